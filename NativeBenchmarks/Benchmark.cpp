@@ -0,0 +1,166 @@
+#include "Benchmark.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <ctime>
+#include <thread>
+
+using namespace std;
+
+static volatile UINT64 g_KeptResult = 0;
+
+void KeepResult(_In_ UINT64 value)
+{
+	g_KeptResult = g_KeptResult ^ value;
+}
+
+static double MeasureNanos(_In_ const std::function<void(UINT64 iterations)> &func, _In_ UINT64 iterations)
+{
+	auto start = chrono::steady_clock::now();
+	func(iterations);
+	auto end = chrono::steady_clock::now();
+	return chrono::duration<double, nano>(end - start).count();
+}
+
+static std::string EscapeJson(_In_ const std::string &text)
+{
+	std::string escaped;
+	for (char c : text) {
+		switch (c) {
+		case '"': escaped += "\\\""; break;
+		case '\\': escaped += "\\\\"; break;
+		case '\n': escaped += "\\n"; break;
+		case '\r': escaped += "\\r"; break;
+		case '\t': escaped += "\\t"; break;
+		default:
+			if (static_cast<unsigned char>(c) < 0x20) {
+				char code[8];
+				snprintf(code, sizeof(code), "\\u%04x", c);
+				escaped += code;
+			}
+			else {
+				escaped += c;
+			}
+		}
+	}
+	return escaped;
+}
+
+BenchmarkRunner::BenchmarkRunner(_In_ BENCHMARK_OPTIONS options) :
+	m_Options(options),
+	m_Context{},
+	m_Results{}
+{
+	m_Options.Repetitions = max(1u, m_Options.Repetitions);
+	time_t now = time(nullptr);
+	tm utc;
+	gmtime_s(&utc, &now);
+	char date[32];
+	strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%SZ", &utc);
+	m_Context["date"] = date;
+	m_Context["label"] = m_Options.Label;
+	m_Context["seed"] = to_string(BENCHMARK_SEED);
+	m_Context["num_cpus"] = to_string(thread::hardware_concurrency());
+#if _DEBUG
+	m_Context["build_type"] = "debug";
+#else
+	m_Context["build_type"] = "release";
+#endif
+#if defined(_M_ARM64)
+	m_Context["architecture"] = "arm64";
+#elif defined(_M_X64)
+	m_Context["architecture"] = "x64";
+#elif defined(_M_IX86)
+	m_Context["architecture"] = "x86";
+#else
+	m_Context["architecture"] = "unknown";
+#endif
+}
+
+bool BenchmarkRunner::IsSelected(_In_ const std::string &name) const
+{
+	return m_Options.Filter.empty() || name.find(m_Options.Filter) != std::string::npos;
+}
+
+void BenchmarkRunner::Run(_In_ const std::string &name, _In_ UINT64 bytesPerIteration, _In_ std::function<void(UINT64 iterations)> func)
+{
+	if (!IsSelected(name)) {
+		return;
+	}
+	//Calibrate the iteration count, which also warms up caches and allocators
+	const double minTimeNanos = m_Options.MinTimeMillis * 1000000.0;
+	UINT64 iterations = 1;
+	double elapsedNanos = MeasureNanos(func, iterations);
+	while (elapsedNanos < minTimeNanos && iterations < (1ULL << 40)) {
+		double scale = elapsedNanos > 0 ? minTimeNanos / elapsedNanos : 10.0;
+		iterations = static_cast<UINT64>(ceil(iterations * min(10.0, max(2.0, scale * 1.2))));
+		elapsedNanos = MeasureNanos(func, iterations);
+	}
+
+	std::vector<double> nanosPerIteration;
+	for (UINT32 i = 0; i < m_Options.Repetitions; i++) {
+		nanosPerIteration.push_back(MeasureNanos(func, iterations) / iterations);
+	}
+	sort(nanosPerIteration.begin(), nanosPerIteration.end());
+	BENCHMARK_RESULT result{};
+	result.Name = name;
+	result.Iterations = iterations;
+	result.Repetitions = m_Options.Repetitions;
+	size_t count = nanosPerIteration.size();
+	result.MedianNanos = count % 2 == 1 ? nanosPerIteration[count / 2] : (nanosPerIteration[count / 2 - 1] + nanosPerIteration[count / 2]) / 2;
+	result.MinNanos = nanosPerIteration.front();
+	result.MaxNanos = nanosPerIteration.back();
+	double sum = 0;
+	for (double nanos : nanosPerIteration) {
+		sum += nanos;
+	}
+	result.MeanNanos = sum / count;
+	double squaredDeviations = 0;
+	for (double nanos : nanosPerIteration) {
+		squaredDeviations += (nanos - result.MeanNanos) * (nanos - result.MeanNanos);
+	}
+	result.StdDevNanos = count > 1 ? sqrt(squaredDeviations / (count - 1)) : 0;
+	result.BytesPerSecond = bytesPerIteration > 0 && result.MedianNanos > 0 ? bytesPerIteration * 1000000000.0 / result.MedianNanos : 0;
+	m_Results.push_back(result);
+	fprintf(stderr, "%-48s %14.1f ns %12llu iterations\n", name.c_str(), result.MedianNanos, static_cast<unsigned long long>(iterations));
+}
+
+void BenchmarkRunner::SetContext(_In_ const std::string &key, _In_ const std::string &value)
+{
+	m_Context[key] = value;
+}
+
+void BenchmarkRunner::WriteJson(_Inout_ std::ostream &stream) const
+{
+	char number[64];
+	stream << "{\n  \"version\": " << BENCHMARK_RESULTS_VERSION << ",\n  \"context\": {";
+	bool isFirst = true;
+	for (const auto &entry : m_Context) {
+		stream << (isFirst ? "\n" : ",\n") << "    \"" << EscapeJson(entry.first) << "\": \"" << EscapeJson(entry.second) << "\"";
+		isFirst = false;
+	}
+	stream << "\n  },\n  \"benchmarks\": [";
+	isFirst = true;
+	for (const BENCHMARK_RESULT &result : m_Results) {
+		stream << (isFirst ? "\n" : ",\n") << "    {\n";
+		stream << "      \"name\": \"" << EscapeJson(result.Name) << "\",\n";
+		stream << "      \"iterations\": " << result.Iterations << ",\n";
+		stream << "      \"repetitions\": " << result.Repetitions << ",\n";
+		snprintf(number, sizeof(number), "%.3f", result.MedianNanos);
+		stream << "      \"median_ns\": " << number << ",\n";
+		snprintf(number, sizeof(number), "%.3f", result.MeanNanos);
+		stream << "      \"mean_ns\": " << number << ",\n";
+		snprintf(number, sizeof(number), "%.3f", result.MinNanos);
+		stream << "      \"min_ns\": " << number << ",\n";
+		snprintf(number, sizeof(number), "%.3f", result.MaxNanos);
+		stream << "      \"max_ns\": " << number << ",\n";
+		snprintf(number, sizeof(number), "%.3f", result.StdDevNanos);
+		stream << "      \"stddev_ns\": " << number << ",\n";
+		snprintf(number, sizeof(number), "%.0f", result.BytesPerSecond);
+		stream << "      \"bytes_per_second\": " << number << "\n";
+		stream << "    }";
+		isFirst = false;
+	}
+	stream << "\n  ]\n}\n";
+}
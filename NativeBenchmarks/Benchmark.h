@@ -0,0 +1,78 @@
+#pragma once
+#include <Windows.h>
+#include <functional>
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+//Seed of the random generators that produce the synthetic input data, so every run measures the same input.
+#define BENCHMARK_SEED 20240607
+//Version of the JSON results, increased when fields are renamed or removed.
+#define BENCHMARK_RESULTS_VERSION 1
+
+struct BENCHMARK_OPTIONS {
+	// Only benchmarks with names that contain this text are run. Empty runs all benchmarks.
+	std::string Filter;
+	// Number of timed repetitions of each benchmark
+	UINT32 Repetitions;
+	// Minimum duration of a repetition. The number of iterations is doubled until a repetition takes at least this long.
+	double MinTimeMillis;
+	// Free text stored with the results, like the commit that was measured
+	std::string Label;
+	BENCHMARK_OPTIONS() :
+		Filter(),
+		Repetitions(5),
+		MinTimeMillis(100),
+		Label()
+	{
+	}
+};
+
+struct BENCHMARK_RESULT {
+	std::string Name;
+	// Iterations in each repetition
+	UINT64 Iterations;
+	UINT32 Repetitions;
+	// Time of an iteration in nanoseconds, over the repetitions
+	double MedianNanos;
+	double MeanNanos;
+	double MinNanos;
+	double MaxNanos;
+	double StdDevNanos;
+	// Bytes of input processed per second at the median time, or 0 if the benchmark does not process a known number of bytes
+	double BytesPerSecond;
+};
+
+//
+// Runs benchmarks and collects the time of an iteration of each. A benchmark is a function that runs the measured code
+// a given number of times, so the loop and any per iteration setup is under the control of the benchmark.
+// The iteration count is first calibrated to fill the minimum repetition time, and then the timed repetitions are run.
+//
+class BenchmarkRunner
+{
+public:
+	BenchmarkRunner(_In_ BENCHMARK_OPTIONS options);
+	bool IsSelected(_In_ const std::string &name) const;
+	/// <summary>
+	/// Runs the benchmark if its name matches the filter.
+	/// </summary>
+	/// <param name="bytesPerIteration">Bytes of input processed by an iteration, to report throughput, or 0</param>
+	/// <param name="func">Runs the measured code the given number of times</param>
+	void Run(_In_ const std::string &name, _In_ UINT64 bytesPerIteration, _In_ std::function<void(UINT64 iterations)> func);
+	/// <summary>
+	/// Records a value in the context of the results, like the build configuration or the instruction set used by a kernel.
+	/// </summary>
+	void SetContext(_In_ const std::string &key, _In_ const std::string &value);
+	const std::vector<BENCHMARK_RESULT> &GetResults() const { return m_Results; }
+	void WriteJson(_Inout_ std::ostream &stream) const;
+private:
+	BENCHMARK_OPTIONS m_Options;
+	std::map<std::string, std::string> m_Context;
+	std::vector<BENCHMARK_RESULT> m_Results;
+};
+
+/// <summary>
+/// Keeps the compiler from removing the computation of a value that is otherwise unused.
+/// </summary>
+void KeepResult(_In_ UINT64 value);
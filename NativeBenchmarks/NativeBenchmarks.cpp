@@ -0,0 +1,396 @@
+//
+// Microbenchmarks of the CPU hot paths of the library. They run on synthetic data from fixed seeds and need no
+// GPU, display or audio device, so results from a build host can be compared from commit to commit.
+//
+// Usage: NativeBenchmarks [--out <results.json>] [--filter <text>] [--repetitions <count>] [--min-time <milliseconds>] [--label <text>]
+//
+// Results are written as JSON to the --out file, or to stdout. Progress is written to stderr.
+//
+#include "Benchmark.h"
+#include "AudioSamples.h"
+#include "CursorRasterizer.h"
+#include "DirtyRects.h"
+#include "LogQueue.h"
+#include "WWMFResampler.h"
+#include "YuvConversion.h"
+#include "fifo_map.h"
+#include <mfapi.h>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <random>
+
+// The logging globals are defined by RecordingManager in the library, which is not part of the benchmarks.
+bool isLoggingEnabled = false;
+int logSeverityLevel = LOG_LVL_INFO;
+
+//Sample rate and channels of the synthetic audio, 16 bit stereo at 48 kHz like the default output format
+#define AUDIO_SAMPLE_RATE 48000
+#define AUDIO_CHANNELS 2
+#define AUDIO_FRAME_BYTES (AUDIO_CHANNELS * 2)
+//Audio grabbed for each video frame at 30 fps
+#define AUDIO_FRAMES_PER_VIDEO_FRAME (AUDIO_SAMPLE_RATE / 30)
+//Audio delivered by the capture device in one packet, 10 ms
+#define AUDIO_FRAMES_PER_PACKET (AUDIO_SAMPLE_RATE / 100)
+
+static std::vector<BYTE> CreateRandomPcm(_Inout_ std::mt19937 &random, _In_ size_t frameCount)
+{
+	//Well below full scale, so mixing two sources rarely clips
+	std::uniform_int_distribution<int> amplitude(-12000, 12000);
+	std::vector<BYTE> bytes(frameCount * AUDIO_FRAME_BYTES);
+	for (size_t i = 0; i < bytes.size(); i += 2) {
+		short sample = static_cast<short>(amplitude(random));
+		bytes[i] = static_cast<BYTE>(sample & 0xFF);
+		bytes[i + 1] = static_cast<BYTE>((sample >> 8) & 0xFF);
+	}
+	return bytes;
+}
+
+static void RunAudioBenchmarks(_Inout_ BenchmarkRunner &runner)
+{
+	std::mt19937 random(BENCHMARK_SEED);
+	std::vector<BYTE> outputDeviceBytes = CreateRandomPcm(random, AUDIO_FRAMES_PER_VIDEO_FRAME);
+	std::vector<BYTE> inputDeviceBytes = CreateRandomPcm(random, AUDIO_FRAMES_PER_VIDEO_FRAME);
+	const std::vector<BYTE> noBytes;
+	runner.Run("MixAudio/two_devices", outputDeviceBytes.size() + inputDeviceBytes.size(), [&](UINT64 iterations) {
+		for (UINT64 i = 0; i < iterations; i++) {
+			std::vector<BYTE> mixed = MixAudio(outputDeviceBytes, inputDeviceBytes, 1.0f, 0.8f);
+			KeepResult(mixed[i % mixed.size()]);
+		}
+	});
+	runner.Run("MixAudio/one_device", outputDeviceBytes.size(), [&](UINT64 iterations) {
+		for (UINT64 i = 0; i < iterations; i++) {
+			std::vector<BYTE> mixed = MixAudio(outputDeviceBytes, noBytes, 0.5f, 1.0f);
+			KeepResult(mixed[i % mixed.size()]);
+		}
+	});
+
+	//The capture thread appends packets as they arrive, and the bytes of a video frame are taken when it is written
+	std::vector<BYTE> packet = CreateRandomPcm(random, AUDIO_FRAMES_PER_PACKET);
+	runner.Run("AudioSampleQueue/append_and_take", packet.size(), [&](UINT64 iterations) {
+		AudioSampleQueue queue;
+		for (UINT64 i = 0; i < iterations; i++) {
+			queue.Append(packet.data(), packet.size());
+			if (queue.GetSize() >= AUDIO_FRAMES_PER_VIDEO_FRAME * AUDIO_FRAME_BYTES) {
+				KeepResult(queue.Take(AUDIO_FRAMES_PER_VIDEO_FRAME * AUDIO_FRAME_BYTES).size());
+			}
+		}
+	});
+	//When writing falls behind, each frame is taken from the front of a backlog of queued audio
+	std::vector<BYTE> backlog = CreateRandomPcm(random, AUDIO_SAMPLE_RATE);
+	runner.Run("AudioSampleQueue/take_from_1s_backlog", AUDIO_FRAMES_PER_VIDEO_FRAME * AUDIO_FRAME_BYTES, [&](UINT64 iterations) {
+		AudioSampleQueue queue;
+		queue.Append(backlog.data(), backlog.size());
+		for (UINT64 i = 0; i < iterations; i++) {
+			std::vector<BYTE> bytes = queue.Take(AUDIO_FRAMES_PER_VIDEO_FRAME * AUDIO_FRAME_BYTES);
+			queue.Append(bytes.data(), bytes.size());
+			KeepResult(bytes[0]);
+		}
+	});
+}
+
+static void RunResamplerBenchmarks(_Inout_ BenchmarkRunner &runner)
+{
+	const std::string name = "Resampler/44100_to_48000_stereo_10ms";
+	if (!runner.IsSelected(name)) {
+		return;
+	}
+	//The formats used when the device mixes at 44.1 kHz and the recording is 48 kHz, with the filter length used by WASAPICapture
+	WWMFPcmFormat inputFormat(WWMFBitFormatType::WWMFBitFormatInt, AUDIO_CHANNELS, 16, 44100, 0, 16);
+	WWMFPcmFormat outputFormat = inputFormat;
+	outputFormat.sampleRate = AUDIO_SAMPLE_RATE;
+	WWMFResampler resampler;
+	HRESULT hr = resampler.Initialize(inputFormat, outputFormat, 60);
+	if (FAILED(hr)) {
+		fprintf(stderr, "Skipping %s, the resampler could not be created: hr = 0x%08x\n", name.c_str(), hr);
+		return;
+	}
+	std::mt19937 random(BENCHMARK_SEED);
+	std::vector<BYTE> packet = CreateRandomPcm(random, 441);
+	runner.Run(name, packet.size(), [&](UINT64 iterations) {
+		for (UINT64 i = 0; i < iterations; i++) {
+			WWMFSampleData sampleData;
+			if (SUCCEEDED(resampler.Resample(packet.data(), static_cast<DWORD>(packet.size()), &sampleData))) {
+				KeepResult(sampleData.bytes);
+			}
+			sampleData.Release();
+		}
+	});
+}
+
+static void RunCursorBenchmarks(_Inout_ BenchmarkRunner &runner)
+{
+	runner.SetContext("cursor_rasterizer", IsCursorRasterizerVectorized() ? "vectorized" : "scalar");
+	//A large pointer, as drawn with the pointer size accessibility setting
+	const INT size = 128;
+	std::mt19937 random(BENCHMARK_SEED);
+	std::vector<UINT> background(size * size);
+	for (UINT &pixel : background) {
+		pixel = random() | CURSOR_OPAQUE_BLACK;
+	}
+	std::vector<UINT> output(size * size);
+	const UINT64 outputBytes = output.size() * sizeof(UINT);
+
+	//An AND mask followed by an XOR mask, one bit per pixel
+	const UINT monochromePitch = size / 8;
+	std::vector<BYTE> monochromeShape(monochromePitch * size * 2);
+	for (BYTE &value : monochromeShape) {
+		value = static_cast<BYTE>(random());
+	}
+	CURSOR_RASTER_DESC monochromeDesc{};
+	monochromeDesc.pShape = monochromeShape.data();
+	monochromeDesc.ShapePitch = monochromePitch;
+	monochromeDesc.MaskHeight = size;
+	monochromeDesc.pBackground = background.data();
+	monochromeDesc.BackgroundPitchInPixels = size;
+	monochromeDesc.Width = size;
+	monochromeDesc.Height = size;
+
+	//Each pixel either replaces the background or is XORed with it
+	std::vector<UINT> colorPixels(size * size);
+	for (UINT &pixel : colorPixels) {
+		pixel = (random() % 2 ? CURSOR_OPAQUE_BLACK : 0) | (random() & 0x00FFFFFF);
+	}
+	CURSOR_RASTER_DESC colorDesc = monochromeDesc;
+	colorDesc.pShape = reinterpret_cast<const BYTE *>(colorPixels.data());
+	colorDesc.ShapePitch = size * sizeof(UINT);
+
+	runner.Run("CursorRasterizer/monochrome_128", outputBytes, [&](UINT64 iterations) {
+		for (UINT64 i = 0; i < iterations; i++) {
+			RasterizeMonochromeCursor(monochromeDesc, output.data());
+			KeepResult(output[i % output.size()]);
+		}
+	});
+	runner.Run("CursorRasterizer/monochrome_128_scalar", outputBytes, [&](UINT64 iterations) {
+		for (UINT64 i = 0; i < iterations; i++) {
+			RasterizeMonochromeCursorScalar(monochromeDesc, output.data());
+			KeepResult(output[i % output.size()]);
+		}
+	});
+	runner.Run("CursorRasterizer/masked_color_128", outputBytes, [&](UINT64 iterations) {
+		for (UINT64 i = 0; i < iterations; i++) {
+			RasterizeMaskedColorCursor(colorDesc, output.data());
+			KeepResult(output[i % output.size()]);
+		}
+	});
+	runner.Run("CursorRasterizer/masked_color_128_scalar", outputBytes, [&](UINT64 iterations) {
+		for (UINT64 i = 0; i < iterations; i++) {
+			RasterizeMaskedColorCursorScalar(colorDesc, output.data());
+			KeepResult(output[i % output.size()]);
+		}
+	});
+
+	//A pointer without inverted pixels is scanned to the end before it can be cached
+	std::vector<BYTE> opaqueShape(monochromeShape.size(), 0);
+	runner.Run("CursorRasterizer/background_dependence_128", opaqueShape.size(), [&](UINT64 iterations) {
+		for (UINT64 i = 0; i < iterations; i++) {
+			KeepResult(IsCursorBackgroundDependent(true, opaqueShape.data(), monochromePitch, size, size));
+		}
+	});
+}
+
+static void RunYuvBenchmarks(_Inout_ BenchmarkRunner &runner)
+{
+	const YUV_TO_RGB_MATRIX matrix = GetYuvToRgbMatrix(YuvMatrix::BT709, false);
+	std::mt19937 random(BENCHMARK_SEED);
+
+	//A 1080p frame from a video source
+	const UINT nv12Width = 1920;
+	const UINT nv12Height = 1080;
+	std::vector<BYTE> nv12(GetYuvFrameBufferSize(YuvPixelFormat::NV12, nv12Width, nv12Height));
+	for (BYTE &value : nv12) {
+		value = static_cast<BYTE>(random());
+	}
+	std::vector<BYTE> nv12Output(nv12Width * nv12Height * 4);
+	runner.Run("YuvConversion/nv12_to_bgra_1080p", nv12.size(), [&](UINT64 iterations) {
+		for (UINT64 i = 0; i < iterations; i++) {
+			ConvertNV12ToBGRA(nv12.data(), nv12Width, nv12.data() + nv12Width * nv12Height, nv12Width, nv12Width, nv12Height, matrix, nv12Output.data(), nv12Width * 4);
+			KeepResult(nv12Output[i % nv12Output.size()]);
+		}
+	});
+
+	//A 720p frame from a webcam
+	const UINT yuy2Width = 1280;
+	const UINT yuy2Height = 720;
+	std::vector<BYTE> yuy2(GetYuvFrameBufferSize(YuvPixelFormat::YUY2, yuy2Width * 2, yuy2Height));
+	for (BYTE &value : yuy2) {
+		value = static_cast<BYTE>(random());
+	}
+	std::vector<BYTE> yuy2Output(yuy2Width * yuy2Height * 4);
+	runner.Run("YuvConversion/yuy2_to_bgra_720p", yuy2.size(), [&](UINT64 iterations) {
+		for (UINT64 i = 0; i < iterations; i++) {
+			ConvertYUY2ToBGRA(yuy2.data(), yuy2Width * 2, yuy2Width, yuy2Height, matrix, yuy2Output.data(), yuy2Width * 4);
+			KeepResult(yuy2Output[i % yuy2Output.size()]);
+		}
+	});
+}
+
+static void RunFifoMapBenchmarks(_Inout_ BenchmarkRunner &runner)
+{
+	//The frame delays of a recording in slideshow mode get one entry for each written image
+	std::vector<std::wstring> paths;
+	for (int i = 0; i < 1000; i++) {
+		paths.push_back(L"C:\\Users\\Recorder\\Videos\\Slideshow\\" + std::to_wstring(i) + L".png");
+	}
+	runner.Run("fifo_map/insert_1000_frame_delays", 0, [&](UINT64 iterations) {
+		for (UINT64 i = 0; i < iterations; i++) {
+			nlohmann::fifo_map<std::wstring, int> delays{};
+			for (const std::wstring &path : paths) {
+				delays.insert(std::pair<std::wstring, int>(path, 33));
+			}
+			KeepResult(delays.size());
+		}
+	});
+}
+
+static void RunDirtyRectBenchmarks(_Inout_ BenchmarkRunner &runner)
+{
+	const RECT desktopCoordinates{ 0, 0, 1920, 1080 };
+	D3D11_TEXTURE2D_DESC desc{};
+	desc.Width = 1920;
+	desc.Height = 1080;
+	std::mt19937 random(BENCHMARK_SEED);
+
+	//A busy frame, like scrolling a web page, can report hundreds of dirty rects
+	std::vector<RECT> dirtyRects(256);
+	for (RECT &rect : dirtyRects) {
+		rect.left = random() % 1800;
+		rect.top = random() % 1000;
+		rect.right = rect.left + 1 + random() % 120;
+		rect.bottom = rect.top + 1 + random() % 80;
+	}
+	std::vector<VERTEX> vertices(dirtyRects.size() * DIRTY_RECT_VERTEX_COUNT);
+	for (DXGI_MODE_ROTATION rotation : { DXGI_MODE_ROTATION_IDENTITY, DXGI_MODE_ROTATION_ROTATE90 }) {
+		std::string name = rotation == DXGI_MODE_ROTATION_IDENTITY ? "DirtyRects/vertices_256" : "DirtyRects/vertices_256_rotated";
+		runner.Run(name, 0, [&](UINT64 iterations) {
+			for (UINT64 i = 0; i < iterations; i++) {
+				for (size_t r = 0; r < dirtyRects.size(); r++) {
+					SetDirtyVert(&vertices[r * DIRTY_RECT_VERTEX_COUNT], &dirtyRects[r], 0, 0, desktopCoordinates, rotation, &desc, &desc);
+				}
+				KeepResult(static_cast<INT64>(vertices[i % vertices.size()].Pos.x * 1000));
+			}
+		});
+	}
+
+	std::vector<DXGI_OUTDUPL_MOVE_RECT> moveRects(64);
+	for (DXGI_OUTDUPL_MOVE_RECT &moveRect : moveRects) {
+		moveRect.DestinationRect.left = random() % 1800;
+		moveRect.DestinationRect.top = random() % 1000;
+		moveRect.DestinationRect.right = moveRect.DestinationRect.left + 1 + random() % 120;
+		moveRect.DestinationRect.bottom = moveRect.DestinationRect.top + 1 + random() % 80;
+		moveRect.SourcePoint.x = moveRect.DestinationRect.left;
+		moveRect.SourcePoint.y = max(0L, moveRect.DestinationRect.top - 40);
+	}
+	runner.Run("DirtyRects/move_rects_64_rotated", 0, [&](UINT64 iterations) {
+		for (UINT64 i = 0; i < iterations; i++) {
+			for (DXGI_OUTDUPL_MOVE_RECT &moveRect : moveRects) {
+				RECT sourceRect;
+				RECT destinationRect;
+				SetMoveRect(&sourceRect, &destinationRect, DXGI_MODE_ROTATION_ROTATE270, &moveRect, 1920, 1080);
+				KeepResult(sourceRect.left ^ destinationRect.bottom);
+			}
+		}
+	});
+}
+
+static bool PushLogMessage(_Inout_ LogQueue &queue, _In_ PCWSTR format, ...)
+{
+	va_list args;
+	va_start(args, format);
+	bool isQueued = queue.TryPush(LOG_LVL_INFO, std::chrono::system_clock::now(), format, args);
+	va_end(args);
+	return isQueued;
+}
+
+static void RunLogBenchmarks(_Inout_ BenchmarkRunner &runner)
+{
+	//Messages are formatted by the logging thread into its queue, so this is the cost of a log statement on a pipeline thread.
+	//Writing the queued messages to the file is done on the log writer thread, and is not measured.
+	LogQueue queue;
+	runner.Run("Log/format_message", 0, [&](UINT64 iterations) {
+		for (UINT64 i = 0; i < iterations; i++) {
+			PushLogMessage(queue, L"[INFO]  [%-25.24hs|%20.19hs:%4d] >> Wrote frame %llu of %ls at %.2f ms, %d bytes\n",
+				file_name(__FILE__), __func__, __LINE__, i, L"Display 1", i * 16.67, 8294400);
+			queue.Drain([](const LOG_RECORD &record) {
+				KeepResult(record.Message[0]);
+			});
+		}
+	});
+}
+
+static bool ParseArguments(_In_ int argc, _In_reads_(argc) char *argv[], _Out_ BENCHMARK_OPTIONS *pOptions, _Out_ std::string *pOutputPath)
+{
+	*pOptions = BENCHMARK_OPTIONS();
+	pOutputPath->clear();
+	for (int i = 1; i < argc; i++) {
+		std::string argument = argv[i];
+		if (i + 1 >= argc) {
+			return false;
+		}
+		std::string value = argv[++i];
+		if (argument == "--out") {
+			*pOutputPath = value;
+		}
+		else if (argument == "--filter") {
+			pOptions->Filter = value;
+		}
+		else if (argument == "--repetitions") {
+			pOptions->Repetitions = static_cast<UINT32>(atoi(value.c_str()));
+		}
+		else if (argument == "--min-time") {
+			pOptions->MinTimeMillis = atof(value.c_str());
+		}
+		else if (argument == "--label") {
+			pOptions->Label = value;
+		}
+		else {
+			return false;
+		}
+	}
+	return true;
+}
+
+int main(int argc, char *argv[])
+{
+	BENCHMARK_OPTIONS options;
+	std::string outputPath;
+	if (!ParseArguments(argc, argv, &options, &outputPath)) {
+		fprintf(stderr, "Usage: %s [--out <results.json>] [--filter <text>] [--repetitions <count>] [--min-time <milliseconds>] [--label <text>]\n", argv[0]);
+		return 2;
+	}
+#if _DEBUG
+	fprintf(stderr, "Warning: this is a debug build, the results are not representative\n");
+#endif
+	HRESULT hr = CoInitializeEx(nullptr, COINIT_MULTITHREADED);
+	if (SUCCEEDED(hr)) {
+		hr = MFStartup(MF_VERSION, MFSTARTUP_LITE);
+	}
+	if (FAILED(hr)) {
+		fprintf(stderr, "Failed to initialize Media Foundation: hr = 0x%08x\n", hr);
+		return 1;
+	}
+
+	BenchmarkRunner runner(options);
+	RunAudioBenchmarks(runner);
+	RunResamplerBenchmarks(runner);
+	RunCursorBenchmarks(runner);
+	RunYuvBenchmarks(runner);
+	RunFifoMapBenchmarks(runner);
+	RunDirtyRectBenchmarks(runner);
+	RunLogBenchmarks(runner);
+
+	MFShutdown();
+	CoUninitialize();
+
+	if (outputPath.empty()) {
+		runner.WriteJson(std::cout);
+		return 0;
+	}
+	std::ofstream stream(outputPath, std::ios_base::out | std::ios_base::trunc);
+	if (!stream.is_open()) {
+		fprintf(stderr, "Failed to open %s\n", outputPath.c_str());
+		return 1;
+	}
+	runner.WriteJson(stream);
+	return stream.good() ? 0 : 1;
+}
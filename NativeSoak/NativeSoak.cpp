@@ -0,0 +1,452 @@
+//
+// Soak test of the full recording pipeline. A generated test pattern and test audio signal are recorded on a virtual media clock,
+// which the recorder advances as fast as frames are processed, so the equivalent of a day of recording runs in a few hours.
+// Memory, handle and thread counts and the per-frame latency of the recording loop are sampled at a fixed interval of media time,
+// and the run fails if any of them trends upward by more than its threshold once the warm-up is over.
+//
+// Usage: NativeSoak [--hours <media hours>] [--sample-minutes <media minutes>] [--fps <fps>] [--width <pixels>] [--height <pixels>]
+//                   [--bitrate <bits per second>] [--audio <0|1>] [--out <samples.csv>] [--recording <path>]
+//
+// The samples are written as CSV to the --out file as they are taken, and the trend of every metric is written to stdout at the end.
+// The recording is written to the --recording path, or to a temporary file that is deleted at the end.
+// Exits with 0 if no metric trends upward, 1 if any does, 2 on invalid arguments and 3 if the recording fails.
+//
+#include "RecordingManager.h"
+#include "MediaClock.h"
+#include "MetricsRegistry.h"
+#include "SoakTrend.h"
+#include "util.h"
+#include <atlbase.h>
+#include <dxgi1_4.h>
+#include <Psapi.h>
+#include <TlHelp32.h>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+
+#define BYTES_PER_MB (1024.0 * 1024.0)
+//Media time units in a millisecond, to report frame latencies in milliseconds
+#define MEDIA_TIME_UNITS_PER_MILLISECOND 10000.0
+//Media time units in an hour, the unit trends are fitted in
+#define MEDIA_TIME_UNITS_PER_HOUR (3600LL * MEDIA_TIME_UNITS_PER_SECOND)
+
+struct SOAK_OPTIONS {
+	// Media time to record
+	double Hours;
+	// Media time between samples
+	double SampleMinutes;
+	UINT32 Fps;
+	SIZE Size;
+	UINT32 Bitrate;
+	bool IsAudioEnabled;
+	// Path of the CSV file the samples are written to, or empty
+	std::string SamplesPath;
+	// Path the recording is kept at, or empty to record to a temporary file
+	std::string RecordingPath;
+	SOAK_OPTIONS() :
+		Hours(24),
+		SampleMinutes(15),
+		Fps(30),
+		Size{ 1280, 720 },
+		Bitrate(500 * 1000),
+		IsAudioEnabled(true),
+		SamplesPath(),
+		RecordingPath()
+	{
+	}
+};
+
+struct SOAK_SAMPLE {
+	double MediaHours;
+	double WallSeconds;
+	// Frames rendered since the previous sample
+	INT64 FrameCount;
+	double WorkingSetMB;
+	double PrivateMB;
+	// Live allocations on the process heap, which the CRT allocates from
+	double HeapAllocations;
+	double HeapMB;
+	// Video memory of the process on all adapters, or 0 if it can not be queried
+	double GpuMB;
+	double Handles;
+	double Threads;
+	// Wall time between frames of the recording loop since the previous sample. On the virtual clock this is the time it takes to process a frame.
+	double FrameP50Millis;
+	double FrameP90Millis;
+	double FrameP99Millis;
+};
+
+struct SOAK_METRIC {
+	const char *Name;
+	double SOAK_SAMPLE:: *Value;
+	SOAK_TREND_THRESHOLD Threshold;
+};
+
+//The metrics that are gated on, and how much each may grow over the run after the warm-up.
+//Thread counts are small, so a few threads more is already a leak.
+static const SOAK_METRIC SoakMetrics[] = {
+	{ "working_set_mb", &SOAK_SAMPLE::WorkingSetMB, SOAK_TREND_THRESHOLD(0.1, 32) },
+	{ "private_mb", &SOAK_SAMPLE::PrivateMB, SOAK_TREND_THRESHOLD(0.1, 32) },
+	{ "heap_allocations", &SOAK_SAMPLE::HeapAllocations, SOAK_TREND_THRESHOLD(0.1, 1000) },
+	{ "heap_mb", &SOAK_SAMPLE::HeapMB, SOAK_TREND_THRESHOLD(0.1, 16) },
+	{ "gpu_mb", &SOAK_SAMPLE::GpuMB, SOAK_TREND_THRESHOLD(0.1, 64) },
+	{ "handles", &SOAK_SAMPLE::Handles, SOAK_TREND_THRESHOLD(0.1, 50) },
+	{ "threads", &SOAK_SAMPLE::Threads, SOAK_TREND_THRESHOLD(0, 4) },
+	{ "frame_p50_ms", &SOAK_SAMPLE::FrameP50Millis, SOAK_TREND_THRESHOLD(0.25, 1) },
+	{ "frame_p90_ms", &SOAK_SAMPLE::FrameP90Millis, SOAK_TREND_THRESHOLD(0.25, 1) },
+	{ "frame_p99_ms", &SOAK_SAMPLE::FrameP99Millis, SOAK_TREND_THRESHOLD(0.25, 2) },
+};
+
+//State shared with the recorder callbacks, which are plain function pointers. The sampling callbacks are all called on the recording thread.
+struct SOAK_STATE {
+	std::shared_ptr<VirtualMediaClock> Clock;
+	INT64 Duration;
+	HANDLE DurationReachedEvent;
+	HANDLE FinishedEvent;
+	bool IsSuccess;
+	std::wstring Error;
+	LARGE_INTEGER StartTime;
+	LARGE_INTEGER PreviousFrameTime;
+	INT64 PreviousFrameNumber;
+	std::unique_ptr<LatencyHistogram> FrameLatency;
+	std::vector<CComPtr<IDXGIAdapter3>> Adapters;
+	std::vector<SOAK_SAMPLE> Samples;
+	std::ofstream SamplesStream;
+};
+static SOAK_STATE g_Soak{};
+
+static std::vector<CComPtr<IDXGIAdapter3>> GetAdapters()
+{
+	std::vector<CComPtr<IDXGIAdapter3>> adapters;
+	CComPtr<IDXGIFactory1> pFactory;
+	if (FAILED(CreateDXGIFactory1(IID_PPV_ARGS(&pFactory)))) {
+		return adapters;
+	}
+	CComPtr<IDXGIAdapter1> pAdapter;
+	for (UINT i = 0; pFactory->EnumAdapters1(i, &pAdapter) != DXGI_ERROR_NOT_FOUND; i++) {
+		CComPtr<IDXGIAdapter3> pAdapter3;
+		//QueryVideoMemoryInfo needs Windows 10
+		if (SUCCEEDED(pAdapter->QueryInterface(IID_PPV_ARGS(&pAdapter3)))) {
+			adapters.push_back(pAdapter3);
+		}
+		pAdapter.Release();
+	}
+	return adapters;
+}
+
+static double GetGpuMemoryMB(_In_ const std::vector<CComPtr<IDXGIAdapter3>> &adapters)
+{
+	UINT64 bytes = 0;
+	for (const CComPtr<IDXGIAdapter3> &pAdapter : adapters) {
+		for (DXGI_MEMORY_SEGMENT_GROUP group : { DXGI_MEMORY_SEGMENT_GROUP_LOCAL, DXGI_MEMORY_SEGMENT_GROUP_NON_LOCAL }) {
+			DXGI_QUERY_VIDEO_MEMORY_INFO info{};
+			if (SUCCEEDED(pAdapter->QueryVideoMemoryInfo(0, group, &info))) {
+				bytes += info.CurrentUsage;
+			}
+		}
+	}
+	return bytes / BYTES_PER_MB;
+}
+
+/// <summary>
+/// Counts the allocations on the process heap. The heap is locked while it is walked, which blocks other threads that allocate for a few milliseconds.
+/// </summary>
+static void GetHeapUsage(_Out_ double *pAllocationCount, _Out_ double *pAllocatedMB)
+{
+	*pAllocationCount = 0;
+	*pAllocatedMB = 0;
+	HANDLE heap = GetProcessHeap();
+	if (!HeapLock(heap)) {
+		return;
+	}
+	UINT64 count = 0;
+	UINT64 bytes = 0;
+	PROCESS_HEAP_ENTRY entry{};
+	while (HeapWalk(heap, &entry)) {
+		if ((entry.wFlags & PROCESS_HEAP_ENTRY_BUSY) != 0) {
+			count++;
+			bytes += entry.cbData;
+		}
+	}
+	HeapUnlock(heap);
+	*pAllocationCount = static_cast<double>(count);
+	*pAllocatedMB = bytes / BYTES_PER_MB;
+}
+
+static double GetThreadCount()
+{
+	HANDLE snapshot = CreateToolhelp32Snapshot(TH32CS_SNAPTHREAD, 0);
+	if (snapshot == INVALID_HANDLE_VALUE) {
+		return 0;
+	}
+	DWORD processId = GetCurrentProcessId();
+	UINT32 count = 0;
+	THREADENTRY32 entry{};
+	entry.dwSize = sizeof(entry);
+	for (BOOL found = Thread32First(snapshot, &entry); found; found = Thread32Next(snapshot, &entry)) {
+		if (entry.th32OwnerProcessID == processId) {
+			count++;
+		}
+	}
+	CloseHandle(snapshot);
+	return count;
+}
+
+static SOAK_SAMPLE TakeSample(_In_ INT64 mediaTime)
+{
+	SOAK_SAMPLE sample{};
+	LARGE_INTEGER now;
+	QueryPerformanceCounter(&now);
+	sample.MediaHours = static_cast<double>(mediaTime) / MEDIA_TIME_UNITS_PER_HOUR;
+	sample.WallSeconds = static_cast<double>(QPCTicksToHundredNanos(now.QuadPart - g_Soak.StartTime.QuadPart)) / MEDIA_TIME_UNITS_PER_SECOND;
+
+	PROCESS_MEMORY_COUNTERS_EX memory{};
+	if (GetProcessMemoryInfo(GetCurrentProcess(), reinterpret_cast<PROCESS_MEMORY_COUNTERS *>(&memory), sizeof(memory))) {
+		sample.WorkingSetMB = memory.WorkingSetSize / BYTES_PER_MB;
+		sample.PrivateMB = memory.PrivateUsage / BYTES_PER_MB;
+	}
+	GetHeapUsage(&sample.HeapAllocations, &sample.HeapMB);
+	sample.GpuMB = GetGpuMemoryMB(g_Soak.Adapters);
+	DWORD handleCount = 0;
+	if (GetProcessHandleCount(GetCurrentProcess(), &handleCount)) {
+		sample.Handles = handleCount;
+	}
+	sample.Threads = GetThreadCount();
+
+	LATENCY_HISTOGRAM_SNAPSHOT latency = g_Soak.FrameLatency->GetSnapshot();
+	sample.FrameCount = latency.Count;
+	if (latency.Count > 0) {
+		sample.FrameP50Millis = latency.P50 / MEDIA_TIME_UNITS_PER_MILLISECOND;
+		sample.FrameP90Millis = latency.P90 / MEDIA_TIME_UNITS_PER_MILLISECOND;
+		sample.FrameP99Millis = latency.P99 / MEDIA_TIME_UNITS_PER_MILLISECOND;
+	}
+	//Latencies are reported per sample interval, so a slowdown late in the run is not averaged away by the hours before it
+	g_Soak.FrameLatency = std::make_unique<LatencyHistogram>();
+	return sample;
+}
+
+static void WriteSamplesHeader(_Inout_ std::ostream &stream)
+{
+	stream << "media_hours,wall_seconds,frames";
+	for (const SOAK_METRIC &metric : SoakMetrics) {
+		stream << "," << metric.Name;
+	}
+	stream << std::endl;
+}
+
+static void WriteSample(_Inout_ std::ostream &stream, _In_ const SOAK_SAMPLE &sample)
+{
+	stream << std::fixed << std::setprecision(4) << sample.MediaHours << "," << sample.WallSeconds << "," << sample.FrameCount;
+	for (const SOAK_METRIC &metric : SoakMetrics) {
+		stream << "," << sample.*metric.Value;
+	}
+	//Flushed every sample, so the samples up to a crash or hang are kept
+	stream << std::endl;
+}
+
+static void __stdcall OnFrameNumberChanged(int frameNumber, INT64 timestamp, _In_opt_ FRAME_BITMAP_DATA *data)
+{
+	LARGE_INTEGER now;
+	QueryPerformanceCounter(&now);
+	//Frames are numbered from 1, and restart when the capture is restarted
+	if (g_Soak.PreviousFrameNumber > 0 && frameNumber > g_Soak.PreviousFrameNumber) {
+		g_Soak.FrameLatency->Record(QPCTicksToHundredNanos(now.QuadPart - g_Soak.PreviousFrameTime.QuadPart));
+	}
+	g_Soak.PreviousFrameNumber = frameNumber;
+	g_Soak.PreviousFrameTime = now;
+}
+
+static void __stdcall OnStatistics(const METRICS_SNAPSHOT &snapshot)
+{
+	INT64 mediaTime = g_Soak.Clock->GetTime();
+	SOAK_SAMPLE sample = TakeSample(mediaTime);
+	g_Soak.Samples.push_back(sample);
+	if (g_Soak.SamplesStream.is_open()) {
+		WriteSample(g_Soak.SamplesStream, sample);
+	}
+	const METRIC_SNAPSHOT *pDroppedFrames = snapshot.Find(L"recorder.dropped_frames");
+	fprintf(stderr, "%6.2f h (%.1fx real time): working set %.1f MB, heap %.0f allocations, %.0f handles, %.0f threads, frame p99 %.2f ms, %.0f dropped frames\n",
+		sample.MediaHours, sample.WallSeconds > 0 ? sample.MediaHours * 3600 / sample.WallSeconds : 0,
+		sample.WorkingSetMB, sample.HeapAllocations, sample.Handles, sample.Threads, sample.FrameP99Millis,
+		pDroppedFrames ? pDroppedFrames->Value : 0);
+	if (mediaTime >= g_Soak.Duration) {
+		SetEvent(g_Soak.DurationReachedEvent);
+	}
+}
+
+static void __stdcall OnRecordingComplete(std::wstring path, nlohmann::fifo_map<std::wstring, int> frameDelays)
+{
+	g_Soak.IsSuccess = true;
+	SetEvent(g_Soak.FinishedEvent);
+}
+
+static void __stdcall OnRecordingFailed(std::wstring error, std::wstring path)
+{
+	g_Soak.IsSuccess = false;
+	g_Soak.Error = error;
+	SetEvent(g_Soak.FinishedEvent);
+}
+
+/// <summary>
+/// Fits a trend to every metric and writes a line per metric to stdout.
+/// </summary>
+/// <returns>True if any metric trends upward by more than its threshold.</returns>
+static bool ReportTrends(_In_ const std::vector<SOAK_SAMPLE> &samples)
+{
+	std::vector<double> hours;
+	for (const SOAK_SAMPLE &sample : samples) {
+		hours.push_back(sample.MediaHours);
+	}
+	bool hasRegression = false;
+	printf("%-18s %14s %14s %10s  %s\n", "metric", "baseline", "growth", "growth %", "result");
+	for (const SOAK_METRIC &metric : SoakMetrics) {
+		std::vector<double> values;
+		for (const SOAK_SAMPLE &sample : samples) {
+			values.push_back(sample.*metric.Value);
+		}
+		SOAK_TREND_RESULT trend = AnalyzeTrend(hours, values, metric.Threshold);
+		const char *result = !trend.IsEvaluated ? "too few samples" : trend.IsRegression ? "FAIL" : "ok";
+		double relativeGrowth = trend.Baseline != 0 ? 100.0 * trend.Growth / std::abs(trend.Baseline) : 0;
+		printf("%-18s %14.2f %14.2f %9.1f%%  %s\n", metric.Name, trend.Baseline, trend.Growth, relativeGrowth, result);
+		hasRegression |= trend.IsRegression;
+	}
+	return hasRegression;
+}
+
+static bool ParseArguments(_In_ int argc, _In_reads_(argc) char *argv[], _Out_ SOAK_OPTIONS *pOptions)
+{
+	*pOptions = SOAK_OPTIONS();
+	for (int i = 1; i < argc; i++) {
+		std::string argument = argv[i];
+		if (i + 1 >= argc) {
+			return false;
+		}
+		std::string value = argv[++i];
+		if (argument == "--hours") {
+			pOptions->Hours = atof(value.c_str());
+		}
+		else if (argument == "--sample-minutes") {
+			pOptions->SampleMinutes = atof(value.c_str());
+		}
+		else if (argument == "--fps") {
+			pOptions->Fps = static_cast<UINT32>(atoi(value.c_str()));
+		}
+		else if (argument == "--width") {
+			pOptions->Size.cx = atoi(value.c_str());
+		}
+		else if (argument == "--height") {
+			pOptions->Size.cy = atoi(value.c_str());
+		}
+		else if (argument == "--bitrate") {
+			pOptions->Bitrate = static_cast<UINT32>(atoi(value.c_str()));
+		}
+		else if (argument == "--audio") {
+			pOptions->IsAudioEnabled = atoi(value.c_str()) != 0;
+		}
+		else if (argument == "--out") {
+			pOptions->SamplesPath = value;
+		}
+		else if (argument == "--recording") {
+			pOptions->RecordingPath = value;
+		}
+		else {
+			return false;
+		}
+	}
+	return pOptions->Hours > 0 && pOptions->SampleMinutes > 0 && pOptions->Fps > 0 && pOptions->Size.cx > 0 && pOptions->Size.cy > 0;
+}
+
+int main(int argc, char *argv[])
+{
+	SOAK_OPTIONS options;
+	if (!ParseArguments(argc, argv, &options)) {
+		fprintf(stderr, "Usage: %s [--hours <media hours>] [--sample-minutes <media minutes>] [--fps <fps>] [--width <pixels>] [--height <pixels>] [--bitrate <bits per second>] [--audio <0|1>] [--out <samples.csv>] [--recording <path>]\n", argv[0]);
+		return 2;
+	}
+#if _DEBUG
+	fprintf(stderr, "Warning: this is a debug build, the debug heap and logging distort the memory and latency samples\n");
+#endif
+	std::wstring recordingPath = s2ws(options.RecordingPath);
+	bool isTemporaryRecording = recordingPath.empty();
+	if (isTemporaryRecording) {
+		wchar_t tempFolder[MAX_PATH];
+		if (GetTempPathW(MAX_PATH, tempFolder) == 0) {
+			fprintf(stderr, "Failed to get the temporary folder\n");
+			return 3;
+		}
+		recordingPath = string_format(L"%lsNativeSoak_%lu.mp4", tempFolder, GetCurrentProcessId());
+	}
+	if (!options.SamplesPath.empty()) {
+		g_Soak.SamplesStream.open(options.SamplesPath, std::ios_base::out | std::ios_base::trunc);
+		if (!g_Soak.SamplesStream.is_open()) {
+			fprintf(stderr, "Failed to open %s\n", options.SamplesPath.c_str());
+			return 2;
+		}
+		WriteSamplesHeader(g_Soak.SamplesStream);
+	}
+
+	g_Soak.Clock = std::make_shared<VirtualMediaClock>();
+	g_Soak.Duration = static_cast<INT64>(options.Hours * MEDIA_TIME_UNITS_PER_HOUR);
+	g_Soak.DurationReachedEvent = CreateEvent(nullptr, TRUE, FALSE, nullptr);
+	g_Soak.FinishedEvent = CreateEvent(nullptr, TRUE, FALSE, nullptr);
+	g_Soak.FrameLatency = std::make_unique<LatencyHistogram>();
+	g_Soak.Adapters = GetAdapters();
+	QueryPerformanceCounter(&g_Soak.StartTime);
+	{
+		RecordingManager recorder;
+		RECORDING_SOURCE source;
+		source.ID = L"SoakTestPattern";
+		source.Type = RecordingSourceType::TestPattern;
+		//Small changes every frame, like a desktop with a few windows updating
+		source.TestPattern.Mode = TestPatternMode::DirtyRects;
+		source.TestPattern.Size = options.Size;
+		source.TestPattern.FrameRate = options.Fps;
+		source.TestPattern.IsPointerEnabled = true;
+		recorder.SetRecordingSources({ source });
+
+		H264_ENCODER_OPTIONS *pEncoderOptions = new H264_ENCODER_OPTIONS();
+		pEncoderOptions->SetVideoFps(options.Fps);
+		pEncoderOptions->SetVideoBitrate(options.Bitrate);
+		pEncoderOptions->SetVideoBitrateMode(eAVEncCommonRateControlMode_CBR);
+		pEncoderOptions->SetFixedFramerate(true);
+		//A regular MP4 keeps the index of every sample in memory until the file is finalized, which would grow with the recording.
+		//Fragments are written with their own index, so the memory of the sink stays flat.
+		pEncoderOptions->SetFragmentedMp4Enabled(true);
+		pEncoderOptions->SetFastStartEnabled(false);
+		recorder.SetEncoderOptions(pEncoderOptions);
+		AUDIO_OPTIONS *pAudioOptions = new AUDIO_OPTIONS();
+		pAudioOptions->SetAudioEnabled(options.IsAudioEnabled);
+		pAudioOptions->SetTestSignal(AudioTestSignal::Tone);
+		recorder.SetAudioOptions(pAudioOptions);
+
+		recorder.SetMediaClock(g_Soak.Clock);
+		recorder.SetStatisticsInterval(std::chrono::milliseconds(static_cast<INT64>(options.SampleMinutes * 60 * 1000)));
+		recorder.RecordingStatisticsCallback = &OnStatistics;
+		recorder.RecordingFrameNumberChangedCallback = &OnFrameNumberChanged;
+		recorder.RecordingCompleteCallback = &OnRecordingComplete;
+		recorder.RecordingFailedCallback = &OnRecordingFailed;
+
+		fprintf(stderr, "Recording %.1f hours of %dx%d at %u fps in virtual time to %ls\n", options.Hours, options.Size.cx, options.Size.cy, options.Fps, recordingPath.c_str());
+		HRESULT hr = recorder.BeginRecording(recordingPath);
+		if (FAILED(hr)) {
+			fprintf(stderr, "Failed to start recording: hr = 0x%08x\n", hr);
+			return 3;
+		}
+		HANDLE events[] = { g_Soak.DurationReachedEvent, g_Soak.FinishedEvent };
+		if (WaitForMultipleObjects(ARRAYSIZE(events), events, FALSE, INFINITE) == WAIT_OBJECT_0) {
+			recorder.EndRecording();
+			WaitForSingleObject(g_Soak.FinishedEvent, INFINITE);
+		}
+	}
+	CloseHandle(g_Soak.DurationReachedEvent);
+	CloseHandle(g_Soak.FinishedEvent);
+	if (isTemporaryRecording) {
+		DeleteFileW(recordingPath.c_str());
+	}
+	if (!g_Soak.IsSuccess) {
+		fprintf(stderr, "Recording failed: %ls\n", g_Soak.Error.c_str());
+		return 3;
+	}
+	return ReportTrends(g_Soak.Samples) ? 1 : 0;
+}
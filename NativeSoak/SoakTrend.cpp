@@ -0,0 +1,62 @@
+#include "SoakTrend.h"
+#include <algorithm>
+#include <cmath>
+
+//Fewest samples after the warm-up a trend is fitted to
+#define SOAK_TREND_MIN_SAMPLES 3
+
+double Median(_In_ std::vector<double> values)
+{
+	if (values.empty()) {
+		return 0;
+	}
+	size_t middle = values.size() / 2;
+	std::nth_element(values.begin(), values.begin() + middle, values.end());
+	double median = values[middle];
+	if (values.size() % 2 == 0) {
+		double lower = *std::max_element(values.begin(), values.begin() + middle);
+		median = (lower + median) / 2;
+	}
+	return median;
+}
+
+double TheilSenSlope(_In_ const std::vector<double> &times, _In_ const std::vector<double> &values)
+{
+	size_t count = min(times.size(), values.size());
+	std::vector<double> slopes;
+	slopes.reserve(count * (count - 1) / 2);
+	for (size_t i = 0; i < count; i++) {
+		for (size_t j = i + 1; j < count; j++) {
+			double duration = times[j] - times[i];
+			if (duration != 0) {
+				slopes.push_back((values[j] - values[i]) / duration);
+			}
+		}
+	}
+	return Median(slopes);
+}
+
+SOAK_TREND_RESULT AnalyzeTrend(_In_ const std::vector<double> &times, _In_ const std::vector<double> &values, _In_ SOAK_TREND_THRESHOLD threshold)
+{
+	SOAK_TREND_RESULT result{};
+	size_t count = min(times.size(), values.size());
+	size_t warmupCount = static_cast<size_t>(count * max(0.0, min(threshold.WarmupFraction, 1.0)));
+	std::vector<double> trendTimes(times.begin() + warmupCount, times.begin() + count);
+	std::vector<double> trendValues(values.begin() + warmupCount, values.begin() + count);
+	result.SampleCount = trendTimes.size();
+	if (result.SampleCount < SOAK_TREND_MIN_SAMPLES) {
+		return result;
+	}
+	result.IsEvaluated = true;
+	result.Slope = TheilSenSlope(trendTimes, trendValues);
+	//The intercept is the median of the residuals, so it is as robust to outliers as the slope
+	std::vector<double> intercepts(trendTimes.size());
+	for (size_t i = 0; i < trendTimes.size(); i++) {
+		intercepts[i] = trendValues[i] - result.Slope * trendTimes[i];
+	}
+	result.Baseline = Median(intercepts) + result.Slope * trendTimes.front();
+	result.Growth = result.Slope * (trendTimes.back() - trendTimes.front());
+	result.IsRegression = result.Growth > threshold.MinAbsoluteGrowth
+		&& result.Growth > threshold.MaxRelativeGrowth * std::abs(result.Baseline);
+	return result;
+}
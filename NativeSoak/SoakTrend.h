@@ -0,0 +1,55 @@
+#pragma once
+#include <Windows.h>
+#include <string>
+#include <vector>
+
+struct SOAK_TREND_THRESHOLD {
+	// Growth over the run, as a fraction of the value at the start of the run, above which the metric fails
+	double MaxRelativeGrowth;
+	// Growth over the run below this amount never fails, so metrics with small or noisy values are not flagged
+	double MinAbsoluteGrowth;
+	// Fraction of the samples at the start of the run that are skipped, while caches and pools fill up
+	double WarmupFraction;
+	SOAK_TREND_THRESHOLD() :
+		MaxRelativeGrowth(0.1),
+		MinAbsoluteGrowth(0),
+		WarmupFraction(0.25)
+	{
+	}
+	SOAK_TREND_THRESHOLD(_In_ double maxRelativeGrowth, _In_ double minAbsoluteGrowth, _In_ double warmupFraction = 0.25) :
+		MaxRelativeGrowth(maxRelativeGrowth),
+		MinAbsoluteGrowth(minAbsoluteGrowth),
+		WarmupFraction(warmupFraction)
+	{
+	}
+};
+
+struct SOAK_TREND_RESULT {
+	// Number of samples the trend was fitted to, after the warm-up
+	size_t SampleCount;
+	// False if there were too few samples after the warm-up to fit a trend
+	bool IsEvaluated;
+	// Value of the fitted trend at the first sample after the warm-up
+	double Baseline;
+	// Change of the fitted trend per unit of time
+	double Slope;
+	// Change of the fitted trend from the first to the last sample after the warm-up
+	double Growth;
+	// True if the growth is above both thresholds
+	bool IsRegression;
+};
+
+/// <summary>
+/// Returns the median of the values, or 0 if there are none.
+/// </summary>
+double Median(_In_ std::vector<double> values);
+/// <summary>
+/// Returns the Theil-Sen estimate of the slope of the values over time, the median of the slopes between all pairs of samples.
+/// Unlike a least squares fit, a few outliers, like a latency spike from a background task, do not move the estimate.
+/// Pairs of samples at the same time are skipped.
+/// </summary>
+double TheilSenSlope(_In_ const std::vector<double> &times, _In_ const std::vector<double> &values);
+/// <summary>
+/// Fits a trend to the samples after the warm-up, and checks if the metric grew more than the threshold allows over the run.
+/// </summary>
+SOAK_TREND_RESULT AnalyzeTrend(_In_ const std::vector<double> &times, _In_ const std::vector<double> &values, _In_ SOAK_TREND_THRESHOLD threshold);
@@ -0,0 +1,74 @@
+#include "CppUnitTest.h"
+#include "AudioSamples.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace NativeTests
+{
+	static std::vector<BYTE> ToBytes(const std::vector<short> &samples)
+	{
+		std::vector<BYTE> bytes;
+		for (short sample : samples) {
+			bytes.push_back(static_cast<BYTE>(sample & 0xFF));
+			bytes.push_back(static_cast<BYTE>((sample >> 8) & 0xFF));
+		}
+		return bytes;
+	}
+
+	static std::vector<short> ToSamples(const std::vector<BYTE> &bytes)
+	{
+		std::vector<short> samples;
+		for (size_t i = 0; i + 1 < bytes.size(); i += 2) {
+			samples.push_back(static_cast<short>(bytes[i] | bytes[i + 1] << 8));
+		}
+		return samples;
+	}
+
+	TEST_CLASS(AudioSamplesTests)
+	{
+	public:
+		TEST_METHOD(TakesBytesFromTheFrontInOrder)
+		{
+			AudioSampleQueue queue;
+			const BYTE first[] = { 1, 2, 3, 4 };
+			const BYTE second[] = { 5, 6 };
+			queue.Append(first, sizeof(first));
+			queue.Append(second, sizeof(second));
+			Assert::AreEqual(static_cast<size_t>(6), queue.GetSize());
+
+			std::vector<BYTE> taken = queue.Take(3);
+			Assert::IsTrue(taken == std::vector<BYTE>({ 1, 2, 3 }));
+			Assert::AreEqual(static_cast<size_t>(3), queue.GetSize());
+			Assert::IsTrue(queue.Peek() == std::vector<BYTE>({ 4, 5, 6 }));
+
+			taken = queue.Take(10);
+			Assert::IsTrue(taken == std::vector<BYTE>({ 4, 5, 6 }));
+			Assert::AreEqual(static_cast<size_t>(0), queue.GetSize());
+			Assert::IsTrue(queue.Take(4).empty());
+		}
+
+		TEST_METHOD(PrependsSilence)
+		{
+			AudioSampleQueue queue;
+			const BYTE packet[] = { 7, 8 };
+			queue.Append(packet, sizeof(packet));
+			queue.PrependSilence(3);
+			Assert::IsTrue(queue.Peek() == std::vector<BYTE>({ 0, 0, 0, 7, 8 }));
+			queue.Clear();
+			Assert::AreEqual(static_cast<size_t>(0), queue.GetSize());
+		}
+
+		TEST_METHOD(MixesWithVolumesAndClips)
+		{
+			bool isClipped = true;
+			std::vector<BYTE> mixed = MixAudio(ToBytes({ 1000, -2000, 100 }), ToBytes({ 3000, 4000 }), 0.5f, 0.25f, &isClipped);
+			Assert::IsFalse(isClipped);
+			//The shorter buffer is padded with silence
+			Assert::IsTrue(ToSamples(mixed) == std::vector<short>({ 1250, 0, 50 }));
+
+			mixed = MixAudio(ToBytes({ 30000, -30000 }), ToBytes({ 30000, -30000 }), 1.0f, 1.0f, &isClipped);
+			Assert::IsTrue(isClipped);
+			Assert::IsTrue(ToSamples(mixed) == std::vector<short>({ MAXSHORT, -MAXSHORT }));
+		}
+	};
+}
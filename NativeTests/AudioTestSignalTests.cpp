@@ -0,0 +1,67 @@
+#include "CppUnitTest.h"
+#include "AudioTestSignal.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace NativeTests
+{
+	static std::vector<short> ToSamples(const std::vector<BYTE> &bytes)
+	{
+		std::vector<short> samples(bytes.size() / 2);
+		memcpy(samples.data(), bytes.data(), samples.size() * sizeof(short));
+		return samples;
+	}
+
+	static short GetPeak(const std::vector<short> &samples, size_t begin, size_t end)
+	{
+		short peak = 0;
+		for (size_t i = begin; i < end && i < samples.size(); i++) {
+			peak = max(peak, static_cast<short>(abs(samples[i])));
+		}
+		return peak;
+	}
+
+	TEST_CLASS(AudioTestSignalTests)
+	{
+	public:
+		TEST_METHOD(GeneratesTheRequestedDurationWithoutDrift)
+		{
+			AudioTestSignalGenerator generator(AudioTestSignal::Tone, 44100, 2);
+			size_t byteCount = 0;
+			//A third of a millisecond is not a whole number of samples
+			for (int i = 0; i < 3000; i++) {
+				byteCount += generator.Generate(3333).size();
+			}
+			byteCount += generator.Generate(1000).size();
+			Assert::AreEqual(static_cast<size_t>(44100 * 2 * 2), byteCount);
+			Assert::AreEqual(static_cast<UINT64>(44100), generator.GetGeneratedFrameCount());
+		}
+
+		TEST_METHOD(GeneratesTheSignals)
+		{
+			AudioTestSignalGenerator silence(AudioTestSignal::Silence, 48000, 2);
+			Assert::AreEqual(static_cast<short>(0), GetPeak(ToSamples(silence.Generate(10000000)), 0, 96000));
+
+			AudioTestSignalGenerator tone(AudioTestSignal::Tone, 48000, 2);
+			std::vector<short> toneSamples = ToSamples(tone.Generate(10000000));
+			Assert::AreEqual(static_cast<size_t>(96000), toneSamples.size());
+			Assert::AreEqual(static_cast<short>(8192), GetPeak(toneSamples, 0, toneSamples.size()));
+			//Both channels get the same tone
+			Assert::AreEqual(toneSamples[24], toneSamples[25]);
+
+			AudioTestSignalGenerator beeps(AudioTestSignal::Beeps, 48000, 1);
+			std::vector<short> beepSamples = ToSamples(beeps.Generate(10000000));
+			Assert::IsTrue(GetPeak(beepSamples, 0, 4800) > 8000);
+			Assert::AreEqual(static_cast<short>(0), GetPeak(beepSamples, 4800, 48000));
+		}
+
+		TEST_METHOD(RepeatsTheNoiseAfterReset)
+		{
+			AudioTestSignalGenerator noise(AudioTestSignal::Noise, 48000, 2);
+			std::vector<BYTE> first = noise.Generate(200000);
+			Assert::IsTrue(GetPeak(ToSamples(first), 0, first.size() / 2) > 0);
+			noise.Reset();
+			Assert::IsTrue(first == noise.Generate(200000));
+		}
+	};
+}
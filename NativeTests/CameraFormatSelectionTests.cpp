@@ -0,0 +1,99 @@
+#include "CppUnitTest.h"
+#include "CameraFormatSelection.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace NativeTests
+{
+	static CAMERA_FORMAT Format(DWORD index, CameraPixelFormat pixelFormat, UINT width, UINT height, double frameRate = 30)
+	{
+		return CAMERA_FORMAT{ index, pixelFormat, width, height, frameRate };
+	}
+
+	static CAMERA_FORMAT_TARGET Target(LONG width, LONG height, double frameRate = 30, double aspectRatio = 0)
+	{
+		CAMERA_FORMAT_TARGET target{};
+		target.Size = SIZE{ width, height };
+		target.FrameRate = frameRate;
+		target.AspectRatio = aspectRatio;
+		return target;
+	}
+
+	TEST_CLASS(CameraFormatSelectionTests)
+	{
+	public:
+		TEST_METHOD(SelectsTheSmallestFormatCoveringTheOutputSize)
+		{
+			std::vector<CAMERA_FORMAT> formats{
+				Format(0, CameraPixelFormat::MJPG, 1920, 1080),
+				Format(1, CameraPixelFormat::NV12, 1280, 720),
+				Format(2, CameraPixelFormat::NV12, 640, 360),
+				Format(3, CameraPixelFormat::NV12, 320, 180),
+			};
+			Assert::AreEqual(2, SelectCameraFormat(formats, Target(480, 270)));
+			Assert::AreEqual(1, SelectCameraFormat(formats, Target(1280, 720)));
+		}
+
+		TEST_METHOD(PrefersUncompressedFormatsOfTheSameSize)
+		{
+			std::vector<CAMERA_FORMAT> formats{
+				Format(0, CameraPixelFormat::MJPG, 1280, 720),
+				Format(1, CameraPixelFormat::YUY2, 1280, 720),
+				Format(2, CameraPixelFormat::NV12, 1280, 720),
+			};
+			Assert::AreEqual(2, SelectCameraFormat(formats, Target(1280, 720)));
+			formats.pop_back();
+			Assert::AreEqual(1, SelectCameraFormat(formats, Target(1280, 720)));
+			Assert::IsTrue(GetCameraFormatCost(formats[0]) > GetCameraFormatCost(formats[1]));
+		}
+
+		TEST_METHOD(AcceptsFrameRatesWithinTheTolerance)
+		{
+			std::vector<CAMERA_FORMAT> formats{
+				Format(0, CameraPixelFormat::NV12, 1280, 720, 60),
+				Format(1, CameraPixelFormat::NV12, 1280, 720, 29.97),
+				Format(2, CameraPixelFormat::NV12, 1280, 720, 15),
+			};
+			Assert::AreEqual(1, SelectCameraFormat(formats, Target(1280, 720)));
+			//A larger format at the full frame rate is better than one that drops frames
+			formats[0] = Format(0, CameraPixelFormat::NV12, 1920, 1080, 30);
+			formats[1] = Format(1, CameraPixelFormat::NV12, 1280, 720, 15);
+			Assert::AreEqual(0, SelectCameraFormat(formats, Target(1280, 720)));
+		}
+
+		TEST_METHOD(PrefersTheTargetAspectRatio)
+		{
+			std::vector<CAMERA_FORMAT> formats{
+				Format(0, CameraPixelFormat::NV12, 640, 480),
+				Format(1, CameraPixelFormat::NV12, 1280, 720),
+			};
+			Assert::AreEqual(0, SelectCameraFormat(formats, Target(640, 360)));
+			Assert::AreEqual(1, SelectCameraFormat(formats, Target(640, 360, 30, 16.0 / 9.0)));
+		}
+
+		TEST_METHOD(FallsBackToTheClosestFormat)
+		{
+			std::vector<CAMERA_FORMAT> formats{
+				Format(0, CameraPixelFormat::NV12, 320, 240),
+				Format(1, CameraPixelFormat::MJPG, 1280, 720, 15),
+				Format(2, CameraPixelFormat::NV12, 640, 480),
+			};
+			Assert::AreEqual(2, SelectCameraFormat(formats, Target(3840, 2160)));
+			formats.pop_back();
+			formats.erase(formats.begin());
+			Assert::AreEqual(0, SelectCameraFormat(formats, Target(3840, 2160)));
+			Assert::AreEqual(-1, SelectCameraFormat(std::vector<CAMERA_FORMAT>{}, Target(640, 480)));
+		}
+
+		TEST_METHOD(ZeroDimensionIsUnconstrained)
+		{
+			std::vector<CAMERA_FORMAT> formats{
+				Format(0, CameraPixelFormat::NV12, 1920, 1080),
+				Format(1, CameraPixelFormat::NV12, 1280, 720),
+				Format(2, CameraPixelFormat::NV12, 640, 360),
+			};
+			Assert::AreEqual(1, SelectCameraFormat(formats, Target(1000, 0)));
+			Assert::AreEqual(2, SelectCameraFormat(formats, Target(0, 0)));
+		}
+	};
+}
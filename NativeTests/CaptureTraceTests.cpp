@@ -0,0 +1,276 @@
+#include "CppUnitTest.h"
+#include "CaptureTrace.h"
+#include <sstream>
+#include <thread>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace NativeTests
+{
+	static const UINT TRACE_WIDTH = 200;
+	static const UINT TRACE_HEIGHT = 100;
+
+	//
+	// Writes a capture trace to a temporary file, and loads it for replay.
+	//
+	class TraceFile
+	{
+	public:
+		TraceFile(CAPTURE_TRACE_HEADER header)
+		{
+			wchar_t tempPath[MAX_PATH];
+			GetTempPathW(MAX_PATH, tempPath);
+			Path = std::wstring(tempPath) + L"CaptureTraceTests" + std::to_wstring(GetCurrentProcessId()) + CAPTURE_TRACE_FILE_EXTENSION;
+			Assert::AreEqual(S_OK, Writer.Open(Path, header));
+		}
+		~TraceFile()
+		{
+			Writer.Close();
+			DeleteFileW(Path.c_str());
+		}
+		void Load(CaptureTraceReplay &replay)
+		{
+			Assert::AreEqual(S_OK, Writer.Close());
+			Assert::AreEqual(S_OK, replay.Load(Path));
+		}
+
+		CaptureTraceWriter Writer;
+		std::wstring Path;
+	};
+
+	static CAPTURE_TRACE_HEADER GetHeader(UINT samplesPerSecond = 0, UINT channels = 0)
+	{
+		CAPTURE_TRACE_HEADER header{};
+		header.Width = TRACE_WIDTH;
+		header.Height = TRACE_HEIGHT;
+		header.AudioSamplesPerSecond = samplesPerSecond;
+		header.AudioChannels = channels;
+		header.AudioBitsPerSample = channels > 0 ? 16 : 0;
+		return header;
+	}
+
+	static void FillRect(std::vector<UINT> &frame, UINT pitch, RECT rect, UINT color)
+	{
+		for (LONG y = rect.top; y < rect.bottom; y++) {
+			for (LONG x = rect.left; x < rect.right; x++) {
+				frame[y * pitch + x] = color;
+			}
+		}
+	}
+
+	TEST_CLASS(CaptureTraceTests)
+	{
+	public:
+		TEST_METHOD(EncodesPixelRunsLosslessly)
+		{
+			std::vector<UINT> pixels{};
+			pixels.insert(pixels.end(), 100000, 0xFF000000);
+			for (UINT i = 0; i < 1000; i++) {
+				pixels.push_back(i * 2654435761u);
+			}
+			pixels.insert(pixels.end(), 3, 0xFFFFFFFF);
+			pixels.push_back(7);
+
+			std::vector<BYTE> encoded{};
+			EncodePixelRuns(pixels.data(), pixels.size(), &encoded);
+			//The long run of one color is stored as a few runs, not as pixels
+			Assert::IsTrue(encoded.size() < 1100 * sizeof(UINT));
+			std::vector<UINT> decoded{};
+			Assert::AreEqual(S_OK, DecodePixelRuns(encoded, pixels.size(), &decoded));
+			Assert::IsTrue(pixels == decoded);
+
+			//Truncated data and a wrong pixel count are rejected
+			encoded.pop_back();
+			Assert::AreEqual(E_INVALIDARG, DecodePixelRuns(encoded, pixels.size(), &decoded));
+			encoded.clear();
+			EncodePixelRuns(pixels.data(), pixels.size(), &encoded);
+			Assert::AreEqual(E_INVALIDARG, DecodePixelRuns(encoded, pixels.size() - 1, &decoded));
+		}
+
+		TEST_METHOD(FindsChangedTilesAndMergesNeighbours)
+		{
+			UINT pitch = TRACE_WIDTH + 8;
+			std::vector<UINT> previous(pitch * TRACE_HEIGHT, 0);
+			std::vector<UINT> current = previous;
+			Assert::AreEqual(static_cast<size_t>(0), FindChangedTiles(previous.data(), current.data(), TRACE_WIDTH, TRACE_HEIGHT, pitch, 64).size());
+
+			//Changes in the padding of the rows are not part of the frame
+			current[TRACE_WIDTH + 1] = 1;
+			Assert::AreEqual(static_cast<size_t>(0), FindChangedTiles(previous.data(), current.data(), TRACE_WIDTH, TRACE_HEIGHT, pitch, 64).size());
+
+			//Two neighbouring tiles on the first row, and the clipped tile in the bottom right corner
+			current[10] = 1;
+			current[70] = 1;
+			current[(TRACE_HEIGHT - 1) * pitch + TRACE_WIDTH - 1] = 1;
+			std::vector<RECT> rects = FindChangedTiles(previous.data(), current.data(), TRACE_WIDTH, TRACE_HEIGHT, pitch, 64);
+			Assert::AreEqual(static_cast<size_t>(2), rects.size());
+			Assert::IsTrue(rects[0].left == 0 && rects[0].top == 0 && rects[0].right == 128 && rects[0].bottom == 64);
+			Assert::IsTrue(rects[1].left == 192 && rects[1].top == 64 && rects[1].right == 200 && rects[1].bottom == 100);
+		}
+
+		TEST_METHOD(ReplaysTheRecordedFrames)
+		{
+			std::vector<std::vector<UINT>> frames{};
+			std::vector<UINT> frame(TRACE_WIDTH * TRACE_HEIGHT, 0xFF102030);
+			frames.push_back(frame);
+			FillRect(frame, TRACE_WIDTH, RECT{ 5,5,40,30 }, 0xFFFF0000);
+			frames.push_back(frame);
+			FillRect(frame, TRACE_WIDTH, RECT{ 150,60,200,100 }, 0xFF00FF00);
+			frame[1234] = 0xFF0000FF;
+			frames.push_back(frame);
+
+			TraceFile file(GetHeader());
+			Assert::AreEqual(S_OK, file.Writer.WriteFrame(0, frames[0].data(), TRACE_WIDTH, TRACE_HEIGHT, TRACE_WIDTH));
+			Assert::AreEqual(S_FALSE, file.Writer.WriteFrame(100000, frames[0].data(), TRACE_WIDTH, TRACE_HEIGHT, TRACE_WIDTH));
+			Assert::AreEqual(S_OK, file.Writer.WriteFrame(200000, frames[1].data(), TRACE_WIDTH, TRACE_HEIGHT, TRACE_WIDTH));
+			Assert::AreEqual(S_OK, file.Writer.WriteFrame(300000, frames[2].data(), TRACE_WIDTH, TRACE_HEIGHT, TRACE_WIDTH));
+			Assert::AreEqual(E_INVALIDARG, file.Writer.WriteFrame(400000, frames[2].data(), TRACE_WIDTH - 1, TRACE_HEIGHT, TRACE_WIDTH));
+			Assert::AreEqual(3LL, file.Writer.GetFrameRecordCount());
+
+			CaptureTraceReplay replay;
+			file.Load(replay);
+			Assert::AreEqual(TRACE_WIDTH, replay.GetHeader().Width);
+			Assert::AreEqual(TRACE_HEIGHT, replay.GetHeader().Height);
+			Assert::IsFalse(replay.HasAudio());
+			Assert::AreEqual(static_cast<size_t>(3), replay.GetFrames().size());
+			Assert::AreEqual(300000LL, replay.GetDuration());
+			Assert::AreEqual(static_cast<size_t>(1), replay.GetFrames()[1].DirtyRects.size());
+			std::vector<UINT> canvas{};
+			for (size_t i = 0; i < frames.size(); i++) {
+				Assert::AreEqual(S_OK, replay.ApplyFrame(i, &canvas));
+				Assert::IsTrue(frames[i] == canvas);
+			}
+
+			Assert::AreEqual(static_cast<size_t>(1), replay.GetFrameCountUntil(199999));
+			Assert::AreEqual(static_cast<size_t>(2), replay.GetFrameCountUntil(200000));
+			Assert::AreEqual(-1LL, replay.GetLastRecordTimeUntil(-1));
+			Assert::AreEqual(200000LL, replay.GetLastRecordTimeUntil(250000));
+			Assert::AreEqual(300000LL, replay.GetNextRecordTimeAfter(250000).value());
+			Assert::IsFalse(replay.GetNextRecordTimeAfter(300000).has_value());
+
+			CAPTURE_TRACE_HEADER header{};
+			Assert::AreEqual(S_OK, CaptureTraceReplay::ReadHeader(file.Path, &header));
+			Assert::AreEqual(TRACE_WIDTH, header.Width);
+		}
+
+		TEST_METHOD(KeepsTheRecordsBeforeATruncatedRecord)
+		{
+			std::vector<UINT> frame(TRACE_WIDTH * TRACE_HEIGHT, 0xFF000000);
+			TraceFile file(GetHeader());
+			Assert::AreEqual(S_OK, file.Writer.WriteFrame(0, frame.data(), TRACE_WIDTH, TRACE_HEIGHT, TRACE_WIDTH));
+			frame[0] = 0xFFFFFFFF;
+			Assert::AreEqual(S_OK, file.Writer.WriteFrame(100000, frame.data(), TRACE_WIDTH, TRACE_HEIGHT, TRACE_WIDTH));
+			Assert::AreEqual(S_OK, file.Writer.Close());
+
+			std::ifstream input(file.Path, std::ios_base::in | std::ios_base::binary);
+			std::string content((std::istreambuf_iterator<char>(input)), std::istreambuf_iterator<char>());
+			std::istringstream truncated(content.substr(0, content.size() - 3));
+			CaptureTraceReplay replay;
+			Assert::AreEqual(S_OK, replay.Load(truncated));
+			Assert::AreEqual(static_cast<size_t>(1), replay.GetFrames().size());
+
+			std::istringstream notATrace("RIFF0000WAVE");
+			Assert::AreEqual(E_INVALIDARG, replay.Load(notATrace));
+		}
+
+		TEST_METHOD(WritesPointerShapesOnlyWhenChanged)
+		{
+			DXGI_OUTDUPL_POINTER_SHAPE_INFO shapeInfo{};
+			shapeInfo.Type = DXGI_OUTDUPL_POINTER_SHAPE_TYPE_COLOR;
+			shapeInfo.Width = 4;
+			shapeInfo.Height = 4;
+			shapeInfo.Pitch = 16;
+			std::vector<BYTE> arrow(64, 0xFF);
+			std::vector<BYTE> hand(64, 0x80);
+
+			TraceFile file(GetHeader());
+			Assert::AreEqual(S_OK, file.Writer.WritePointer(0, POINT{ 10,10 }, true, shapeInfo, arrow.data(), static_cast<UINT>(arrow.size())));
+			Assert::AreEqual(S_FALSE, file.Writer.WritePointer(100, POINT{ 10,10 }, true, shapeInfo, arrow.data(), static_cast<UINT>(arrow.size())));
+			Assert::AreEqual(S_OK, file.Writer.WritePointer(200, POINT{ 20,15 }, true, shapeInfo, arrow.data(), static_cast<UINT>(arrow.size())));
+			Assert::AreEqual(S_OK, file.Writer.WritePointer(300, POINT{ 20,15 }, false, shapeInfo, arrow.data(), static_cast<UINT>(arrow.size())));
+			//The position of a hidden pointer does not matter
+			Assert::AreEqual(S_FALSE, file.Writer.WritePointer(400, POINT{ 50,50 }, false, shapeInfo, arrow.data(), static_cast<UINT>(arrow.size())));
+			Assert::AreEqual(S_OK, file.Writer.WritePointer(500, POINT{ 50,50 }, true, shapeInfo, hand.data(), static_cast<UINT>(hand.size())));
+			Assert::AreEqual(4LL, file.Writer.GetPointerRecordCount());
+
+			CaptureTraceReplay replay;
+			file.Load(replay);
+			const std::vector<CAPTURE_TRACE_POINTER> &pointers = replay.GetPointers();
+			Assert::AreEqual(static_cast<size_t>(4), pointers.size());
+			Assert::IsTrue(pointers[0].IsShapeUpdated);
+			Assert::IsFalse(pointers[1].IsShapeUpdated);
+			Assert::IsFalse(pointers[2].Visible);
+			Assert::IsTrue(pointers[3].IsShapeUpdated);
+			Assert::AreEqual(20, static_cast<int>(pointers[1].Position.x));
+			Assert::AreEqual(15, static_cast<int>(pointers[1].Position.y));
+			Assert::IsTrue(replay.GetPointerShape(2) == &pointers[0]);
+			Assert::IsTrue(replay.GetPointerShape(3) == &pointers[3]);
+			Assert::IsTrue(hand == replay.GetPointerShape(3)->ShapeBuffer);
+			Assert::AreEqual(16U, replay.GetPointerShape(1)->ShapeInfo.Pitch);
+			Assert::IsNull(replay.GetPointerShape(4));
+			Assert::AreEqual(static_cast<size_t>(3), replay.GetPointerCountUntil(300));
+		}
+
+		TEST_METHOD(ReadsTheAudioBackWithSilentGaps)
+		{
+			//1 kHz mono, so a sample frame is 10000 units of media time and 2 bytes
+			TraceFile file(GetHeader(1000, 1));
+			std::vector<BYTE> first(20, 0x11);
+			std::vector<BYTE> second(10, 0x22);
+			Assert::AreEqual(S_OK, file.Writer.WriteAudio(0, first));
+			Assert::AreEqual(S_OK, file.Writer.WriteAudio(100000, second));
+			Assert::AreEqual(2LL, file.Writer.GetAudioRecordCount());
+
+			CaptureTraceReplay replay;
+			file.Load(replay);
+			Assert::IsTrue(replay.HasAudio());
+			Assert::AreEqual(10ULL, replay.GetAudio()[1].StreamPosition);
+			Assert::AreEqual(150000LL, replay.GetDuration());
+
+			//Reads across the two packets, in durations that are not a whole number of sample frames
+			std::vector<BYTE> audio{};
+			for (int i = 0; i < 4; i++) {
+				std::vector<BYTE> bytes = replay.ReadAudio(33333);
+				audio.insert(audio.end(), bytes.begin(), bytes.end());
+			}
+			std::vector<BYTE> bytes = replay.ReadAudio(66668);
+			audio.insert(audio.end(), bytes.begin(), bytes.end());
+			Assert::AreEqual(static_cast<size_t>(40), audio.size());
+			for (size_t i = 0; i < audio.size(); i++) {
+				BYTE expected = i < 20 ? 0x11 : i < 30 ? 0x22 : 0;
+				Assert::AreEqual(expected, audio[i]);
+			}
+		}
+
+		TEST_METHOD(PresentsUntilTheRequestedTime)
+		{
+			std::vector<UINT> frame(TRACE_WIDTH * TRACE_HEIGHT, 0);
+			TraceFile file(GetHeader());
+			for (INT64 i = 0; i < 3; i++) {
+				frame[0] = static_cast<UINT>(i);
+				Assert::AreEqual(S_OK, file.Writer.WriteFrame(i * 100000, frame.data(), TRACE_WIDTH, TRACE_HEIGHT, TRACE_WIDTH));
+			}
+			CaptureTraceReplay replay;
+			file.Load(replay);
+
+			Assert::AreEqual(S_FALSE, replay.PresentUntil(0, 0));
+			Assert::IsTrue(replay.WaitForPresentRequest(-1, 0));
+			Assert::IsFalse(replay.WaitForPresentRequest(0, 0));
+
+			//A source presenting on another thread completes the request
+			std::thread source([&]() {
+				INT64 presentedTime = -1;
+				while (presentedTime < 200000) {
+					if (replay.WaitForPresentRequest(presentedTime, 1000)) {
+						presentedTime = replay.GetLastRecordTimeUntil(250000);
+						replay.SetPresented(presentedTime);
+					}
+				}
+			});
+			Assert::AreEqual(S_OK, replay.PresentUntil(250000, 5000));
+			source.join();
+			//Records that were presented already do not have to be waited for
+			Assert::AreEqual(S_OK, replay.PresentUntil(100000, 0));
+		}
+	};
+}
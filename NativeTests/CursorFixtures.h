@@ -0,0 +1,245 @@
+#pragma once
+#include <Windows.h>
+#include <string>
+#include <vector>
+#include <cstring>
+
+//
+// Pointer shape fixtures for the rasterizer tests, transcribed from the classic Windows system cursors.
+// Each pixel is one character:
+//   '.' transparent, '#' black, 'o' white, 'x' inverts the background.
+// Masked color fixtures additionally use:
+//   'r' opaque red, 's' XORs the background with mid gray.
+// Shapes are padded with transparent pixels to the fixture size, and can be scaled up to the sizes used on high DPI displays.
+//
+namespace CursorFixtures {
+	struct CURSOR_FIXTURE {
+		const wchar_t *Name;
+		bool IsMonochrome;
+		UINT Width;
+		UINT Height;
+		std::vector<const char *> Rows;
+	};
+
+	struct CURSOR_SHAPE {
+		std::wstring Name;
+		bool IsMonochrome;
+		UINT Width;
+		// Height of the pointer. The monochrome shape buffer holds twice as many rows.
+		UINT Height;
+		UINT Pitch;
+		std::vector<BYTE> Buffer;
+	};
+
+	inline std::vector<CURSOR_FIXTURE> GetFixtures()
+	{
+		return {
+			{ L"Arrow", true, 32, 32, {
+				"#...........",
+				"##..........",
+				"#o#.........",
+				"#oo#........",
+				"#ooo#.......",
+				"#oooo#......",
+				"#ooooo#.....",
+				"#oooooo#....",
+				"#ooooooo#...",
+				"#oooooooo#..",
+				"#ooooo#####.",
+				"#oo#oo#.....",
+				"#o#.#oo#....",
+				"##..#oo#....",
+				"#....#oo#...",
+				".....#oo#...",
+				"......#oo#..",
+				"......#oo#..",
+				".......##...",
+			} },
+			{ L"IBeam", true, 32, 32, {
+				"........................",
+				"........xxx.xxx.........",
+				"...........x............",
+				"...........x............",
+				"...........x............",
+				"...........x............",
+				"...........x............",
+				"...........x............",
+				"...........x............",
+				"...........x............",
+				"...........x............",
+				"...........x............",
+				"...........x............",
+				"...........x............",
+				"...........x............",
+				"...........x............",
+				"...........x............",
+				"........xxx.xxx.........",
+			} },
+			{ L"Cross", true, 32, 32, {
+				"...............................",
+				"...............x...............",
+				"...............x...............",
+				"...............x...............",
+				"...............x...............",
+				"...............x...............",
+				"...............x...............",
+				"...............x...............",
+				"...............x...............",
+				"...............x...............",
+				"...............x...............",
+				"...............x...............",
+				"...............x...............",
+				"...............x...............",
+				"...............................",
+				".xxxxxxxxxxxxx...xxxxxxxxxxxxx.",
+				"...............................",
+				"...............x...............",
+				"...............x...............",
+				"...............x...............",
+				"...............x...............",
+				"...............x...............",
+				"...............x...............",
+				"...............x...............",
+				"...............x...............",
+				"...............x...............",
+				"...............x...............",
+				"...............x...............",
+				"...............x...............",
+				"...............x...............",
+			} },
+			{ L"SizeNWSE", true, 32, 32, {
+				"..........................",
+				".#########................",
+				".#ooooooo#................",
+				".#oooooo#.................",
+				".#ooooo#..................",
+				".#oooooo#.................",
+				".#oo#oooo#................",
+				".#o#.#oooo#...............",
+				".##...#oooo#..............",
+				".#.....#oooo#.............",
+				"........#oooo#.....#......",
+				".........#oooo#...##......",
+				"..........#oooo#.#o#......",
+				"...........#oooo#oo#......",
+				"............#oooooo#......",
+				".............#ooooo#......",
+				"............#oooooo#......",
+				"...........#ooooooo#......",
+				"...........#########......",
+			} },
+			{ L"IBeamMasked", false, 32, 32, {
+				"........................",
+				"........###.###.........",
+				"........#oo#oo#.........",
+				"...........x............",
+				"...........x............",
+				"...........x............",
+				"...........x............",
+				"...........x............",
+				"...........x............",
+				"...........x............",
+				"...........x............",
+				"...........x............",
+				"...........x............",
+				"...........x............",
+				"...........x............",
+				"........#oo#oo#.........",
+				"........###.###.........",
+			} },
+			{ L"ArrowMasked", false, 32, 32, {
+				"#...........",
+				"##..........",
+				"#r#.........",
+				"#rr#........",
+				"#rrr#.......",
+				"#rrrr#......",
+				"#rrrrr#.....",
+				"#rrrrrr#....",
+				"#rrrrrrr#...",
+				"#rrrrrrrr#..",
+				"#rrrrr#####s",
+				"#rr#rr#sssss",
+				"#r#s#rr#ss..",
+				"##ss#rr#s...",
+				"#sss.#rr#s..",
+				".....#rr#s..",
+				"......#rr#s.",
+				"......#rr#s.",
+				".......##ss.",
+			} },
+		};
+	}
+
+	inline UINT GetMonochromeBits(char pixel)
+	{
+		// AND mask bit in bit 1, XOR mask bit in bit 0
+		switch (pixel) {
+			case '#': return 0x0;
+			case 'o': return 0x1;
+			case 'x': return 0x3;
+			default: return 0x2;
+		}
+	}
+
+	inline UINT GetMaskedColorPixel(char pixel)
+	{
+		switch (pixel) {
+			case '#': return 0x00000000;
+			case 'o': return 0x00FFFFFF;
+			case 'x': return 0xFFFFFFFF;
+			case 'r': return 0x00FF0000;
+			case 's': return 0xFF808080;
+			default: return 0xFF000000;
+		}
+	}
+
+	inline char GetFixturePixel(const CURSOR_FIXTURE &fixture, UINT x, UINT y)
+	{
+		if (y >= fixture.Rows.size()) {
+			return '.';
+		}
+		const char *row = fixture.Rows[y];
+		return x < strlen(row) ? row[x] : '.';
+	}
+
+	/// <summary>
+	/// Builds the shape buffer for a fixture the way IDXGIOutputDuplication::GetFramePointerShape returns it, scaled up by an integer factor.
+	/// </summary>
+	inline CURSOR_SHAPE BuildShape(const CURSOR_FIXTURE &fixture, UINT scale)
+	{
+		CURSOR_SHAPE shape{};
+		shape.Name = std::wstring(fixture.Name) + L" x" + std::to_wstring(scale);
+		shape.IsMonochrome = fixture.IsMonochrome;
+		shape.Width = fixture.Width * scale;
+		shape.Height = fixture.Height * scale;
+		if (fixture.IsMonochrome) {
+			// One bit per pixel, rows padded to whole 32 bit words
+			shape.Pitch = ((shape.Width + 31) / 32) * 4;
+			shape.Buffer.resize(shape.Pitch * shape.Height * 2);
+			for (UINT y = 0; y < shape.Height; y++) {
+				for (UINT x = 0; x < shape.Width; x++) {
+					UINT bits = GetMonochromeBits(GetFixturePixel(fixture, x / scale, y / scale));
+					BYTE mask = 0x80 >> (x % 8);
+					if (bits & 0x2) {
+						shape.Buffer[y * shape.Pitch + x / 8] |= mask;
+					}
+					if (bits & 0x1) {
+						shape.Buffer[(y + shape.Height) * shape.Pitch + x / 8] |= mask;
+					}
+				}
+			}
+		}
+		else {
+			shape.Pitch = shape.Width * 4;
+			shape.Buffer.resize(shape.Pitch * shape.Height);
+			UINT *pPixels = reinterpret_cast<UINT *>(shape.Buffer.data());
+			for (UINT y = 0; y < shape.Height; y++) {
+				for (UINT x = 0; x < shape.Width; x++) {
+					pPixels[y * shape.Width + x] = GetMaskedColorPixel(GetFixturePixel(fixture, x / scale, y / scale));
+				}
+			}
+		}
+		return shape;
+	}
+}
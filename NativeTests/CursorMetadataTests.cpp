@@ -0,0 +1,344 @@
+#include "CppUnitTest.h"
+#include "CursorMetadata.h"
+#include "CursorRasterizer.h"
+#include "CursorFixtures.h"
+#include <sstream>
+#include <thread>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace CursorFixtures;
+
+namespace NativeTests
+{
+	static const UINT FRAME_COLOR = 0xFF336699;
+
+	//
+	// Writes cursor metadata to a temporary file with a clock that is advanced by the test.
+	//
+	class MetadataFile
+	{
+	public:
+		MetadataFile() :
+			Time(0),
+			Writer([this](INT64 *pTime) { *pTime = Time; return S_OK; })
+		{
+			wchar_t tempPath[MAX_PATH];
+			GetTempPathW(MAX_PATH, tempPath);
+			Path = std::wstring(tempPath) + L"CursorMetadataTests" + std::to_wstring(GetCurrentProcessId()) + CURSOR_METADATA_FILE_EXTENSION;
+			Assert::AreEqual(S_OK, Writer.Open(Path));
+		}
+		~MetadataFile()
+		{
+			Writer.Close();
+			DeleteFileW(Path.c_str());
+		}
+		void Load(CursorCompositor &compositor)
+		{
+			Assert::AreEqual(S_OK, Writer.Close());
+			Assert::AreEqual(S_OK, compositor.Load(Path));
+		}
+
+		INT64 Time;
+		CursorMetadataWriter Writer;
+		std::wstring Path;
+	};
+
+	static DXGI_OUTDUPL_POINTER_SHAPE_INFO GetShapeInfo(const CURSOR_SHAPE &shape, LONG hotSpotX, LONG hotSpotY)
+	{
+		DXGI_OUTDUPL_POINTER_SHAPE_INFO info{};
+		info.Type = shape.IsMonochrome ? DXGI_OUTDUPL_POINTER_SHAPE_TYPE_MONOCHROME : DXGI_OUTDUPL_POINTER_SHAPE_TYPE_MASKED_COLOR;
+		info.Width = shape.Width;
+		info.Height = shape.IsMonochrome ? shape.Height * 2 : shape.Height;
+		info.Pitch = shape.Pitch;
+		info.HotSpot = POINT{ hotSpotX, hotSpotY };
+		return info;
+	}
+
+	static CURSOR_SHAPE BuildFixtureShape(const wchar_t *name, UINT scale)
+	{
+		for (const CURSOR_FIXTURE &fixture : GetFixtures()) {
+			if (wcscmp(fixture.Name, name) == 0) {
+				return BuildShape(fixture, scale);
+			}
+		}
+		Assert::Fail(L"Missing fixture");
+		return CURSOR_SHAPE{};
+	}
+
+	static CURSOR_METADATA_POINTER MakePointer(LONG left, LONG top, bool visible = true, float scale = 1.0f)
+	{
+		CURSOR_METADATA_POINTER pointer{};
+		pointer.Left = left;
+		pointer.Top = top;
+		pointer.Visible = visible;
+		pointer.ScaleX = scale;
+		pointer.ScaleY = scale;
+		return pointer;
+	}
+
+	static CURSOR_METADATA_LAYOUT MakeLayout(LONG width, LONG height, double scale, double offsetX, double offsetY)
+	{
+		CURSOR_METADATA_LAYOUT layout{};
+		layout.OutputWidth = width;
+		layout.OutputHeight = height;
+		layout.ScaleX = scale;
+		layout.ScaleY = scale;
+		layout.OffsetX = offsetX;
+		layout.OffsetY = offsetY;
+		return layout;
+	}
+
+	TEST_CLASS(CursorMetadataTests)
+	{
+	public:
+		TEST_METHOD(UnchangedPointerIsNotWrittenAgain)
+		{
+			MetadataFile file;
+			CURSOR_SHAPE arrow = BuildFixtureShape(L"Arrow", 1);
+			CURSOR_SHAPE ibeam = BuildFixtureShape(L"IBeam", 1);
+			DXGI_OUTDUPL_POINTER_SHAPE_INFO arrowInfo = GetShapeInfo(arrow, 0, 0);
+			DXGI_OUTDUPL_POINTER_SHAPE_INFO ibeamInfo = GetShapeInfo(ibeam, 4, 8);
+
+			Assert::AreEqual(S_OK, file.Writer.WritePointer(MakePointer(10, 10), arrowInfo, arrow.Buffer.data(), static_cast<UINT>(arrow.Buffer.size()), false));
+			file.Time += 10;
+			Assert::AreEqual(S_FALSE, file.Writer.WritePointer(MakePointer(10, 10), arrowInfo, arrow.Buffer.data(), static_cast<UINT>(arrow.Buffer.size()), false));
+			Assert::AreEqual(S_OK, file.Writer.WritePointer(MakePointer(11, 10), arrowInfo, arrow.Buffer.data(), static_cast<UINT>(arrow.Buffer.size()), false));
+			Assert::AreEqual(S_OK, file.Writer.WritePointer(MakePointer(11, 10), ibeamInfo, ibeam.Buffer.data(), static_cast<UINT>(ibeam.Buffer.size()), true));
+			//Returning to a shape that was already written only adds a pointer record.
+			Assert::AreEqual(S_OK, file.Writer.WritePointer(MakePointer(11, 10), arrowInfo, arrow.Buffer.data(), static_cast<UINT>(arrow.Buffer.size()), true));
+			Assert::AreEqual(S_OK, file.Writer.WritePointer(MakePointer(20, 20, false), arrowInfo, arrow.Buffer.data(), static_cast<UINT>(arrow.Buffer.size()), false));
+			//A hidden pointer that moves does not change the video.
+			Assert::AreEqual(S_FALSE, file.Writer.WritePointer(MakePointer(30, 30, false), arrowInfo, arrow.Buffer.data(), static_cast<UINT>(arrow.Buffer.size()), false));
+
+			Assert::AreEqual(static_cast<INT64>(5), file.Writer.GetPointerRecordCount());
+			Assert::AreEqual(static_cast<INT64>(2), file.Writer.GetSkippedPointerRecordCount());
+			Assert::AreEqual(static_cast<size_t>(2), file.Writer.GetShapeCount());
+		}
+
+		TEST_METHOD(ShapeIsOnlyHashedWhenUpdated)
+		{
+			MetadataFile file;
+			CURSOR_SHAPE arrow = BuildFixtureShape(L"Arrow", 1);
+			CURSOR_SHAPE ibeam = BuildFixtureShape(L"IBeam", 1);
+			DXGI_OUTDUPL_POINTER_SHAPE_INFO arrowInfo = GetShapeInfo(arrow, 0, 0);
+			DXGI_OUTDUPL_POINTER_SHAPE_INFO ibeamInfo = GetShapeInfo(ibeam, 4, 8);
+
+			//The first pointer state is always hashed.
+			Assert::AreEqual(S_OK, file.Writer.WritePointer(MakePointer(10, 10), arrowInfo, arrow.Buffer.data(), static_cast<UINT>(arrow.Buffer.size()), false));
+			//A shape that is not reported as updated keeps the hash of the previous shape.
+			Assert::AreEqual(S_FALSE, file.Writer.WritePointer(MakePointer(10, 10), ibeamInfo, ibeam.Buffer.data(), static_cast<UINT>(ibeam.Buffer.size()), false));
+			Assert::AreEqual(S_OK, file.Writer.WritePointer(MakePointer(10, 10), ibeamInfo, ibeam.Buffer.data(), static_cast<UINT>(ibeam.Buffer.size()), true));
+			Assert::AreEqual(static_cast<size_t>(2), file.Writer.GetShapeCount());
+
+			CursorCompositor compositor;
+			file.Load(compositor);
+			Assert::AreEqual(static_cast<size_t>(2), compositor.GetPointers().size());
+			Assert::AreEqual(GetCursorShapeHash(arrowInfo, arrow.Buffer.data(), static_cast<UINT>(arrow.Buffer.size())), compositor.GetPointers()[0].ShapeHash);
+			Assert::AreEqual(GetCursorShapeHash(ibeamInfo, ibeam.Buffer.data(), static_cast<UINT>(ibeam.Buffer.size())), compositor.GetPointers()[1].ShapeHash);
+		}
+
+		TEST_METHOD(RecordsFromSeveralThreadsAreWritten)
+		{
+			MetadataFile file;
+			CURSOR_SHAPE arrow = BuildFixtureShape(L"Arrow", 1);
+			DXGI_OUTDUPL_POINTER_SHAPE_INFO arrowInfo = GetShapeInfo(arrow, 0, 0);
+			//Clicks are written from the mouse click detection thread while the pointer is written from the capture thread.
+			int queuedClickCount = 0;
+			std::thread clickThread([&]() {
+				for (int i = 0; i < 100; i++) {
+					if (file.Writer.WriteClick(VK_LBUTTON) == S_OK) {
+						queuedClickCount++;
+					}
+				}
+				});
+			for (LONG i = 0; i < 100; i++) {
+				Assert::AreEqual(S_OK, file.Writer.WritePointer(MakePointer(i, 10), arrowInfo, arrow.Buffer.data(), static_cast<UINT>(arrow.Buffer.size()), i == 0));
+			}
+			clickThread.join();
+			Assert::AreEqual(100, queuedClickCount);
+
+			CursorCompositor compositor;
+			file.Load(compositor);
+			Assert::AreEqual(static_cast<size_t>(100), compositor.GetPointers().size());
+			Assert::AreEqual(static_cast<size_t>(100), compositor.GetClicks().size());
+			Assert::AreEqual(static_cast<size_t>(1), compositor.GetShapes().size());
+			Assert::AreEqual(static_cast<INT64>(0), file.Writer.GetDroppedRecordCount());
+		}
+
+		TEST_METHOD(RecordsAreReadBack)
+		{
+			MetadataFile file;
+			CURSOR_SHAPE shape = BuildFixtureShape(L"ArrowMasked", 2);
+			DXGI_OUTDUPL_POINTER_SHAPE_INFO info = GetShapeInfo(shape, 1, 2);
+
+			Assert::AreEqual(S_OK, file.Writer.WriteLayout(MakeLayout(1280, 720, 0.5, 8, -4)));
+			file.Time = 100;
+			Assert::AreEqual(S_OK, file.Writer.WritePointer(MakePointer(40, 50, true, 1.5f), info, shape.Buffer.data(), static_cast<UINT>(shape.Buffer.size()), false));
+			file.Time = 200;
+			Assert::AreEqual(S_OK, file.Writer.WriteClick(VK_RBUTTON));
+			file.Time = 300;
+			Assert::AreEqual(S_OK, file.Writer.WritePointer(MakePointer(-5, 60, true, 1.5f), info, shape.Buffer.data(), static_cast<UINT>(shape.Buffer.size()), false));
+
+			CursorCompositor compositor;
+			file.Load(compositor);
+			Assert::AreEqual(static_cast<size_t>(1), compositor.GetLayouts().size());
+			Assert::AreEqual(0.5, compositor.GetLayouts()[0].ScaleX);
+			Assert::AreEqual(-4.0, compositor.GetLayouts()[0].OffsetY);
+			Assert::AreEqual(static_cast<size_t>(2), compositor.GetPointers().size());
+			Assert::AreEqual(static_cast<size_t>(1), compositor.GetClicks().size());
+			Assert::AreEqual(static_cast<UINT>(VK_RBUTTON), compositor.GetClicks()[0].Button);
+			Assert::AreEqual(static_cast<INT64>(200), compositor.GetClicks()[0].TimeStamp);
+
+			Assert::AreEqual(static_cast<size_t>(1), compositor.GetShapes().size());
+			const CURSOR_METADATA_SHAPE &readShape = compositor.GetShapes().begin()->second;
+			Assert::AreEqual(GetCursorShapeHash(info, shape.Buffer.data(), static_cast<UINT>(shape.Buffer.size())), readShape.Hash);
+			Assert::IsTrue(readShape.Buffer == shape.Buffer);
+			Assert::AreEqual(static_cast<LONG>(2), readShape.ShapeInfo.HotSpot.y);
+
+			CURSOR_METADATA_POINTER pointer;
+			Assert::IsFalse(compositor.GetPointerAt(99, &pointer));
+			Assert::IsTrue(compositor.GetPointerAt(299, &pointer));
+			Assert::AreEqual(static_cast<LONG>(40), pointer.Left);
+			Assert::AreEqual(1.5f, pointer.ScaleY);
+			Assert::AreEqual(readShape.Hash, pointer.ShapeHash);
+			Assert::IsTrue(compositor.GetPointerAt(1000, &pointer));
+			Assert::AreEqual(static_cast<LONG>(-5), pointer.Left);
+		}
+
+		TEST_METHOD(MalformedFileIsRejected)
+		{
+			CursorCompositor compositor;
+			std::istringstream wrongHeader("Some other file\npointer 0 1 2 1 0 1 1\n");
+			Assert::AreEqual(E_FAIL, compositor.Load(wrongHeader));
+
+			std::istringstream badRecords(std::string(CURSOR_METADATA_HEADER) + "\r\npointer 0 1\nshape 12 2 2 1 8 0 0 00ff\nfuture 1 2 3\npointer 5 1 2 1 0 1 1\n");
+			Assert::AreEqual(S_OK, compositor.Load(badRecords));
+			Assert::AreEqual(static_cast<size_t>(1), compositor.GetPointers().size());
+			Assert::AreEqual(static_cast<size_t>(0), compositor.GetShapes().size());
+		}
+
+		//
+		// A pointer drawn by the compositor must look the same as the pointer rasterized at its final size and drawn on the frame,
+		// including when the layout scales the canvas and the pointer is partially outside the frame.
+		//
+		TEST_METHOD(ComposedPointerMatchesRasterizer)
+		{
+			for (const wchar_t *name : { L"Arrow", L"IBeam", L"ArrowMasked", L"IBeamMasked" }) {
+				for (LONG left : { 20L, -3L }) {
+					MetadataFile file;
+					CURSOR_SHAPE shape = BuildFixtureShape(name, 1);
+					CURSOR_SHAPE expectedShape = BuildFixtureShape(name, 2);
+					DXGI_OUTDUPL_POINTER_SHAPE_INFO info = GetShapeInfo(shape, 0, 0);
+					//Canvas to frame: x * 2 - 10
+					file.Writer.WriteLayout(MakeLayout(96, 80, 2.0, -10, -10));
+					file.Writer.WritePointer(MakePointer(left, 10), info, shape.Buffer.data(), static_cast<UINT>(shape.Buffer.size()), false);
+					CursorCompositor compositor;
+					file.Load(compositor);
+
+					const UINT width = 96, height = 80, pitch = 100;
+					std::vector<UINT> frame(pitch * height, FRAME_COLOR);
+					Assert::AreEqual(S_OK, compositor.ComposeFrame(0, frame.data(), width, height, pitch));
+
+					LONG destLeft = left * 2 - 10;
+					LONG destTop = 10;
+					UINT skipX = destLeft < 0 ? -destLeft : 0;
+					CURSOR_RASTER_DESC desc{};
+					desc.pShape = expectedShape.Buffer.data();
+					desc.ShapePitch = expectedShape.Pitch;
+					desc.MaskHeight = expectedShape.Height;
+					desc.SkipX = skipX;
+					desc.Width = static_cast<INT>(expectedShape.Width - skipX);
+					desc.Height = static_cast<INT>(expectedShape.Height);
+					std::vector<UINT> background(desc.Width, FRAME_COLOR);
+					desc.pBackground = background.data();
+					desc.BackgroundPitchInPixels = 0;
+					std::vector<UINT> expected(static_cast<size_t>(desc.Width) * desc.Height);
+					if (expectedShape.IsMonochrome) {
+						RasterizeMonochromeCursorScalar(desc, expected.data());
+					}
+					else {
+						RasterizeMaskedColorCursorScalar(desc, expected.data());
+					}
+
+					for (UINT y = 0; y < height; y++) {
+						for (UINT x = 0; x < width; x++) {
+							UINT expectedPixel = FRAME_COLOR;
+							LONG shapeX = static_cast<LONG>(x) - destLeft - static_cast<LONG>(skipX);
+							LONG shapeY = static_cast<LONG>(y) - destTop;
+							if (static_cast<LONG>(x) >= destLeft + static_cast<LONG>(skipX) && shapeX < desc.Width && shapeY >= 0 && shapeY < desc.Height) {
+								UINT rasterized = expected[shapeY * desc.Width + shapeX];
+								if (rasterized >> 24) {
+									expectedPixel = rasterized;
+								}
+							}
+							if (frame[y * pitch + x] != expectedPixel) {
+								wchar_t message[256];
+								swprintf_s(message, L"%ls at %d: pixel (%u,%u) is 0x%08X, expected 0x%08X", name, left, x, y, frame[y * pitch + x], expectedPixel);
+								Assert::Fail(message);
+							}
+						}
+						//Padding after each row must be left alone.
+						for (UINT x = width; x < pitch; x++) {
+							Assert::AreEqual(FRAME_COLOR, frame[y * pitch + x]);
+						}
+					}
+				}
+			}
+		}
+
+		TEST_METHOD(ColorPointerIsBlended)
+		{
+			MetadataFile file;
+			//2x1 color pointer: opaque red, then half transparent white
+			std::vector<UINT> pixels = { 0xFFFF0000, 0x80FFFFFF };
+			DXGI_OUTDUPL_POINTER_SHAPE_INFO info{};
+			info.Type = DXGI_OUTDUPL_POINTER_SHAPE_TYPE_COLOR;
+			info.Width = 2;
+			info.Height = 1;
+			info.Pitch = 8;
+			file.Writer.WritePointer(MakePointer(3, 4), info, reinterpret_cast<const BYTE *>(pixels.data()), 8, false);
+			file.Time = 10;
+			file.Writer.WritePointer(MakePointer(3, 4, false), info, reinterpret_cast<const BYTE *>(pixels.data()), 8, false);
+			CursorCompositor compositor;
+			file.Load(compositor);
+
+			std::vector<UINT> frame(8 * 8, 0xFF000000);
+			Assert::AreEqual(S_OK, compositor.ComposeFrame(5, frame.data(), 8, 8, 8));
+			Assert::AreEqual(0xFFFF0000, frame[4 * 8 + 3]);
+			Assert::AreEqual(0xFF808080, frame[4 * 8 + 4]);
+			Assert::AreEqual(0xFF000000, frame[4 * 8 + 5]);
+
+			std::vector<UINT> hiddenFrame(8 * 8, 0xFF000000);
+			Assert::AreEqual(S_FALSE, compositor.ComposeFrame(10, hiddenFrame.data(), 8, 8, 8));
+			Assert::IsTrue(hiddenFrame == std::vector<UINT>(8 * 8, 0xFF000000));
+		}
+
+		TEST_METHOD(ClickIsDrawnForItsDuration)
+		{
+			MetadataFile file;
+			CURSOR_SHAPE shape = BuildFixtureShape(L"Cross", 1);
+			DXGI_OUTDUPL_POINTER_SHAPE_INFO info = GetShapeInfo(shape, 16, 16);
+			file.Writer.WritePointer(MakePointer(10, 10), info, shape.Buffer.data(), static_cast<UINT>(shape.Buffer.size()), false);
+			//The pointer is hidden before the click, so only the click is drawn.
+			file.Time = 1;
+			file.Writer.WritePointer(MakePointer(10, 10, false), info, shape.Buffer.data(), static_cast<UINT>(shape.Buffer.size()), false);
+			file.Time = 1000;
+			file.Writer.WriteClick(VK_LBUTTON);
+			CursorCompositor compositor;
+			file.Load(compositor);
+			compositor.SetClickStyle(500, 0x0000FF, 0xFF0000, 4);
+
+			std::vector<UINT> frame(64 * 64, 0xFF000000);
+			Assert::AreEqual(S_FALSE, compositor.ComposeFrame(999, frame.data(), 64, 64, 64));
+			Assert::AreEqual(S_OK, compositor.ComposeFrame(1499, frame.data(), 64, 64, 64));
+			//Centered on the hotspot at (26,26), blue at 70% opacity
+			Assert::AreEqual(0xFF0000B3, frame[26 * 64 + 26]);
+			Assert::AreEqual(0xFF0000B3, frame[26 * 64 + 23]);
+			Assert::AreEqual(0xFF000000, frame[26 * 64 + 31]);
+			Assert::AreEqual(0xFF000000, frame[21 * 64 + 26]);
+
+			std::vector<UINT> laterFrame(64 * 64, 0xFF000000);
+			Assert::AreEqual(S_FALSE, compositor.ComposeFrame(1500, laterFrame.data(), 64, 64, 64));
+		}
+	};
+}
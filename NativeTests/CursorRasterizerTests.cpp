@@ -0,0 +1,209 @@
+#include "CppUnitTest.h"
+#include "CursorRasterizer.h"
+#include "CursorFixtures.h"
+#include <random>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace CursorFixtures;
+
+namespace NativeTests
+{
+	static const UINT BACKGROUND_COLOR = 0xFF336699;
+
+	static void RasterizeBothWays(const CURSOR_SHAPE &shape, const CURSOR_RASTER_DESC &desc, std::vector<UINT> &vectorized, std::vector<UINT> &scalar)
+	{
+		vectorized.assign(static_cast<size_t>(desc.Width) * desc.Height, 0xCDCDCDCD);
+		scalar.assign(static_cast<size_t>(desc.Width) * desc.Height, 0xCDCDCDCD);
+		if (shape.IsMonochrome) {
+			RasterizeMonochromeCursor(desc, vectorized.data());
+			RasterizeMonochromeCursorScalar(desc, scalar.data());
+		}
+		else {
+			RasterizeMaskedColorCursor(desc, vectorized.data());
+			RasterizeMaskedColorCursorScalar(desc, scalar.data());
+		}
+	}
+
+	static void AssertSamePixels(const std::wstring &name, const CURSOR_RASTER_DESC &desc, const std::vector<UINT> &vectorized, const std::vector<UINT> &scalar)
+	{
+		for (size_t i = 0; i < scalar.size(); i++) {
+			if (vectorized[i] != scalar[i]) {
+				wchar_t message[256];
+				swprintf_s(message, L"%ls: pixel (%d,%d) is 0x%08X, expected 0x%08X (skip %u,%u, size %dx%d, background pitch %u)",
+					name.c_str(), static_cast<int>(i % desc.Width), static_cast<int>(i / desc.Width), vectorized[i], scalar[i],
+					desc.SkipX, desc.SkipY, desc.Width, desc.Height, desc.BackgroundPitchInPixels);
+				Assert::Fail(message);
+			}
+		}
+	}
+
+	//
+	// Rasterizes the shape with every combination of clipping offsets and background layouts a pointer
+	// partially outside the desktop can produce, and checks that both kernels agree.
+	//
+	static void CompareWithScalar(const CURSOR_SHAPE &shape, std::mt19937 &random)
+	{
+		std::vector<UINT> vectorized, scalar;
+		for (UINT skipY : { 0u, 1u, 7u }) {
+			for (UINT skipX = 0; skipX < 10; skipX++) {
+				for (UINT clipRight : { 0u, 3u }) {
+					for (UINT backgroundPadding : { 0u, 5u }) {
+						CURSOR_RASTER_DESC desc{};
+						desc.pShape = shape.Buffer.data();
+						desc.ShapePitch = shape.Pitch;
+						desc.MaskHeight = shape.Height;
+						desc.SkipX = skipX;
+						desc.SkipY = skipY;
+						desc.Width = static_cast<INT>(shape.Width - skipX - clipRight);
+						desc.Height = static_cast<INT>(shape.Height - skipY);
+						std::vector<UINT> background((desc.Width + backgroundPadding) * desc.Height);
+						for (UINT &pixel : background) {
+							pixel = random();
+						}
+						desc.pBackground = background.data();
+						// No padding stands in for the single row background used for cached pointers
+						desc.BackgroundPitchInPixels = backgroundPadding ? desc.Width + backgroundPadding : 0;
+						RasterizeBothWays(shape, desc, vectorized, scalar);
+						AssertSamePixels(shape.Name, desc, vectorized, scalar);
+					}
+				}
+			}
+		}
+	}
+
+	static CURSOR_RASTER_DESC GetUnclippedDesc(const CURSOR_SHAPE &shape, const std::vector<UINT> &background)
+	{
+		CURSOR_RASTER_DESC desc{};
+		desc.pShape = shape.Buffer.data();
+		desc.ShapePitch = shape.Pitch;
+		desc.MaskHeight = shape.Height;
+		desc.pBackground = background.data();
+		desc.BackgroundPitchInPixels = shape.Width;
+		desc.Width = static_cast<INT>(shape.Width);
+		desc.Height = static_cast<INT>(shape.Height);
+		return desc;
+	}
+
+	static const CURSOR_FIXTURE &GetFixture(const std::vector<CURSOR_FIXTURE> &fixtures, const wchar_t *name)
+	{
+		for (const CURSOR_FIXTURE &fixture : fixtures) {
+			if (wcscmp(fixture.Name, name) == 0) {
+				return fixture;
+			}
+		}
+		Assert::Fail(L"Missing fixture");
+		return fixtures.front();
+	}
+
+	TEST_CLASS(CursorRasterizerTests)
+	{
+	public:
+		TEST_METHOD(FixturesMatchScalar)
+		{
+			Logger::WriteMessage(IsCursorRasterizerVectorized() ? L"Testing vectorized kernels" : L"No vector instructions on this platform, testing scalar kernels");
+			std::mt19937 random(1234);
+			for (const CURSOR_FIXTURE &fixture : GetFixtures()) {
+				for (UINT scale : { 1u, 2u, 4u }) {
+					CompareWithScalar(BuildShape(fixture, scale), random);
+				}
+			}
+		}
+
+		TEST_METHOD(RandomShapesMatchScalar)
+		{
+			std::mt19937 random(5678);
+			for (int i = 0; i < 200; i++) {
+				CURSOR_SHAPE shape{};
+				shape.Name = L"Random " + std::to_wstring(i);
+				shape.IsMonochrome = i % 2 == 0;
+				shape.Width = 16 + random() % 60;
+				shape.Height = 8 + random() % 8;
+				shape.Pitch = shape.IsMonochrome ? ((shape.Width + 31) / 32) * 4 : shape.Width * 4;
+				shape.Buffer.resize(shape.Pitch * shape.Height * (shape.IsMonochrome ? 2 : 1));
+				for (BYTE &value : shape.Buffer) {
+					value = static_cast<BYTE>(random());
+				}
+				if (!shape.IsMonochrome) {
+					// Masked color pointers only use 0x00 and 0xFF masks, and often have black pixels under the mask
+					UINT *pPixels = reinterpret_cast<UINT *>(shape.Buffer.data());
+					for (size_t p = 0; p < shape.Buffer.size() / 4; p++) {
+						UINT mask = random() % 2 ? CURSOR_OPAQUE_BLACK : 0;
+						UINT color = random() % 3 ? pPixels[p] & 0x00FFFFFF : 0;
+						pPixels[p] = mask | color;
+					}
+				}
+				CompareWithScalar(shape, random);
+			}
+		}
+
+		TEST_METHOD(MonochromeArrowPixels)
+		{
+			auto fixtures = GetFixtures();
+			const CURSOR_FIXTURE &fixture = GetFixture(fixtures, L"Arrow");
+			CURSOR_SHAPE shape = BuildShape(fixture, 1);
+			std::vector<UINT> background(shape.Width * shape.Height, BACKGROUND_COLOR);
+			std::vector<UINT> output(shape.Width * shape.Height);
+			RasterizeMonochromeCursor(GetUnclippedDesc(shape, background), output.data());
+			for (UINT y = 0; y < shape.Height; y++) {
+				for (UINT x = 0; x < shape.Width; x++) {
+					UINT expected = CURSOR_TRANSPARENT_WHITE;
+					switch (GetFixturePixel(fixture, x, y)) {
+						case '#': expected = CURSOR_OPAQUE_BLACK; break;
+						case 'o': expected = CURSOR_OPAQUE_WHITE; break;
+					}
+					Assert::IsTrue(output[y * shape.Width + x] == expected);
+				}
+			}
+		}
+
+		TEST_METHOD(MonochromeInvertsBackground)
+		{
+			auto fixtures = GetFixtures();
+			const CURSOR_FIXTURE &fixture = GetFixture(fixtures, L"IBeam");
+			CURSOR_SHAPE shape = BuildShape(fixture, 1);
+			std::vector<UINT> background(shape.Width * shape.Height, BACKGROUND_COLOR);
+			std::vector<UINT> output(shape.Width * shape.Height);
+			RasterizeMonochromeCursor(GetUnclippedDesc(shape, background), output.data());
+			for (UINT y = 0; y < shape.Height; y++) {
+				for (UINT x = 0; x < shape.Width; x++) {
+					UINT expected = GetFixturePixel(fixture, x, y) == 'x' ? BACKGROUND_COLOR ^ 0x00FFFFFF : CURSOR_TRANSPARENT_WHITE;
+					Assert::IsTrue(output[y * shape.Width + x] == expected);
+				}
+			}
+		}
+
+		TEST_METHOD(MaskedColorPixels)
+		{
+			auto fixtures = GetFixtures();
+			const CURSOR_FIXTURE &fixture = GetFixture(fixtures, L"ArrowMasked");
+			CURSOR_SHAPE shape = BuildShape(fixture, 1);
+			std::vector<UINT> background(shape.Width * shape.Height, BACKGROUND_COLOR);
+			std::vector<UINT> output(shape.Width * shape.Height);
+			RasterizeMaskedColorCursor(GetUnclippedDesc(shape, background), output.data());
+			for (UINT y = 0; y < shape.Height; y++) {
+				for (UINT x = 0; x < shape.Width; x++) {
+					UINT expected = CURSOR_TRANSPARENT_WHITE;
+					switch (GetFixturePixel(fixture, x, y)) {
+						case '#': expected = CURSOR_OPAQUE_BLACK; break;
+						case 'r': expected = 0xFFFF0000; break;
+						case 's': expected = (BACKGROUND_COLOR ^ 0x00808080) | CURSOR_OPAQUE_BLACK; break;
+					}
+					Assert::IsTrue(output[y * shape.Width + x] == expected);
+				}
+			}
+		}
+
+		TEST_METHOD(BackgroundDependence)
+		{
+			for (const CURSOR_FIXTURE &fixture : GetFixtures()) {
+				CURSOR_SHAPE shape = BuildShape(fixture, 1);
+				bool hasInvertedPixels = false;
+				for (const char *row : fixture.Rows) {
+					hasInvertedPixels |= strchr(row, 'x') != nullptr || strchr(row, 's') != nullptr;
+				}
+				bool isBackgroundDependent = IsCursorBackgroundDependent(shape.IsMonochrome, shape.Buffer.data(), shape.Pitch, shape.Width, shape.Height);
+				Assert::AreEqual(hasInvertedPixels, isBackgroundDependent, fixture.Name);
+			}
+		}
+	};
+}
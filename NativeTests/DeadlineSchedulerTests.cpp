@@ -0,0 +1,149 @@
+#include "CppUnitTest.h"
+#include "DeadlineScheduler.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace NativeTests
+{
+	//Interval of a 60 fps timer, in 100 nanosecond units. Not a whole number of milliseconds.
+	static const INT64 INTERVAL_60FPS = 166667;
+	//Time a spin takes to read the clock again, on the virtual clock
+	static const INT64 SPIN_STEP = 10;
+
+	//
+	// A clock that only advances when the scheduler sleeps or spins. Sleeps overshoot the requested time by a fixed amount,
+	// plus a repeating pattern of jitter.
+	//
+	class VirtualClock
+	{
+	public:
+		VirtualClock(INT64 startTime, INT64 sleepOvershoot, INT64 sleepJitter) :
+			Now(startTime),
+			m_SleepOvershoot(sleepOvershoot),
+			m_SleepJitter(sleepJitter),
+			m_SleepCount(0)
+		{
+		}
+
+		// Waits for the next tick like HighresTimer does, and returns the time of the tick
+		INT64 WaitForNextTick(DeadlineScheduler &scheduler)
+		{
+			while (!scheduler.IsDue(Now)) {
+				INT64 sleepTime = scheduler.GetSleepTime(Now);
+				if (sleepTime > 0) {
+					INT64 actualTime = sleepTime + m_SleepOvershoot + (m_SleepJitter * (m_SleepCount++ % 4)) / 3;
+					Now += actualTime;
+					scheduler.RecordSleep(sleepTime, actualTime);
+				}
+				else {
+					Now += SPIN_STEP;
+				}
+			}
+			scheduler.CompleteTick(Now);
+			return Now;
+		}
+
+		INT64 Now;
+	private:
+		INT64 m_SleepOvershoot;
+		INT64 m_SleepJitter;
+		INT64 m_SleepCount;
+	};
+
+	TEST_CLASS(DeadlineSchedulerTests)
+	{
+	public:
+		TEST_METHOD(TicksAtFractionalMillisecondIntervalsWithoutDrift)
+		{
+			DeadlineScheduler scheduler;
+			VirtualClock clock(1000, 5000, 3000);
+			scheduler.Start(clock.Now, INTERVAL_60FPS);
+			const INT64 tickCount = 600;
+			for (INT64 i = 0; i < tickCount; i++) {
+				INT64 tickTime = clock.WaitForNextTick(scheduler);
+				INT64 deadline = 1000 + i * INTERVAL_60FPS;
+				Assert::IsTrue(tickTime >= deadline);
+				//Only the first few ticks are late, while the spin time is calibrated to the sleep overshoot
+				if (i >= 10) {
+					Assert::IsTrue(tickTime - deadline <= SPIN_STEP);
+				}
+			}
+			//600 ticks at 60 fps take 10 seconds, not 600 * 16 ms
+			Assert::AreEqual(1000 + tickCount * INTERVAL_60FPS, scheduler.GetNextDeadline());
+			TIMER_LATENESS_HISTOGRAM histogram = scheduler.GetLatenessHistogram();
+			Assert::AreEqual(tickCount, histogram.TickCount);
+			Assert::AreEqual(0LL, histogram.MissedTickCount);
+		}
+
+		TEST_METHOD(CalibratesSpinToSleepOvershoot)
+		{
+			DeadlineScheduler scheduler;
+			VirtualClock clock(0, 25000, 0);
+			scheduler.Start(0, INTERVAL_60FPS);
+			for (int i = 0; i < 20; i++) {
+				clock.WaitForNextTick(scheduler);
+			}
+			//The spin covers the 2.5 ms overshoot, and most of the wait is still spent sleeping
+			Assert::IsTrue(scheduler.GetSpinThreshold() > 25000);
+			Assert::IsTrue(scheduler.GetSpinThreshold() <= DEADLINE_SCHEDULER_MAX_SPIN_THRESHOLD);
+
+			//When sleeps become accurate, the spin shrinks to its minimum
+			DeadlineScheduler accurateScheduler;
+			VirtualClock accurateClock(0, 0, 0);
+			accurateScheduler.Start(0, INTERVAL_60FPS);
+			for (int i = 0; i < 200; i++) {
+				accurateClock.WaitForNextTick(accurateScheduler);
+			}
+			Assert::AreEqual((INT64)DEADLINE_SCHEDULER_MIN_SPIN_THRESHOLD, accurateScheduler.GetSpinThreshold());
+			Assert::AreEqual(200LL, accurateScheduler.GetLatenessHistogram().Counts[0]);
+		}
+
+		TEST_METHOD(SkipsDeadlinesThatHavePassed)
+		{
+			DeadlineScheduler scheduler;
+			scheduler.Start(0, 100000);
+			scheduler.CompleteTick(0);
+			//The second tick is 2.5 intervals late, so the deadlines at 200000 and 300000 are skipped
+			scheduler.CompleteTick(350000);
+			Assert::AreEqual(400000LL, scheduler.GetNextDeadline());
+			//A tick less than an interval late keeps the schedule
+			scheduler.CompleteTick(450000);
+			Assert::AreEqual(500000LL, scheduler.GetNextDeadline());
+
+			TIMER_LATENESS_HISTOGRAM histogram = scheduler.GetLatenessHistogram();
+			Assert::AreEqual(3LL, histogram.TickCount);
+			Assert::AreEqual(2LL, histogram.MissedTickCount);
+			Assert::AreEqual(250000LL, histogram.MaxLateness);
+			Assert::AreEqual(300000LL, histogram.TotalLateness);
+		}
+
+		TEST_METHOD(CountsLatenessInBuckets)
+		{
+			DeadlineScheduler scheduler;
+			const INT64 interval = 10000000;
+			scheduler.Start(0, interval);
+			INT64 latenesses[] = { 0, 500, 501, 10000, 15000, 160000, 160001, 5000000 };
+			for (UINT i = 0; i < ARRAYSIZE(latenesses); i++) {
+				scheduler.CompleteTick(i * interval + latenesses[i]);
+			}
+			TIMER_LATENESS_HISTOGRAM histogram = scheduler.GetLatenessHistogram();
+			INT64 expectedCounts[TIMER_LATENESS_BUCKET_COUNT] = { 2, 1, 0, 0, 1, 1, 0, 0, 1, 2 };
+			for (UINT i = 0; i < TIMER_LATENESS_BUCKET_COUNT; i++) {
+				Assert::AreEqual(expectedCounts[i], histogram.Counts[i]);
+			}
+			Assert::AreEqual(500LL, GetTimerLatenessBucketBound(0));
+			Assert::AreEqual(160000LL, GetTimerLatenessBucketBound(TIMER_LATENESS_BUCKET_COUNT - 2));
+			Assert::AreEqual(-1LL, GetTimerLatenessBucketBound(TIMER_LATENESS_BUCKET_COUNT - 1));
+		}
+
+		TEST_METHOD(SleepsUntilShortlyBeforeTheDeadline)
+		{
+			DeadlineScheduler scheduler;
+			scheduler.Start(1000000, INTERVAL_60FPS);
+			Assert::AreEqual((INT64)(1000000 - DEADLINE_SCHEDULER_INITIAL_SPIN_THRESHOLD), scheduler.GetSleepTime(0));
+			Assert::AreEqual(0LL, scheduler.GetSleepTime(1000000 - DEADLINE_SCHEDULER_INITIAL_SPIN_THRESHOLD));
+			Assert::IsFalse(scheduler.IsDue(999999));
+			Assert::IsTrue(scheduler.IsDue(1000000));
+		}
+	};
+}
@@ -0,0 +1,129 @@
+#include "CppUnitTest.h"
+#include "DecodedFrameQueue.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace NativeTests
+{
+	//Duration of a frame at 30 fps, in 100 nanosecond units
+	static const LONGLONG FRAME_DURATION = 333333;
+
+	TEST_CLASS(DecodedFrameQueueTests)
+	{
+	public:
+		TEST_METHOD(PresentsFramesByTheirTimeStamps)
+		{
+			DecodedFrameQueue<int> queue(4);
+			Assert::IsFalse(queue.IsFrameDue(0));
+			Assert::AreEqual(-1LL, queue.GetTimeUntilNextFrame(0));
+			for (int i = 0; i < 3; i++) {
+				Assert::IsTrue(queue.TryPush(i, i * FRAME_DURATION, FRAME_DURATION));
+			}
+			//The first frame is presented right away, at any clock time
+			const LONGLONG start = 5000000;
+			int frame = -1;
+			Assert::IsTrue(queue.TryAcquire(start, &frame));
+			Assert::AreEqual(0, frame);
+
+			Assert::IsFalse(queue.TryAcquire(start + FRAME_DURATION - 1, &frame));
+			Assert::AreEqual(1LL, queue.GetTimeUntilNextFrame(start + FRAME_DURATION - 1));
+			Assert::IsTrue(queue.TryAcquire(start + FRAME_DURATION, &frame));
+			Assert::AreEqual(1, frame);
+			Assert::IsTrue(queue.TryAcquire(start + 2 * FRAME_DURATION + 10, &frame));
+			Assert::AreEqual(2, frame);
+			Assert::IsFalse(queue.TryAcquire(start + 10 * FRAME_DURATION, &frame));
+
+			DECODED_FRAME_QUEUE_STATISTICS statistics = queue.GetStatistics();
+			Assert::AreEqual(0u, statistics.Depth);
+			Assert::AreEqual(3LL, statistics.PresentedFrameCount);
+			Assert::AreEqual(0LL, statistics.LateFrameCount);
+			Assert::AreEqual(0LL, statistics.DroppedFrameCount);
+		}
+
+		TEST_METHOD(DropsFramesThatAreOverdue)
+		{
+			DecodedFrameQueue<int> queue(4);
+			for (int i = 0; i < 4; i++) {
+				queue.TryPush(i, i * FRAME_DURATION, FRAME_DURATION);
+			}
+			int frame = -1;
+			Assert::IsTrue(queue.TryAcquire(0, &frame));
+			//Frames 1 and 2 are both due, so only the newest is presented
+			Assert::IsTrue(queue.TryAcquire(2 * FRAME_DURATION, &frame));
+			Assert::AreEqual(2, frame);
+
+			DECODED_FRAME_QUEUE_STATISTICS statistics = queue.GetStatistics();
+			Assert::AreEqual(1u, statistics.Depth);
+			Assert::AreEqual(2LL, statistics.PresentedFrameCount);
+			Assert::AreEqual(1LL, statistics.DroppedFrameCount);
+			Assert::AreEqual(0LL, statistics.LateFrameCount);
+		}
+
+		TEST_METHOD(CountsFramesPresentedAfterTheirDuration)
+		{
+			DecodedFrameQueue<int> queue(4);
+			queue.TryPush(0, 0, FRAME_DURATION);
+			int frame = -1;
+			Assert::IsTrue(queue.TryAcquire(0, &frame));
+			//The decoder falls behind, and the next frame arrives after it should have been replaced
+			queue.TryPush(1, FRAME_DURATION, FRAME_DURATION);
+			Assert::IsTrue(queue.TryAcquire(2 * FRAME_DURATION + 1, &frame));
+			Assert::AreEqual(1, frame);
+			Assert::AreEqual(1LL, queue.GetStatistics().LateFrameCount);
+			Assert::AreEqual(0LL, queue.GetStatistics().DroppedFrameCount);
+		}
+
+		TEST_METHOD(ContinuesTimeStampsAcrossLoops)
+		{
+			DecodedFrameQueue<int> queue(8);
+			//Two loops of a stream of three frames that does not start at 0
+			const LONGLONG firstTimeStamp = 1000;
+			for (int i = 0; i < 6; i++) {
+				Assert::IsTrue(queue.TryPush(i, firstTimeStamp + (i % 3) * FRAME_DURATION, FRAME_DURATION));
+			}
+			int frame = -1;
+			for (int i = 0; i < 6; i++) {
+				Assert::IsTrue(queue.TryAcquire(i * FRAME_DURATION, &frame));
+				Assert::AreEqual(i, frame);
+				Assert::IsFalse(queue.IsFrameDue(i * FRAME_DURATION));
+			}
+			Assert::AreEqual(0LL, queue.GetStatistics().DroppedFrameCount);
+		}
+
+		TEST_METHOD(HoldsAtMostItsCapacity)
+		{
+			DecodedFrameQueue<int> queue(2);
+			Assert::IsTrue(queue.TryPush(10, 0, FRAME_DURATION));
+			Assert::IsFalse(queue.IsFull());
+			Assert::IsTrue(queue.TryPush(11, FRAME_DURATION, FRAME_DURATION));
+			Assert::IsTrue(queue.IsFull());
+			Assert::IsFalse(queue.TryPush(12, 2 * FRAME_DURATION, FRAME_DURATION));
+			Assert::IsTrue(queue.Contains(11));
+			Assert::IsFalse(queue.Contains(12));
+
+			int frame = -1;
+			Assert::IsTrue(queue.TryAcquire(0, &frame));
+			Assert::IsFalse(queue.IsFull());
+			Assert::IsFalse(queue.Contains(10));
+			Assert::AreEqual(1u, queue.GetStatistics().Depth);
+		}
+
+		TEST_METHOD(ClearStartsPlaybackOver)
+		{
+			DecodedFrameQueue<int> queue(4);
+			queue.TryPush(0, 0, FRAME_DURATION);
+			queue.TryPush(1, FRAME_DURATION, FRAME_DURATION);
+			int frame = -1;
+			Assert::IsTrue(queue.TryAcquire(0, &frame));
+			queue.Clear();
+			Assert::IsTrue(queue.IsEmpty());
+
+			//After a restart the first frame is due immediately, even at an earlier clock time
+			queue.TryPush(5, 0, FRAME_DURATION);
+			Assert::IsTrue(queue.IsFrameDue(-FRAME_DURATION));
+			Assert::IsTrue(queue.TryAcquire(-FRAME_DURATION, &frame));
+			Assert::AreEqual(5, frame);
+			Assert::AreEqual(2LL, queue.GetStatistics().PresentedFrameCount);
+		}
+	};
+}
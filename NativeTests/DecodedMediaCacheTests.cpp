@@ -0,0 +1,111 @@
+#include "CppUnitTest.h"
+#include "DecodedMediaCache.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace NativeTests
+{
+	static DECODED_MEDIA_KEY FileKey(const wchar_t *path, UINT64 lastWriteTime = 1)
+	{
+		DECODED_MEDIA_KEY key{};
+		key.Path = path;
+		key.LastWriteTime = lastWriteTime;
+		key.Size = 100;
+		return key;
+	}
+
+	// An image of 4 bytes per pixel
+	static std::shared_ptr<const DECODED_MEDIA> Image(UINT width, UINT height)
+	{
+		std::shared_ptr<DECODED_MEDIA> pMedia = std::make_shared<DECODED_MEDIA>();
+		pMedia->Width = width;
+		pMedia->Height = height;
+		pMedia->Pixels.resize(static_cast<size_t>(width) * height);
+		return pMedia;
+	}
+
+	TEST_CLASS(DecodedMediaCacheTests)
+	{
+	public:
+		TEST_METHOD(FindsMediaByKey)
+		{
+			DecodedMediaCache cache(1000);
+			std::shared_ptr<const DECODED_MEDIA> pImage = Image(10, 10);
+			cache.Insert(FileKey(L"c:\\a.png"), pImage);
+			Assert::IsTrue(cache.Find(FileKey(L"c:\\a.png")) == pImage);
+			Assert::IsTrue(cache.Find(FileKey(L"c:\\b.png")) == nullptr);
+			//A file that was written to since it was decoded is a different file
+			Assert::IsTrue(cache.Find(FileKey(L"c:\\a.png", 2)) == nullptr);
+
+			DECODED_MEDIA_KEY streamKey{};
+			streamKey.ContentHash = 42;
+			streamKey.Size = 100;
+			Assert::IsTrue(cache.Find(streamKey) == nullptr);
+			cache.Insert(streamKey, Image(1, 1));
+			Assert::AreEqual(2u, cache.GetEntryCount());
+			Assert::AreEqual(static_cast<size_t>(404), cache.GetSizeInBytes());
+		}
+
+		TEST_METHOD(EvictsLeastRecentlyUsed)
+		{
+			DecodedMediaCache cache(1000);
+			cache.Insert(FileKey(L"a"), Image(10, 10));
+			cache.Insert(FileKey(L"b"), Image(10, 10));
+			//Using a makes b the least recently used
+			Assert::IsTrue(cache.Find(FileKey(L"a")) != nullptr);
+			cache.Insert(FileKey(L"c"), Image(10, 10));
+			Assert::IsTrue(cache.Find(FileKey(L"a")) != nullptr);
+			Assert::IsTrue(cache.Find(FileKey(L"b")) == nullptr);
+			Assert::IsTrue(cache.Find(FileKey(L"c")) != nullptr);
+			Assert::AreEqual(static_cast<size_t>(800), cache.GetSizeInBytes());
+		}
+
+		TEST_METHOD(EvictedMediaStaysValidWhileInUse)
+		{
+			DecodedMediaCache cache(500);
+			cache.Insert(FileKey(L"a"), Image(10, 10));
+			std::shared_ptr<const DECODED_MEDIA> pInUse = cache.Find(FileKey(L"a"));
+			cache.Insert(FileKey(L"b"), Image(10, 10));
+			Assert::IsTrue(cache.Find(FileKey(L"a")) == nullptr);
+			Assert::AreEqual(static_cast<size_t>(100), pInUse->Pixels.size());
+			Assert::AreEqual(static_cast<size_t>(400), cache.GetSizeInBytes());
+		}
+
+		TEST_METHOD(ReplacesMediaWithTheSameKey)
+		{
+			DecodedMediaCache cache(1000);
+			cache.Insert(FileKey(L"a"), Image(10, 10));
+			std::shared_ptr<const DECODED_MEDIA> pReplacement = Image(5, 5);
+			cache.Insert(FileKey(L"a"), pReplacement);
+			Assert::IsTrue(cache.Find(FileKey(L"a")) == pReplacement);
+			Assert::AreEqual(1u, cache.GetEntryCount());
+			Assert::AreEqual(static_cast<size_t>(100), cache.GetSizeInBytes());
+		}
+
+		TEST_METHOD(DoesNotCacheMediaLargerThanTheBudget)
+		{
+			DecodedMediaCache cache(1000);
+			cache.Insert(FileKey(L"a"), Image(10, 10));
+			cache.Insert(FileKey(L"b"), Image(20, 20));
+			Assert::IsTrue(cache.Find(FileKey(L"b")) == nullptr);
+			//Nothing is evicted to make room for media that does not fit anyway
+			Assert::IsTrue(cache.Find(FileKey(L"a")) != nullptr);
+
+			cache.Clear();
+			Assert::AreEqual(0u, cache.GetEntryCount());
+			Assert::AreEqual(static_cast<size_t>(0), cache.GetSizeInBytes());
+		}
+
+		TEST_METHOD(CountsGifDataAndFrames)
+		{
+			std::shared_ptr<DECODED_MEDIA> pGif = std::make_shared<DECODED_MEDIA>();
+			pGif->GifData.resize(50);
+			for (UINT i = 0; i < 3; i++) {
+				std::shared_ptr<GIF_FRAME> pFrame = std::make_shared<GIF_FRAME>();
+				pFrame->Pixels.resize(10);
+				pGif->GifFrames.push_back(pFrame);
+			}
+			Assert::AreEqual(static_cast<size_t>(50 + 3 * 40), pGif->GetSizeInBytes());
+		}
+	};
+}
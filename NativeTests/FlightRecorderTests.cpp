@@ -0,0 +1,102 @@
+#include "CppUnitTest.h"
+#include "FlightRecorder.h"
+#include <sstream>
+#include <thread>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace NativeTests
+{
+	TEST_CLASS(FlightRecorderTests)
+	{
+	public:
+		TEST_METHOD(KeepsTheMostRecentRecordsOldestFirst)
+		{
+			FlightRecorder recorder(8);
+			for (int i = 0; i < 10; i++) {
+				recorder.Record(FlightEventType::FrameRendered, S_OK, i * 100, static_cast<UINT16>(i));
+			}
+			UINT32 droppedCount = 0;
+			std::vector<FLIGHT_RECORD> records = recorder.GetRecords(&droppedCount);
+			Assert::AreEqual(8u, static_cast<UINT>(records.size()));
+			Assert::AreEqual(0u, droppedCount);
+			for (int i = 0; i < 8; i++) {
+				Assert::AreEqual(static_cast<UINT32>(i + 2), records[i].Sequence);
+				Assert::AreEqual(static_cast<INT64>((i + 2) * 100), records[i].Value);
+				Assert::AreEqual(static_cast<UINT16>(i + 2), records[i].Detail);
+				Assert::IsTrue(i == 0 || records[i].Time >= records[i - 1].Time);
+			}
+		}
+
+		TEST_METHOD(WritesDumpThatTheDecoderReads)
+		{
+			FlightRecorder recorder(16);
+			recorder.Record(FlightEventType::RecordingStarted);
+			recorder.Record(FlightEventType::CaptureRestarting, DXGI_ERROR_ACCESS_LOST, 3, 1);
+			recorder.Record(FlightEventType::AudioDiscontinuity, S_OK, -1, 1);
+			std::stringstream stream;
+			Assert::AreEqual(S_OK, recorder.Write(stream));
+			Assert::AreEqual(static_cast<size_t>(FLIGHT_RECORDER_HEADER_SIZE + 3 * FLIGHT_RECORDER_RECORD_SIZE), stream.str().size());
+
+			FLIGHT_RECORDER_HEADER header{};
+			std::vector<FLIGHT_RECORD> records;
+			Assert::IsTrue(FlightRecorderFile::Read(stream, &header, &records));
+			Assert::AreEqual(static_cast<UINT32>(FLIGHT_RECORDER_VERSION), header.Version);
+			Assert::AreEqual(3u, header.RecordCount);
+			Assert::IsTrue(header.Frequency > 0);
+			Assert::IsTrue(header.DumpTime >= records[2].Time);
+			Assert::IsTrue(records[1].Type == FlightEventType::CaptureRestarting);
+			Assert::AreEqual(static_cast<INT32>(DXGI_ERROR_ACCESS_LOST), records[1].Result);
+			Assert::AreEqual(3LL, records[1].Value);
+			Assert::AreEqual(static_cast<UINT32>(GetCurrentThreadId()), records[1].ThreadId);
+			Assert::AreEqual(-1LL, records[2].Value);
+			Assert::AreEqual(std::string("AudioDiscontinuity"), std::string(GetFlightEventName(records[2].Type)));
+		}
+
+		TEST_METHOD(RejectsStreamsThatAreNotDumps)
+		{
+			FLIGHT_RECORDER_HEADER header{};
+			std::vector<FLIGHT_RECORD> records;
+			std::stringstream notADump("ScreenRecorderLib cursor metadata 1");
+			Assert::IsFalse(FlightRecorderFile::Read(notADump, &header, &records));
+
+			FlightRecorder recorder(4);
+			recorder.Record(FlightEventType::RecordingStarted);
+			std::stringstream stream;
+			recorder.Write(stream);
+			std::stringstream truncated(stream.str().substr(0, FLIGHT_RECORDER_HEADER_SIZE + FLIGHT_RECORDER_RECORD_SIZE / 2));
+			Assert::IsFalse(FlightRecorderFile::Read(truncated, &header, &records));
+		}
+
+		TEST_METHOD(RecordsAreNotTornWhenReadWhileWritten)
+		{
+			const int threadCount = 4;
+			const int recordsPerThread = 100000;
+			FlightRecorder recorder(64);
+			std::vector<std::thread> threads;
+			for (int i = 0; i < threadCount; i++) {
+				threads.push_back(std::thread([&recorder, i]() {
+					for (int j = 0; j < recordsPerThread; j++) {
+						//The result and detail are derived from the value, so a record mixing two writes can be told apart
+						recorder.Record(FlightEventType::QueueDepth, -j, j, static_cast<UINT16>(i));
+					}
+				}));
+			}
+			UINT64 readCount = 0;
+			for (int i = 0; i < 200; i++) {
+				for (const FLIGHT_RECORD &record : recorder.GetRecords()) {
+					Assert::AreEqual(static_cast<INT32>(-record.Value), record.Result);
+					Assert::IsTrue(record.Detail < threadCount);
+					readCount++;
+				}
+			}
+			for (auto &thread : threads) {
+				thread.join();
+			}
+			UINT32 droppedCount = 0;
+			Assert::AreEqual(64u, static_cast<UINT>(recorder.GetRecords(&droppedCount).size()));
+			Assert::AreEqual(0u, droppedCount);
+			Assert::IsTrue(readCount > 0);
+		}
+	};
+}
@@ -0,0 +1,266 @@
+#include "CppUnitTest.h"
+#include "GifDecoder.h"
+#include "GifFixtures.h"
+#include <fstream>
+#include <random>
+#include <string>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace GifFixtures;
+
+namespace NativeTests
+{
+	// Composes every disposal method, a transparent color and a local color table.
+	static std::vector<GIF_FIXTURE_FRAME> GetDisposalFrames()
+	{
+		return {
+			{ 0, 0, GIF_DISPOSAL_NONE, 10, false, false, {
+				"bbbbbb",
+				"bwwwwb",
+				"bwwwwb",
+				"bbbbbb",
+			} },
+			{ 1, 1, GIF_DISPOSAL_BACKGROUND, 20, false, false, {
+				"r.r",
+				"rrr",
+			} },
+			{ 3, 0, GIF_DISPOSAL_PREVIOUS, 0, false, true, {
+				"gg",
+				"gg",
+			} },
+			{ 0, 3, GIF_DISPOSAL_NONE, 30, true, false, {
+				"kkkkkk",
+			} },
+		};
+	}
+
+	static const std::vector<std::vector<const char *>> DISPOSAL_FRAMES_COMPOSED = {
+		{
+			"bbbbbb",
+			"bwwwwb",
+			"bwwwwb",
+			"bbbbbb",
+		},
+		{
+			"bbbbbb",
+			"brwrwb",
+			"brrrwb",
+			"bbbbbb",
+		},
+		{
+			"bbbggb",
+			"b..ggb",
+			"b...wb",
+			"bbbbbb",
+		},
+		{
+			"bbbbbb",
+			"b...wb",
+			"b...wb",
+			"kkkkkk",
+		},
+	};
+
+	static std::vector<BYTE> ReadTestMedia(const char *fileName)
+	{
+		std::string path = __FILE__;
+		path = path.substr(0, path.find_last_of("\\/") + 1) + "..\\Testmedia\\" + fileName;
+		std::ifstream file(path, std::ios::binary);
+		if (!file) {
+			Assert::Fail(L"Test media file not found");
+		}
+		return std::vector<BYTE>((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+	}
+
+	static UINT64 HashPixels(const std::vector<UINT> &pixels, UINT64 hash)
+	{
+		//FNV-1a
+		const BYTE *pBytes = reinterpret_cast<const BYTE *>(pixels.data());
+		for (size_t i = 0; i < pixels.size() * sizeof(UINT); i++) {
+			hash = (hash ^ pBytes[i]) * 0x100000001B3ull;
+		}
+		return hash;
+	}
+
+	TEST_CLASS(GifDecoderTests)
+	{
+	public:
+		TEST_METHOD(ComposesFramesWithDisposalAndTransparency)
+		{
+			std::vector<GIF_FIXTURE_FRAME> frames = GetDisposalFrames();
+			//Sub-blocks of a single byte split nearly every code between two writes to the LZW decoder.
+			for (UINT subBlockSize : { 255u, 1u, 2u }) {
+				GifDecoder decoder;
+				Assert::AreEqual(S_OK, decoder.Open(EncodeGif(6, 4, 2, frames, subBlockSize)));
+				Assert::AreEqual(6u, decoder.GetWidth());
+				Assert::AreEqual(4u, decoder.GetHeight());
+				Assert::AreEqual(4u, decoder.GetFrameCount());
+				Assert::IsTrue(decoder.HasLoopCount());
+				Assert::AreEqual(2u, decoder.GetLoopCount());
+				//The second loop starts from a clear canvas, and must compose the same frames.
+				for (UINT i = 0; i < 2 * frames.size(); i++) {
+					UINT frameIndex = i % frames.size();
+					std::shared_ptr<GIF_FRAME> pFrame;
+					Assert::AreEqual(S_OK, decoder.DecodeNextFrame(&pFrame));
+					Assert::AreEqual(frameIndex, pFrame->Index);
+					Assert::AreEqual(frames[frameIndex].Delay * 10, pFrame->DelayMillis);
+					Assert::IsTrue(ToPixels(DISPOSAL_FRAMES_COMPOSED[frameIndex]) == pFrame->Pixels, L"Composed frame does not match");
+				}
+			}
+		}
+
+		TEST_METHOD(DecodesInterlacedRows)
+		{
+			std::vector<const char *> rows = { "kw", "wr", "rg", "gb", "bk", "kr", "wg", "rb", "gk", "bw", "kg" };
+			GifDecoder decoder;
+			Assert::AreEqual(S_OK, decoder.Open(EncodeGif(2, static_cast<UINT>(rows.size()), -1, { { 0, 0, GIF_DISPOSAL_NONE, 0, true, false, rows } })));
+			Assert::IsFalse(decoder.HasLoopCount());
+			std::shared_ptr<GIF_FRAME> pFrame;
+			Assert::AreEqual(S_OK, decoder.DecodeNextFrame(&pFrame));
+			Assert::IsTrue(ToPixels(rows) == pFrame->Pixels, L"Interlaced rows are out of order");
+		}
+
+		TEST_METHOD(DecodesImagesThatFillTheCodeTable)
+		{
+			//Random pixels create a new code for almost every pixel, so the table fills up and is cleared many times.
+			const UINT width = 300;
+			const UINT height = 200;
+			std::mt19937 random(7);
+			std::vector<std::string> rowStrings(height);
+			for (std::string &row : rowStrings) {
+				for (UINT x = 0; x < width; x++) {
+					row.push_back("kwrgb"[random() % 5]);
+				}
+			}
+			std::vector<const char *> rows;
+			for (const std::string &row : rowStrings) {
+				rows.push_back(row.c_str());
+			}
+			GifDecoder decoder;
+			Assert::AreEqual(S_OK, decoder.Open(EncodeGif(width, height, -1, { { 0, 0, GIF_DISPOSAL_NONE, 0, false, false, rows } })));
+			std::shared_ptr<GIF_FRAME> pFrame;
+			Assert::AreEqual(S_OK, decoder.DecodeNextFrame(&pFrame));
+			Assert::IsTrue(ToPixels(rows) == pFrame->Pixels, L"Decoded pixels do not match");
+		}
+
+		TEST_METHOD(TruncatedFileKeepsDecodedPixels)
+		{
+			std::vector<BYTE> gif = EncodeGif(6, 4, -1, GetDisposalFrames());
+			//Cut the file in the middle of the image data of the last frame.
+			gif.resize(gif.size() - 3);
+			GifDecoder decoder;
+			Assert::AreEqual(S_OK, decoder.Open(gif));
+			Assert::AreEqual(4u, decoder.GetFrameCount());
+			std::shared_ptr<GIF_FRAME> pFrame;
+			for (UINT i = 0; i < 4; i++) {
+				Assert::AreEqual(S_OK, decoder.DecodeNextFrame(&pFrame));
+			}
+			//Earlier frames are intact
+			std::vector<UINT> expected = ToPixels(DISPOSAL_FRAMES_COMPOSED[3]);
+			Assert::IsTrue(std::equal(expected.begin(), expected.begin() + 18, pFrame->Pixels.begin()));
+
+			Assert::AreEqual(E_FAIL, decoder.Open(std::vector<BYTE>(gif.begin(), gif.begin() + 12)));
+			Assert::AreEqual(E_FAIL, decoder.Open(std::vector<BYTE>(100, 0)));
+		}
+
+		TEST_METHOD(FramePoolReusesReleasedFrames)
+		{
+			GifDecoder decoder;
+			Assert::AreEqual(S_OK, decoder.Open(EncodeGif(6, 4, 0, GetDisposalFrames())));
+			for (UINT i = 0; i < 20; i++) {
+				std::shared_ptr<GIF_FRAME> pFrame;
+				Assert::AreEqual(S_OK, decoder.DecodeNextFrame(&pFrame));
+			}
+			Assert::AreEqual(1u, decoder.GetFramePool().GetAllocatedFrameCount());
+
+			std::shared_ptr<GIF_FRAME> pFirstFrame;
+			std::shared_ptr<GIF_FRAME> pSecondFrame;
+			Assert::AreEqual(S_OK, decoder.DecodeNextFrame(&pFirstFrame));
+			Assert::AreEqual(S_OK, decoder.DecodeNextFrame(&pSecondFrame));
+			Assert::IsTrue(pFirstFrame != pSecondFrame);
+			Assert::AreEqual(2u, decoder.GetFramePool().GetAllocatedFrameCount());
+
+			//Frames released after the decoder is reopened are not reused.
+			Assert::AreEqual(S_OK, decoder.Open(EncodeGif(6, 4, 0, GetDisposalFrames())));
+			pFirstFrame.reset();
+			pSecondFrame.reset();
+			Assert::AreEqual(0u, decoder.GetFramePool().GetAllocatedFrameCount());
+		}
+
+		TEST_METHOD(FrameQueueDecodesInOrder)
+		{
+			std::vector<GIF_FIXTURE_FRAME> frames = GetDisposalFrames();
+			GifDecoder decoder;
+			Assert::AreEqual(S_OK, decoder.Open(EncodeGif(6, 4, 0, frames)));
+			GifFrameQueue queue;
+			Assert::AreEqual(S_OK, queue.Start(&decoder, 2));
+			for (UINT i = 0; i < 3 * frames.size(); i++) {
+				std::shared_ptr<GIF_FRAME> pFrame;
+				Assert::AreEqual(S_OK, queue.GetNextFrame(&pFrame));
+				Assert::AreEqual(static_cast<UINT>(i % frames.size()), pFrame->Index);
+				Assert::IsTrue(ToPixels(DISPOSAL_FRAMES_COMPOSED[pFrame->Index]) == pFrame->Pixels, L"Composed frame does not match");
+			}
+			queue.Stop();
+			std::shared_ptr<GIF_FRAME> pFrame;
+			Assert::AreEqual(E_ABORT, queue.GetNextFrame(&pFrame));
+			//Frames in the queue and in use, and one being decoded
+			Assert::IsTrue(decoder.GetFramePool().GetAllocatedFrameCount() <= 4);
+		}
+
+		TEST_METHOD(VectorizedExpansionMatchesScalar)
+		{
+			std::mt19937 random(11);
+			UINT palette[256];
+			for (UINT &color : palette) {
+				//A quarter of the colors are transparent
+				color = random() % 4 == 0 ? 0 : (0xFF000000 | (random() & 0xFFFFFF));
+			}
+			for (UINT count = 0; count < 40; count++) {
+				std::vector<BYTE> indices(count);
+				for (BYTE &index : indices) {
+					index = static_cast<BYTE>(random());
+				}
+				std::vector<UINT> vectorized(count);
+				for (UINT &pixel : vectorized) {
+					pixel = random();
+				}
+				std::vector<UINT> scalar = vectorized;
+				ExpandGifPixels(indices.data(), palette, vectorized.data(), count);
+				ExpandGifPixelsScalar(indices.data(), palette, scalar.data(), count);
+				Assert::IsTrue(vectorized == scalar, L"Vectorized and scalar expansion differ");
+			}
+		}
+
+		TEST_METHOD(DecodesTestMedia)
+		{
+			struct TEST_MEDIA {
+				const char *FileName;
+				UINT Width;
+				UINT Height;
+				UINT FrameCount;
+				UINT LoopCount;
+				// Hash of the composed frames of the first loop, which were verified against another decoder
+				UINT64 Hash;
+			};
+			const TEST_MEDIA testMedia[] = {
+				{ "earth.gif", 400, 400, 44, 65535, 0x4194E8B76F94EDC3ull },
+				{ "giftest.gif", 129, 134, 65, 0, 0x8CFA8380DFBD3A8Bull },
+			};
+			for (const TEST_MEDIA &media : testMedia) {
+				GifDecoder decoder;
+				Assert::AreEqual(S_OK, decoder.Open(ReadTestMedia(media.FileName)));
+				Assert::AreEqual(media.Width, decoder.GetWidth());
+				Assert::AreEqual(media.Height, decoder.GetHeight());
+				Assert::AreEqual(media.FrameCount, decoder.GetFrameCount());
+				Assert::AreEqual(media.LoopCount, decoder.GetLoopCount());
+				UINT64 hash = 0xCBF29CE484222325ull;
+				for (UINT i = 0; i < media.FrameCount; i++) {
+					std::shared_ptr<GIF_FRAME> pFrame;
+					Assert::AreEqual(S_OK, decoder.DecodeNextFrame(&pFrame));
+					hash = HashPixels(pFrame->Pixels, hash);
+				}
+				Assert::AreEqual(media.Hash, hash);
+			}
+		}
+	};
+}
@@ -0,0 +1,205 @@
+#pragma once
+#include <Windows.h>
+#include <vector>
+#include <map>
+#include <cstring>
+
+//
+// Encodes small GIFs for the decoder tests from frames drawn as text. Each pixel is one character:
+//   'k' black, 'w' white, 'r' red, 'g' green, 'b' blue, '.' the transparent color.
+// Frames with a local color table use the colors in a different order than the global color table,
+// so a decoder that ignores the local table draws the wrong colors.
+//
+namespace GifFixtures {
+	struct GIF_FIXTURE_FRAME {
+		UINT Left;
+		UINT Top;
+		UINT Disposal;
+		// Delay in hundredths of a second, as stored in the file
+		UINT Delay;
+		bool IsInterlaced;
+		bool HasLocalColorTable;
+		std::vector<const char *> Rows;
+	};
+
+	static const char GLOBAL_COLORS[] = "kwrgb.";
+	static const char LOCAL_COLORS[] = "bgrwk.";
+	static const BYTE TRANSPARENT_INDEX = 5;
+	// Minimum code size for color tables of 8 entries
+	static const BYTE MINIMUM_CODE_SIZE = 3;
+
+	inline UINT ColorOf(char pixel)
+	{
+		switch (pixel) {
+			case 'k': return 0xFF000000;
+			case 'w': return 0xFFFFFFFF;
+			case 'r': return 0xFFFF0000;
+			case 'g': return 0xFF00FF00;
+			case 'b': return 0xFF0000FF;
+			default: return 0x00000000;
+		}
+	}
+
+	/// <summary>
+	/// Returns the BGRA pixels of a canvas drawn as text.
+	/// </summary>
+	inline std::vector<UINT> ToPixels(const std::vector<const char *> &rows)
+	{
+		std::vector<UINT> pixels;
+		for (const char *row : rows) {
+			for (const char *pixel = row; *pixel; pixel++) {
+				pixels.push_back(ColorOf(*pixel));
+			}
+		}
+		return pixels;
+	}
+
+	inline void WriteUInt16(std::vector<BYTE> &gif, UINT value)
+	{
+		gif.push_back(static_cast<BYTE>(value & 0xFF));
+		gif.push_back(static_cast<BYTE>(value >> 8));
+	}
+
+	inline void WriteColorTable(std::vector<BYTE> &gif, const char *colors)
+	{
+		for (UINT i = 0; i < 8; i++) {
+			//The transparent entry and the unused entries get a color no frame uses.
+			UINT color = i < 5 ? ColorOf(colors[i]) : 0xFFFF00FF;
+			gif.push_back(static_cast<BYTE>(color >> 16));
+			gif.push_back(static_cast<BYTE>(color >> 8));
+			gif.push_back(static_cast<BYTE>(color));
+		}
+	}
+
+	/// <summary>
+	/// LZW compresses color indices and appends them to the GIF as data sub-blocks of at most subBlockSize bytes.
+	/// </summary>
+	inline void WriteImageData(std::vector<BYTE> &gif, const std::vector<BYTE> &indices, UINT subBlockSize)
+	{
+		std::vector<BYTE> data;
+		UINT32 bitBuffer = 0;
+		UINT bitCount = 0;
+		auto writeCode = [&](UINT code, UINT codeSize) {
+			bitBuffer |= code << bitCount;
+			bitCount += codeSize;
+			while (bitCount >= 8) {
+				data.push_back(static_cast<BYTE>(bitBuffer & 0xFF));
+				bitBuffer >>= 8;
+				bitCount -= 8;
+			}
+		};
+		const UINT clearCode = 1 << MINIMUM_CODE_SIZE;
+		UINT codeSize = MINIMUM_CODE_SIZE + 1;
+		UINT nextCode = clearCode + 2;
+		std::map<std::pair<UINT, BYTE>, UINT> table;
+		writeCode(clearCode, codeSize);
+		INT current = -1;
+		for (BYTE index : indices) {
+			if (current < 0) {
+				current = index;
+				continue;
+			}
+			auto entry = table.find({ current, index });
+			if (entry != table.end()) {
+				current = entry->second;
+				continue;
+			}
+			writeCode(current, codeSize);
+			if (nextCode < 4096) {
+				table[{ current, index }] = nextCode++;
+				//The decoder defines each code one step later than the encoder, so it switches to larger codes one step later.
+				if (nextCode - 1 == (1u << codeSize) && codeSize < 12) {
+					codeSize++;
+				}
+			}
+			else {
+				writeCode(clearCode, codeSize);
+				table.clear();
+				codeSize = MINIMUM_CODE_SIZE + 1;
+				nextCode = clearCode + 2;
+			}
+			current = index;
+		}
+		if (current >= 0) {
+			writeCode(current, codeSize);
+		}
+		writeCode(clearCode + 1, codeSize);
+		if (bitCount > 0) {
+			data.push_back(static_cast<BYTE>(bitBuffer & 0xFF));
+		}
+
+		gif.push_back(MINIMUM_CODE_SIZE);
+		for (size_t offset = 0; offset < data.size(); offset += subBlockSize) {
+			size_t blockSize = min(static_cast<size_t>(subBlockSize), data.size() - offset);
+			gif.push_back(static_cast<BYTE>(blockSize));
+			gif.insert(gif.end(), data.begin() + offset, data.begin() + offset + blockSize);
+		}
+		gif.push_back(0);
+	}
+
+	/// <summary>
+	/// Encodes an animated GIF. A loop count of -1 omits the looping extension.
+	/// </summary>
+	inline std::vector<BYTE> EncodeGif(UINT width, UINT height, INT loopCount, const std::vector<GIF_FIXTURE_FRAME> &frames, UINT subBlockSize = 255)
+	{
+		std::vector<BYTE> gif = { 'G', 'I', 'F', '8', '9', 'a' };
+		WriteUInt16(gif, width);
+		WriteUInt16(gif, height);
+		// Global color table of 8 entries, background color index and pixel aspect ratio
+		gif.insert(gif.end(), { 0xF2, 0, 0 });
+		WriteColorTable(gif, GLOBAL_COLORS);
+		if (loopCount >= 0) {
+			gif.insert(gif.end(), { 0x21, 0xFF, 11 });
+			gif.insert(gif.end(), { 'N', 'E', 'T', 'S', 'C', 'A', 'P', 'E', '2', '.', '0' });
+			gif.insert(gif.end(), { 3, 1 });
+			WriteUInt16(gif, loopCount);
+			gif.push_back(0);
+		}
+		for (const GIF_FIXTURE_FRAME &frame : frames) {
+			UINT frameWidth = static_cast<UINT>(strlen(frame.Rows[0]));
+			UINT frameHeight = static_cast<UINT>(frame.Rows.size());
+			const char *colors = frame.HasLocalColorTable ? LOCAL_COLORS : GLOBAL_COLORS;
+			std::vector<BYTE> indices;
+			bool hasTransparency = false;
+			std::vector<UINT> rowOrder;
+			if (frame.IsInterlaced) {
+				const UINT passStart[] = { 0, 4, 2, 1 };
+				const UINT passStep[] = { 8, 8, 4, 2 };
+				for (UINT pass = 0; pass < 4; pass++) {
+					for (UINT row = passStart[pass]; row < frameHeight; row += passStep[pass]) {
+						rowOrder.push_back(row);
+					}
+				}
+			}
+			else {
+				for (UINT row = 0; row < frameHeight; row++) {
+					rowOrder.push_back(row);
+				}
+			}
+			for (UINT row : rowOrder) {
+				for (const char *pixel = frame.Rows[row]; *pixel; pixel++) {
+					indices.push_back(static_cast<BYTE>(strchr(colors, *pixel) - colors));
+					hasTransparency |= *pixel == '.';
+				}
+			}
+
+			// Graphic control extension
+			gif.insert(gif.end(), { 0x21, 0xF9, 4, static_cast<BYTE>((frame.Disposal << 2) | (hasTransparency ? 1 : 0)) });
+			WriteUInt16(gif, frame.Delay);
+			gif.insert(gif.end(), { TRANSPARENT_INDEX, 0 });
+			// Image descriptor
+			gif.push_back(0x2C);
+			WriteUInt16(gif, frame.Left);
+			WriteUInt16(gif, frame.Top);
+			WriteUInt16(gif, frameWidth);
+			WriteUInt16(gif, frameHeight);
+			gif.push_back(static_cast<BYTE>((frame.HasLocalColorTable ? 0x82 : 0) | (frame.IsInterlaced ? 0x40 : 0)));
+			if (frame.HasLocalColorTable) {
+				WriteColorTable(gif, LOCAL_COLORS);
+			}
+			WriteImageData(gif, indices, subBlockSize);
+		}
+		gif.push_back(0x3B);
+		return gif;
+	}
+}
@@ -0,0 +1,188 @@
+#include "CppUnitTest.h"
+#include "LogQueue.h"
+#include <thread>
+#include <vector>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace NativeTests
+{
+	static bool PushMessage(LogQueue &queue, PCWSTR format, ...)
+	{
+		va_list args;
+		va_start(args, format);
+		bool isQueued = queue.TryPush(LOG_LVL_INFO, std::chrono::system_clock::now(), format, args);
+		va_end(args);
+		return isQueued;
+	}
+
+	static std::vector<std::wstring> DrainMessages(LogQueue &queue)
+	{
+		std::vector<std::wstring> messages;
+		queue.Drain([&](const LOG_RECORD &record) { messages.push_back(record.Message); });
+		return messages;
+	}
+
+	TEST_CLASS(LogQueueTests)
+	{
+	public:
+		TEST_METHOD(FormatsMessagesWhenTheyAreQueued)
+		{
+			LogQueue queue;
+			std::wstring text = L"temporary";
+			Assert::IsTrue(PushMessage(queue, L"%ls %d", text.c_str(), 1));
+			text = L"overwritten";
+			Assert::IsTrue(PushMessage(queue, L"second"));
+			Assert::AreEqual(2u, queue.GetCount());
+			std::vector<std::wstring> messages = DrainMessages(queue);
+			Assert::AreEqual(2u, static_cast<UINT>(messages.size()));
+			Assert::AreEqual(std::wstring(L"temporary 1"), messages[0]);
+			Assert::AreEqual(std::wstring(L"second"), messages[1]);
+			Assert::AreEqual(0u, queue.GetCount());
+		}
+
+		TEST_METHOD(DropsMessagesWhenFull)
+		{
+			LogQueue queue(4);
+			for (int i = 0; i < 4; i++) {
+				Assert::IsTrue(PushMessage(queue, L"%d", i));
+			}
+			Assert::IsFalse(PushMessage(queue, L"dropped"));
+			Assert::IsFalse(PushMessage(queue, L"dropped"));
+			Assert::AreEqual((UINT64)2, queue.GetDroppedCount());
+			Assert::AreEqual(std::wstring(L"0"), DrainMessages(queue)[0]);
+
+			//The queue wraps around once drained
+			for (int round = 0; round < 3; round++) {
+				Assert::IsTrue(PushMessage(queue, L"a%d", round));
+				Assert::IsTrue(PushMessage(queue, L"b%d", round));
+				Assert::IsTrue(PushMessage(queue, L"c%d", round));
+				std::vector<std::wstring> messages = DrainMessages(queue);
+				Assert::AreEqual(3u, static_cast<UINT>(messages.size()));
+				Assert::AreEqual(L"c" + std::to_wstring(round), messages[2]);
+			}
+			Assert::AreEqual((UINT64)2, queue.GetDroppedCount());
+		}
+
+		TEST_METHOD(HandsOverMessagesBetweenThreads)
+		{
+			const int messageCount = 100000;
+			LogQueue queue;
+			std::thread producer([&]() {
+				for (int i = 0; i < messageCount; i++) {
+					PushMessage(queue, L"%d", i);
+				}
+			});
+			int receivedCount = 0;
+			int lastMessage = -1;
+			bool isOrdered = true;
+			auto consume = [&](const LOG_RECORD &record) {
+				int message = _wtoi(record.Message);
+				isOrdered = isOrdered && message > lastMessage;
+				lastMessage = message;
+				receivedCount++;
+			};
+			while (receivedCount + queue.GetDroppedCount() < messageCount) {
+				if (queue.Drain(consume) == 0) {
+					std::this_thread::yield();
+				}
+			}
+			producer.join();
+			queue.Drain(consume);
+			Assert::IsTrue(isOrdered, L"Messages were reordered or corrupted");
+			Assert::AreEqual((UINT64)messageCount, receivedCount + queue.GetDroppedCount());
+		}
+
+		TEST_METHOD(WritesMessagesOfAllThreadsToTheLogFile)
+		{
+			wchar_t tempPath[MAX_PATH];
+			GetTempPathW(MAX_PATH, tempPath);
+			std::wstring path = std::wstring(tempPath) + L"LogQueueTests" + std::to_wstring(GetCurrentProcessId()) + L".log";
+			DeleteFileW(path.c_str());
+			bool wasLoggingEnabled = isLoggingEnabled;
+			int previousSeverityLevel = logSeverityLevel;
+			isLoggingEnabled = true;
+			logSeverityLevel = LOG_LVL_INFO;
+			SetLogFilePath(path);
+			UINT64 previousWrittenCount = GetLogStatistics().WrittenCount;
+
+			const int threadCount = 4;
+			const int messagesPerThread = 20;
+			std::vector<std::thread> threads;
+			for (int i = 0; i < threadCount; i++) {
+				threads.push_back(std::thread([i]() {
+					for (int j = 0; j < messagesPerThread; j++) {
+						LOG_INFO(L"Message %d from thread %d", j, i);
+					}
+					LOG_TRACE(L"Below the severity level");
+				}));
+			}
+			for (auto &thread : threads) {
+				thread.join();
+			}
+			FlushLog();
+
+			isLoggingEnabled = wasLoggingEnabled;
+			logSeverityLevel = previousSeverityLevel;
+			SetLogFilePath(L"");
+			Assert::AreEqual((UINT64)(threadCount * messagesPerThread), GetLogStatistics().WrittenCount - previousWrittenCount);
+			std::wifstream file(path);
+			std::wstring line;
+			int lineCount = 0;
+			while (std::getline(file, line)) {
+				Assert::IsTrue(line.find(L"[INFO]") != std::wstring::npos);
+				lineCount++;
+			}
+			file.close();
+			DeleteFileW(path.c_str());
+			Assert::AreEqual(threadCount * messagesPerThread, lineCount);
+		}
+
+		TEST_METHOD(SwitchesLogFileWhileLogging)
+		{
+			wchar_t tempPath[MAX_PATH];
+			GetTempPathW(MAX_PATH, tempPath);
+			std::wstring paths[2];
+			for (int i = 0; i < 2; i++) {
+				paths[i] = std::wstring(tempPath) + L"LogQueueTests" + std::to_wstring(GetCurrentProcessId()) + L"_" + std::to_wstring(i) + L".log";
+				DeleteFileW(paths[i].c_str());
+			}
+			bool wasLoggingEnabled = isLoggingEnabled;
+			int previousSeverityLevel = logSeverityLevel;
+			isLoggingEnabled = true;
+			logSeverityLevel = LOG_LVL_INFO;
+			UINT64 previousWrittenCount = GetLogStatistics().WrittenCount;
+
+			SetLogFilePath(paths[0]);
+			//Fewer messages than the queue holds, so none are dropped
+			const int messageCount = LOG_QUEUE_CAPACITY / 2;
+			std::thread logger([]() {
+				for (int i = 0; i < messageCount; i++) {
+					LOG_INFO(L"Message %d", i);
+				}
+			});
+			//The writer thread reads the path while it is changed
+			for (int i = 0; i < 50; i++) {
+				SetLogFilePath(paths[i % 2]);
+			}
+			logger.join();
+			FlushLog();
+			SetLogFilePath(L"");
+
+			isLoggingEnabled = wasLoggingEnabled;
+			logSeverityLevel = previousSeverityLevel;
+			Assert::AreEqual((UINT64)messageCount, GetLogStatistics().WrittenCount - previousWrittenCount);
+			int lineCount = 0;
+			for (int i = 0; i < 2; i++) {
+				std::wifstream file(paths[i]);
+				std::wstring line;
+				while (std::getline(file, line)) {
+					lineCount++;
+				}
+				file.close();
+				DeleteFileW(paths[i].c_str());
+			}
+			Assert::AreEqual(messageCount, lineCount);
+		}
+	};
+}
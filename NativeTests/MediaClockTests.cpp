@@ -0,0 +1,159 @@
+#include "CppUnitTest.h"
+#include "MediaClock.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace NativeTests
+{
+	static const MEDIA_RATE NTSC_FRAME_RATE{ 30000, 1001 };
+	static const MEDIA_RATE AUDIO_SAMPLE_RATE{ 48000, 1 };
+
+	TEST_CLASS(MediaClockTests)
+	{
+	public:
+		TEST_METHOD(VirtualClockDoesNotAdvanceWhilePaused)
+		{
+			VirtualMediaClock clock;
+			clock.Advance(5000);
+			Assert::AreEqual(0LL, clock.GetTime());
+			Assert::IsTrue(clock.GetState() == MediaClockState::Stopped);
+
+			clock.Start();
+			clock.Advance(1000);
+			Assert::AreEqual(1000LL, clock.GetTime());
+			clock.Pause();
+			Assert::IsTrue(clock.GetState() == MediaClockState::Paused);
+			clock.Advance(100000);
+			Assert::AreEqual(1000LL, clock.GetTime());
+			//Pausing again does not lose time
+			clock.Pause();
+			clock.Resume();
+			clock.Advance(500);
+			Assert::AreEqual(1500LL, clock.GetTime());
+			//Resuming a running clock has no effect
+			clock.Resume();
+			Assert::AreEqual(1500LL, clock.GetTime());
+
+			clock.Stop();
+			Assert::AreEqual(0LL, clock.GetTime());
+			clock.Resume();
+			Assert::IsTrue(clock.GetState() == MediaClockState::Stopped);
+			clock.Start();
+			clock.Advance(10);
+			Assert::AreEqual(10LL, clock.GetTime());
+		}
+
+		TEST_METHOD(SystemClockAdvances)
+		{
+			SystemMediaClock clock;
+			clock.Start();
+			INT64 start = clock.GetTime();
+			Assert::IsTrue(start >= 0);
+			Sleep(20);
+			Assert::IsTrue(clock.GetTime() - start >= 100000);
+			clock.Pause();
+			INT64 pausedTime = clock.GetTime();
+			Sleep(20);
+			Assert::AreEqual(pausedTime, clock.GetTime());
+		}
+
+		TEST_METHOD(FrameTimesOfFractionalRatesDoNotDrift)
+		{
+			Assert::AreEqual(333666LL, MediaTimeFromCount(1, NTSC_FRAME_RATE));
+			//30000 frames at 29.97 fps take exactly 1001 seconds
+			Assert::AreEqual(1001LL * MEDIA_TIME_UNITS_PER_SECOND, MediaTimeFromCount(30000, NTSC_FRAME_RATE));
+			INT64 totalDuration = 0;
+			for (INT64 i = 0; i < 30000; i++) {
+				totalDuration += MediaTimeFromCount(i + 1, NTSC_FRAME_RATE) - MediaTimeFromCount(i, NTSC_FRAME_RATE);
+			}
+			Assert::AreEqual(1001LL * MEDIA_TIME_UNITS_PER_SECOND, totalDuration);
+			//Ten days of audio samples do not overflow
+			Assert::AreEqual(864000LL * MEDIA_TIME_UNITS_PER_SECOND, MediaTimeFromCount(48000LL * 864000, AUDIO_SAMPLE_RATE));
+			Assert::AreEqual(0LL, MediaTimeFromCount(10, MEDIA_RATE{ 0, 1 }));
+		}
+
+		TEST_METHOD(CountsEventsStartingBeforeATime)
+		{
+			Assert::AreEqual(0LL, CountFromMediaTime(0, AUDIO_SAMPLE_RATE));
+			Assert::AreEqual(1LL, CountFromMediaTime(1, AUDIO_SAMPLE_RATE));
+			Assert::AreEqual(48000LL, CountFromMediaTime(MEDIA_TIME_UNITS_PER_SECOND, AUDIO_SAMPLE_RATE));
+			//The audio of a frame at 60 fps, of which the duration is rounded down
+			Assert::AreEqual(800LL, CountFromMediaTime(MediaTimeFromCount(1, MEDIA_RATE{ 60, 1 }), AUDIO_SAMPLE_RATE));
+			for (INT64 i = 0; i < 1000; i++) {
+				Assert::AreEqual(i, CountFromMediaTime(MediaTimeFromCount(i, NTSC_FRAME_RATE), NTSC_FRAME_RATE));
+			}
+		}
+
+		TEST_METHOD(PacesRecorderLoopFasterThanRealTime)
+		{
+			VirtualMediaClock clock;
+			const INT64 frameDuration = MediaTimeFromCount(1, MEDIA_RATE{ 30, 1 });
+			//Time each frame takes to capture and encode
+			const INT64 processingTime = 80000;
+			clock.Start();
+			INT64 lastFrameStartTime = 0;
+			INT64 totalDuration = 0;
+			int frameCount = 0;
+			//Ten minutes of recording, in a fraction of a second
+			while (clock.GetTime() < 600 * MEDIA_TIME_UNITS_PER_SECOND) {
+				clock.Advance(GetTimeUntilNextFrame(clock.GetTime(), lastFrameStartTime, frameDuration));
+				INT64 duration = clock.GetTime() - lastFrameStartTime;
+				Assert::IsTrue(duration >= frameDuration);
+				totalDuration += duration;
+				lastFrameStartTime += duration;
+				frameCount++;
+				clock.Advance(processingTime);
+			}
+			Assert::AreEqual(18000, frameCount);
+			Assert::AreEqual(clock.GetTime() - processingTime, totalDuration);
+			//A frame that took longer than its duration is followed by one that is due right away
+			clock.Advance(2 * frameDuration);
+			Assert::AreEqual(0LL, GetTimeUntilNextFrame(clock.GetTime(), lastFrameStartTime, frameDuration));
+		}
+
+		TEST_METHOD(FixedFrameRateFramesStartAtTheirFrameIndex)
+		{
+			VirtualMediaClock clock;
+			//Time each frame takes to capture and encode
+			const INT64 processingTime = 80000;
+			clock.Start();
+			INT64 lastFrameIndex = 0;
+			INT64 lastFrameStartTime = 0;
+			//Ten minutes of recording at 29.97 fps
+			while (clock.GetTime() < 600 * MEDIA_TIME_UNITS_PER_SECOND) {
+				INT64 nextFrameDuration = MediaTimeFromCount(lastFrameIndex + 1, NTSC_FRAME_RATE) - lastFrameStartTime;
+				clock.Advance(GetTimeUntilNextFrame(clock.GetTime(), lastFrameStartTime, nextFrameDuration));
+				INT64 frameIndex = FrameIndexFromMediaTime(clock.GetTime(), lastFrameIndex, NTSC_FRAME_RATE);
+				Assert::AreEqual(lastFrameIndex + 1, frameIndex);
+				lastFrameStartTime = MediaTimeFromCount(frameIndex, NTSC_FRAME_RATE);
+				lastFrameIndex = frameIndex;
+				clock.Advance(processingTime);
+			}
+			Assert::AreEqual(17982LL, lastFrameIndex);
+			Assert::AreEqual(MediaTimeFromCount(17982, NTSC_FRAME_RATE), lastFrameStartTime);
+			//A late frame takes the index nearest to its time, skipping the frames that were due before it
+			clock.Advance(2 * MediaTimeFromCount(1, NTSC_FRAME_RATE));
+			Assert::AreEqual(lastFrameIndex + 2, FrameIndexFromMediaTime(clock.GetTime(), lastFrameIndex, NTSC_FRAME_RATE));
+			//An early frame still takes the next index
+			Assert::AreEqual(lastFrameIndex + 1, FrameIndexFromMediaTime(lastFrameStartTime, lastFrameIndex, NTSC_FRAME_RATE));
+		}
+
+		TEST_METHOD(SchedulesSnapshotsOnMediaTime)
+		{
+			VirtualMediaClock clock;
+			const INT64 interval = 10 * MEDIA_TIME_UNITS_PER_SECOND;
+			clock.Start();
+			Assert::IsTrue(IsSnapshotDue(clock.GetTime(), std::nullopt, interval));
+			std::optional<INT64> previousSnapshotTime = clock.GetTime();
+			clock.Advance(interval);
+			Assert::IsFalse(IsSnapshotDue(clock.GetTime(), previousSnapshotTime, interval));
+			//Time spent paused does not count towards the interval
+			clock.Pause();
+			clock.Advance(interval);
+			Assert::IsFalse(IsSnapshotDue(clock.GetTime(), previousSnapshotTime, interval));
+			clock.Resume();
+			clock.Advance(1);
+			Assert::IsTrue(IsSnapshotDue(clock.GetTime(), previousSnapshotTime, interval));
+		}
+	};
+}
@@ -0,0 +1,119 @@
+#include "CppUnitTest.h"
+#include "MetricsRegistry.h"
+#include <thread>
+#include <vector>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace NativeTests
+{
+	TEST_CLASS(MetricsRegistryTests)
+	{
+	public:
+		TEST_METHOD(BucketsValuesWithinOneSixteenth)
+		{
+			for (INT64 value = 0; value < 32; value++) {
+				Assert::AreEqual(value, LatencyHistogram::GetBucketUpperBound(LatencyHistogram::GetBucketIndex(value)));
+			}
+			int previousIndex = 0;
+			for (INT64 value = 32; value < 0x4000000000000000LL; value += value / 7) {
+				int index = LatencyHistogram::GetBucketIndex(value);
+				INT64 upperBound = LatencyHistogram::GetBucketUpperBound(index);
+				Assert::IsTrue(index >= previousIndex);
+				Assert::IsTrue(upperBound >= value);
+				Assert::IsTrue(upperBound - value <= value / 16);
+				//The value just above the upper bound is in the next bucket
+				Assert::AreEqual(index + 1, LatencyHistogram::GetBucketIndex(upperBound + 1));
+				previousIndex = index;
+			}
+			Assert::AreEqual(LATENCY_HISTOGRAM_BUCKET_COUNT - 1, LatencyHistogram::GetBucketIndex(MAXLONGLONG));
+			Assert::AreEqual(0, LatencyHistogram::GetBucketIndex(-5));
+		}
+
+		TEST_METHOD(CalculatesPercentilesOfRecordedValues)
+		{
+			LatencyHistogram histogram;
+			Assert::AreEqual(0LL, histogram.GetSnapshot().Count);
+			for (INT64 value = 1000; value >= 1; value--) {
+				histogram.Record(value);
+			}
+			LATENCY_HISTOGRAM_SNAPSHOT snapshot = histogram.GetSnapshot();
+			Assert::AreEqual(1000LL, snapshot.Count);
+			Assert::AreEqual(500.5, snapshot.Mean);
+			Assert::AreEqual(1LL, snapshot.Min);
+			Assert::IsTrue(snapshot.P50 >= 500 && snapshot.P50 <= 500 + 500 / 16);
+			Assert::IsTrue(snapshot.P90 >= 900 && snapshot.P90 <= 900 + 900 / 16);
+			Assert::IsTrue(snapshot.P99 >= 990 && snapshot.P99 <= 990 + 990 / 16);
+			Assert::IsTrue(snapshot.Max >= 1000 && snapshot.Max <= 1000 + 1000 / 16);
+		}
+
+		TEST_METHOD(SnapshotHasMetricsOfEachSourceSortedByName)
+		{
+			MetricsRegistry registry;
+			registry.GetCounter(L"frames", L"Screen 2").Add(2);
+			registry.GetCounter(L"frames", L"Screen 1").Add();
+			//Looking up a metric again returns the same metric
+			registry.GetCounter(L"frames", L"Screen 1").Add(4);
+			registry.GetGauge(L"fps").Set(29.5);
+			registry.GetHistogram(L"encode_time").Record(100);
+
+			METRICS_SNAPSHOT snapshot = registry.GetSnapshot();
+			Assert::AreEqual(4u, static_cast<UINT>(snapshot.Metrics.size()));
+			Assert::AreEqual(std::wstring(L"encode_time"), snapshot.Metrics[0].Name);
+			Assert::AreEqual(std::wstring(L"fps"), snapshot.Metrics[1].Name);
+			Assert::AreEqual(std::wstring(L"Screen 1"), snapshot.Metrics[2].Source);
+			Assert::AreEqual(std::wstring(L"Screen 2"), snapshot.Metrics[3].Source);
+			Assert::AreEqual(5.0, snapshot.Find(L"frames", L"Screen 1")->Value);
+			Assert::AreEqual(2.0, snapshot.Find(L"frames", L"Screen 2")->Value);
+			Assert::AreEqual(29.5, snapshot.Find(L"fps")->Value);
+			Assert::IsTrue(snapshot.Find(L"encode_time")->Type == MetricType::Histogram);
+			Assert::AreEqual(1LL, snapshot.Find(L"encode_time")->Histogram.Count);
+			Assert::IsNull(snapshot.Find(L"frames"));
+		}
+
+		TEST_METHOD(CountsUpdatesFromManyThreadsWhileReading)
+		{
+			const int threadCount = 4;
+			const int updatesPerThread = 100000;
+			MetricsRegistry registry;
+			MetricCounter &counter = registry.GetCounter(L"frames");
+			LatencyHistogram &histogram = registry.GetHistogram(L"frame_time");
+			std::vector<std::thread> threads;
+			for (int i = 0; i < threadCount; i++) {
+				threads.push_back(std::thread([&]() {
+					for (int j = 0; j < updatesPerThread; j++) {
+						counter.Add();
+						histogram.Record(j);
+					}
+				}));
+			}
+			double previousCount = 0;
+			for (int i = 0; i < 10; i++) {
+				METRICS_SNAPSHOT snapshot = registry.GetSnapshot();
+				Assert::IsTrue(snapshot.Find(L"frames")->Value >= previousCount);
+				previousCount = snapshot.Find(L"frames")->Value;
+			}
+			for (auto &thread : threads) {
+				thread.join();
+			}
+			METRICS_SNAPSHOT snapshot = registry.GetSnapshot();
+			Assert::AreEqual(static_cast<double>(threadCount * updatesPerThread), snapshot.Find(L"frames")->Value);
+			Assert::AreEqual(static_cast<INT64>(threadCount * updatesPerThread), snapshot.Find(L"frame_time")->Histogram.Count);
+			Assert::AreEqual((updatesPerThread - 1) / 2.0, snapshot.Find(L"frame_time")->Histogram.Mean);
+		}
+
+		TEST_METHOD(LatencyTimerRecordsOnce)
+		{
+			LatencyHistogram histogram;
+			{
+				LatencyTimer timer(histogram);
+				Sleep(2);
+				timer.Stop();
+				timer.Stop();
+			}
+			LATENCY_HISTOGRAM_SNAPSHOT snapshot = histogram.GetSnapshot();
+			Assert::AreEqual(1LL, snapshot.Count);
+			Assert::IsTrue(snapshot.Max >= 20000);
+		}
+	};
+}
@@ -0,0 +1,154 @@
+#include "CppUnitTest.h"
+#include "MouseClickEvents.h"
+#include <thread>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace NativeTests
+{
+	static MOUSE_CLICK_EVENT ClickEvent(INT64 timeStamp, UINT button, bool isPressed)
+	{
+		MOUSE_CLICK_EVENT clickEvent{};
+		clickEvent.TimeStamp = timeStamp;
+		clickEvent.Button = button;
+		clickEvent.IsPressed = isPressed;
+		return clickEvent;
+	}
+
+	TEST_CLASS(MouseClickEventsTests)
+	{
+	public:
+		TEST_METHOD(QueueReturnsEventsInOrder)
+		{
+			MouseClickEventQueue queue;
+			//Wrap around the end of the buffer a few times
+			for (INT64 i = 0; i < (INT64)MouseClickEventQueue::CAPACITY * 3; i++) {
+				Assert::IsTrue(queue.TryPush(ClickEvent(i, VK_LBUTTON, i % 2 == 0)));
+				Assert::IsTrue(queue.TryPush(ClickEvent(i, VK_RBUTTON, i % 2 != 0)));
+				MOUSE_CLICK_EVENT clickEvent;
+				Assert::IsTrue(queue.TryPeek(&clickEvent));
+				Assert::AreEqual(i, clickEvent.TimeStamp);
+				Assert::IsTrue(queue.TryPop(&clickEvent));
+				Assert::AreEqual((UINT)VK_LBUTTON, clickEvent.Button);
+				Assert::AreEqual(i % 2 == 0, clickEvent.IsPressed);
+				Assert::IsTrue(queue.TryPop(&clickEvent));
+				Assert::AreEqual((UINT)VK_RBUTTON, clickEvent.Button);
+				Assert::IsFalse(queue.TryPop(&clickEvent));
+			}
+			Assert::AreEqual(0LL, queue.GetDroppedEventCount());
+		}
+
+		TEST_METHOD(FullQueueDropsNewEvents)
+		{
+			MouseClickEventQueue queue;
+			for (INT64 i = 0; i < (INT64)MouseClickEventQueue::CAPACITY; i++) {
+				Assert::IsTrue(queue.TryPush(ClickEvent(i, VK_LBUTTON, true)));
+			}
+			Assert::IsFalse(queue.TryPush(ClickEvent(-1, VK_LBUTTON, true)));
+			Assert::AreEqual(1LL, queue.GetDroppedEventCount());
+
+			MOUSE_CLICK_EVENT clickEvent;
+			Assert::IsTrue(queue.TryPop(&clickEvent));
+			Assert::AreEqual(0LL, clickEvent.TimeStamp);
+			Assert::IsTrue(queue.TryPush(ClickEvent((INT64)MouseClickEventQueue::CAPACITY, VK_LBUTTON, true)));
+
+			queue.Clear();
+			Assert::IsFalse(queue.TryPeek(&clickEvent));
+			Assert::IsTrue(queue.TryPush(ClickEvent(0, VK_LBUTTON, true)));
+		}
+
+		TEST_METHOD(QueueHandsOverEventsBetweenThreads)
+		{
+			const INT64 eventCount = 200000;
+			MouseClickEventQueue queue;
+			std::thread producer([&]() {
+				for (INT64 i = 0; i < eventCount; i++) {
+					while (!queue.TryPush(ClickEvent(i, i % 2 == 0 ? VK_LBUTTON : VK_RBUTTON, true))) {
+						std::this_thread::yield();
+					}
+				}
+			});
+			INT64 expected = 0;
+			while (expected < eventCount) {
+				MOUSE_CLICK_EVENT clickEvent;
+				if (!queue.TryPop(&clickEvent)) {
+					std::this_thread::yield();
+					continue;
+				}
+				if (clickEvent.TimeStamp != expected || clickEvent.Button != (expected % 2 == 0 ? VK_LBUTTON : VK_RBUTTON)) {
+					producer.join();
+					Assert::Fail(L"Events were reordered or corrupted");
+				}
+				expected++;
+			}
+			producer.join();
+		}
+
+		TEST_METHOD(ClickIsDrawnFromTheFrameItHappened)
+		{
+			MouseClickEventQueue queue;
+			MouseClickTracker tracker;
+			const INT64 duration = 50;
+			queue.TryPush(ClickEvent(100, VK_LBUTTON, true));
+			queue.TryPush(ClickEvent(110, VK_LBUTTON, false));
+
+			tracker.Update(queue, 90);
+			Assert::AreEqual(0u, tracker.GetClickedButton(90, duration));
+
+			tracker.Update(queue, 105);
+			Assert::AreEqual((UINT)VK_LBUTTON, tracker.GetClickedButton(105, duration));
+
+			//Released, but still drawn for the click duration
+			tracker.Update(queue, 150);
+			Assert::AreEqual((UINT)VK_LBUTTON, tracker.GetClickedButton(150, duration));
+
+			tracker.Update(queue, 160);
+			Assert::AreEqual(0u, tracker.GetClickedButton(160, duration));
+		}
+
+		TEST_METHOD(ClickBetweenFramesIsDrawn)
+		{
+			MouseClickEventQueue queue;
+			MouseClickTracker tracker;
+			queue.TryPush(ClickEvent(101, VK_RBUTTON, true));
+			queue.TryPush(ClickEvent(102, VK_RBUTTON, false));
+			tracker.Update(queue, 133);
+			Assert::AreEqual((UINT)VK_RBUTTON, tracker.GetClickedButton(133, 50));
+		}
+
+		TEST_METHOD(HeldButtonIsDrawnUntilReleased)
+		{
+			MouseClickEventQueue queue;
+			MouseClickTracker tracker;
+			queue.TryPush(ClickEvent(100, VK_LBUTTON, true));
+			tracker.Update(queue, 100);
+			tracker.Update(queue, 10000);
+			Assert::AreEqual((UINT)VK_LBUTTON, tracker.GetClickedButton(10000, 50));
+
+			//Releasing another button does not end the click
+			queue.TryPush(ClickEvent(10001, VK_RBUTTON, false));
+			tracker.Update(queue, 20000);
+			Assert::AreEqual((UINT)VK_LBUTTON, tracker.GetClickedButton(20000, 50));
+
+			queue.TryPush(ClickEvent(20001, VK_LBUTTON, false));
+			tracker.Update(queue, 20100);
+			Assert::AreEqual(0u, tracker.GetClickedButton(20100, 50));
+		}
+
+		TEST_METHOD(DroppedEventsReleaseHeldButton)
+		{
+			MouseClickEventQueue queue;
+			MouseClickTracker tracker;
+			queue.TryPush(ClickEvent(1, VK_LBUTTON, true));
+			tracker.Update(queue, 1);
+			Assert::AreEqual((UINT)VK_LBUTTON, tracker.GetClickedButton(1, 50));
+			for (INT64 i = 0; i <= (INT64)MouseClickEventQueue::CAPACITY; i++) {
+				queue.TryPush(ClickEvent(1000 + i, VK_RBUTTON, i % 2 == 0));
+			}
+			Assert::AreEqual(1LL, queue.GetDroppedEventCount());
+			//Only consume events up to a time before any of the new ones, so the held button is released by the dropped events alone
+			tracker.Update(queue, 2);
+			Assert::AreEqual(0u, tracker.GetClickedButton(2, 50));
+		}
+	};
+}
@@ -0,0 +1,102 @@
+#include "CppUnitTest.h"
+#include "..\NativeSoak\SoakTrend.h"
+#include <vector>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace NativeTests
+{
+	TEST_CLASS(SoakTrendTests)
+	{
+	public:
+		TEST_METHOD(CalculatesMedianOfOddAndEvenCounts)
+		{
+			Assert::AreEqual(0.0, Median({}));
+			Assert::AreEqual(3.0, Median({ 5, 1, 3 }));
+			Assert::AreEqual(2.5, Median({ 4, 1, 3, 2 }));
+		}
+
+		TEST_METHOD(EstimatesSlopeOfLine)
+		{
+			std::vector<double> times{ 0, 1, 2, 3, 4 };
+			std::vector<double> values{ 10, 12, 14, 16, 18 };
+			Assert::AreEqual(2.0, TheilSenSlope(times, values), 1e-9);
+			//Samples at the same time have no slope between them
+			Assert::AreEqual(0.0, TheilSenSlope({ 1, 1 }, { 0, 5 }));
+		}
+
+		TEST_METHOD(IgnoresOutliersWhenEstimatingSlope)
+		{
+			std::vector<double> times;
+			std::vector<double> values;
+			for (int i = 0; i < 20; i++) {
+				times.push_back(i);
+				values.push_back(100);
+			}
+			//A few latency spikes late in the run would tilt a least squares fit
+			values[17] = 1000;
+			values[19] = 2000;
+			Assert::AreEqual(0.0, TheilSenSlope(times, values), 1e-9);
+			SOAK_TREND_RESULT result = AnalyzeTrend(times, values, SOAK_TREND_THRESHOLD(0.1, 1));
+			Assert::IsTrue(result.IsEvaluated);
+			Assert::IsFalse(result.IsRegression);
+			Assert::AreEqual(100.0, result.Baseline, 1e-9);
+		}
+
+		TEST_METHOD(FlagsSteadyGrowthAboveThreshold)
+		{
+			std::vector<double> times;
+			std::vector<double> values;
+			for (int i = 0; i <= 24; i++) {
+				times.push_back(i);
+				values.push_back(200 + 2.0 * i);
+			}
+			//Grows 36 over the 18 hours after the warm-up, from a baseline of 212
+			SOAK_TREND_RESULT result = AnalyzeTrend(times, values, SOAK_TREND_THRESHOLD(0.1, 10, 0.25));
+			Assert::IsTrue(result.IsEvaluated);
+			Assert::AreEqual(static_cast<size_t>(19), result.SampleCount);
+			Assert::AreEqual(2.0, result.Slope, 1e-9);
+			Assert::AreEqual(212.0, result.Baseline, 1e-9);
+			Assert::AreEqual(36.0, result.Growth, 1e-9);
+			Assert::IsTrue(result.IsRegression);
+
+			//Below the relative threshold
+			Assert::IsFalse(AnalyzeTrend(times, values, SOAK_TREND_THRESHOLD(0.2, 10, 0.25)).IsRegression);
+			//Below the absolute threshold
+			Assert::IsFalse(AnalyzeTrend(times, values, SOAK_TREND_THRESHOLD(0.1, 40, 0.25)).IsRegression);
+		}
+
+		TEST_METHOD(SkipsWarmupSamples)
+		{
+			//Memory grows while caches fill in the first hours, and is flat after
+			std::vector<double> times;
+			std::vector<double> values;
+			for (int i = 0; i < 24; i++) {
+				times.push_back(i);
+				values.push_back(i < 12 ? 100 + 25.0 * i : 400);
+			}
+			Assert::IsTrue(AnalyzeTrend(times, values, SOAK_TREND_THRESHOLD(0.1, 1, 0)).IsRegression);
+			SOAK_TREND_RESULT result = AnalyzeTrend(times, values, SOAK_TREND_THRESHOLD(0.1, 1, 0.5));
+			Assert::IsFalse(result.IsRegression);
+			Assert::AreEqual(0.0, result.Growth, 1e-9);
+		}
+
+		TEST_METHOD(DoesNotFlagShrinkingMetric)
+		{
+			std::vector<double> times{ 0, 1, 2, 3, 4, 5, 6, 7 };
+			std::vector<double> values{ 80, 70, 60, 50, 40, 30, 20, 10 };
+			SOAK_TREND_RESULT result = AnalyzeTrend(times, values, SOAK_TREND_THRESHOLD(0, 0, 0));
+			Assert::IsTrue(result.Growth < 0);
+			Assert::IsFalse(result.IsRegression);
+		}
+
+		TEST_METHOD(NeedsSamplesAfterWarmup)
+		{
+			SOAK_TREND_RESULT result = AnalyzeTrend({ 0, 1, 2 }, { 1, 100, 1000 }, SOAK_TREND_THRESHOLD(0, 0, 0.5));
+			Assert::IsFalse(result.IsEvaluated);
+			Assert::IsFalse(result.IsRegression);
+			Assert::AreEqual(static_cast<size_t>(2), result.SampleCount);
+			Assert::IsFalse(AnalyzeTrend({}, {}, SOAK_TREND_THRESHOLD()).IsEvaluated);
+		}
+	};
+}
@@ -0,0 +1,5 @@
+#include "Log.h"
+
+// The logging globals are defined by RecordingManager in the library, which is not part of the tests.
+bool isLoggingEnabled = false;
+int logSeverityLevel = LOG_LVL_INFO;
@@ -0,0 +1,108 @@
+#include "CppUnitTest.h"
+#include "TestPattern.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace NativeTests
+{
+	static TEST_PATTERN_OPTIONS CreateOptions(TestPatternMode mode, UINT32 seed = 1)
+	{
+		TEST_PATTERN_OPTIONS options;
+		options.Mode = mode;
+		options.Size = SIZE{ 320, 240 };
+		options.FrameRate = 30;
+		options.DirtyRectCount = 3;
+		options.Seed = seed;
+		return options;
+	}
+
+	TEST_CLASS(TestPatternTests)
+	{
+	public:
+		TEST_METHOD(RendersTheSameFramesForTheSameOptions)
+		{
+			for (TestPatternMode mode : { TestPatternMode::MovingBars, TestPatternMode::ScrollingText, TestPatternMode::Noise, TestPatternMode::DirtyRects }) {
+				TestPatternGenerator first(CreateOptions(mode));
+				TestPatternGenerator second(CreateOptions(mode));
+				std::vector<RECT> dirtyRects;
+				//Frames are the same even when one generator skips frames
+				for (UINT64 frame = 0; frame < 6; frame++) {
+					first.RenderFrame(frame, &dirtyRects);
+				}
+				second.RenderFrame(0, &dirtyRects);
+				second.RenderFrame(3, &dirtyRects);
+				second.RenderFrame(5, &dirtyRects);
+				Assert::IsTrue(first.GetPixels() == second.GetPixels());
+			}
+		}
+
+		TEST_METHOD(ChangesContentEveryFrame)
+		{
+			for (TestPatternMode mode : { TestPatternMode::MovingBars, TestPatternMode::ScrollingText, TestPatternMode::Noise }) {
+				TestPatternGenerator generator(CreateOptions(mode));
+				std::vector<RECT> dirtyRects;
+				generator.RenderFrame(0, &dirtyRects);
+				std::vector<UINT> previous = generator.GetPixels();
+				generator.RenderFrame(1, &dirtyRects);
+				Assert::IsFalse(previous == generator.GetPixels());
+				Assert::AreEqual(static_cast<size_t>(1), dirtyRects.size());
+				Assert::AreEqual(320L, dirtyRects[0].right);
+				Assert::AreEqual(240L, dirtyRects[0].bottom);
+			}
+			TestPatternGenerator noise(CreateOptions(TestPatternMode::Noise, 1));
+			TestPatternGenerator otherNoise(CreateOptions(TestPatternMode::Noise, 2));
+			std::vector<RECT> dirtyRects;
+			noise.RenderFrame(0, &dirtyRects);
+			otherNoise.RenderFrame(0, &dirtyRects);
+			Assert::IsFalse(noise.GetPixels() == otherNoise.GetPixels());
+		}
+
+		TEST_METHOD(OnlyChangesTheDirtyRects)
+		{
+			TestPatternGenerator generator(CreateOptions(TestPatternMode::DirtyRects));
+			std::vector<RECT> dirtyRects;
+			generator.RenderFrame(0, &dirtyRects);
+			Assert::AreEqual(static_cast<size_t>(1), dirtyRects.size());
+			std::vector<UINT> previous = generator.GetPixels();
+
+			generator.RenderFrame(1, &dirtyRects);
+			//The rectangles of the previous frame are restored and the new ones are drawn
+			Assert::AreEqual(static_cast<size_t>(6), dirtyRects.size());
+			const std::vector<UINT> &pixels = generator.GetPixels();
+			bool isAnyChanged = false;
+			for (LONG y = 0; y < 240; y++) {
+				for (LONG x = 0; x < 320; x++) {
+					size_t i = static_cast<size_t>(y) * 320 + x;
+					if (pixels[i] == previous[i]) {
+						continue;
+					}
+					isAnyChanged = true;
+					POINT point{ x, y };
+					bool isInDirtyRect = false;
+					for (const RECT &rect : dirtyRects) {
+						isInDirtyRect |= PtInRect(&rect, point) != FALSE;
+					}
+					Assert::IsTrue(isInDirtyRect);
+				}
+			}
+			Assert::IsTrue(isAnyChanged);
+
+			generator.RenderFrame(1, &dirtyRects);
+			Assert::IsTrue(dirtyRects.empty());
+		}
+
+		TEST_METHOD(KeepsThePointerInsideTheFrame)
+		{
+			TestPatternGenerator generator(CreateOptions(TestPatternMode::MovingBars));
+			for (UINT64 frame = 0; frame < 30 * 15; frame += 7) {
+				POINT position = generator.GetPointerPosition(frame);
+				Assert::IsTrue(position.x >= 0 && position.x < 320);
+				Assert::IsTrue(position.y >= 0 && position.y < 240);
+			}
+			SIZE shapeSize;
+			std::vector<UINT> shape = TestPatternGenerator::CreatePointerShape(&shapeSize);
+			Assert::AreEqual(static_cast<size_t>(shapeSize.cx * shapeSize.cy), shape.size());
+			Assert::AreEqual(0xFF000000u, shape[0]);
+		}
+	};
+}
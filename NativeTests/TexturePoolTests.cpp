@@ -0,0 +1,251 @@
+#include "CppUnitTest.h"
+#include "TexturePool.h"
+#include <atomic>
+#include <vector>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace NativeTests
+{
+	//
+	// Texture that only counts references, so the pool can be tested without a device.
+	//
+	class FakeTexture : public ID3D11Texture2D
+	{
+	public:
+		FakeTexture(_In_ const D3D11_TEXTURE2D_DESC &desc) : m_RefCount(1), m_Desc(desc) {}
+		HRESULT STDMETHODCALLTYPE QueryInterface(REFIID, void **ppObject) override { *ppObject = nullptr; return E_NOINTERFACE; }
+		ULONG STDMETHODCALLTYPE AddRef() override { return ++m_RefCount; }
+		ULONG STDMETHODCALLTYPE Release() override
+		{
+			ULONG refCount = --m_RefCount;
+			if (refCount == 0) {
+				delete this;
+			}
+			return refCount;
+		}
+		void STDMETHODCALLTYPE GetDevice(ID3D11Device **ppDevice) override { *ppDevice = nullptr; }
+		HRESULT STDMETHODCALLTYPE GetPrivateData(REFGUID, UINT *, void *) override { return E_NOTIMPL; }
+		HRESULT STDMETHODCALLTYPE SetPrivateData(REFGUID, UINT, const void *) override { return E_NOTIMPL; }
+		HRESULT STDMETHODCALLTYPE SetPrivateDataInterface(REFGUID, const IUnknown *) override { return E_NOTIMPL; }
+		void STDMETHODCALLTYPE GetType(D3D11_RESOURCE_DIMENSION *pDimension) override { *pDimension = D3D11_RESOURCE_DIMENSION_TEXTURE2D; }
+		void STDMETHODCALLTYPE SetEvictionPriority(UINT) override {}
+		UINT STDMETHODCALLTYPE GetEvictionPriority() override { return 0; }
+		void STDMETHODCALLTYPE GetDesc(D3D11_TEXTURE2D_DESC *pDesc) override { *pDesc = m_Desc; }
+	private:
+		std::atomic<ULONG> m_RefCount;
+		D3D11_TEXTURE2D_DESC m_Desc;
+	};
+
+	// A BGRA texture of 4 bytes per pixel
+	static D3D11_TEXTURE2D_DESC TextureDesc(UINT width, UINT height)
+	{
+		D3D11_TEXTURE2D_DESC desc{};
+		desc.Width = width;
+		desc.Height = height;
+		desc.MipLevels = 1;
+		desc.ArraySize = 1;
+		desc.Format = DXGI_FORMAT_B8G8R8A8_UNORM;
+		desc.SampleDesc.Count = 1;
+		desc.Usage = D3D11_USAGE_DEFAULT;
+		desc.BindFlags = D3D11_BIND_RENDER_TARGET | D3D11_BIND_SHADER_RESOURCE;
+		return desc;
+	}
+
+	// The pool only uses devices as keys when textures are made by a factory, so any distinct pointers will do
+	static ID3D11Device *const DeviceA = reinterpret_cast<ID3D11Device *>(0x1000);
+	static ID3D11Device *const DeviceB = reinterpret_cast<ID3D11Device *>(0x2000);
+
+	static TexturePool::TextureFactory FakeFactory(_Inout_ int *pCreatedCount)
+	{
+		return [pCreatedCount](ID3D11Device *, const D3D11_TEXTURE2D_DESC &desc, ID3D11Texture2D **ppTexture) {
+			(*pCreatedCount)++;
+			*ppTexture = new FakeTexture(desc);
+			return S_OK;
+		};
+	}
+
+	TEST_CLASS(TexturePoolTests)
+	{
+	public:
+		TEST_METHOD(ReusesReleasedTexture)
+		{
+			int createdCount = 0;
+			TexturePool pool(1000, FakeFactory(&createdCount));
+			CComPtr<ID3D11Texture2D> pFirst;
+			Assert::AreEqual(S_OK, pool.Acquire(DeviceA, TextureDesc(10, 10), &pFirst));
+			ID3D11Texture2D *pFirstTexture = pFirst;
+			pFirst.Release();
+			CComPtr<ID3D11Texture2D> pSecond;
+			Assert::AreEqual(S_OK, pool.Acquire(DeviceA, TextureDesc(10, 10), &pSecond));
+			Assert::IsTrue(pSecond == pFirstTexture);
+			Assert::AreEqual(1, createdCount);
+
+			TEXTURE_POOL_STATISTICS statistics = pool.GetStatistics();
+			Assert::AreEqual(static_cast<UINT64>(1), statistics.Hits);
+			Assert::AreEqual(static_cast<UINT64>(1), statistics.Misses);
+			Assert::AreEqual(static_cast<UINT64>(0), statistics.Evictions);
+			Assert::AreEqual(1u, statistics.TextureCount);
+			Assert::AreEqual(static_cast<size_t>(400), statistics.SizeInBytes);
+		}
+
+		TEST_METHOD(NeverHandsOutTextureInUse)
+		{
+			int createdCount = 0;
+			TexturePool pool(10000, FakeFactory(&createdCount));
+			//Like frames queued in the encoder, all three are held at the same time
+			std::vector<CComPtr<ID3D11Texture2D>> textures(3);
+			for (CComPtr<ID3D11Texture2D> &pTexture : textures) {
+				Assert::AreEqual(S_OK, pool.Acquire(DeviceA, TextureDesc(10, 10), &pTexture));
+			}
+			Assert::IsTrue(textures[0] != textures[1]);
+			Assert::IsTrue(textures[1] != textures[2]);
+			Assert::IsTrue(textures[0] != textures[2]);
+			Assert::AreEqual(3, createdCount);
+
+			ID3D11Texture2D *pReleasedTexture = textures[1];
+			textures[1].Release();
+			CComPtr<ID3D11Texture2D> pReused;
+			Assert::AreEqual(S_OK, pool.Acquire(DeviceA, TextureDesc(10, 10), &pReused));
+			Assert::IsTrue(pReused == pReleasedTexture);
+			Assert::AreEqual(3, createdCount);
+		}
+
+		TEST_METHOD(KeysTexturesByDeviceAndDescription)
+		{
+			int createdCount = 0;
+			TexturePool pool(10000, FakeFactory(&createdCount));
+			D3D11_TEXTURE2D_DESC stagingDesc = TextureDesc(10, 10);
+			stagingDesc.Usage = D3D11_USAGE_STAGING;
+			stagingDesc.BindFlags = 0;
+			stagingDesc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+			for (int i = 0; i < 2; i++) {
+				CComPtr<ID3D11Texture2D> pTexture;
+				pool.Acquire(DeviceA, TextureDesc(10, 10), &pTexture);
+				pTexture.Release();
+				pool.Acquire(DeviceB, TextureDesc(10, 10), &pTexture);
+				pTexture.Release();
+				pool.Acquire(DeviceA, TextureDesc(20, 10), &pTexture);
+				pTexture.Release();
+				pool.Acquire(DeviceA, stagingDesc, &pTexture);
+			}
+			Assert::AreEqual(4, createdCount);
+			Assert::AreEqual(static_cast<UINT64>(4), pool.GetStatistics().Hits);
+		}
+
+		TEST_METHOD(EvictsLeastRecentlyUsedOverBudget)
+		{
+			int createdCount = 0;
+			TexturePool pool(1000, FakeFactory(&createdCount));
+			CComPtr<ID3D11Texture2D> pTexture;
+			pool.Acquire(DeviceA, TextureDesc(10, 10), &pTexture);
+			pTexture.Release();
+			pool.Acquire(DeviceA, TextureDesc(10, 11), &pTexture);
+			pTexture.Release();
+			//Using the first texture makes the second the least recently used
+			pool.Acquire(DeviceA, TextureDesc(10, 10), &pTexture);
+			pTexture.Release();
+			pool.Acquire(DeviceA, TextureDesc(10, 12), &pTexture);
+			pTexture.Release();
+			TEXTURE_POOL_STATISTICS statistics = pool.GetStatistics();
+			Assert::AreEqual(static_cast<UINT64>(1), statistics.Evictions);
+			Assert::AreEqual(2u, statistics.TextureCount);
+			Assert::AreEqual(static_cast<size_t>(880), statistics.SizeInBytes);
+
+			pool.Acquire(DeviceA, TextureDesc(10, 10), &pTexture);
+			pTexture.Release();
+			Assert::AreEqual(3, createdCount);
+			pool.Acquire(DeviceA, TextureDesc(10, 11), &pTexture);
+			pTexture.Release();
+			Assert::AreEqual(4, createdCount);
+		}
+
+		TEST_METHOD(EvictedTextureStaysValidWhileInUse)
+		{
+			int createdCount = 0;
+			TexturePool pool(500, FakeFactory(&createdCount));
+			CComPtr<ID3D11Texture2D> pHeld;
+			pool.Acquire(DeviceA, TextureDesc(10, 10), &pHeld);
+			CComPtr<ID3D11Texture2D> pOther;
+			pool.Acquire(DeviceA, TextureDesc(10, 11), &pOther);
+			Assert::AreEqual(static_cast<UINT64>(1), pool.GetStatistics().Evictions);
+			//The pool dropped its reference, so the holder has the last one
+			Assert::AreEqual(2ul, pHeld.p->AddRef());
+			pHeld.p->Release();
+			D3D11_TEXTURE2D_DESC desc;
+			pHeld->GetDesc(&desc);
+			Assert::AreEqual(10u, desc.Height);
+		}
+
+		TEST_METHOD(DoesNotPoolTextureLargerThanBudget)
+		{
+			int createdCount = 0;
+			TexturePool pool(100, FakeFactory(&createdCount));
+			CComPtr<ID3D11Texture2D> pTexture;
+			Assert::AreEqual(S_OK, pool.Acquire(DeviceA, TextureDesc(10, 10), &pTexture));
+			Assert::IsTrue(pTexture != nullptr);
+			Assert::AreEqual(0u, pool.GetStatistics().TextureCount);
+		}
+
+		TEST_METHOD(ClearsTexturesOfDevice)
+		{
+			int createdCount = 0;
+			TexturePool pool(10000, FakeFactory(&createdCount));
+			CComPtr<ID3D11Texture2D> pTexture;
+			pool.Acquire(DeviceA, TextureDesc(10, 10), &pTexture);
+			pTexture.Release();
+			pool.Acquire(DeviceB, TextureDesc(10, 10), &pTexture);
+			pTexture.Release();
+			pool.Clear(DeviceA);
+			TEXTURE_POOL_STATISTICS statistics = pool.GetStatistics();
+			Assert::AreEqual(1u, statistics.TextureCount);
+			Assert::AreEqual(static_cast<size_t>(400), statistics.SizeInBytes);
+			pool.Acquire(DeviceB, TextureDesc(10, 10), &pTexture);
+			pTexture.Release();
+			Assert::AreEqual(2, createdCount);
+			pool.Clear();
+			Assert::AreEqual(0u, pool.GetStatistics().TextureCount);
+		}
+
+		TEST_METHOD(PassesOnFactoryFailure)
+		{
+			TexturePool pool(1000, [](ID3D11Device *, const D3D11_TEXTURE2D_DESC &, ID3D11Texture2D **) { return E_OUTOFMEMORY; });
+			CComPtr<ID3D11Texture2D> pTexture;
+			Assert::AreEqual(E_OUTOFMEMORY, pool.Acquire(DeviceA, TextureDesc(10, 10), &pTexture));
+			Assert::IsTrue(pTexture == nullptr);
+			Assert::AreEqual(0u, pool.GetStatistics().TextureCount);
+		}
+
+		TEST_METHOD(EstimatesTextureSize)
+		{
+			Assert::AreEqual(static_cast<size_t>(1920 * 1080 * 4), TexturePool::GetTextureSizeInBytes(TextureDesc(1920, 1080)));
+			D3D11_TEXTURE2D_DESC desc = TextureDesc(1920, 1080);
+			desc.Format = DXGI_FORMAT_NV12;
+			Assert::AreEqual(static_cast<size_t>(1920 * 1080 * 3 / 2), TexturePool::GetTextureSizeInBytes(desc));
+			//4x4, 2x2 and 1x1 mip levels
+			desc = TextureDesc(4, 4);
+			desc.MipLevels = 0;
+			Assert::AreEqual(static_cast<size_t>((16 + 4 + 1) * 4), TexturePool::GetTextureSizeInBytes(desc));
+		}
+
+		TEST_METHOD(HashesAndComparesEveryField)
+		{
+			TEXTURE_POOL_KEY key{ DeviceA, TextureDesc(10, 10) };
+			TEXTURE_POOL_KEY same{ DeviceA, TextureDesc(10, 10) };
+			Assert::IsTrue(key == same);
+			Assert::AreEqual(TexturePoolKeyHasher()(key), TexturePoolKeyHasher()(same));
+
+			TEXTURE_POOL_KEY other = key;
+			other.Desc.MiscFlags = D3D11_RESOURCE_MISC_SHARED;
+			Assert::IsFalse(key == other);
+			Assert::AreNotEqual(TexturePoolKeyHasher()(key), TexturePoolKeyHasher()(other));
+			other = key;
+			other.Device = DeviceB;
+			Assert::IsFalse(key == other);
+			//Width and height are hashed separately, so swapped sizes do not collide
+			TEXTURE_POOL_KEY swapped{ DeviceA, TextureDesc(20, 10) };
+			TEXTURE_POOL_KEY transposed{ DeviceA, TextureDesc(10, 20) };
+			Assert::AreNotEqual(TexturePoolKeyHasher()(swapped), TexturePoolKeyHasher()(transposed));
+		}
+	};
+}
@@ -0,0 +1,114 @@
+#include "CppUnitTest.h"
+#include "TraceRecorder.h"
+#include <sstream>
+#include <thread>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace NativeTests
+{
+	static INT64 GetQPCTime()
+	{
+		LARGE_INTEGER time;
+		QueryPerformanceCounter(&time);
+		return time.QuadPart;
+	}
+
+	static std::string WriteTrace()
+	{
+		std::stringstream stream;
+		Assert::AreEqual(S_OK, TraceRecorder::Instance().Write(stream));
+		return stream.str();
+	}
+
+	static bool Contains(const std::string &text, const std::string &value)
+	{
+		return text.find(value) != std::string::npos;
+	}
+
+	TEST_CLASS(TraceRecorderTests)
+	{
+	public:
+		TEST_METHOD(RecordsSpansOfEachThreadWithFrameNumbers)
+		{
+			TraceRecorder &recorder = TraceRecorder::Instance();
+			recorder.Start();
+			recorder.SetThreadName("Test \"main\"");
+			recorder.SetFrameNumber(7);
+			{
+				TRACE_SPAN("Compose");
+			}
+			std::thread worker([&]() {
+				recorder.SetThreadName("Worker");
+				INT64 now = GetQPCTime();
+				recorder.RecordSpan("Encode", now, now + 10);
+				recorder.RecordSpan("Encode", now + 10, now + 20);
+			});
+			worker.join();
+			recorder.Stop();
+			{
+				TRACE_SPAN("AfterStop");
+			}
+
+			TRACE_STATISTICS statistics = recorder.GetStatistics();
+			Assert::AreEqual(3LL, statistics.EventCount);
+			Assert::AreEqual(2LL, statistics.ThreadCount);
+			Assert::AreEqual(0LL, statistics.DroppedEventCount);
+			std::string trace = WriteTrace();
+			Assert::IsTrue(Contains(trace, "{\"traceEvents\":["));
+			Assert::IsTrue(Contains(trace, "{\"name\":\"Compose\",\"cat\":\"pipeline\",\"ph\":\"X\""));
+			Assert::IsTrue(Contains(trace, "\"args\":{\"frame\":7}}"));
+			Assert::IsTrue(Contains(trace, "\"args\":{\"name\":\"Test \\\"main\\\"\"}}"));
+			Assert::IsTrue(Contains(trace, "\"args\":{\"name\":\"Worker\"}}"));
+			Assert::IsFalse(Contains(trace, "AfterStop"));
+			Assert::IsTrue(Contains(trace, "],\"displayTimeUnit\":\"ms\"}"));
+		}
+
+		TEST_METHOD(WritesTimesInMicroseconds)
+		{
+			LARGE_INTEGER frequency;
+			QueryPerformanceFrequency(&frequency);
+			TraceRecorder &recorder = TraceRecorder::Instance();
+			recorder.Start();
+			INT64 now = GetQPCTime();
+			recorder.RecordSpan("OneMillisecond", now, now + frequency.QuadPart / 1000);
+			recorder.Stop();
+			Assert::IsTrue(Contains(WriteTrace(), "\"dur\":1000.000,"));
+		}
+
+		TEST_METHOD(StartDiscardsThePreviousTrace)
+		{
+			TraceRecorder &recorder = TraceRecorder::Instance();
+			recorder.Start();
+			{
+				TRACE_SPAN("First");
+			}
+			recorder.Start();
+			{
+				TraceSpan span("Second");
+				span.End();
+				//Ending the span twice records it once
+				span.End();
+			}
+			recorder.Stop();
+			Assert::AreEqual(1LL, recorder.GetStatistics().EventCount);
+			std::string trace = WriteTrace();
+			Assert::IsFalse(Contains(trace, "First"));
+			Assert::IsTrue(Contains(trace, "Second"));
+		}
+
+		TEST_METHOD(DropsEventsWhenTheThreadBufferIsFull)
+		{
+			TraceThreadBuffer buffer(1);
+			const INT64 capacity = (INT64)TRACE_BLOCK_EVENT_COUNT * TRACE_MAX_BLOCKS_PER_THREAD;
+			for (INT64 i = 0; i < capacity; i++) {
+				Assert::IsTrue(buffer.TryAdd(TRACE_EVENT{ "Event", i, 1, i }));
+			}
+			Assert::IsFalse(buffer.TryAdd(TRACE_EVENT{ "Event", capacity, 1, capacity }));
+			Assert::AreEqual(capacity, buffer.GetEventCount());
+			Assert::AreEqual(1LL, buffer.GetDroppedEventCount());
+			Assert::AreEqual(TRACE_BLOCK_EVENT_COUNT + 1LL, buffer.GetEvent(TRACE_BLOCK_EVENT_COUNT + 1).FrameNumber);
+			Assert::AreEqual(capacity - 1, buffer.GetEvent(capacity - 1).StartTime);
+		}
+	};
+}
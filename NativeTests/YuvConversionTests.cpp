@@ -0,0 +1,128 @@
+#include "CppUnitTest.h"
+#include "YuvConversion.h"
+#include <vector>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace NativeTests
+{
+	//Value of pixels the kernels must not write to
+	static const UINT UNTOUCHED = 0x12345678;
+
+	static void AssertColor(UINT pixel, int r, int g, int b, int tolerance = 1)
+	{
+		Assert::AreEqual(0xFFu, pixel >> 24);
+		Assert::IsTrue(abs(static_cast<int>((pixel >> 16) & 0xFF) - r) <= tolerance, L"Red");
+		Assert::IsTrue(abs(static_cast<int>((pixel >> 8) & 0xFF) - g) <= tolerance, L"Green");
+		Assert::IsTrue(abs(static_cast<int>(pixel & 0xFF) - b) <= tolerance, L"Blue");
+	}
+
+	// Converts a single pixel of the given samples, using an NV12 frame of 2x2 pixels
+	static UINT ConvertPixel(BYTE y, BYTE u, BYTE v, YuvMatrix matrix, bool isFullRange)
+	{
+		BYTE luma[4] = { y, y, y, y };
+		BYTE chroma[2] = { u, v };
+		UINT pixels[4];
+		ConvertNV12ToBGRA(luma, 2, chroma, 2, 2, 2, GetYuvToRgbMatrix(matrix, isFullRange), reinterpret_cast<BYTE *>(pixels), 2 * sizeof(UINT));
+		return pixels[0];
+	}
+
+	TEST_CLASS(YuvConversionTests)
+	{
+	public:
+		TEST_METHOD(ConvertsBlackAndWhite)
+		{
+			for (YuvMatrix matrix : { YuvMatrix::BT601, YuvMatrix::BT709 }) {
+				Assert::AreEqual(0xFF000000u, ConvertPixel(16, 128, 128, matrix, false));
+				Assert::AreEqual(0xFFFFFFFFu, ConvertPixel(235, 128, 128, matrix, false));
+				Assert::AreEqual(0xFF000000u, ConvertPixel(0, 128, 128, matrix, true));
+				Assert::AreEqual(0xFFFFFFFFu, ConvertPixel(255, 128, 128, matrix, true));
+				Assert::AreEqual(0xFF808080u, ConvertPixel(128, 128, 128, matrix, true));
+			}
+			//Samples outside the video range are clamped
+			Assert::AreEqual(0xFF000000u, ConvertPixel(0, 128, 128, YuvMatrix::BT601, false));
+			Assert::AreEqual(0xFFFFFFFFu, ConvertPixel(255, 128, 128, YuvMatrix::BT601, false));
+		}
+
+		TEST_METHOD(ConvertsPrimariesOfEachMatrix)
+		{
+			AssertColor(ConvertPixel(81, 90, 240, YuvMatrix::BT601, false), 255, 0, 0, 2);
+			AssertColor(ConvertPixel(145, 54, 34, YuvMatrix::BT601, false), 0, 255, 0, 2);
+			AssertColor(ConvertPixel(41, 240, 110, YuvMatrix::BT601, false), 0, 0, 255, 2);
+			AssertColor(ConvertPixel(63, 102, 240, YuvMatrix::BT709, false), 255, 0, 0, 2);
+			AssertColor(ConvertPixel(173, 42, 26, YuvMatrix::BT709, false), 0, 255, 0, 2);
+			AssertColor(ConvertPixel(32, 240, 118, YuvMatrix::BT709, false), 0, 0, 255, 2);
+			//The same samples are a different color with the other matrix
+			AssertColor(ConvertPixel(63, 102, 240, YuvMatrix::BT601, false), 233, 0, 2, 2);
+		}
+
+		TEST_METHOD(SharesNV12ChromaWithinEachBlock)
+		{
+			const UINT width = 4, height = 4;
+			std::vector<BYTE> luma(width * height, 128);
+			//Grey in the top left block, and full blue chroma in the top right block
+			BYTE chroma[] = { 128, 128, 255, 128,
+							  128, 128, 128, 128 };
+			std::vector<UINT> pixels(width * height);
+			ConvertNV12ToBGRA(luma.data(), width, chroma, width, width, height, GetYuvToRgbMatrix(YuvMatrix::BT601, true), reinterpret_cast<BYTE *>(pixels.data()), width * sizeof(UINT));
+			for (UINT y = 0; y < height; y++) {
+				for (UINT x = 0; x < width; x++) {
+					if (y < 2 && x >= 2) {
+						AssertColor(pixels[y * width + x], 128, 84, 255);
+					}
+					else {
+						Assert::AreEqual(0xFF808080u, pixels[y * width + x]);
+					}
+				}
+			}
+		}
+
+		TEST_METHOD(ConvertsYUY2Pairs)
+		{
+			//Y0 U Y1 V
+			BYTE samples[] = { 16, 128, 235, 128, 235, 90, 81, 240 };
+			UINT pixels[4];
+			ConvertYUY2ToBGRA(samples, sizeof(samples), 4, 1, GetYuvToRgbMatrix(YuvMatrix::BT601, false), reinterpret_cast<BYTE *>(pixels), sizeof(pixels));
+			Assert::AreEqual(0xFF000000u, pixels[0]);
+			Assert::AreEqual(0xFFFFFFFFu, pixels[1]);
+			AssertColor(pixels[3], 255, 0, 0, 2);
+			//The second pair shares its chroma, so the brighter pixel is a lighter red
+			AssertColor(pixels[2], 255, 179, 178, 2);
+		}
+
+		TEST_METHOD(RespectsStridesAndOddSizes)
+		{
+			//A 3x3 NV12 frame with padded rows, drawn into a wider destination
+			const UINT width = 3, height = 3;
+			const LONG stride = 8;
+			std::vector<BYTE> frame(GetYuvFrameBufferSize(YuvPixelFormat::NV12, stride, height), 128);
+			for (UINT y = 0; y < height; y++) {
+				for (UINT x = 0; x < width; x++) {
+					frame[y * stride + x] = 235;
+				}
+			}
+			const UINT destinationWidth = 5;
+			std::vector<UINT> pixels(destinationWidth * height, UNTOUCHED);
+			ConvertYuvFrameToBGRA(YuvPixelFormat::NV12, frame.data(), stride, width, height, GetYuvToRgbMatrix(YuvMatrix::BT709, false), reinterpret_cast<BYTE *>(pixels.data()), destinationWidth * sizeof(UINT));
+			for (UINT y = 0; y < height; y++) {
+				for (UINT x = 0; x < destinationWidth; x++) {
+					Assert::AreEqual(x < width ? 0xFFFFFFFFu : UNTOUCHED, pixels[y * destinationWidth + x]);
+				}
+			}
+
+			BYTE samples[] = { 235, 128, 235, 128 };
+			UINT yuy2Pixels[2] = { UNTOUCHED, UNTOUCHED };
+			ConvertYUY2ToBGRA(samples, sizeof(samples), 1, 1, GetYuvToRgbMatrix(YuvMatrix::BT709, false), reinterpret_cast<BYTE *>(yuy2Pixels), sizeof(yuy2Pixels));
+			Assert::AreEqual(0xFFFFFFFFu, yuy2Pixels[0]);
+			Assert::AreEqual(UNTOUCHED, yuy2Pixels[1]);
+		}
+
+		TEST_METHOD(CalculatesFrameBufferSizes)
+		{
+			Assert::AreEqual(640u * 480 * 3 / 2, GetYuvFrameBufferSize(YuvPixelFormat::NV12, 640, 480));
+			//The chroma plane of an odd height covers the last row
+			Assert::AreEqual(64u * 3 + 64u * 2, GetYuvFrameBufferSize(YuvPixelFormat::NV12, 64, 3));
+			Assert::AreEqual(1280u * 480, GetYuvFrameBufferSize(YuvPixelFormat::YUY2, 1280, 480));
+		}
+	};
+}
@@ -18,13 +18,18 @@ namespace ScreenRecorderLib {
 	};
 	public enum class MouseDetectionMode {
 		///<summary>
-		///Use polling for detecting mouse clicks. Does not affect mouse performance, but may not work for all mouse clicks generated programmatically.
+		///The default mode. Mouse clicks are detected with a low level system hook, as with Hook. The name is kept for compatibility, as clicks are no longer polled.
 		///</summary>
 		Polling = MOUSE_OPTIONS::MOUSE_DETECTION_MODE_POLLING,
 		///<summary>
 		///Use a low level system hook for detecting mouse clicks. Works more reliably for programmatic events, but can negatively affect mouse performance while recording.
 		///</summary>
-		Hook = MOUSE_OPTIONS::MOUSE_DETECTION_MODE_HOOK
+		Hook = MOUSE_OPTIONS::MOUSE_DETECTION_MODE_HOOK,
+		///<summary>
+		///Use raw mouse input for detecting mouse clicks. Does not affect mouse performance, but may not work for all mouse clicks generated programmatically.
+		///Raw input can only be registered once per process. If the application has registered for raw mouse input, the hook is used instead, and the registration of the application is left untouched.
+		///</summary>
+		RawInput = MOUSE_OPTIONS::MOUSE_DETECTION_MODE_RAW_INPUT
 	};
 
 	public enum class ImageFormat {
@@ -39,6 +44,18 @@ namespace ScreenRecorderLib {
 		Stereo = 2,
 		FivePointOne = 6
 	};
+	public enum class AudioTestSignal {
+		///<summary>Record audio from the devices.</summary>
+		None = 0,
+		///<summary>Digital silence.</summary>
+		Silence = 1,
+		///<summary>A continuous 1 kHz sine tone.</summary>
+		Tone = 2,
+		///<summary>White noise.</summary>
+		Noise = 3,
+		///<summary>A short 1 kHz beep at the start of every second, and silence for the rest.</summary>
+		Beeps = 4
+	};
 	public enum class AudioBitrate {
 		bitrate_96kbps = 12000,
 		bitrate_128kbps = 16000,
@@ -212,6 +229,7 @@ namespace ScreenRecorderLib {
 	public ref class VideoEncoderOptions : public INotifyPropertyChanged {
 	private:
 		int _framerate;
+		int _framerateDenominator;
 		int _quality;
 		int _bitrate;
 		bool _isFixedFramerate;
@@ -224,6 +242,7 @@ namespace ScreenRecorderLib {
 	public:
 		VideoEncoderOptions() {
 			Framerate = 30;
+			FramerateDenominator = 1;
 			Quality = 70;
 			Bitrate = 4000 * 1000;
 			IsFixedFramerate = false;
@@ -252,6 +271,18 @@ namespace ScreenRecorderLib {
 			}
 		}
 		/// <summary>
+		///Denominator of the framerate, for fractional framerates. The framerate is Framerate / FramerateDenominator, e.g. 30000 / 1001 for 29.97 fps. Default is 1.
+		/// </summary>
+		property int FramerateDenominator {
+			int get() {
+				return _framerateDenominator;
+			}
+			void set(int value) {
+				_framerateDenominator = value;
+				OnPropertyChanged("FramerateDenominator");
+			}
+		}
+		/// <summary>
 		///Bitrate in bits per second
 		/// </summary>
 		property int Bitrate {
@@ -505,6 +536,7 @@ namespace ScreenRecorderLib {
 		Nullable<AudioChannels> _channels;
 		String^ _audioInputDevice;
 		String^ _audioOutputDevice;
+		Nullable<AudioTestSignal> _testSignal;
 
 	public:
 		AudioOptions() :DynamicAudioOptions() {
@@ -570,6 +602,18 @@ namespace ScreenRecorderLib {
 				OnPropertyChanged("AudioInputDevice");
 			}
 		}
+		/// <summary>
+		///Generated audio that replaces the audio devices, for load tests that do not depend on the audio of the system.
+		/// </summary>
+		property Nullable<AudioTestSignal> TestSignal {
+			Nullable<AudioTestSignal> get() {
+				return _testSignal;
+			}
+			void set(Nullable<AudioTestSignal> value) {
+				_testSignal = value;
+				OnPropertyChanged("TestSignal");
+			}
+		}
 
 
 	};
@@ -669,9 +713,11 @@ namespace ScreenRecorderLib {
 	public ref class MouseOptions :DynamicMouseOptions {
 	private:
 		MouseDetectionMode _mouseClickDetectionMode;
+		bool _isMousePointerMetadataEnabled;
 	public:
 		MouseOptions() :DynamicMouseOptions() {
 			MouseClickDetectionMode = MouseDetectionMode::Polling;
+			IsMousePointerMetadataEnabled = false;
 			IsMousePointerEnabled = true;
 			IsMouseClicksDetected = false;
 			MouseLeftClickDetectionColor = "#FFFF00";
@@ -691,6 +737,19 @@ namespace ScreenRecorderLib {
 				OnPropertyChanged("MouseClickDetectionMode");
 			}
 		}
+		/// <summary>
+		/// Record the mouse pointer and clicks to a .cursor file next to the video instead of drawing them on the frames.
+		/// Frames are then not re-encoded when only the pointer moves. Only applies to video recordings to a file. Default is false.
+		/// </summary>
+		property bool IsMousePointerMetadataEnabled {
+			bool get() {
+				return _isMousePointerMetadataEnabled;
+			}
+			void set(bool value) {
+				_isMousePointerMetadataEnabled = value;
+				OnPropertyChanged("IsMousePointerMetadataEnabled");
+			}
+		}
 	};
 
 	public ref class OverLayOptions : public INotifyPropertyChanged {
@@ -721,6 +780,8 @@ namespace ScreenRecorderLib {
 		bool _isLogEnabled;
 		String^ _logFilePath;
 		LogLevel _logSeverityLevel;
+		String^ _traceFilePath;
+		String^ _captureTraceFilePath;
 
 	public:
 		LogOptions() {
@@ -773,6 +834,32 @@ namespace ScreenRecorderLib {
 				OnPropertyChanged("LogSeverityLevel");
 			}
 		}
+		/// <summary>
+		/// A path to write a trace of the time spent in each stage of the recording pipeline to, when the recording ends.
+		/// The trace is in the Chrome trace event format, and can be opened in chrome://tracing or https://ui.perfetto.dev. Default is null, for no trace.
+		/// </summary>
+		property String^ TraceFilePath {
+			String^ get() {
+				return _traceFilePath;
+			}
+			void set(String^ value) {
+				_traceFilePath = value;
+				OnPropertyChanged("TraceFilePath");
+			}
+		}
+		/// <summary>
+		/// A path to record the frames, mouse pointer and audio the recording pipeline receives to, so the recording can be reproduced with a ReplayRecordingSource.
+		/// Changed frames are read back from the GPU while recording, so this slows down the recording. Default is null, for no capture trace.
+		/// </summary>
+		property String^ CaptureTraceFilePath {
+			String^ get() {
+				return _captureTraceFilePath;
+			}
+			void set(String^ value) {
+				_captureTraceFilePath = value;
+				OnPropertyChanged("CaptureTraceFilePath");
+			}
+		}
 	};
 
 	public ref class RecorderOptions {
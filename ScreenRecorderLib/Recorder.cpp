@@ -43,6 +43,7 @@ void Recorder::SetOptions(RecorderOptions^ options) {
 			encoderOptions->SetVideoBitrate(options->VideoEncoderOptions->Bitrate);
 			encoderOptions->SetVideoQuality(options->VideoEncoderOptions->Quality);
 			encoderOptions->SetVideoFps(options->VideoEncoderOptions->Framerate);
+			encoderOptions->SetVideoFpsDenominator(options->VideoEncoderOptions->FramerateDenominator);
 			encoderOptions->SetFixedFramerate(options->VideoEncoderOptions->IsFixedFramerate);
 			encoderOptions->SetThrottlingDisabled(options->VideoEncoderOptions->IsThrottlingDisabled);
 			encoderOptions->SetLowLatencyModeEnabled(options->VideoEncoderOptions->IsLowLatencyEnabled);
@@ -127,6 +128,9 @@ void Recorder::SetOptions(RecorderOptions^ options) {
 			if (options->AudioOptions->OutputVolume.HasValue) {
 				audioOptions->SetOutputVolume(options->AudioOptions->OutputVolume.Value);
 			}
+			if (options->AudioOptions->TestSignal.HasValue) {
+				audioOptions->SetTestSignal(static_cast<::AudioTestSignal>(options->AudioOptions->TestSignal.Value));
+			}
 			m_Rec->SetAudioOptions(audioOptions);
 		}
 		if (options->MouseOptions) {
@@ -151,6 +155,7 @@ void Recorder::SetOptions(RecorderOptions^ options) {
 				mouseOptions->SetMouseClickDetectionDuration(options->MouseOptions->MouseClickDetectionDuration.Value);
 			}
 			mouseOptions->SetMouseClickDetectionMode((UINT32)options->MouseOptions->MouseClickDetectionMode);
+			mouseOptions->SetMousePointerMetadataEnabled(options->MouseOptions->IsMousePointerMetadataEnabled);
 			m_Rec->SetMouseOptions(mouseOptions);
 		}
 		if (options->OverlayOptions) {
@@ -162,6 +167,12 @@ void Recorder::SetOptions(RecorderOptions^ options) {
 				m_Rec->SetLogFilePath(msclr::interop::marshal_as<std::wstring>(options->LogOptions->LogFilePath));
 			}
 			m_Rec->SetLogSeverityLevel((UINT32)options->LogOptions->LogSeverityLevel);
+			if (options->LogOptions->TraceFilePath != nullptr) {
+				m_Rec->SetTraceFilePath(msclr::interop::marshal_as<std::wstring>(options->LogOptions->TraceFilePath));
+			}
+			if (options->LogOptions->CaptureTraceFilePath != nullptr) {
+				m_Rec->SetCaptureTraceFilePath(msclr::interop::marshal_as<std::wstring>(options->LogOptions->CaptureTraceFilePath));
+			}
 		}
 	}
 }
@@ -560,6 +571,30 @@ OutputDimensions^ Recorder::GetOutputDimensionsForRecordingSources(IEnumerable<R
 				}
 				break;
 			}
+			case RecordingSourceType::TestPattern: {
+				for each (RecordingSourceBase ^ recordingSource in recordingSources)
+				{
+					if (isinst<TestPatternRecordingSource^>(recordingSource)) {
+						if ((gcnew String(nativeSource->ID.c_str()))->Equals(recordingSource->ID)) {
+							outputDimensions->OutputCoordinates->Add(gcnew SourceCoordinates(recordingSource, gcnew ScreenRect(nativeSourceRect.left, nativeSourceRect.top, RectWidth(nativeSourceRect), RectHeight(nativeSourceRect))));
+							break;
+						}
+					}
+				}
+				break;
+			}
+			case RecordingSourceType::Replay: {
+				for each (RecordingSourceBase ^ recordingSource in recordingSources)
+				{
+					if (isinst<ReplayRecordingSource^>(recordingSource)) {
+						if ((gcnew String(nativeSource->ID.c_str()))->Equals(recordingSource->ID)) {
+							outputDimensions->OutputCoordinates->Add(gcnew SourceCoordinates(recordingSource, gcnew ScreenRect(nativeSourceRect.left, nativeSourceRect.top, RectWidth(nativeSourceRect), RectHeight(nativeSourceRect))));
+							break;
+						}
+					}
+				}
+				break;
+			}
 			default:
 				break;
 		}
@@ -829,6 +864,30 @@ HRESULT Recorder::CreateOrUpdateNativeRecordingSource(_In_ RecordingSourceBase^
 			hr = S_OK;
 		}
 	}
+	else if (isinst<TestPatternRecordingSource^>(managedSource)) {
+		TestPatternRecordingSource^ testPatternSource = (TestPatternRecordingSource^)managedSource;
+		pNativeSource->Type = RecordingSourceType::TestPattern;
+		pNativeSource->TestPattern.Mode = static_cast<::TestPatternMode>(testPatternSource->Mode);
+		if (testPatternSource->Size && testPatternSource->Size->Width > 0 && testPatternSource->Size->Height > 0) {
+			pNativeSource->TestPattern.Size = testPatternSource->Size->ToSIZE();
+		}
+		if (testPatternSource->FrameRate > 0) {
+			pNativeSource->TestPattern.FrameRate = testPatternSource->FrameRate;
+		}
+		pNativeSource->TestPattern.DirtyRectCount = max(0, testPatternSource->DirtyRectCount);
+		pNativeSource->TestPattern.Seed = static_cast<UINT32>(testPatternSource->Seed);
+		pNativeSource->TestPattern.IsPointerEnabled = testPatternSource->IsPointerEnabled;
+		hr = S_OK;
+	}
+	else if (isinst<ReplayRecordingSource^>(managedSource)) {
+		ReplayRecordingSource^ replaySource = (ReplayRecordingSource^)managedSource;
+		pNativeSource->Type = RecordingSourceType::Replay;
+		pNativeSource->ReplaySpeed = static_cast<::TraceReplaySpeed>(replaySource->Speed);
+		if (!String::IsNullOrEmpty(replaySource->SourcePath)) {
+			pNativeSource->SourcePath = msclr::interop::marshal_as<std::wstring>(replaySource->SourcePath);
+			hr = S_OK;
+		}
+	}
 	else {
 		return E_NOTIMPL;
 	}
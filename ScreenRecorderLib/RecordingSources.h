@@ -16,6 +16,22 @@ namespace ScreenRecorderLib {
 		///<summary>WindowsGraphicsCapture requires Windows 10 version 1803 or higher. This API supports recording windows in addition to screens.</summary>
 		WindowsGraphicsCapture = 1,
 	};
+	public enum class TestPatternMode {
+		///<summary>Color bars that move sideways every frame.</summary>
+		MovingBars = 0,
+		///<summary>Lines of text that scroll upwards every frame.</summary>
+		ScrollingText = 1,
+		///<summary>New random pixels every frame. This is the worst case for the encoder.</summary>
+		Noise = 2,
+		///<summary>A static background where a fixed number of small rectangles change every frame.</summary>
+		DirtyRects = 3,
+	};
+	public enum class ReplaySpeed {
+		///<summary>The recorded frames are presented at the time they were recorded.</summary>
+		RealTime = 0,
+		///<summary>The recording runs on a virtual clock that skips ahead to the next frame, so the replay takes as long as processing the frames does.</summary>
+		FullSpeed = 1,
+	};
 	public ref class RecordingSourceBase abstract : public INotifyPropertyChanged {
 	private:
 		String^ _id;
@@ -440,6 +456,86 @@ namespace ScreenRecorderLib {
 		}
 	};
 
+	/// <summary>
+	/// A generated source for load and soak tests. The frames only depend on the options, so every recording gets the same content.
+	/// </summary>
+	public ref class TestPatternRecordingSource : public RecordingSourceBase {
+	public:
+		property TestPatternMode Mode;
+		/// <summary>
+		/// The size of the generated frames in pixels. Defaults to 1920x1080.
+		/// </summary>
+		property ScreenSize^ Size;
+		/// <summary>
+		/// The number of frames generated per second. Defaults to 60.
+		/// </summary>
+		property int FrameRate;
+		/// <summary>
+		/// The number of rectangles that change every frame in the DirtyRects mode. Defaults to 8.
+		/// </summary>
+		property int DirtyRectCount;
+		/// <summary>
+		/// The seed of the random content. Recordings with the same seed get the same frames.
+		/// </summary>
+		property int Seed;
+		/// <summary>
+		/// Moves a generated mouse pointer over the frames. Defaults to true.
+		/// </summary>
+		property bool IsPointerEnabled;
+
+		TestPatternRecordingSource() :RecordingSourceBase()
+		{
+			Mode = TestPatternMode::MovingBars;
+			Size = gcnew ScreenSize(1920, 1080);
+			FrameRate = 60;
+			DirtyRectCount = 8;
+			Seed = 1;
+			IsPointerEnabled = true;
+		}
+		TestPatternRecordingSource(TestPatternMode mode) :TestPatternRecordingSource() {
+			Mode = mode;
+		}
+		TestPatternRecordingSource(TestPatternRecordingSource^ source) :RecordingSourceBase(source) {
+			Mode = source->Mode;
+			Size = source->Size;
+			FrameRate = source->FrameRate;
+			DirtyRectCount = source->DirtyRectCount;
+			Seed = source->Seed;
+			IsPointerEnabled = source->IsPointerEnabled;
+		}
+	};
+
+	/// <summary>
+	/// Replays a capture trace recorded with LogOptions.CaptureTraceFilePath, with the frames, mouse pointer and audio of the original recording.
+	/// The recording ends when the end of the trace is reached.
+	/// </summary>
+	public ref class ReplayRecordingSource : public RecordingSourceBase {
+	public:
+		/// <summary>
+		/// The path to the capture trace file.
+		/// </summary>
+		property String^ SourcePath;
+		/// <summary>
+		/// Whether to replay the trace in real time, or as fast as the frames can be processed. Defaults to RealTime.
+		/// </summary>
+		property ReplaySpeed Speed;
+
+		ReplayRecordingSource() :RecordingSourceBase()
+		{
+			Speed = ReplaySpeed::RealTime;
+		}
+		ReplayRecordingSource(String^ path) :ReplayRecordingSource() {
+			SourcePath = path;
+		}
+		ReplayRecordingSource(String^ path, ReplaySpeed speed) :ReplayRecordingSource(path) {
+			Speed = speed;
+		}
+		ReplayRecordingSource(ReplayRecordingSource^ source) :RecordingSourceBase(source) {
+			SourcePath = source->SourcePath;
+			Speed = source->Speed;
+		}
+	};
+
 	public ref class RecordableCamera : VideoCaptureRecordingSource {
 	public:
 		RecordableCamera() {}
@@ -6,10 +6,17 @@ using namespace std;
 
 AudioManager::AudioManager() :
 	m_AudioOptions(nullptr),
-	m_IsCaptureEnabled(false)
+	m_Replay(nullptr),
+	m_IsCaptureEnabled(false),
+	m_Metrics(nullptr),
+	m_GrabTime(nullptr),
+	m_GrabbedByteCount(nullptr),
+	m_QueuedOutputBytes(nullptr),
+	m_QueuedInputBytes(nullptr)
 {
 	InitializeCriticalSection(&m_CriticalSection);
 	m_OptionsListenerStopEvent = CreateEvent(nullptr, TRUE, FALSE, nullptr);
+	SetMetricsRegistry(std::make_shared<MetricsRegistry>());
 }
 
 AudioManager::~AudioManager()
@@ -64,6 +71,8 @@ HRESULT AudioManager::Initialize(_In_ std::shared_ptr<AUDIO_OPTIONS> &audioOptio
 
 void AudioManager::ClearRecordedBytes()
 {
+	if (m_TestSignalGenerator)
+		m_TestSignalGenerator->Reset();
 	if (m_AudioOutputCapture)
 		m_AudioOutputCapture->ClearRecordedBytes();
 	if (m_AudioInputCapture)
@@ -125,6 +134,29 @@ HRESULT AudioManager::StopDeviceCapture(WASAPICapture *pCapture) {
 
 HRESULT AudioManager::ConfigureAudioCapture() {
 	HRESULT hr = S_FALSE;
+	if (GetAudioOptions()->IsAudioEnabled() && m_Replay && m_IsCaptureEnabled) {
+		//The replayed audio replaces the devices and the test signal, so recordings of a trace get the same audio every run.
+		hr = StopDeviceCapture(m_AudioOutputCapture.get());
+		LOG_ON_BAD_HR(StopDeviceCapture(m_AudioInputCapture.get()));
+		m_AudioOutputCapture.reset();
+		m_AudioInputCapture.reset();
+		m_TestSignalGenerator.reset();
+		return hr;
+	}
+	AudioTestSignal testSignal = GetAudioOptions()->GetTestSignal();
+	if (GetAudioOptions()->IsAudioEnabled() && testSignal != AudioTestSignal::None && m_IsCaptureEnabled) {
+		//The test signal replaces the devices, so they are not opened at all.
+		hr = StopDeviceCapture(m_AudioOutputCapture.get());
+		LOG_ON_BAD_HR(StopDeviceCapture(m_AudioInputCapture.get()));
+		m_AudioOutputCapture.reset();
+		m_AudioInputCapture.reset();
+		if (!m_TestSignalGenerator || m_TestSignalGenerator->GetSignal() != testSignal) {
+			m_TestSignalGenerator = make_unique<AudioTestSignalGenerator>(testSignal, GetAudioOptions()->GetAudioSamplesPerSecond(), GetAudioOptions()->GetAudioChannels());
+			LOG_DEBUG("Created audio test signal generator");
+		}
+		return hr;
+	}
+	m_TestSignalGenerator.reset();
 	if (GetAudioOptions()->IsAudioEnabled() && GetAudioOptions()->IsOutputDeviceEnabled() && m_IsCaptureEnabled)
 	{
 		if (!m_AudioOutputCapture) {
@@ -157,11 +189,51 @@ HRESULT AudioManager::ConfigureAudioCapture() {
 	return hr;
 }
 
+void AudioManager::SetMetricsRegistry(_In_ std::shared_ptr<MetricsRegistry> pMetrics)
+{
+	EnterCriticalSection(&m_CriticalSection);
+	LeaveCriticalSectionOnExit leaveOnExit(&m_CriticalSection);
+	m_Metrics = pMetrics;
+	m_GrabTime = &pMetrics->GetHistogram(L"audio.grab_time");
+	m_GrabbedByteCount = &pMetrics->GetCounter(L"audio.grabbed_bytes");
+	m_QueuedOutputBytes = &pMetrics->GetGauge(L"audio.queued_bytes", L"output");
+	m_QueuedInputBytes = &pMetrics->GetGauge(L"audio.queued_bytes", L"input");
+}
+
+HRESULT AudioManager::SetReplay(_In_ std::shared_ptr<CaptureTraceReplay> pReplay)
+{
+	EnterCriticalSection(&m_CriticalSection);
+	LeaveCriticalSectionOnExit leaveOnExit(&m_CriticalSection);
+	if (pReplay) {
+		const CAPTURE_TRACE_HEADER &header = pReplay->GetHeader();
+		if (!pReplay->HasAudio()) {
+			LOG_WARN(L"The capture trace has no audio to replay");
+			return E_INVALIDARG;
+		}
+		if (header.AudioSamplesPerSecond != GetAudioOptions()->GetAudioSamplesPerSecond()
+			|| header.AudioChannels != GetAudioOptions()->GetAudioChannels()
+			|| header.AudioBitsPerSample != GetAudioOptions()->GetAudioBitsPerSample()) {
+			LOG_WARN(L"The audio of the capture trace is %u Hz with %u channels of %u bits, which does not match the audio options", header.AudioSamplesPerSecond, header.AudioChannels, header.AudioBitsPerSample);
+			return E_INVALIDARG;
+		}
+	}
+	m_Replay = pReplay;
+	return ConfigureAudioCapture();
+}
+
 std::vector<BYTE> AudioManager::GrabAudioFrame(_In_ UINT64 durationHundredNanos)
 {
 	EnterCriticalSection(&m_CriticalSection);
 	LeaveCriticalSectionOnExit leaveOnExit(&m_CriticalSection);
-	if (m_AudioOutputCapture && m_AudioInputCapture) {
+	LatencyTimer grabTimer(*m_GrabTime);
+	std::vector<BYTE> audioBytes;
+	if (m_Replay && GetAudioOptions()->IsAudioEnabled() && m_IsCaptureEnabled) {
+		audioBytes = m_Replay->ReadAudio(durationHundredNanos);
+	}
+	else if (m_TestSignalGenerator) {
+		audioBytes = MixAudio(m_TestSignalGenerator->Generate(durationHundredNanos), std::vector<BYTE>(), GetAudioOptions()->GetOutputVolume(), 1.0);
+	}
+	else if (m_AudioOutputCapture && m_AudioInputCapture) {
 		auto returnAudioOverflowToBuffer = [&](auto &outputDeviceData, auto &inputDeviceData) {
 			if (outputDeviceData.size() > 0 && inputDeviceData.size() > 0) {
 				if (outputDeviceData.size() > inputDeviceData.size()) {
@@ -186,37 +258,25 @@ std::vector<BYTE> AudioManager::GrabAudioFrame(_In_ UINT64 durationHundredNanos)
 			LOG_ERROR(L"Mixing audio byte arrays with differing sizes");
 		}
 
-		return std::move(MixAudio(outputDeviceData, inputDeviceData, GetAudioOptions()->GetOutputVolume(), GetAudioOptions()->GetInputVolume()));
+		audioBytes = MixAudio(outputDeviceData, inputDeviceData, GetAudioOptions()->GetOutputVolume(), GetAudioOptions()->GetInputVolume());
 	}
 	else if (m_AudioOutputCapture)
-		return std::move(MixAudio(m_AudioOutputCapture->GetRecordedBytes(durationHundredNanos), std::vector<BYTE>(), GetAudioOptions()->GetOutputVolume(), 1.0));
+		audioBytes = MixAudio(m_AudioOutputCapture->GetRecordedBytes(durationHundredNanos), std::vector<BYTE>(), GetAudioOptions()->GetOutputVolume(), 1.0);
 	else if (m_AudioInputCapture)
-		return std::move(MixAudio(std::vector<BYTE>(), m_AudioInputCapture->GetRecordedBytes(durationHundredNanos), 1.0, GetAudioOptions()->GetInputVolume()));
-	else
-		return std::vector<BYTE>();
+		audioBytes = MixAudio(std::vector<BYTE>(), m_AudioInputCapture->GetRecordedBytes(durationHundredNanos), 1.0, GetAudioOptions()->GetInputVolume());
+
+	m_GrabbedByteCount->Add(audioBytes.size());
+	m_QueuedOutputBytes->Set(m_AudioOutputCapture ? static_cast<double>(m_AudioOutputCapture->GetRecordedByteCount()) : 0);
+	m_QueuedInputBytes->Set(m_AudioInputCapture ? static_cast<double>(m_AudioInputCapture->GetRecordedByteCount()) : 0);
+	return audioBytes;
 }
 
 std::vector<BYTE> AudioManager::MixAudio(_In_ std::vector<BYTE> const &first, _In_ std::vector<BYTE> const &second, _In_ float firstVolume, _In_ float secondVolume)
 {
-	std::vector<BYTE> newvector(max(first.size(), second.size()));
 	bool clipped = false;
-	for (size_t i = 0; i < newvector.size(); i += 2) {
-		short firstSample = first.size() > i + 1 ? static_cast<short>(first[i] | first[i + 1] << 8) : 0;
-		short secondSample = second.size() > i + 1 ? static_cast<short>(second[i] | second[i + 1] << 8) : 0;
-		auto out = reinterpret_cast<short *>(&newvector[i]);
-		int mixedSample = int(round((firstSample)*firstVolume + (secondSample)*secondVolume));
-		if (mixedSample > MAXSHORT) {
-			clipped = true;
-			mixedSample = MAXSHORT;
-		}
-		else if (mixedSample < -MAXSHORT) {
-			clipped = true;
-			mixedSample = -MAXSHORT;
-		}
-		*out = (short)mixedSample;
-	}
+	std::vector<BYTE> mixedBytes = ::MixAudio(first, second, firstVolume, secondVolume, &clipped);
 	if (clipped) {
 		LOG_WARN("Audio clipped during mixing");
 	}
-	return newvector;
+	return mixedBytes;
 }
\ No newline at end of file
@@ -1,7 +1,10 @@
 #pragma once
 #include <vector>
 #include "WASAPICapture.h"
+#include "AudioTestSignal.h"
+#include "CaptureTrace.h"
 #include "CommonTypes.h"
+#include "MetricsRegistry.h"
 class AudioManager 
 {
 public:
@@ -12,6 +15,15 @@ public:
 	HRESULT StartCapture();
 	HRESULT StopCapture();
 	std::vector<BYTE> GrabAudioFrame(_In_ UINT64 durationHundredNanos);
+	/// <summary>
+	/// Sets the registry the grabbed audio and the audio waiting in the capture buffers are recorded to.
+	/// </summary>
+	void SetMetricsRegistry(_In_ std::shared_ptr<MetricsRegistry> pMetrics);
+	/// <summary>
+	/// Sets a capture trace to replay the audio of in place of the audio devices, or nullptr to capture from the devices.
+	/// The audio of the trace must be in the format of the audio options.
+	/// </summary>
+	HRESULT SetReplay(_In_ std::shared_ptr<CaptureTraceReplay> pReplay);
 private:
 	CRITICAL_SECTION m_CriticalSection;
 	std::shared_ptr<AUDIO_OPTIONS> m_AudioOptions;
@@ -19,9 +31,20 @@ private:
 	std::unique_ptr<WASAPICapture> m_AudioOutputCapture;
 	//Audio input, i.e. microphone
 	std::unique_ptr<WASAPICapture> m_AudioInputCapture;
+	//Generated audio that replaces both devices when a test signal is set
+	std::unique_ptr<AudioTestSignalGenerator> m_TestSignalGenerator;
+	//Capture trace of which the audio replaces both devices
+	std::shared_ptr<CaptureTraceReplay> m_Replay;
 
 	bool m_IsCaptureEnabled;
 
+	std::shared_ptr<MetricsRegistry> m_Metrics;
+	LatencyHistogram *m_GrabTime;
+	MetricCounter *m_GrabbedByteCount;
+	//Captured bytes not yet grabbed, for each device
+	MetricGauge *m_QueuedOutputBytes;
+	MetricGauge *m_QueuedInputBytes;
+
 	AUDIO_OPTIONS *GetAudioOptions() { return m_AudioOptions.get(); }
 
 	HRESULT StartDeviceCapture(WASAPICapture *pCapture, std::wstring deviceId, EDataFlow flow);
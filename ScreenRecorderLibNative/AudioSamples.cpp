@@ -0,0 +1,68 @@
+#include "AudioSamples.h"
+#include <cmath>
+
+AudioSampleQueue::AudioSampleQueue() :
+	m_Bytes{}
+{
+}
+
+void AudioSampleQueue::Append(_In_reads_bytes_(byteCount) const BYTE *pData, _In_ size_t byteCount)
+{
+	if (m_Bytes.size() == 0) {
+		m_Bytes.reserve(byteCount);
+	}
+	m_Bytes.insert(m_Bytes.end(), pData, pData + byteCount);
+}
+
+void AudioSampleQueue::PrependSilence(_In_ size_t byteCount)
+{
+	m_Bytes.insert(m_Bytes.begin(), byteCount, 0);
+}
+
+std::vector<BYTE> AudioSampleQueue::Take(_In_ size_t byteCount)
+{
+	byteCount = min(byteCount, m_Bytes.size());
+	std::vector<BYTE> bytes(m_Bytes.begin(), m_Bytes.begin() + byteCount);
+	m_Bytes.erase(m_Bytes.begin(), m_Bytes.begin() + byteCount);
+	return bytes;
+}
+
+std::vector<BYTE> AudioSampleQueue::Peek() const
+{
+	return m_Bytes;
+}
+
+size_t AudioSampleQueue::GetSize() const
+{
+	return m_Bytes.size();
+}
+
+void AudioSampleQueue::Clear()
+{
+	m_Bytes.clear();
+}
+
+std::vector<BYTE> MixAudio(_In_ std::vector<BYTE> const &first, _In_ std::vector<BYTE> const &second, _In_ float firstVolume, _In_ float secondVolume, _Out_opt_ bool *pIsClipped)
+{
+	std::vector<BYTE> newvector(max(first.size(), second.size()));
+	bool clipped = false;
+	for (size_t i = 0; i < newvector.size(); i += 2) {
+		short firstSample = first.size() > i + 1 ? static_cast<short>(first[i] | first[i + 1] << 8) : 0;
+		short secondSample = second.size() > i + 1 ? static_cast<short>(second[i] | second[i + 1] << 8) : 0;
+		auto out = reinterpret_cast<short *>(&newvector[i]);
+		int mixedSample = int(round((firstSample)*firstVolume + (secondSample)*secondVolume));
+		if (mixedSample > MAXSHORT) {
+			clipped = true;
+			mixedSample = MAXSHORT;
+		}
+		else if (mixedSample < -MAXSHORT) {
+			clipped = true;
+			mixedSample = -MAXSHORT;
+		}
+		*out = (short)mixedSample;
+	}
+	if (pIsClipped) {
+		*pIsClipped = clipped;
+	}
+	return newvector;
+}
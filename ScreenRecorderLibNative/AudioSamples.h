@@ -0,0 +1,34 @@
+#pragma once
+#include <Windows.h>
+#include <vector>
+
+//
+// Captured audio bytes waiting to be written, in the capture format of the device.
+// Bytes are appended by the capture thread and taken from the front when a frame of audio is written.
+// Not thread safe, callers must hold their own lock.
+//
+class AudioSampleQueue
+{
+public:
+	AudioSampleQueue();
+	void Append(_In_reads_bytes_(byteCount) const BYTE *pData, _In_ size_t byteCount);
+	/// <summary>
+	/// Inserts silence at the front of the queue, to make up for audio that the device skipped.
+	/// </summary>
+	void PrependSilence(_In_ size_t byteCount);
+	/// <summary>
+	/// Removes and returns up to byteCount bytes from the front of the queue.
+	/// </summary>
+	std::vector<BYTE> Take(_In_ size_t byteCount);
+	std::vector<BYTE> Peek() const;
+	size_t GetSize() const;
+	void Clear();
+private:
+	std::vector<BYTE> m_Bytes;
+};
+
+/// <summary>
+/// Mixes two buffers of 16 bit PCM samples with the given volumes. The shorter buffer is padded with silence.
+/// </summary>
+/// <param name="pIsClipped">Receives true if any mixed sample was clipped</param>
+std::vector<BYTE> MixAudio(_In_ std::vector<BYTE> const &first, _In_ std::vector<BYTE> const &second, _In_ float firstVolume, _In_ float secondVolume, _Out_opt_ bool *pIsClipped = nullptr);
@@ -0,0 +1,84 @@
+#include "AudioTestSignal.h"
+#include <cmath>
+
+//Frequency of the tone and the beeps in Hz
+#define TEST_SIGNAL_FREQUENCY 1000
+//Peak amplitude of the signals, at -12 dBFS
+#define TEST_SIGNAL_AMPLITUDE 8192
+//Duration of each beep at the start of a second, in milliseconds
+#define TEST_SIGNAL_BEEP_MILLIS 100
+
+AudioTestSignalGenerator::AudioTestSignalGenerator(_In_ AudioTestSignal signal, _In_ UINT32 samplesPerSecond, _In_ UINT32 channels, _In_ UINT32 seed) :
+	m_Signal(signal),
+	m_SamplesPerSecond(max(1u, samplesPerSecond)),
+	m_Channels(max(1u, channels)),
+	m_Seed(seed),
+	m_NoiseState(0),
+	m_GeneratedDuration(0),
+	m_GeneratedFrames(0)
+{
+	Reset();
+}
+
+void AudioTestSignalGenerator::Reset()
+{
+	m_NoiseState = (static_cast<UINT64>(m_Seed) << 32 | 0x9E3779B9) ^ 0xD1B54A32D192ED03ULL;
+	m_GeneratedDuration = 0;
+	m_GeneratedFrames = 0;
+}
+
+std::vector<BYTE> AudioTestSignalGenerator::Generate(_In_ UINT64 durationHundredNanos)
+{
+	m_GeneratedDuration += durationHundredNanos;
+	UINT64 totalFrames = m_GeneratedDuration / 10000000 * m_SamplesPerSecond + m_GeneratedDuration % 10000000 * m_SamplesPerSecond / 10000000;
+	UINT64 frameCount = totalFrames - m_GeneratedFrames;
+	std::vector<BYTE> bytes(static_cast<size_t>(frameCount * m_Channels * sizeof(short)), 0);
+	if (m_Signal != AudioTestSignal::Silence && m_Signal != AudioTestSignal::None) {
+		short *pSamples = reinterpret_cast<short *>(bytes.data());
+		for (UINT64 frame = 0; frame < frameCount; frame++) {
+			if (m_Signal == AudioTestSignal::Noise) {
+				//Each channel gets its own noise
+				for (UINT32 channel = 0; channel < m_Channels; channel++) {
+					*pSamples++ = GetSample(m_GeneratedFrames + frame);
+				}
+			}
+			else {
+				short sample = GetSample(m_GeneratedFrames + frame);
+				for (UINT32 channel = 0; channel < m_Channels; channel++) {
+					*pSamples++ = sample;
+				}
+			}
+		}
+	}
+	m_GeneratedFrames = totalFrames;
+	return bytes;
+}
+
+short AudioTestSignalGenerator::GetSample(_In_ UINT64 frameIndex)
+{
+	const double pi = 3.14159265358979323846;
+	switch (m_Signal)
+	{
+		case AudioTestSignal::Noise: {
+			//xorshift64, scaled to the amplitude of the other signals
+			m_NoiseState ^= m_NoiseState << 13;
+			m_NoiseState ^= m_NoiseState >> 7;
+			m_NoiseState ^= m_NoiseState << 17;
+			return static_cast<short>(static_cast<INT64>(m_NoiseState % (2 * TEST_SIGNAL_AMPLITUDE + 1)) - TEST_SIGNAL_AMPLITUDE);
+		}
+		case AudioTestSignal::Beeps: {
+			UINT64 frameInSecond = frameIndex % m_SamplesPerSecond;
+			if (frameInSecond >= static_cast<UINT64>(m_SamplesPerSecond) * TEST_SIGNAL_BEEP_MILLIS / 1000) {
+				return 0;
+			}
+			break;
+		}
+		case AudioTestSignal::Tone:
+			break;
+		default:
+			return 0;
+	}
+	//The phase is taken from the position within the current second, which holds a whole number of periods
+	double seconds = static_cast<double>(frameIndex % m_SamplesPerSecond) / m_SamplesPerSecond;
+	return static_cast<short>(lround(TEST_SIGNAL_AMPLITUDE * sin(2 * pi * TEST_SIGNAL_FREQUENCY * seconds)));
+}
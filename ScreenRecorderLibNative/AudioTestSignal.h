@@ -0,0 +1,33 @@
+#pragma once
+#include "CommonTypes.h"
+
+//
+// Generates 16 bit PCM audio for the test signals, in place of the audio captured from devices.
+// The samples only depend on the signal, the format and the position in the stream, so recordings get the same audio every run.
+//
+class AudioTestSignalGenerator
+{
+public:
+	AudioTestSignalGenerator(_In_ AudioTestSignal signal, _In_ UINT32 samplesPerSecond, _In_ UINT32 channels, _In_ UINT32 seed = 1);
+	/// <summary>
+	/// Returns the audio for the next duration of the stream. The stream position is kept in time rather than in samples,
+	/// so durations that are not a whole number of samples do not drift.
+	/// </summary>
+	std::vector<BYTE> Generate(_In_ UINT64 durationHundredNanos);
+	/// <summary>
+	/// Restarts the signal from the beginning.
+	/// </summary>
+	void Reset();
+	inline AudioTestSignal GetSignal() { return m_Signal; }
+	inline UINT64 GetGeneratedFrameCount() { return m_GeneratedFrames; }
+private:
+	short GetSample(_In_ UINT64 frameIndex);
+
+	AudioTestSignal m_Signal;
+	UINT32 m_SamplesPerSecond;
+	UINT32 m_Channels;
+	UINT32 m_Seed;
+	UINT64 m_NoiseState;
+	UINT64 m_GeneratedDuration;
+	UINT64 m_GeneratedFrames;
+};
@@ -129,6 +129,12 @@ HRESULT CameraCapture::InitializeMediaSource(
 	EnterCriticalSection(&m_CriticalSection);
 	LeaveCriticalSectionOnExit leaveCriticalSection(&m_CriticalSection);
 
+	if (!sourceFormatIndex.has_value()) {
+		DWORD selectedFormatIndex;
+		if (SelectDeviceFormat(pSource, &selectedFormatIndex) == S_OK) {
+			sourceFormatIndex = selectedFormatIndex;
+		}
+	}
 	if (sourceFormatIndex.has_value()) {
 		SetDeviceFormat(pSource, sourceFormatIndex.value());
 	}
@@ -235,8 +241,11 @@ HRESULT CameraCapture::InitializeMediaSource(
 						(*ppSourceReader)->AddRef();
 					}
 					if (ppMediaTransform) {
+						//There is no media transform for frames that are drawn in their native format
 						*ppMediaTransform = pMediaTransform;
-						(*ppMediaTransform)->AddRef();
+						if (*ppMediaTransform) {
+							(*ppMediaTransform)->AddRef();
+						}
 					}
 					*pStreamIndex = streamIndex;
 					foundValidTopology = true;
@@ -302,4 +311,90 @@ done:
 	SafeRelease(&pHandler);
 	SafeRelease(&pType);
 	return hr;
-}
\ No newline at end of file
+}
+static CameraPixelFormat GetCameraPixelFormat(_In_ const GUID &subtype)
+{
+	if (subtype == MFVideoFormat_NV12) {
+		return CameraPixelFormat::NV12;
+	}
+	else if (subtype == MFVideoFormat_YUY2) {
+		return CameraPixelFormat::YUY2;
+	}
+	else if (subtype == MFVideoFormat_RGB32 || subtype == MFVideoFormat_ARGB32) {
+		return CameraPixelFormat::RGB32;
+	}
+	else if (subtype == MFVideoFormat_MJPG) {
+		return CameraPixelFormat::MJPG;
+	}
+	return CameraPixelFormat::Other;
+}
+
+HRESULT CameraCapture::SelectDeviceFormat(_In_ CComPtr<IMFMediaSource> pDevice, _Out_ DWORD *pFormatIndex)
+{
+	*pFormatIndex = 0;
+	if (!m_RecordingSource || !m_RecordingSource->OutputSize.has_value()) {
+		return S_FALSE;
+	}
+	RECORDING_SOURCE *pRecordingSource = dynamic_cast<RECORDING_SOURCE *>(m_RecordingSource);
+	if (pRecordingSource && pRecordingSource->SourceRect.has_value()) {
+		return S_FALSE;
+	}
+	SIZE outputSize = m_RecordingSource->OutputSize.value();
+	if (outputSize.cx <= 0 && outputSize.cy <= 0) {
+		return S_FALSE;
+	}
+	HRESULT hr;
+	CComPtr<IMFPresentationDescriptor> pPD;
+	CComPtr<IMFStreamDescriptor> pSD;
+	CComPtr<IMFMediaTypeHandler> pHandler;
+	BOOL fSelected;
+	RETURN_ON_BAD_HR(hr = pDevice->CreatePresentationDescriptor(&pPD));
+	RETURN_ON_BAD_HR(hr = pPD->GetStreamDescriptorByIndex(0, &fSelected, &pSD));
+	RETURN_ON_BAD_HR(hr = pSD->GetMediaTypeHandler(&pHandler));
+
+	CAMERA_FORMAT_TARGET target{};
+	target.Size = SIZE{ max(outputSize.cx, 0L), max(outputSize.cy, 0L) };
+	target.FrameRate = CAMERA_FORMAT_TARGET_FRAMERATE;
+	if (target.Size.cx > 0 && target.Size.cy > 0) {
+		target.AspectRatio = static_cast<double>(target.Size.cx) / target.Size.cy;
+	}
+	else {
+		//The missing dimension of the output size is calculated from the current format, so keep its aspect ratio.
+		CComPtr<IMFMediaType> pCurrentType;
+		UINT32 width, height;
+		if (SUCCEEDED(pHandler->GetCurrentMediaType(&pCurrentType))
+			&& SUCCEEDED(MFGetAttributeSize(pCurrentType, MF_MT_FRAME_SIZE, &width, &height))
+			&& height > 0) {
+			target.AspectRatio = static_cast<double>(width) / height;
+		}
+	}
+
+	std::vector<CAMERA_FORMAT> formats;
+	DWORD typeCount = 0;
+	RETURN_ON_BAD_HR(hr = pHandler->GetMediaTypeCount(&typeCount));
+	for (DWORD i = 0; i < typeCount; i++) {
+		CComPtr<IMFMediaType> pType;
+		GUID majorType;
+		GUID subtype;
+		UINT32 width, height;
+		UINT32 frameRateNumerator, frameRateDenominator;
+		if (FAILED(pHandler->GetMediaTypeByIndex(i, &pType))
+			|| FAILED(pType->GetGUID(MF_MT_MAJOR_TYPE, &majorType))
+			|| majorType != MFMediaType_Video
+			|| FAILED(pType->GetGUID(MF_MT_SUBTYPE, &subtype))
+			|| FAILED(MFGetAttributeSize(pType, MF_MT_FRAME_SIZE, &width, &height))
+			|| FAILED(MFGetAttributeRatio(pType, MF_MT_FRAME_RATE, &frameRateNumerator, &frameRateDenominator))
+			|| frameRateDenominator == 0) {
+			continue;
+		}
+		formats.push_back(CAMERA_FORMAT{ i, GetCameraPixelFormat(subtype), width, height, static_cast<double>(frameRateNumerator) / frameRateDenominator });
+	}
+	INT selected = SelectCameraFormat(formats, target);
+	if (selected < 0) {
+		return S_FALSE;
+	}
+	const CAMERA_FORMAT &format = formats[selected];
+	LOG_INFO(L"Selected camera format %u of %u: %ux%u at %.2f fps, for an output size of %ldx%ld", format.Index, typeCount, format.Width, format.Height, format.FrameRate, outputSize.cx, outputSize.cy);
+	*pFormatIndex = format.Index;
+	return S_OK;
+}
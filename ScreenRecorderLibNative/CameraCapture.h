@@ -1,6 +1,7 @@
 #pragma once
 #include "SourceReaderBase.h"
 #include "MF.util.h"
+#include "CameraFormatSelection.h"
 
 class CameraCapture : public SourceReaderBase
 {
@@ -38,6 +39,11 @@ private:
 		_Outptr_opt_result_maybenull_ IMFTransform **ppMediaTransform
 	);
 	HRESULT SetDeviceFormat(_In_ CComPtr<IMFMediaSource> pDevice, _In_ DWORD dwFormatIndex);
+	/// <summary>
+	/// Selects the cheapest format of the device for the output size of the recording source.
+	/// Returns S_FALSE if the source has no output size, or is cropped in the coordinates of the current format.
+	/// </summary>
+	HRESULT SelectDeviceFormat(_In_ CComPtr<IMFMediaSource> pDevice, _Out_ DWORD *pFormatIndex);
 	std::wstring m_DeviceName;
 	std::wstring m_DeviceSymbolicLink;
 };
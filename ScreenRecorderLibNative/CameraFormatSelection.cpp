@@ -0,0 +1,91 @@
+#include "CameraFormatSelection.h"
+#include <cmath>
+
+//Relative cost of a pixel of each format. Uncompressed YUV and RGB frames are converted directly by the video processor,
+//while MJPEG and other compressed formats must be decoded first.
+static double GetPixelCost(_In_ CameraPixelFormat pixelFormat)
+{
+	switch (pixelFormat) {
+		case CameraPixelFormat::NV12:
+		case CameraPixelFormat::YUY2:
+		case CameraPixelFormat::RGB32:
+			return 1.0;
+		case CameraPixelFormat::MJPG:
+			return 4.0;
+		default:
+			return 8.0;
+	}
+}
+
+double GetCameraFormatCost(_In_ const CAMERA_FORMAT &format)
+{
+	return static_cast<double>(format.Width) * format.Height * format.FrameRate * GetPixelCost(format.PixelFormat);
+}
+
+static bool CoversFrameRate(_In_ const CAMERA_FORMAT &format, _In_ const CAMERA_FORMAT_TARGET &target)
+{
+	return format.FrameRate >= target.FrameRate * (1.0 - CAMERA_FORMAT_FRAMERATE_TOLERANCE);
+}
+
+static bool CoversSize(_In_ const CAMERA_FORMAT &format, _In_ const CAMERA_FORMAT_TARGET &target)
+{
+	return static_cast<LONG>(format.Width) >= target.Size.cx && static_cast<LONG>(format.Height) >= target.Size.cy;
+}
+
+static bool MatchesAspectRatio(_In_ const CAMERA_FORMAT &format, _In_ const CAMERA_FORMAT_TARGET &target)
+{
+	if (target.AspectRatio <= 0 || format.Height == 0) {
+		return true;
+	}
+	double aspectRatio = static_cast<double>(format.Width) / format.Height;
+	return fabs(aspectRatio / target.AspectRatio - 1.0) <= CAMERA_FORMAT_ASPECT_RATIO_TOLERANCE;
+}
+
+/// <summary>
+/// Returns true if format a is a better choice for the target than format b.
+/// </summary>
+static bool IsBetterFormat(_In_ const CAMERA_FORMAT &a, _In_ const CAMERA_FORMAT &b, _In_ const CAMERA_FORMAT_TARGET &target)
+{
+	bool aCoversFrameRate = CoversFrameRate(a, target);
+	if (aCoversFrameRate != CoversFrameRate(b, target)) {
+		return aCoversFrameRate;
+	}
+	bool aCoversSize = CoversSize(a, target);
+	if (aCoversSize != CoversSize(b, target)) {
+		return aCoversSize;
+	}
+	bool aMatchesAspectRatio = MatchesAspectRatio(a, target);
+	if (aMatchesAspectRatio != MatchesAspectRatio(b, target)) {
+		return aMatchesAspectRatio;
+	}
+	//Of formats that fall short, the one closest to the target
+	if (!aCoversFrameRate && a.FrameRate != b.FrameRate) {
+		return a.FrameRate > b.FrameRate;
+	}
+	UINT64 aPixels = static_cast<UINT64>(a.Width) * a.Height;
+	UINT64 bPixels = static_cast<UINT64>(b.Width) * b.Height;
+	if (!aCoversSize && aPixels != bPixels) {
+		return aPixels > bPixels;
+	}
+	double aCost = GetCameraFormatCost(a);
+	double bCost = GetCameraFormatCost(b);
+	if (aCost != bCost) {
+		return aCost < bCost;
+	}
+	//The pixel formats are declared from most to least preferred
+	if (a.PixelFormat != b.PixelFormat) {
+		return a.PixelFormat < b.PixelFormat;
+	}
+	return a.Index < b.Index;
+}
+
+INT SelectCameraFormat(_In_ const std::vector<CAMERA_FORMAT> &formats, _In_ const CAMERA_FORMAT_TARGET &target)
+{
+	INT bestPosition = -1;
+	for (size_t i = 0; i < formats.size(); i++) {
+		if (bestPosition < 0 || IsBetterFormat(formats[i], formats[bestPosition], target)) {
+			bestPosition = static_cast<INT>(i);
+		}
+	}
+	return bestPosition;
+}
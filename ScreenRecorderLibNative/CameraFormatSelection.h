@@ -0,0 +1,53 @@
+#pragma once
+#include <Windows.h>
+#include <vector>
+
+//Frame rate camera formats are selected for. The frame rate of the recording is not known to the capture source.
+#define CAMERA_FORMAT_TARGET_FRAMERATE 30
+//Frame rates this close to the target count as reaching it, so formats of 29.97 fps are as good as 30 fps.
+#define CAMERA_FORMAT_FRAMERATE_TOLERANCE 0.02
+//Aspect ratios this close to the target count as the same.
+#define CAMERA_FORMAT_ASPECT_RATIO_TOLERANCE 0.02
+
+//
+// Automatic selection of the capture format of a camera. Cameras offer the same resolution in several pixel formats,
+// and capturing a larger frame than the destination needs, or a compressed format, costs decoding and conversion on every frame.
+// The selection is a pure function over a list of formats, so it does not depend on Media Foundation.
+//
+
+enum class CameraPixelFormat {
+	NV12,
+	YUY2,
+	RGB32,
+	MJPG,
+	// Other compressed or uncommon formats, which are the most expensive to decode
+	Other
+};
+
+struct CAMERA_FORMAT {
+	// Index of the media type on the device
+	DWORD Index;
+	CameraPixelFormat PixelFormat;
+	UINT Width;
+	UINT Height;
+	double FrameRate;
+};
+
+struct CAMERA_FORMAT_TARGET {
+	// Size the frames are drawn at. A width or height of 0 puts no requirement on that dimension.
+	SIZE Size;
+	double FrameRate;
+	// Width divided by height of the frames the destination was laid out for, or 0 for no preference
+	double AspectRatio;
+};
+
+/// <summary>
+/// Returns the relative cost of capturing and converting a frame of the format, per second.
+/// </summary>
+double GetCameraFormatCost(_In_ const CAMERA_FORMAT &format);
+
+/// <summary>
+/// Returns the position in the list of the cheapest format that covers the target size and frame rate, preferring formats with the target aspect ratio.
+/// If no format covers the target, the format that comes closest is returned. Returns -1 if the list is empty.
+/// </summary>
+INT SelectCameraFormat(_In_ const std::vector<CAMERA_FORMAT> &formats, _In_ const CAMERA_FORMAT_TARGET &target);
@@ -4,6 +4,8 @@
 
 CaptureBase::CaptureBase() :
 	m_LastGrabTimeStamp{},
+	m_IsPointerOnlyUpdatePublished(true),
+	m_DeviceCriticalSection(nullptr),
 	m_Device(nullptr),
 	m_DeviceContext(nullptr),
 	m_RecordingSource(nullptr),
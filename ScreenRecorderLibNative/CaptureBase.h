@@ -13,6 +13,24 @@ public:
 	virtual HRESULT GetNativeSize(_In_ RECORDING_SOURCE_BASE &recordingSource, _Out_ SIZE *nativeMediaSize) abstract;
 	virtual HRESULT GetMouse(_Inout_ PTR_INFO *pPtrInfo, _In_ RECT frameCoordinates, _In_ int offsetX, _In_ int offsetY) abstract;
 	virtual std::wstring Name() abstract;
+	/// <summary>
+	/// Returns true if the source always returns the same frame once started, so anything derived from it can be cached.
+	/// </summary>
+	virtual inline bool IsStaticContent() { return false; }
+	/// <summary>
+	/// Sets whether updates that only move or change the mouse pointer produce a new frame. Defaults to true.
+	/// When the pointer is not drawn on the frames, such updates leave the frame unchanged and do not need to be published.
+	/// </summary>
+	inline void SetPointerOnlyUpdatesPublished(_In_ bool value) { m_IsPointerOnlyUpdatePublished = value; }
+	/// <summary>
+	/// Sets the lock held by the caller while it uses the device, when the device is shared with other sources.
+	/// Sources that use the device from threads of their own must hold it there too.
+	/// </summary>
+	inline void SetDeviceCriticalSection(_In_opt_ CRITICAL_SECTION *pCriticalSection) { m_DeviceCriticalSection = pCriticalSection; }
+	/// <summary>
+	/// Called by the capture thread after the frame written with WriteNextFrameToSharedSurface is published to the recorder.
+	/// </summary>
+	virtual inline void OnFramePublished() {}
 	virtual HRESULT SendBitmapCallback(_In_ ID3D11Texture2D *pTexture);
 	/// <summary>
 	/// Calculate the offset used to position the content withing the parent frame based on the given anchor.
@@ -29,6 +47,8 @@ protected:
 	std::unique_ptr<TextureManager> m_TextureManager;
 	RECORDING_SOURCE_BASE *m_RecordingSource;
 	LARGE_INTEGER m_LastGrabTimeStamp;
+	bool m_IsPointerOnlyUpdatePublished;
+	CRITICAL_SECTION *m_DeviceCriticalSection;
 
 private:
 	ID3D11Texture2D *m_FrameDataCallbackTexture;
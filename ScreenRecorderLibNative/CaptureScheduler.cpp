@@ -0,0 +1,121 @@
+#include "CaptureScheduler.h"
+#include "Cleanup.h"
+#include "Log.h"
+
+CaptureScheduler::CaptureScheduler() :
+	m_Pool(nullptr),
+	m_CallbackEnvironment{},
+	m_MTAUsageCookie(nullptr),
+	m_MaxThreadCount(0),
+	m_Tasks{}
+{
+	InitializeCriticalSection(&m_CriticalSection);
+}
+
+CaptureScheduler::~CaptureScheduler()
+{
+	Stop();
+	if (m_Pool) {
+		DestroyThreadpoolEnvironment(&m_CallbackEnvironment);
+		CloseThreadpool(m_Pool);
+		m_Pool = nullptr;
+	}
+	if (m_MTAUsageCookie) {
+		CoDecrementMTAUsage(m_MTAUsageCookie);
+		m_MTAUsageCookie = nullptr;
+	}
+	DeleteCriticalSection(&m_CriticalSection);
+}
+
+HRESULT CaptureScheduler::Initialize()
+{
+	if (m_Pool) {
+		return S_FALSE;
+	}
+	//Keeps the multithreaded apartment alive for as long as the pool exists, so tasks can use COM without initializing it on every run.
+	HRESULT hr = CoIncrementMTAUsage(&m_MTAUsageCookie);
+	if (FAILED(hr)) {
+		LOG_ERROR(L"CoIncrementMTAUsage failed: hr = 0x%08x", hr);
+		return hr;
+	}
+	m_Pool = CreateThreadpool(nullptr);
+	if (!m_Pool) {
+		LOG_ERROR(L"CreateThreadpool failed: last error is %u", GetLastError());
+		return HRESULT_FROM_WIN32(GetLastError());
+	}
+	//Pooled tasks are short and mostly idle, so half the logical processors is plenty, and leaves the rest to the pinned capture threads and the encoder.
+	UINT processorCount = GetActiveProcessorCount(ALL_PROCESSOR_GROUPS);
+	m_MaxThreadCount = max(1u, min(processorCount / 2, 8u));
+	SetThreadpoolThreadMaximum(m_Pool, m_MaxThreadCount);
+	if (!SetThreadpoolThreadMinimum(m_Pool, 1)) {
+		LOG_WARN(L"SetThreadpoolThreadMinimum failed: last error is %u", GetLastError());
+	}
+	InitializeThreadpoolEnvironment(&m_CallbackEnvironment);
+	SetThreadpoolCallbackPool(&m_CallbackEnvironment, m_Pool);
+	LOG_DEBUG(L"Created capture worker pool with a maximum of %u threads", m_MaxThreadCount);
+	return S_OK;
+}
+
+HRESULT CaptureScheduler::ScheduleTask(_In_ std::function<DWORD()> task)
+{
+	if (!m_Pool) {
+		LOG_ERROR(L"Capture worker pool is not initialized");
+		return E_NOT_VALID_STATE;
+	}
+	SCHEDULED_TASK *pTask = new SCHEDULED_TASK();
+	pTask->Task = task;
+	pTask->IsCancelled = false;
+	pTask->Timer = CreateThreadpoolTimer(TimerCallback, pTask, &m_CallbackEnvironment);
+	if (!pTask->Timer) {
+		DWORD dwErr = GetLastError();
+		LOG_ERROR(L"CreateThreadpoolTimer failed: last error is %u", dwErr);
+		delete pTask;
+		return HRESULT_FROM_WIN32(dwErr);
+	}
+	EnterCriticalSection(&m_CriticalSection);
+	LeaveCriticalSectionOnExit leaveOnExit(&m_CriticalSection);
+	m_Tasks.push_back(pTask);
+	SetTimerDelay(pTask->Timer, 0);
+	return S_OK;
+}
+
+void CaptureScheduler::Stop()
+{
+	EnterCriticalSection(&m_CriticalSection);
+	LeaveCriticalSectionOnExit leaveOnExit(&m_CriticalSection);
+	for each (SCHEDULED_TASK * pTask in m_Tasks)
+	{
+		pTask->IsCancelled = true;
+		SetThreadpoolTimer(pTask->Timer, nullptr, 0, 0);
+		WaitForThreadpoolTimerCallbacks(pTask->Timer, TRUE);
+		//A callback that was running while the task was cancelled may have re-armed the timer before it saw the flag.
+		SetThreadpoolTimer(pTask->Timer, nullptr, 0, 0);
+		WaitForThreadpoolTimerCallbacks(pTask->Timer, TRUE);
+		CloseThreadpoolTimer(pTask->Timer);
+		delete pTask;
+	}
+	m_Tasks.clear();
+}
+
+VOID CALLBACK CaptureScheduler::TimerCallback(_Inout_ PTP_CALLBACK_INSTANCE pInstance, _Inout_opt_ PVOID pContext, _Inout_ PTP_TIMER pTimer)
+{
+	SCHEDULED_TASK *pTask = static_cast<SCHEDULED_TASK *>(pContext);
+	if (pTask->IsCancelled) {
+		return;
+	}
+	DWORD nextRunMillis = pTask->Task();
+	if (nextRunMillis != INFINITE && !pTask->IsCancelled) {
+		SetTimerDelay(pTimer, nextRunMillis);
+	}
+}
+
+void CaptureScheduler::SetTimerDelay(_In_ PTP_TIMER pTimer, _In_ DWORD delayMillis)
+{
+	//Negative due times are relative, in 100 nanosecond units. A zero due time would be read as an absolute time, so the shortest delay is one unit.
+	ULARGE_INTEGER dueTime;
+	dueTime.QuadPart = static_cast<ULONGLONG>(-max(1LL, static_cast<LONGLONG>(delayMillis) * 10000));
+	FILETIME fileDueTime;
+	fileDueTime.dwLowDateTime = dueTime.LowPart;
+	fileDueTime.dwHighDateTime = dueTime.HighPart;
+	SetThreadpoolTimer(pTimer, &fileDueTime, 0, 0);
+}
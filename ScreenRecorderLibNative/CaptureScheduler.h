@@ -0,0 +1,52 @@
+#pragma once
+#include <Windows.h>
+#include <combaseapi.h>
+#include <functional>
+#include <vector>
+#include <atomic>
+
+//
+// Runs recurring capture work on a shared pool of worker threads, instead of dedicating a thread to each source.
+// A task is a function that performs one unit of work and returns the number of milliseconds until it should run again,
+// or INFINITE when it is finished. Tasks are driven by one-shot thread pool timers that are re-armed after each run,
+// so a single task never runs concurrently with itself. Worker threads are implicitly part of the multithreaded COM apartment.
+//
+class CaptureScheduler
+{
+public:
+	CaptureScheduler();
+	~CaptureScheduler();
+
+	/// <summary>
+	/// Creates the worker pool. The number of worker threads scales with the number of logical processors.
+	/// </summary>
+	HRESULT Initialize();
+
+	/// <summary>
+	/// Schedules a task to run on the worker pool as soon as a worker is available.
+	/// </summary>
+	/// <param name="task">The task to run. Returns the delay in milliseconds until the next run, or INFINITE to stop.</param>
+	HRESULT ScheduleTask(_In_ std::function<DWORD()> task);
+
+	/// <summary>
+	/// Cancels all pending task runs, waits for running tasks to return and releases the tasks.
+	/// </summary>
+	void Stop();
+
+	inline UINT GetMaxThreadCount() { return m_MaxThreadCount; }
+private:
+	struct SCHEDULED_TASK {
+		std::function<DWORD()> Task;
+		PTP_TIMER Timer;
+		std::atomic<bool> IsCancelled;
+	};
+	static VOID CALLBACK TimerCallback(_Inout_ PTP_CALLBACK_INSTANCE pInstance, _Inout_opt_ PVOID pContext, _Inout_ PTP_TIMER pTimer);
+	static void SetTimerDelay(_In_ PTP_TIMER pTimer, _In_ DWORD delayMillis);
+
+	PTP_POOL m_Pool;
+	TP_CALLBACK_ENVIRON m_CallbackEnvironment;
+	CO_MTA_USAGE_COOKIE m_MTAUsageCookie;
+	UINT m_MaxThreadCount;
+	std::vector<SCHEDULED_TASK *> m_Tasks;
+	CRITICAL_SECTION m_CriticalSection;
+};
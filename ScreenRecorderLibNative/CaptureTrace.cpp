@@ -0,0 +1,679 @@
+#include "CaptureTrace.h"
+#include "CursorMetadata.h"
+#include "Log.h"
+#include "util.h"
+#include <algorithm>
+
+using namespace std;
+
+//Longest run of pixels a run header can hold
+#define PIXEL_RUN_MAX_LENGTH 0x8000
+#define PIXEL_RUN_REPEAT_FLAG 0x8000
+
+template <typename T>
+static void AppendValue(_Inout_ std::vector<BYTE> *pBuffer, _In_ T value)
+{
+	size_t offset = pBuffer->size();
+	pBuffer->resize(offset + sizeof(T));
+	memcpy(pBuffer->data() + offset, &value, sizeof(T));
+}
+
+static void AppendBytes(_Inout_ std::vector<BYTE> *pBuffer, _In_reads_bytes_(size) const void *pData, _In_ size_t size)
+{
+	if (size > 0) {
+		size_t offset = pBuffer->size();
+		pBuffer->resize(offset + size);
+		memcpy(pBuffer->data() + offset, pData, size);
+	}
+}
+
+//
+// Reads values from a record, and remembers if any read went past the end of it.
+//
+class RecordReader
+{
+public:
+	RecordReader(_In_ const std::vector<BYTE> &record) :
+		m_Record(record),
+		m_Offset(0),
+		m_IsTruncated(false)
+	{
+	}
+	template <typename T>
+	T Read()
+	{
+		T value{};
+		ReadBytes(&value, sizeof(T));
+		return value;
+	}
+	void ReadBytes(_Out_writes_bytes_(size) void *pData, _In_ size_t size)
+	{
+		if (m_IsTruncated || m_Record.size() - m_Offset < size) {
+			m_IsTruncated = true;
+			memset(pData, 0, size);
+			return;
+		}
+		memcpy(pData, m_Record.data() + m_Offset, size);
+		m_Offset += size;
+	}
+	std::vector<BYTE> ReadVector()
+	{
+		UINT32 size = Read<UINT32>();
+		if (m_IsTruncated || m_Record.size() - m_Offset < size) {
+			m_IsTruncated = true;
+			return std::vector<BYTE>();
+		}
+		std::vector<BYTE> data(m_Record.begin() + m_Offset, m_Record.begin() + m_Offset + size);
+		m_Offset += size;
+		return data;
+	}
+	bool IsTruncated() { return m_IsTruncated; }
+	bool IsAtEnd() { return m_Offset == m_Record.size(); }
+private:
+	const std::vector<BYTE> &m_Record;
+	size_t m_Offset;
+	bool m_IsTruncated;
+};
+
+std::vector<RECT> FindChangedTiles(_In_ const UINT *pPrevious, _In_ const UINT *pCurrent, _In_ UINT width, _In_ UINT height, _In_ UINT pitchInPixels, _In_ UINT tileSize)
+{
+	std::vector<RECT> rects{};
+	if (tileSize == 0) {
+		return rects;
+	}
+	for (UINT tileTop = 0; tileTop < height; tileTop += tileSize) {
+		UINT tileBottom = min(height, tileTop + tileSize);
+		//Left edge of the run of changed tiles on this row, if any
+		std::optional<UINT> runLeft = std::nullopt;
+		for (UINT tileLeft = 0; tileLeft < width; tileLeft += tileSize) {
+			UINT tileRight = min(width, tileLeft + tileSize);
+			bool isChanged = false;
+			for (UINT y = tileTop; y < tileBottom && !isChanged; y++) {
+				size_t offset = static_cast<size_t>(y) * pitchInPixels + tileLeft;
+				isChanged = memcmp(pPrevious + offset, pCurrent + offset, (tileRight - tileLeft) * sizeof(UINT)) != 0;
+			}
+			if (isChanged && !runLeft.has_value()) {
+				runLeft = tileLeft;
+			}
+			else if (!isChanged && runLeft.has_value()) {
+				rects.push_back(RECT{ static_cast<LONG>(runLeft.value()), static_cast<LONG>(tileTop), static_cast<LONG>(tileLeft), static_cast<LONG>(tileBottom) });
+				runLeft = std::nullopt;
+			}
+		}
+		if (runLeft.has_value()) {
+			rects.push_back(RECT{ static_cast<LONG>(runLeft.value()), static_cast<LONG>(tileTop), static_cast<LONG>(width), static_cast<LONG>(tileBottom) });
+		}
+	}
+	return rects;
+}
+
+void EncodePixelRuns(_In_reads_(count) const UINT *pPixels, _In_ size_t count, _Inout_ std::vector<BYTE> *pEncoded)
+{
+	size_t i = 0;
+	//Start of the literal pixels not yet written
+	size_t literalStart = 0;
+	auto WriteLiterals([&](size_t end) {
+		while (literalStart < end) {
+			size_t length = min(end - literalStart, static_cast<size_t>(PIXEL_RUN_MAX_LENGTH));
+			AppendValue<UINT16>(pEncoded, static_cast<UINT16>(length - 1));
+			AppendBytes(pEncoded, pPixels + literalStart, length * sizeof(UINT));
+			literalStart += length;
+		}
+	});
+	while (i < count) {
+		size_t runEnd = i + 1;
+		while (runEnd < count && runEnd - i < PIXEL_RUN_MAX_LENGTH && pPixels[runEnd] == pPixels[i]) {
+			runEnd++;
+		}
+		if (runEnd - i >= 2) {
+			WriteLiterals(i);
+			AppendValue<UINT16>(pEncoded, static_cast<UINT16>(PIXEL_RUN_REPEAT_FLAG | (runEnd - i - 1)));
+			AppendValue<UINT>(pEncoded, pPixels[i]);
+			literalStart = runEnd;
+		}
+		i = runEnd;
+	}
+	WriteLiterals(count);
+}
+
+HRESULT DecodePixelRuns(_In_ const std::vector<BYTE> &encoded, _In_ size_t count, _Out_ std::vector<UINT> *pPixels)
+{
+	pPixels->clear();
+	pPixels->reserve(count);
+	RecordReader reader(encoded);
+	while (pPixels->size() < count) {
+		UINT16 header = reader.Read<UINT16>();
+		size_t length = static_cast<size_t>(header & ~PIXEL_RUN_REPEAT_FLAG) + 1;
+		if (reader.IsTruncated() || pPixels->size() + length > count) {
+			return E_INVALIDARG;
+		}
+		if (header & PIXEL_RUN_REPEAT_FLAG) {
+			pPixels->insert(pPixels->end(), length, reader.Read<UINT>());
+		}
+		else {
+			size_t offset = pPixels->size();
+			pPixels->resize(offset + length);
+			reader.ReadBytes(pPixels->data() + offset, length * sizeof(UINT));
+		}
+		if (reader.IsTruncated()) {
+			return E_INVALIDARG;
+		}
+	}
+	//Runs left over mean the data was encoded from more pixels
+	return reader.IsAtEnd() ? S_OK : E_INVALIDARG;
+}
+
+CaptureTraceWriter::CaptureTraceWriter() :
+	m_Stream{},
+	m_Header{},
+	m_PreviousFrame{},
+	m_HasPreviousFrame(false),
+	m_LastPointer{},
+	m_LastShapeHash(0),
+	m_HasLastPointer(false),
+	m_AudioStreamPosition(0),
+	m_FrameRecordCount(0),
+	m_PointerRecordCount(0),
+	m_AudioRecordCount(0),
+	m_WrittenByteCount(0)
+{
+}
+
+CaptureTraceWriter::~CaptureTraceWriter()
+{
+	Close();
+}
+
+HRESULT CaptureTraceWriter::Open(_In_ std::wstring path, _In_ CAPTURE_TRACE_HEADER header)
+{
+	if (m_Stream.is_open()) {
+		m_Stream.close();
+	}
+	m_Stream.open(path, ios_base::out | ios_base::trunc | ios_base::binary);
+	if (!m_Stream.is_open()) {
+		LOG_ERROR(L"Failed to open capture trace file %ls", path.c_str());
+		return E_FAIL;
+	}
+	m_Header = header;
+	m_PreviousFrame.clear();
+	m_HasPreviousFrame = false;
+	m_HasLastPointer = false;
+	m_LastShapeHash = 0;
+	m_AudioStreamPosition = 0;
+	m_FrameRecordCount = 0;
+	m_PointerRecordCount = 0;
+	m_AudioRecordCount = 0;
+
+	std::vector<BYTE> buffer{};
+	AppendBytes(&buffer, CAPTURE_TRACE_MAGIC, sizeof(CAPTURE_TRACE_MAGIC));
+	AppendValue<UINT32>(&buffer, CAPTURE_TRACE_VERSION);
+	AppendValue<UINT32>(&buffer, header.Width);
+	AppendValue<UINT32>(&buffer, header.Height);
+	AppendValue<UINT32>(&buffer, header.AudioSamplesPerSecond);
+	AppendValue<UINT32>(&buffer, header.AudioChannels);
+	AppendValue<UINT32>(&buffer, header.AudioBitsPerSample);
+	m_Stream.write(reinterpret_cast<const char *>(buffer.data()), buffer.size());
+	m_WrittenByteCount = buffer.size();
+	LOG_DEBUG(L"Writing capture trace of %ux%u to %ls", header.Width, header.Height, path.c_str());
+	return m_Stream.good() ? S_OK : E_FAIL;
+}
+
+HRESULT CaptureTraceWriter::Close()
+{
+	if (!m_Stream.is_open()) {
+		return S_FALSE;
+	}
+	m_Stream.close();
+	return m_Stream.fail() ? E_FAIL : S_OK;
+}
+
+HRESULT CaptureTraceWriter::WriteFrame(_In_ INT64 timeStamp, _In_reads_(pitchInPixels *height) const UINT *pPixels, _In_ UINT width, _In_ UINT height, _In_ UINT pitchInPixels)
+{
+	if (!m_Stream.is_open()) {
+		return S_FALSE;
+	}
+	if (width != m_Header.Width || height != m_Header.Height) {
+		LOG_WARN(L"Frame of %ux%u does not match the %ux%u canvas of the capture trace", width, height, m_Header.Width, m_Header.Height);
+		return E_INVALIDARG;
+	}
+	std::vector<UINT> frame(static_cast<size_t>(width) * height);
+	for (UINT y = 0; y < height; y++) {
+		memcpy(frame.data() + static_cast<size_t>(y) * width, pPixels + static_cast<size_t>(y) * pitchInPixels, width * sizeof(UINT));
+	}
+	std::vector<RECT> dirtyRects{};
+	if (m_HasPreviousFrame) {
+		dirtyRects = FindChangedTiles(m_PreviousFrame.data(), frame.data(), width, height, width, CAPTURE_TRACE_TILE_SIZE);
+	}
+	else {
+		dirtyRects.push_back(RECT{ 0,0,static_cast<LONG>(width),static_cast<LONG>(height) });
+	}
+	if (dirtyRects.empty()) {
+		return S_FALSE;
+	}
+	std::vector<UINT> dirtyPixels{};
+	for each (RECT rect in dirtyRects)
+	{
+		for (LONG y = rect.top; y < rect.bottom; y++) {
+			const UINT *pRow = frame.data() + static_cast<size_t>(y) * width;
+			dirtyPixels.insert(dirtyPixels.end(), pRow + rect.left, pRow + rect.right);
+		}
+	}
+	std::vector<BYTE> payload{};
+	EncodePixelRuns(dirtyPixels.data(), dirtyPixels.size(), &payload);
+
+	std::vector<BYTE> record{};
+	AppendValue<INT64>(&record, timeStamp);
+	AppendValue<UINT32>(&record, static_cast<UINT32>(dirtyRects.size()));
+	for each (RECT rect in dirtyRects)
+	{
+		AppendValue<INT32>(&record, rect.left);
+		AppendValue<INT32>(&record, rect.top);
+		AppendValue<INT32>(&record, rect.right);
+		AppendValue<INT32>(&record, rect.bottom);
+	}
+	AppendValue<UINT32>(&record, static_cast<UINT32>(payload.size()));
+	AppendBytes(&record, payload.data(), payload.size());
+	HRESULT hr;
+	RETURN_ON_BAD_HR(hr = WriteRecord(CaptureTraceRecordType::Frame, record));
+	m_PreviousFrame.swap(frame);
+	m_HasPreviousFrame = true;
+	m_FrameRecordCount++;
+	return hr;
+}
+
+HRESULT CaptureTraceWriter::WritePointer(_In_ INT64 timeStamp, _In_ POINT position, _In_ bool visible, _In_ const DXGI_OUTDUPL_POINTER_SHAPE_INFO &shapeInfo, _In_reads_bytes_opt_(shapeBufferSize) const BYTE *pShapeBuffer, _In_ UINT shapeBufferSize)
+{
+	if (!m_Stream.is_open()) {
+		return S_FALSE;
+	}
+	UINT64 shapeHash = pShapeBuffer && shapeBufferSize > 0 ? GetCursorShapeHash(shapeInfo, pShapeBuffer, shapeBufferSize) : 0;
+	bool isShapeUpdated = shapeHash != 0 && shapeHash != m_LastShapeHash;
+	if (m_HasLastPointer && !isShapeUpdated && m_LastPointer.Visible == visible
+		&& (!visible || (m_LastPointer.Position.x == position.x && m_LastPointer.Position.y == position.y))) {
+		return S_FALSE;
+	}
+	std::vector<BYTE> record{};
+	AppendValue<INT64>(&record, timeStamp);
+	AppendValue<INT32>(&record, position.x);
+	AppendValue<INT32>(&record, position.y);
+	AppendValue<BYTE>(&record, visible ? 1 : 0);
+	AppendValue<BYTE>(&record, isShapeUpdated ? 1 : 0);
+	if (isShapeUpdated) {
+		AppendValue<UINT32>(&record, shapeInfo.Type);
+		AppendValue<UINT32>(&record, shapeInfo.Width);
+		AppendValue<UINT32>(&record, shapeInfo.Height);
+		AppendValue<UINT32>(&record, shapeInfo.Pitch);
+		AppendValue<INT32>(&record, shapeInfo.HotSpot.x);
+		AppendValue<INT32>(&record, shapeInfo.HotSpot.y);
+		AppendValue<UINT32>(&record, shapeBufferSize);
+		AppendBytes(&record, pShapeBuffer, shapeBufferSize);
+	}
+	HRESULT hr;
+	RETURN_ON_BAD_HR(hr = WriteRecord(CaptureTraceRecordType::Pointer, record));
+	m_LastPointer.TimeStamp = timeStamp;
+	m_LastPointer.Position = position;
+	m_LastPointer.Visible = visible;
+	if (isShapeUpdated) {
+		m_LastShapeHash = shapeHash;
+	}
+	m_HasLastPointer = true;
+	m_PointerRecordCount++;
+	return hr;
+}
+
+HRESULT CaptureTraceWriter::WriteAudio(_In_ INT64 timeStamp, _In_ const std::vector<BYTE> &data)
+{
+	if (!m_Stream.is_open()) {
+		return S_FALSE;
+	}
+	UINT32 blockAlign = m_Header.AudioChannels * m_Header.AudioBitsPerSample / 8;
+	if (blockAlign == 0) {
+		LOG_WARN(L"Audio can not be written to a capture trace without an audio format");
+		return E_INVALIDARG;
+	}
+	std::vector<BYTE> record{};
+	AppendValue<INT64>(&record, timeStamp);
+	AppendValue<UINT64>(&record, m_AudioStreamPosition);
+	AppendValue<UINT32>(&record, static_cast<UINT32>(data.size()));
+	AppendBytes(&record, data.data(), data.size());
+	HRESULT hr;
+	RETURN_ON_BAD_HR(hr = WriteRecord(CaptureTraceRecordType::Audio, record));
+	m_AudioStreamPosition += data.size() / blockAlign;
+	m_AudioRecordCount++;
+	return hr;
+}
+
+HRESULT CaptureTraceWriter::WriteRecord(_In_ CaptureTraceRecordType type, _In_ const std::vector<BYTE> &record)
+{
+	BYTE recordType = static_cast<BYTE>(type);
+	UINT32 recordSize = static_cast<UINT32>(record.size());
+	m_Stream.write(reinterpret_cast<const char *>(&recordType), sizeof(recordType));
+	m_Stream.write(reinterpret_cast<const char *>(&recordSize), sizeof(recordSize));
+	m_Stream.write(reinterpret_cast<const char *>(record.data()), record.size());
+	if (!m_Stream.good()) {
+		LOG_ERROR(L"Failed to write to capture trace file");
+		return E_FAIL;
+	}
+	m_WrittenByteCount += sizeof(recordType) + sizeof(recordSize) + record.size();
+	return S_OK;
+}
+
+CaptureTraceReplay::CaptureTraceReplay() :
+	m_Header{},
+	m_Frames{},
+	m_Pointers{},
+	m_PointerShapeIndexes{},
+	m_Audio{},
+	m_AudioIndex(0),
+	m_ReadAudioDuration(0),
+	m_Clock(nullptr),
+	m_RequestedTime(-1),
+	m_PresentedTime(-1)
+{
+}
+
+static HRESULT ReadTraceHeader(_In_ std::istream &stream, _Out_ CAPTURE_TRACE_HEADER *pHeader)
+{
+	*pHeader = CAPTURE_TRACE_HEADER{};
+	std::vector<BYTE> buffer(sizeof(CAPTURE_TRACE_MAGIC) + 6 * sizeof(UINT32));
+	stream.read(reinterpret_cast<char *>(buffer.data()), buffer.size());
+	if (stream.gcount() != static_cast<std::streamsize>(buffer.size())
+		|| memcmp(buffer.data(), CAPTURE_TRACE_MAGIC, sizeof(CAPTURE_TRACE_MAGIC)) != 0) {
+		LOG_ERROR(L"Not a capture trace file");
+		return E_INVALIDARG;
+	}
+	RecordReader reader(buffer);
+	char magic[sizeof(CAPTURE_TRACE_MAGIC)];
+	reader.ReadBytes(magic, sizeof(magic));
+	UINT32 version = reader.Read<UINT32>();
+	if (version != CAPTURE_TRACE_VERSION) {
+		LOG_ERROR(L"Unsupported capture trace version %u", version);
+		return E_INVALIDARG;
+	}
+	pHeader->Width = reader.Read<UINT32>();
+	pHeader->Height = reader.Read<UINT32>();
+	pHeader->AudioSamplesPerSecond = reader.Read<UINT32>();
+	pHeader->AudioChannels = reader.Read<UINT32>();
+	pHeader->AudioBitsPerSample = reader.Read<UINT32>();
+	return S_OK;
+}
+
+HRESULT CaptureTraceReplay::ReadHeader(_In_ std::wstring path, _Out_ CAPTURE_TRACE_HEADER *pHeader)
+{
+	std::ifstream stream(path, ios_base::in | ios_base::binary);
+	if (!stream.is_open()) {
+		*pHeader = CAPTURE_TRACE_HEADER{};
+		LOG_ERROR(L"Failed to open capture trace file %ls", path.c_str());
+		return E_FAIL;
+	}
+	return ReadTraceHeader(stream, pHeader);
+}
+
+HRESULT CaptureTraceReplay::Load(_In_ std::wstring path)
+{
+	std::ifstream stream(path, ios_base::in | ios_base::binary);
+	if (!stream.is_open()) {
+		LOG_ERROR(L"Failed to open capture trace file %ls", path.c_str());
+		return E_FAIL;
+	}
+	return Load(stream);
+}
+
+HRESULT CaptureTraceReplay::Load(_In_ std::istream &stream)
+{
+	m_Frames.clear();
+	m_Pointers.clear();
+	m_PointerShapeIndexes.clear();
+	m_Audio.clear();
+	m_AudioIndex = 0;
+	m_ReadAudioDuration = 0;
+	HRESULT hr;
+	RETURN_ON_BAD_HR(hr = ReadTraceHeader(stream, &m_Header));
+	INT64 shapeIndex = -1;
+	std::vector<BYTE> record{};
+	while (true) {
+		BYTE recordType = 0;
+		UINT32 recordSize = 0;
+		stream.read(reinterpret_cast<char *>(&recordType), sizeof(recordType));
+		if (stream.gcount() == 0) {
+			break;
+		}
+		stream.read(reinterpret_cast<char *>(&recordSize), sizeof(recordSize));
+		bool isComplete = stream.gcount() == sizeof(recordSize);
+		if (isComplete) {
+			record.resize(recordSize);
+			stream.read(reinterpret_cast<char *>(record.data()), recordSize);
+			isComplete = stream.gcount() == static_cast<std::streamsize>(recordSize);
+		}
+		if (!isComplete) {
+			//A trace of a recording that crashed can end in the middle of a record, so the records before it are kept.
+			LOG_WARN(L"Capture trace ends in a truncated record, it is replayed up to the record");
+			break;
+		}
+		RecordReader reader(record);
+		switch (static_cast<CaptureTraceRecordType>(recordType))
+		{
+			case CaptureTraceRecordType::Frame: {
+				CAPTURE_TRACE_FRAME frame{};
+				frame.TimeStamp = reader.Read<INT64>();
+				UINT32 rectCount = reader.Read<UINT32>();
+				for (UINT32 i = 0; i < rectCount && !reader.IsTruncated(); i++) {
+					RECT rect{};
+					rect.left = reader.Read<INT32>();
+					rect.top = reader.Read<INT32>();
+					rect.right = reader.Read<INT32>();
+					rect.bottom = reader.Read<INT32>();
+					frame.DirtyRects.push_back(rect);
+				}
+				frame.Payload = reader.ReadVector();
+				if (!reader.IsTruncated()) {
+					m_Frames.push_back(std::move(frame));
+				}
+				break;
+			}
+			case CaptureTraceRecordType::Pointer: {
+				CAPTURE_TRACE_POINTER pointer{};
+				pointer.TimeStamp = reader.Read<INT64>();
+				pointer.Position.x = reader.Read<INT32>();
+				pointer.Position.y = reader.Read<INT32>();
+				pointer.Visible = reader.Read<BYTE>() != 0;
+				pointer.IsShapeUpdated = reader.Read<BYTE>() != 0;
+				if (pointer.IsShapeUpdated) {
+					pointer.ShapeInfo.Type = reader.Read<UINT32>();
+					pointer.ShapeInfo.Width = reader.Read<UINT32>();
+					pointer.ShapeInfo.Height = reader.Read<UINT32>();
+					pointer.ShapeInfo.Pitch = reader.Read<UINT32>();
+					pointer.ShapeInfo.HotSpot.x = reader.Read<INT32>();
+					pointer.ShapeInfo.HotSpot.y = reader.Read<INT32>();
+					pointer.ShapeBuffer = reader.ReadVector();
+				}
+				if (!reader.IsTruncated()) {
+					if (pointer.IsShapeUpdated) {
+						shapeIndex = static_cast<INT64>(m_Pointers.size());
+					}
+					m_Pointers.push_back(std::move(pointer));
+					m_PointerShapeIndexes.push_back(shapeIndex);
+				}
+				break;
+			}
+			case CaptureTraceRecordType::Audio: {
+				CAPTURE_TRACE_AUDIO audio{};
+				audio.TimeStamp = reader.Read<INT64>();
+				audio.StreamPosition = reader.Read<UINT64>();
+				audio.Data = reader.ReadVector();
+				if (!reader.IsTruncated()) {
+					m_Audio.push_back(std::move(audio));
+				}
+				break;
+			}
+			default:
+				//Records added in later versions are skipped.
+				break;
+		}
+		if (reader.IsTruncated()) {
+			LOG_WARN(L"Skipped malformed capture trace record of type %u", recordType);
+		}
+	}
+	LOG_DEBUG(L"Loaded capture trace of %ux%u with %zu frames, %zu pointer records and %zu audio packets", m_Header.Width, m_Header.Height, m_Frames.size(), m_Pointers.size(), m_Audio.size());
+	return S_OK;
+}
+
+INT64 CaptureTraceReplay::GetDuration()
+{
+	INT64 duration = 0;
+	if (!m_Frames.empty()) {
+		duration = max(duration, m_Frames.back().TimeStamp);
+	}
+	if (!m_Pointers.empty()) {
+		duration = max(duration, m_Pointers.back().TimeStamp);
+	}
+	if (HasAudio()) {
+		const CAPTURE_TRACE_AUDIO &lastPacket = m_Audio.back();
+		INT64 frameCount = lastPacket.Data.size() / (m_Header.AudioChannels * m_Header.AudioBitsPerSample / 8);
+		duration = max(duration, lastPacket.TimeStamp + MediaTimeFromCount(frameCount, MEDIA_RATE{ m_Header.AudioSamplesPerSecond, 1 }));
+	}
+	return duration;
+}
+
+size_t CaptureTraceReplay::GetFrameCountUntil(_In_ INT64 timeStamp)
+{
+	return std::upper_bound(m_Frames.begin(), m_Frames.end(), timeStamp, [](INT64 time, const CAPTURE_TRACE_FRAME &frame) { return time < frame.TimeStamp; }) - m_Frames.begin();
+}
+
+size_t CaptureTraceReplay::GetPointerCountUntil(_In_ INT64 timeStamp)
+{
+	return std::upper_bound(m_Pointers.begin(), m_Pointers.end(), timeStamp, [](INT64 time, const CAPTURE_TRACE_POINTER &pointer) { return time < pointer.TimeStamp; }) - m_Pointers.begin();
+}
+
+const CAPTURE_TRACE_POINTER *CaptureTraceReplay::GetPointerShape(_In_ size_t pointerIndex)
+{
+	if (pointerIndex >= m_PointerShapeIndexes.size() || m_PointerShapeIndexes[pointerIndex] < 0) {
+		return nullptr;
+	}
+	return &m_Pointers[static_cast<size_t>(m_PointerShapeIndexes[pointerIndex])];
+}
+
+HRESULT CaptureTraceReplay::ApplyFrame(_In_ size_t frameIndex, _Inout_ std::vector<UINT> *pCanvas)
+{
+	if (frameIndex >= m_Frames.size()) {
+		return E_INVALIDARG;
+	}
+	size_t canvasPixelCount = static_cast<size_t>(m_Header.Width) * m_Header.Height;
+	if (pCanvas->size() != canvasPixelCount) {
+		pCanvas->assign(canvasPixelCount, 0);
+	}
+	const CAPTURE_TRACE_FRAME &frame = m_Frames[frameIndex];
+	size_t pixelCount = 0;
+	for each (RECT rect in frame.DirtyRects)
+	{
+		if (rect.left < 0 || rect.top < 0 || rect.right > static_cast<LONG>(m_Header.Width) || rect.bottom > static_cast<LONG>(m_Header.Height)
+			|| rect.right < rect.left || rect.bottom < rect.top) {
+			LOG_ERROR(L"Capture trace frame %zu has a dirty rect outside the canvas", frameIndex);
+			return E_INVALIDARG;
+		}
+		pixelCount += static_cast<size_t>(RectWidth(rect)) * RectHeight(rect);
+	}
+	std::vector<UINT> pixels{};
+	HRESULT hr;
+	RETURN_ON_BAD_HR(hr = DecodePixelRuns(frame.Payload, pixelCount, &pixels));
+	const UINT *pSource = pixels.data();
+	for each (RECT rect in frame.DirtyRects)
+	{
+		for (LONG y = rect.top; y < rect.bottom; y++) {
+			memcpy(pCanvas->data() + static_cast<size_t>(y) * m_Header.Width + rect.left, pSource, RectWidth(rect) * sizeof(UINT));
+			pSource += RectWidth(rect);
+		}
+	}
+	return hr;
+}
+
+std::vector<BYTE> CaptureTraceReplay::ReadAudio(_In_ UINT64 durationHundredNanos)
+{
+	UINT32 blockAlign = m_Header.AudioChannels * m_Header.AudioBitsPerSample / 8;
+	if (blockAlign == 0) {
+		return std::vector<BYTE>();
+	}
+	MEDIA_RATE rate{ m_Header.AudioSamplesPerSecond, 1 };
+	UINT64 startFrame = CountFromMediaTime(m_ReadAudioDuration, rate);
+	m_ReadAudioDuration += durationHundredNanos;
+	UINT64 endFrame = CountFromMediaTime(m_ReadAudioDuration, rate);
+	std::vector<BYTE> audio(static_cast<size_t>(endFrame - startFrame) * blockAlign, 0);
+	auto GetPacketEnd([&](const CAPTURE_TRACE_AUDIO &packet) {
+		return packet.StreamPosition + packet.Data.size() / blockAlign;
+	});
+	while (m_AudioIndex < m_Audio.size() && GetPacketEnd(m_Audio[m_AudioIndex]) <= startFrame) {
+		m_AudioIndex++;
+	}
+	for (size_t i = m_AudioIndex; i < m_Audio.size() && m_Audio[i].StreamPosition < endFrame; i++) {
+		const CAPTURE_TRACE_AUDIO &packet = m_Audio[i];
+		UINT64 copyStart = max(startFrame, packet.StreamPosition);
+		UINT64 copyEnd = min(endFrame, GetPacketEnd(packet));
+		if (copyEnd > copyStart) {
+			memcpy(audio.data() + (copyStart - startFrame) * blockAlign, packet.Data.data() + (copyStart - packet.StreamPosition) * blockAlign, static_cast<size_t>(copyEnd - copyStart) * blockAlign);
+		}
+	}
+	return audio;
+}
+
+void CaptureTraceReplay::SetClock(_In_ std::shared_ptr<MediaClock> pClock)
+{
+	std::scoped_lock lock(m_Mutex);
+	m_Clock = pClock;
+}
+
+std::shared_ptr<MediaClock> CaptureTraceReplay::GetClock()
+{
+	std::scoped_lock lock(m_Mutex);
+	return m_Clock;
+}
+
+INT64 CaptureTraceReplay::GetLastRecordTimeUntil(_In_ INT64 timeStamp)
+{
+	INT64 lastTime = -1;
+	size_t frameCount = GetFrameCountUntil(timeStamp);
+	if (frameCount > 0) {
+		lastTime = m_Frames[frameCount - 1].TimeStamp;
+	}
+	size_t pointerCount = GetPointerCountUntil(timeStamp);
+	if (pointerCount > 0) {
+		lastTime = max(lastTime, m_Pointers[pointerCount - 1].TimeStamp);
+	}
+	return lastTime;
+}
+
+std::optional<INT64> CaptureTraceReplay::GetNextRecordTimeAfter(_In_ INT64 timeStamp)
+{
+	std::optional<INT64> nextTime = std::nullopt;
+	size_t frameCount = GetFrameCountUntil(timeStamp);
+	if (frameCount < m_Frames.size()) {
+		nextTime = m_Frames[frameCount].TimeStamp;
+	}
+	size_t pointerCount = GetPointerCountUntil(timeStamp);
+	if (pointerCount < m_Pointers.size()) {
+		nextTime = min(nextTime.value_or(MAXINT64), m_Pointers[pointerCount].TimeStamp);
+	}
+	return nextTime;
+}
+
+HRESULT CaptureTraceReplay::PresentUntil(_In_ INT64 timeStamp, _In_ DWORD timeoutMillis)
+{
+	INT64 lastRecordTime = GetLastRecordTimeUntil(timeStamp);
+	std::unique_lock lock(m_Mutex);
+	m_RequestedTime = max(m_RequestedTime, timeStamp);
+	m_Condition.notify_all();
+	bool isPresented = m_Condition.wait_for(lock, std::chrono::milliseconds(timeoutMillis), [&]() { return m_PresentedTime >= lastRecordTime; });
+	return isPresented ? S_OK : S_FALSE;
+}
+
+void CaptureTraceReplay::SetPresented(_In_ INT64 timeStamp)
+{
+	std::scoped_lock lock(m_Mutex);
+	m_PresentedTime = max(m_PresentedTime, timeStamp);
+	m_Condition.notify_all();
+}
+
+bool CaptureTraceReplay::WaitForPresentRequest(_In_ INT64 timeStamp, _In_ DWORD timeoutMillis)
+{
+	std::unique_lock lock(m_Mutex);
+	return m_Condition.wait_for(lock, std::chrono::milliseconds(timeoutMillis), [&]() { return m_RequestedTime > timeStamp; });
+}
@@ -0,0 +1,221 @@
+#pragma once
+#include <Windows.h>
+#include <dxgi1_2.h>
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <fstream>
+#include <istream>
+#include "MediaClock.h"
+
+//
+// Records the inputs of the recording pipeline to a compact binary trace file, and replays them, so performance problems that depend on
+// the exact sequence of frames, pointer updates and audio packets can be reproduced and benchmarked. The trace file has the extension .srtrace:
+//
+//   header    "SRTRACE" 0, version, canvas width and height, audio samples per second, channels and bits per sample
+//   records   type (1 byte), size of the record in bytes (4 bytes), record
+//
+// A frame record holds the rectangles of the canvas that changed since the previous frame, and the pixels of those rectangles, run length encoded.
+// A pointer record holds the position and visibility of the pointer, and its shape when it changed since the previous pointer record.
+// An audio record holds the position of the packet in the audio stream in sample frames, and the PCM bytes of the packet.
+// Every record starts with its time stamp, in 100 nanosecond units on the media timeline of the recording. All values are little endian.
+//
+
+#define CAPTURE_TRACE_MAGIC "SRTRACE"
+#define CAPTURE_TRACE_VERSION 1
+#define CAPTURE_TRACE_FILE_EXTENSION L".srtrace"
+//Width and height of the tiles frames are compared in to find the changed areas
+#define CAPTURE_TRACE_TILE_SIZE 64
+
+enum class CaptureTraceRecordType : BYTE {
+	Frame = 1,
+	Pointer = 2,
+	Audio = 3
+};
+
+struct CAPTURE_TRACE_HEADER {
+	//Size of the canvas the frames are recorded from
+	UINT32 Width{};
+	UINT32 Height{};
+	//Format of the audio records, or 0 if the trace has no audio
+	UINT32 AudioSamplesPerSecond{};
+	UINT32 AudioChannels{};
+	UINT32 AudioBitsPerSample{};
+};
+
+struct CAPTURE_TRACE_FRAME {
+	INT64 TimeStamp{};
+	//Areas of the canvas that changed since the previous frame. The first frame covers the whole canvas.
+	std::vector<RECT> DirtyRects;
+	//Pixels of the dirty rects, row by row and rect by rect, run length encoded with EncodePixelRuns
+	std::vector<BYTE> Payload;
+};
+
+struct CAPTURE_TRACE_POINTER {
+	INT64 TimeStamp{};
+	//Top left corner of the pointer shape in canvas coordinates
+	POINT Position{};
+	bool Visible{};
+	//True if the record holds a new shape. Otherwise the pointer has the shape of the most recent record that holds one.
+	bool IsShapeUpdated{};
+	DXGI_OUTDUPL_POINTER_SHAPE_INFO ShapeInfo{};
+	std::vector<BYTE> ShapeBuffer;
+};
+
+struct CAPTURE_TRACE_AUDIO {
+	INT64 TimeStamp{};
+	//Position of the first sample frame of the packet in the audio stream of the recording
+	UINT64 StreamPosition{};
+	std::vector<BYTE> Data;
+};
+
+/// <summary>
+/// Compares two 32bpp frames in square tiles, and returns the tiles that differ as rectangles. Changed tiles that are next to each other on a row of tiles are merged.
+/// </summary>
+std::vector<RECT> FindChangedTiles(_In_ const UINT *pPrevious, _In_ const UINT *pCurrent, _In_ UINT width, _In_ UINT height, _In_ UINT pitchInPixels, _In_ UINT tileSize);
+/// <summary>
+/// Appends the pixels to the buffer as runs of identical pixels and runs of literal pixels. Each run starts with a 16 bit header,
+/// where the high bit is set for a run of identical pixels, and the other bits are the length of the run minus one.
+/// </summary>
+void EncodePixelRuns(_In_reads_(count) const UINT *pPixels, _In_ size_t count, _Inout_ std::vector<BYTE> *pEncoded);
+/// <summary>
+/// Decodes pixels encoded with EncodePixelRuns.
+/// </summary>
+/// <returns>E_INVALIDARG if the encoded data is truncated or does not decode to the expected number of pixels.</returns>
+HRESULT DecodePixelRuns(_In_ const std::vector<BYTE> &encoded, _In_ size_t count, _Out_ std::vector<UINT> *pPixels);
+
+class CaptureTraceWriter
+{
+public:
+	CaptureTraceWriter();
+	~CaptureTraceWriter();
+	HRESULT Open(_In_ std::wstring path, _In_ CAPTURE_TRACE_HEADER header);
+	HRESULT Close();
+	/// <summary>
+	/// Writes the areas of a 32bpp canvas frame that changed since the previous frame. The first frame is written in full.
+	/// </summary>
+	/// <returns>S_OK if the frame was written, S_FALSE if it was unchanged or the writer is closed.</returns>
+	HRESULT WriteFrame(_In_ INT64 timeStamp, _In_reads_(pitchInPixels *height) const UINT *pPixels, _In_ UINT width, _In_ UINT height, _In_ UINT pitchInPixels);
+	/// <summary>
+	/// Writes the pointer state, unless it is identical to the previous state. The shape is only written when it changed.
+	/// </summary>
+	/// <returns>S_OK if the state was written, S_FALSE if it was unchanged or the writer is closed.</returns>
+	HRESULT WritePointer(_In_ INT64 timeStamp, _In_ POINT position, _In_ bool visible, _In_ const DXGI_OUTDUPL_POINTER_SHAPE_INFO &shapeInfo, _In_reads_bytes_opt_(shapeBufferSize) const BYTE *pShapeBuffer, _In_ UINT shapeBufferSize);
+	/// <summary>
+	/// Writes a packet of audio in the format of the header. The position of the packet in the audio stream follows from the packets written before it.
+	/// </summary>
+	HRESULT WriteAudio(_In_ INT64 timeStamp, _In_ const std::vector<BYTE> &data);
+
+	inline INT64 GetFrameRecordCount() { return m_FrameRecordCount; }
+	inline INT64 GetPointerRecordCount() { return m_PointerRecordCount; }
+	inline INT64 GetAudioRecordCount() { return m_AudioRecordCount; }
+	inline UINT64 GetWrittenByteCount() { return m_WrittenByteCount; }
+private:
+	std::ofstream m_Stream;
+	CAPTURE_TRACE_HEADER m_Header;
+	std::vector<UINT> m_PreviousFrame;
+	bool m_HasPreviousFrame;
+	CAPTURE_TRACE_POINTER m_LastPointer;
+	UINT64 m_LastShapeHash;
+	bool m_HasLastPointer;
+	UINT64 m_AudioStreamPosition;
+	INT64 m_FrameRecordCount;
+	INT64 m_PointerRecordCount;
+	INT64 m_AudioRecordCount;
+	UINT64 m_WrittenByteCount;
+
+	HRESULT WriteRecord(_In_ CaptureTraceRecordType type, _In_ const std::vector<BYTE> &record);
+};
+
+//
+// A capture trace loaded for replay. Replayed sources present the frames and pointer updates that are due on the media clock of the recording,
+// and the audio is read back in the order it was recorded. When the recording runs at full speed, the recorder advances a virtual clock
+// and waits with PresentUntil for the replayed sources to catch up, so every run renders the same frames.
+//
+class CaptureTraceReplay
+{
+public:
+	CaptureTraceReplay();
+	HRESULT Load(_In_ std::wstring path);
+	HRESULT Load(_In_ std::istream &stream);
+	/// <summary>
+	/// Reads only the header of a trace file, e.g. to get the size of the canvas.
+	/// </summary>
+	static HRESULT ReadHeader(_In_ std::wstring path, _Out_ CAPTURE_TRACE_HEADER *pHeader);
+
+	inline const CAPTURE_TRACE_HEADER &GetHeader() { return m_Header; }
+	inline const std::vector<CAPTURE_TRACE_FRAME> &GetFrames() { return m_Frames; }
+	inline const std::vector<CAPTURE_TRACE_POINTER> &GetPointers() { return m_Pointers; }
+	inline const std::vector<CAPTURE_TRACE_AUDIO> &GetAudio() { return m_Audio; }
+	inline bool HasAudio() { return !m_Audio.empty() && m_Header.AudioChannels > 0 && m_Header.AudioBitsPerSample > 0; }
+	/// <summary>
+	/// Returns the time stamp of the last record of the trace.
+	/// </summary>
+	INT64 GetDuration();
+	/// <summary>
+	/// Returns the number of frames recorded at or before the time.
+	/// </summary>
+	size_t GetFrameCountUntil(_In_ INT64 timeStamp);
+	/// <summary>
+	/// Returns the number of pointer records recorded at or before the time.
+	/// </summary>
+	size_t GetPointerCountUntil(_In_ INT64 timeStamp);
+	/// <summary>
+	/// Returns the pointer record that holds the shape of the pointer record at the index, or nullptr if no shape was recorded yet.
+	/// </summary>
+	const CAPTURE_TRACE_POINTER *GetPointerShape(_In_ size_t pointerIndex);
+	/// <summary>
+	/// Decodes the frame at the index onto a canvas of the size in the header, which holds the previous frame.
+	/// </summary>
+	HRESULT ApplyFrame(_In_ size_t frameIndex, _Inout_ std::vector<UINT> *pCanvas);
+	/// <summary>
+	/// Returns the audio for the next duration of the stream. Parts of the stream no packet was recorded for are silent.
+	/// The stream position is kept in time rather than in samples, so durations that are not a whole number of samples do not drift.
+	/// </summary>
+	std::vector<BYTE> ReadAudio(_In_ UINT64 durationHundredNanos);
+
+	/// <summary>
+	/// Sets the clock of the recording the trace is replayed in.
+	/// </summary>
+	void SetClock(_In_ std::shared_ptr<MediaClock> pClock);
+	std::shared_ptr<MediaClock> GetClock();
+	/// <summary>
+	/// Returns the time of the most recent record at or before the time, or -1 if there is none. Records at the same time are presented together.
+	/// </summary>
+	INT64 GetLastRecordTimeUntil(_In_ INT64 timeStamp);
+	/// <summary>
+	/// Returns the time of the first frame or pointer record after the time, or nullopt if there are no more.
+	/// </summary>
+	std::optional<INT64> GetNextRecordTimeAfter(_In_ INT64 timeStamp);
+	/// <summary>
+	/// Wakes the replayed sources, and waits until they have presented everything recorded up to the time.
+	/// </summary>
+	/// <returns>S_OK if the records were presented, S_FALSE if not within the timeout.</returns>
+	HRESULT PresentUntil(_In_ INT64 timeStamp, _In_ DWORD timeoutMillis);
+	/// <summary>
+	/// Called by a replayed source when it has presented the records up to the time.
+	/// </summary>
+	void SetPresented(_In_ INT64 timeStamp);
+	/// <summary>
+	/// Waits for the recorder to ask for records after the time with PresentUntil.
+	/// </summary>
+	/// <returns>True if records after the time were asked for within the timeout.</returns>
+	bool WaitForPresentRequest(_In_ INT64 timeStamp, _In_ DWORD timeoutMillis);
+private:
+	CAPTURE_TRACE_HEADER m_Header;
+	std::vector<CAPTURE_TRACE_FRAME> m_Frames;
+	std::vector<CAPTURE_TRACE_POINTER> m_Pointers;
+	//Index of the record holding the shape of each pointer record, or -1 if none
+	std::vector<INT64> m_PointerShapeIndexes;
+	std::vector<CAPTURE_TRACE_AUDIO> m_Audio;
+	size_t m_AudioIndex;
+	UINT64 m_ReadAudioDuration;
+
+	std::mutex m_Mutex;
+	std::condition_variable m_Condition;
+	std::shared_ptr<MediaClock> m_Clock;
+	INT64 m_RequestedTime;
+	INT64 m_PresentedTime;
+};
@@ -11,8 +11,16 @@
 #include <optional>
 #include <wincodec.h>
 #include <chrono>
+#include <memory>
 #include "util.h"
 
+class TripleBufferedTexture;
+class CursorMetadataWriter;
+class CaptureTraceReplay;
+class MediaClock;
+class MetricGauge;
+class LatencyHistogram;
+
 typedef void(__stdcall *CallbackNewFrameDataFunction)(int, byte *, int, int, int);
 
 struct FRAME_BITMAP_DATA {
@@ -94,6 +102,9 @@ struct PTR_INFO
 	SIZE_F Scale;
 	bool Visible;
 	bool IsPointerShapeUpdated;
+	// Incremented every time the shape is updated. IsPointerShapeUpdated is cleared when a frame is acquired, so copies of the
+	// pointer info on frames that are skipped do not tell the shape changed. Comparing this count does.
+	UINT64 ShapeUpdateCount;
 	UINT BufferSize;
 	RECT WhoUpdatedPositionLast;
 	LARGE_INTEGER LastTimeStamp;
@@ -104,6 +115,7 @@ struct PTR_INFO
 		Scale{ 1.0, 1.0 },
 		Visible(false),
 		IsPointerShapeUpdated(false),
+		ShapeUpdateCount(0),
 		BufferSize(0),
 		WhoUpdatedPositionLast{},
 		LastTimeStamp{},
@@ -165,6 +177,8 @@ struct CAPTURED_FRAME
 	std::optional<PTR_INFO> PtrInfo;
 	//The number of updates written to the current frame since last fetch.
 	int FrameUpdateCount;
+	//QueryPerformanceCounter time the frame was composed.
+	LARGE_INTEGER TimeStamp;
 };
 
 enum class RecorderModeInternal {
@@ -204,7 +218,73 @@ enum class RecordingSourceType {
 	Window,
 	CameraCapture,
 	Picture,
-	Video
+	Video,
+	TestPattern,
+	Replay
+};
+
+enum class TestPatternMode {
+	//Color bars that move sideways every frame
+	MovingBars,
+	//Lines of text that scroll upwards every frame
+	ScrollingText,
+	//New random pixels every frame, the worst case for the encoder
+	Noise,
+	//A static background where a fixed number of small rectangles change every frame
+	DirtyRects
+};
+
+enum class AudioTestSignal {
+	None,
+	//Digital silence
+	Silence,
+	//A continuous 1 kHz sine tone
+	Tone,
+	//White noise
+	Noise,
+	//A short 1 kHz beep at the start of every second, and silence for the rest
+	Beeps
+};
+
+enum class TraceReplaySpeed {
+	//Records are presented at the media time they were recorded at
+	RealTime,
+	//The recording runs on a virtual clock that skips ahead to the next frame as soon as the replayed records are presented
+	FullSpeed
+};
+
+struct TEST_PATTERN_OPTIONS {
+	TestPatternMode Mode;
+	/// <summary>
+	/// The size of the generated frames
+	/// </summary>
+	SIZE Size;
+	/// <summary>
+	/// The number of frames generated per second
+	/// </summary>
+	UINT32 FrameRate;
+	/// <summary>
+	/// The number of rectangles that change every frame in the DirtyRects mode
+	/// </summary>
+	UINT32 DirtyRectCount;
+	/// <summary>
+	/// Seed of the random content, so runs with the same seed generate the same frames.
+	/// </summary>
+	UINT32 Seed;
+	/// <summary>
+	/// Moves a generated mouse pointer over the frames.
+	/// </summary>
+	bool IsPointerEnabled;
+	TEST_PATTERN_OPTIONS() :
+		Mode(TestPatternMode::MovingBars),
+		Size{ 1920, 1080 },
+		FrameRate(60),
+		DirtyRectCount(8),
+		Seed(1),
+		IsPointerEnabled(true)
+	{
+
+	}
 };
 
 enum class RecordingSourceApi {
@@ -257,6 +337,22 @@ public:
 	/// The requested dimensions of the frame preview bitmap
 	/// </summary>
 	std::optional<SIZE> VideoFramePreviewSize;
+	/// <summary>
+	/// The generated content of test pattern sources.
+	/// </summary>
+	TEST_PATTERN_OPTIONS TestPattern;
+	/// <summary>
+	/// How fast the capture trace of replay sources is replayed.
+	/// </summary>
+	TraceReplaySpeed ReplaySpeed;
+	/// <summary>
+	/// The capture trace of replay sources. It is loaded from the source path by the recorder when a recording starts.
+	/// </summary>
+	std::shared_ptr<CaptureTraceReplay> Replay;
+	/// <summary>
+	/// The clock of the recording the source is captured in. It is set by the recorder when a recording starts, so generated sources follow a virtual clock.
+	/// </summary>
+	std::shared_ptr<MediaClock> Clock;
 
 	RECORDING_SOURCE_BASE() :
 		Type(RecordingSourceType::Display),
@@ -272,6 +368,10 @@ public:
 		IsBorderRequired(std::nullopt),
 		IsVideoFramePreviewEnabled(std::nullopt),
 		VideoFramePreviewSize(std::nullopt),
+		TestPattern{},
+		ReplaySpeed(TraceReplaySpeed::RealTime),
+		Replay(nullptr),
+		Clock(nullptr),
 		m_NewFrameDataCallbacks{}
 	{
 
@@ -383,8 +483,10 @@ struct RECORDING_SOURCE_DATA {
 //
 struct THREAD_DATA_BASE
 {
-	////Handle to shared surface texture
-	HANDLE CanvasTexSharedHandle{ nullptr };
+	// The frames written by this thread. Replaced by the thread when the buffers are recreated, so access with std::atomic_load/std::atomic_store.
+	std::shared_ptr<TripleBufferedTexture> FrameBuffer{ nullptr };
+	// Used to notify the compositor that a new frame was published
+	HANDLE NewFrameEvent{};
 	// Used to signal an error in the ongoing capture
 	HANDLE ErrorEvent{};
 	// Used to signal capture has started
@@ -398,11 +500,33 @@ struct THREAD_DATA_BASE
 //
 // Structure to pass to a new thread
 //
+//
+// Metrics of a single recording source, looked up when its capture thread is started
+//
+struct SOURCE_METRICS {
+	// Time the capture thread takes to write a new frame of the source
+	LatencyHistogram *FrameWriteTime{ nullptr };
+	// Published, dropped and late frames of the source, updated by the compositor
+	MetricCounter *PublishedFrames{ nullptr };
+	MetricCounter *DroppedFrames{ nullptr };
+	MetricCounter *LateFrames{ nullptr };
+	// Frame buffer the counters were last updated from, and its totals at that time. The totals start over when the frame buffer is replaced.
+	TripleBufferedTexture *CountedFrameBuffer{ nullptr };
+	INT64 CountedPublishedFrames{ 0 };
+	INT64 CountedDroppedFrames{ 0 };
+	INT64 CountedLateFrames{ 0 };
+};
+
 struct CAPTURE_THREAD_DATA :THREAD_DATA_BASE
 {
 	RECORDING_SOURCE_DATA *RecordingSource{ nullptr };
 	INT64 TotalUpdatedFrameCount{};
 	PTR_INFO *PtrInfo{ nullptr };
+	// Guards PtrInfo, which is shared between all capture threads and the compositor
+	CRITICAL_SECTION *PtrInfoCriticalSection{ nullptr };
+	// Records pointer updates when the pointer is not drawn on the frames. Null if cursor metadata is not enabled.
+	std::shared_ptr<CursorMetadataWriter> CursorMetadata{ nullptr };
+	SOURCE_METRICS Metrics{};
 };
 
 //
@@ -410,9 +534,22 @@ struct CAPTURE_THREAD_DATA :THREAD_DATA_BASE
 //
 struct OVERLAY_THREAD_DATA :THREAD_DATA_BASE
 {
-	////Handle to shared overlay texture
-	HANDLE OverlayTexSharedHandle{ nullptr };
 	RECORDING_OVERLAY_DATA *RecordingOverlay{};
+	// True if the overlay source never changes its frame, so the compositor can cache it.
+	bool IsStaticContent{ false };
+};
+
+//
+// Frame delivery statistics for a single recording source or overlay
+//
+struct SOURCE_FRAME_STATISTICS {
+	std::wstring ID;
+	// Total number of frames published by the source
+	INT64 PublishedFrameCount{};
+	// Frames that were replaced by a newer frame before the compositor read them
+	INT64 DroppedFrameCount{};
+	// Frames that waited longer than one output frame before the compositor read them
+	INT64 LateFrameCount{};
 };
 
 struct CAPTURE_THREAD {
@@ -434,9 +571,11 @@ protected:
 	UINT32 m_MouseClickDetectionRadius = 20;
 	UINT32 m_MouseClickDetectionMode = MOUSE_DETECTION_MODE_POLLING;
 	UINT32 m_MouseClickDetectionDurationMillis = 50;
+	bool m_IsMousePointerMetadataEnabled = false;
 public:
 	static const UINT32 MOUSE_DETECTION_MODE_POLLING = 0;
 	static const UINT32 MOUSE_DETECTION_MODE_HOOK = 1;
+	static const UINT32 MOUSE_DETECTION_MODE_RAW_INPUT = 2;
 
 	void SetMousePointerEnabled(bool value) { m_IsMousePointerEnabled = value; }
 	void SetDetectMouseClicks(bool value) { m_IsMouseClicksDetected = value; }
@@ -445,6 +584,7 @@ public:
 	void SetMouseClickDetectionRadius(int value) { m_MouseClickDetectionRadius = value; }
 	void SetMouseClickDetectionMode(UINT32 value) { m_MouseClickDetectionMode = value; }
 	void SetMouseClickDetectionDuration(int value) { m_MouseClickDetectionDurationMillis = value; }
+	void SetMousePointerMetadataEnabled(bool value) { m_IsMousePointerMetadataEnabled = value; }
 
 	bool IsMouseClicksDetected() { return m_IsMouseClicksDetected; }
 	bool IsMousePointerEnabled() { return m_IsMousePointerEnabled; }
@@ -453,6 +593,10 @@ public:
 	UINT32 GetMouseClickDetectionRadius() { return  m_MouseClickDetectionRadius; }
 	UINT32 GetMouseClickDetectionMode() { return m_MouseClickDetectionMode; }
 	UINT32 GetMouseClickDetectionDurationMillis() { return m_MouseClickDetectionDurationMillis; }
+	/// <summary>
+	/// True if the pointer and clicks are recorded to a metadata file instead of being drawn on the frames.
+	/// </summary>
+	bool IsMousePointerMetadataEnabled() { return m_IsMousePointerMetadataEnabled; }
 };
 
 struct AUDIO_OPTIONS {
@@ -472,6 +616,7 @@ protected:
 	UINT32 m_AudioChannels = 2; //Number of audio channels. 1,2 and 6 is supported. 6 only on windows 8 and up.
 	float m_OutputVolumeModifier = 1;
 	float m_InputVolumeModifier = 1;
+	AudioTestSignal m_TestSignal = AudioTestSignal::None; //Generated audio that replaces the capture devices when set, for load tests.
 
 	void Notify(HANDLE h) {
 		SetEvent(h);
@@ -493,6 +638,7 @@ public:
 	void SetAudioEnabled(bool value) { m_IsAudioEnabled = value; Notify(OnPropertyChangedEvent); }
 	void SetOutputDeviceEnabled(bool value) { m_IsOutputDeviceEnabled = value; Notify(OnPropertyChangedEvent); }
 	void SetInputDeviceEnabled(bool value) { m_IsInputDeviceEnabled = value; Notify(OnPropertyChangedEvent); }
+	void SetTestSignal(AudioTestSignal signal) { m_TestSignal = signal; Notify(OnPropertyChangedEvent); }
 
 	std::wstring GetAudioOutputDevice() { return m_AudioOutputDevice; }
 	std::wstring GetAudioInputDevice() { return m_AudioInputDevice; }
@@ -503,6 +649,7 @@ public:
 	float GetInputVolume() { return m_InputVolumeModifier; }
 	bool IsOutputDeviceEnabled() { return m_IsOutputDeviceEnabled; }
 	bool IsInputDeviceEnabled() { return m_IsInputDeviceEnabled; }
+	AudioTestSignal GetTestSignal() { return m_TestSignal; }
 	GUID GetAudioEncoderFormat() { return AUDIO_ENCODING_FORMAT; }
 	UINT32 GetAudioBitsPerSample() { return AUDIO_BITS_PER_SAMPLE; }
 	UINT32 GetAudioSamplesPerSecond() { return AUDIO_SAMPLES_PER_SECOND; }
@@ -539,6 +686,7 @@ protected:
 #pragma region Format constants
 #pragma endregion
 	UINT32 m_VideoFps = 30;
+	UINT32 m_VideoFpsDenominator = 1;//The frame rate is m_VideoFps / m_VideoFpsDenominator, e.g. 30000/1001 for 29.97 fps.
 	UINT32 m_VideoBitrate = 4000 * 1000;//Bitrate in bits per second
 	UINT32 m_VideoQuality = 70;//Video quality from 1 to 100. Is only used with eAVEncCommonRateControlMode_Quality.
 	bool m_IsFixedFramerate = false;
@@ -551,6 +699,7 @@ protected:
 	UINT32 m_EncoderProfile = eAVEncH264VProfile_High;
 public:
 	void SetVideoFps(UINT32 fps) { m_VideoFps = fps; }
+	void SetVideoFpsDenominator(UINT32 denominator) { m_VideoFpsDenominator = max(denominator, 1u); }
 	void SetVideoBitrate(UINT32 bitrate) { m_VideoBitrate = bitrate; }
 	void SetVideoQuality(UINT32 quality) { m_VideoQuality = quality; }
 	void SetFixedFramerate(bool value) { m_IsFixedFramerate = value; }
@@ -563,6 +712,7 @@ public:
 	void SetEncoderProfile(UINT32 profile) { m_EncoderProfile = profile; }
 
 	UINT32 GetVideoFps() { return m_VideoFps; }
+	UINT32 GetVideoFpsDenominator() { return m_VideoFpsDenominator; }
 	UINT32 GetVideoBitrate() { return m_VideoBitrate; }
 	UINT32 GetVideoQuality() { return m_VideoQuality; }
 	bool GetIsFixedFramerate() { return  m_IsFixedFramerate; }
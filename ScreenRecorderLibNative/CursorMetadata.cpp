@@ -0,0 +1,675 @@
+#include "CursorMetadata.h"
+#include "CursorRasterizer.h"
+#include "Cleanup.h"
+#include "Log.h"
+#include "Util.h"
+#include <sstream>
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+//Opacity of drawn clicks, the same as when clicks are drawn on the frames.
+#define CURSOR_METADATA_CLICK_ALPHA 179
+
+static const char HexDigits[] = "0123456789abcdef";
+
+static int ParseHexDigit(_In_ char c)
+{
+	if (c >= '0' && c <= '9') {
+		return c - '0';
+	}
+	if (c >= 'a' && c <= 'f') {
+		return c - 'a' + 10;
+	}
+	if (c >= 'A' && c <= 'F') {
+		return c - 'A' + 10;
+	}
+	return -1;
+}
+
+//
+// Blends a pixel with straight alpha onto the frame, keeping the alpha of the frame.
+//
+static inline UINT BlendPixel(_In_ UINT background, _In_ UINT foreground)
+{
+	UINT alpha = foreground >> 24;
+	if (alpha == 0xFF) {
+		return foreground;
+	}
+	if (alpha == 0) {
+		return background;
+	}
+	UINT result = background & CURSOR_OPAQUE_BLACK;
+	for (UINT shift = 0; shift < 24; shift += 8) {
+		UINT fg = (foreground >> shift) & 0xFF;
+		UINT bg = (background >> shift) & 0xFF;
+		result |= (((fg * alpha + bg * (0xFF - alpha)) + 127) / 0xFF) << shift;
+	}
+	return result;
+}
+
+static bool IsSamePointer(_In_ const CURSOR_METADATA_POINTER &a, _In_ const CURSOR_METADATA_POINTER &b)
+{
+	if (!a.Visible && !b.Visible) {
+		//Nothing is drawn for a hidden pointer, so its position does not matter.
+		return true;
+	}
+	return a.Visible == b.Visible
+		&& a.Left == b.Left
+		&& a.Top == b.Top
+		&& a.ShapeHash == b.ShapeHash
+		&& a.ScaleX == b.ScaleX
+		&& a.ScaleY == b.ScaleY;
+}
+
+UINT64 GetCursorShapeHash(_In_ const DXGI_OUTDUPL_POINTER_SHAPE_INFO &shapeInfo, _In_reads_bytes_(shapeBufferSize) const BYTE *pShapeBuffer, _In_ UINT shapeBufferSize)
+{
+	//FNV-1a, mixing a 64 bit word at a time.
+	const UINT64 prime = 0x100000001b3;
+	UINT64 hash = 0xcbf29ce484222325;
+	auto Mix([&](UINT64 value) {
+		hash ^= value;
+		hash *= prime;
+	});
+	Mix(shapeInfo.Type);
+	Mix(shapeInfo.Width);
+	Mix(shapeInfo.Height);
+	Mix(shapeInfo.Pitch);
+	Mix((static_cast<UINT64>(shapeInfo.HotSpot.x) << 32) | static_cast<UINT32>(shapeInfo.HotSpot.y));
+	UINT i = 0;
+	for (; i + sizeof(UINT64) <= shapeBufferSize; i += sizeof(UINT64)) {
+		UINT64 word;
+		memcpy(&word, pShapeBuffer + i, sizeof(UINT64));
+		Mix(word);
+	}
+	for (; i < shapeBufferSize; i++) {
+		Mix(pShapeBuffer[i]);
+	}
+	//Zero is reserved for pointers without a shape.
+	return hash == 0 ? 1 : hash;
+}
+
+CursorMetadataWriter::CursorMetadataWriter(_In_ std::function<HRESULT(INT64 *)> getTimeStamp) :
+	m_GetTimeStamp(getTimeStamp),
+	m_Stream{},
+	m_WrittenShapes{},
+	m_LastPointer{},
+	m_HasLastPointer(false),
+	m_ShapeHash(0),
+	m_HasShapeHash(false),
+	m_PointerRecordCount(0),
+	m_SkippedPointerRecordCount(0),
+	m_DroppedRecordCount(0),
+	m_Queue{},
+	m_Batch{},
+	m_IsOpen(false),
+	m_IsClosing(false),
+	m_IsWriteFailed(false),
+	m_WriterThread{},
+	m_WakeEvent(nullptr)
+{
+	InitializeCriticalSection(&m_CriticalSection);
+	m_WakeEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+}
+
+CursorMetadataWriter::~CursorMetadataWriter()
+{
+	Close();
+	CloseHandle(m_WakeEvent);
+	DeleteCriticalSection(&m_CriticalSection);
+}
+
+std::wstring CursorMetadataWriter::GetMetadataPath(_In_ std::wstring videoPath)
+{
+	size_t extensionPos = videoPath.find_last_of(L'.');
+	size_t directoryPos = videoPath.find_last_of(L"\\/");
+	if (extensionPos == wstring::npos || (directoryPos != wstring::npos && extensionPos < directoryPos)) {
+		return videoPath + CURSOR_METADATA_FILE_EXTENSION;
+	}
+	return videoPath.substr(0, extensionPos) + CURSOR_METADATA_FILE_EXTENSION;
+}
+
+HRESULT CursorMetadataWriter::Open(_In_ std::wstring path)
+{
+	Close();
+	if (!m_WakeEvent) {
+		return E_OUTOFMEMORY;
+	}
+	EnterCriticalSection(&m_CriticalSection);
+	LeaveCriticalSectionOnExit leaveOnExit(&m_CriticalSection);
+	m_Stream.open(path, ios_base::out | ios_base::trunc | ios_base::binary);
+	if (!m_Stream.is_open()) {
+		LOG_ERROR(L"Failed to open cursor metadata file %ls", path.c_str());
+		return E_FAIL;
+	}
+	m_Stream.precision(9);
+	m_WrittenShapes.clear();
+	m_HasLastPointer = false;
+	m_HasShapeHash = false;
+	m_PointerRecordCount = 0;
+	m_SkippedPointerRecordCount = 0;
+	m_DroppedRecordCount = 0;
+	m_Queue.clear();
+	m_Queue.reserve(CURSOR_METADATA_QUEUE_CAPACITY);
+	m_Batch.clear();
+	m_Batch.reserve(CURSOR_METADATA_QUEUE_CAPACITY);
+	m_Stream << CURSOR_METADATA_HEADER << '\n';
+	if (!m_Stream.good()) {
+		m_Stream.close();
+		return E_FAIL;
+	}
+	m_IsOpen = true;
+	m_IsClosing = false;
+	m_IsWriteFailed = false;
+	m_WriterThread = std::thread(&CursorMetadataWriter::WriterThreadProc, this);
+	LOG_DEBUG(L"Writing cursor metadata to %ls", path.c_str());
+	return S_OK;
+}
+
+HRESULT CursorMetadataWriter::Close()
+{
+	{
+		EnterCriticalSection(&m_CriticalSection);
+		LeaveCriticalSectionOnExit leaveOnExit(&m_CriticalSection);
+		if (!m_IsOpen) {
+			return S_FALSE;
+		}
+		m_IsOpen = false;
+		m_IsClosing = true;
+	}
+	//The writer thread writes the records that are still queued before it exits
+	SetEvent(m_WakeEvent);
+	m_WriterThread.join();
+	m_Stream.flush();
+	bool isGood = m_Stream.good() && !m_IsWriteFailed;
+	m_Stream.close();
+	if (m_DroppedRecordCount > 0) {
+		LOG_WARN(L"%lld cursor metadata records were dropped because the queue was full", m_DroppedRecordCount);
+	}
+	LOG_DEBUG(L"Closed cursor metadata file: %lld pointer records, %lld unchanged pointer records skipped, %zu shapes", m_PointerRecordCount, m_SkippedPointerRecordCount, m_WrittenShapes.size());
+	return isGood ? S_OK : E_FAIL;
+}
+
+HRESULT CursorMetadataWriter::WriteLayout(_In_ CURSOR_METADATA_LAYOUT layout)
+{
+	EnterCriticalSection(&m_CriticalSection);
+	LeaveCriticalSectionOnExit leaveOnExit(&m_CriticalSection);
+	if (!m_IsOpen) {
+		return S_FALSE;
+	}
+	METADATA_RECORD record{};
+	record.Type = RecordType::Layout;
+	record.Layout = layout;
+	record.Layout.TimeStamp = GetTimeStamp();
+	TryQueue(std::move(record));
+	return m_IsWriteFailed ? E_FAIL : S_OK;
+}
+
+HRESULT CursorMetadataWriter::WritePointer(_In_ CURSOR_METADATA_POINTER pointer, _In_ const DXGI_OUTDUPL_POINTER_SHAPE_INFO &shapeInfo, _In_reads_bytes_opt_(shapeBufferSize) const BYTE *pShapeBuffer, _In_ UINT shapeBufferSize, _In_ bool isShapeUpdated)
+{
+	EnterCriticalSection(&m_CriticalSection);
+	LeaveCriticalSectionOnExit leaveOnExit(&m_CriticalSection);
+	if (!m_IsOpen) {
+		return S_FALSE;
+	}
+	//The shape buffer may be larger than the shape it holds.
+	UINT shapeSize = min(shapeBufferSize, shapeInfo.Pitch * shapeInfo.Height);
+	if (isShapeUpdated || !m_HasShapeHash) {
+		m_ShapeHash = pShapeBuffer && shapeSize > 0 ? GetCursorShapeHash(shapeInfo, pShapeBuffer, shapeSize) : 0;
+		m_HasShapeHash = true;
+	}
+	pointer.ShapeHash = pShapeBuffer && shapeSize > 0 ? m_ShapeHash : 0;
+	if (m_HasLastPointer && IsSamePointer(pointer, m_LastPointer)) {
+		m_SkippedPointerRecordCount++;
+		return S_FALSE;
+	}
+	if (pointer.ShapeHash != 0 && m_WrittenShapes.count(pointer.ShapeHash) == 0) {
+		//New shapes are rare, so only they copy the shape buffer
+		METADATA_RECORD shapeRecord{};
+		shapeRecord.Type = RecordType::Shape;
+		shapeRecord.Shape = std::make_shared<CURSOR_METADATA_SHAPE>();
+		shapeRecord.Shape->Hash = pointer.ShapeHash;
+		shapeRecord.Shape->ShapeInfo = shapeInfo;
+		shapeRecord.Shape->Buffer.assign(pShapeBuffer, pShapeBuffer + shapeSize);
+		if (!TryQueue(std::move(shapeRecord))) {
+			return S_FALSE;
+		}
+		m_WrittenShapes.insert(pointer.ShapeHash);
+	}
+	pointer.TimeStamp = GetTimeStamp();
+	METADATA_RECORD record{};
+	record.Type = RecordType::Pointer;
+	record.Pointer = pointer;
+	if (!TryQueue(std::move(record))) {
+		return S_FALSE;
+	}
+	m_LastPointer = pointer;
+	m_HasLastPointer = true;
+	m_PointerRecordCount++;
+	return m_IsWriteFailed ? E_FAIL : S_OK;
+}
+
+HRESULT CursorMetadataWriter::WriteClick(_In_ UINT button)
+{
+	EnterCriticalSection(&m_CriticalSection);
+	LeaveCriticalSectionOnExit leaveOnExit(&m_CriticalSection);
+	if (!m_IsOpen) {
+		return S_FALSE;
+	}
+	METADATA_RECORD record{};
+	record.Type = RecordType::Click;
+	record.Click.TimeStamp = GetTimeStamp();
+	record.Click.Button = button;
+	TryQueue(std::move(record));
+	return m_IsWriteFailed ? E_FAIL : S_OK;
+}
+
+INT64 CursorMetadataWriter::GetTimeStamp()
+{
+	INT64 timeStamp = 0;
+	if (m_GetTimeStamp) {
+		LOG_ON_BAD_HR(m_GetTimeStamp(&timeStamp));
+	}
+	return timeStamp;
+}
+
+/// <summary>
+/// Adds a record to the queue. Must be called with m_CriticalSection held.
+/// </summary>
+/// <returns>False if the queue is full and the record was dropped.</returns>
+bool CursorMetadataWriter::TryQueue(_In_ METADATA_RECORD &&record)
+{
+	if (m_Queue.size() >= CURSOR_METADATA_QUEUE_CAPACITY) {
+		m_DroppedRecordCount++;
+		return false;
+	}
+	m_Queue.push_back(std::move(record));
+	if (m_Queue.size() == CURSOR_METADATA_QUEUE_CAPACITY / 2) {
+		SetEvent(m_WakeEvent);
+	}
+	return true;
+}
+
+void CursorMetadataWriter::WriterThreadProc()
+{
+	bool isClosing = false;
+	while (!isClosing) {
+		WaitForSingleObject(m_WakeEvent, CURSOR_METADATA_WRITER_INTERVAL_MILLIS);
+		{
+			EnterCriticalSection(&m_CriticalSection);
+			LeaveCriticalSectionOnExit leaveOnExit(&m_CriticalSection);
+			isClosing = m_IsClosing;
+			//Swapping keeps the capacity of both vectors, so queueing does not allocate
+			m_Batch.clear();
+			std::swap(m_Batch, m_Queue);
+		}
+		WriteRecords(m_Batch);
+	}
+}
+
+void CursorMetadataWriter::WriteRecords(_In_ const std::vector<METADATA_RECORD> &records)
+{
+	for each (const METADATA_RECORD & record in records)
+	{
+		switch (record.Type)
+		{
+			case RecordType::Layout:
+			{
+				const CURSOR_METADATA_LAYOUT &layout = record.Layout;
+				m_Stream << "layout " << layout.TimeStamp
+					<< ' ' << layout.OutputWidth << ' ' << layout.OutputHeight
+					<< ' ' << layout.ScaleX << ' ' << layout.ScaleY
+					<< ' ' << layout.OffsetX << ' ' << layout.OffsetY << '\n';
+				break;
+			}
+			case RecordType::Shape:
+			{
+				const CURSOR_METADATA_SHAPE &shape = *record.Shape;
+				const DXGI_OUTDUPL_POINTER_SHAPE_INFO &shapeInfo = shape.ShapeInfo;
+				m_Stream << "shape " << std::hex << shape.Hash << std::dec
+					<< ' ' << shapeInfo.Type << ' ' << shapeInfo.Width << ' ' << shapeInfo.Height << ' ' << shapeInfo.Pitch
+					<< ' ' << shapeInfo.HotSpot.x << ' ' << shapeInfo.HotSpot.y << ' ';
+				std::string hex(shape.Buffer.size() * 2, '0');
+				for (size_t i = 0; i < shape.Buffer.size(); i++) {
+					hex[i * 2] = HexDigits[shape.Buffer[i] >> 4];
+					hex[i * 2 + 1] = HexDigits[shape.Buffer[i] & 0x0F];
+				}
+				m_Stream << hex << '\n';
+				break;
+			}
+			case RecordType::Pointer:
+			{
+				const CURSOR_METADATA_POINTER &pointer = record.Pointer;
+				m_Stream << "pointer " << pointer.TimeStamp
+					<< ' ' << pointer.Left << ' ' << pointer.Top
+					<< ' ' << (pointer.Visible ? 1 : 0)
+					<< ' ' << std::hex << pointer.ShapeHash << std::dec
+					<< ' ' << pointer.ScaleX << ' ' << pointer.ScaleY << '\n';
+				break;
+			}
+			case RecordType::Click:
+				m_Stream << "click " << record.Click.TimeStamp << ' ' << record.Click.Button << '\n';
+				break;
+		}
+	}
+	if (!m_Stream.good()) {
+		EnterCriticalSection(&m_CriticalSection);
+		LeaveCriticalSectionOnExit leaveOnExit(&m_CriticalSection);
+		if (!m_IsWriteFailed) {
+			LOG_ERROR(L"Failed to write cursor metadata");
+		}
+		m_IsWriteFailed = true;
+	}
+}
+
+CursorCompositor::CursorCompositor() :
+	m_Layouts{},
+	m_Pointers{},
+	m_Clicks{},
+	m_Shapes{},
+	m_ClickDuration(50 * 10000),
+	m_LeftButtonColor(0xFFFF00),
+	m_RightButtonColor(0xFFFF00),
+	m_ClickRadius(20)
+{
+}
+
+HRESULT CursorCompositor::Load(_In_ std::wstring path)
+{
+	std::ifstream stream(path, ios_base::in | ios_base::binary);
+	if (!stream.is_open()) {
+		LOG_ERROR(L"Failed to open cursor metadata file %ls", path.c_str());
+		return E_FAIL;
+	}
+	return Load(stream);
+}
+
+HRESULT CursorCompositor::Load(_In_ std::istream &stream)
+{
+	m_Layouts.clear();
+	m_Pointers.clear();
+	m_Clicks.clear();
+	m_Shapes.clear();
+	std::string line;
+	if (!std::getline(stream, line)) {
+		LOG_ERROR(L"Cursor metadata is empty");
+		return E_FAIL;
+	}
+	if (!line.empty() && line.back() == '\r') {
+		line.pop_back();
+	}
+	if (line != CURSOR_METADATA_HEADER) {
+		LOG_ERROR(L"Cursor metadata has an unsupported header: %hs", line.c_str());
+		return E_FAIL;
+	}
+	int lineNumber = 1;
+	while (std::getline(stream, line)) {
+		lineNumber++;
+		std::istringstream record(line);
+		std::string type;
+		if (!(record >> type)) {
+			continue;
+		}
+		if (type == "layout") {
+			CURSOR_METADATA_LAYOUT layout{};
+			if (record >> layout.TimeStamp >> layout.OutputWidth >> layout.OutputHeight >> layout.ScaleX >> layout.ScaleY >> layout.OffsetX >> layout.OffsetY) {
+				m_Layouts.push_back(layout);
+				continue;
+			}
+		}
+		else if (type == "shape") {
+			CURSOR_METADATA_SHAPE shape{};
+			std::string hex;
+			if (record >> std::hex >> shape.Hash >> std::dec
+				>> shape.ShapeInfo.Type >> shape.ShapeInfo.Width >> shape.ShapeInfo.Height >> shape.ShapeInfo.Pitch
+				>> shape.ShapeInfo.HotSpot.x >> shape.ShapeInfo.HotSpot.y >> hex
+				&& hex.size() % 2 == 0
+				&& hex.size() / 2 >= static_cast<size_t>(shape.ShapeInfo.Pitch) * shape.ShapeInfo.Height) {
+				shape.Buffer.resize(hex.size() / 2);
+				bool isValid = true;
+				for (size_t i = 0; i < shape.Buffer.size() && isValid; i++) {
+					int high = ParseHexDigit(hex[i * 2]);
+					int low = ParseHexDigit(hex[i * 2 + 1]);
+					isValid = high >= 0 && low >= 0;
+					shape.Buffer[i] = static_cast<BYTE>((high << 4) | low);
+				}
+				if (isValid) {
+					m_Shapes[shape.Hash] = std::move(shape);
+					continue;
+				}
+			}
+		}
+		else if (type == "pointer") {
+			CURSOR_METADATA_POINTER pointer{};
+			int visible;
+			if (record >> pointer.TimeStamp >> pointer.Left >> pointer.Top >> visible >> std::hex >> pointer.ShapeHash >> std::dec >> pointer.ScaleX >> pointer.ScaleY) {
+				pointer.Visible = visible != 0;
+				m_Pointers.push_back(pointer);
+				continue;
+			}
+		}
+		else if (type == "click") {
+			CURSOR_METADATA_CLICK click{};
+			if (record >> click.TimeStamp >> click.Button) {
+				m_Clicks.push_back(click);
+				continue;
+			}
+		}
+		else {
+			//Unknown records are skipped, so files written by newer versions can still be read.
+			continue;
+		}
+		LOG_WARN(L"Skipping malformed cursor metadata record on line %d", lineNumber);
+	}
+	//Records are written from several threads, so keep them ordered by time for lookups.
+	auto ByTime([](const auto &a, const auto &b) { return a.TimeStamp < b.TimeStamp; });
+	std::stable_sort(m_Layouts.begin(), m_Layouts.end(), ByTime);
+	std::stable_sort(m_Pointers.begin(), m_Pointers.end(), ByTime);
+	std::stable_sort(m_Clicks.begin(), m_Clicks.end(), ByTime);
+	return S_OK;
+}
+
+void CursorCompositor::SetClickStyle(_In_ INT64 duration100Nanos, _In_ UINT leftButtonColor, _In_ UINT rightButtonColor, _In_ float radius)
+{
+	m_ClickDuration = duration100Nanos;
+	m_LeftButtonColor = leftButtonColor;
+	m_RightButtonColor = rightButtonColor;
+	m_ClickRadius = radius;
+}
+
+bool CursorCompositor::GetPointerAt(_In_ INT64 timeStamp, _Out_ CURSOR_METADATA_POINTER *pPointer)
+{
+	*pPointer = {};
+	auto next = std::upper_bound(m_Pointers.begin(), m_Pointers.end(), timeStamp, [](INT64 time, const CURSOR_METADATA_POINTER &pointer) { return time < pointer.TimeStamp; });
+	if (next == m_Pointers.begin()) {
+		return false;
+	}
+	*pPointer = *(next - 1);
+	return true;
+}
+
+CURSOR_METADATA_LAYOUT CursorCompositor::GetLayoutAt(_In_ INT64 timeStamp)
+{
+	if (m_Layouts.empty()) {
+		return CURSOR_METADATA_LAYOUT{};
+	}
+	auto next = std::upper_bound(m_Layouts.begin(), m_Layouts.end(), timeStamp, [](INT64 time, const CURSOR_METADATA_LAYOUT &layout) { return time < layout.TimeStamp; });
+	//Pointer records may be written before the first layout, which then applies to them.
+	return next == m_Layouts.begin() ? *next : *(next - 1);
+}
+
+HRESULT CursorCompositor::ComposeFrame(_In_ INT64 timeStamp, _Inout_updates_(pitchInPixels *height) UINT *pFrame, _In_ UINT width, _In_ UINT height, _In_ UINT pitchInPixels)
+{
+	CURSOR_METADATA_POINTER pointer;
+	if (!GetPointerAt(timeStamp, &pointer)) {
+		return S_FALSE;
+	}
+	CURSOR_METADATA_LAYOUT layout = GetLayoutAt(timeStamp);
+	HRESULT hr = S_FALSE;
+	//Clicks are drawn below the pointer.
+	for each (const CURSOR_METADATA_CLICK & click in m_Clicks)
+	{
+		if (click.TimeStamp > timeStamp) {
+			break;
+		}
+		if (timeStamp < click.TimeStamp + m_ClickDuration) {
+			DrawClick(click, pointer, layout, pFrame, width, height, pitchInPixels);
+			hr = S_OK;
+		}
+	}
+	if (pointer.Visible) {
+		if (DrawPointer(pointer, layout, pFrame, width, height, pitchInPixels) == S_OK) {
+			hr = S_OK;
+		}
+	}
+	return hr;
+}
+
+HRESULT CursorCompositor::DrawPointer(_In_ const CURSOR_METADATA_POINTER &pointer, _In_ const CURSOR_METADATA_LAYOUT &layout, _Inout_ UINT *pFrame, _In_ UINT width, _In_ UINT height, _In_ UINT pitchInPixels)
+{
+	auto shapeEntry = m_Shapes.find(pointer.ShapeHash);
+	if (shapeEntry == m_Shapes.end()) {
+		return S_FALSE;
+	}
+	const CURSOR_METADATA_SHAPE &shape = shapeEntry->second;
+	const DXGI_OUTDUPL_POINTER_SHAPE_INFO &info = shape.ShapeInfo;
+	bool isMonochrome = info.Type == DXGI_OUTDUPL_POINTER_SHAPE_TYPE_MONOCHROME;
+	LONG shapeWidth = static_cast<LONG>(info.Width);
+	LONG shapeHeight = static_cast<LONG>(isMonochrome ? info.Height / 2 : info.Height);
+
+	//Position and size of the pointer in the video frame
+	LONG destLeft = static_cast<LONG>(round(pointer.Left * layout.ScaleX + layout.OffsetX));
+	LONG destTop = static_cast<LONG>(round(pointer.Top * layout.ScaleY + layout.OffsetY));
+	LONG destWidth = static_cast<LONG>(round(shapeWidth * pointer.ScaleX * layout.ScaleX));
+	LONG destHeight = static_cast<LONG>(round(shapeHeight * pointer.ScaleY * layout.ScaleY));
+	if (destWidth <= 0 || destHeight <= 0 || shapeWidth <= 0 || shapeHeight <= 0) {
+		return S_FALSE;
+	}
+	LONG clipLeft = max(0L, destLeft);
+	LONG clipTop = max(0L, destTop);
+	LONG clipRight = min(static_cast<LONG>(width), destLeft + destWidth);
+	LONG clipBottom = min(static_cast<LONG>(height), destTop + destHeight);
+	if (clipRight <= clipLeft || clipBottom <= clipTop) {
+		return S_FALSE;
+	}
+	INT visibleWidth = clipRight - clipLeft;
+	INT visibleHeight = clipBottom - clipTop;
+	UINT skipX = clipLeft - destLeft;
+	UINT skipY = clipTop - destTop;
+	UINT *pDestination = pFrame + static_cast<size_t>(clipTop) * pitchInPixels + clipLeft;
+
+	//Nearest neighbour source column and row for each destination column and row
+	std::vector<LONG> sourceColumns(destWidth);
+	std::vector<LONG> sourceRows(destHeight);
+	for (LONG col = 0; col < destWidth; col++) {
+		sourceColumns[col] = col * shapeWidth / destWidth;
+	}
+	for (LONG row = 0; row < destHeight; row++) {
+		sourceRows[row] = row * shapeHeight / destHeight;
+	}
+
+	std::vector<UINT> pixels(static_cast<size_t>(visibleWidth) * visibleHeight);
+	if (info.Type == DXGI_OUTDUPL_POINTER_SHAPE_TYPE_COLOR) {
+		for (INT row = 0; row < visibleHeight; row++) {
+			const UINT *pShapeRow = reinterpret_cast<const UINT *>(shape.Buffer.data() + sourceRows[row + skipY] * info.Pitch);
+			for (INT col = 0; col < visibleWidth; col++) {
+				pixels[row * visibleWidth + col] = pShapeRow[sourceColumns[col + skipX]];
+			}
+		}
+	}
+	else {
+		//Scale the shape to its size in the video frame, keeping its format, and let the rasterizer apply it to the frame below.
+		CURSOR_RASTER_DESC desc{};
+		std::vector<BYTE> scaledShape;
+		if (isMonochrome) {
+			UINT scaledPitch = (destWidth + 7) / 8;
+			scaledShape.resize(static_cast<size_t>(scaledPitch) * destHeight * 2);
+			for (LONG row = 0; row < destHeight; row++) {
+				const BYTE *pAndRow = shape.Buffer.data() + sourceRows[row] * info.Pitch;
+				const BYTE *pXorRow = shape.Buffer.data() + (sourceRows[row] + shapeHeight) * info.Pitch;
+				BYTE *pScaledAndRow = scaledShape.data() + row * scaledPitch;
+				BYTE *pScaledXorRow = scaledShape.data() + (row + destHeight) * scaledPitch;
+				for (LONG col = 0; col < destWidth; col++) {
+					LONG sourceCol = sourceColumns[col];
+					BYTE sourceMask = 0x80 >> (sourceCol % 8);
+					BYTE destMask = 0x80 >> (col % 8);
+					if (pAndRow[sourceCol / 8] & sourceMask) {
+						pScaledAndRow[col / 8] |= destMask;
+					}
+					if (pXorRow[sourceCol / 8] & sourceMask) {
+						pScaledXorRow[col / 8] |= destMask;
+					}
+				}
+			}
+			desc.ShapePitch = scaledPitch;
+			desc.MaskHeight = destHeight;
+		}
+		else {
+			scaledShape.resize(static_cast<size_t>(destWidth) * destHeight * sizeof(UINT));
+			UINT *pScaled = reinterpret_cast<UINT *>(scaledShape.data());
+			for (LONG row = 0; row < destHeight; row++) {
+				const UINT *pShapeRow = reinterpret_cast<const UINT *>(shape.Buffer.data() + sourceRows[row] * info.Pitch);
+				for (LONG col = 0; col < destWidth; col++) {
+					pScaled[row * destWidth + col] = pShapeRow[sourceColumns[col]];
+				}
+			}
+			desc.ShapePitch = destWidth * sizeof(UINT);
+		}
+		desc.pShape = scaledShape.data();
+		desc.SkipX = skipX;
+		desc.SkipY = skipY;
+		desc.pBackground = pDestination;
+		desc.BackgroundPitchInPixels = pitchInPixels;
+		desc.Width = visibleWidth;
+		desc.Height = visibleHeight;
+		if (isMonochrome) {
+			RasterizeMonochromeCursor(desc, pixels.data());
+		}
+		else {
+			RasterizeMaskedColorCursor(desc, pixels.data());
+		}
+	}
+	for (INT row = 0; row < visibleHeight; row++) {
+		UINT *pDestinationRow = pDestination + static_cast<size_t>(row) * pitchInPixels;
+		for (INT col = 0; col < visibleWidth; col++) {
+			pDestinationRow[col] = BlendPixel(pDestinationRow[col], pixels[row * visibleWidth + col]);
+		}
+	}
+	return S_OK;
+}
+
+void CursorCompositor::DrawClick(_In_ const CURSOR_METADATA_CLICK &click, _In_ const CURSOR_METADATA_POINTER &pointer, _In_ const CURSOR_METADATA_LAYOUT &layout, _Inout_ UINT *pFrame, _In_ UINT width, _In_ UINT height, _In_ UINT pitchInPixels)
+{
+	//Clicks are centered on the hotspot of the pointer.
+	double centerX = pointer.Left;
+	double centerY = pointer.Top;
+	auto shapeEntry = m_Shapes.find(pointer.ShapeHash);
+	if (shapeEntry != m_Shapes.end()) {
+		centerX += round(shapeEntry->second.ShapeInfo.HotSpot.x * pointer.ScaleX);
+		centerY += round(shapeEntry->second.ShapeInfo.HotSpot.y * pointer.ScaleY);
+	}
+	centerX = centerX * layout.ScaleX + layout.OffsetX;
+	centerY = centerY * layout.ScaleY + layout.OffsetY;
+	double radiusX = m_ClickRadius * pointer.ScaleX * layout.ScaleX;
+	double radiusY = m_ClickRadius * pointer.ScaleY * layout.ScaleY;
+	if (radiusX <= 0 || radiusY <= 0) {
+		return;
+	}
+	UINT color = (click.Button == VK_RBUTTON ? m_RightButtonColor : m_LeftButtonColor) & 0x00FFFFFF;
+	UINT pixel = color | (CURSOR_METADATA_CLICK_ALPHA << 24);
+	LONG top = max(0L, static_cast<LONG>(floor(centerY - radiusY)));
+	LONG bottom = min(static_cast<LONG>(height), static_cast<LONG>(ceil(centerY + radiusY)));
+	LONG left = max(0L, static_cast<LONG>(floor(centerX - radiusX)));
+	LONG right = min(static_cast<LONG>(width), static_cast<LONG>(ceil(centerX + radiusX)));
+	for (LONG y = top; y < bottom; y++) {
+		double dy = (y + 0.5 - centerY) / radiusY;
+		UINT *pRow = pFrame + static_cast<size_t>(y) * pitchInPixels;
+		for (LONG x = left; x < right; x++) {
+			double dx = (x + 0.5 - centerX) / radiusX;
+			if (dx * dx + dy * dy <= 1.0) {
+				pRow[x] = BlendPixel(pRow[x], pixel);
+			}
+		}
+	}
+}
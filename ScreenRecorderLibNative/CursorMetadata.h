@@ -0,0 +1,196 @@
+#pragma once
+#include <Windows.h>
+#include <dxgi1_2.h>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+#include <functional>
+#include <fstream>
+#include <istream>
+#include <memory>
+#include <thread>
+
+//
+// Records the mouse pointer as a timed metadata side-track next to the video, instead of drawing it on the frames.
+// When the pointer is not part of the frame, pointer-only movement leaves the frame unchanged and does not need to be encoded again.
+// The side-track is a line based text file with the extension .cursor:
+//
+//   ScreenRecorderLib cursor metadata 1
+//   layout <time> <output width> <output height> <scale x> <scale y> <offset x> <offset y>
+//   shape <hash> <type> <width> <height> <pitch> <hotspot x> <hotspot y> <shape buffer as hex>
+//   pointer <time> <left> <top> <visible> <shape hash> <scale x> <scale y>
+//   click <time> <virtual key code of button>
+//
+// Times are in 100 nanosecond units on the media timeline of the video. Pointer positions are the top left corner of the shape on the canvas,
+// and the layout maps canvas coordinates to video frame coordinates. Each distinct shape is written once, and pointer records refer to it by hash.
+// CursorCompositor reads the file back and draws the pointer onto decoded frames.
+//
+
+#define CURSOR_METADATA_HEADER "ScreenRecorderLib cursor metadata 1"
+#define CURSOR_METADATA_FILE_EXTENSION L".cursor"
+//Number of records that can be queued before the writer thread catches up. Records written to a full queue are dropped.
+#define CURSOR_METADATA_QUEUE_CAPACITY 4096
+//Maximum time records stay queued before the writer thread writes them to the file.
+#define CURSOR_METADATA_WRITER_INTERVAL_MILLIS 100
+
+struct CURSOR_METADATA_LAYOUT {
+	INT64 TimeStamp{};
+	// Size of the video frame
+	LONG OutputWidth{};
+	LONG OutputHeight{};
+	// Maps canvas coordinates to video frame coordinates, as output = canvas * scale + offset.
+	double ScaleX{ 1.0 };
+	double ScaleY{ 1.0 };
+	double OffsetX{};
+	double OffsetY{};
+};
+
+struct CURSOR_METADATA_SHAPE {
+	UINT64 Hash{};
+	DXGI_OUTDUPL_POINTER_SHAPE_INFO ShapeInfo{};
+	std::vector<BYTE> Buffer;
+};
+
+struct CURSOR_METADATA_POINTER {
+	INT64 TimeStamp{};
+	// Top left corner of the pointer shape in canvas coordinates
+	LONG Left{};
+	LONG Top{};
+	bool Visible{};
+	UINT64 ShapeHash{};
+	// Scale of the pointer shape on the canvas
+	float ScaleX{ 1.0f };
+	float ScaleY{ 1.0f };
+};
+
+struct CURSOR_METADATA_CLICK {
+	INT64 TimeStamp{};
+	// VK_LBUTTON or VK_RBUTTON
+	UINT Button{};
+};
+
+/// <summary>
+/// Returns a hash of a pointer shape and its shape buffer, used to write each distinct shape only once.
+/// </summary>
+UINT64 GetCursorShapeHash(_In_ const DXGI_OUTDUPL_POINTER_SHAPE_INFO &shapeInfo, _In_reads_bytes_(shapeBufferSize) const BYTE *pShapeBuffer, _In_ UINT shapeBufferSize);
+
+//
+// Writes cursor metadata from the capture, mouse click detection and recording threads. The records are queued and written to the file
+// by a writer thread, so the calling threads never wait for file I/O. A shape is only hashed when the caller reports it as updated.
+//
+class CursorMetadataWriter
+{
+public:
+	/// <param name="getTimeStamp">Returns the current position on the media timeline, in 100 nanosecond units.</param>
+	CursorMetadataWriter(_In_ std::function<HRESULT(INT64 *)> getTimeStamp);
+	~CursorMetadataWriter();
+	/// <summary>
+	/// Returns the path of the cursor metadata file for a video file.
+	/// </summary>
+	static std::wstring GetMetadataPath(_In_ std::wstring videoPath);
+	HRESULT Open(_In_ std::wstring path);
+	HRESULT Close();
+	/// <summary>
+	/// Writes the mapping from canvas to video frame coordinates. Must be written again when the canvas or output size changes.
+	/// </summary>
+	HRESULT WriteLayout(_In_ CURSOR_METADATA_LAYOUT layout);
+	/// <summary>
+	/// Writes the pointer state, unless it is identical to the previous state. The shape is written the first time it is seen.
+	/// The hash of the shape is computed when isShapeUpdated is true, and the hash of the previous shape is used otherwise.
+	/// The time stamp and shape hash of the pointer are set by the writer.
+	/// </summary>
+	/// <returns>S_OK if the state was queued, S_FALSE if it was unchanged or the writer is closed.</returns>
+	HRESULT WritePointer(_In_ CURSOR_METADATA_POINTER pointer, _In_ const DXGI_OUTDUPL_POINTER_SHAPE_INFO &shapeInfo, _In_reads_bytes_opt_(shapeBufferSize) const BYTE *pShapeBuffer, _In_ UINT shapeBufferSize, _In_ bool isShapeUpdated);
+	HRESULT WriteClick(_In_ UINT button);
+
+	inline INT64 GetPointerRecordCount() { return m_PointerRecordCount; }
+	inline INT64 GetSkippedPointerRecordCount() { return m_SkippedPointerRecordCount; }
+	inline size_t GetShapeCount() { return m_WrittenShapes.size(); }
+	/// <summary>Number of records dropped because the queue was full.</summary>
+	inline INT64 GetDroppedRecordCount() { return m_DroppedRecordCount; }
+private:
+	enum class RecordType {
+		Layout,
+		Shape,
+		Pointer,
+		Click
+	};
+	struct METADATA_RECORD {
+		RecordType Type;
+		CURSOR_METADATA_LAYOUT Layout;
+		CURSOR_METADATA_POINTER Pointer;
+		CURSOR_METADATA_CLICK Click;
+		std::shared_ptr<CURSOR_METADATA_SHAPE> Shape;
+	};
+	std::function<HRESULT(INT64 *)> m_GetTimeStamp;
+	std::ofstream m_Stream;
+	std::unordered_set<UINT64> m_WrittenShapes;
+	CURSOR_METADATA_POINTER m_LastPointer;
+	bool m_HasLastPointer;
+	// Hash of the shape of the last pointer state, reused until the shape is updated
+	UINT64 m_ShapeHash;
+	bool m_HasShapeHash;
+	INT64 m_PointerRecordCount;
+	INT64 m_SkippedPointerRecordCount;
+	INT64 m_DroppedRecordCount;
+	// Records waiting for the writer thread, and the batch the writer thread is writing
+	std::vector<METADATA_RECORD> m_Queue;
+	std::vector<METADATA_RECORD> m_Batch;
+	bool m_IsOpen;
+	bool m_IsClosing;
+	bool m_IsWriteFailed;
+	std::thread m_WriterThread;
+	HANDLE m_WakeEvent;
+	// Guards the queue and the state used to build records. The file is only written by the writer thread.
+	CRITICAL_SECTION m_CriticalSection;
+
+	INT64 GetTimeStamp();
+	bool TryQueue(_In_ METADATA_RECORD &&record);
+	void WriterThreadProc();
+	void WriteRecords(_In_ const std::vector<METADATA_RECORD> &records);
+};
+
+//
+// Reference compositor for cursor metadata files. Draws the pointer and clicks recorded at a given time onto a 32bpp BGRA video frame,
+// the same way they would have been drawn if the pointer was part of the recording.
+//
+class CursorCompositor
+{
+public:
+	CursorCompositor();
+	HRESULT Load(_In_ std::wstring path);
+	HRESULT Load(_In_ std::istream &stream);
+	/// <summary>
+	/// Sets how clicks are drawn. Colors are 0xRRGGBB, and the radius is in canvas pixels.
+	/// </summary>
+	void SetClickStyle(_In_ INT64 duration100Nanos, _In_ UINT leftButtonColor, _In_ UINT rightButtonColor, _In_ float radius);
+	/// <summary>
+	/// Gets the pointer state at the given time.
+	/// </summary>
+	/// <returns>False if no pointer state was recorded at or before the time.</returns>
+	bool GetPointerAt(_In_ INT64 timeStamp, _Out_ CURSOR_METADATA_POINTER *pPointer);
+	/// <summary>
+	/// Draws the pointer and any active click at the given time onto a video frame.
+	/// </summary>
+	/// <returns>S_OK if anything was drawn, S_FALSE if not.</returns>
+	HRESULT ComposeFrame(_In_ INT64 timeStamp, _Inout_updates_(pitchInPixels *height) UINT *pFrame, _In_ UINT width, _In_ UINT height, _In_ UINT pitchInPixels);
+
+	inline const std::vector<CURSOR_METADATA_LAYOUT> &GetLayouts() { return m_Layouts; }
+	inline const std::vector<CURSOR_METADATA_POINTER> &GetPointers() { return m_Pointers; }
+	inline const std::vector<CURSOR_METADATA_CLICK> &GetClicks() { return m_Clicks; }
+	inline const std::unordered_map<UINT64, CURSOR_METADATA_SHAPE> &GetShapes() { return m_Shapes; }
+private:
+	std::vector<CURSOR_METADATA_LAYOUT> m_Layouts;
+	std::vector<CURSOR_METADATA_POINTER> m_Pointers;
+	std::vector<CURSOR_METADATA_CLICK> m_Clicks;
+	std::unordered_map<UINT64, CURSOR_METADATA_SHAPE> m_Shapes;
+	INT64 m_ClickDuration;
+	UINT m_LeftButtonColor;
+	UINT m_RightButtonColor;
+	float m_ClickRadius;
+
+	CURSOR_METADATA_LAYOUT GetLayoutAt(_In_ INT64 timeStamp);
+	HRESULT DrawPointer(_In_ const CURSOR_METADATA_POINTER &pointer, _In_ const CURSOR_METADATA_LAYOUT &layout, _Inout_ UINT *pFrame, _In_ UINT width, _In_ UINT height, _In_ UINT pitchInPixels);
+	void DrawClick(_In_ const CURSOR_METADATA_CLICK &click, _In_ const CURSOR_METADATA_POINTER &pointer, _In_ const CURSOR_METADATA_LAYOUT &layout, _Inout_ UINT *pFrame, _In_ UINT width, _In_ UINT height, _In_ UINT pitchInPixels);
+};
@@ -0,0 +1,217 @@
+#include "CursorRasterizer.h"
+#include "SimdPixels.h"
+
+//
+// Scalar row kernels, used for whole rows when no vector instructions are available and for the pixels left over at the end of each row otherwise.
+//
+static void RasterizeMonochromeSpan(_In_ const CURSOR_RASTER_DESC &desc, _In_ const BYTE *pAndRow, _In_ const BYTE *pXorRow, _In_ const UINT *pBackgroundRow, _Inout_ UINT *pOutputRow, _In_ INT startCol)
+{
+	for (INT Col = startCol; Col < desc.Width; ++Col)
+	{
+		// Get masks using appropriate offsets
+		UINT Bit = Col + desc.SkipX;
+		BYTE Mask = 0x80 >> (Bit % 8);
+		BYTE AndMask = pAndRow[Bit / 8] & Mask;
+		BYTE XorMask = pXorRow[Bit / 8] & Mask;
+		UINT AndMask32 = (AndMask) ? CURSOR_OPAQUE_WHITE : CURSOR_OPAQUE_BLACK;
+		UINT XorMask32 = (XorMask) ? CURSOR_TRANSPARENT_WHITE : CURSOR_TRANSPARENT_BLACK;
+
+		if (AndMask && !XorMask) {
+			pOutputRow[Col] = CURSOR_TRANSPARENT_WHITE;
+		}
+		else {
+			// Set new pixel with background from desktop
+			pOutputRow[Col] = (pBackgroundRow[Col] & AndMask32) ^ XorMask32;
+		}
+	}
+}
+
+static void RasterizeMaskedColorSpan(_In_ const CURSOR_RASTER_DESC &desc, _In_ const UINT *pShapeRow, _In_ const UINT *pBackgroundRow, _Inout_ UINT *pOutputRow, _In_ INT startCol)
+{
+	for (INT Col = startCol; Col < desc.Width; ++Col)
+	{
+		UINT RgbValue = pShapeRow[Col];
+		// Set up mask
+		UINT MaskVal = CURSOR_OPAQUE_BLACK & RgbValue;
+		if (MaskVal)
+		{
+			// Mask was 0xFF
+			if (RgbValue == MaskVal) {
+				pOutputRow[Col] = CURSOR_TRANSPARENT_WHITE;
+			}
+			else {
+				pOutputRow[Col] = (pBackgroundRow[Col] ^ RgbValue) | CURSOR_OPAQUE_BLACK;
+			}
+		}
+		else
+		{
+			// Mask was 0x00
+			pOutputRow[Col] = RgbValue | CURSOR_OPAQUE_BLACK;
+		}
+	}
+}
+
+#ifdef PIXELS_SIMD
+//
+// Vector row kernels. These produce the same pixels as the scalar kernels, 8 monochrome or 4 masked color pixels at a time,
+// and return the first column they did not process.
+//
+static inline PIXELS ExpandMaskBits(_In_ UINT bits, _In_ PIXELS laneBits)
+{
+	//All ones in each lane whose bit is set, zero otherwise.
+	return EqualPixels(AndPixels(SplatPixels(bits), laneBits), laneBits);
+}
+
+static inline PIXELS RasterizeMonochromePixels(_In_ PIXELS andMask, _In_ PIXELS xorMask, _In_ PIXELS background)
+{
+	const PIXELS opaqueBlack = SplatPixels(CURSOR_OPAQUE_BLACK);
+	const PIXELS transparentWhite = SplatPixels(CURSOR_TRANSPARENT_WHITE);
+	PIXELS result = XorPixels(AndPixels(background, OrPixels(andMask, opaqueBlack)), AndPixels(xorMask, transparentWhite));
+	return SelectPixels(AndNotPixels(andMask, xorMask), transparentWhite, result);
+}
+
+static INT RasterizeMonochromeSpanVectorized(_In_ const CURSOR_RASTER_DESC &desc, _In_ const BYTE *pAndRow, _In_ const BYTE *pXorRow, _In_ const UINT *pBackgroundRow, _Inout_ UINT *pOutputRow)
+{
+	//The first pixel of a group is the most significant of the 8 mask bits.
+	const PIXELS highLaneBits = SetPixels(0x80, 0x40, 0x20, 0x10);
+	const PIXELS lowLaneBits = SetPixels(0x08, 0x04, 0x02, 0x01);
+	INT Col = 0;
+	for (; Col + 8 <= desc.Width; Col += 8)
+	{
+		UINT Bit = Col + desc.SkipX;
+		UINT ByteIndex = Bit / 8;
+		UINT Shift = Bit % 8;
+		//An unaligned group spans two mask bytes. The second byte is only read when it holds pixels of this group, so it is always inside the row.
+		UINT AndBits = pAndRow[ByteIndex];
+		UINT XorBits = pXorRow[ByteIndex];
+		if (Shift) {
+			AndBits = ((AndBits << 8 | pAndRow[ByteIndex + 1]) >> (8 - Shift)) & 0xFF;
+			XorBits = ((XorBits << 8 | pXorRow[ByteIndex + 1]) >> (8 - Shift)) & 0xFF;
+		}
+		StorePixels(pOutputRow + Col, RasterizeMonochromePixels(
+			ExpandMaskBits(AndBits, highLaneBits),
+			ExpandMaskBits(XorBits, highLaneBits),
+			LoadPixels(pBackgroundRow + Col)));
+		StorePixels(pOutputRow + Col + 4, RasterizeMonochromePixels(
+			ExpandMaskBits(AndBits, lowLaneBits),
+			ExpandMaskBits(XorBits, lowLaneBits),
+			LoadPixels(pBackgroundRow + Col + 4)));
+	}
+	return Col;
+}
+
+static INT RasterizeMaskedColorSpanVectorized(_In_ const CURSOR_RASTER_DESC &desc, _In_ const UINT *pShapeRow, _In_ const UINT *pBackgroundRow, _Inout_ UINT *pOutputRow)
+{
+	const PIXELS zero = SplatPixels(0);
+	const PIXELS opaqueBlack = SplatPixels(CURSOR_OPAQUE_BLACK);
+	const PIXELS transparentWhite = SplatPixels(CURSOR_TRANSPARENT_WHITE);
+	INT Col = 0;
+	for (; Col + 4 <= desc.Width; Col += 4)
+	{
+		PIXELS rgbValue = LoadPixels(pShapeRow + Col);
+		PIXELS maskVal = AndPixels(rgbValue, opaqueBlack);
+		PIXELS isMaskClear = EqualPixels(maskVal, zero);
+		PIXELS isMaskOnly = EqualPixels(rgbValue, maskVal);
+		PIXELS inverted = OrPixels(XorPixels(LoadPixels(pBackgroundRow + Col), rgbValue), opaqueBlack);
+		PIXELS result = SelectPixels(isMaskClear, OrPixels(rgbValue, opaqueBlack), inverted);
+		StorePixels(pOutputRow + Col, SelectPixels(AndNotPixels(isMaskOnly, isMaskClear), transparentWhite, result));
+	}
+	return Col;
+}
+#endif
+
+void RasterizeMonochromeCursor(_In_ const CURSOR_RASTER_DESC &desc, _Out_writes_(desc.Width *desc.Height) UINT *pOutput)
+{
+	for (INT Row = 0; Row < desc.Height; ++Row)
+	{
+		const BYTE *pAndRow = desc.pShape + (Row + desc.SkipY) * desc.ShapePitch;
+		const BYTE *pXorRow = desc.pShape + (Row + desc.SkipY + desc.MaskHeight) * desc.ShapePitch;
+		const UINT *pBackgroundRow = desc.pBackground + Row * desc.BackgroundPitchInPixels;
+		UINT *pOutputRow = pOutput + Row * desc.Width;
+		INT startCol = 0;
+#ifdef PIXELS_SIMD
+		startCol = RasterizeMonochromeSpanVectorized(desc, pAndRow, pXorRow, pBackgroundRow, pOutputRow);
+#endif
+		RasterizeMonochromeSpan(desc, pAndRow, pXorRow, pBackgroundRow, pOutputRow, startCol);
+	}
+}
+
+void RasterizeMaskedColorCursor(_In_ const CURSOR_RASTER_DESC &desc, _Out_writes_(desc.Width *desc.Height) UINT *pOutput)
+{
+	for (INT Row = 0; Row < desc.Height; ++Row)
+	{
+		const UINT *pShapeRow = reinterpret_cast<const UINT *>(desc.pShape + (Row + desc.SkipY) * desc.ShapePitch) + desc.SkipX;
+		const UINT *pBackgroundRow = desc.pBackground + Row * desc.BackgroundPitchInPixels;
+		UINT *pOutputRow = pOutput + Row * desc.Width;
+		INT startCol = 0;
+#ifdef PIXELS_SIMD
+		startCol = RasterizeMaskedColorSpanVectorized(desc, pShapeRow, pBackgroundRow, pOutputRow);
+#endif
+		RasterizeMaskedColorSpan(desc, pShapeRow, pBackgroundRow, pOutputRow, startCol);
+	}
+}
+
+void RasterizeMonochromeCursorScalar(_In_ const CURSOR_RASTER_DESC &desc, _Out_writes_(desc.Width *desc.Height) UINT *pOutput)
+{
+	for (INT Row = 0; Row < desc.Height; ++Row)
+	{
+		RasterizeMonochromeSpan(desc,
+			desc.pShape + (Row + desc.SkipY) * desc.ShapePitch,
+			desc.pShape + (Row + desc.SkipY + desc.MaskHeight) * desc.ShapePitch,
+			desc.pBackground + Row * desc.BackgroundPitchInPixels,
+			pOutput + Row * desc.Width,
+			0);
+	}
+}
+
+void RasterizeMaskedColorCursorScalar(_In_ const CURSOR_RASTER_DESC &desc, _Out_writes_(desc.Width *desc.Height) UINT *pOutput)
+{
+	for (INT Row = 0; Row < desc.Height; ++Row)
+	{
+		RasterizeMaskedColorSpan(desc,
+			reinterpret_cast<const UINT *>(desc.pShape + (Row + desc.SkipY) * desc.ShapePitch) + desc.SkipX,
+			desc.pBackground + Row * desc.BackgroundPitchInPixels,
+			pOutput + Row * desc.Width,
+			0);
+	}
+}
+
+bool IsCursorRasterizerVectorized()
+{
+#ifdef PIXELS_SIMD
+	return true;
+#else
+	return false;
+#endif
+}
+
+bool IsCursorBackgroundDependent(_In_ bool isMonochrome, _In_ const BYTE *pShape, _In_ UINT shapePitch, _In_ UINT width, _In_ UINT height)
+{
+	for (UINT Row = 0; Row < height; ++Row)
+	{
+		if (isMonochrome) {
+			const BYTE *pAndRow = pShape + Row * shapePitch;
+			const BYTE *pXorRow = pShape + (Row + height) * shapePitch;
+			for (UINT Col = 0; Col < width; Col += 8)
+			{
+				// Only pixels where both the AND and XOR bits are set invert the background.
+				BYTE validBits = width - Col >= 8 ? 0xFF : static_cast<BYTE>(0xFF << (8 - (width - Col)));
+				if (pAndRow[Col / 8] & pXorRow[Col / 8] & validBits) {
+					return true;
+				}
+			}
+		}
+		else {
+			const UINT *pShapeRow = reinterpret_cast<const UINT *>(pShape + Row * shapePitch);
+			for (UINT Col = 0; Col < width; ++Col)
+			{
+				// Pixels with the mask set and a non-zero color are XORed with the background.
+				UINT RgbValue = pShapeRow[Col];
+				if ((RgbValue & CURSOR_OPAQUE_BLACK) && RgbValue != (RgbValue & CURSOR_OPAQUE_BLACK)) {
+					return true;
+				}
+			}
+		}
+	}
+	return false;
+}
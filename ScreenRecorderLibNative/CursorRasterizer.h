@@ -0,0 +1,66 @@
+#pragma once
+#include <Windows.h>
+
+//
+// CPU rasterization of monochrome and masked color pointer shapes into 32bpp BGRA, as returned by
+// IDXGIOutputDuplication::GetFramePointerShape. These pointer types can invert the pixels below them,
+// so they are rendered against a copy of the background. Pixels where the pointer is not visible are set to
+// transparent white, so the result can be resized independently of the background and drawn on top of it.
+// https://docs.microsoft.com/en-us/windows-hardware/drivers/display/drawing-monochrome-pointers
+// https://docs.microsoft.com/en-us/windows-hardware/drivers/display/drawing-color-pointers
+//
+
+#define CURSOR_TRANSPARENT_WHITE 0x00FFFFFF
+#define CURSOR_TRANSPARENT_BLACK 0x00000000
+#define CURSOR_OPAQUE_WHITE 0xFFFFFFFF
+#define CURSOR_OPAQUE_BLACK 0xFF000000
+
+struct CURSOR_RASTER_DESC {
+	// The pointer shape buffer. For monochrome pointers the AND mask is followed by the XOR mask, one bit per pixel.
+	const BYTE *pShape;
+	// Bytes per row in the shape buffer
+	UINT ShapePitch;
+	// Height of a single mask for monochrome pointers, i.e. half the height of the shape buffer. Unused for color pointers.
+	UINT MaskHeight;
+	// Number of shape pixels to skip on the left and top, when the pointer is partially outside the background
+	UINT SkipX;
+	UINT SkipY;
+	// The background under the pointer. A pitch of 0 repeats the first row for all rows.
+	const UINT *pBackground;
+	UINT BackgroundPitchInPixels;
+	// Size of the area to rasterize
+	INT Width;
+	INT Height;
+};
+
+/// <summary>
+/// Rasterizes a monochrome pointer against the background. The output is Width*Height pixels with no row padding.
+/// </summary>
+void RasterizeMonochromeCursor(_In_ const CURSOR_RASTER_DESC &desc, _Out_writes_(desc.Width *desc.Height) UINT *pOutput);
+
+/// <summary>
+/// Rasterizes a masked color pointer against the background. The output is Width*Height pixels with no row padding.
+/// </summary>
+void RasterizeMaskedColorCursor(_In_ const CURSOR_RASTER_DESC &desc, _Out_writes_(desc.Width *desc.Height) UINT *pOutput);
+
+/// <summary>
+/// Scalar reference implementations of the kernels above. The kernels above use SSE2 or NEON where available, and must produce identical output.
+/// </summary>
+void RasterizeMonochromeCursorScalar(_In_ const CURSOR_RASTER_DESC &desc, _Out_writes_(desc.Width *desc.Height) UINT *pOutput);
+void RasterizeMaskedColorCursorScalar(_In_ const CURSOR_RASTER_DESC &desc, _Out_writes_(desc.Width *desc.Height) UINT *pOutput);
+
+/// <summary>
+/// Returns true if the rasterization kernels use vector instructions on this build.
+/// </summary>
+bool IsCursorRasterizerVectorized();
+
+/// <summary>
+/// Returns true if any pixel of a monochrome or masked color pointer inverts the background below it.
+/// Pointers that do not can be rasterized once and cached, as their appearance does not depend on what they are drawn over.
+/// </summary>
+/// <param name="isMonochrome">True for monochrome pointers, false for masked color pointers</param>
+/// <param name="pShape">The pointer shape buffer</param>
+/// <param name="shapePitch">Bytes per row in the shape buffer</param>
+/// <param name="width">Width of the pointer in pixels</param>
+/// <param name="height">Height of the pointer in pixels. For monochrome pointers, this is the height of a single mask.</param>
+bool IsCursorBackgroundDependent(_In_ bool isMonochrome, _In_ const BYTE *pShape, _In_ UINT shapePitch, _In_ UINT width, _In_ UINT height);
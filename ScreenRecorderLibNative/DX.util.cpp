@@ -6,7 +6,10 @@
 #include "CameraCapture.h"
 #include "ImageReader.h"
 #include "GifReader.h"
+#include "TestPatternCapture.h"
+#include "TraceReplayCapture.h"
 #include "WindowsGraphicsCapture.h"
+#include "TexturePool.h"
 #include "PixelShader.h"
 #include "VertexShader.h"
 #include <dxgi1_6.h>
@@ -242,6 +245,28 @@ HRESULT GetOutputRectsForRecordingSources(_In_ const std::vector<RECORDING_SOURC
 				}
 				break;
 			}
+			case RecordingSourceType::TestPattern: {
+				SIZE size{};
+				TestPatternCapture capture{};
+				HRESULT hr = capture.GetNativeSize(*source, &size);
+				if (SUCCEEDED(hr)) {
+					RECT sourceRect = GetOffsetSourceRect(RECT{ 0,0,size.cx,size.cy }, source);
+					std::pair<RECORDING_SOURCE *, RECT> tuple(source, sourceRect);
+					validOutputs.push_back(tuple);
+				}
+				break;
+			}
+			case RecordingSourceType::Replay: {
+				SIZE size{};
+				TraceReplayCapture capture{};
+				HRESULT hr = capture.GetNativeSize(*source, &size);
+				if (SUCCEEDED(hr)) {
+					RECT sourceRect = GetOffsetSourceRect(RECT{ 0,0,size.cx,size.cy }, source);
+					std::pair<RECORDING_SOURCE *, RECT> tuple(source, sourceRect);
+					validOutputs.push_back(tuple);
+				}
+				break;
+			}
 			default:
 				break;
 		}
@@ -480,6 +505,10 @@ std::vector<IDXGIAdapter *> EnumDisplayAdapters()
 //
 void CleanDx(_Inout_ DX_RESOURCES *Data)
 {
+	//Pooled textures hold a reference to their device, so they are dropped first to let the device be freed
+	if (Data->Device) {
+		TexturePool::Shared().Clear(Data->Device);
+	}
 	SafeRelease(&Data->Device);
 	SafeRelease(&Data->Context);
 	SafeRelease(&Data->Debug);
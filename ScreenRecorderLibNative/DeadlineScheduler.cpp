@@ -0,0 +1,71 @@
+#include "DeadlineScheduler.h"
+
+//Upper bounds of the lateness histogram buckets, from 50 microseconds to 16 milliseconds.
+static const INT64 LATENESS_BUCKET_BOUNDS[TIMER_LATENESS_BUCKET_COUNT - 1] = { 500, 1000, 2500, 5000, 10000, 20000, 40000, 80000, 160000 };
+
+INT64 GetTimerLatenessBucketBound(_In_ UINT bucket)
+{
+	if (bucket >= TIMER_LATENESS_BUCKET_COUNT - 1) {
+		return -1;
+	}
+	return LATENESS_BUCKET_BOUNDS[bucket];
+}
+
+DeadlineScheduler::DeadlineScheduler() :
+	m_Interval(0),
+	m_NextDeadline(0),
+	m_SleepOvershoot(DEADLINE_SCHEDULER_INITIAL_SPIN_THRESHOLD),
+	m_SpinThreshold(DEADLINE_SCHEDULER_INITIAL_SPIN_THRESHOLD),
+	m_Histogram{}
+{
+}
+
+void DeadlineScheduler::Start(_In_ INT64 startTime, _In_ INT64 interval)
+{
+	m_Interval = interval;
+	m_NextDeadline = startTime;
+	m_Histogram = {};
+}
+
+INT64 DeadlineScheduler::GetSleepTime(_In_ INT64 now) const
+{
+	INT64 timeUntilDeadline = m_NextDeadline - now;
+	if (timeUntilDeadline <= m_SpinThreshold) {
+		return 0;
+	}
+	return timeUntilDeadline - m_SpinThreshold;
+}
+
+void DeadlineScheduler::RecordSleep(_In_ INT64 requestedTime, _In_ INT64 actualTime)
+{
+	INT64 overshoot = max(0, actualTime - requestedTime);
+	//Rise quickly when sleeps get worse, and fall slowly when they get better, as a late tick costs more than a longer spin.
+	if (overshoot > m_SleepOvershoot) {
+		m_SleepOvershoot += (overshoot - m_SleepOvershoot) / 2;
+	}
+	else {
+		m_SleepOvershoot -= (m_SleepOvershoot - overshoot) / 16;
+	}
+	//Spin for half as long again as the typical overshoot, to cover its variation
+	m_SpinThreshold = min(max(m_SleepOvershoot + m_SleepOvershoot / 2, DEADLINE_SCHEDULER_MIN_SPIN_THRESHOLD), DEADLINE_SCHEDULER_MAX_SPIN_THRESHOLD);
+}
+
+void DeadlineScheduler::CompleteTick(_In_ INT64 now)
+{
+	INT64 lateness = max(0, now - m_NextDeadline);
+	UINT bucket = 0;
+	while (bucket < TIMER_LATENESS_BUCKET_COUNT - 1 && lateness > LATENESS_BUCKET_BOUNDS[bucket]) {
+		bucket++;
+	}
+	m_Histogram.Counts[bucket]++;
+	m_Histogram.TickCount++;
+	m_Histogram.TotalLateness += lateness;
+	m_Histogram.MaxLateness = max(m_Histogram.MaxLateness, lateness);
+
+	m_NextDeadline += m_Interval;
+	if (m_Interval > 0 && now >= m_NextDeadline) {
+		INT64 missedTicks = (now - m_NextDeadline) / m_Interval + 1;
+		m_NextDeadline += missedTicks * m_Interval;
+		m_Histogram.MissedTickCount += missedTicks;
+	}
+}
@@ -0,0 +1,70 @@
+#pragma once
+#include <Windows.h>
+
+//Number of buckets in the tick lateness histogram.
+#define TIMER_LATENESS_BUCKET_COUNT 10
+//Sleep overshoot assumed before any sleep is measured, in 100 nanosecond units.
+#define DEADLINE_SCHEDULER_INITIAL_SPIN_THRESHOLD 20000
+//Smallest and largest time spun before a deadline, in 100 nanosecond units.
+#define DEADLINE_SCHEDULER_MIN_SPIN_THRESHOLD 2000
+#define DEADLINE_SCHEDULER_MAX_SPIN_THRESHOLD 40000
+
+//
+// Counts of ticks by how late they were, compared to their deadline.
+// Bucket i counts ticks later than the bound of bucket i - 1, and up to the bound of bucket i. The last bucket has no upper bound.
+//
+struct TIMER_LATENESS_HISTOGRAM {
+	INT64 Counts[TIMER_LATENESS_BUCKET_COUNT];
+	INT64 TickCount;
+	// Deadlines that passed without a tick, because a tick was later than a whole interval
+	INT64 MissedTickCount;
+	// In 100 nanosecond units
+	INT64 MaxLateness;
+	INT64 TotalLateness;
+};
+
+/// <summary>
+/// Returns the upper bound of the lateness histogram bucket in 100 nanosecond units, or -1 for the last bucket.
+/// </summary>
+INT64 GetTimerLatenessBucketBound(_In_ UINT bucket);
+
+//
+// Schedules ticks at a fixed interval from absolute deadlines, so late ticks do not delay the ticks after them.
+// The wait for each deadline is split into a coarse sleep, and a short spin for the time the sleep may overshoot.
+// The spin time is calibrated from the measured overshoot of previous sleeps.
+// The scheduler does not wait itself, so it works on any clock. All times are in 100 nanosecond units.
+//
+class DeadlineScheduler
+{
+public:
+	DeadlineScheduler();
+	/// <summary>
+	/// Starts scheduling ticks at the interval, with the first tick due at the start time.
+	/// </summary>
+	void Start(_In_ INT64 startTime, _In_ INT64 interval);
+	inline INT64 GetNextDeadline() const { return m_NextDeadline; }
+	inline INT64 GetInterval() const { return m_Interval; }
+	inline bool IsDue(_In_ INT64 now) const { return now >= m_NextDeadline; }
+	/// <summary>
+	/// Returns how long to sleep before spinning until the next deadline, or 0 if the rest of the wait should be spun.
+	/// </summary>
+	INT64 GetSleepTime(_In_ INT64 now) const;
+	/// <summary>
+	/// Records how long a sleep took compared to the requested time, to calibrate the spin before each deadline.
+	/// </summary>
+	void RecordSleep(_In_ INT64 requestedTime, _In_ INT64 actualTime);
+	inline INT64 GetSpinThreshold() const { return m_SpinThreshold; }
+	/// <summary>
+	/// Records the lateness of a tick, and moves on to the next deadline. Deadlines that have already passed are skipped,
+	/// so a late tick is not followed by a burst of ticks.
+	/// </summary>
+	void CompleteTick(_In_ INT64 now);
+	inline TIMER_LATENESS_HISTOGRAM GetLatenessHistogram() const { return m_Histogram; }
+private:
+	INT64 m_Interval;
+	INT64 m_NextDeadline;
+	// Moving average of how much sleeps overshoot the requested time
+	INT64 m_SleepOvershoot;
+	INT64 m_SpinThreshold;
+	TIMER_LATENESS_HISTOGRAM m_Histogram;
+};
@@ -0,0 +1,169 @@
+#pragma once
+#include <Windows.h>
+#include <deque>
+#include <optional>
+
+struct DECODED_FRAME_QUEUE_STATISTICS {
+	// Frames waiting in the queue
+	UINT Depth;
+	// Frames returned for presentation
+	INT64 PresentedFrameCount;
+	// Frames returned more than their duration after they were due, because the decoder fell behind
+	INT64 LateFrameCount;
+	// Frames removed without being presented, because a later frame was already due
+	INT64 DroppedFrameCount;
+};
+
+//
+// Bounded queue of decoded frames with their presentation time stamps, filled ahead of playback by a decoder.
+// The consumer takes the frame that is due at its own clock, instead of the decoder being paced to the frame rate.
+// When the stream loops, the time stamps of the next loop continue from the end of the previous one, so the frames
+// at the start of the stream can be decoded while the last frames are still queued.
+// Not thread safe. All times are in 100 nanosecond units.
+//
+template <class TFrame>
+class DecodedFrameQueue
+{
+public:
+	DecodedFrameQueue(_In_ size_t capacity) :
+		m_Capacity(capacity),
+		m_Frames{},
+		m_IsClockAnchored(false),
+		m_ClockOffset(0),
+		m_StreamTimeOffset(0),
+		m_LastStreamTimeStamp(std::nullopt),
+		m_EndTime(0),
+		m_Statistics{}
+	{
+	}
+
+	inline bool IsFull() const { return m_Frames.size() >= m_Capacity; }
+	inline bool IsEmpty() const { return m_Frames.empty(); }
+
+	/// <summary>
+	/// Adds a decoded frame to the queue.
+	/// </summary>
+	/// <param name="timeStamp">The time stamp of the frame in the stream. A time stamp before the previous one starts a new loop of the stream.</param>
+	/// <param name="duration">The duration of the frame</param>
+	/// <returns>False if the queue is full and the frame was not added.</returns>
+	bool TryPush(_In_ const TFrame &frame, _In_ LONGLONG timeStamp, _In_ LONGLONG duration)
+	{
+		if (IsFull()) {
+			return false;
+		}
+		if (m_LastStreamTimeStamp.has_value() && timeStamp < m_LastStreamTimeStamp.value()) {
+			//The stream started over, so continue where the previous loop ended
+			m_StreamTimeOffset = m_EndTime - timeStamp;
+		}
+		m_LastStreamTimeStamp = timeStamp;
+		QUEUED_FRAME queuedFrame{ frame, timeStamp + m_StreamTimeOffset, duration };
+		m_EndTime = queuedFrame.PresentationTime + duration;
+		m_Frames.push_back(queuedFrame);
+		return true;
+	}
+
+	/// <summary>
+	/// Returns true if a frame is due at the clock time. The first frame is always due, and sets the clock time it is presented at.
+	/// </summary>
+	bool IsFrameDue(_In_ LONGLONG clockTime) const
+	{
+		if (m_Frames.empty()) {
+			return false;
+		}
+		return !m_IsClockAnchored || m_Frames.front().PresentationTime - m_ClockOffset <= clockTime;
+	}
+
+	/// <summary>
+	/// Returns the time until the next frame is due at the clock time, or a negative value if no frame is queued.
+	/// </summary>
+	LONGLONG GetTimeUntilNextFrame(_In_ LONGLONG clockTime) const
+	{
+		if (m_Frames.empty()) {
+			return -1;
+		}
+		if (IsFrameDue(clockTime)) {
+			return 0;
+		}
+		return m_Frames.front().PresentationTime - m_ClockOffset - clockTime;
+	}
+
+	/// <summary>
+	/// Removes all frames that are due at the clock time, and returns the newest of them.
+	/// </summary>
+	/// <returns>False if no frame is due.</returns>
+	bool TryAcquire(_In_ LONGLONG clockTime, _Out_ TFrame *pFrame)
+	{
+		if (!IsFrameDue(clockTime)) {
+			return false;
+		}
+		if (!m_IsClockAnchored) {
+			m_ClockOffset = m_Frames.front().PresentationTime - clockTime;
+			m_IsClockAnchored = true;
+		}
+		QUEUED_FRAME dueFrame = m_Frames.front();
+		m_Frames.pop_front();
+		while (IsFrameDue(clockTime)) {
+			m_Statistics.DroppedFrameCount++;
+			dueFrame = m_Frames.front();
+			m_Frames.pop_front();
+		}
+		m_Statistics.PresentedFrameCount++;
+		if (clockTime - (dueFrame.PresentationTime - m_ClockOffset) > dueFrame.Duration) {
+			m_Statistics.LateFrameCount++;
+		}
+		*pFrame = dueFrame.Frame;
+		return true;
+	}
+
+	/// <summary>
+	/// Returns true if the frame is waiting in the queue.
+	/// </summary>
+	bool Contains(_In_ const TFrame &frame) const
+	{
+		for (const QUEUED_FRAME &queuedFrame : m_Frames) {
+			if (queuedFrame.Frame == frame) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	/// <summary>
+	/// Removes all frames, and starts playback over at the next frame that is pushed. The statistics are kept.
+	/// </summary>
+	void Clear()
+	{
+		m_Frames.clear();
+		m_IsClockAnchored = false;
+		m_ClockOffset = 0;
+		m_StreamTimeOffset = 0;
+		m_LastStreamTimeStamp.reset();
+		m_EndTime = 0;
+	}
+
+	DECODED_FRAME_QUEUE_STATISTICS GetStatistics() const
+	{
+		DECODED_FRAME_QUEUE_STATISTICS statistics = m_Statistics;
+		statistics.Depth = static_cast<UINT>(m_Frames.size());
+		return statistics;
+	}
+private:
+	struct QUEUED_FRAME {
+		TFrame Frame;
+		// Time stamp of the frame, continued across loops of the stream
+		LONGLONG PresentationTime;
+		LONGLONG Duration;
+	};
+	size_t m_Capacity;
+	std::deque<QUEUED_FRAME> m_Frames;
+	// True once the first frame is presented, which maps presentation times to the consumer clock
+	bool m_IsClockAnchored;
+	// Presentation time minus clock time
+	LONGLONG m_ClockOffset;
+	// Added to the stream time stamps of the current loop
+	LONGLONG m_StreamTimeOffset;
+	std::optional<LONGLONG> m_LastStreamTimeStamp;
+	// Presentation time at the end of the last pushed frame
+	LONGLONG m_EndTime;
+	DECODED_FRAME_QUEUE_STATISTICS m_Statistics;
+};
@@ -0,0 +1,144 @@
+#include "DecodedMediaCache.h"
+#include "Log.h"
+#include "Util.h"
+
+using namespace std;
+
+//Size of the pieces a stream is read in when hashing it.
+static const ULONG STREAM_HASH_CHUNK_BYTES = 64 * 1024;
+
+size_t DECODED_MEDIA::GetSizeInBytes() const
+{
+	size_t size = Pixels.size() * sizeof(UINT) + GifData.size();
+	for each (const std::shared_ptr<const GIF_FRAME> &frame in GifFrames)
+	{
+		size += frame->Pixels.size() * sizeof(UINT);
+	}
+	return size;
+}
+
+DecodedMediaCache::DecodedMediaCache(_In_ size_t budgetBytes) :
+	m_Mutex(),
+	m_Entries{},
+	m_EntriesByKey{},
+	m_BudgetBytes(budgetBytes),
+	m_SizeInBytes(0)
+{
+}
+
+DecodedMediaCache &DecodedMediaCache::Shared()
+{
+	static DecodedMediaCache cache(DECODED_MEDIA_CACHE_BUDGET_BYTES);
+	return cache;
+}
+
+HRESULT DecodedMediaCache::GetMediaKey(_In_ std::wstring path, _Out_ DECODED_MEDIA_KEY *pKey)
+{
+	*pKey = DECODED_MEDIA_KEY{};
+	DWORD length = GetFullPathNameW(path.c_str(), 0, nullptr, nullptr);
+	if (length == 0) {
+		DWORD err = GetLastError();
+		LOG_ERROR(L"Failed to get full path of %ls: last error = %u", path.c_str(), err);
+		return HRESULT_FROM_WIN32(err);
+	}
+	std::wstring fullPath(length, L'\0');
+	length = GetFullPathNameW(path.c_str(), length, &fullPath[0], nullptr);
+	fullPath.resize(length);
+	//Paths are case insensitive
+	CharLowerBuffW(&fullPath[0], length);
+
+	WIN32_FILE_ATTRIBUTE_DATA attributes;
+	if (!GetFileAttributesExW(fullPath.c_str(), GetFileExInfoStandard, &attributes)) {
+		DWORD err = GetLastError();
+		LOG_ERROR(L"Failed to get attributes of %ls: last error = %u", fullPath.c_str(), err);
+		return HRESULT_FROM_WIN32(err);
+	}
+	pKey->Path = fullPath;
+	pKey->LastWriteTime = (static_cast<UINT64>(attributes.ftLastWriteTime.dwHighDateTime) << 32) | attributes.ftLastWriteTime.dwLowDateTime;
+	pKey->Size = (static_cast<UINT64>(attributes.nFileSizeHigh) << 32) | attributes.nFileSizeLow;
+	return S_OK;
+}
+
+HRESULT DecodedMediaCache::GetMediaKey(_In_ IStream *pStream, _Out_ DECODED_MEDIA_KEY *pKey)
+{
+	HRESULT hr;
+	*pKey = DECODED_MEDIA_KEY{};
+	LARGE_INTEGER li = { 0 };
+	RETURN_ON_BAD_HR(hr = pStream->Seek(li, STREAM_SEEK_SET, nullptr));
+	//FNV-1a
+	UINT64 hash = 0xCBF29CE484222325ull;
+	UINT64 size = 0;
+	std::vector<BYTE> chunk(STREAM_HASH_CHUNK_BYTES);
+	ULONG count = 0;
+	do {
+		RETURN_ON_BAD_HR(hr = pStream->Read(chunk.data(), STREAM_HASH_CHUNK_BYTES, &count));
+		for (ULONG i = 0; i < count; i++) {
+			hash = (hash ^ chunk[i]) * 0x100000001B3ull;
+		}
+		size += count;
+	} while (count == STREAM_HASH_CHUNK_BYTES);
+	RETURN_ON_BAD_HR(hr = pStream->Seek(li, STREAM_SEEK_SET, nullptr));
+	pKey->ContentHash = hash;
+	pKey->Size = size;
+	return S_OK;
+}
+
+std::shared_ptr<const DECODED_MEDIA> DecodedMediaCache::Find(_In_ const DECODED_MEDIA_KEY &key)
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	auto iterator = m_EntriesByKey.find(key);
+	if (iterator == m_EntriesByKey.end()) {
+		return nullptr;
+	}
+	//Move the entry to the front, as the most recently used
+	m_Entries.splice(m_Entries.begin(), m_Entries, iterator->second);
+	return iterator->second->Media;
+}
+
+void DecodedMediaCache::Insert(_In_ const DECODED_MEDIA_KEY &key, _In_ std::shared_ptr<const DECODED_MEDIA> pMedia)
+{
+	size_t sizeInBytes = pMedia->GetSizeInBytes();
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	auto iterator = m_EntriesByKey.find(key);
+	if (iterator != m_EntriesByKey.end()) {
+		Remove(iterator->second);
+	}
+	if (sizeInBytes > m_BudgetBytes) {
+		LOG_DEBUG(L"Decoded media of %zu bytes is larger than the cache budget, and is not cached", sizeInBytes);
+		return;
+	}
+	while (m_SizeInBytes + sizeInBytes > m_BudgetBytes) {
+		//Evict the least recently used entry
+		Remove(std::prev(m_Entries.end()));
+	}
+	m_Entries.push_front(CACHE_ENTRY{ key, pMedia, sizeInBytes });
+	m_EntriesByKey[key] = m_Entries.begin();
+	m_SizeInBytes += sizeInBytes;
+}
+
+void DecodedMediaCache::Clear()
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	m_Entries.clear();
+	m_EntriesByKey.clear();
+	m_SizeInBytes = 0;
+}
+
+size_t DecodedMediaCache::GetSizeInBytes()
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	return m_SizeInBytes;
+}
+
+UINT DecodedMediaCache::GetEntryCount()
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	return static_cast<UINT>(m_Entries.size());
+}
+
+void DecodedMediaCache::Remove(_In_ std::list<CACHE_ENTRY>::iterator entry)
+{
+	m_SizeInBytes -= entry->SizeInBytes;
+	m_EntriesByKey.erase(entry->Key);
+	m_Entries.erase(entry);
+}
@@ -0,0 +1,99 @@
+#pragma once
+#include <Windows.h>
+#include <objidl.h>
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <list>
+#include <map>
+#include <tuple>
+#include "GifDecoder.h"
+
+//Maximum memory used by the decoded media cache shared by all readers in the process.
+#define DECODED_MEDIA_CACHE_BUDGET_BYTES (256 * 1024 * 1024)
+
+//
+// Identifies the contents of a media file or stream.
+// Files are identified by their full path, last write time and size, so a file that is replaced on disk is decoded again.
+// Streams have no name or reliable modification time, and the same stream object may be reused with other contents,
+// so they are identified by a hash of their contents instead.
+//
+struct DECODED_MEDIA_KEY {
+	// Full path of the file in lowercase, or empty for a stream
+	std::wstring Path;
+	// Last write time of the file, as a FILETIME
+	UINT64 LastWriteTime;
+	// FNV-1a hash of the contents of a stream
+	UINT64 ContentHash;
+	// Size of the file or stream in bytes
+	UINT64 Size;
+
+	bool operator<(const DECODED_MEDIA_KEY &other) const
+	{
+		return std::tie(Path, LastWriteTime, ContentHash, Size) < std::tie(other.Path, other.LastWriteTime, other.ContentHash, other.Size);
+	}
+};
+
+//
+// Decoded media that is shared between readers. The contents are never modified once the media is added to the cache.
+//
+struct DECODED_MEDIA {
+	UINT Width;
+	UINT Height;
+	// BGRA pixels of a still image, Width*Height pixels with no row padding
+	std::vector<UINT> Pixels;
+	// The encoded GIF, which readers decode until the composed frames are cached
+	std::vector<BYTE> GifData;
+	// The composed frames of one loop of a GIF in display order, or empty if they are not cached
+	std::vector<std::shared_ptr<const GIF_FRAME>> GifFrames;
+
+	size_t GetSizeInBytes() const;
+};
+
+//
+// Keeps decoded media in memory, so media used by several sources and overlays, or re-applied during a recording, is only decoded once.
+// Entries are reference counted: media evicted from the cache stays valid for the readers still using it.
+// The least recently used entries are evicted when the cache exceeds its budget.
+//
+class DecodedMediaCache
+{
+public:
+	DecodedMediaCache(_In_ size_t budgetBytes);
+	/// <summary>
+	/// Returns the cache shared by all readers in the process.
+	/// </summary>
+	static DecodedMediaCache &Shared();
+	static HRESULT GetMediaKey(_In_ std::wstring path, _Out_ DECODED_MEDIA_KEY *pKey);
+	/// <summary>
+	/// Hashes the contents of the stream, and seeks it back to the start.
+	/// </summary>
+	static HRESULT GetMediaKey(_In_ IStream *pStream, _Out_ DECODED_MEDIA_KEY *pKey);
+
+	/// <summary>
+	/// Returns the cached media, or nullptr if it is not cached.
+	/// </summary>
+	std::shared_ptr<const DECODED_MEDIA> Find(_In_ const DECODED_MEDIA_KEY &key);
+	/// <summary>
+	/// Adds the media to the cache, replacing any media cached with the same key. Media larger than the budget is not cached.
+	/// </summary>
+	void Insert(_In_ const DECODED_MEDIA_KEY &key, _In_ std::shared_ptr<const DECODED_MEDIA> pMedia);
+	void Clear();
+
+	size_t GetSizeInBytes();
+	UINT GetEntryCount();
+private:
+	struct CACHE_ENTRY {
+		DECODED_MEDIA_KEY Key;
+		std::shared_ptr<const DECODED_MEDIA> Media;
+		size_t SizeInBytes;
+	};
+	void Remove(_In_ std::list<CACHE_ENTRY>::iterator entry);
+
+	std::mutex m_Mutex;
+	// Entries ordered from the most to the least recently used
+	std::list<CACHE_ENTRY> m_Entries;
+	std::map<DECODED_MEDIA_KEY, std::list<CACHE_ENTRY>::iterator> m_EntriesByKey;
+	size_t m_BudgetBytes;
+	size_t m_SizeInBytes;
+};
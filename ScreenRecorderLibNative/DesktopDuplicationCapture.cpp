@@ -1,5 +1,6 @@
 #include "DesktopDuplicationCapture.h"
 #include "Cleanup.h"
+#include "TexturePool.h"
 #include "MouseManager.h"
 #include "PixelShader.h"
 #include "VertexShader.h"
@@ -95,7 +96,7 @@ HRESULT DesktopDuplicationCapture::AcquireNextFrame(_In_ DWORD timeoutMillis, _O
 		desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
 		desc.MiscFlags = 0;
 		ID3D11Texture2D *pFrame = nullptr;
-		hr = m_Device->CreateTexture2D(&desc, nullptr, &pFrame);
+		hr = TexturePool::Shared().Acquire(m_Device, desc, &pFrame);
 		if (SUCCEEDED(hr)) {
 			m_DeviceContext->CopyResource(pFrame, m_CurrentData.Frame);
 			QueryPerformanceCounter(&m_LastGrabTimeStamp);
@@ -218,7 +219,14 @@ HRESULT DesktopDuplicationCapture::WriteNextFrameToSharedSurface(_In_ DWORD time
 		}
 		else if (m_LastGrabTimeStamp.QuadPart > 0
 			&& m_CurrentData.FrameInfo.LastMouseUpdateTime.QuadPart > m_LastGrabTimeStamp.QuadPart) {
-			hr = S_OK;
+			if (m_IsPointerOnlyUpdatePublished) {
+				hr = S_OK;
+			}
+			else {
+				//Only the pointer was updated, and it is not drawn on the frame.
+				QueryPerformanceCounter(&m_LastGrabTimeStamp);
+				hr = S_FALSE;
+			}
 		}
 		else {
 			hr = S_FALSE;
@@ -255,7 +263,7 @@ HRESULT DesktopDuplicationCapture::SendBitmapCallback(_In_ ID3D11Texture2D *pSha
 
 		HRESULT hr = GetMouse(&m_BitmapDataCallbackPtrInfo, destinationRect, frameOffset.cx, frameOffset.cy);
 		if (SUCCEEDED(hr)) {
-			LOG_ON_BAD_HR(hr = m_MouseManager->ProcessMousePointer(m_BitmapDataCallbackTexture, &m_BitmapDataCallbackPtrInfo));
+			LOG_ON_BAD_HR(hr = m_MouseManager->ProcessMousePointer(m_BitmapDataCallbackTexture, &m_BitmapDataCallbackPtrInfo, m_LastGrabTimeStamp.QuadPart));
 		}
 		return CaptureBase::SendBitmapCallback(m_BitmapDataCallbackTexture);
 	}
@@ -496,72 +504,6 @@ HRESULT DesktopDuplicationCapture::GetNextFrame(_In_ DWORD timeoutMillis, _Inout
 	return S_OK;
 }
 
-//
-// Set appropriate source and destination rects for move rects
-//
-void DesktopDuplicationCapture::SetMoveRect(_Out_ RECT *pSrcRect, _Out_ RECT *pDestRect, _In_ DXGI_MODE_ROTATION rotation, _In_ DXGI_OUTDUPL_MOVE_RECT *pMoveRect, INT texWidth, INT texHeight)
-{
-	switch (rotation)
-	{
-		case DXGI_MODE_ROTATION_UNSPECIFIED:
-		case DXGI_MODE_ROTATION_IDENTITY:
-		{
-			pSrcRect->left = pMoveRect->SourcePoint.x;
-			pSrcRect->top = pMoveRect->SourcePoint.y;
-			pSrcRect->right = pMoveRect->SourcePoint.x + RectWidth(pMoveRect->DestinationRect);
-			pSrcRect->bottom = pMoveRect->SourcePoint.y + RectHeight(pMoveRect->DestinationRect);
-
-			*pDestRect = pMoveRect->DestinationRect;
-			break;
-		}
-		case DXGI_MODE_ROTATION_ROTATE90:
-		{
-			pSrcRect->left = texHeight - (pMoveRect->SourcePoint.y + RectHeight(pMoveRect->DestinationRect));
-			pSrcRect->top = pMoveRect->SourcePoint.x;
-			pSrcRect->right = texHeight - pMoveRect->SourcePoint.y;
-			pSrcRect->bottom = pMoveRect->SourcePoint.x + RectWidth(pMoveRect->DestinationRect);
-
-			pDestRect->left = texHeight - pMoveRect->DestinationRect.bottom;
-			pDestRect->top = pMoveRect->DestinationRect.left;
-			pDestRect->right = texHeight - pMoveRect->DestinationRect.top;
-			pDestRect->bottom = pMoveRect->DestinationRect.right;
-			break;
-		}
-		case DXGI_MODE_ROTATION_ROTATE180:
-		{
-			pSrcRect->left = texWidth - (pMoveRect->SourcePoint.x + RectWidth(pMoveRect->DestinationRect));
-			pSrcRect->top = texHeight - (pMoveRect->SourcePoint.y + RectHeight(pMoveRect->DestinationRect));
-			pSrcRect->right = texWidth - pMoveRect->SourcePoint.x;
-			pSrcRect->bottom = texHeight - pMoveRect->SourcePoint.y;
-
-			pDestRect->left = texWidth - pMoveRect->DestinationRect.right;
-			pDestRect->top = texHeight - pMoveRect->DestinationRect.bottom;
-			pDestRect->right = texWidth - pMoveRect->DestinationRect.left;
-			pDestRect->bottom = texHeight - pMoveRect->DestinationRect.top;
-			break;
-		}
-		case DXGI_MODE_ROTATION_ROTATE270:
-		{
-			pSrcRect->left = pMoveRect->SourcePoint.x;
-			pSrcRect->top = texWidth - (pMoveRect->SourcePoint.x + RectWidth(pMoveRect->DestinationRect));
-			pSrcRect->right = pMoveRect->SourcePoint.y + RectHeight(pMoveRect->DestinationRect);
-			pSrcRect->bottom = texWidth - pMoveRect->SourcePoint.x;
-
-			pDestRect->left = pMoveRect->DestinationRect.top;
-			pDestRect->top = texWidth - pMoveRect->DestinationRect.right;
-			pDestRect->right = pMoveRect->DestinationRect.bottom;
-			pDestRect->bottom = texWidth - pMoveRect->DestinationRect.left;
-			break;
-		}
-		default:
-		{
-			RtlZeroMemory(pDestRect, sizeof(RECT));
-			RtlZeroMemory(pSrcRect, sizeof(RECT));
-			break;
-		}
-	}
-}
-
 //
 // Copy move rectangles
 //
@@ -618,100 +560,6 @@ HRESULT DesktopDuplicationCapture::CopyMove(_Inout_ ID3D11Texture2D *pSharedSurf
 	return S_OK;
 }
 
-//
-// Sets up vertices for dirty rects for rotated desktops
-//
-#pragma warning(push)
-#pragma warning(disable:__WARNING_USING_UNINIT_VAR) // false positives in SetDirtyVert due to tool bug
-
-void DesktopDuplicationCapture::SetDirtyVert(_Out_writes_(NUMVERTICES) VERTEX *pVertices, _In_ RECT *pDirty, INT offsetX, INT offsetY, _In_ RECT desktopCoordinates, _In_ DXGI_MODE_ROTATION rotation, _In_ D3D11_TEXTURE2D_DESC *pFullDesc, _In_ D3D11_TEXTURE2D_DESC *pThisDesc)
-{
-	INT CenterX = pFullDesc->Width / 2;
-	INT CenterY = pFullDesc->Height / 2;
-
-	INT Width = RectWidth(desktopCoordinates);
-	INT Height = RectHeight(desktopCoordinates);
-
-	// Rotation compensated destination rect
-	RECT DestDirty = *pDirty;
-
-	// Set appropriate coordinates compensated for rotation
-	switch (rotation)
-	{
-		case DXGI_MODE_ROTATION_ROTATE90:
-		{
-			DestDirty.left = Width - pDirty->bottom;
-			DestDirty.top = pDirty->left;
-			DestDirty.right = Width - pDirty->top;
-			DestDirty.bottom = pDirty->right;
-
-			pVertices[0].TexCoord = XMFLOAT2(pDirty->right / static_cast<FLOAT>(pThisDesc->Width), pDirty->bottom / static_cast<FLOAT>(pThisDesc->Height));
-			pVertices[1].TexCoord = XMFLOAT2(pDirty->left / static_cast<FLOAT>(pThisDesc->Width), pDirty->bottom / static_cast<FLOAT>(pThisDesc->Height));
-			pVertices[2].TexCoord = XMFLOAT2(pDirty->right / static_cast<FLOAT>(pThisDesc->Width), pDirty->top / static_cast<FLOAT>(pThisDesc->Height));
-			pVertices[5].TexCoord = XMFLOAT2(pDirty->left / static_cast<FLOAT>(pThisDesc->Width), pDirty->top / static_cast<FLOAT>(pThisDesc->Height));
-			break;
-		}
-		case DXGI_MODE_ROTATION_ROTATE180:
-		{
-			DestDirty.left = Width - pDirty->right;
-			DestDirty.top = Height - pDirty->bottom;
-			DestDirty.right = Width - pDirty->left;
-			DestDirty.bottom = Height - pDirty->top;
-
-			pVertices[0].TexCoord = XMFLOAT2(pDirty->right / static_cast<FLOAT>(pThisDesc->Width), pDirty->top / static_cast<FLOAT>(pThisDesc->Height));
-			pVertices[1].TexCoord = XMFLOAT2(pDirty->right / static_cast<FLOAT>(pThisDesc->Width), pDirty->bottom / static_cast<FLOAT>(pThisDesc->Height));
-			pVertices[2].TexCoord = XMFLOAT2(pDirty->left / static_cast<FLOAT>(pThisDesc->Width), pDirty->top / static_cast<FLOAT>(pThisDesc->Height));
-			pVertices[5].TexCoord = XMFLOAT2(pDirty->left / static_cast<FLOAT>(pThisDesc->Width), pDirty->bottom / static_cast<FLOAT>(pThisDesc->Height));
-			break;
-		}
-		case DXGI_MODE_ROTATION_ROTATE270:
-		{
-			DestDirty.left = pDirty->top;
-			DestDirty.top = Height - pDirty->right;
-			DestDirty.right = pDirty->bottom;
-			DestDirty.bottom = Height - pDirty->left;
-
-			pVertices[0].TexCoord = XMFLOAT2(pDirty->left / static_cast<FLOAT>(pThisDesc->Width), pDirty->top / static_cast<FLOAT>(pThisDesc->Height));
-			pVertices[1].TexCoord = XMFLOAT2(pDirty->right / static_cast<FLOAT>(pThisDesc->Width), pDirty->top / static_cast<FLOAT>(pThisDesc->Height));
-			pVertices[2].TexCoord = XMFLOAT2(pDirty->left / static_cast<FLOAT>(pThisDesc->Width), pDirty->bottom / static_cast<FLOAT>(pThisDesc->Height));
-			pVertices[5].TexCoord = XMFLOAT2(pDirty->right / static_cast<FLOAT>(pThisDesc->Width), pDirty->bottom / static_cast<FLOAT>(pThisDesc->Height));
-			break;
-		}
-		case DXGI_MODE_ROTATION_UNSPECIFIED:
-		case DXGI_MODE_ROTATION_IDENTITY:
-		{
-			pVertices[0].TexCoord = XMFLOAT2(pDirty->left / static_cast<FLOAT>(pThisDesc->Width), pDirty->bottom / static_cast<FLOAT>(pThisDesc->Height));
-			pVertices[1].TexCoord = XMFLOAT2(pDirty->left / static_cast<FLOAT>(pThisDesc->Width), pDirty->top / static_cast<FLOAT>(pThisDesc->Height));
-			pVertices[2].TexCoord = XMFLOAT2(pDirty->right / static_cast<FLOAT>(pThisDesc->Width), pDirty->bottom / static_cast<FLOAT>(pThisDesc->Height));
-			pVertices[5].TexCoord = XMFLOAT2(pDirty->right / static_cast<FLOAT>(pThisDesc->Width), pDirty->top / static_cast<FLOAT>(pThisDesc->Height));
-			break;
-		}
-		default:
-			assert(false);
-	}
-
-	// Set positions
-	pVertices[0].Pos = XMFLOAT3((DestDirty.left + desktopCoordinates.left + offsetX - CenterX) / static_cast<FLOAT>(CenterX),
-		-1 * (DestDirty.bottom + desktopCoordinates.top + offsetY - CenterY) / static_cast<FLOAT>(CenterY),
-		0.0f);
-	pVertices[1].Pos = XMFLOAT3((DestDirty.left + desktopCoordinates.left + offsetX - CenterX) / static_cast<FLOAT>(CenterX),
-		-1 * (DestDirty.top + desktopCoordinates.top + offsetY - CenterY) / static_cast<FLOAT>(CenterY),
-		0.0f);
-	pVertices[2].Pos = XMFLOAT3((DestDirty.right + desktopCoordinates.left + offsetX - CenterX) / static_cast<FLOAT>(CenterX),
-		-1 * (DestDirty.bottom + desktopCoordinates.top + offsetY - CenterY) / static_cast<FLOAT>(CenterY),
-		0.0f);
-	pVertices[3].Pos = pVertices[2].Pos;
-	pVertices[4].Pos = pVertices[1].Pos;
-	pVertices[5].Pos = XMFLOAT3((DestDirty.right + desktopCoordinates.left + offsetX - CenterX) / static_cast<FLOAT>(CenterX),
-		-1 * (DestDirty.top + desktopCoordinates.top + offsetY - CenterY) / static_cast<FLOAT>(CenterY),
-		0.0f);
-
-	pVertices[3].TexCoord = pVertices[2].TexCoord;
-	pVertices[4].TexCoord = pVertices[1].TexCoord;
-}
-
-#pragma warning(pop) // re-enable __WARNING_USING_UNINIT_VAR
-
 //
 // Copies dirty rectangles
 //
@@ -0,0 +1,164 @@
+#include "DirtyRects.h"
+#include <cassert>
+
+using namespace DirectX;
+
+//
+// Set appropriate source and destination rects for move rects
+//
+void SetMoveRect(_Out_ RECT *pSrcRect, _Out_ RECT *pDestRect, _In_ DXGI_MODE_ROTATION rotation, _In_ DXGI_OUTDUPL_MOVE_RECT *pMoveRect, INT texWidth, INT texHeight)
+{
+	switch (rotation)
+	{
+		case DXGI_MODE_ROTATION_UNSPECIFIED:
+		case DXGI_MODE_ROTATION_IDENTITY:
+		{
+			pSrcRect->left = pMoveRect->SourcePoint.x;
+			pSrcRect->top = pMoveRect->SourcePoint.y;
+			pSrcRect->right = pMoveRect->SourcePoint.x + RectWidth(pMoveRect->DestinationRect);
+			pSrcRect->bottom = pMoveRect->SourcePoint.y + RectHeight(pMoveRect->DestinationRect);
+
+			*pDestRect = pMoveRect->DestinationRect;
+			break;
+		}
+		case DXGI_MODE_ROTATION_ROTATE90:
+		{
+			pSrcRect->left = texHeight - (pMoveRect->SourcePoint.y + RectHeight(pMoveRect->DestinationRect));
+			pSrcRect->top = pMoveRect->SourcePoint.x;
+			pSrcRect->right = texHeight - pMoveRect->SourcePoint.y;
+			pSrcRect->bottom = pMoveRect->SourcePoint.x + RectWidth(pMoveRect->DestinationRect);
+
+			pDestRect->left = texHeight - pMoveRect->DestinationRect.bottom;
+			pDestRect->top = pMoveRect->DestinationRect.left;
+			pDestRect->right = texHeight - pMoveRect->DestinationRect.top;
+			pDestRect->bottom = pMoveRect->DestinationRect.right;
+			break;
+		}
+		case DXGI_MODE_ROTATION_ROTATE180:
+		{
+			pSrcRect->left = texWidth - (pMoveRect->SourcePoint.x + RectWidth(pMoveRect->DestinationRect));
+			pSrcRect->top = texHeight - (pMoveRect->SourcePoint.y + RectHeight(pMoveRect->DestinationRect));
+			pSrcRect->right = texWidth - pMoveRect->SourcePoint.x;
+			pSrcRect->bottom = texHeight - pMoveRect->SourcePoint.y;
+
+			pDestRect->left = texWidth - pMoveRect->DestinationRect.right;
+			pDestRect->top = texHeight - pMoveRect->DestinationRect.bottom;
+			pDestRect->right = texWidth - pMoveRect->DestinationRect.left;
+			pDestRect->bottom = texHeight - pMoveRect->DestinationRect.top;
+			break;
+		}
+		case DXGI_MODE_ROTATION_ROTATE270:
+		{
+			pSrcRect->left = pMoveRect->SourcePoint.x;
+			pSrcRect->top = texWidth - (pMoveRect->SourcePoint.x + RectWidth(pMoveRect->DestinationRect));
+			pSrcRect->right = pMoveRect->SourcePoint.y + RectHeight(pMoveRect->DestinationRect);
+			pSrcRect->bottom = texWidth - pMoveRect->SourcePoint.x;
+
+			pDestRect->left = pMoveRect->DestinationRect.top;
+			pDestRect->top = texWidth - pMoveRect->DestinationRect.right;
+			pDestRect->right = pMoveRect->DestinationRect.bottom;
+			pDestRect->bottom = texWidth - pMoveRect->DestinationRect.left;
+			break;
+		}
+		default:
+		{
+			RtlZeroMemory(pDestRect, sizeof(RECT));
+			RtlZeroMemory(pSrcRect, sizeof(RECT));
+			break;
+		}
+	}
+}
+
+//
+// Sets up vertices for dirty rects for rotated desktops
+//
+#pragma warning(push)
+#pragma warning(disable:__WARNING_USING_UNINIT_VAR) // false positives in SetDirtyVert due to tool bug
+
+void SetDirtyVert(_Out_writes_(DIRTY_RECT_VERTEX_COUNT) VERTEX *pVertices, _In_ RECT *pDirty, INT offsetX, INT offsetY, _In_ RECT desktopCoordinates, _In_ DXGI_MODE_ROTATION rotation, _In_ D3D11_TEXTURE2D_DESC *pFullDesc, _In_ D3D11_TEXTURE2D_DESC *pThisDesc)
+{
+	INT CenterX = pFullDesc->Width / 2;
+	INT CenterY = pFullDesc->Height / 2;
+
+	INT Width = RectWidth(desktopCoordinates);
+	INT Height = RectHeight(desktopCoordinates);
+
+	// Rotation compensated destination rect
+	RECT DestDirty = *pDirty;
+
+	// Set appropriate coordinates compensated for rotation
+	switch (rotation)
+	{
+		case DXGI_MODE_ROTATION_ROTATE90:
+		{
+			DestDirty.left = Width - pDirty->bottom;
+			DestDirty.top = pDirty->left;
+			DestDirty.right = Width - pDirty->top;
+			DestDirty.bottom = pDirty->right;
+
+			pVertices[0].TexCoord = XMFLOAT2(pDirty->right / static_cast<FLOAT>(pThisDesc->Width), pDirty->bottom / static_cast<FLOAT>(pThisDesc->Height));
+			pVertices[1].TexCoord = XMFLOAT2(pDirty->left / static_cast<FLOAT>(pThisDesc->Width), pDirty->bottom / static_cast<FLOAT>(pThisDesc->Height));
+			pVertices[2].TexCoord = XMFLOAT2(pDirty->right / static_cast<FLOAT>(pThisDesc->Width), pDirty->top / static_cast<FLOAT>(pThisDesc->Height));
+			pVertices[5].TexCoord = XMFLOAT2(pDirty->left / static_cast<FLOAT>(pThisDesc->Width), pDirty->top / static_cast<FLOAT>(pThisDesc->Height));
+			break;
+		}
+		case DXGI_MODE_ROTATION_ROTATE180:
+		{
+			DestDirty.left = Width - pDirty->right;
+			DestDirty.top = Height - pDirty->bottom;
+			DestDirty.right = Width - pDirty->left;
+			DestDirty.bottom = Height - pDirty->top;
+
+			pVertices[0].TexCoord = XMFLOAT2(pDirty->right / static_cast<FLOAT>(pThisDesc->Width), pDirty->top / static_cast<FLOAT>(pThisDesc->Height));
+			pVertices[1].TexCoord = XMFLOAT2(pDirty->right / static_cast<FLOAT>(pThisDesc->Width), pDirty->bottom / static_cast<FLOAT>(pThisDesc->Height));
+			pVertices[2].TexCoord = XMFLOAT2(pDirty->left / static_cast<FLOAT>(pThisDesc->Width), pDirty->top / static_cast<FLOAT>(pThisDesc->Height));
+			pVertices[5].TexCoord = XMFLOAT2(pDirty->left / static_cast<FLOAT>(pThisDesc->Width), pDirty->bottom / static_cast<FLOAT>(pThisDesc->Height));
+			break;
+		}
+		case DXGI_MODE_ROTATION_ROTATE270:
+		{
+			DestDirty.left = pDirty->top;
+			DestDirty.top = Height - pDirty->right;
+			DestDirty.right = pDirty->bottom;
+			DestDirty.bottom = Height - pDirty->left;
+
+			pVertices[0].TexCoord = XMFLOAT2(pDirty->left / static_cast<FLOAT>(pThisDesc->Width), pDirty->top / static_cast<FLOAT>(pThisDesc->Height));
+			pVertices[1].TexCoord = XMFLOAT2(pDirty->right / static_cast<FLOAT>(pThisDesc->Width), pDirty->top / static_cast<FLOAT>(pThisDesc->Height));
+			pVertices[2].TexCoord = XMFLOAT2(pDirty->left / static_cast<FLOAT>(pThisDesc->Width), pDirty->bottom / static_cast<FLOAT>(pThisDesc->Height));
+			pVertices[5].TexCoord = XMFLOAT2(pDirty->right / static_cast<FLOAT>(pThisDesc->Width), pDirty->bottom / static_cast<FLOAT>(pThisDesc->Height));
+			break;
+		}
+		case DXGI_MODE_ROTATION_UNSPECIFIED:
+		case DXGI_MODE_ROTATION_IDENTITY:
+		{
+			pVertices[0].TexCoord = XMFLOAT2(pDirty->left / static_cast<FLOAT>(pThisDesc->Width), pDirty->bottom / static_cast<FLOAT>(pThisDesc->Height));
+			pVertices[1].TexCoord = XMFLOAT2(pDirty->left / static_cast<FLOAT>(pThisDesc->Width), pDirty->top / static_cast<FLOAT>(pThisDesc->Height));
+			pVertices[2].TexCoord = XMFLOAT2(pDirty->right / static_cast<FLOAT>(pThisDesc->Width), pDirty->bottom / static_cast<FLOAT>(pThisDesc->Height));
+			pVertices[5].TexCoord = XMFLOAT2(pDirty->right / static_cast<FLOAT>(pThisDesc->Width), pDirty->top / static_cast<FLOAT>(pThisDesc->Height));
+			break;
+		}
+		default:
+			assert(false);
+	}
+
+	// Set positions
+	pVertices[0].Pos = XMFLOAT3((DestDirty.left + desktopCoordinates.left + offsetX - CenterX) / static_cast<FLOAT>(CenterX),
+		-1 * (DestDirty.bottom + desktopCoordinates.top + offsetY - CenterY) / static_cast<FLOAT>(CenterY),
+		0.0f);
+	pVertices[1].Pos = XMFLOAT3((DestDirty.left + desktopCoordinates.left + offsetX - CenterX) / static_cast<FLOAT>(CenterX),
+		-1 * (DestDirty.top + desktopCoordinates.top + offsetY - CenterY) / static_cast<FLOAT>(CenterY),
+		0.0f);
+	pVertices[2].Pos = XMFLOAT3((DestDirty.right + desktopCoordinates.left + offsetX - CenterX) / static_cast<FLOAT>(CenterX),
+		-1 * (DestDirty.bottom + desktopCoordinates.top + offsetY - CenterY) / static_cast<FLOAT>(CenterY),
+		0.0f);
+	pVertices[3].Pos = pVertices[2].Pos;
+	pVertices[4].Pos = pVertices[1].Pos;
+	pVertices[5].Pos = XMFLOAT3((DestDirty.right + desktopCoordinates.left + offsetX - CenterX) / static_cast<FLOAT>(CenterX),
+		-1 * (DestDirty.top + desktopCoordinates.top + offsetY - CenterY) / static_cast<FLOAT>(CenterY),
+		0.0f);
+
+	pVertices[3].TexCoord = pVertices[2].TexCoord;
+	pVertices[4].TexCoord = pVertices[1].TexCoord;
+}
+
+#pragma warning(pop) // re-enable __WARNING_USING_UNINIT_VAR
@@ -0,0 +1,22 @@
+#pragma once
+#include "CommonTypes.h"
+
+//
+// Coordinate math for the move and dirty rectangles reported by Desktop Duplication, compensated for the rotation of the output.
+// These run on the CPU for every rectangle of every updated frame, before the rectangles are copied or drawn on the GPU.
+//
+
+//Number of vertices used to draw a dirty rectangle, as two triangles.
+#define DIRTY_RECT_VERTEX_COUNT 6
+
+/// <summary>
+/// Sets the source and destination rects of a move rectangle, in the coordinates of the unrotated desktop texture.
+/// </summary>
+void SetMoveRect(_Out_ RECT *pSrcRect, _Out_ RECT *pDestRect, _In_ DXGI_MODE_ROTATION rotation, _In_ DXGI_OUTDUPL_MOVE_RECT *pMoveRect, INT texWidth, INT texHeight);
+
+/// <summary>
+/// Sets the vertices that draw a dirty rectangle of the source texture onto the shared surface.
+/// </summary>
+/// <param name="pFullDesc">Description of the shared surface</param>
+/// <param name="pThisDesc">Description of the source texture</param>
+void SetDirtyVert(_Out_writes_(DIRTY_RECT_VERTEX_COUNT) VERTEX *pVertices, _In_ RECT *pDirty, INT offsetX, INT offsetY, _In_ RECT desktopCoordinates, _In_ DXGI_MODE_ROTATION rotation, _In_ D3D11_TEXTURE2D_DESC *pFullDesc, _In_ D3D11_TEXTURE2D_DESC *pThisDesc);
@@ -21,6 +21,15 @@ DynamicWait::~DynamicWait()
 }
 
 void DynamicWait::Wait()
+{
+	// Sleep for the required period of time
+	WaitForSingleObject(m_CancelEvent, GetNextWaitTime());
+
+	// Record the time we woke up so we can detect wait sequences
+	QueryPerformanceCounter(&m_LastWakeUpTime);
+}
+
+UINT DynamicWait::GetNextWaitTime()
 {
 	LARGE_INTEGER CurrentQPC = { 0 };
 
@@ -41,13 +50,12 @@ void DynamicWait::Wait()
 		m_WaitCountInCurrentBand = 0;
 		m_CurrentWaitBandIdx = 0;
 	}
+	UINT waitTime = m_WaitBands[m_CurrentWaitBandIdx].WaitTime;
 
-	// Sleep for the required period of time
-	WaitForSingleObject(m_CancelEvent, m_WaitBands[m_CurrentWaitBandIdx].WaitTime);
-
-	// Record the time we woke up so we can detect wait sequences
-	QueryPerformanceCounter(&m_LastWakeUpTime);
+	// Record the expected wake up time, so a caller that schedules the wait itself is still detected as part of the same sequence
+	m_LastWakeUpTime.QuadPart = CurrentQPC.QuadPart + (m_QPCFrequency.QuadPart * waitTime) / 1000;
 	m_WaitCountInCurrentBand++;
+	return waitTime;
 }
 
 void DynamicWait::Cancel() {
@@ -20,6 +20,8 @@ public:
         m_WaitBands = bands;
     }
     void Wait();
+    // Advances the wait sequence like Wait(), but returns the period in milliseconds instead of sleeping.
+    UINT GetNextWaitTime();
     void Cancel();
 
 private:
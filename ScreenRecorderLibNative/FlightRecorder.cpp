@@ -0,0 +1,106 @@
+#include "FlightRecorder.h"
+#include "Log.h"
+#include <fstream>
+
+using namespace std;
+
+FlightRecorder::FlightRecorder(_In_ UINT32 capacity) :
+	m_Capacity(max(1u, capacity)),
+	m_Slots(nullptr),
+	m_NextSequence(0)
+{
+	m_Slots = make_unique<SLOT[]>(m_Capacity);
+	for (UINT32 i = 0; i < m_Capacity; i++) {
+		m_Slots[i].Sequence.store(0, memory_order_relaxed);
+	}
+}
+
+FlightRecorder &FlightRecorder::Instance()
+{
+	//Never destroyed, as events may still be recorded on other threads when the module is unloaded
+	static FlightRecorder *recorder = new FlightRecorder();
+	return *recorder;
+}
+
+void FlightRecorder::Record(_In_ FlightEventType type, _In_ HRESULT result, _In_ INT64 value, _In_ UINT16 detail)
+{
+	LARGE_INTEGER time;
+	QueryPerformanceCounter(&time);
+	UINT64 sequence = m_NextSequence.fetch_add(1, memory_order_relaxed);
+	SLOT &slot = m_Slots[sequence % m_Capacity];
+	slot.Sequence.store(0, memory_order_relaxed);
+	atomic_thread_fence(memory_order_release);
+	slot.Words[0].store(static_cast<UINT64>(time.QuadPart), memory_order_relaxed);
+	slot.Words[1].store(static_cast<UINT64>(type) | static_cast<UINT64>(detail) << 16 | static_cast<UINT64>(GetCurrentThreadId()) << 32, memory_order_relaxed);
+	slot.Words[2].store(static_cast<UINT32>(result), memory_order_relaxed);
+	slot.Words[3].store(static_cast<UINT64>(value), memory_order_relaxed);
+	slot.Sequence.store(sequence + 1, memory_order_release);
+}
+
+std::vector<FLIGHT_RECORD> FlightRecorder::GetRecords(_Out_opt_ UINT32 *pDroppedCount)
+{
+	std::vector<FLIGHT_RECORD> records;
+	UINT32 droppedCount = 0;
+	UINT64 nextSequence = m_NextSequence.load(memory_order_acquire);
+	UINT64 firstSequence = nextSequence > m_Capacity ? nextSequence - m_Capacity : 0;
+	for (UINT64 sequence = firstSequence; sequence < nextSequence; sequence++) {
+		SLOT &slot = m_Slots[sequence % m_Capacity];
+		if (slot.Sequence.load(memory_order_acquire) != sequence + 1) {
+			droppedCount++;
+			continue;
+		}
+		UINT64 words[4];
+		for (int i = 0; i < 4; i++) {
+			words[i] = slot.Words[i].load(memory_order_relaxed);
+		}
+		atomic_thread_fence(memory_order_acquire);
+		if (slot.Sequence.load(memory_order_relaxed) != sequence + 1) {
+			droppedCount++;
+			continue;
+		}
+		FLIGHT_RECORD record{};
+		record.Time = static_cast<INT64>(words[0]);
+		record.Sequence = static_cast<UINT32>(sequence);
+		record.Type = static_cast<FlightEventType>(words[1] & 0xFFFF);
+		record.Detail = static_cast<UINT16>((words[1] >> 16) & 0xFFFF);
+		record.ThreadId = static_cast<UINT32>(words[1] >> 32);
+		record.Result = static_cast<INT32>(static_cast<UINT32>(words[2]));
+		record.Value = static_cast<INT64>(words[3]);
+		records.push_back(record);
+	}
+	if (pDroppedCount) {
+		*pDroppedCount = droppedCount;
+	}
+	return records;
+}
+
+HRESULT FlightRecorder::Write(_Inout_ std::ostream &stream)
+{
+	FLIGHT_RECORDER_HEADER header{};
+	std::vector<FLIGHT_RECORD> records = GetRecords(&header.DroppedRecordCount);
+	LARGE_INTEGER frequency;
+	QueryPerformanceFrequency(&frequency);
+	LARGE_INTEGER now;
+	QueryPerformanceCounter(&now);
+	header.Version = FLIGHT_RECORDER_VERSION;
+	header.RecordSize = FLIGHT_RECORDER_RECORD_SIZE;
+	header.Frequency = frequency.QuadPart;
+	header.DumpTime = now.QuadPart;
+	header.RecordCount = static_cast<UINT32>(records.size());
+	FlightRecorderFile::WriteHeader(stream, header);
+	for each (const FLIGHT_RECORD &record in records)
+	{
+		FlightRecorderFile::WriteRecord(stream, record);
+	}
+	return stream.good() ? S_OK : E_FAIL;
+}
+
+HRESULT FlightRecorder::WriteToFile(_In_ std::wstring path)
+{
+	std::ofstream stream(path, ios_base::out | ios_base::trunc | ios_base::binary);
+	if (!stream.is_open()) {
+		LOG_ERROR(L"Failed to open flight recorder file %ls", path.c_str());
+		return E_FAIL;
+	}
+	return Write(stream);
+}
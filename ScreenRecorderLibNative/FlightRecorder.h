@@ -0,0 +1,47 @@
+#pragma once
+#include <Windows.h>
+#include <atomic>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "FlightRecorderFormat.h"
+
+//Number of records kept. At 60 fps with a few events per frame, this covers the last 20 seconds or so of a recording.
+#define FLIGHT_RECORDER_CAPACITY 4096
+
+//
+// Always-on ring of the most recent pipeline events, like rendered frames, capture errors, restarts and audio gaps,
+// dumped to a compact binary file when a recording fails, to find out what led up to the failure.
+// Recording an event is a performance counter read and a few atomic stores, without locks, so it can be done from any thread.
+// When the ring is full, the oldest records are overwritten.
+//
+class FlightRecorder
+{
+public:
+	FlightRecorder(_In_ UINT32 capacity = FLIGHT_RECORDER_CAPACITY);
+	static FlightRecorder &Instance();
+	void Record(_In_ FlightEventType type, _In_ HRESULT result = S_OK, _In_ INT64 value = 0, _In_ UINT16 detail = 0);
+	/// <summary>
+	/// Returns the records in the ring, oldest first. Records that are overwritten while they are read are left out.
+	/// </summary>
+	/// <param name="pDroppedCount">Receives the number of records that were left out</param>
+	std::vector<FLIGHT_RECORD> GetRecords(_Out_opt_ UINT32 *pDroppedCount = nullptr);
+	/// <summary>
+	/// Writes the records in the ring in the format described in FlightRecorderFormat.h. Can be called while events are recorded.
+	/// </summary>
+	HRESULT Write(_Inout_ std::ostream &stream);
+	HRESULT WriteToFile(_In_ std::wstring path);
+private:
+	//
+	// A record packed in atomic words, so it can be read while it is overwritten. The sequence number tells if the read was torn.
+	//
+	struct SLOT {
+		// Sequence number of the record plus one, or 0 while the record is written
+		std::atomic<UINT64> Sequence;
+		std::atomic<UINT64> Words[4];
+	};
+	UINT32 m_Capacity;
+	std::unique_ptr<SLOT[]> m_Slots;
+	std::atomic<UINT64> m_NextSequence;
+};
@@ -0,0 +1,167 @@
+#pragma once
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <vector>
+
+//
+// File format of flight recorder dumps. This header only uses the standard library, so the decoder in Tools/FlightRecorderDecoder
+// can be built on any platform. A dump is a header followed by the records, oldest first. All fields are little-endian.
+//
+//   header: magic "SRLFLT1\0", uint32 version, uint32 record size, int64 performance counter frequency,
+//           int64 performance counter time of the dump, uint32 record count, uint32 dropped record count
+//   record: int64 performance counter time, uint32 sequence number, uint16 event type, uint16 detail,
+//           uint32 thread id, int32 HRESULT, int64 value
+//
+// The meaning of the detail and value fields depends on the event type, see FlightEventType.
+//
+
+#define FLIGHT_RECORDER_MAGIC "SRLFLT1"
+#define FLIGHT_RECORDER_VERSION 1
+#define FLIGHT_RECORDER_HEADER_SIZE 40
+#define FLIGHT_RECORDER_RECORD_SIZE 32
+#define FLIGHT_RECORDER_FILE_EXTENSION L".flightrec"
+
+enum class FlightEventType : uint16_t {
+	None = 0,
+	// Value is the recorder mode
+	RecordingStarted = 1,
+	// HRESULT is the recording result, value the finalize result
+	RecordingFinished = 2,
+	// A frame was written. HRESULT is the result of writing it, value its media time stamp in 100 nanosecond units and detail the number of sources that had updated.
+	FrameRendered = 3,
+	// A capture thread failed. HRESULT is the error, detail 1 if the error is recoverable.
+	CaptureFailed = 4,
+	// The recorder is restarting capture after an error. HRESULT is the error, value the number of restarts so far and detail 1 if it is a device error.
+	CaptureRestarting = 5,
+	// HRESULT is the result of restarting capture
+	CaptureRestarted = 6,
+	// The audio device reported a gap in the captured audio. Value is the device position, detail 0 for the output device and 1 for the input device.
+	AudioDiscontinuity = 7,
+	// The number of samples queued in the sink writer changed. Value is the number of samples, detail 0 for video and 1 for audio.
+	QueueDepth = 8,
+	// Silence was written because no audio was captured for a frame. Value is the media time stamp of the frame.
+	AudioPadded = 9
+};
+
+struct FLIGHT_RECORD {
+	// QueryPerformanceCounter time the event was recorded
+	int64_t Time;
+	// Number of the record since the recorder was created, to find gaps where records were overwritten
+	uint32_t Sequence;
+	FlightEventType Type;
+	uint16_t Detail;
+	uint32_t ThreadId;
+	int32_t Result;
+	int64_t Value;
+};
+
+struct FLIGHT_RECORDER_HEADER {
+	uint32_t Version;
+	uint32_t RecordSize;
+	int64_t Frequency;
+	int64_t DumpTime;
+	uint32_t RecordCount;
+	// Records that were overwritten while the dump was read
+	uint32_t DroppedRecordCount;
+};
+
+inline const char *GetFlightEventName(FlightEventType type)
+{
+	switch (type) {
+	case FlightEventType::RecordingStarted: return "RecordingStarted";
+	case FlightEventType::RecordingFinished: return "RecordingFinished";
+	case FlightEventType::FrameRendered: return "FrameRendered";
+	case FlightEventType::CaptureFailed: return "CaptureFailed";
+	case FlightEventType::CaptureRestarting: return "CaptureRestarting";
+	case FlightEventType::CaptureRestarted: return "CaptureRestarted";
+	case FlightEventType::AudioDiscontinuity: return "AudioDiscontinuity";
+	case FlightEventType::QueueDepth: return "QueueDepth";
+	case FlightEventType::AudioPadded: return "AudioPadded";
+	default: return "Unknown";
+	}
+}
+
+namespace FlightRecorderFile
+{
+	inline void WriteValue(std::ostream &stream, uint64_t value, int byteCount)
+	{
+		for (int i = 0; i < byteCount; i++) {
+			stream.put(static_cast<char>((value >> (8 * i)) & 0xFF));
+		}
+	}
+
+	inline uint64_t ReadValue(std::istream &stream, int byteCount)
+	{
+		uint64_t value = 0;
+		for (int i = 0; i < byteCount; i++) {
+			value |= static_cast<uint64_t>(static_cast<uint8_t>(stream.get())) << (8 * i);
+		}
+		return value;
+	}
+
+	inline void WriteHeader(std::ostream &stream, const FLIGHT_RECORDER_HEADER &header)
+	{
+		stream.write(FLIGHT_RECORDER_MAGIC, sizeof(FLIGHT_RECORDER_MAGIC));
+		WriteValue(stream, header.Version, 4);
+		WriteValue(stream, header.RecordSize, 4);
+		WriteValue(stream, header.Frequency, 8);
+		WriteValue(stream, header.DumpTime, 8);
+		WriteValue(stream, header.RecordCount, 4);
+		WriteValue(stream, header.DroppedRecordCount, 4);
+	}
+
+	inline void WriteRecord(std::ostream &stream, const FLIGHT_RECORD &record)
+	{
+		WriteValue(stream, record.Time, 8);
+		WriteValue(stream, record.Sequence, 4);
+		WriteValue(stream, static_cast<uint16_t>(record.Type), 2);
+		WriteValue(stream, record.Detail, 2);
+		WriteValue(stream, record.ThreadId, 4);
+		WriteValue(stream, static_cast<uint32_t>(record.Result), 4);
+		WriteValue(stream, record.Value, 8);
+	}
+
+	/// <summary>
+	/// Reads a dump written by FlightRecorder. Returns false if the stream is not a flight recorder dump of a supported version, or is truncated.
+	/// </summary>
+	inline bool Read(std::istream &stream, FLIGHT_RECORDER_HEADER *pHeader, std::vector<FLIGHT_RECORD> *pRecords)
+	{
+		char magic[sizeof(FLIGHT_RECORDER_MAGIC)]{};
+		stream.read(magic, sizeof(magic));
+		if (!stream || std::char_traits<char>::compare(magic, FLIGHT_RECORDER_MAGIC, sizeof(magic)) != 0) {
+			return false;
+		}
+		FLIGHT_RECORDER_HEADER header{};
+		header.Version = static_cast<uint32_t>(ReadValue(stream, 4));
+		header.RecordSize = static_cast<uint32_t>(ReadValue(stream, 4));
+		header.Frequency = static_cast<int64_t>(ReadValue(stream, 8));
+		header.DumpTime = static_cast<int64_t>(ReadValue(stream, 8));
+		header.RecordCount = static_cast<uint32_t>(ReadValue(stream, 4));
+		header.DroppedRecordCount = static_cast<uint32_t>(ReadValue(stream, 4));
+		if (!stream || header.Version != FLIGHT_RECORDER_VERSION || header.RecordSize < FLIGHT_RECORDER_RECORD_SIZE) {
+			return false;
+		}
+		std::vector<FLIGHT_RECORD> records;
+		for (uint32_t i = 0; i < header.RecordCount; i++) {
+			FLIGHT_RECORD record{};
+			record.Time = static_cast<int64_t>(ReadValue(stream, 8));
+			record.Sequence = static_cast<uint32_t>(ReadValue(stream, 4));
+			record.Type = static_cast<FlightEventType>(ReadValue(stream, 2));
+			record.Detail = static_cast<uint16_t>(ReadValue(stream, 2));
+			record.ThreadId = static_cast<uint32_t>(ReadValue(stream, 4));
+			record.Result = static_cast<int32_t>(ReadValue(stream, 4));
+			record.Value = static_cast<int64_t>(ReadValue(stream, 8));
+			//Later versions may add fields to the end of a record
+			stream.ignore(header.RecordSize - FLIGHT_RECORDER_RECORD_SIZE);
+			if (!stream) {
+				return false;
+			}
+			records.push_back(record);
+		}
+		*pHeader = header;
+		*pRecords = records;
+		return true;
+	}
+}
@@ -0,0 +1,599 @@
+#include "GifDecoder.h"
+#include "SimdPixels.h"
+#include <algorithm>
+#include <cstring>
+
+GifLzwDecoder::GifLzwDecoder() :
+	m_Prefix{},
+	m_Suffix{},
+	m_FirstByte{},
+	m_Length{},
+	m_MinimumCodeSize(0),
+	m_ClearCode(0),
+	m_CodeSize(0),
+	m_NextCode(0),
+	m_PreviousCode(NO_CODE),
+	m_BitBuffer(0),
+	m_BitCount(0),
+	m_IsComplete(true),
+	m_pOutput(nullptr),
+	m_OutputSize(0),
+	m_OutputPosition(0)
+{
+}
+
+HRESULT GifLzwDecoder::Begin(_In_ BYTE minimumCodeSize, _Out_writes_(outputSize) BYTE *pOutput, _In_ size_t outputSize)
+{
+	m_pOutput = pOutput;
+	m_OutputSize = outputSize;
+	m_OutputPosition = 0;
+	m_BitBuffer = 0;
+	m_BitCount = 0;
+	//The specification requires at least 2, but some encoders write 1 bit images with a code size of 1.
+	if (minimumCodeSize < 1 || minimumCodeSize > 8) {
+		m_IsComplete = true;
+		return E_FAIL;
+	}
+	m_MinimumCodeSize = minimumCodeSize;
+	m_ClearCode = 1 << minimumCodeSize;
+	for (UINT code = 0; code < m_ClearCode; code++) {
+		m_Prefix[code] = NO_CODE;
+		m_Suffix[code] = static_cast<BYTE>(code);
+		m_FirstByte[code] = static_cast<BYTE>(code);
+		m_Length[code] = 1;
+	}
+	ResetTable();
+	m_IsComplete = outputSize == 0;
+	return S_OK;
+}
+
+void GifLzwDecoder::ResetTable()
+{
+	//Only the codes above the end of information code change, so the single byte codes never need to be reset.
+	m_CodeSize = m_MinimumCodeSize + 1;
+	m_NextCode = m_ClearCode + 2;
+	m_PreviousCode = NO_CODE;
+}
+
+HRESULT GifLzwDecoder::Write(_In_reads_bytes_(size) const BYTE *pData, _In_ size_t size)
+{
+	if (m_IsComplete) {
+		return S_FALSE;
+	}
+	for (size_t i = 0; i < size; i++) {
+		m_BitBuffer |= static_cast<UINT32>(pData[i]) << m_BitCount;
+		m_BitCount += 8;
+		while (m_BitCount >= m_CodeSize) {
+			UINT16 code = static_cast<UINT16>(m_BitBuffer & ((1u << m_CodeSize) - 1));
+			m_BitBuffer >>= m_CodeSize;
+			m_BitCount -= m_CodeSize;
+			HRESULT hr = ProcessCode(code);
+			if (hr != S_OK) {
+				m_IsComplete = true;
+				return hr;
+			}
+		}
+	}
+	return S_OK;
+}
+
+HRESULT GifLzwDecoder::ProcessCode(_In_ UINT16 code)
+{
+	if (code == m_ClearCode) {
+		ResetTable();
+		return S_OK;
+	}
+	if (code == m_ClearCode + 1) {
+		//End of information
+		return S_FALSE;
+	}
+	if (m_PreviousCode == NO_CODE) {
+		//The first code after a clear code must be a single byte.
+		if (code >= m_ClearCode) {
+			return E_FAIL;
+		}
+	}
+	else {
+		BYTE nextByte;
+		if (code < m_NextCode) {
+			nextByte = m_FirstByte[code];
+		}
+		else if (code == m_NextCode && m_NextCode < MAX_CODES) {
+			//The code is being defined by this step, as the previous string followed by its own first byte.
+			nextByte = m_FirstByte[m_PreviousCode];
+		}
+		else {
+			return E_FAIL;
+		}
+		if (m_NextCode < MAX_CODES) {
+			m_Prefix[m_NextCode] = m_PreviousCode;
+			m_Suffix[m_NextCode] = nextByte;
+			m_FirstByte[m_NextCode] = m_FirstByte[m_PreviousCode];
+			m_Length[m_NextCode] = m_Length[m_PreviousCode] + 1;
+			m_NextCode++;
+			if (m_NextCode == (1u << m_CodeSize) && m_CodeSize < MAX_CODE_SIZE) {
+				m_CodeSize++;
+			}
+		}
+	}
+	OutputString(code);
+	m_PreviousCode = code;
+	return m_OutputPosition == m_OutputSize ? S_FALSE : S_OK;
+}
+
+void GifLzwDecoder::OutputString(_In_ UINT16 code)
+{
+	size_t end = m_OutputPosition + m_Length[code];
+	//Strings are linked from their last byte to their first, so they are written back to front.
+	if (end > m_OutputSize) {
+		//Drop the part of the string that does not fit in the image.
+		for (size_t skip = end - m_OutputSize; skip > 0; skip--) {
+			code = m_Prefix[code];
+		}
+		end = m_OutputSize;
+	}
+	BYTE *pStart = m_pOutput + m_OutputPosition;
+	BYTE *pEnd = m_pOutput + end;
+	while (pEnd > pStart) {
+		*--pEnd = m_Suffix[code];
+		code = m_Prefix[code];
+	}
+	m_OutputPosition = end;
+}
+
+GifFramePool::GifFramePool() :
+	m_State(std::make_shared<POOL_STATE>()),
+	m_Width(0),
+	m_Height(0),
+	m_AllocatedFrameCount(0)
+{
+}
+
+void GifFramePool::Initialize(_In_ UINT width, _In_ UINT height)
+{
+	//Frames still in use from a previous size are released instead of being returned to the new pool.
+	m_State = std::make_shared<POOL_STATE>();
+	m_Width = width;
+	m_Height = height;
+	m_AllocatedFrameCount = 0;
+}
+
+std::shared_ptr<GIF_FRAME> GifFramePool::Acquire()
+{
+	std::unique_ptr<GIF_FRAME> pFrame;
+	{
+		std::lock_guard<std::mutex> lock(m_State->Mutex);
+		if (!m_State->FreeFrames.empty()) {
+			pFrame = std::move(m_State->FreeFrames.back());
+			m_State->FreeFrames.pop_back();
+		}
+		else {
+			m_AllocatedFrameCount++;
+		}
+	}
+	if (!pFrame) {
+		pFrame = std::make_unique<GIF_FRAME>();
+		pFrame->Pixels.resize(static_cast<size_t>(m_Width) * m_Height);
+	}
+	pFrame->Width = m_Width;
+	pFrame->Height = m_Height;
+	std::weak_ptr<POOL_STATE> pool = m_State;
+	return std::shared_ptr<GIF_FRAME>(pFrame.release(), [pool](GIF_FRAME *pReleasedFrame) {
+		std::unique_ptr<GIF_FRAME> pOwnedFrame(pReleasedFrame);
+		if (std::shared_ptr<POOL_STATE> pState = pool.lock()) {
+			std::lock_guard<std::mutex> lock(pState->Mutex);
+			pState->FreeFrames.push_back(std::move(pOwnedFrame));
+		}
+	});
+}
+
+UINT GifFramePool::GetAllocatedFrameCount()
+{
+	std::lock_guard<std::mutex> lock(m_State->Mutex);
+	return m_AllocatedFrameCount;
+}
+
+void ExpandGifPixelsScalar(_In_reads_(count) const BYTE *pIndices, _In_reads_(256) const UINT *pPalette, _Inout_updates_(count) UINT *pCanvas, _In_ UINT count)
+{
+	for (UINT i = 0; i < count; i++) {
+		UINT color = pPalette[pIndices[i]];
+		if (color & 0xFF000000) {
+			pCanvas[i] = color;
+		}
+	}
+}
+
+void ExpandGifPixels(_In_reads_(count) const BYTE *pIndices, _In_reads_(256) const UINT *pPalette, _Inout_updates_(count) UINT *pCanvas, _In_ UINT count)
+{
+	UINT i = 0;
+#ifdef PIXELS_SIMD
+	//The palette lookup is scalar, but keeping transparent pixels is a branchless select on the alpha of four pixels at a time.
+	const PIXELS alphaMask = SplatPixels(0xFF000000);
+	const PIXELS zero = SplatPixels(0);
+	for (; i + 4 <= count; i += 4) {
+		PIXELS colors = SetPixels(pPalette[pIndices[i]], pPalette[pIndices[i + 1]], pPalette[pIndices[i + 2]], pPalette[pIndices[i + 3]]);
+		PIXELS isTransparent = EqualPixels(AndPixels(colors, alphaMask), zero);
+		StorePixels(pCanvas + i, SelectPixels(isTransparent, LoadPixels(pCanvas + i), colors));
+	}
+#endif
+	ExpandGifPixelsScalar(pIndices + i, pPalette, pCanvas + i, count - i);
+}
+
+static inline UINT ReadUInt16(_In_ const BYTE *p)
+{
+	return p[0] | (p[1] << 8);
+}
+
+GifDecoder::GifDecoder() :
+	m_Data{},
+	m_Frames{},
+	m_Width(0),
+	m_Height(0),
+	m_GlobalColorTableOffset(0),
+	m_GlobalColorTableSize(0),
+	m_HasLoopCount(false),
+	m_LoopCount(0),
+	m_LzwDecoder(),
+	m_FramePool(),
+	m_NextFrameIndex(0),
+	m_Indices{},
+	m_Palette{},
+	m_Canvas{},
+	m_SavedCanvas{}
+{
+}
+
+HRESULT GifDecoder::Open(_In_ std::vector<BYTE> data)
+{
+	m_Data = std::move(data);
+	m_Frames.clear();
+	m_HasLoopCount = false;
+	m_LoopCount = 0;
+	m_GlobalColorTableOffset = 0;
+	m_GlobalColorTableSize = 0;
+	// Header and logical screen descriptor
+	if (m_Data.size() < 13
+		|| (memcmp(m_Data.data(), "GIF87a", 6) && memcmp(m_Data.data(), "GIF89a", 6))) {
+		return E_FAIL;
+	}
+	m_Width = ReadUInt16(&m_Data[6]);
+	m_Height = ReadUInt16(&m_Data[8]);
+	BYTE flags = m_Data[10];
+	if (m_Width == 0 || m_Height == 0) {
+		return E_FAIL;
+	}
+	if (flags & 0x80) {
+		m_GlobalColorTableOffset = 13;
+		m_GlobalColorTableSize = 2 << (flags & 0x07);
+	}
+	HRESULT hr = ReadFrames();
+	if (FAILED(hr)) {
+		return hr;
+	}
+	m_FramePool.Initialize(m_Width, m_Height);
+	m_Canvas.assign(static_cast<size_t>(m_Width) * m_Height, 0);
+	m_SavedCanvas.clear();
+	Reset();
+	return S_OK;
+}
+
+HRESULT GifDecoder::SkipSubBlocks(_Inout_ size_t *pOffset)
+{
+	size_t offset = *pOffset;
+	while (offset < m_Data.size()) {
+		BYTE blockSize = m_Data[offset++];
+		if (blockSize == 0) {
+			*pOffset = offset;
+			return S_OK;
+		}
+		offset += blockSize;
+	}
+	*pOffset = m_Data.size();
+	return E_FAIL;
+}
+
+HRESULT GifDecoder::ReadFrames()
+{
+	size_t offset = 13 + m_GlobalColorTableSize * 3;
+	// The graphic control extension applies to the image that follows it
+	UINT disposal = GIF_DISPOSAL_UNDEFINED;
+	UINT delay = 0;
+	INT transparentIndex = -1;
+	while (offset < m_Data.size()) {
+		BYTE introducer = m_Data[offset++];
+		if (introducer == 0x3B) {
+			//Trailer
+			break;
+		}
+		else if (introducer == 0x21 && offset < m_Data.size()) {
+			BYTE label = m_Data[offset++];
+			size_t blockOffset = offset;
+			if (label == 0xF9 && blockOffset + 5 <= m_Data.size() && m_Data[blockOffset] >= 4) {
+				BYTE gceFlags = m_Data[blockOffset + 1];
+				disposal = (gceFlags >> 2) & 0x07;
+				delay = ReadUInt16(&m_Data[blockOffset + 2]) * 10;
+				transparentIndex = (gceFlags & 0x01) ? m_Data[blockOffset + 4] : -1;
+			}
+			else if (label == 0xFF && blockOffset + 12 <= m_Data.size() && m_Data[blockOffset] == 11
+				&& (!memcmp(&m_Data[blockOffset + 1], "NETSCAPE2.0", 11) || !memcmp(&m_Data[blockOffset + 1], "ANIMEXTS1.0", 11))) {
+				//  The data sub-block is in the following format:
+				//  byte 0: block size (3)
+				//  byte 1: sub-block ID (1 == loop count)
+				//  byte 2-3: loop count, least significant byte first
+				size_t dataOffset = blockOffset + 12;
+				if (dataOffset + 4 <= m_Data.size() && m_Data[dataOffset] >= 3 && m_Data[dataOffset + 1] == 1) {
+					m_HasLoopCount = true;
+					m_LoopCount = ReadUInt16(&m_Data[dataOffset + 2]);
+				}
+			}
+			if (FAILED(SkipSubBlocks(&offset))) {
+				break;
+			}
+		}
+		else if (introducer == 0x2C && offset + 9 <= m_Data.size()) {
+			GIF_FRAME_DESC frame{};
+			frame.Left = ReadUInt16(&m_Data[offset]);
+			frame.Top = ReadUInt16(&m_Data[offset + 2]);
+			frame.Width = ReadUInt16(&m_Data[offset + 4]);
+			frame.Height = ReadUInt16(&m_Data[offset + 6]);
+			BYTE imageFlags = m_Data[offset + 8];
+			offset += 9;
+			frame.IsInterlaced = (imageFlags & 0x40) != 0;
+			if (imageFlags & 0x80) {
+				frame.ColorTableOffset = offset;
+				frame.ColorTableSize = 2 << (imageFlags & 0x07);
+				offset += frame.ColorTableSize * 3;
+			}
+			else {
+				frame.ColorTableOffset = m_GlobalColorTableOffset;
+				frame.ColorTableSize = m_GlobalColorTableSize;
+			}
+			frame.ImageDataOffset = offset;
+			frame.TransparentIndex = transparentIndex;
+			frame.Disposal = disposal;
+			frame.DelayMillis = delay;
+			if (offset >= m_Data.size()) {
+				break;
+			}
+			//A frame cut short by the end of the file is still shown, as far as it could be decoded.
+			m_Frames.push_back(frame);
+			disposal = GIF_DISPOSAL_UNDEFINED;
+			delay = 0;
+			transparentIndex = -1;
+			offset++;
+			if (FAILED(SkipSubBlocks(&offset))) {
+				break;
+			}
+		}
+		else {
+			//Unknown block, so the rest of the file can not be parsed.
+			break;
+		}
+	}
+	return m_Frames.empty() ? E_FAIL : S_OK;
+}
+
+void GifDecoder::Reset()
+{
+	m_NextFrameIndex = 0;
+}
+
+HRESULT GifDecoder::DecodeNextFrame(_Out_ std::shared_ptr<GIF_FRAME> *ppFrame)
+{
+	*ppFrame = nullptr;
+	if (m_Frames.empty()) {
+		return E_FAIL;
+	}
+	UINT frameIndex = m_NextFrameIndex;
+	const GIF_FRAME_DESC &frame = m_Frames[frameIndex];
+	if (frameIndex == 0) {
+		std::fill(m_Canvas.begin(), m_Canvas.end(), 0);
+	}
+	else {
+		// Dispose the previous frame
+		const GIF_FRAME_DESC &previousFrame = m_Frames[frameIndex - 1];
+		if (previousFrame.Disposal == GIF_DISPOSAL_BACKGROUND) {
+			ClearCanvasRect(previousFrame);
+		}
+		else if (previousFrame.Disposal == GIF_DISPOSAL_PREVIOUS && m_SavedCanvas.size() == m_Canvas.size()) {
+			std::copy(m_SavedCanvas.begin(), m_SavedCanvas.end(), m_Canvas.begin());
+		}
+	}
+	if (frame.Disposal == GIF_DISPOSAL_PREVIOUS) {
+		m_SavedCanvas.assign(m_Canvas.begin(), m_Canvas.end());
+	}
+	//Corrupt image data still shows the pixels decoded before the error, like most browsers do.
+	DecodeIndices(frame);
+	BuildPalette(frame);
+	DrawIndices(frame);
+
+	std::shared_ptr<GIF_FRAME> pFrame = m_FramePool.Acquire();
+	pFrame->Index = frameIndex;
+	pFrame->DelayMillis = frame.DelayMillis;
+	std::copy(m_Canvas.begin(), m_Canvas.end(), pFrame->Pixels.begin());
+	*ppFrame = pFrame;
+	m_NextFrameIndex = (frameIndex + 1) % static_cast<UINT>(m_Frames.size());
+	return S_OK;
+}
+
+HRESULT GifDecoder::DecodeIndices(_In_ const GIF_FRAME_DESC &frame)
+{
+	size_t pixelCount = static_cast<size_t>(frame.Width) * frame.Height;
+	if (m_Indices.size() < pixelCount) {
+		m_Indices.resize(pixelCount);
+	}
+	HRESULT hr = m_LzwDecoder.Begin(m_Data[frame.ImageDataOffset], m_Indices.data(), pixelCount);
+	if (FAILED(hr)) {
+		return hr;
+	}
+	size_t offset = frame.ImageDataOffset + 1;
+	while (offset < m_Data.size() && !m_LzwDecoder.IsComplete()) {
+		size_t blockSize = m_Data[offset++];
+		if (blockSize == 0) {
+			break;
+		}
+		blockSize = min(blockSize, m_Data.size() - offset);
+		hr = m_LzwDecoder.Write(&m_Data[offset], blockSize);
+		if (FAILED(hr)) {
+			return hr;
+		}
+		offset += blockSize;
+	}
+	return S_OK;
+}
+
+void GifDecoder::BuildPalette(_In_ const GIF_FRAME_DESC &frame)
+{
+	UINT colorCount = 0;
+	if (frame.ColorTableOffset > 0) {
+		//The color table may be cut short by the end of the file.
+		colorCount = static_cast<UINT>(min(static_cast<size_t>(frame.ColorTableSize), (m_Data.size() - frame.ColorTableOffset) / 3));
+	}
+	const BYTE *pColor = colorCount > 0 ? &m_Data[frame.ColorTableOffset] : nullptr;
+	for (UINT i = 0; i < colorCount; i++, pColor += 3) {
+		m_Palette[i] = 0xFF000000 | (pColor[0] << 16) | (pColor[1] << 8) | pColor[2];
+	}
+	//Indices outside the color table are drawn black.
+	for (UINT i = colorCount; i < 256; i++) {
+		m_Palette[i] = 0xFF000000;
+	}
+	if (frame.TransparentIndex >= 0) {
+		m_Palette[frame.TransparentIndex] = 0;
+	}
+}
+
+// Interlaced images store every 8th row starting with row 0, then every 8th row starting with row 4, then every 4th row starting with row 2, then the odd rows.
+static UINT GetInterlacedRow(_In_ UINT storedRow, _In_ UINT height)
+{
+	static const UINT passStart[] = { 0, 4, 2, 1 };
+	static const UINT passStep[] = { 8, 8, 4, 2 };
+	for (UINT pass = 0; pass < 4; pass++) {
+		UINT rowsInPass = height > passStart[pass] ? (height - passStart[pass] + passStep[pass] - 1) / passStep[pass] : 0;
+		if (storedRow < rowsInPass) {
+			return passStart[pass] + storedRow * passStep[pass];
+		}
+		storedRow -= rowsInPass;
+	}
+	return height;
+}
+
+void GifDecoder::DrawIndices(_In_ const GIF_FRAME_DESC &frame)
+{
+	if (frame.Left >= m_Width || frame.Top >= m_Height || frame.Width == 0) {
+		return;
+	}
+	UINT visibleWidth = min(frame.Width, m_Width - frame.Left);
+	size_t decodedCount = m_LzwDecoder.GetDecodedCount();
+	for (UINT storedRow = 0; storedRow < frame.Height; storedRow++) {
+		size_t rowStart = static_cast<size_t>(storedRow) * frame.Width;
+		if (rowStart >= decodedCount) {
+			break;
+		}
+		UINT canvasRow = frame.Top + (frame.IsInterlaced ? GetInterlacedRow(storedRow, frame.Height) : storedRow);
+		if (canvasRow < m_Height) {
+			UINT count = static_cast<UINT>(min(static_cast<size_t>(visibleWidth), decodedCount - rowStart));
+			ExpandGifPixels(&m_Indices[rowStart], m_Palette, &m_Canvas[static_cast<size_t>(canvasRow) * m_Width + frame.Left], count);
+		}
+	}
+}
+
+void GifDecoder::ClearCanvasRect(_In_ const GIF_FRAME_DESC &frame)
+{
+	//The background color is ignored, like most browsers do, so the area becomes transparent.
+	if (frame.Left >= m_Width || frame.Top >= m_Height) {
+		return;
+	}
+	UINT right = min(frame.Left + frame.Width, m_Width);
+	UINT bottom = min(frame.Top + frame.Height, m_Height);
+	for (UINT y = frame.Top; y < bottom; y++) {
+		UINT *pRow = &m_Canvas[static_cast<size_t>(y) * m_Width];
+		std::fill(pRow + frame.Left, pRow + right, 0);
+	}
+}
+
+GifFrameQueue::GifFrameQueue() :
+	m_pDecoder(nullptr),
+	m_MaxQueuedFrames(0),
+	m_DecodeThread{},
+	m_Mutex{},
+	m_QueueChanged{},
+	m_Frames{},
+	m_DecodeResult(S_OK),
+	m_IsStopping(true)
+{
+}
+
+GifFrameQueue::~GifFrameQueue()
+{
+	Stop();
+}
+
+HRESULT GifFrameQueue::Start(_In_ GifDecoder *pDecoder, _In_ UINT maxQueuedFrames)
+{
+	Stop();
+	if (!pDecoder || maxQueuedFrames == 0) {
+		return E_INVALIDARG;
+	}
+	m_pDecoder = pDecoder;
+	m_MaxQueuedFrames = maxQueuedFrames;
+	m_DecodeResult = S_OK;
+	m_IsStopping = false;
+	m_DecodeThread = std::thread(&GifFrameQueue::DecodeLoop, this);
+	return S_OK;
+}
+
+void GifFrameQueue::Stop()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_IsStopping = true;
+	}
+	m_QueueChanged.notify_all();
+	if (m_DecodeThread.joinable()) {
+		m_DecodeThread.join();
+	}
+	m_Frames.clear();
+}
+
+HRESULT GifFrameQueue::GetNextFrame(_Out_ std::shared_ptr<GIF_FRAME> *ppFrame)
+{
+	*ppFrame = nullptr;
+	std::unique_lock<std::mutex> lock(m_Mutex);
+	m_QueueChanged.wait(lock, [this]() { return m_IsStopping || !m_Frames.empty() || FAILED(m_DecodeResult); });
+	if (m_Frames.empty()) {
+		return FAILED(m_DecodeResult) ? m_DecodeResult : E_ABORT;
+	}
+	*ppFrame = m_Frames.front();
+	m_Frames.pop_front();
+	lock.unlock();
+	m_QueueChanged.notify_all();
+	return S_OK;
+}
+
+void GifFrameQueue::DecodeLoop()
+{
+	while (true) {
+		{
+			std::unique_lock<std::mutex> lock(m_Mutex);
+			m_QueueChanged.wait(lock, [this]() { return m_IsStopping || m_Frames.size() < m_MaxQueuedFrames; });
+			if (m_IsStopping) {
+				return;
+			}
+		}
+		std::shared_ptr<GIF_FRAME> pFrame;
+		HRESULT hr = m_pDecoder->DecodeNextFrame(&pFrame);
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			if (FAILED(hr)) {
+				m_DecodeResult = hr;
+			}
+			else {
+				m_Frames.push_back(pFrame);
+			}
+		}
+		m_QueueChanged.notify_all();
+		if (FAILED(hr)) {
+			return;
+		}
+	}
+}
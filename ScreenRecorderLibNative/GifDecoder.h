@@ -0,0 +1,226 @@
+#pragma once
+#include <Windows.h>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <deque>
+#include <thread>
+#include <condition_variable>
+
+//
+// GIF decoding and composition on the CPU, without WIC or D2D.
+// Frames are composed on a canvas the size of the logical screen, applying the transparency and disposal of each frame,
+// and handed out as 32bpp BGRA buffers. GIF colors are either opaque or fully transparent, so the buffers are valid as both
+// straight and premultiplied alpha. Transparent pixels are 0x00000000.
+// https://www.w3.org/Graphics/GIF/spec-gif89a.txt
+//
+
+#define GIF_DISPOSAL_UNDEFINED 0
+#define GIF_DISPOSAL_NONE 1
+#define GIF_DISPOSAL_BACKGROUND 2
+#define GIF_DISPOSAL_PREVIOUS 3
+
+//
+// Streaming decoder for the variable length LZW codes of a GIF image. The compressed data can be written in pieces of any size,
+// typically one data sub-block at a time, and codes spanning two pieces are handled.
+//
+class GifLzwDecoder
+{
+public:
+	GifLzwDecoder();
+	/// <summary>
+	/// Prepares for a new image, decoding into the given buffer of color indices.
+	/// </summary>
+	/// <param name="minimumCodeSize">The LZW minimum code size that precedes the image data.</param>
+	HRESULT Begin(_In_ BYTE minimumCodeSize, _Out_writes_(outputSize) BYTE *pOutput, _In_ size_t outputSize);
+	/// <summary>
+	/// Decodes the next piece of compressed data. Returns S_FALSE once the end of information code is read or the output is full,
+	/// and E_FAIL if the data is corrupt. The indices decoded before an error are kept.
+	/// </summary>
+	HRESULT Write(_In_reads_bytes_(size) const BYTE *pData, _In_ size_t size);
+	/// <summary>
+	/// Returns the number of color indices written to the output so far.
+	/// </summary>
+	size_t GetDecodedCount() { return m_OutputPosition; }
+	bool IsComplete() { return m_IsComplete; }
+private:
+	static const UINT MAX_CODE_SIZE = 12;
+	static const UINT MAX_CODES = 1 << MAX_CODE_SIZE;
+	static const UINT16 NO_CODE = 0xFFFF;
+
+	HRESULT ProcessCode(_In_ UINT16 code);
+	void OutputString(_In_ UINT16 code);
+	void ResetTable();
+
+	// For each code, the code of the string without its last byte, the last byte and the first byte of the string and its length.
+	UINT16 m_Prefix[MAX_CODES];
+	BYTE m_Suffix[MAX_CODES];
+	BYTE m_FirstByte[MAX_CODES];
+	UINT16 m_Length[MAX_CODES];
+
+	UINT m_MinimumCodeSize;
+	UINT m_ClearCode;
+	UINT m_CodeSize;
+	UINT m_NextCode;
+	UINT16 m_PreviousCode;
+	UINT32 m_BitBuffer;
+	UINT m_BitCount;
+	bool m_IsComplete;
+
+	BYTE *m_pOutput;
+	size_t m_OutputSize;
+	size_t m_OutputPosition;
+};
+
+struct GIF_FRAME {
+	// Index of the frame in the file
+	UINT Index;
+	// Delay until the next frame, as stored in the file. Many GIFs use a delay of 0 and rely on the player to pick a sensible minimum.
+	UINT DelayMillis;
+	UINT Width;
+	UINT Height;
+	// The composed frame, Width*Height pixels with no row padding
+	std::vector<UINT> Pixels;
+};
+
+//
+// Recycles frame buffers of a fixed size. Frames are returned to the pool when the last reference to them is released,
+// so decoding an animation in a loop allocates only as many buffers as are in use at the same time.
+// Frames may outlive the pool, and it is safe to release them on any thread.
+//
+class GifFramePool
+{
+public:
+	GifFramePool();
+	void Initialize(_In_ UINT width, _In_ UINT height);
+	std::shared_ptr<GIF_FRAME> Acquire();
+	/// <summary>
+	/// Returns the number of frame buffers allocated since the pool was initialized.
+	/// </summary>
+	UINT GetAllocatedFrameCount();
+private:
+	struct POOL_STATE {
+		std::mutex Mutex;
+		std::vector<std::unique_ptr<GIF_FRAME>> FreeFrames;
+	};
+	std::shared_ptr<POOL_STATE> m_State;
+	UINT m_Width;
+	UINT m_Height;
+	UINT m_AllocatedFrameCount;
+};
+
+/// <summary>
+/// Writes a row of color indices to the canvas using a palette of 256 BGRA colors. Palette entries with an alpha of zero are transparent,
+/// and leave the canvas pixel unchanged.
+/// </summary>
+void ExpandGifPixels(_In_reads_(count) const BYTE *pIndices, _In_reads_(256) const UINT *pPalette, _Inout_updates_(count) UINT *pCanvas, _In_ UINT count);
+/// <summary>
+/// Scalar reference implementation of ExpandGifPixels. ExpandGifPixels uses SSE2 or NEON where available, and must produce identical output.
+/// </summary>
+void ExpandGifPixelsScalar(_In_reads_(count) const BYTE *pIndices, _In_reads_(256) const UINT *pPalette, _Inout_updates_(count) UINT *pCanvas, _In_ UINT count);
+
+//
+// Decodes and composes the frames of a GIF held in memory.
+// Decoding is sequential: after the last frame, the next frame is the first frame again, composed from a clear canvas.
+//
+class GifDecoder
+{
+public:
+	GifDecoder();
+	/// <summary>
+	/// Reads the global information of the GIF and the position of each frame. Returns E_FAIL if the data is not a GIF or has no frames.
+	/// </summary>
+	HRESULT Open(_In_ std::vector<BYTE> data);
+	/// <summary>
+	/// Composes the next frame into a buffer from the frame pool.
+	/// </summary>
+	HRESULT DecodeNextFrame(_Out_ std::shared_ptr<GIF_FRAME> *ppFrame);
+	/// <summary>
+	/// Restarts decoding from the first frame.
+	/// </summary>
+	void Reset();
+
+	UINT GetWidth() { return m_Width; }
+	UINT GetHeight() { return m_Height; }
+	UINT GetFrameCount() { return static_cast<UINT>(m_Frames.size()); }
+	/// <summary>
+	/// Returns true if the GIF has a NETSCAPE2.0 or ANIMEXTS1.0 looping extension. A loop count of 0 means the animation loops forever.
+	/// </summary>
+	bool HasLoopCount() { return m_HasLoopCount; }
+	UINT GetLoopCount() { return m_LoopCount; }
+	GifFramePool &GetFramePool() { return m_FramePool; }
+private:
+	struct GIF_FRAME_DESC {
+		UINT Left;
+		UINT Top;
+		UINT Width;
+		UINT Height;
+		bool IsInterlaced;
+		// Offset of the local color table in the data, or 0 to use the global color table
+		size_t ColorTableOffset;
+		UINT ColorTableSize;
+		// Offset of the LZW minimum code size, which is followed by the image data sub-blocks
+		size_t ImageDataOffset;
+		// Transparent color index, or -1 if the frame has no transparency
+		INT TransparentIndex;
+		UINT Disposal;
+		UINT DelayMillis;
+	};
+
+	HRESULT ReadFrames();
+	HRESULT SkipSubBlocks(_Inout_ size_t *pOffset);
+	HRESULT DecodeIndices(_In_ const GIF_FRAME_DESC &frame);
+	void BuildPalette(_In_ const GIF_FRAME_DESC &frame);
+	void DrawIndices(_In_ const GIF_FRAME_DESC &frame);
+	void ClearCanvasRect(_In_ const GIF_FRAME_DESC &frame);
+
+	std::vector<BYTE> m_Data;
+	std::vector<GIF_FRAME_DESC> m_Frames;
+	UINT m_Width;
+	UINT m_Height;
+	size_t m_GlobalColorTableOffset;
+	UINT m_GlobalColorTableSize;
+	bool m_HasLoopCount;
+	UINT m_LoopCount;
+
+	GifLzwDecoder m_LzwDecoder;
+	GifFramePool m_FramePool;
+	UINT m_NextFrameIndex;
+	std::vector<BYTE> m_Indices;
+	UINT m_Palette[256];
+	std::vector<UINT> m_Canvas;
+	// Copy of the canvas before the previous frame was drawn, for frames with the restore to previous disposal method
+	std::vector<UINT> m_SavedCanvas;
+};
+
+//
+// Decodes frames of a GifDecoder on a background thread, keeping a number of frames ready ahead of playback.
+//
+class GifFrameQueue
+{
+public:
+	GifFrameQueue();
+	~GifFrameQueue();
+	/// <summary>
+	/// Starts decoding. The decoder must not be used by anyone else until the queue is stopped.
+	/// </summary>
+	/// <param name="maxQueuedFrames">The maximum number of decoded frames waiting to be taken from the queue.</param>
+	HRESULT Start(_In_ GifDecoder *pDecoder, _In_ UINT maxQueuedFrames);
+	/// <summary>
+	/// Waits for the next frame to be decoded and removes it from the queue. Returns the decoding error if decoding failed,
+	/// and E_ABORT if the queue is stopped.
+	/// </summary>
+	HRESULT GetNextFrame(_Out_ std::shared_ptr<GIF_FRAME> *ppFrame);
+	void Stop();
+private:
+	void DecodeLoop();
+
+	GifDecoder *m_pDecoder;
+	UINT m_MaxQueuedFrames;
+	std::thread m_DecodeThread;
+	std::mutex m_Mutex;
+	std::condition_variable m_QueueChanged;
+	std::deque<std::shared_ptr<GIF_FRAME>> m_Frames;
+	HRESULT m_DecodeResult;
+	bool m_IsStopping;
+};
@@ -1,33 +1,33 @@
 #include "GifReader.h"
 #include "Cleanup.h"
+#include "TexturePool.h"
 
 using namespace std;
 
 GifReader::GifReader()
 	:
-	m_RenderTarget(nullptr),
 	m_RenderTexture(nullptr),
-	m_pD2DFactory(nullptr),
-	m_pFrameComposeRT(nullptr),
-	m_pRawFrame(nullptr),
-	m_pSavedFrame(nullptr),
-	m_pIWICFactory(nullptr),
-	m_pDecoder(nullptr),
+	m_Decoder(),
+	m_FrameQueue(),
+	m_MediaKey{},
+	m_SharedMedia(nullptr),
+	m_DecodedFrames{},
+	m_IsSharingDecodedFrames(false),
 	m_FramerateTimer(nullptr),
 	m_LastSampleReceivedTimeStamp{ 0 },
 	m_cxGifImage(0),
 	m_cyGifImage(0),
-	m_backgroundColor(D2D1::ColorF(0, 0.f)),
 	m_cFrames(0),
-	m_cxGifImagePixel(0),
-	m_cyGifImagePixel(0),
 	m_fHasLoop(false),
 	m_uLoopNumber(0),
 	m_uNextFrameIndex(0),
 	m_uTotalLoopCount(0),
-	m_uFrameDisposal(0),
 	m_uFrameDelay(0),
-	m_framePosition{}
+	m_ComposedFrameCache{},
+	m_IsFrameCacheEnabled(true),
+	m_IsFrameCacheComplete(false),
+	m_uNextCachedFrameIndex(0),
+	m_CurrentFrame(nullptr)
 {
 	InitializeCriticalSection(&m_CriticalSection);
 	m_NewFrameEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
@@ -36,13 +36,7 @@ GifReader::GifReader()
 GifReader::~GifReader()
 {
 	StopCapture();
-	SafeRelease(&m_RenderTarget);
-	SafeRelease(&m_pD2DFactory);
-	SafeRelease(&m_pFrameComposeRT);
-	SafeRelease(&m_pRawFrame);
-	SafeRelease(&m_pSavedFrame);
-	SafeRelease(&m_pIWICFactory);
-	SafeRelease(&m_pDecoder);
+	ClearFrameCache();
 	SafeRelease(&m_RenderTexture);
 	SafeRelease(&m_Device);
 	SafeRelease(&m_DeviceContext);
@@ -95,8 +89,10 @@ HRESULT GifReader::StopCapture()
 		if (FAILED(hr)) {
 			return hr;
 		}
-		m_CaptureTask.wait();
 	}
+	//Release the capture loop if it is waiting for a frame to be decoded
+	m_FrameQueue.Stop();
+	m_CaptureTask.wait();
 	return S_OK;
 }
 
@@ -112,18 +108,24 @@ HRESULT GifReader::AcquireNextFrame(_In_ DWORD timeoutMillis, _Outptr_opt_ ID3D1
 		if (ppFrame) {
 			EnterCriticalSection(&m_CriticalSection);
 			LeaveCriticalSectionOnExit leaveCriticalSection(&m_CriticalSection, L"GetFrameBuffer");
-			CComPtr<ID3D11Texture2D> pStagingTexture = nullptr;
-			D3D11_TEXTURE2D_DESC desc;
-			m_RenderTexture->GetDesc(&desc);
-			desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
-			desc.MiscFlags = 0;
-			desc.Usage = D3D11_USAGE_DEFAULT;
-
-			RETURN_ON_BAD_HR(hr = m_Device->CreateTexture2D(&desc, nullptr, &pStagingTexture));
-
-			m_DeviceContext->CopyResource(pStagingTexture, m_RenderTexture);
-			*ppFrame = pStagingTexture;
-			(*ppFrame)->AddRef();
+			if (m_CurrentFrame) {
+				//Cached frames are never modified, so they can be handed out directly.
+				*ppFrame = m_CurrentFrame;
+				(*ppFrame)->AddRef();
+			}
+			else {
+				//The render texture is overwritten by the next frame, so a copy is handed out.
+				//The pool does not reuse the copy while the caller still holds it.
+				D3D11_TEXTURE2D_DESC desc;
+				m_RenderTexture->GetDesc(&desc);
+				desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+				desc.MiscFlags = 0;
+				desc.Usage = D3D11_USAGE_DEFAULT;
+				CComPtr<ID3D11Texture2D> pFrameCopy;
+				RETURN_ON_BAD_HR(hr = TexturePool::Shared().Acquire(m_Device, desc, &pFrameCopy));
+				m_DeviceContext->CopyResource(pFrameCopy, m_RenderTexture);
+				*ppFrame = pFrameCopy.Detach();
+			}
 			QueryPerformanceCounter(&m_LastGrabTimeStamp);
 		}
 	}
@@ -185,22 +187,7 @@ HRESULT GifReader::WriteNextFrameToSharedSurface(_In_ DWORD timeoutMillis, _Inou
 	long right = left + MakeEven(frameDesc.Width);
 	long bottom = top + MakeEven(frameDesc.Height);
 
-	D3D11_BOX Box{};
-	// Copy back to shared surface
-	Box.right = right - left;
-	Box.bottom = bottom - top;
-	Box.back = 1;
-
-	CComPtr<ID3D11Texture2D> pBlankFrame;
-	D3D11_TEXTURE2D_DESC desc;
-	pSharedSurf->GetDesc(&desc);
-	desc.MiscFlags = 0;
-	desc.Width = right - left;
-	desc.Height = bottom - top;
-	hr = m_Device->CreateTexture2D(&desc, nullptr, &pBlankFrame);
-	if (SUCCEEDED(hr)) {
-		m_DeviceContext->CopySubresourceRegion(pSharedSurf, 0, left, top, 0, pBlankFrame, 0, &Box);
-	}
+	hr = m_TextureManager->BlankTexture(pSharedSurf, RECT{ left,top,right,bottom });
 	m_TextureManager->DrawTexture(pSharedSurf, pProcessedTexture, RECT{ left,top,right,bottom });
 	SendBitmapCallback(pProcessedTexture);
 	return hr;
@@ -223,103 +210,127 @@ void GifReader::ResetGifState()
 {
 	// Reset the states
 	m_uNextFrameIndex = 0;
-	m_uFrameDisposal = DM_NONE;  // No previous frame, use disposal none
 	m_uLoopNumber = 0;
 	m_fHasLoop = FALSE;
+	m_DecodedFrames.clear();
+	m_IsSharingDecodedFrames = false;
+	ClearFrameCache();
 }
 
-HRESULT GifReader::InitializeDecoder(_In_ std::wstring source)
+void GifReader::ClearFrameCache()
 {
-	HRESULT hr = E_FAIL;
+	m_ComposedFrameCache.clear();
+	m_IsFrameCacheEnabled = true;
+	m_IsFrameCacheComplete = false;
+	m_uNextCachedFrameIndex = 0;
+	m_CurrentFrame.Release();
+}
 
-	ResetGifState();
-	SafeRelease(&m_pSavedFrame);
+static HRESULT ReadFileToBuffer(_In_ std::wstring filePath, _Out_ std::vector<BYTE> *pBuffer)
+{
+	FILE *stream;
+	_wfopen_s(&stream, filePath.c_str(), L"rb");
+	if (!stream) {
+		LOG_ERROR(L"Failed to open GIF file %ls", filePath.c_str());
+		return E_FAIL;
+	}
+	ExecuteFuncOnExit closeFileOnExit([&]() {
+		fclose(stream);
+	});
+	fseek(stream, 0, SEEK_END);
+	long size = ftell(stream);
+	fseek(stream, 0, SEEK_SET);
+	if (size < 0) {
+		return E_FAIL;
+	}
+	pBuffer->resize(size);
+	pBuffer->resize(fread(pBuffer->data(), 1, size, stream));
+	return S_OK;
+}
 
-	if (!m_pD2DFactory) {
-		// Create D2D factory
-		RETURN_ON_BAD_HR(hr = D2D1CreateFactory(D2D1_FACTORY_TYPE_SINGLE_THREADED, __uuidof(ID2D1Factory), (void **)&m_pD2DFactory));
-	}
-	if (!m_pIWICFactory) {
-		// Create WIC factory
-		RETURN_ON_BAD_HR(hr = CoCreateInstance(
-			CLSID_WICImagingFactory,
-			NULL,
-			CLSCTX_INPROC_SERVER,
-			IID_PPV_ARGS(&m_pIWICFactory)));
+static HRESULT ReadStreamToBuffer(_In_ IStream *pStream, _Out_ std::vector<BYTE> *pBuffer)
+{
+	HRESULT hr;
+	STATSTG stat;
+	RETURN_ON_BAD_HR(hr = pStream->Stat(&stat, STATFLAG_NONAME));
+	if (stat.cbSize.QuadPart > MAXDWORD) {
+		return E_OUTOFMEMORY;
+	}
+	LARGE_INTEGER li = { 0 };
+	RETURN_ON_BAD_HR(hr = pStream->Seek(li, STREAM_SEEK_SET, nullptr));
+	pBuffer->resize(static_cast<size_t>(stat.cbSize.QuadPart));
+	ULONG count = 0;
+	RETURN_ON_BAD_HR(hr = pStream->Read(pBuffer->data(), static_cast<ULONG>(pBuffer->size()), &count));
+	pBuffer->resize(count);
+	pStream->Seek(li, STREAM_SEEK_SET, nullptr);
+	return S_OK;
+}
 
-	}
+HRESULT GifReader::InitializeDecoder(_In_ std::wstring source)
+{
+	HRESULT hr;
+	DECODED_MEDIA_KEY key;
+	RETURN_ON_BAD_HR(hr = DecodedMediaCache::GetMediaKey(source, &key));
+	std::shared_ptr<const DECODED_MEDIA> pMedia = DecodedMediaCache::Shared().Find(key);
+	if (pMedia) {
+		return InitializeDecoder(key, pMedia);
+	}
+	std::vector<BYTE> data;
+	RETURN_ON_BAD_HR(hr = ReadFileToBuffer(source, &data));
+	return InitializeDecoder(key, std::move(data));
+}
 
-	// Create a decoder for the gif file
-	SafeRelease(&m_pDecoder);
-	hr = m_pIWICFactory->CreateDecoderFromFilename(
-		source.c_str(),
-		NULL,
-		GENERIC_READ,
-		WICDecodeMetadataCacheOnLoad,
-		&m_pDecoder);
-	if (SUCCEEDED(hr))
-	{
-		hr = GetGlobalMetadata();
-	}
+HRESULT GifReader::InitializeDecoder(_In_ IStream *pSourceStream)
+{
+	HRESULT hr;
+	DECODED_MEDIA_KEY key;
+	RETURN_ON_BAD_HR(hr = DecodedMediaCache::GetMediaKey(pSourceStream, &key));
+	std::shared_ptr<const DECODED_MEDIA> pMedia = DecodedMediaCache::Shared().Find(key);
+	if (pMedia) {
+		return InitializeDecoder(key, pMedia);
+	}
+	std::vector<BYTE> data;
+	RETURN_ON_BAD_HR(hr = ReadStreamToBuffer(pSourceStream, &data));
+	return InitializeDecoder(key, std::move(data));
+}
 
+HRESULT GifReader::InitializeDecoder(_In_ const DECODED_MEDIA_KEY &key, _In_ std::vector<BYTE> data)
+{
+	HRESULT hr;
+	std::shared_ptr<DECODED_MEDIA> pMedia = std::make_shared<DECODED_MEDIA>();
+	pMedia->GifData = std::move(data);
+	RETURN_ON_BAD_HR(hr = InitializeDecoder(key, std::shared_ptr<const DECODED_MEDIA>(pMedia)));
+	//Nobody else has the media until it is added to the cache
+	pMedia->Width = m_cxGifImage;
+	pMedia->Height = m_cyGifImage;
+	DecodedMediaCache::Shared().Insert(key, pMedia);
 	return hr;
 }
 
-HRESULT GifReader::InitializeDecoder(_In_ IStream *pSourceStream)
+HRESULT GifReader::InitializeDecoder(_In_ const DECODED_MEDIA_KEY &key, _In_ std::shared_ptr<const DECODED_MEDIA> pMedia)
 {
-	HRESULT hr = E_FAIL;
-
+	HRESULT hr;
+	//The decoder is used by the frame queue until it is stopped.
+	m_FrameQueue.Stop();
 	ResetGifState();
-	SafeRelease(&m_pSavedFrame);
-
-	if (!m_pD2DFactory) {
-		// Create D2D factory
-		RETURN_ON_BAD_HR(hr = D2D1CreateFactory(D2D1_FACTORY_TYPE_SINGLE_THREADED, __uuidof(ID2D1Factory), (void **)&m_pD2DFactory));
-	}
-	if (!m_pIWICFactory) {
-		// Create WIC factory
-		RETURN_ON_BAD_HR(hr = CoCreateInstance(
-			CLSID_WICImagingFactory,
-			NULL,
-			CLSCTX_INPROC_SERVER,
-			IID_PPV_ARGS(&m_pIWICFactory)));
-
-	}
-
-	// Create a decoder for the gif file
-	SafeRelease(&m_pDecoder);
-	hr = m_pIWICFactory->CreateDecoderFromStream(
-		pSourceStream,
-		NULL,
-		WICDecodeMetadataCacheOnLoad,
-		&m_pDecoder);
-	if (SUCCEEDED(hr))
-	{
-		hr = GetGlobalMetadata();
-	}
-
+	m_MediaKey = key;
+	m_SharedMedia = pMedia;
+	//Opening only reads the position of each frame. The frames are decoded by the frame queue, unless they are cached.
+	RETURN_ON_BAD_HR(hr = m_Decoder.Open(pMedia->GifData));
+	m_cFrames = m_Decoder.GetFrameCount();
+	m_cxGifImage = m_Decoder.GetWidth();
+	m_cyGifImage = m_Decoder.GetHeight();
+	// If the loop count is 0, we repeat infinitely
+	m_uTotalLoopCount = m_Decoder.GetLoopCount();
+	m_fHasLoop = m_Decoder.HasLoopCount() && m_uTotalLoopCount != 0;
 	return hr;
 }
 
 HRESULT GifReader::CreateDeviceResources()
 {
 	HRESULT hr = S_OK;
-
-
-	if (m_RenderTarget == NULL)
+	if (m_RenderTexture == NULL)
 	{
-		// Create the DXGI Surface Render Target.
-		UINT dpi = GetSystemDpi();
-		/* RenderTargetProperties contains the description for render target */
-		D2D1_RENDER_TARGET_PROPERTIES RenderTargetProperties =
-			D2D1::RenderTargetProperties(
-				D2D1_RENDER_TARGET_TYPE_DEFAULT,
-				D2D1::PixelFormat(DXGI_FORMAT_UNKNOWN, D2D1_ALPHA_MODE_PREMULTIPLIED),
-				static_cast<float>(dpi),
-				static_cast<float>(dpi)
-			);
-
-
 		D3D11_TEXTURE2D_DESC desc = { 0 };
 		desc.MipLevels = 1;
 		desc.ArraySize = 1;
@@ -327,640 +338,178 @@ HRESULT GifReader::CreateDeviceResources()
 		desc.SampleDesc.Count = 1;
 		desc.SampleDesc.Quality = 0;
 		desc.Usage = D3D11_USAGE_DEFAULT;
-		desc.BindFlags = D3D11_BIND_RENDER_TARGET;
-		desc.Width = m_cxGifImagePixel;
-		desc.Height = m_cyGifImagePixel;
+		desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+		desc.Width = m_cxGifImage;
+		desc.Height = m_cyGifImage;
 		RETURN_ON_BAD_HR(hr = m_Device->CreateTexture2D(&desc, nullptr, &m_RenderTexture));
-
-		ATL::CComPtr<IDXGISurface> pSharedSurface;
-		RETURN_ON_BAD_HR(hr = m_RenderTexture->QueryInterface(__uuidof(IDXGISurface), (void **)&pSharedSurface));
-		RETURN_ON_BAD_HR(hr = m_pD2DFactory->CreateDxgiSurfaceRenderTarget(pSharedSurface, RenderTargetProperties, &m_RenderTarget));
-
-		if (SUCCEEDED(hr))
-		{
-			SafeRelease(&m_pFrameComposeRT);
-			hr = m_RenderTarget->CreateCompatibleRenderTarget(
-				D2D1::SizeF(
-					static_cast<FLOAT>(m_cxGifImage),
-					static_cast<FLOAT>(m_cyGifImage)),
-				&m_pFrameComposeRT);
-		}
 	}
 	return hr;
 }
 
-HRESULT GifReader::GetGlobalMetadata()
+void GifReader::ShowDecodedFrame(_In_ const GIF_FRAME &frame)
 {
-	PROPVARIANT propValue;
-	PropVariantInit(&propValue);
-	IWICMetadataQueryReader *pMetadataQueryReader = NULL;
-
-	// Get the frame count
-	HRESULT hr = m_pDecoder->GetFrameCount(&m_cFrames);
-	if (SUCCEEDED(hr))
-	{
-		// Create a MetadataQueryReader from the decoder
-		hr = m_pDecoder->GetMetadataQueryReader(
-			&pMetadataQueryReader);
-	}
-
-	if (SUCCEEDED(hr))
-	{
-		// Get background color
-		if (FAILED(GetBackgroundColor(pMetadataQueryReader)))
-		{
-			// Default to transparent if failed to get the color
-			m_backgroundColor = D2D1::ColorF(0, 0.f);
-		}
-	}
-
-	// Get global frame size
-	if (SUCCEEDED(hr))
-	{
-		// Get width
-		hr = pMetadataQueryReader->GetMetadataByName(
-			L"/logscrdesc/Width",
-			&propValue);
-		if (SUCCEEDED(hr))
-		{
-			hr = (propValue.vt == VT_UI2 ? S_OK : E_FAIL);
-			if (SUCCEEDED(hr))
-			{
-				m_cxGifImage = propValue.uiVal;
-			}
-			PropVariantClear(&propValue);
-		}
-	}
-
-	if (SUCCEEDED(hr))
-	{
-		// Get height
-		hr = pMetadataQueryReader->GetMetadataByName(
-			L"/logscrdesc/Height",
-			&propValue);
-		if (SUCCEEDED(hr))
-		{
-			hr = (propValue.vt == VT_UI2 ? S_OK : E_FAIL);
-			if (SUCCEEDED(hr))
-			{
-				m_cyGifImage = propValue.uiVal;
-			}
-			PropVariantClear(&propValue);
-		}
-	}
-
-	if (SUCCEEDED(hr))
+	// If starting a new animation loop, increase loop count
+	if (frame.Index == 0)
 	{
-		// Get pixel aspect ratio
-		hr = pMetadataQueryReader->GetMetadataByName(
-			L"/logscrdesc/PixelAspectRatio",
-			&propValue);
-		if (SUCCEEDED(hr))
-		{
-			hr = (propValue.vt == VT_UI1 ? S_OK : E_FAIL);
-			if (SUCCEEDED(hr))
-			{
-				UINT uPixelAspRatio = propValue.bVal;
-
-				if (uPixelAspRatio != 0)
-				{
-					// Need to calculate the ratio. The value in uPixelAspRatio 
-					// allows specifying widest pixel 4:1 to the tallest pixel of 
-					// 1:4 in increments of 1/64th
-					FLOAT pixelAspRatio = (uPixelAspRatio + 15.f) / 64.f;
-
-					// Calculate the image width and height in pixel based on the
-					// pixel aspect ratio. Only shrink the image.
-					if (pixelAspRatio > 1.f)
-					{
-						m_cxGifImagePixel = m_cxGifImage;
-						m_cyGifImagePixel = static_cast<UINT>(m_cyGifImage / pixelAspRatio);
-					}
-					else
-					{
-						m_cxGifImagePixel = static_cast<UINT>(m_cxGifImage * pixelAspRatio);
-						m_cyGifImagePixel = m_cyGifImage;
-					}
-				}
-				else
-				{
-					// The value is 0, so its ratio is 1
-					m_cxGifImagePixel = m_cxGifImage;
-					m_cyGifImagePixel = m_cyGifImage;
-				}
-			}
-			PropVariantClear(&propValue);
-		}
+		m_uLoopNumber++;
 	}
-
-	// Get looping information
-	if (SUCCEEDED(hr))
+	m_uNextFrameIndex = (frame.Index + 1) % m_cFrames;
+	m_uFrameDelay = frame.DelayMillis;
+	// Insert an artificial delay to ensure rendering for gif with very small
+	// or 0 delay.  This delay number is picked to match with most browsers' 
+	// gif display speed.
+	if (m_uFrameDelay < 20)
 	{
-		// First check to see if the application block in the Application Extension
-		// contains "NETSCAPE2.0" and "ANIMEXTS1.0", which indicates the gif animation
-		// has looping information associated with it.
-		// 
-		// If we fail to get the looping information, loop the animation infinitely.
-		if (SUCCEEDED(pMetadataQueryReader->GetMetadataByName(
-			L"/appext/application",
-			&propValue)) &&
-			propValue.vt == (VT_UI1 | VT_VECTOR) &&
-			propValue.caub.cElems == 11 &&  // Length of the application block
-			(!memcmp(propValue.caub.pElems, "NETSCAPE2.0", propValue.caub.cElems) ||
-				!memcmp(propValue.caub.pElems, "ANIMEXTS1.0", propValue.caub.cElems)))
-		{
-			PropVariantClear(&propValue);
-
-			hr = pMetadataQueryReader->GetMetadataByName(L"/appext/data", &propValue);
-			if (SUCCEEDED(hr))
-			{
-				//  The data is in the following format:
-				//  byte 0: extsize (must be > 1)
-				//  byte 1: loopType (1 == animated gif)
-				//  byte 2: loop count (least significant byte)
-				//  byte 3: loop count (most significant byte)
-				//  byte 4: set to zero
-				if (propValue.vt == (VT_UI1 | VT_VECTOR) &&
-					propValue.caub.cElems >= 4 &&
-					propValue.caub.pElems[0] > 0 &&
-					propValue.caub.pElems[1] == 1)
-				{
-					m_uTotalLoopCount = MAKEWORD(propValue.caub.pElems[2],
-						propValue.caub.pElems[3]);
-
-					// If the total loop count is not zero, we then have a loop count
-					// If it is 0, then we repeat infinitely
-					if (m_uTotalLoopCount != 0)
-					{
-						m_fHasLoop = TRUE;
-					}
-				}
-			}
-		}
+		m_uFrameDelay = 90;
 	}
-
-	PropVariantClear(&propValue);
-	SafeRelease(&pMetadataQueryReader);
-	return hr;
+	m_DeviceContext->UpdateSubresource(m_RenderTexture, 0, nullptr, frame.Pixels.data(), frame.Width * 4, 0);
 }
 
-HRESULT GifReader::GetRawFrame(UINT uFrameIndex)
+HRESULT GifReader::StartCaptureLoop()
 {
-	IWICFormatConverter *pConverter = NULL;
-	IWICBitmapFrameDecode *pWicFrame = NULL;
-	IWICMetadataQueryReader *pFrameMetadataQueryReader = NULL;
-
-	PROPVARIANT propValue;
-	PropVariantInit(&propValue);
-
-	// Retrieve the current frame
-	HRESULT hr = m_pDecoder->GetFrame(uFrameIndex, &pWicFrame);
-	if (SUCCEEDED(hr))
-	{
-		// Format convert to 32bppPBGRA which D2D expects
-		hr = m_pIWICFactory->CreateFormatConverter(&pConverter);
-	}
-
-	if (SUCCEEDED(hr))
-	{
-		hr = pConverter->Initialize(
-			pWicFrame,
-			GUID_WICPixelFormat32bppPBGRA,
-			WICBitmapDitherTypeNone,
-			NULL,
-			0.f,
-			WICBitmapPaletteTypeCustom);
-	}
-
-	if (SUCCEEDED(hr))
-	{
-		// Create a D2DBitmap from IWICBitmapSource
-		SafeRelease(&m_pRawFrame);
-		hr = m_RenderTarget->CreateBitmapFromWicBitmap(
-			pConverter,
-			NULL,
-			&m_pRawFrame);
+	HRESULT hr;
+	if (m_SharedMedia->GifFrames.empty()) {
+		RETURN_ON_BAD_HR(hr = m_FrameQueue.Start(&m_Decoder, GIF_DECODE_AHEAD_FRAMES));
+		//The frames decoded by the first reader of a GIF are shared with later readers, if they fit in the same budget as the composed frame cache.
+		m_IsSharingDecodedFrames = static_cast<UINT64>(m_cFrames) * m_cxGifImage * m_cyGifImage * 4 <= GIF_FRAME_CACHE_BUDGET_BYTES;
 	}
-
-	if (SUCCEEDED(hr))
-	{
-		// Get Metadata Query Reader from the frame
-		hr = pWicFrame->GetMetadataQueryReader(&pFrameMetadataQueryReader);
+	else {
+		LOG_DEBUG(L"Playing %zu GIF frames from the decoded media cache", m_SharedMedia->GifFrames.size());
 	}
-
-	// Get the Metadata for the current frame
-	if (SUCCEEDED(hr))
-	{
-		hr = pFrameMetadataQueryReader->GetMetadataByName(L"/imgdesc/Left", &propValue);
-		if (SUCCEEDED(hr))
-		{
-			hr = (propValue.vt == VT_UI2 ? S_OK : E_FAIL);
-			if (SUCCEEDED(hr))
-			{
-				m_framePosition.left = static_cast<FLOAT>(propValue.uiVal);
-			}
-			PropVariantClear(&propValue);
+	m_CaptureTask = concurrency::create_task([this]() {
+		if (!m_FramerateTimer) {
+			m_FramerateTimer = make_unique<HighresTimer>();
 		}
-	}
-
-	if (SUCCEEDED(hr))
-	{
-		hr = pFrameMetadataQueryReader->GetMetadataByName(L"/imgdesc/Top", &propValue);
-		if (SUCCEEDED(hr))
-		{
-			hr = (propValue.vt == VT_UI2 ? S_OK : E_FAIL);
-			if (SUCCEEDED(hr))
-			{
-				m_framePosition.top = static_cast<FLOAT>(propValue.uiVal);
-			}
-			PropVariantClear(&propValue);
+		if (m_IsFrameCacheEnabled
+			&& static_cast<UINT64>(m_cFrames) * m_cxGifImage * m_cyGifImage * 4 > GIF_FRAME_CACHE_BUDGET_BYTES) {
+			LOG_DEBUG(L"GIF with %u frames of %ux%u does not fit in the frame cache, frames are decoded on every loop", m_cFrames, m_cxGifImage, m_cyGifImage);
+			m_IsFrameCacheEnabled = false;
 		}
-	}
-
-	if (SUCCEEDED(hr))
-	{
-		hr = pFrameMetadataQueryReader->GetMetadataByName(L"/imgdesc/Width", &propValue);
-		if (SUCCEEDED(hr))
+		HRESULT hr;
+		do
 		{
-			hr = (propValue.vt == VT_UI2 ? S_OK : E_FAIL);
-			if (SUCCEEDED(hr))
-			{
-				m_framePosition.right = static_cast<FLOAT>(propValue.uiVal)
-					+ m_framePosition.left;
+			std::shared_ptr<const GIF_FRAME> pFrame;
+			if (!m_IsFrameCacheComplete) {
+				//Wait for the frame outside the critical section, so it does not block the frames being read
+				hr = GetNextFrame(&pFrame);
+				if (hr == E_ABORT) {
+					return;
+				}
+				else if (FAILED(hr)) {
+					LOG_ERROR(L"Failed to decode GIF frame: hr = 0x%08x", hr);
+					return;
+				}
 			}
-			PropVariantClear(&propValue);
-		}
-	}
-
-	if (SUCCEEDED(hr))
-	{
-		hr = pFrameMetadataQueryReader->GetMetadataByName(L"/imgdesc/Height", &propValue);
-		if (SUCCEEDED(hr))
-		{
-			hr = (propValue.vt == VT_UI2 ? S_OK : E_FAIL);
-			if (SUCCEEDED(hr))
-			{
-				m_framePosition.bottom = static_cast<FLOAT>(propValue.uiVal)
-					+ m_framePosition.top;
+			//Rendering uses the device, which may be shared with other sources
+			if (m_DeviceCriticalSection) {
+				EnterCriticalSection(m_DeviceCriticalSection);
 			}
-			PropVariantClear(&propValue);
-		}
-	}
-
-	if (SUCCEEDED(hr))
-	{
-		// Get delay from the optional Graphic Control Extension
-		if (SUCCEEDED(pFrameMetadataQueryReader->GetMetadataByName(
-			L"/grctlext/Delay",
-			&propValue)))
-		{
-			hr = (propValue.vt == VT_UI2 ? S_OK : E_FAIL);
-			if (SUCCEEDED(hr))
-			{
-				// Convert the delay retrieved in 10 ms units to a delay in 1 ms units
-				hr = UIntMult(propValue.uiVal, 10, &m_uFrameDelay);
+			EnterCriticalSection(&m_CriticalSection);
+			if (m_IsFrameCacheComplete) {
+				ShowCachedFrame();
 			}
-			PropVariantClear(&propValue);
-		}
-		else
-		{
-			// Failed to get delay from graphic control extension. Possibly a
-			// single frame image (non-animated gif)
-			m_uFrameDelay = 0;
-		}
-
-		if (SUCCEEDED(hr))
-		{
-			// Insert an artificial delay to ensure rendering for gif with very small
-			// or 0 delay.  This delay number is picked to match with most browsers' 
-			// gif display speed.
-			//
-			// This will defeat the purpose of using zero delay intermediate frames in 
-			// order to preserve compatibility. If this is removed, the zero delay 
-			// intermediate frames will not be visible.
-			if (m_uFrameDelay < 20)
-			{
-				m_uFrameDelay = 90;
+			else {
+				ShowDecodedFrame(*pFrame);
+				if (m_IsFrameCacheEnabled) {
+					LOG_ON_BAD_HR(CacheComposedFrame());
+				}
 			}
-		}
-	}
-
-	if (SUCCEEDED(hr))
-	{
-		if (SUCCEEDED(pFrameMetadataQueryReader->GetMetadataByName(
-			L"/grctlext/Disposal",
-			&propValue)))
-		{
-			hr = (propValue.vt == VT_UI1) ? S_OK : E_FAIL;
-			if (SUCCEEDED(hr))
-			{
-				m_uFrameDisposal = propValue.bVal;
+			LeaveCriticalSection(&m_CriticalSection);
+			if (m_DeviceCriticalSection) {
+				LeaveCriticalSection(m_DeviceCriticalSection);
 			}
-		}
-		else
-		{
-			// Failed to get the disposal method, use default. Possibly a 
-			// non-animated gif.
-			m_uFrameDisposal = DM_UNDEFINED;
-		}
-	}
-
-	PropVariantClear(&propValue);
-
-	SafeRelease(&pConverter);
-	SafeRelease(&pWicFrame);
-	SafeRelease(&pFrameMetadataQueryReader);
-
-	return hr;
-}
-
-HRESULT GifReader::GetBackgroundColor(
-	IWICMetadataQueryReader *pMetadataQueryReader)
-{
-	DWORD dwBGColor;
-	BYTE backgroundIndex = 0;
-	WICColor rgColors[256];
-	UINT cColorsCopied = 0;
-	PROPVARIANT propVariant;
-	PropVariantInit(&propVariant);
-	IWICPalette *pWicPalette = NULL;
-
-	// If we have a global palette, get the palette and background color
-	HRESULT hr = pMetadataQueryReader->GetMetadataByName(
-		L"/logscrdesc/GlobalColorTableFlag",
-		&propVariant);
-	if (SUCCEEDED(hr))
-	{
-		hr = (propVariant.vt != VT_BOOL || !propVariant.boolVal) ? E_FAIL : S_OK;
-		PropVariantClear(&propVariant);
-	}
-
-	if (SUCCEEDED(hr))
-	{
-		// Background color index
-		hr = pMetadataQueryReader->GetMetadataByName(
-			L"/logscrdesc/BackgroundColorIndex",
-			&propVariant);
-		if (SUCCEEDED(hr))
-		{
-			hr = (propVariant.vt != VT_UI1) ? E_FAIL : S_OK;
-			if (SUCCEEDED(hr))
-			{
-				backgroundIndex = propVariant.bVal;
+			if (m_IsSharingDecodedFrames) {
+				ShareDecodedFrame(pFrame);
 			}
-			PropVariantClear(&propVariant);
-		}
-	}
-
-	// Get the color from the palette
-	if (SUCCEEDED(hr))
-	{
-		hr = m_pIWICFactory->CreatePalette(&pWicPalette);
-	}
-
-	if (SUCCEEDED(hr))
-	{
-		// Get the global palette
-		hr = m_pDecoder->CopyPalette(pWicPalette);
-	}
-
-	if (SUCCEEDED(hr))
-	{
-		hr = pWicPalette->GetColors(
-			ARRAYSIZE(rgColors),
-			rgColors,
-			&cColorsCopied);
-	}
-
-	if (SUCCEEDED(hr))
-	{
-		// Check whether background color is outside range 
-		hr = (backgroundIndex >= cColorsCopied) ? E_FAIL : S_OK;
-	}
-
-	if (SUCCEEDED(hr))
-	{
-		// Get the color in ARGB format
-		dwBGColor = rgColors[backgroundIndex];
-
-		// The background color is in ARGB format, and we want to 
-		// extract the alpha value and convert it in FLOAT
-		FLOAT alpha = (dwBGColor >> 24) / 255.f;
-		m_backgroundColor = D2D1::ColorF(dwBGColor, alpha);
-	}
-
-	SafeRelease(&pWicPalette);
-	return hr;
-}
-
-HRESULT GifReader::RestoreSavedFrame()
-{
-	HRESULT hr = S_OK;
-
-	ID2D1Bitmap *pFrameToCopyTo = NULL;
-
-	hr = m_pSavedFrame ? S_OK : E_FAIL;
-
-	if (SUCCEEDED(hr))
-	{
-		hr = m_pFrameComposeRT->GetBitmap(&pFrameToCopyTo);
-	}
-
-	if (SUCCEEDED(hr))
-	{
-		// Copy the whole bitmap
-		hr = pFrameToCopyTo->CopyFromBitmap(NULL, m_pSavedFrame, NULL);
-	}
-
-	SafeRelease(&pFrameToCopyTo);
-
-	return hr;
-}
-
-HRESULT GifReader::ClearCurrentFrameArea()
-{
-	m_pFrameComposeRT->BeginDraw();
-
-	// Clip the render target to the size of the raw frame
-	m_pFrameComposeRT->PushAxisAlignedClip(
-		&m_framePosition,
-		D2D1_ANTIALIAS_MODE_PER_PRIMITIVE);
-
-	m_pFrameComposeRT->Clear(NULL);//m_backgroundColor);
-
-	// Remove the clipping
-	m_pFrameComposeRT->PopAxisAlignedClip();
-
-	return m_pFrameComposeRT->EndDraw();
+			pFrame.reset();
+			if (m_IsFrameCacheComplete) {
+				//All frames are cached, so nothing more needs to be decoded
+				m_FrameQueue.Stop();
+			}
+			//Update timestamp and notify that there is a new sample available
+			QueryPerformanceCounter(&m_LastSampleReceivedTimeStamp);
+			SetEvent(m_NewFrameEvent);
+			hr = m_FramerateTimer->WaitFor(MillisToHundredNanos(m_uFrameDelay));
+			if (FAILED(hr)) {
+				LOG_ERROR(L"StartCaptureLoop wait for frame failed: hr = 0x%08x", hr);
+				return;
+			}
+		} while (!EndOfAnimation() && m_cFrames > 1);
+		});
+	return S_OK;
 }
 
-HRESULT GifReader::DisposeCurrentFrame()
+HRESULT GifReader::GetNextFrame(_Out_ std::shared_ptr<const GIF_FRAME> *ppFrame)
 {
-	HRESULT hr = S_OK;
-
-	switch (m_uFrameDisposal)
-	{
-		case DM_UNDEFINED:
-		case DM_NONE:
-			// We simply draw on the previous frames. Do nothing here.
-			break;
-		case DM_BACKGROUND:
-			// Dispose background
-			// Clear the area covered by the current raw frame with background color
-			hr = ClearCurrentFrameArea();
-			break;
-		case DM_PREVIOUS:
-			// Dispose previous
-			// We restore the previous composed frame first
-			hr = RestoreSavedFrame();
-			break;
-		default:
-			// Invalid disposal method
-			hr = E_FAIL;
+	if (!m_SharedMedia->GifFrames.empty()) {
+		*ppFrame = m_SharedMedia->GifFrames[m_uNextFrameIndex];
+		return S_OK;
 	}
-
+	std::shared_ptr<GIF_FRAME> pFrame;
+	HRESULT hr = m_FrameQueue.GetNextFrame(&pFrame);
+	*ppFrame = pFrame;
 	return hr;
 }
 
-HRESULT GifReader::OverlayNextFrame()
+void GifReader::ShareDecodedFrame(_In_ std::shared_ptr<const GIF_FRAME> pFrame)
 {
-	// Get Frame information
-	HRESULT hr = GetRawFrame(m_uNextFrameIndex);
-	if (SUCCEEDED(hr))
-	{
-		// For disposal 3 method, we would want to save a copy of the current
-		// composed frame
-		if (m_uFrameDisposal == DM_PREVIOUS)
-		{
-			hr = SaveComposedFrame();
-		}
-	}
-
-	if (SUCCEEDED(hr))
-	{
-		// Start producing the next bitmap
-		m_pFrameComposeRT->BeginDraw();
-
-		// If starting a new animation loop
-		if (m_uNextFrameIndex == 0)
-		{
-			// Draw background and increase loop count
-			m_pFrameComposeRT->Clear(NULL);//m_backgroundColor);
-			m_uLoopNumber++;
-		}
-
-		// Produce the next frame
-		m_pFrameComposeRT->DrawBitmap(
-			m_pRawFrame,
-			m_framePosition);
-
-		hr = m_pFrameComposeRT->EndDraw();
+	if (m_uLoopNumber != 1) {
+		m_IsSharingDecodedFrames = false;
+		m_DecodedFrames.clear();
+		return;
+	}
+	m_DecodedFrames.push_back(pFrame);
+	if (m_DecodedFrames.size() == m_cFrames) {
+		std::shared_ptr<DECODED_MEDIA> pMedia = std::make_shared<DECODED_MEDIA>(*m_SharedMedia);
+		pMedia->GifFrames = std::move(m_DecodedFrames);
+		DecodedMediaCache::Shared().Insert(m_MediaKey, pMedia);
+		m_SharedMedia = pMedia;
+		m_DecodedFrames.clear();
+		m_IsSharingDecodedFrames = false;
+		//The following loops are played from the shared frames
+		m_FrameQueue.Stop();
+		LOG_DEBUG(L"Added %u composed GIF frames to the decoded media cache", m_cFrames);
 	}
-
-	// To improve performance and avoid decoding/composing this frame in the 
-	// following animation loops, the composed frame can be cached here in system 
-	// or video memory.
-
-	if (SUCCEEDED(hr))
-	{
-		// Increase the frame index by 1
-		m_uNextFrameIndex = (++m_uNextFrameIndex) % m_cFrames;
-	}
-
-	return hr;
 }
 
-HRESULT GifReader::SaveComposedFrame()
+HRESULT GifReader::CacheComposedFrame()
 {
 	HRESULT hr = S_OK;
-
-	ID2D1Bitmap *pFrameToBeSaved = NULL;
-
-	hr = m_pFrameComposeRT->GetBitmap(&pFrameToBeSaved);
-	if (SUCCEEDED(hr))
-	{
-		// Create the temporary bitmap if it hasn't been created yet 
-		if (m_pSavedFrame == NULL)
-		{
-			D2D1_SIZE_U bitmapSize = pFrameToBeSaved->GetPixelSize();
-			D2D1_BITMAP_PROPERTIES bitmapProp;
-			pFrameToBeSaved->GetDpi(&bitmapProp.dpiX, &bitmapProp.dpiY);
-			bitmapProp.pixelFormat = pFrameToBeSaved->GetPixelFormat();
-
-			hr = m_pFrameComposeRT->CreateBitmap(
-				bitmapSize,
-				bitmapProp,
-				&m_pSavedFrame);
+	m_CurrentFrame.Release();
+	if (m_uLoopNumber == 1) {
+		D3D11_TEXTURE2D_DESC desc;
+		m_RenderTexture->GetDesc(&desc);
+		desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+		desc.MiscFlags = 0;
+		desc.Usage = D3D11_USAGE_DEFAULT;
+		CComPtr<ID3D11Texture2D> pCachedFrame;
+		hr = m_Device->CreateTexture2D(&desc, nullptr, &pCachedFrame);
+		if (FAILED(hr)) {
+			//Fall back to decoding every loop
+			m_IsFrameCacheEnabled = false;
+			m_ComposedFrameCache.clear();
+			return hr;
 		}
+		m_DeviceContext->CopyResource(pCachedFrame, m_RenderTexture);
+		m_ComposedFrameCache.push_back(COMPOSED_FRAME{ pCachedFrame, m_uFrameDelay });
+		m_CurrentFrame = pCachedFrame;
 	}
-
-	if (SUCCEEDED(hr))
-	{
-		// Copy the whole bitmap
-		hr = m_pSavedFrame->CopyFromBitmap(NULL, pFrameToBeSaved, NULL);
+	if (IsLastFrame() && !m_ComposedFrameCache.empty()) {
+		//The first loop is complete, so the remaining loops can be played from the cache.
+		m_IsFrameCacheComplete = true;
+		m_uNextCachedFrameIndex = 0;
+		LOG_DEBUG(L"Cached %zu composed GIF frames", m_ComposedFrameCache.size());
 	}
-
-	SafeRelease(&pFrameToBeSaved);
-
 	return hr;
 }
 
-HRESULT GifReader::StartCaptureLoop()
+void GifReader::ShowCachedFrame()
 {
-	m_CaptureTask = concurrency::create_task([this]() {
-		if (!m_FramerateTimer) {
-			m_FramerateTimer = make_unique<HighresTimer>();
-		}
-		do
-		{
-			EnterCriticalSection(&m_CriticalSection);
-			ComposeNextFrame();
-			CComPtr<ID2D1Bitmap> pFrameToRender = nullptr;
-			HRESULT hr = m_pFrameComposeRT->GetBitmap(&pFrameToRender);
-			if (SUCCEEDED(hr)) {
-				m_RenderTarget->BeginDraw();
-				m_RenderTarget->Clear(NULL);
-				m_RenderTarget->DrawBitmap(pFrameToRender);
-				m_RenderTarget->EndDraw();
-			}
-			LeaveCriticalSection(&m_CriticalSection);
-			//Update timestamp and notify that there is a new sample available
-			QueryPerformanceCounter(&m_LastSampleReceivedTimeStamp);
-			SetEvent(m_NewFrameEvent);
-			hr = m_FramerateTimer->WaitFor(MillisToHundredNanos(m_uFrameDelay));
-			if (FAILED(hr)) {
-				LOG_ERROR(L"StartCaptureLoop wait for frame failed: hr = 0x%08x", hr);
-				return;
-			}
-		} while (!EndOfAnimation() && m_cFrames > 1);
-		});
-	return S_OK;
-}
-
-HRESULT GifReader::ComposeNextFrame()
-{
-	HRESULT hr = S_OK;
-	// Check to see if the render targets are initialized
-	if (m_RenderTarget && m_pFrameComposeRT)
-	{
-		// Compose one frame
-		hr = DisposeCurrentFrame();
-		if (SUCCEEDED(hr))
-		{
-			hr = OverlayNextFrame();
-		}
-
-		// Keep composing frames until we see a frame with delay greater than
-		// 0 (0 delay frames are the invisible intermediate frames), or until
-		// we have reached the very last frame.
-		while (SUCCEEDED(hr) && m_uFrameDelay == 0 && !IsLastFrame())
-		{
-			hr = DisposeCurrentFrame();
-			if (SUCCEEDED(hr))
-			{
-				hr = OverlayNextFrame();
-			}
-		}
+	if (m_uNextCachedFrameIndex == 0) {
+		m_uLoopNumber++;
 	}
-	return hr;
+	COMPOSED_FRAME &frame = m_ComposedFrameCache[m_uNextCachedFrameIndex];
+	m_CurrentFrame = frame.Texture;
+	m_uFrameDelay = frame.DelayMillis;
+	m_uNextCachedFrameIndex = (m_uNextCachedFrameIndex + 1) % static_cast<UINT>(m_ComposedFrameCache.size());
 }
\ No newline at end of file
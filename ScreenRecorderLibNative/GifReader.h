@@ -1,6 +1,4 @@
 #pragma once
-#include <d2d1.h>
-#include <wincodec.h>
 #include <concrt.h>
 #include <ppltasks.h> 
 #include "CommonTypes.h"
@@ -8,6 +6,15 @@
 #include "HighresTimer.h"
 #include "CaptureBase.h"
 #include "TextureManager.h"
+#include "GifDecoder.h"
+#include "DecodedMediaCache.h"
+#include <vector>
+
+//Number of frames decoded ahead of playback on a background thread.
+#define GIF_DECODE_AHEAD_FRAMES 2
+
+//Maximum memory used to keep the composed frames of an animation, so later loops do not need to decode and compose them again.
+#define GIF_FRAME_CACHE_BUDGET_BYTES (64 * 1024 * 1024)
 
 	class GifReader : public CaptureBase
 	{
@@ -26,35 +33,46 @@
 		}
 		virtual inline std::wstring Name() override { return L"GifReader"; };
 	private:
-		enum DISPOSAL_METHODS
-		{
-			DM_UNDEFINED = 0,
-			DM_NONE = 1,
-			DM_BACKGROUND = 2,
-			DM_PREVIOUS = 3
-		};
 		HRESULT InitializeDecoder(_In_ std::wstring source);
 		HRESULT InitializeDecoder(_In_ IStream *pSourceStream);
+		/// <summary>
+		/// Adds a GIF that is not in the decoded media cache to the cache, and opens it.
+		/// </summary>
+		HRESULT InitializeDecoder(_In_ const DECODED_MEDIA_KEY &key, _In_ std::vector<BYTE> data);
+		HRESULT InitializeDecoder(_In_ const DECODED_MEDIA_KEY &key, _In_ std::shared_ptr<const DECODED_MEDIA> pMedia);
+		/// <summary>
+		/// Returns the next frame to show, from the decoded media cache if it has the composed frames, and else from the frame queue.
+		/// </summary>
+		HRESULT GetNextFrame(_Out_ std::shared_ptr<const GIF_FRAME> *ppFrame);
+		/// <summary>
+		/// Keeps the decoded frames of the first loop, and adds them to the decoded media cache when the loop is complete.
+		/// </summary>
+		void ShareDecodedFrame(_In_ std::shared_ptr<const GIF_FRAME> pFrame);
 		HRESULT CreateDeviceResources();
 
-
-		HRESULT GetRawFrame(UINT uFrameIndex);
-		HRESULT GetGlobalMetadata();
-		HRESULT GetBackgroundColor(IWICMetadataQueryReader *pMetadataQueryReader);
-
 		HRESULT StartCaptureLoop();
-		HRESULT ComposeNextFrame();
-		HRESULT DisposeCurrentFrame();
-		HRESULT OverlayNextFrame();
+		/// <summary>
+		/// Uploads a frame from the decoder to the render texture.
+		/// </summary>
+		void ShowDecodedFrame(_In_ const GIF_FRAME &frame);
 
-		HRESULT SaveComposedFrame();
-		HRESULT RestoreSavedFrame();
-		HRESULT ClearCurrentFrameArea();
+		/// <summary>
+		/// Keeps a copy of the frame in the render texture while the first loop of the animation is played.
+		/// </summary>
+		HRESULT CacheComposedFrame();
+		/// <summary>
+		/// Shows the next frame from the cache, once all frames of the animation are cached.
+		/// </summary>
+		void ShowCachedFrame();
+		void ClearFrameCache();
 
 		void ResetGifState();
 
 		BOOL IsLastFrame()
 		{
+			if (m_IsFrameCacheComplete) {
+				return (m_uNextCachedFrameIndex == 0);
+			}
 			return (m_uNextFrameIndex == 0);
 		}
 
@@ -71,26 +89,37 @@
 		std::unique_ptr<HighresTimer> m_FramerateTimer;
 
 		ID3D11Texture2D *m_RenderTexture;
-		ID2D1Factory *m_pD2DFactory;
-		ID2D1BitmapRenderTarget *m_pFrameComposeRT;
-		ID2D1RenderTarget *m_RenderTarget;
-		ID2D1Bitmap *m_pRawFrame;
-		ID2D1Bitmap *m_pSavedFrame;          // The temporary bitmap used for disposal 3 method
-		D2D1_COLOR_F                m_backgroundColor;
-
-		IWICImagingFactory *m_pIWICFactory;
-		IWICBitmapDecoder *m_pDecoder;
+		GifDecoder m_Decoder;
+		DECODED_MEDIA_KEY m_MediaKey;
+		// The media in the decoded media cache. Shared with other readers of the same file, and never modified.
+		std::shared_ptr<const DECODED_MEDIA> m_SharedMedia;
+		// Frames of the first loop decoded by this reader, until they are added to the decoded media cache
+		std::vector<std::shared_ptr<const GIF_FRAME>> m_DecodedFrames;
+		// False if the frames are taken from the cache, or do not fit in the frame cache budget
+		bool m_IsSharingDecodedFrames;
+		// Decodes frames ahead of playback. Declared after the decoder, as it uses the decoder until it is destroyed.
+		GifFrameQueue m_FrameQueue;
 
 		UINT    m_uNextFrameIndex;
 		UINT    m_uTotalLoopCount;  // The number of loops for which the animation will be played
 		UINT    m_uLoopNumber;      // The current animation loop number (e.g. 1 when the animation is first played)
 		BOOL    m_fHasLoop;         // Whether the gif has a loop
 		UINT    m_cFrames;
-		UINT    m_uFrameDisposal;
 		UINT    m_uFrameDelay;
 		UINT    m_cxGifImage;
 		UINT    m_cyGifImage;
-		UINT    m_cxGifImagePixel;  // Width of the displayed image in pixel calculated using pixel aspect ratio
-		UINT    m_cyGifImagePixel;  // Height of the displayed image in pixel calculated using pixel aspect ratio
-		D2D1_RECT_F m_framePosition;
+
+		struct COMPOSED_FRAME {
+			CComPtr<ID3D11Texture2D> Texture;
+			UINT DelayMillis;
+		};
+		// Composed frames in display order. The textures are never written to after they are cached.
+		std::vector<COMPOSED_FRAME> m_ComposedFrameCache;
+		// False if the animation does not fit in the cache budget, or caching failed
+		bool m_IsFrameCacheEnabled;
+		// True when all frames are cached and played from the cache
+		bool m_IsFrameCacheComplete;
+		UINT m_uNextCachedFrameIndex;
+		// The cached texture of the frame currently shown, or nullptr if it is only in the render texture
+		CComPtr<ID3D11Texture2D> m_CurrentFrame;
 	};
\ No newline at end of file
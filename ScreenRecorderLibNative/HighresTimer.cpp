@@ -10,8 +10,12 @@ HighresTimer::HighresTimer() :
 	m_LastTick{},
 	m_Interval(0),
 	m_TickCount(0),
-	m_IsActive(false)
+	m_IsActive(false),
+	m_IsPrecise(false),
+	m_Scheduler(),
+	m_QPCFrequency{ 0 }
 {
+	QueryPerformanceFrequency(&m_QPCFrequency);
 	TIMECAPS tc;
 	UINT targetResolutionMs = 1;
 	if (timeGetDevCaps(&tc, sizeof(TIMECAPS)) == TIMERR_NOERROR)
@@ -50,6 +54,7 @@ HRESULT HighresTimer::StartRecurringTimer(INT64 msInterval)
 	}
 
 	m_Interval = msInterval;
+	m_IsPrecise = false;
 	ResetEvent(m_TickEvent);
 	ResetEvent(m_StopEvent);
 
@@ -72,10 +77,28 @@ HRESULT HighresTimer::StartRecurringTimer(INT64 msInterval)
 	return S_OK;
 }
 
+HRESULT HighresTimer::StartPreciseTimer(INT64 interval100Nanos)
+{
+	if (NULL == m_TickEvent) {
+		DWORD dwErr = GetLastError();
+		LOG_ERROR(L"CreateWaitableTimer failed: last error = %u", dwErr);
+		return HRESULT_FROM_WIN32(dwErr);
+	}
+	m_Interval = interval100Nanos / 10000;
+	m_IsPrecise = true;
+	CancelWaitableTimer(m_TickEvent);
+	ResetEvent(m_StopEvent);
+	m_LastTick = std::chrono::steady_clock::now();
+	m_Scheduler.Start(GetTime100Nanos(), interval100Nanos);
+	m_IsActive = true;
+	return S_OK;
+}
+
 HRESULT HighresTimer::StopTimer(bool waitForCompletion)
 {
 	SetEvent(m_StopEvent);
-	if (waitForCompletion && m_IsActive) {
+	//The precise timer only sets the waitable timer while a thread is waiting for a tick, and that wait ends on the stop event.
+	if (waitForCompletion && m_IsActive && !m_IsPrecise) {
 		if (WaitForSingleObject(m_TickEvent, INFINITE) != WAIT_OBJECT_0) {
 			LOG_ERROR("Failed to wait for timer tick");
 			return E_FAIL;
@@ -89,6 +112,9 @@ HRESULT HighresTimer::StopTimer(bool waitForCompletion)
 
 HRESULT HighresTimer::WaitForNextTick()
 {
+	if (m_IsPrecise) {
+		return WaitForPreciseTick();
+	}
 	//WAIT_OBJECT_0 means the first handle in the array, the stop event, signaled the stop, so exit.
 	if (WaitForMultipleObjects(ARRAYSIZE(m_EventArray), m_EventArray, FALSE, INFINITE) == WAIT_OBJECT_0) {
 		LOG_TRACE("HighresTimer was canceled");
@@ -127,8 +153,55 @@ HRESULT HighresTimer::WaitFor(INT64 interval100Nanos)
 	return S_OK;
 }
 
+HRESULT HighresTimer::WaitForPreciseTick()
+{
+	INT64 now = GetTime100Nanos();
+	while (!m_Scheduler.IsDue(now)) {
+		INT64 sleepTime = m_Scheduler.GetSleepTime(now);
+		if (sleepTime > 0) {
+			LARGE_INTEGER liDueTime;
+			liDueTime.QuadPart = -sleepTime; // negative means relative time
+			if (!SetWaitableTimer(m_TickEvent, &liDueTime, 0, NULL, NULL, FALSE)) {
+				LOG_ERROR(L"HighresTimer::WaitForPreciseTick failed setting timer");
+				return E_FAIL;
+			}
+			//WAIT_OBJECT_0 means the first handle in the array, the stop event, signaled the stop, so exit.
+			if (WaitForMultipleObjects(ARRAYSIZE(m_EventArray), m_EventArray, FALSE, INFINITE) == WAIT_OBJECT_0) {
+				LOG_TRACE("HighresTimer was canceled");
+				return E_FAIL;
+			}
+			INT64 sleepStart = now;
+			now = GetTime100Nanos();
+			m_Scheduler.RecordSleep(sleepTime, now - sleepStart);
+		}
+		else {
+			if (WaitForSingleObject(m_StopEvent, 0) == WAIT_OBJECT_0) {
+				LOG_TRACE("HighresTimer was canceled");
+				return E_FAIL;
+			}
+			YieldProcessor();
+			now = GetTime100Nanos();
+		}
+	}
+	m_Scheduler.CompleteTick(now);
+	m_LastTick = std::chrono::steady_clock::now();
+	m_TickCount++;
+	return S_OK;
+}
+
+INT64 HighresTimer::GetTime100Nanos()
+{
+	LARGE_INTEGER counter;
+	QueryPerformanceCounter(&counter);
+	//Split the conversion to avoid overflow
+	return (counter.QuadPart / m_QPCFrequency.QuadPart) * 10000000 + (counter.QuadPart % m_QPCFrequency.QuadPart) * 10000000 / m_QPCFrequency.QuadPart;
+}
+
 double HighresTimer::GetMillisUntilNextTick()
 {
+	if (m_IsPrecise) {
+		return max(0, (m_Scheduler.GetNextDeadline() - GetTime100Nanos()) / 10000.0);
+	}
 	if (m_TickCount == 0)
 		return 0;
 	return max(0, (m_Interval - std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - m_LastTick).count()));
@@ -1,6 +1,7 @@
 #pragma once
 #include "CommonTypes.h"
 #include "Util.h"
+#include "DeadlineScheduler.h"
 class HighresTimer
 {
 public:
@@ -8,12 +9,28 @@ public:
 	~HighresTimer();
 	inline HANDLE GetTickEvent() { return m_TickEvent; }
 	HRESULT StartRecurringTimer(INT64 msInterval);
+	/// <summary>
+	/// Starts ticking at the interval, from absolute deadlines that do not drift. Each tick sleeps until shortly before its deadline,
+	/// and spins for the rest. The lateness of each tick is recorded in the lateness histogram.
+	/// </summary>
+	/// <param name="interval100Nanos">The interval between ticks, in 100 nanosecond units</param>
+	HRESULT StartPreciseTimer(INT64 interval100Nanos);
 	HRESULT StopTimer(bool waitForCompletion);
 	HRESULT WaitForNextTick();
 	HRESULT WaitFor(INT64 interval100Nanos);
 	double GetMillisUntilNextTick();
 	inline INT64 GetTickCount() { return m_TickCount; }
+	/// <summary>
+	/// Returns the lateness of the ticks of the precise timer. Must be called from the thread that waits for the ticks.
+	/// </summary>
+	inline TIMER_LATENESS_HISTOGRAM GetLatenessHistogram() { return m_Scheduler.GetLatenessHistogram(); }
 private:
+	HRESULT WaitForPreciseTick();
+	INT64 GetTime100Nanos();
+
+	bool m_IsPrecise;
+	DeadlineScheduler m_Scheduler;
+	LARGE_INTEGER m_QPCFrequency;
 	bool m_IsActive;
 	INT64 m_TickCount;
 	std::chrono::steady_clock::time_point m_LastTick;
@@ -7,7 +7,11 @@ using namespace std;
 
 ImageReader::ImageReader() :
 	m_Texture(nullptr),
-	m_NativeSize{}
+	m_NativeSize{},
+	m_ProcessedTexture(nullptr),
+	m_ProcessedDestinationRect{},
+	m_ProcessedSourceRect{},
+	m_ProcessedContentRect{}
 {
 }
 
@@ -45,6 +49,19 @@ HRESULT ImageReader::GetNativeSize(_In_ RECORDING_SOURCE_BASE &recordingSource,
 	HRESULT hr = S_OK;
 	MeasureExecutionTime measure(L"ImageReader GetNativeSize");
 	if (!m_Texture) {
+		//Media that is already decoded does not need to be opened again
+		DECODED_MEDIA_KEY key;
+		if (recordingSource.SourceStream) {
+			hr = DecodedMediaCache::GetMediaKey(recordingSource.SourceStream, &key);
+		}
+		else {
+			hr = DecodedMediaCache::GetMediaKey(recordingSource.SourcePath, &key);
+		}
+		std::shared_ptr<const DECODED_MEDIA> pMedia = SUCCEEDED(hr) ? DecodedMediaCache::Shared().Find(key) : nullptr;
+		if (pMedia) {
+			*nativeMediaSize = SIZE{ static_cast<long>(pMedia->Width),static_cast<long>(pMedia->Height) };
+			return S_OK;
+		}
 		CComPtr<IWICBitmapSource> pBitmap;
 		if (recordingSource.SourceStream) {
 			hr = CreateWICBitmapFromStream(recordingSource.SourceStream, GUID_WICPixelFormat32bppBGRA, &pBitmap);
@@ -69,16 +86,8 @@ HRESULT ImageReader::GetNativeSize(_In_ RECORDING_SOURCE_BASE &recordingSource,
 HRESULT ImageReader::AcquireNextFrame(_In_ DWORD timeoutMillis, _Outptr_opt_result_maybenull_ ID3D11Texture2D **ppFrame)
 {
 	if (m_Texture && ppFrame) {
-		CComPtr<ID3D11Texture2D> pStagingTexture = nullptr;
-		D3D11_TEXTURE2D_DESC desc;
-		m_Texture->GetDesc(&desc);
-		desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
-		desc.MiscFlags = 0;
-		desc.Usage = D3D11_USAGE_DEFAULT;
-
-		RETURN_ON_BAD_HR(m_Device->CreateTexture2D(&desc, nullptr, &pStagingTexture));
-		m_DeviceContext->CopyResource(pStagingTexture, m_Texture);
-		*ppFrame = pStagingTexture;
+		//The image never changes, so the decoded texture is handed out as is. Callers only read from it.
+		*ppFrame = m_Texture;
 		(*ppFrame)->AddRef();
 		QueryPerformanceCounter(&m_LastGrabTimeStamp);
 		return S_OK;
@@ -100,39 +109,60 @@ HRESULT ImageReader::WriteNextFrameToSharedSurface(_In_ DWORD timeoutMillis, _In
 
 	CComPtr<ID3D11Texture2D> pProcessedTexture;
 	HRESULT hr = E_FAIL;
-	if (pTexture) {
-		pProcessedTexture = pTexture;
+	RECORDING_SOURCE *recordingSource = dynamic_cast<RECORDING_SOURCE *>(m_RecordingSource);
+	RECT sourceRect = recordingSource ? recordingSource->SourceRect.value_or(RECT{}) : RECT{};
+	RECT contentRect = destinationRect;
+	bool isOwnTexture = !pTexture || pTexture == m_Texture;
+	if (isOwnTexture
+		&& m_ProcessedTexture
+		&& EqualRect(&m_ProcessedDestinationRect, &destinationRect)
+		&& EqualRect(&m_ProcessedSourceRect, &sourceRect)) {
+		//The image never changes, so the result of the previous crop and resize is still valid.
+		pProcessedTexture = m_ProcessedTexture;
+		contentRect = m_ProcessedContentRect;
 		hr = S_OK;
 	}
 	else {
-		hr = AcquireNextFrame(timeoutMillis, &pProcessedTexture);
-		RETURN_ON_BAD_HR(hr);
-	}
+		if (pTexture) {
+			pProcessedTexture = pTexture;
+			hr = S_OK;
+		}
+		else {
+			hr = AcquireNextFrame(timeoutMillis, &pProcessedTexture);
+			RETURN_ON_BAD_HR(hr);
+		}
 
-	D3D11_TEXTURE2D_DESC frameDesc;
-	pProcessedTexture->GetDesc(&frameDesc);
-	RECORDING_SOURCE *recordingSource = dynamic_cast<RECORDING_SOURCE *>(m_RecordingSource);
+		D3D11_TEXTURE2D_DESC frameDesc;
+		pProcessedTexture->GetDesc(&frameDesc);
+
+		if (recordingSource && recordingSource->SourceRect.has_value()
+			&& IsValidRect(recordingSource->SourceRect.value())
+			&& (RectWidth(recordingSource->SourceRect.value()) != frameDesc.Width || (RectHeight(recordingSource->SourceRect.value()) != frameDesc.Height))) {
+			ID3D11Texture2D *pCroppedTexture;
+			RETURN_ON_BAD_HR(hr = m_TextureManager->CropTexture(pProcessedTexture, recordingSource->SourceRect.value(), &pCroppedTexture));
+			if (hr == S_OK) {
+				pProcessedTexture.Release();
+				pProcessedTexture.Attach(pCroppedTexture);
+			}
+		}
+		pProcessedTexture->GetDesc(&frameDesc);
 
-	if (recordingSource && recordingSource->SourceRect.has_value()
-		&& IsValidRect(recordingSource->SourceRect.value())
-		&& (RectWidth(recordingSource->SourceRect.value()) != frameDesc.Width || (RectHeight(recordingSource->SourceRect.value()) != frameDesc.Height))) {
-		ID3D11Texture2D *pCroppedTexture;
-		RETURN_ON_BAD_HR(hr = m_TextureManager->CropTexture(pProcessedTexture, recordingSource->SourceRect.value(), &pCroppedTexture));
-		if (hr == S_OK) {
+		if (RectWidth(destinationRect) != frameDesc.Width || RectHeight(destinationRect) != frameDesc.Height) {
+			ID3D11Texture2D *pResizedTexture;
+			RETURN_ON_BAD_HR(hr = m_TextureManager->ResizeTexture(pProcessedTexture, SIZE{ RectWidth(destinationRect),RectHeight(destinationRect) }, m_RecordingSource->Stretch, &pResizedTexture, &contentRect));
 			pProcessedTexture.Release();
-			pProcessedTexture.Attach(pCroppedTexture);
+			pProcessedTexture.Attach(pResizedTexture);
+		}
+		if (isOwnTexture) {
+			m_ProcessedTexture = pProcessedTexture;
+			m_ProcessedDestinationRect = destinationRect;
+			m_ProcessedSourceRect = sourceRect;
+			m_ProcessedContentRect = contentRect;
 		}
 	}
+	D3D11_TEXTURE2D_DESC frameDesc;
 	pProcessedTexture->GetDesc(&frameDesc);
 
-	RECT contentRect = destinationRect;
-	if (RectWidth(destinationRect) != frameDesc.Width || RectHeight(destinationRect) != frameDesc.Height) {
-		ID3D11Texture2D *pResizedTexture;
-		RETURN_ON_BAD_HR(hr = m_TextureManager->ResizeTexture(pProcessedTexture, SIZE{ RectWidth(destinationRect),RectHeight(destinationRect) }, m_RecordingSource->Stretch, &pResizedTexture, &contentRect));
-		pProcessedTexture.Release();
-		pProcessedTexture.Attach(pResizedTexture);
-	}
-
 	SIZE contentOffset = GetContentOffset(m_RecordingSource->Anchor, destinationRect, contentRect);
 	long left = destinationRect.left + offsetX + contentOffset.cx;
 	long top = destinationRect.top + offsetY + contentOffset.cy;
@@ -145,27 +175,44 @@ HRESULT ImageReader::WriteNextFrameToSharedSurface(_In_ DWORD timeoutMillis, _In
 
 HRESULT ImageReader::InitializeDecoder(_In_ std::wstring source)
 {
-	CComPtr<IWICBitmapSource> pBitmap;
-	HRESULT hr = CreateWICBitmapFromFile(source.c_str(), GUID_WICPixelFormat32bppBGRA, &pBitmap);
-	if (FAILED(hr)) {
-		return hr;
+	HRESULT hr;
+	DECODED_MEDIA_KEY key;
+	RETURN_ON_BAD_HR(hr = DecodedMediaCache::GetMediaKey(source, &key));
+	std::shared_ptr<const DECODED_MEDIA> pMedia = DecodedMediaCache::Shared().Find(key);
+	if (!pMedia) {
+		CComPtr<IWICBitmapSource> pBitmap;
+		hr = CreateWICBitmapFromFile(source.c_str(), GUID_WICPixelFormat32bppBGRA, &pBitmap);
+		if (FAILED(hr)) {
+			return hr;
+		}
+		RETURN_ON_BAD_HR(hr = DecodeBitmap(pBitmap, &pMedia));
+		DecodedMediaCache::Shared().Insert(key, pMedia);
 	}
-	return InitializeDecoder(pBitmap);
+	return InitializeTexture(*pMedia);
 }
 
 HRESULT ImageReader::InitializeDecoder(_In_ IStream *pSourceStream)
 {
-	CComPtr<IWICBitmapSource> pBitmap;
-	HRESULT hr = CreateWICBitmapFromStream(pSourceStream, GUID_WICPixelFormat32bppBGRA, &pBitmap);
-	if (FAILED(hr)) {
-		return hr;
+	HRESULT hr;
+	DECODED_MEDIA_KEY key;
+	RETURN_ON_BAD_HR(hr = DecodedMediaCache::GetMediaKey(pSourceStream, &key));
+	std::shared_ptr<const DECODED_MEDIA> pMedia = DecodedMediaCache::Shared().Find(key);
+	if (!pMedia) {
+		CComPtr<IWICBitmapSource> pBitmap;
+		hr = CreateWICBitmapFromStream(pSourceStream, GUID_WICPixelFormat32bppBGRA, &pBitmap);
+		if (FAILED(hr)) {
+			return hr;
+		}
+		RETURN_ON_BAD_HR(hr = DecodeBitmap(pBitmap, &pMedia));
+		DecodedMediaCache::Shared().Insert(key, pMedia);
 	}
-	return InitializeDecoder(pBitmap);
+	return InitializeTexture(*pMedia);
 }
 
-HRESULT ImageReader::InitializeDecoder(_In_ IWICBitmapSource *pBitmap) {
+HRESULT ImageReader::DecodeBitmap(_In_ IWICBitmapSource *pBitmap, _Out_ std::shared_ptr<const DECODED_MEDIA> *ppMedia)
+{
 	HRESULT hr = E_FAIL;
-	// Copy the 32bpp RGBA image to a buffer for further processing.
+	*ppMedia = nullptr;
 	UINT width, height;
 	RETURN_ON_BAD_HR(hr = pBitmap->GetSize(&width, &height));
 
@@ -175,14 +222,28 @@ HRESULT ImageReader::InitializeDecoder(_In_ IWICBitmapSource *pBitmap) {
 	if (bitmapSize <= 0) {
 		return E_FAIL;
 	}
-	BYTE *pFrameBuffer = new (std::nothrow) BYTE[bitmapSize];
-	if (!pFrameBuffer) {
+	std::shared_ptr<DECODED_MEDIA> pMedia = std::make_shared<DECODED_MEDIA>();
+	pMedia->Width = width;
+	pMedia->Height = height;
+	try {
+		pMedia->Pixels.resize(static_cast<size_t>(width) * height);
+	}
+	catch (const std::bad_alloc &) {
 		LOG_ERROR("Failed to allocate memory for bitmap decode");
 		return E_OUTOFMEMORY;
 	}
-	DeleteArrayOnExit deleteOnExit(pFrameBuffer);
-	RETURN_ON_BAD_HR(hr = pBitmap->CopyPixels(nullptr, stride, bitmapSize, pFrameBuffer));
-	RETURN_ON_BAD_HR(m_TextureManager->CreateTextureFromBuffer(pFrameBuffer, stride, width, height, &m_Texture, 0, D3D11_BIND_SHADER_RESOURCE));
-	m_NativeSize = SIZE{ static_cast<long>(width),static_cast<long>(height) };
+	// Copy the 32bpp RGBA image to a buffer for further processing.
+	RETURN_ON_BAD_HR(hr = pBitmap->CopyPixels(nullptr, stride, bitmapSize, reinterpret_cast<BYTE *>(pMedia->Pixels.data())));
+	*ppMedia = pMedia;
+	return hr;
+}
+
+HRESULT ImageReader::InitializeTexture(_In_ const DECODED_MEDIA &media)
+{
+	HRESULT hr;
+	m_Texture.Release();
+	m_ProcessedTexture.Release();
+	RETURN_ON_BAD_HR(hr = m_TextureManager->CreateTextureFromBuffer(reinterpret_cast<const BYTE *>(media.Pixels.data()), media.Width * 4, media.Width, media.Height, &m_Texture, 0, D3D11_BIND_SHADER_RESOURCE));
+	m_NativeSize = SIZE{ static_cast<long>(media.Width),static_cast<long>(media.Height) };
 	return hr;
 }
\ No newline at end of file
@@ -3,6 +3,7 @@
 #include "CommonTypes.h"
 #include <memory>
 #include "TextureManager.h"
+#include "DecodedMediaCache.h"
 #include <atlbase.h>
 
 class ImageReader :public CaptureBase
@@ -20,12 +21,22 @@ public:
 		return S_FALSE;
 	}
 	virtual inline std::wstring Name() override { return L"ImageReader"; };
+	virtual inline bool IsStaticContent() override { return true; }
 
 private:
 	HRESULT InitializeDecoder(_In_ std::wstring source);
 	HRESULT InitializeDecoder(_In_ IStream *pSourceStream);
-	HRESULT InitializeDecoder(_In_ IWICBitmapSource *pBitmap);
+	/// <summary>
+	/// Copies the pixels of the bitmap to memory that can be shared through the decoded media cache.
+	/// </summary>
+	HRESULT DecodeBitmap(_In_ IWICBitmapSource *pBitmap, _Out_ std::shared_ptr<const DECODED_MEDIA> *ppMedia);
+	HRESULT InitializeTexture(_In_ const DECODED_MEDIA &media);
 
 	CComPtr<ID3D11Texture2D> m_Texture;
 	SIZE m_NativeSize;
+	//The image cropped and resized for the last destination, reused until the destination or source rect changes.
+	CComPtr<ID3D11Texture2D> m_ProcessedTexture;
+	RECT m_ProcessedDestinationRect;
+	RECT m_ProcessedSourceRect;
+	RECT m_ProcessedContentRect;
 };
\ No newline at end of file
@@ -1,44 +1,238 @@
 #include "Log.h"
+#include "LogQueue.h"
 #include <mutex>
+#include <thread>
+#include <vector>
 
-static std::mutex g_Mtx{};
+//Length of a formatted timestamp, like 2021-01-31 23:59:59.999, including the terminating null.
+#define LOG_TIMESTAMP_LENGTH 24
 
-void _log(PCWSTR format, ...)
+static void FormatTimestamp(_In_ std::chrono::system_clock::time_point time, _Out_writes_(LOG_TIMESTAMP_LENGTH) wchar_t *buffer)
 {
-	const std::lock_guard<std::mutex> lock(g_Mtx);
-	wchar_t buffer[LOG_BUFFER_SIZE];
-	va_list args;
-	va_start(args, format);
+	const auto timeAsTimeT = std::chrono::system_clock::to_time_t(time);
+	tm localTime;
+	localtime_s(&localTime, &timeAsTimeT);
+	const auto timeMs = std::chrono::duration_cast<std::chrono::milliseconds>(time.time_since_epoch()) % 1000;
+	size_t length = wcsftime(buffer, LOG_TIMESTAMP_LENGTH, L"%Y-%m-%d %H:%M:%S", &localTime);
+	swprintf_s(buffer + length, LOG_TIMESTAMP_LENGTH - length, L".%03d", static_cast<int>(timeMs.count()));
+}
+
+//
+// Writes the messages of all logging threads on a background thread. Each logging thread queues its messages
+// in its own LogQueue, and the writer keeps the log file open and writes the queued messages in batches.
+// The writer thread is started by the first message, and exits when no messages have been logged for a while.
+// Messages of different threads that are written in the same batch are grouped by thread.
+//
+class LogWriter
+{
+public:
+	static LogWriter &Instance()
+	{
+		//Never destroyed, as the writer thread may still be running when the module is unloaded
+		static LogWriter *writer = new LogWriter();
+		return *writer;
+	}
+
+	void Log(_In_ int level, _In_ PCWSTR format, _In_ va_list args)
+	{
+		thread_local std::shared_ptr<LogQueue> t_Queue = RegisterQueue();
+		t_Queue->TryPush(level, std::chrono::system_clock::now(), format, args);
+		if (!m_IsWriterRunning && !m_IsWriterRunning.exchange(true)) {
+			std::thread(&LogWriter::WriterThreadProc, this).detach();
+		}
+		else if (level >= LOG_LVL_WARN || t_Queue->GetCount() >= t_Queue->GetCapacity() / 2) {
+			SetEvent(m_WakeEvent);
+		}
+	}
+
+	void Flush()
+	{
+		std::scoped_lock lock(m_WriteMutex);
+		WriteQueuedMessages();
+	}
+
+	void SetFilePath(_In_ std::wstring path)
+	{
+		std::scoped_lock lock(m_WriteMutex);
+		//Write the messages already logged to the previous file
+		WriteQueuedMessages();
+		m_LogFilePath = path;
+	}
+
+	LOG_STATISTICS GetStatistics()
+	{
+		std::scoped_lock lock(m_WriteMutex);
+		return LOG_STATISTICS{ m_WrittenCount, GetDroppedCount() };
+	}
+private:
+	LogWriter() :
+		m_QueuesMutex{},
+		m_Queues{},
+		m_WriteMutex{},
+		m_File{},
+		m_FilePath{},
+		m_LogFilePath{},
+		m_Batch{},
+		m_IsWriterRunning(false),
+		m_WakeEvent(CreateEvent(nullptr, FALSE, FALSE, nullptr)),
+		m_WrittenCount(0),
+		m_ReportedDroppedCount(0),
+		m_RemovedQueuesDroppedCount(0)
+	{
+	}
+
+	std::shared_ptr<LogQueue> RegisterQueue()
+	{
+		auto queue = std::make_shared<LogQueue>();
+		std::scoped_lock lock(m_QueuesMutex);
+		m_Queues.push_back(queue);
+		return queue;
+	}
+
+	UINT64 GetDroppedCount()
+	{
+		std::scoped_lock lock(m_QueuesMutex);
+		UINT64 droppedCount = m_RemovedQueuesDroppedCount;
+		for each (auto queue in m_Queues)
+		{
+			droppedCount += queue->GetDroppedCount();
+		}
+		return droppedCount;
+	}
+
+	void WriterThreadProc()
+	{
+		UINT idleIntervals = 0;
+		while (true) {
+			WaitForSingleObject(m_WakeEvent, LOG_WRITER_INTERVAL_MILLIS);
+			std::scoped_lock lock(m_WriteMutex);
+			if (WriteQueuedMessages() > 0) {
+				idleIntervals = 0;
+			}
+			else if (++idleIntervals >= LOG_WRITER_IDLE_INTERVALS) {
+				//A message queued after this is seen by the final write, or starts a new writer thread
+				m_IsWriterRunning = false;
+				WriteQueuedMessages();
+				m_File.close();
+				return;
+			}
+		}
+	}
 
-	vswprintf_s(buffer, LOG_BUFFER_SIZE, format, args);
-	if (!logFilePath.empty()) {
+	/// <summary>
+	/// Writes the messages of all queues to the log file. Must be called with m_WriteMutex held.
+	/// </summary>
+	/// <returns>The number of messages written.</returns>
+	UINT WriteQueuedMessages()
+	{
+		std::vector<std::shared_ptr<LogQueue>> queues;
+		{
+			std::scoped_lock lock(m_QueuesMutex);
+			//Remove the queues of threads that have exited once they are drained, as only this list references them
+			for (auto it = m_Queues.begin(); it != m_Queues.end();) {
+				if (it->use_count() == 1 && (*it)->GetCount() == 0) {
+					m_RemovedQueuesDroppedCount += (*it)->GetDroppedCount();
+					it = m_Queues.erase(it);
+				}
+				else {
+					it++;
+				}
+			}
+			queues = m_Queues;
+		}
+		UINT count = 0;
+		m_Batch.clear();
+		for each (auto queue in queues)
+		{
+			count += queue->Drain([&](const LOG_RECORD &record) {
+				wchar_t timestamp[LOG_TIMESTAMP_LENGTH];
+				FormatTimestamp(record.Time, timestamp);
+				m_Batch.append(timestamp);
+				m_Batch.append(L" ");
+				m_Batch.append(record.Message);
+				});
+		}
+		UINT64 droppedCount = GetDroppedCount();
+		if (droppedCount > m_ReportedDroppedCount) {
+			wchar_t timestamp[LOG_TIMESTAMP_LENGTH];
+			FormatTimestamp(std::chrono::system_clock::now(), timestamp);
+			wchar_t message[LOG_BUFFER_SIZE];
+			swprintf_s(message, LOG_BUFFER_SIZE, L"%ls [WARN]  %llu log messages were dropped because the log queue was full\n", timestamp, droppedCount - m_ReportedDroppedCount);
+			m_Batch.append(message);
+			m_ReportedDroppedCount = droppedCount;
+		}
+		if (!m_Batch.empty()) {
+			Write(m_Batch);
+		}
+		m_WrittenCount += count;
+		return count;
+	}
 
-		std::wofstream logFile(logFilePath, std::ios_base::app | std::ios_base::out);
-		if (logFile.is_open())
+	void Write(_In_ const std::wstring &text)
+	{
+		if (m_LogFilePath.empty()) {
+			m_File.close();
+			OutputDebugStringW(text.c_str());
+			return;
+		}
+		if (!m_File.is_open() || m_FilePath != m_LogFilePath) {
+			m_File.close();
+			m_FilePath = m_LogFilePath;
+			m_File.open(m_FilePath, std::ios_base::app | std::ios_base::out);
+		}
+		if (m_File.is_open())
 		{
-			logFile << buffer;
-			logFile.close();
+			m_File.write(text.c_str(), text.size());
+			m_File.flush();
 		}
 		else {
 			OutputDebugStringW(L"Error opening log file for write");
 		}
 	}
-	else {
-		OutputDebugStringW(buffer);
-	}
+
+	std::mutex m_QueuesMutex;
+	std::vector<std::shared_ptr<LogQueue>> m_Queues;
+	//Held while writing, so only one thread drains the queues at a time
+	std::mutex m_WriteMutex;
+	std::wofstream m_File;
+	//Path of the open log file
+	std::wstring m_FilePath;
+	//Path messages are written to. Only accessed with m_WriteMutex held.
+	std::wstring m_LogFilePath;
+	std::wstring m_Batch;
+	std::atomic<bool> m_IsWriterRunning;
+	HANDLE m_WakeEvent;
+	UINT64 m_WrittenCount;
+	UINT64 m_ReportedDroppedCount;
+	UINT64 m_RemovedQueuesDroppedCount;
+};
+
+void _log(int level, PCWSTR format, ...)
+{
+	va_list args;
+	va_start(args, format);
+	LogWriter::Instance().Log(level, format, args);
 	va_end(args);
 }
 
+void FlushLog()
+{
+	LogWriter::Instance().Flush();
+}
+
+void SetLogFilePath(_In_ std::wstring path)
+{
+	LogWriter::Instance().SetFilePath(path);
+}
+
+LOG_STATISTICS GetLogStatistics()
+{
+	return LogWriter::Instance().GetStatistics();
+}
+
 std::wstring GetTimestamp() {
 	// get a precise timestamp as a string
-	const auto now = std::chrono::system_clock::now();
-	const auto nowAsTimeT = std::chrono::system_clock::to_time_t(now);
-	tm localTime;
-	localtime_s(&localTime, &nowAsTimeT);
-	const auto nowMs = std::chrono::duration_cast<std::chrono::milliseconds>(now.time_since_epoch()) % 1000;
-	std::wstringstream nowSs;
-	nowSs
-		<< std::put_time(&localTime, L"%Y-%m-%d %H:%M:%S")
-		<< '.' << std::setfill(L'0') << std::setw(3) << nowMs.count();
-	return nowSs.str();
+	wchar_t timestamp[LOG_TIMESTAMP_LENGTH];
+	FormatTimestamp(std::chrono::system_clock::now(), timestamp);
+	return timestamp;
 }
@@ -0,0 +1,84 @@
+#pragma once
+#include "Log.h"
+#include <atomic>
+#include <memory>
+#include <cstdarg>
+
+//Number of messages a logging thread can queue before the log writer catches up. Messages logged to a full queue are dropped.
+#define LOG_QUEUE_CAPACITY 64
+
+struct LOG_RECORD {
+	// Time the message was logged
+	std::chrono::system_clock::time_point Time;
+	// Severity of the message, one of the LOG_LVL values
+	int Level;
+	// The formatted message
+	wchar_t Message[LOG_BUFFER_SIZE];
+};
+
+//
+// Bounded queue of log records, with a single producer and a single consumer. Each logging thread owns one, so logging
+// does not take a lock or touch the file. The producer formats its message straight into a free record, as the format
+// arguments do not outlive the call. The timestamp and the file writing are left to the consumer.
+//
+class LogQueue
+{
+public:
+	LogQueue(_In_ UINT capacity = LOG_QUEUE_CAPACITY) :
+		m_Records(std::make_unique<LOG_RECORD[]>(capacity)),
+		m_Capacity(capacity),
+		m_WriteIndex(0),
+		m_ReadIndex(0),
+		m_DroppedCount(0)
+	{
+	}
+
+	/// <summary>
+	/// Formats a message into the queue. Must only be called from the producer thread.
+	/// </summary>
+	/// <returns>False if the queue is full and the message was dropped.</returns>
+	bool TryPush(_In_ int level, _In_ std::chrono::system_clock::time_point time, _In_ PCWSTR format, _In_ va_list args)
+	{
+		UINT64 writeIndex = m_WriteIndex.load(std::memory_order_relaxed);
+		if (writeIndex - m_ReadIndex.load(std::memory_order_acquire) >= m_Capacity) {
+			m_DroppedCount.fetch_add(1, std::memory_order_relaxed);
+			return false;
+		}
+		LOG_RECORD &record = m_Records[writeIndex % m_Capacity];
+		record.Time = time;
+		record.Level = level;
+		vswprintf_s(record.Message, LOG_BUFFER_SIZE, format, args);
+		m_WriteIndex.store(writeIndex + 1);
+		return true;
+	}
+
+	/// <summary>
+	/// Passes each queued record to the consume function and removes it from the queue. Must only be called by one consumer thread at a time.
+	/// </summary>
+	/// <returns>The number of records consumed.</returns>
+	template <class TFunc>
+	UINT Drain(_In_ TFunc consume)
+	{
+		UINT64 readIndex = m_ReadIndex.load(std::memory_order_relaxed);
+		UINT64 writeIndex = m_WriteIndex.load(std::memory_order_acquire);
+		UINT count = 0;
+		for (; readIndex < writeIndex; readIndex++, count++) {
+			consume(static_cast<const LOG_RECORD &>(m_Records[readIndex % m_Capacity]));
+			m_ReadIndex.store(readIndex + 1, std::memory_order_release);
+		}
+		return count;
+	}
+
+	inline UINT GetCount() { return static_cast<UINT>(m_WriteIndex.load(std::memory_order_acquire) - m_ReadIndex.load(std::memory_order_acquire)); }
+	inline UINT GetCapacity() { return m_Capacity; }
+	/// <summary>Number of messages dropped because the queue was full.</summary>
+	inline UINT64 GetDroppedCount() { return m_DroppedCount.load(std::memory_order_relaxed); }
+private:
+	std::unique_ptr<LOG_RECORD[]> m_Records;
+	UINT m_Capacity;
+	//Total number of records written. Only written by the producer.
+	std::atomic<UINT64> m_WriteIndex;
+	//Total number of records read. Only written by the consumer.
+	std::atomic<UINT64> m_ReadIndex;
+	std::atomic<UINT64> m_DroppedCount;
+};
@@ -0,0 +1,133 @@
+#include "MediaClock.h"
+
+INT64 MediaTimeFromCount(_In_ INT64 count, _In_ MEDIA_RATE rate)
+{
+	if (rate.Numerator == 0) {
+		return 0;
+	}
+	INT64 unitsPerEventNumerator = MEDIA_TIME_UNITS_PER_SECOND * rate.Denominator;
+	//Split the count by the numerator, so the multiplication does not overflow for long recordings
+	return (count / rate.Numerator) * unitsPerEventNumerator + ((count % rate.Numerator) * unitsPerEventNumerator) / rate.Numerator;
+}
+
+INT64 CountFromMediaTime(_In_ INT64 mediaTime, _In_ MEDIA_RATE rate)
+{
+	if (rate.Denominator == 0) {
+		return 0;
+	}
+	INT64 unitsPerEventNumerator = MEDIA_TIME_UNITS_PER_SECOND * rate.Denominator;
+	INT64 wholeCycles = mediaTime / unitsPerEventNumerator;
+	INT64 remainder = mediaTime % unitsPerEventNumerator;
+	//Round up, as an event that starts before the time counts
+	return wholeCycles * rate.Numerator + (remainder * rate.Numerator + unitsPerEventNumerator - 1) / unitsPerEventNumerator;
+}
+
+INT64 FrameIndexFromMediaTime(_In_ INT64 mediaTime, _In_ INT64 previousFrameIndex, _In_ MEDIA_RATE rate)
+{
+	if (rate.Denominator == 0) {
+		return previousFrameIndex + 1;
+	}
+	INT64 unitsPerEventNumerator = MEDIA_TIME_UNITS_PER_SECOND * rate.Denominator;
+	INT64 wholeCycles = mediaTime / unitsPerEventNumerator;
+	INT64 remainder = mediaTime % unitsPerEventNumerator;
+	//Round to the nearest frame
+	INT64 frameIndex = wholeCycles * rate.Numerator + (2 * remainder * rate.Numerator + unitsPerEventNumerator) / (2 * unitsPerEventNumerator);
+	return max(previousFrameIndex + 1, frameIndex);
+}
+
+INT64 GetTimeUntilNextFrame(_In_ INT64 now, _In_ INT64 lastFrameStartTime, _In_ INT64 frameDuration)
+{
+	return max(0, frameDuration - (now - lastFrameStartTime));
+}
+
+bool IsSnapshotDue(_In_ INT64 now, _In_ std::optional<INT64> previousSnapshotTime, _In_ INT64 interval)
+{
+	return !previousSnapshotTime.has_value() || now - previousSnapshotTime.value() > interval;
+}
+
+MediaClock::MediaClock() :
+	m_Mutex{},
+	m_State(MediaClockState::Stopped),
+	m_ElapsedTime(0),
+	m_RunningSinceSourceTime(0)
+{
+}
+
+void MediaClock::Start()
+{
+	std::scoped_lock lock(m_Mutex);
+	m_ElapsedTime = 0;
+	m_RunningSinceSourceTime = GetSourceTime();
+	m_State = MediaClockState::Running;
+}
+
+void MediaClock::Pause()
+{
+	std::scoped_lock lock(m_Mutex);
+	if (m_State == MediaClockState::Running) {
+		m_ElapsedTime += GetSourceTime() - m_RunningSinceSourceTime;
+		m_State = MediaClockState::Paused;
+	}
+}
+
+void MediaClock::Resume()
+{
+	std::scoped_lock lock(m_Mutex);
+	if (m_State == MediaClockState::Paused) {
+		m_RunningSinceSourceTime = GetSourceTime();
+		m_State = MediaClockState::Running;
+	}
+}
+
+void MediaClock::Stop()
+{
+	std::scoped_lock lock(m_Mutex);
+	m_ElapsedTime = 0;
+	m_State = MediaClockState::Stopped;
+}
+
+INT64 MediaClock::GetTime()
+{
+	std::scoped_lock lock(m_Mutex);
+	if (m_State == MediaClockState::Running) {
+		return m_ElapsedTime + GetSourceTime() - m_RunningSinceSourceTime;
+	}
+	return m_ElapsedTime;
+}
+
+MediaClockState MediaClock::GetState()
+{
+	std::scoped_lock lock(m_Mutex);
+	return m_State;
+}
+
+SystemMediaClock::SystemMediaClock() :
+	MediaClock(),
+	m_QPCFrequency{ 0 }
+{
+	QueryPerformanceFrequency(&m_QPCFrequency);
+}
+
+INT64 SystemMediaClock::GetSourceTime()
+{
+	LARGE_INTEGER counter;
+	QueryPerformanceCounter(&counter);
+	//Split the conversion to avoid overflow
+	return (counter.QuadPart / m_QPCFrequency.QuadPart) * MEDIA_TIME_UNITS_PER_SECOND + (counter.QuadPart % m_QPCFrequency.QuadPart) * MEDIA_TIME_UNITS_PER_SECOND / m_QPCFrequency.QuadPart;
+}
+
+VirtualMediaClock::VirtualMediaClock() :
+	MediaClock(),
+	m_SourceTime(0)
+{
+}
+
+void VirtualMediaClock::Advance(_In_ INT64 duration)
+{
+	m_SourceTime += duration;
+}
+
+INT64 VirtualMediaClock::GetSourceTime()
+{
+	return m_SourceTime;
+}
@@ -0,0 +1,120 @@
+#pragma once
+#include <Windows.h>
+#include <atomic>
+#include <mutex>
+#include <optional>
+
+//Number of media time units in a second. Media time stamps are in 100 nanosecond units.
+#define MEDIA_TIME_UNITS_PER_SECOND 10000000LL
+
+//
+// A rate of events per second as a fraction, like 30000/1001 for 29.97 fps video or 48000/1 for audio samples.
+//
+struct MEDIA_RATE {
+	UINT32 Numerator;
+	UINT32 Denominator;
+};
+
+/// <summary>
+/// Returns the media time of the event at the index, for events at the rate. The time is rounded down, and calculated from the index
+/// instead of by adding up durations, so rounding errors do not add up over a long recording.
+/// </summary>
+INT64 MediaTimeFromCount(_In_ INT64 count, _In_ MEDIA_RATE rate);
+/// <summary>
+/// Returns the number of events at the rate that start before the media time.
+/// </summary>
+INT64 CountFromMediaTime(_In_ INT64 mediaTime, _In_ MEDIA_RATE rate);
+/// <summary>
+/// Returns the index of the frame at the rate that starts nearest to the media time, and at least one past the previous frame index.
+/// Frames of a fixed frame rate are placed at these indexes, so their time stamps can be calculated with MediaTimeFromCount.
+/// </summary>
+INT64 FrameIndexFromMediaTime(_In_ INT64 mediaTime, _In_ INT64 previousFrameIndex, _In_ MEDIA_RATE rate);
+/// <summary>
+/// Returns the time left until the next frame of the duration is due, or 0 if it is due.
+/// </summary>
+INT64 GetTimeUntilNextFrame(_In_ INT64 now, _In_ INT64 lastFrameStartTime, _In_ INT64 frameDuration);
+/// <summary>
+/// Returns true if more than the interval has passed since the previous snapshot, or if no snapshot has been taken.
+/// </summary>
+bool IsSnapshotDue(_In_ INT64 now, _In_ std::optional<INT64> previousSnapshotTime, _In_ INT64 interval);
+
+enum class MediaClockState {
+	Stopped,
+	Running,
+	Paused
+};
+
+//
+// The clock media time stamps of a recording are taken from. The time starts at 0 when the clock is started,
+// and does not advance while the clock is paused. The recorder takes all its timing from this clock, so recordings
+// can be paced by a virtual clock in tests and benchmarks. Safe to use from several threads.
+//
+class MediaClock abstract
+{
+public:
+	MediaClock();
+	virtual ~MediaClock() {}
+	/// <summary>
+	/// Starts the clock at time 0.
+	/// </summary>
+	void Start();
+	/// <summary>
+	/// Stops the time from advancing, until the clock is resumed. Has no effect unless the clock is running.
+	/// </summary>
+	void Pause();
+	/// <summary>
+	/// Lets the time advance again from where it was paused. Has no effect unless the clock is paused.
+	/// </summary>
+	void Resume();
+	/// <summary>
+	/// Stops the clock, and resets the time to 0.
+	/// </summary>
+	void Stop();
+	/// <summary>
+	/// Returns the media time, in 100 nanosecond units.
+	/// </summary>
+	INT64 GetTime();
+	MediaClockState GetState();
+protected:
+	/// <summary>
+	/// Returns the time of the source the clock runs on, in 100 nanosecond units. The source time keeps advancing while the clock is paused.
+	/// </summary>
+	virtual INT64 GetSourceTime() abstract;
+private:
+	std::mutex m_Mutex;
+	MediaClockState m_State;
+	// Media time when the clock was last started or resumed
+	INT64 m_ElapsedTime;
+	// Source time when the clock was last started or resumed
+	INT64 m_RunningSinceSourceTime;
+};
+
+//
+// Media clock that runs in real time, on the performance counter.
+//
+class SystemMediaClock : public MediaClock
+{
+public:
+	SystemMediaClock();
+protected:
+	virtual INT64 GetSourceTime() override;
+private:
+	LARGE_INTEGER m_QPCFrequency;
+};
+
+//
+// Media clock that only advances when it is told to, so recordings can be paced faster than real time and deterministically.
+//
+class VirtualMediaClock : public MediaClock
+{
+public:
+	VirtualMediaClock();
+	/// <summary>
+	/// Advances the source time, and the media time if the clock is running.
+	/// </summary>
+	void Advance(_In_ INT64 duration);
+protected:
+	virtual INT64 GetSourceTime() override;
+private:
+	std::atomic<INT64> m_SourceTime;
+};
@@ -0,0 +1,193 @@
+#include "MetricsRegistry.h"
+#include <algorithm>
+#include <cmath>
+#include <intrin.h>
+
+static int GetHighestSetBit(_In_ UINT64 value)
+{
+	unsigned long index;
+	//_BitScanReverse64 is only available on x64
+	if (_BitScanReverse(&index, static_cast<unsigned long>(value >> 32))) {
+		return static_cast<int>(index) + 32;
+	}
+	_BitScanReverse(&index, static_cast<unsigned long>(value));
+	return static_cast<int>(index);
+}
+
+INT64 QPCTicksToHundredNanos(_In_ INT64 ticks)
+{
+	static const INT64 frequency = []() {
+		LARGE_INTEGER frequency;
+		QueryPerformanceFrequency(&frequency);
+		return frequency.QuadPart;
+	}();
+	return ticks / frequency * 10000000 + (ticks % frequency) * 10000000 / frequency;
+}
+
+const METRIC_SNAPSHOT *METRICS_SNAPSHOT::Find(_In_ const std::wstring &name, _In_ const std::wstring &source) const
+{
+	for each (const METRIC_SNAPSHOT &metric in Metrics)
+	{
+		if (metric.Name == name && metric.Source == source) {
+			return &metric;
+		}
+	}
+	return nullptr;
+}
+
+LatencyHistogram::LatencyHistogram() :
+	m_Total(0)
+{
+	for (int i = 0; i < LATENCY_HISTOGRAM_BUCKET_COUNT; i++) {
+		m_Buckets[i].store(0, std::memory_order_relaxed);
+	}
+}
+
+int LatencyHistogram::GetBucketIndex(_In_ INT64 value)
+{
+	if (value < 2 * LATENCY_HISTOGRAM_SUB_BUCKET_COUNT) {
+		return static_cast<int>(max(0, value));
+	}
+	int highestBit = GetHighestSetBit(static_cast<UINT64>(value));
+	int shift = highestBit - LATENCY_HISTOGRAM_SUB_BUCKET_BITS;
+	int subBucket = static_cast<int>(value >> shift) - LATENCY_HISTOGRAM_SUB_BUCKET_COUNT;
+	return 2 * LATENCY_HISTOGRAM_SUB_BUCKET_COUNT + (shift - 1) * LATENCY_HISTOGRAM_SUB_BUCKET_COUNT + subBucket;
+}
+
+INT64 LatencyHistogram::GetBucketUpperBound(_In_ int index)
+{
+	if (index < 2 * LATENCY_HISTOGRAM_SUB_BUCKET_COUNT) {
+		return index;
+	}
+	int shift = (index - 2 * LATENCY_HISTOGRAM_SUB_BUCKET_COUNT) / LATENCY_HISTOGRAM_SUB_BUCKET_COUNT + 1;
+	INT64 subBucket = (index - 2 * LATENCY_HISTOGRAM_SUB_BUCKET_COUNT) % LATENCY_HISTOGRAM_SUB_BUCKET_COUNT;
+	INT64 lowerBound = (LATENCY_HISTOGRAM_SUB_BUCKET_COUNT + subBucket) << shift;
+	return lowerBound + ((1LL << shift) - 1);
+}
+
+void LatencyHistogram::Record(_In_ INT64 value)
+{
+	value = max(0, value);
+	m_Buckets[GetBucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+	m_Total.fetch_add(value, std::memory_order_relaxed);
+}
+
+LATENCY_HISTOGRAM_SNAPSHOT LatencyHistogram::GetSnapshot() const
+{
+	//The buckets are copied first, so the percentiles are calculated from a consistent set of counts even while values are recorded.
+	std::vector<INT64> buckets(LATENCY_HISTOGRAM_BUCKET_COUNT);
+	INT64 count = 0;
+	for (int i = 0; i < LATENCY_HISTOGRAM_BUCKET_COUNT; i++) {
+		buckets[i] = m_Buckets[i].load(std::memory_order_relaxed);
+		count += buckets[i];
+	}
+	LATENCY_HISTOGRAM_SNAPSHOT snapshot{};
+	snapshot.Count = count;
+	if (count == 0) {
+		return snapshot;
+	}
+	snapshot.Mean = static_cast<double>(m_Total.load(std::memory_order_relaxed)) / count;
+	auto GetPercentile([&](double percentile) {
+		INT64 rank = max(1, static_cast<INT64>(ceil(percentile / 100.0 * count)));
+		INT64 seen = 0;
+		for (int i = 0; i < LATENCY_HISTOGRAM_BUCKET_COUNT; i++) {
+			seen += buckets[i];
+			if (seen >= rank) {
+				return GetBucketUpperBound(i);
+			}
+		}
+		return GetBucketUpperBound(LATENCY_HISTOGRAM_BUCKET_COUNT - 1);
+	});
+	snapshot.Min = GetPercentile(0);
+	snapshot.P50 = GetPercentile(50);
+	snapshot.P90 = GetPercentile(90);
+	snapshot.P99 = GetPercentile(99);
+	snapshot.Max = GetPercentile(100);
+	return snapshot;
+}
+
+LatencyTimer::LatencyTimer(_In_ LatencyHistogram &histogram) :
+	m_Histogram(&histogram),
+	m_StartTime{ 0 }
+{
+	QueryPerformanceCounter(&m_StartTime);
+}
+
+LatencyTimer::~LatencyTimer()
+{
+	Stop();
+}
+
+void LatencyTimer::Stop()
+{
+	if (m_Histogram) {
+		LARGE_INTEGER endTime;
+		QueryPerformanceCounter(&endTime);
+		m_Histogram->Record(QPCTicksToHundredNanos(endTime.QuadPart - m_StartTime.QuadPart));
+		m_Histogram = nullptr;
+	}
+}
+
+MetricsRegistry::MetricsRegistry() :
+	m_StartTime{ 0 },
+	m_Mutex{},
+	m_Counters{},
+	m_Gauges{},
+	m_Histograms{}
+{
+	QueryPerformanceCounter(&m_StartTime);
+}
+
+template <typename T>
+static T &GetOrCreateMetric(_Inout_ std::map<std::pair<std::wstring, std::wstring>, std::unique_ptr<T>> &metrics, _In_ const std::wstring &name, _In_ const std::wstring &source)
+{
+	std::unique_ptr<T> &pMetric = metrics[std::make_pair(name, source)];
+	if (!pMetric) {
+		pMetric = std::make_unique<T>();
+	}
+	return *pMetric;
+}
+
+MetricCounter &MetricsRegistry::GetCounter(_In_ const std::wstring &name, _In_ const std::wstring &source)
+{
+	std::scoped_lock lock(m_Mutex);
+	return GetOrCreateMetric(m_Counters, name, source);
+}
+
+MetricGauge &MetricsRegistry::GetGauge(_In_ const std::wstring &name, _In_ const std::wstring &source)
+{
+	std::scoped_lock lock(m_Mutex);
+	return GetOrCreateMetric(m_Gauges, name, source);
+}
+
+LatencyHistogram &MetricsRegistry::GetHistogram(_In_ const std::wstring &name, _In_ const std::wstring &source)
+{
+	std::scoped_lock lock(m_Mutex);
+	return GetOrCreateMetric(m_Histograms, name, source);
+}
+
+METRICS_SNAPSHOT MetricsRegistry::GetSnapshot()
+{
+	METRICS_SNAPSHOT snapshot{};
+	LARGE_INTEGER now;
+	QueryPerformanceCounter(&now);
+	snapshot.ElapsedTime = QPCTicksToHundredNanos(now.QuadPart - m_StartTime.QuadPart);
+
+	std::scoped_lock lock(m_Mutex);
+	for each (const auto &counter in m_Counters)
+	{
+		snapshot.Metrics.push_back(METRIC_SNAPSHOT{ counter.first.first, counter.first.second, MetricType::Counter, static_cast<double>(counter.second->GetValue()) });
+	}
+	for each (const auto &gauge in m_Gauges)
+	{
+		snapshot.Metrics.push_back(METRIC_SNAPSHOT{ gauge.first.first, gauge.first.second, MetricType::Gauge, gauge.second->GetValue() });
+	}
+	for each (const auto &histogram in m_Histograms)
+	{
+		snapshot.Metrics.push_back(METRIC_SNAPSHOT{ histogram.first.first, histogram.first.second, MetricType::Histogram, 0, histogram.second->GetSnapshot() });
+	}
+	std::sort(snapshot.Metrics.begin(), snapshot.Metrics.end(), [](const METRIC_SNAPSHOT &a, const METRIC_SNAPSHOT &b) {
+		return a.Name != b.Name ? a.Name < b.Name : a.Source < b.Source;
+	});
+	return snapshot;
+}
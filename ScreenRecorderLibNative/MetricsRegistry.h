@@ -0,0 +1,154 @@
+#pragma once
+#include <Windows.h>
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+//Values below twice the sub-bucket count are counted exactly. Above that, each power of two is split into this many buckets, which keeps the relative error of a value below 1/16.
+#define LATENCY_HISTOGRAM_SUB_BUCKET_BITS 4
+#define LATENCY_HISTOGRAM_SUB_BUCKET_COUNT (1 << LATENCY_HISTOGRAM_SUB_BUCKET_BITS)
+//Number of buckets needed to cover all positive INT64 values
+#define LATENCY_HISTOGRAM_BUCKET_COUNT (2 * LATENCY_HISTOGRAM_SUB_BUCKET_COUNT + (63 - LATENCY_HISTOGRAM_SUB_BUCKET_BITS - 1) * LATENCY_HISTOGRAM_SUB_BUCKET_COUNT)
+
+enum class MetricType {
+	Counter,
+	Gauge,
+	Histogram
+};
+
+struct LATENCY_HISTOGRAM_SNAPSHOT {
+	// Number of recorded values
+	INT64 Count;
+	// Mean of the recorded values, in 100 nanosecond units
+	double Mean;
+	// Percentiles, minimum and maximum in 100 nanosecond units. These are the upper bounds of the buckets the values fell in, so they are at most 1/16 higher than the recorded values.
+	INT64 Min;
+	INT64 P50;
+	INT64 P90;
+	INT64 P99;
+	INT64 Max;
+};
+
+struct METRIC_SNAPSHOT {
+	std::wstring Name;
+	// The source the metric is broken down by, like the ID of a recording source, or empty for metrics of the whole recording
+	std::wstring Source;
+	MetricType Type;
+	// Value of a counter or gauge
+	double Value;
+	// Statistics of a histogram
+	LATENCY_HISTOGRAM_SNAPSHOT Histogram;
+};
+
+struct METRICS_SNAPSHOT {
+	// Time since the registry was created, in 100 nanosecond units. Counters can be divided by it to get rates.
+	INT64 ElapsedTime;
+	// All metrics, sorted by name and source
+	std::vector<METRIC_SNAPSHOT> Metrics;
+	/// <summary>
+	/// Returns the metric with the name and source, or nullptr if there is none.
+	/// </summary>
+	const METRIC_SNAPSHOT *Find(_In_ const std::wstring &name, _In_ const std::wstring &source = L"") const;
+};
+
+//
+// A count of events that only increases. Updating it is a single atomic add.
+//
+class MetricCounter
+{
+public:
+	MetricCounter() : m_Value(0) {}
+	inline void Add(_In_ INT64 value = 1) { m_Value.fetch_add(value, std::memory_order_relaxed); }
+	inline INT64 GetValue() const { return m_Value.load(std::memory_order_relaxed); }
+private:
+	std::atomic<INT64> m_Value;
+};
+
+//
+// The latest value of a measurement, like a queue depth or frame rate. Updating it is a single atomic store.
+//
+class MetricGauge
+{
+public:
+	MetricGauge() : m_Value(0) {}
+	inline void Set(_In_ double value) { m_Value.store(value, std::memory_order_relaxed); }
+	inline double GetValue() const { return m_Value.load(std::memory_order_relaxed); }
+private:
+	std::atomic<double> m_Value;
+};
+
+//
+// Histogram of durations in 100 nanosecond units, with log-linear buckets in the style of HdrHistogram.
+// Recording a value is two atomic adds, so it never waits on readers or other writers.
+//
+class LatencyHistogram
+{
+public:
+	LatencyHistogram();
+	/// <summary>
+	/// Records a duration in 100 nanosecond units. Negative durations are recorded as 0.
+	/// </summary>
+	void Record(_In_ INT64 value);
+	LATENCY_HISTOGRAM_SNAPSHOT GetSnapshot() const;
+	static int GetBucketIndex(_In_ INT64 value);
+	/// <summary>
+	/// Returns the highest value counted in the bucket.
+	/// </summary>
+	static INT64 GetBucketUpperBound(_In_ int index);
+private:
+	std::atomic<INT64> m_Buckets[LATENCY_HISTOGRAM_BUCKET_COUNT];
+	std::atomic<INT64> m_Total;
+};
+
+//
+// Records the time from construction until destruction in a latency histogram.
+//
+class LatencyTimer
+{
+public:
+	LatencyTimer(_In_ LatencyHistogram &histogram);
+	~LatencyTimer();
+	/// <summary>
+	/// Records the time before the end of the scope. Only the first call records.
+	/// </summary>
+	void Stop();
+private:
+	LatencyHistogram *m_Histogram;
+	LARGE_INTEGER m_StartTime;
+};
+
+/// <summary>
+/// Converts a QueryPerformanceCounter duration to 100 nanosecond units.
+/// </summary>
+INT64 QPCTicksToHundredNanos(_In_ INT64 ticks);
+
+//
+// Named counters, gauges and latency histograms of a recording, optionally broken down by source.
+// Components look up their metrics once and keep the references, which stay valid for the lifetime of the registry.
+// Looking up a metric takes a lock, but updating it never does, so metrics can be updated from any thread on the hot path.
+//
+class MetricsRegistry
+{
+public:
+	MetricsRegistry();
+	/// <summary>
+	/// Gets the counter with the name and source, creating it if it does not exist.
+	/// </summary>
+	MetricCounter &GetCounter(_In_ const std::wstring &name, _In_ const std::wstring &source = L"");
+	MetricGauge &GetGauge(_In_ const std::wstring &name, _In_ const std::wstring &source = L"");
+	LatencyHistogram &GetHistogram(_In_ const std::wstring &name, _In_ const std::wstring &source = L"");
+	/// <summary>
+	/// Reads the current value of all metrics. Can be called from any thread while the metrics are updated.
+	/// </summary>
+	METRICS_SNAPSHOT GetSnapshot();
+private:
+	typedef std::pair<std::wstring, std::wstring> MetricKey;
+	LARGE_INTEGER m_StartTime;
+	std::mutex m_Mutex;
+	std::map<MetricKey, std::unique_ptr<MetricCounter>> m_Counters;
+	std::map<MetricKey, std::unique_ptr<MetricGauge>> m_Gauges;
+	std::map<MetricKey, std::unique_ptr<LatencyHistogram>> m_Histograms;
+};
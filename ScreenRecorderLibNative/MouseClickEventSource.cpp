@@ -0,0 +1,287 @@
+#include "MouseClickEventSource.h"
+#include "CommonTypes.h"
+#include "Log.h"
+
+#define HID_USAGE_PAGE_GENERIC 0x01
+#define HID_USAGE_GENERIC_MOUSE 0x02
+
+//Gets the raw mouse input registration of the process, if there is one. Returns false if the mouse is not registered.
+static bool GetRawMouseRegistration(_Out_ RAWINPUTDEVICE *pDevice)
+{
+	*pDevice = RAWINPUTDEVICE{};
+	UINT count = 0;
+	if (GetRegisteredRawInputDevices(nullptr, &count, sizeof(RAWINPUTDEVICE)) == (UINT)-1 || count == 0) {
+		return false;
+	}
+	std::vector<RAWINPUTDEVICE> devices(count);
+	count = GetRegisteredRawInputDevices(devices.data(), &count, sizeof(RAWINPUTDEVICE));
+	if (count == (UINT)-1) {
+		return false;
+	}
+	for (UINT i = 0; i < count; i++) {
+		if (devices[i].usUsagePage == HID_USAGE_PAGE_GENERIC && devices[i].usUsage == HID_USAGE_GENERIC_MOUSE) {
+			*pDevice = devices[i];
+			return true;
+		}
+	}
+	return false;
+}
+
+//The hook source that installed the low level mouse hook on the current thread. Low level hooks are called on the thread that installed them.
+thread_local MouseHookClickEventSource *t_HookClickEventSource = nullptr;
+
+std::unique_ptr<MouseClickEventSource> MouseClickEventSource::Create(_In_ UINT32 detectionMode)
+{
+	switch (detectionMode)
+	{
+		case MOUSE_OPTIONS::MOUSE_DETECTION_MODE_RAW_INPUT:
+			return std::make_unique<RawInputClickEventSource>();
+		case MOUSE_OPTIONS::MOUSE_DETECTION_MODE_HOOK:
+		case MOUSE_OPTIONS::MOUSE_DETECTION_MODE_POLLING:
+		default:
+			return std::make_unique<MouseHookClickEventSource>();
+	}
+}
+
+MouseClickEventSource::MouseClickEventSource() :
+	m_OnClickEvent(nullptr),
+	m_DetectionThread(nullptr),
+	m_DetectionThreadId(0),
+	m_ReadyEvent(nullptr),
+	m_RegisterResult(E_FAIL)
+{
+	m_ReadyEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+}
+
+MouseClickEventSource::~MouseClickEventSource()
+{
+	Stop();
+	CloseHandle(m_ReadyEvent);
+}
+
+HRESULT MouseClickEventSource::Start(_In_ std::function<void(const MOUSE_CLICK_EVENT &)> onClickEvent)
+{
+	if (m_DetectionThread) {
+		return S_FALSE;
+	}
+	if (!m_ReadyEvent) {
+		return E_OUTOFMEMORY;
+	}
+	m_OnClickEvent = onClickEvent;
+	m_DetectionThread = CreateThread(nullptr, 0, DetectionThreadProc, this, 0, &m_DetectionThreadId);
+	if (!m_DetectionThread) {
+		DWORD error = GetLastError();
+		LOG_ERROR(L"Failed to create mouse click detection thread: last error is %u", error);
+		return HRESULT_FROM_WIN32(error);
+	}
+	HANDLE waitHandles[] = { m_ReadyEvent, m_DetectionThread };
+	WaitForMultipleObjects(ARRAYSIZE(waitHandles), waitHandles, FALSE, INFINITE);
+	if (FAILED(m_RegisterResult)) {
+		WaitForSingleObject(m_DetectionThread, INFINITE);
+		CloseHandle(m_DetectionThread);
+		m_DetectionThread = nullptr;
+		m_DetectionThreadId = 0;
+		return m_RegisterResult;
+	}
+	LOG_INFO(L"Started mouse click detection with %ls", Name().c_str());
+	return S_OK;
+}
+
+void MouseClickEventSource::Stop()
+{
+	if (!m_DetectionThread) {
+		return;
+	}
+	PostThreadMessage(m_DetectionThreadId, WM_QUIT, 0, 0);
+	DWORD dwWaitResult = WaitForSingleObject(m_DetectionThread, 5000);
+	if (dwWaitResult != WAIT_OBJECT_0) {
+		LOG_ERROR(L"Timeout waiting for mouse click detection thread to exit.");
+	}
+	CloseHandle(m_DetectionThread);
+	m_DetectionThread = nullptr;
+	m_DetectionThreadId = 0;
+}
+
+void MouseClickEventSource::RaiseClickEvent(_In_ UINT button, _In_ bool isPressed)
+{
+	MOUSE_CLICK_EVENT clickEvent{};
+	LARGE_INTEGER timeStamp;
+	QueryPerformanceCounter(&timeStamp);
+	clickEvent.TimeStamp = timeStamp.QuadPart;
+	clickEvent.Button = button;
+	clickEvent.IsPressed = isPressed;
+	if (m_OnClickEvent) {
+		m_OnClickEvent(clickEvent);
+	}
+}
+
+DWORD WINAPI MouseClickEventSource::DetectionThreadProc(_In_ void *pParam)
+{
+	MouseClickEventSource *pSource = static_cast<MouseClickEventSource *>(pParam);
+	MSG msg;
+	//Create the message queue before signaling that the thread is ready, so Stop can always post to it.
+	PeekMessage(&msg, nullptr, WM_USER, WM_USER, PM_NOREMOVE);
+	pSource->m_RegisterResult = pSource->Register();
+	SetEvent(pSource->m_ReadyEvent);
+	if (FAILED(pSource->m_RegisterResult)) {
+		return 0;
+	}
+	while (GetMessage(&msg, nullptr, 0, 0) > 0) {
+		pSource->ProcessMessage(msg);
+		DispatchMessage(&msg);
+	}
+	pSource->Unregister();
+	LOG_INFO(L"Exiting mouse click detection thread");
+	return 0;
+}
+
+MouseHookClickEventSource::MouseHookClickEventSource() :
+	MouseClickEventSource(),
+	m_MouseHook(nullptr)
+{
+}
+
+MouseHookClickEventSource::~MouseHookClickEventSource()
+{
+	Stop();
+}
+
+HRESULT MouseHookClickEventSource::Register()
+{
+	t_HookClickEventSource = this;
+	m_MouseHook = SetWindowsHookEx(WH_MOUSE_LL, MouseHookProc, nullptr, 0);
+	if (!m_MouseHook) {
+		DWORD error = GetLastError();
+		LOG_ERROR(L"Failed to create mouse click detection hook: last error is %u", error);
+		t_HookClickEventSource = nullptr;
+		return HRESULT_FROM_WIN32(error);
+	}
+	return S_OK;
+}
+
+void MouseHookClickEventSource::Unregister()
+{
+	if (m_MouseHook) {
+		UnhookWindowsHookEx(m_MouseHook);
+		m_MouseHook = nullptr;
+	}
+	t_HookClickEventSource = nullptr;
+}
+
+LRESULT CALLBACK MouseHookClickEventSource::MouseHookProc(_In_ int nCode, _In_ WPARAM wParam, _In_ LPARAM lParam)
+{
+	if (nCode == HC_ACTION && t_HookClickEventSource) {
+		switch (wParam)
+		{
+			case WM_LBUTTONDOWN:
+				t_HookClickEventSource->RaiseClickEvent(VK_LBUTTON, true);
+				break;
+			case WM_LBUTTONUP:
+				t_HookClickEventSource->RaiseClickEvent(VK_LBUTTON, false);
+				break;
+			case WM_RBUTTONDOWN:
+				t_HookClickEventSource->RaiseClickEvent(VK_RBUTTON, true);
+				break;
+			case WM_RBUTTONUP:
+				t_HookClickEventSource->RaiseClickEvent(VK_RBUTTON, false);
+				break;
+			default:
+				break;
+		}
+	}
+	return CallNextHookEx(nullptr, nCode, wParam, lParam);
+}
+
+RawInputClickEventSource::RawInputClickEventSource() :
+	MouseClickEventSource(),
+	m_MessageWindow(nullptr),
+	m_IsRegistered(false)
+{
+}
+
+RawInputClickEventSource::~RawInputClickEventSource()
+{
+	Stop();
+}
+
+HRESULT RawInputClickEventSource::Register()
+{
+	//Raw input registrations are per process, so registering would replace a raw mouse input registration made by the host application.
+	RAWINPUTDEVICE hostDevice;
+	if (GetRawMouseRegistration(&hostDevice)) {
+		LOG_WARN(L"The application has registered for raw mouse input, so raw input is not used for mouse click detection");
+		return HRESULT_FROM_WIN32(ERROR_ALREADY_REGISTERED);
+	}
+	m_MessageWindow = CreateWindowExW(0, L"Message", nullptr, 0, 0, 0, 0, 0, HWND_MESSAGE, nullptr, nullptr, nullptr);
+	if (!m_MessageWindow) {
+		DWORD error = GetLastError();
+		LOG_ERROR(L"Failed to create mouse click detection window: last error is %u", error);
+		return HRESULT_FROM_WIN32(error);
+	}
+	RAWINPUTDEVICE device{};
+	device.usUsagePage = HID_USAGE_PAGE_GENERIC;
+	device.usUsage = HID_USAGE_GENERIC_MOUSE;
+	device.dwFlags = RIDEV_INPUTSINK;
+	device.hwndTarget = m_MessageWindow;
+	if (!RegisterRawInputDevices(&device, 1, sizeof(device))) {
+		DWORD error = GetLastError();
+		LOG_ERROR(L"Failed to register for raw mouse input: last error is %u", error);
+		DestroyWindow(m_MessageWindow);
+		m_MessageWindow = nullptr;
+		return HRESULT_FROM_WIN32(error);
+	}
+	m_IsRegistered = true;
+	return S_OK;
+}
+
+void RawInputClickEventSource::Unregister()
+{
+	//Only remove the registration made here. If the application registered the mouse since, its registration replaced this one and is kept.
+	RAWINPUTDEVICE currentDevice;
+	if (m_IsRegistered && GetRawMouseRegistration(&currentDevice) && currentDevice.hwndTarget == m_MessageWindow) {
+		RAWINPUTDEVICE device{};
+		device.usUsagePage = HID_USAGE_PAGE_GENERIC;
+		device.usUsage = HID_USAGE_GENERIC_MOUSE;
+		device.dwFlags = RIDEV_REMOVE;
+		device.hwndTarget = nullptr;
+		RegisterRawInputDevices(&device, 1, sizeof(device));
+	}
+	m_IsRegistered = false;
+	if (m_MessageWindow) {
+		DestroyWindow(m_MessageWindow);
+		m_MessageWindow = nullptr;
+	}
+}
+
+void RawInputClickEventSource::ProcessMessage(_In_ const MSG &msg)
+{
+	if (msg.message != WM_INPUT) {
+		return;
+	}
+	RAWINPUT input{};
+	UINT size = sizeof(input);
+	if (GetRawInputData(reinterpret_cast<HRAWINPUT>(msg.lParam), RID_INPUT, &input, &size, sizeof(RAWINPUTHEADER)) == (UINT)-1
+		|| input.header.dwType != RIM_TYPEMOUSE) {
+		return;
+	}
+	USHORT buttonFlags = input.data.mouse.usButtonFlags;
+	if (!(buttonFlags & (RI_MOUSE_LEFT_BUTTON_DOWN | RI_MOUSE_LEFT_BUTTON_UP | RI_MOUSE_RIGHT_BUTTON_DOWN | RI_MOUSE_RIGHT_BUTTON_UP))) {
+		return;
+	}
+	//Raw input reports the physical buttons, while clicks are drawn for the logical buttons.
+	bool isSwapped = GetSystemMetrics(SM_SWAPBUTTON) != 0;
+	UINT leftButton = isSwapped ? VK_RBUTTON : VK_LBUTTON;
+	UINT rightButton = isSwapped ? VK_LBUTTON : VK_RBUTTON;
+	if (buttonFlags & RI_MOUSE_LEFT_BUTTON_DOWN) {
+		RaiseClickEvent(leftButton, true);
+	}
+	if (buttonFlags & RI_MOUSE_LEFT_BUTTON_UP) {
+		RaiseClickEvent(leftButton, false);
+	}
+	if (buttonFlags & RI_MOUSE_RIGHT_BUTTON_DOWN) {
+		RaiseClickEvent(rightButton, true);
+	}
+	if (buttonFlags & RI_MOUSE_RIGHT_BUTTON_UP) {
+		RaiseClickEvent(rightButton, false);
+	}
+}
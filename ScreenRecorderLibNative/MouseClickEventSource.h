@@ -0,0 +1,91 @@
+#pragma once
+#include <Windows.h>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include "MouseClickEvents.h"
+
+//
+// Detects mouse button presses and releases as they happen and reports them as time stamped events.
+// Detection runs on a dedicated thread that sleeps in GetMessage until there is mouse input, so it does not wake up while the mouse is idle.
+//
+class MouseClickEventSource abstract
+{
+public:
+	MouseClickEventSource();
+	virtual ~MouseClickEventSource();
+	/// <summary>
+	/// Creates the event source for a MOUSE_OPTIONS mouse click detection mode.
+	/// </summary>
+	static std::unique_ptr<MouseClickEventSource> Create(_In_ UINT32 detectionMode);
+	/// <summary>
+	/// Starts the detection thread and waits until it is ready to detect clicks.
+	/// </summary>
+	/// <param name="onClickEvent">Called on the detection thread for each press and release.</param>
+	HRESULT Start(_In_ std::function<void(const MOUSE_CLICK_EVENT &)> onClickEvent);
+	/// <summary>
+	/// Stops the detection thread. Derived classes must stop in their destructor, as detection calls into them.
+	/// </summary>
+	void Stop();
+	virtual std::wstring Name() = 0;
+protected:
+	/// <summary>
+	/// Called on the detection thread before it starts waiting for messages.
+	/// </summary>
+	virtual HRESULT Register() = 0;
+	/// <summary>
+	/// Called on the detection thread after it stops waiting for messages.
+	/// </summary>
+	virtual void Unregister() = 0;
+	/// <summary>
+	/// Called on the detection thread for each message it receives.
+	/// </summary>
+	virtual void ProcessMessage(_In_ const MSG &msg) {}
+	void RaiseClickEvent(_In_ UINT button, _In_ bool isPressed);
+private:
+	static DWORD WINAPI DetectionThreadProc(_In_ void *pParam);
+
+	std::function<void(const MOUSE_CLICK_EVENT &)> m_OnClickEvent;
+	HANDLE m_DetectionThread;
+	DWORD m_DetectionThreadId;
+	HANDLE m_ReadyEvent;
+	HRESULT m_RegisterResult;
+};
+
+//
+// Detects clicks with a low level mouse hook. Sees clicks generated programmatically, but every mouse event in the system waits for the hook.
+//
+class MouseHookClickEventSource : public MouseClickEventSource
+{
+public:
+	MouseHookClickEventSource();
+	virtual ~MouseHookClickEventSource();
+	virtual std::wstring Name() override { return L"MouseHookClickEventSource"; }
+protected:
+	virtual HRESULT Register() override;
+	virtual void Unregister() override;
+private:
+	static LRESULT CALLBACK MouseHookProc(_In_ int nCode, _In_ WPARAM wParam, _In_ LPARAM lParam);
+	HHOOK m_MouseHook;
+};
+
+//
+// Detects clicks with raw input from mouse devices, received in the background by a message-only window. Does not affect mouse performance.
+// Raw input allows one registration of the mouse per process, so registering fails if the host application has registered the mouse itself.
+//
+class RawInputClickEventSource : public MouseClickEventSource
+{
+public:
+	RawInputClickEventSource();
+	virtual ~RawInputClickEventSource();
+	virtual std::wstring Name() override { return L"RawInputClickEventSource"; }
+protected:
+	virtual HRESULT Register() override;
+	virtual void Unregister() override;
+	virtual void ProcessMessage(_In_ const MSG &msg) override;
+private:
+	HWND m_MessageWindow;
+	// True if the mouse was registered for raw input by this instance
+	bool m_IsRegistered;
+};
@@ -0,0 +1,97 @@
+#include "MouseClickEvents.h"
+
+MouseClickEventQueue::MouseClickEventQueue() :
+	m_Events{},
+	m_ReadCount(0),
+	m_WriteCount(0),
+	m_DroppedEventCount(0)
+{
+}
+
+bool MouseClickEventQueue::TryPush(_In_ const MOUSE_CLICK_EVENT &clickEvent)
+{
+	size_t writeCount = m_WriteCount.load(std::memory_order_relaxed);
+	if (writeCount - m_ReadCount.load(std::memory_order_acquire) >= CAPACITY) {
+		m_DroppedEventCount++;
+		return false;
+	}
+	m_Events[writeCount % CAPACITY] = clickEvent;
+	//Publish the event to the consumer only after it is written.
+	m_WriteCount.store(writeCount + 1, std::memory_order_release);
+	return true;
+}
+
+bool MouseClickEventQueue::TryPeek(_Out_ MOUSE_CLICK_EVENT *pClickEvent)
+{
+	size_t readCount = m_ReadCount.load(std::memory_order_relaxed);
+	if (readCount == m_WriteCount.load(std::memory_order_acquire)) {
+		*pClickEvent = {};
+		return false;
+	}
+	*pClickEvent = m_Events[readCount % CAPACITY];
+	return true;
+}
+
+bool MouseClickEventQueue::TryPop(_Out_ MOUSE_CLICK_EVENT *pClickEvent)
+{
+	if (!TryPeek(pClickEvent)) {
+		return false;
+	}
+	//Hand the slot back to the producer only after the event is copied out.
+	m_ReadCount.store(m_ReadCount.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+	return true;
+}
+
+void MouseClickEventQueue::Clear()
+{
+	m_ReadCount.store(m_WriteCount.load(std::memory_order_acquire), std::memory_order_release);
+}
+
+MouseClickTracker::MouseClickTracker() :
+	m_Button(0),
+	m_IsHeld(false),
+	m_ReleaseTimeStamp(0),
+	m_LastDroppedEventCount(0)
+{
+}
+
+void MouseClickTracker::Update(_Inout_ MouseClickEventQueue &queue, _In_ INT64 frameTimeStamp)
+{
+	INT64 droppedEventCount = queue.GetDroppedEventCount();
+	if (droppedEventCount != m_LastDroppedEventCount) {
+		//The release of a held button may have been dropped, so it can no longer be trusted to be held.
+		m_LastDroppedEventCount = droppedEventCount;
+		m_IsHeld = false;
+		m_Button = 0;
+	}
+	MOUSE_CLICK_EVENT clickEvent;
+	while (queue.TryPeek(&clickEvent) && clickEvent.TimeStamp <= frameTimeStamp) {
+		queue.TryPop(&clickEvent);
+		if (clickEvent.IsPressed) {
+			m_Button = clickEvent.Button;
+			m_IsHeld = true;
+		}
+		else if (clickEvent.Button == m_Button && m_IsHeld) {
+			m_IsHeld = false;
+			m_ReleaseTimeStamp = clickEvent.TimeStamp;
+		}
+	}
+}
+
+UINT MouseClickTracker::GetClickedButton(_In_ INT64 frameTimeStamp, _In_ INT64 clickDuration)
+{
+	if (m_Button == 0) {
+		return 0;
+	}
+	if (m_IsHeld || frameTimeStamp < m_ReleaseTimeStamp + clickDuration) {
+		return m_Button;
+	}
+	return 0;
+}
+
+void MouseClickTracker::Reset()
+{
+	m_Button = 0;
+	m_IsHeld = false;
+	m_ReleaseTimeStamp = 0;
+}
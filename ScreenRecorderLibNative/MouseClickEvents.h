@@ -0,0 +1,79 @@
+#pragma once
+#include <Windows.h>
+#include <atomic>
+
+struct MOUSE_CLICK_EVENT {
+	// QueryPerformanceCounter time of the event
+	INT64 TimeStamp{};
+	// VK_LBUTTON or VK_RBUTTON
+	UINT Button{};
+	// True when the button was pressed, false when it was released
+	bool IsPressed{};
+};
+
+//
+// Fixed size queue that hands mouse click events from the thread that detects them to the thread that renders them.
+// Safe for one producer thread and one consumer thread at the same time, without locks. Events pushed while the queue is full are dropped.
+//
+class MouseClickEventQueue
+{
+public:
+	static const size_t CAPACITY = 256;
+
+	MouseClickEventQueue();
+	/// <summary>
+	/// Adds an event to the queue. Must only be called from the producer thread.
+	/// </summary>
+	/// <returns>False if the queue is full and the event was dropped.</returns>
+	bool TryPush(_In_ const MOUSE_CLICK_EVENT &clickEvent);
+	/// <summary>
+	/// Gets the oldest event without removing it. Must only be called from the consumer thread.
+	/// </summary>
+	bool TryPeek(_Out_ MOUSE_CLICK_EVENT *pClickEvent);
+	/// <summary>
+	/// Removes and returns the oldest event. Must only be called from the consumer thread.
+	/// </summary>
+	bool TryPop(_Out_ MOUSE_CLICK_EVENT *pClickEvent);
+	/// <summary>
+	/// Removes all events. Must only be called from the consumer thread.
+	/// </summary>
+	void Clear();
+
+	/// <summary>Number of events dropped because the queue was full.</summary>
+	inline INT64 GetDroppedEventCount() { return m_DroppedEventCount; }
+private:
+	MOUSE_CLICK_EVENT m_Events[CAPACITY];
+	//Total number of events read. Only written by the consumer.
+	std::atomic<size_t> m_ReadCount;
+	//Total number of events written. Only written by the producer.
+	std::atomic<size_t> m_WriteCount;
+	std::atomic<INT64> m_DroppedEventCount;
+};
+
+//
+// Consumes mouse click events up to the time stamp of each rendered frame, and tracks which button click should be drawn on it.
+// Events newer than the frame are left in the queue, so a click is first drawn on the frame where it happened.
+//
+class MouseClickTracker
+{
+public:
+	MouseClickTracker();
+	/// <summary>
+	/// Applies all queued events up to and including the frame time stamp.
+	/// </summary>
+	/// <param name="queue">The queue to consume events from</param>
+	/// <param name="frameTimeStamp">QueryPerformanceCounter time of the frame</param>
+	void Update(_Inout_ MouseClickEventQueue &queue, _In_ INT64 frameTimeStamp);
+	/// <summary>
+	/// Returns the button whose click should be drawn on the frame, or 0 if none. A click is drawn while the button is held, and for the given duration after it is released.
+	/// </summary>
+	/// <param name="frameTimeStamp">QueryPerformanceCounter time of the frame</param>
+	/// <param name="clickDuration">How long a click is drawn after the button is released, in QueryPerformanceCounter ticks</param>
+	UINT GetClickedButton(_In_ INT64 frameTimeStamp, _In_ INT64 clickDuration);
+	void Reset();
+private:
+	UINT m_Button;
+	bool m_IsHeld;
+	INT64 m_ReleaseTimeStamp;
+	INT64 m_LastDroppedEventCount;
+};
@@ -3,71 +3,45 @@
 #include "Log.h"
 #include "Util.h"
 #include "Cleanup.h"
-#include <concrt.h>
-#include <ppltasks.h>
+#include "CursorRasterizer.h"
+#include "CursorMetadata.h"
+#include <algorithm>
 
 using namespace DirectX;
-using namespace Concurrency;
 using namespace std;
 
 #pragma comment(lib, "comctl32.lib")
 #pragma comment(lib, "D2d1.lib")
 
-#define ET_QUITLOOP WM_USER+1
-
-INT64 g_LastMouseClickDurationRemaining = 0;
-INT g_MouseClickDetectionDurationMillis = 50;
-UINT g_LastMouseClickButton = 0;
-
-
-DWORD WINAPI MouseHookThreadProc(_In_ void *Param) {
-	HHOOK mouseHook = SetWindowsHookEx(WH_MOUSE_LL, MouseHookProc, nullptr, 0);
-	MSG msg;
-	while (true) {
-		GetMessage(&msg, NULL, 0, 0);
-		if (msg.message == ET_QUITLOOP) {
-			break;
-		}
-	}
-	UnhookWindowsHookEx(mouseHook);
-	LOG_INFO("Exiting mouse click hook thread");
-	return 0;
-}
-LRESULT CALLBACK MouseHookProc(int nCode, WPARAM wParam, LPARAM lParam)
-{
-	// MB1 click
-	if (wParam == WM_LBUTTONDOWN)
-	{
-		g_LastMouseClickButton = VK_LBUTTON;
-		g_LastMouseClickDurationRemaining = g_MouseClickDetectionDurationMillis;
-	}
-	else if (wParam == WM_RBUTTONDOWN)
-	{
-		g_LastMouseClickButton = VK_RBUTTON;
-		g_LastMouseClickDurationRemaining = g_MouseClickDetectionDurationMillis;
-	}
-	return CallNextHookEx(0, nCode, wParam, lParam);
-}
-
 MouseManager::MouseManager() :
 	m_MouseOptions(nullptr),
 	m_DeviceContext(nullptr),
 	m_Device(nullptr),
-	m_StopPollingTaskEvent(nullptr),
-	m_LastMouseDrawTimeStamp(std::chrono::steady_clock::now()),
 	m_IsCapturingMouseClicks(false),
-	m_MouseHookThread(nullptr),
-	m_MouseHookThreadId(0),
-	m_TextureManager(nullptr)
+	m_MouseClickEventSource(nullptr),
+	m_MouseClickEvents{},
+	m_MouseClickTracker{},
+	m_QPCFrequency{},
+	m_TextureManager(nullptr),
+	m_PointerStagingTexture(nullptr),
+	m_PointerUploadTexture(nullptr),
+	m_PointerShapeCache{},
+	m_PointerShapeCacheClock(0),
+	m_CurrentPointerShapeKey(std::nullopt),
+	m_CurrentPointerShapeUpdateCount(0),
+	m_CurrentPointerShapeBuffer(nullptr),
+	m_PointerShapeCacheHits(0),
+	m_PointerShapeCacheMisses(0),
+	m_CursorMetadataWriter(nullptr)
 {
 	InitializeCriticalSection(&m_CriticalSection);
+	QueryPerformanceFrequency(&m_QPCFrequency);
 }
 
 MouseManager::~MouseManager()
 {
 	CleanDX();
 	StopMouseClickDetection();
-	CloseHandle(m_StopPollingTaskEvent);
 	DeleteCriticalSection(&m_CriticalSection);
 }
 
@@ -113,8 +87,6 @@ HRESULT MouseManager::Initialize(_In_ ID3D11DeviceContext *pDeviceContext, _In_
 	m_MouseOptions = pOptions;
 
 	StopMouseClickDetection();
-	CloseHandle(m_StopPollingTaskEvent);
-	m_StopPollingTaskEvent = CreateEvent(nullptr, TRUE, FALSE, nullptr);
 	InitializeMouseClickDetection();
 	return hr;
 }
@@ -123,45 +95,21 @@ void MouseManager::InitializeMouseClickDetection()
 {
 	if (m_MouseOptions->IsMouseClicksDetected()) {
 		if (!m_IsCapturingMouseClicks) {
-			switch (m_MouseOptions->GetMouseClickDetectionMode())
-			{
-				default:
-				case MOUSE_OPTIONS::MOUSE_DETECTION_MODE_POLLING: {
-					ResetEvent(m_StopPollingTaskEvent);
-					m_MousePollingThread = std::thread([this] {
-						LOG_INFO("Starting mouse click polling task");
-						while (true) {
-							if (GetKeyState(VK_LBUTTON) < 0)
-							{
-								//If left mouse button is held, reset the duration of click duration
-								g_LastMouseClickButton = VK_LBUTTON;
-								g_LastMouseClickDurationRemaining = g_MouseClickDetectionDurationMillis;
-							}
-							else if (GetKeyState(VK_RBUTTON) < 0)
-							{
-								//If right mouse button is held, reset the duration of click duration
-								g_LastMouseClickButton = VK_RBUTTON;
-								g_LastMouseClickDurationRemaining = g_MouseClickDetectionDurationMillis;
-							}
-
-							if (WaitForSingleObjectEx(m_StopPollingTaskEvent, 0, FALSE) == WAIT_OBJECT_0) {
-								break;
-							}
-							wait(1);
-						}
-						LOG_INFO("Exiting mouse click polling task");
-
-						});
-					m_IsCapturingMouseClicks = true;
-					break;
-				}
-				case MOUSE_OPTIONS::MOUSE_DETECTION_MODE_HOOK: {
-					m_MouseHookThread = CreateThread(nullptr, 0, MouseHookThreadProc, nullptr, 0, &m_MouseHookThreadId);
-					m_IsCapturingMouseClicks = true;
-					LOG_INFO("Created mouse click detection hook");
-					break;
-				}
+			m_MouseClickEventSource = MouseClickEventSource::Create(m_MouseOptions->GetMouseClickDetectionMode());
+			HRESULT hr = m_MouseClickEventSource->Start([this](const MOUSE_CLICK_EVENT &clickEvent) { OnMouseClickEvent(clickEvent); });
+			if (FAILED(hr) && m_MouseOptions->GetMouseClickDetectionMode() == MOUSE_OPTIONS::MOUSE_DETECTION_MODE_RAW_INPUT) {
+				//Raw input is unavailable if the application has registered the mouse, so fall back to the hook.
+				LOG_WARN(L"Failed to start raw input mouse click detection, falling back to the mouse hook");
+				m_MouseClickEventSource = MouseClickEventSource::Create(MOUSE_OPTIONS::MOUSE_DETECTION_MODE_HOOK);
+				hr = m_MouseClickEventSource->Start([this](const MOUSE_CLICK_EVENT &clickEvent) { OnMouseClickEvent(clickEvent); });
 			}
+			if (FAILED(hr)) {
+				_com_error err(hr);
+				LOG_ERROR(L"Failed to start mouse click detection: %ls", err.ErrorMessage());
+				m_MouseClickEventSource.reset();
+			}
+			//Do not retry on every frame if detection failed to start.
+			m_IsCapturingMouseClicks = true;
 		}
 	}
 	else if (m_IsCapturingMouseClicks) {
@@ -171,22 +119,39 @@ void MouseManager::InitializeMouseClickDetection()
 
 void MouseManager::StopMouseClickDetection()
 {
-	if (m_MouseHookThread) {
-		PostThreadMessageA(m_MouseHookThreadId, ET_QUITLOOP, 0, 0);
-		DWORD dwWaitResult = WaitForSingleObjectEx(m_MouseHookThread, 5000, false);
-		if (dwWaitResult != WAIT_OBJECT_0) {
-			LOG_ERROR("Timeout waiting for mouse hook thread to exit.");
-		}
-		m_MouseHookThread = nullptr;
-		m_MouseHookThreadId = 0;
+	if (m_MouseClickEventSource) {
+		m_MouseClickEventSource->Stop();
+		m_MouseClickEventSource.reset();
 	}
-	if (m_MousePollingThread.joinable()) {
-		SetEvent(m_StopPollingTaskEvent);
-		m_MousePollingThread.join();
+	if (m_MouseClickEvents.GetDroppedEventCount() > 0) {
+		LOG_WARN(L"Dropped %lld mouse click events that were not drawn in time", m_MouseClickEvents.GetDroppedEventCount());
 	}
+	m_MouseClickEvents.Clear();
+	m_MouseClickTracker.Reset();
 	m_IsCapturingMouseClicks = false;
 }
 
+//
+// Called on the mouse click detection thread for each button press and release.
+//
+void MouseManager::OnMouseClickEvent(_In_ const MOUSE_CLICK_EVENT &clickEvent)
+{
+	std::shared_ptr<CursorMetadataWriter> pWriter = std::atomic_load(&m_CursorMetadataWriter);
+	if (pWriter) {
+		//Clicks are recorded as metadata instead of drawn on the frames.
+		if (clickEvent.IsPressed) {
+			LOG_ON_BAD_HR(pWriter->WriteClick(clickEvent.Button));
+		}
+		return;
+	}
+	m_MouseClickEvents.TryPush(clickEvent);
+}
+
+void MouseManager::SetCursorMetadataWriter(_In_opt_ std::shared_ptr<CursorMetadataWriter> pWriter)
+{
+	std::atomic_store(&m_CursorMetadataWriter, pWriter);
+}
+
 HRESULT MouseManager::InitMouseClickTexture(_In_ ID3D11DeviceContext *pDeviceContext, _In_ ID3D11Device *pDevice) {
 	HRESULT hr = D2D1CreateFactory(D2D1_FACTORY_TYPE_SINGLE_THREADED, __uuidof(ID2D1Factory), (void **)&m_D2DFactory);
 	return hr;
@@ -232,32 +197,35 @@ void MouseManager::GetPointerPosition(_In_ PTR_INFO *pPtrInfo, DXGI_MODE_ROTATIO
 	}
 }
 
-HRESULT MouseManager::ProcessMousePointer(_In_ ID3D11Texture2D *pFrame, _In_ PTR_INFO *pPtrInfo)
+HRESULT MouseManager::ProcessMousePointer(_In_ ID3D11Texture2D *pFrame, _In_ PTR_INFO *pPtrInfo, _In_ INT64 frameTimeStamp)
 {
 	HRESULT hr = S_FALSE;
 	EnterCriticalSection(&m_CriticalSection);
 	LeaveCriticalSectionOnExit leaveOnExit(&m_CriticalSection);
 	InitializeMouseClickDetection();
-	if (g_LastMouseClickDurationRemaining > 0
-		&& m_MouseOptions->IsMouseClicksDetected())
+	if (m_MouseOptions->IsMouseClicksDetected())
 	{
-		if (g_LastMouseClickButton == VK_LBUTTON)
+		if (frameTimeStamp <= 0) {
+			LARGE_INTEGER now;
+			QueryPerformanceCounter(&now);
+			frameTimeStamp = now.QuadPart;
+		}
+		INT64 clickDuration = m_MouseOptions->GetMouseClickDetectionDurationMillis() * m_QPCFrequency.QuadPart / 1000;
+		m_MouseClickTracker.Update(m_MouseClickEvents, frameTimeStamp);
+		UINT clickedButton = m_MouseClickTracker.GetClickedButton(frameTimeStamp, clickDuration);
+		if (clickedButton == VK_LBUTTON)
 		{
 			hr = DrawMouseClick(pPtrInfo, pFrame, m_MouseOptions->GetMouseClickDetectionLMBColor(), (float)m_MouseOptions->GetMouseClickDetectionRadius(), DXGI_MODE_ROTATION_UNSPECIFIED);
 		}
-		if (g_LastMouseClickButton == VK_RBUTTON)
+		else if (clickedButton == VK_RBUTTON)
 		{
 			hr = DrawMouseClick(pPtrInfo, pFrame, m_MouseOptions->GetMouseClickDetectionRMBColor(), (float)m_MouseOptions->GetMouseClickDetectionRadius(), DXGI_MODE_ROTATION_UNSPECIFIED);
 		}
-		INT64 millisSinceLastMouseDraw = (INT64)max(0, (std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - m_LastMouseDrawTimeStamp).count()));
-		g_LastMouseClickDurationRemaining = max(g_LastMouseClickDurationRemaining - millisSinceLastMouseDraw, 0);
-		LOG_TRACE("Drawing mouse click, duration remaining on click is %u ms", g_LastMouseClickDurationRemaining);
 	}
 
 	if (m_MouseOptions->IsMousePointerEnabled()) {
 		hr = DrawMousePointer(pPtrInfo, pFrame, DXGI_MODE_ROTATION_UNSPECIFIED);
 	}
-	m_LastMouseDrawTimeStamp = std::chrono::steady_clock::now();
 	return hr;
 }
 
@@ -331,12 +299,10 @@ HRESULT MouseManager::DrawMousePointer(_In_ PTR_INFO *pPtrInfo, _Inout_ ID3D11Te
 	if (!pPtrInfo || !pPtrInfo->Visible || pPtrInfo->PtrShapeBuffer == nullptr)
 		return S_FALSE;
 	// Vars to be used
-	ID3D11Texture2D *MouseTex = nullptr;
-	ID3D11ShaderResourceView *ShaderRes = nullptr;
+	CComPtr<ID3D11Texture2D> MouseTex = nullptr;
+	CComPtr<ID3D11ShaderResourceView> ShaderRes = nullptr;
 	ID3D11Buffer *VertexBufferMouse = nullptr;
 	D3D11_SUBRESOURCE_DATA InitData = { 0 };
-	D3D11_TEXTURE2D_DESC Desc = { 0 };
-	D3D11_SHADER_RESOURCE_VIEW_DESC SDesc;
 	D3D11_TEXTURE2D_DESC DesktopDesc = { 0 };
 	pBgTexture->GetDesc(&DesktopDesc);
 	// Position will be changed based on mouse position
@@ -366,22 +332,7 @@ HRESULT MouseManager::DrawMousePointer(_In_ PTR_INFO *pPtrInfo, _Inout_ ID3D11Te
 	// Buffer used if necessary (in case of monochrome or masked pointer)
 	BYTE *InitBuffer = nullptr;
 
-	Desc.MipLevels = 1;
-	Desc.ArraySize = 1;
-	Desc.Format = DXGI_FORMAT_B8G8R8A8_UNORM;
-	Desc.SampleDesc.Count = 1;
-	Desc.SampleDesc.Quality = 0;
-	Desc.Usage = D3D11_USAGE_DEFAULT;
-	Desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
-	Desc.CPUAccessFlags = 0;
-	Desc.MiscFlags = 0;
-
-	// Set shader resource properties
-	SDesc.Format = Desc.Format;
-	SDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
-	SDesc.Texture2D.MostDetailedMip = Desc.MipLevels - 1;
-	SDesc.Texture2D.MipLevels = Desc.MipLevels;
-
+	bool isCached = false;
 	switch (pPtrInfo->ShapeInfo.Type)
 	{
 		case DXGI_OUTDUPL_POINTER_SHAPE_TYPE_COLOR:
@@ -389,16 +340,24 @@ HRESULT MouseManager::DrawMousePointer(_In_ PTR_INFO *pPtrInfo, _Inout_ ID3D11Te
 			PtrWidth = static_cast<INT>(pPtrInfo->ShapeInfo.Width);
 			PtrHeight = static_cast<INT>(pPtrInfo->ShapeInfo.Height);
 			GetPointerPosition(pPtrInfo, rotation, DesktopWidth, DesktopHeight, &PtrLeft, &PtrTop);
+			isCached = true;
 			break;
 		}
 		case DXGI_OUTDUPL_POINTER_SHAPE_TYPE_MONOCHROME:
-		{
-			ProcessMonoMask(pBgTexture, rotation, true, pPtrInfo, &PtrWidth, &PtrHeight, &PtrLeft, &PtrTop, &InitBuffer);
-			break;
-		}
 		case DXGI_OUTDUPL_POINTER_SHAPE_TYPE_MASKED_COLOR:
 		{
-			ProcessMonoMask(pBgTexture, rotation, false, pPtrInfo, &PtrWidth, &PtrHeight, &PtrLeft, &PtrTop, &InitBuffer);
+			bool isMono = pPtrInfo->ShapeInfo.Type == DXGI_OUTDUPL_POINTER_SHAPE_TYPE_MONOCHROME;
+			UINT shapeHeight = isMono ? pPtrInfo->ShapeInfo.Height / 2 : pPtrInfo->ShapeInfo.Height;
+			if (IsCursorBackgroundDependent(isMono, pPtrInfo->PtrShapeBuffer, pPtrInfo->ShapeInfo.Pitch, pPtrInfo->ShapeInfo.Width, shapeHeight)) {
+				ProcessMonoMask(pBgTexture, rotation, isMono, pPtrInfo, &PtrWidth, &PtrHeight, &PtrLeft, &PtrTop, &InitBuffer);
+			}
+			else {
+				//The pointer looks the same on any background, so it can be rasterized once and cached like a color pointer.
+				PtrWidth = static_cast<INT>(pPtrInfo->ShapeInfo.Width);
+				PtrHeight = static_cast<INT>(shapeHeight);
+				GetPointerPosition(pPtrInfo, rotation, DesktopWidth, DesktopHeight, &PtrLeft, &PtrTop);
+				isCached = true;
+			}
 			break;
 		}
 		default:
@@ -409,15 +368,14 @@ HRESULT MouseManager::DrawMousePointer(_In_ PTR_INFO *pPtrInfo, _Inout_ ID3D11Te
 	if (PtrWidth <= 0 || PtrHeight <= 0 || unsigned(PtrWidth) > DesktopDesc.Width || unsigned(PtrHeight) > DesktopDesc.Height) {
 		return S_FALSE;
 	}
-
-	// Set original texture properties
-	Desc.Width = PtrWidth;
-	Desc.Height = PtrHeight;
-
-	// Set up init data
-	InitData.pSysMem = (pPtrInfo->ShapeInfo.Type == DXGI_OUTDUPL_POINTER_SHAPE_TYPE_COLOR) ? pPtrInfo->PtrShapeBuffer : InitBuffer;
-	InitData.SysMemPitch = (pPtrInfo->ShapeInfo.Type == DXGI_OUTDUPL_POINTER_SHAPE_TYPE_COLOR) ? pPtrInfo->ShapeInfo.Pitch : PtrWidth * BPP;
-	InitData.SysMemSlicePitch = 0;
+	HRESULT hr = S_OK;
+	if (isCached) {
+		RETURN_ON_BAD_HR(hr = GetCachedPointerTexture(pPtrInfo, &MouseTex, &ShaderRes));
+	}
+	else {
+		// Upload the pointer rasterized against the current background
+		RETURN_ON_BAD_HR(hr = UploadPointerTexture(InitBuffer, PtrWidth, PtrHeight, &MouseTex));
+	}
 
 	// Scaled width and height
 	PtrWidth = static_cast<int>(round(PtrWidth * pPtrInfo->Scale.cx));
@@ -471,30 +429,20 @@ HRESULT MouseManager::DrawMousePointer(_In_ PTR_INFO *pPtrInfo, _Inout_ ID3D11Te
 	Vertices[4].Pos.x = Vertices[1].Pos.x;
 	Vertices[4].Pos.y = Vertices[1].Pos.y;
 
-	// Create mouseshape as texture
-	HRESULT hr = m_Device->CreateTexture2D(&Desc, &InitData, &MouseTex);
-	if (FAILED(hr))
-	{
-		_com_error err(hr);
-		LOG_ERROR(L"Failed to create mouse pointer texture: %ls", err.ErrorMessage());
-		return hr;
-	}
-
-	if (pPtrInfo->Scale.cx != 1.0 || pPtrInfo->Scale.cy != 1.0) {
-		ID3D11Texture2D *pResizedTexture;
-		RETURN_ON_BAD_HR(hr = m_TextureManager->ResizeTexture(MouseTex, SIZE{ PtrWidth,PtrHeight }, TextureStretchMode::Uniform, &pResizedTexture));
-		SafeRelease(&MouseTex);
-		MouseTex = pResizedTexture;
-	}
-	// Create shader resource from texture
-	hr = m_Device->CreateShaderResourceView(MouseTex, &SDesc, &ShaderRes);
-	if (FAILED(hr))
-	{
-		MouseTex->Release();
-		MouseTex = nullptr;
-		_com_error err(hr);
-		LOG_ERROR(L"Failed to create shader resource from mouse pointer texture: %ls", err.ErrorMessage());
-		return hr;
+	if (!isCached) {
+		if (pPtrInfo->Scale.cx != 1.0 || pPtrInfo->Scale.cy != 1.0) {
+			CComPtr<ID3D11Texture2D> pResizedTexture;
+			RETURN_ON_BAD_HR(hr = m_TextureManager->ResizeTexture(MouseTex, SIZE{ PtrWidth,PtrHeight }, TextureStretchMode::Uniform, &pResizedTexture));
+			MouseTex = pResizedTexture;
+		}
+		// Create shader resource from texture
+		hr = m_Device->CreateShaderResourceView(MouseTex, nullptr, &ShaderRes);
+		if (FAILED(hr))
+		{
+			_com_error err(hr);
+			LOG_ERROR(L"Failed to create shader resource from mouse pointer texture: %ls", err.ErrorMessage());
+			return hr;
+		}
 	}
 
 	D3D11_BUFFER_DESC BDesc;
@@ -511,11 +459,6 @@ HRESULT MouseManager::DrawMousePointer(_In_ PTR_INFO *pPtrInfo, _Inout_ ID3D11Te
 	hr = m_Device->CreateBuffer(&BDesc, &InitData, &VertexBufferMouse);
 	if (FAILED(hr))
 	{
-		ShaderRes->Release();
-		ShaderRes = nullptr;
-		MouseTex->Release();
-		MouseTex = nullptr;
-
 		_com_error err(hr);
 		LOG_ERROR(L"Failed to create mouse pointer vertex buffer: %ls", err.ErrorMessage());
 		return hr;
@@ -532,7 +475,7 @@ HRESULT MouseManager::DrawMousePointer(_In_ PTR_INFO *pPtrInfo, _Inout_ ID3D11Te
 	m_DeviceContext->OMSetRenderTargets(1, &RTV, nullptr);
 	m_DeviceContext->VSSetShader(m_VertexShader, nullptr, 0);
 	m_DeviceContext->PSSetShader(m_PixelShader, nullptr, 0);
-	m_DeviceContext->PSSetShaderResources(0, 1, &ShaderRes);
+	m_DeviceContext->PSSetShaderResources(0, 1, &ShaderRes.p);
 	m_DeviceContext->PSSetSamplers(0, 1, &m_SamplerLinear.p);
 	m_DeviceContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 
@@ -559,20 +502,229 @@ HRESULT MouseManager::DrawMousePointer(_In_ PTR_INFO *pPtrInfo, _Inout_ ID3D11Te
 		VertexBufferMouse->Release();
 		VertexBufferMouse = nullptr;
 	}
-	if (ShaderRes)
+
+	return hr;
+}
+
+//
+// Returns a texture with the pointer shape rendered at the current scale, creating it on the first use of the shape.
+// Only valid for pointers that do not depend on the background they are drawn on.
+//
+HRESULT MouseManager::GetCachedPointerTexture(_In_ PTR_INFO *pPtrInfo, _Outptr_ ID3D11Texture2D **ppTexture, _Outptr_ ID3D11ShaderResourceView **ppShaderResource)
+{
+	*ppTexture = nullptr;
+	*ppShaderResource = nullptr;
+	bool isMono = pPtrInfo->ShapeInfo.Type == DXGI_OUTDUPL_POINTER_SHAPE_TYPE_MONOCHROME;
+	UINT shapeBufferSize = min(pPtrInfo->BufferSize, pPtrInfo->ShapeInfo.Pitch * pPtrInfo->ShapeInfo.Height);
+	m_PointerShapeCacheClock++;
+
+	auto IsEntryFor([&](const CACHED_POINTER_SHAPE &cachedShape) {
+		return cachedShape.ShapeBuffer.size() == shapeBufferSize
+			&& memcmp(&cachedShape.ShapeInfo, &pPtrInfo->ShapeInfo, sizeof(DXGI_OUTDUPL_POINTER_SHAPE_INFO)) == 0
+			&& cachedShape.Scale.cx == pPtrInfo->Scale.cx
+			&& cachedShape.Scale.cy == pPtrInfo->Scale.cy;
+	});
+	auto UseEntry([&](CACHED_POINTER_SHAPE &cachedShape) {
+		m_PointerShapeCacheHits++;
+		cachedShape.LastUsed = m_PointerShapeCacheClock;
+		*ppTexture = cachedShape.Texture;
+		(*ppTexture)->AddRef();
+		*ppShaderResource = cachedShape.ShaderResource;
+		(*ppShaderResource)->AddRef();
+	});
+	auto SetCurrentEntry([&](UINT64 key) {
+		m_CurrentPointerShapeKey = key;
+		m_CurrentPointerShapeUpdateCount = pPtrInfo->ShapeUpdateCount;
+		m_CurrentPointerShapeBuffer = pPtrInfo->PtrShapeBuffer;
+	});
+
+	//The shape drawn last is reused without reading the shape buffer, unless the shape was updated since
+	if (m_CurrentPointerShapeKey.has_value()
+		&& !pPtrInfo->IsPointerShapeUpdated
+		&& pPtrInfo->ShapeUpdateCount == m_CurrentPointerShapeUpdateCount
+		&& pPtrInfo->PtrShapeBuffer == m_CurrentPointerShapeBuffer) {
+		auto current = m_PointerShapeCache.find(m_CurrentPointerShapeKey.value());
+		if (current != m_PointerShapeCache.end() && IsEntryFor(current->second)) {
+			UseEntry(current->second);
+			return S_OK;
+		}
+	}
+
+	UINT64 key = GetPointerShapeHash(pPtrInfo, shapeBufferSize);
+	auto entry = m_PointerShapeCache.find(key);
+	if (entry != m_PointerShapeCache.end()
+		&& IsEntryFor(entry->second)
+		&& memcmp(entry->second.ShapeBuffer.data(), pPtrInfo->PtrShapeBuffer, shapeBufferSize) == 0) {
+		UseEntry(entry->second);
+		SetCurrentEntry(key);
+		return S_OK;
+	}
+	m_PointerShapeCacheMisses++;
+
+	HRESULT hr = S_OK;
+	INT width = static_cast<INT>(pPtrInfo->ShapeInfo.Width);
+	INT height = static_cast<INT>(isMono ? pPtrInfo->ShapeInfo.Height / 2 : pPtrInfo->ShapeInfo.Height);
+	D3D11_SUBRESOURCE_DATA InitData = { 0 };
+	std::vector<UINT> rasterizedShape{};
+	if (pPtrInfo->ShapeInfo.Type == DXGI_OUTDUPL_POINTER_SHAPE_TYPE_COLOR) {
+		InitData.pSysMem = pPtrInfo->PtrShapeBuffer;
+		InitData.SysMemPitch = pPtrInfo->ShapeInfo.Pitch;
+	}
+	else {
+		//The background is never visible through this pointer, so any opaque background gives the same result.
+		std::vector<UINT> background(width, CURSOR_OPAQUE_BLACK);
+		rasterizedShape.resize(static_cast<size_t>(width) * height);
+		CURSOR_RASTER_DESC rasterDesc{};
+		rasterDesc.pShape = pPtrInfo->PtrShapeBuffer;
+		rasterDesc.ShapePitch = pPtrInfo->ShapeInfo.Pitch;
+		rasterDesc.MaskHeight = height;
+		rasterDesc.pBackground = background.data();
+		rasterDesc.BackgroundPitchInPixels = 0;
+		rasterDesc.Width = width;
+		rasterDesc.Height = height;
+		if (isMono) {
+			RasterizeMonochromeCursor(rasterDesc, rasterizedShape.data());
+		}
+		else {
+			RasterizeMaskedColorCursor(rasterDesc, rasterizedShape.data());
+		}
+		InitData.pSysMem = rasterizedShape.data();
+		InitData.SysMemPitch = width * BPP;
+	}
+
+	D3D11_TEXTURE2D_DESC Desc = { 0 };
+	Desc.Width = width;
+	Desc.Height = height;
+	Desc.MipLevels = 1;
+	Desc.ArraySize = 1;
+	Desc.Format = DXGI_FORMAT_B8G8R8A8_UNORM;
+	Desc.SampleDesc.Count = 1;
+	Desc.Usage = D3D11_USAGE_DEFAULT;
+	Desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+	CComPtr<ID3D11Texture2D> pTexture;
+	hr = m_Device->CreateTexture2D(&Desc, &InitData, &pTexture);
+	if (FAILED(hr))
 	{
-		ShaderRes->Release();
-		ShaderRes = nullptr;
+		_com_error err(hr);
+		LOG_ERROR(L"Failed to create mouse pointer texture: %ls", err.ErrorMessage());
+		return hr;
 	}
-	if (MouseTex)
+	if (pPtrInfo->Scale.cx != 1.0 || pPtrInfo->Scale.cy != 1.0) {
+		SIZE scaledSize{ static_cast<LONG>(round(width * pPtrInfo->Scale.cx)), static_cast<LONG>(round(height * pPtrInfo->Scale.cy)) };
+		CComPtr<ID3D11Texture2D> pResizedTexture;
+		RETURN_ON_BAD_HR(hr = m_TextureManager->ResizeTexture(pTexture, scaledSize, TextureStretchMode::Uniform, &pResizedTexture));
+		//The texture manager reuses its output textures, so the cache keeps its own copy.
+		D3D11_TEXTURE2D_DESC resizedDesc;
+		pResizedTexture->GetDesc(&resizedDesc);
+		pTexture.Release();
+		RETURN_ON_BAD_HR(hr = m_Device->CreateTexture2D(&resizedDesc, nullptr, &pTexture));
+		m_DeviceContext->CopyResource(pTexture, pResizedTexture);
+	}
+	CComPtr<ID3D11ShaderResourceView> pShaderResource;
+	hr = m_Device->CreateShaderResourceView(pTexture, nullptr, &pShaderResource);
+	if (FAILED(hr))
 	{
-		MouseTex->Release();
-		MouseTex = nullptr;
+		_com_error err(hr);
+		LOG_ERROR(L"Failed to create shader resource from mouse pointer texture: %ls", err.ErrorMessage());
+		return hr;
 	}
 
+	if (m_PointerShapeCache.size() >= MAX_CACHED_POINTER_SHAPES) {
+		auto leastRecentlyUsed = std::min_element(m_PointerShapeCache.begin(), m_PointerShapeCache.end(),
+			[](const auto &a, const auto &b) { return a.second.LastUsed < b.second.LastUsed; });
+		m_PointerShapeCache.erase(leastRecentlyUsed);
+	}
+	CACHED_POINTER_SHAPE &cachedShape = m_PointerShapeCache[key];
+	cachedShape.ShapeBuffer.assign(pPtrInfo->PtrShapeBuffer, pPtrInfo->PtrShapeBuffer + shapeBufferSize);
+	cachedShape.ShapeInfo = pPtrInfo->ShapeInfo;
+	cachedShape.Scale = pPtrInfo->Scale;
+	cachedShape.Texture = pTexture;
+	cachedShape.ShaderResource = pShaderResource;
+	cachedShape.LastUsed = m_PointerShapeCacheClock;
+	SetCurrentEntry(key);
+	LOG_TRACE(L"Cached new mouse pointer shape, %u shapes in cache", static_cast<UINT>(m_PointerShapeCache.size()));
+
+	*ppTexture = pTexture.Detach();
+	*ppShaderResource = pShaderResource.Detach();
+	return hr;
+}
+
+//
+// Uploads a pointer rasterized on the CPU to a texture that is kept between frames
+//
+HRESULT MouseManager::UploadPointerTexture(_In_ BYTE *pBuffer, _In_ INT width, _In_ INT height, _Outptr_ ID3D11Texture2D **ppTexture)
+{
+	*ppTexture = nullptr;
+	HRESULT hr = S_OK;
+	D3D11_TEXTURE2D_DESC Desc = { 0 };
+	if (m_PointerUploadTexture) {
+		m_PointerUploadTexture->GetDesc(&Desc);
+	}
+	if (m_PointerUploadTexture && Desc.Width == static_cast<UINT>(width) && Desc.Height == static_cast<UINT>(height)) {
+		m_DeviceContext->UpdateSubresource(m_PointerUploadTexture, 0, nullptr, pBuffer, width * BPP, 0);
+	}
+	else {
+		m_PointerUploadTexture.Release();
+		Desc.Width = width;
+		Desc.Height = height;
+		Desc.MipLevels = 1;
+		Desc.ArraySize = 1;
+		Desc.Format = DXGI_FORMAT_B8G8R8A8_UNORM;
+		Desc.SampleDesc.Count = 1;
+		Desc.SampleDesc.Quality = 0;
+		Desc.Usage = D3D11_USAGE_DEFAULT;
+		Desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+		Desc.CPUAccessFlags = 0;
+		Desc.MiscFlags = 0;
+		D3D11_SUBRESOURCE_DATA InitData = { 0 };
+		InitData.pSysMem = pBuffer;
+		InitData.SysMemPitch = width * BPP;
+		hr = m_Device->CreateTexture2D(&Desc, &InitData, &m_PointerUploadTexture);
+		if (FAILED(hr))
+		{
+			_com_error err(hr);
+			LOG_ERROR(L"Failed to create mouse pointer texture: %ls", err.ErrorMessage());
+			return hr;
+		}
+	}
+	*ppTexture = m_PointerUploadTexture;
+	(*ppTexture)->AddRef();
 	return hr;
 }
 
+//
+// Hashes the pointer shape buffer together with the shape info and scale it is rendered with
+//
+UINT64 MouseManager::GetPointerShapeHash(_In_ PTR_INFO *pPtrInfo, _In_ UINT shapeBufferSize)
+{
+	//FNV-1a, mixing a 64 bit word at a time.
+	const UINT64 prime = 0x100000001b3;
+	UINT64 hash = 0xcbf29ce484222325;
+	auto Mix([&](UINT64 value) {
+		hash ^= value;
+		hash *= prime;
+	});
+	UINT32 scaleX, scaleY;
+	memcpy(&scaleX, &pPtrInfo->Scale.cx, sizeof(UINT32));
+	memcpy(&scaleY, &pPtrInfo->Scale.cy, sizeof(UINT32));
+	Mix(pPtrInfo->ShapeInfo.Type);
+	Mix(pPtrInfo->ShapeInfo.Width);
+	Mix(pPtrInfo->ShapeInfo.Height);
+	Mix(pPtrInfo->ShapeInfo.Pitch);
+	Mix((static_cast<UINT64>(scaleX) << 32) | scaleY);
+	const BYTE *pShape = pPtrInfo->PtrShapeBuffer;
+	UINT i = 0;
+	for (; i + sizeof(UINT64) <= shapeBufferSize; i += sizeof(UINT64)) {
+		UINT64 word;
+		memcpy(&word, pShape + i, sizeof(UINT64));
+		Mix(word);
+	}
+	for (; i < shapeBufferSize; i++) {
+		Mix(pShape[i]);
+	}
+	return hash;
+}
+
 //
 // Process both masked and monochrome pointers
 //
@@ -641,27 +793,36 @@ HRESULT MouseManager::ProcessMonoMask(
 		return S_FALSE;
 	}
 
-	// Staging buffer/texture
-	D3D11_TEXTURE2D_DESC CopyBufferDesc;
-	CopyBufferDesc.Width = *ptrWidth;
-	CopyBufferDesc.Height = *ptrHeight;
-	CopyBufferDesc.MipLevels = 1;
-	CopyBufferDesc.ArraySize = 1;
-	CopyBufferDesc.Format = desc.Format;
-	CopyBufferDesc.SampleDesc.Count = 1;
-	CopyBufferDesc.SampleDesc.Quality = 0;
-	CopyBufferDesc.Usage = D3D11_USAGE_STAGING;
-	CopyBufferDesc.BindFlags = 0;
-	CopyBufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
-	CopyBufferDesc.MiscFlags = 0;
-
-	ID3D11Texture2D *CopyBuffer = nullptr;
-	HRESULT hr = m_Device->CreateTexture2D(&CopyBufferDesc, nullptr, &CopyBuffer);
-	if (FAILED(hr))
-	{
-		_com_error err(hr);
-		LOG_ERROR(L"Failed creating staging texture for pointer: %ls", err.ErrorMessage());
-		return hr;
+	// Staging buffer/texture, kept between frames and only recreated if the pointer no longer fits
+	HRESULT hr = S_OK;
+	D3D11_TEXTURE2D_DESC CopyBufferDesc{};
+	if (m_PointerStagingTexture) {
+		m_PointerStagingTexture->GetDesc(&CopyBufferDesc);
+	}
+	if (!m_PointerStagingTexture
+		|| CopyBufferDesc.Format != desc.Format
+		|| CopyBufferDesc.Width < static_cast<UINT>(*ptrWidth)
+		|| CopyBufferDesc.Height < static_cast<UINT>(*ptrHeight)) {
+		m_PointerStagingTexture.Release();
+		CopyBufferDesc.Width = max(static_cast<UINT>(*ptrWidth), pPtrInfo->ShapeInfo.Width);
+		CopyBufferDesc.Height = max(static_cast<UINT>(*ptrHeight), IsMono ? pPtrInfo->ShapeInfo.Height / 2 : pPtrInfo->ShapeInfo.Height);
+		CopyBufferDesc.MipLevels = 1;
+		CopyBufferDesc.ArraySize = 1;
+		CopyBufferDesc.Format = desc.Format;
+		CopyBufferDesc.SampleDesc.Count = 1;
+		CopyBufferDesc.SampleDesc.Quality = 0;
+		CopyBufferDesc.Usage = D3D11_USAGE_STAGING;
+		CopyBufferDesc.BindFlags = 0;
+		CopyBufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+		CopyBufferDesc.MiscFlags = 0;
+
+		hr = m_Device->CreateTexture2D(&CopyBufferDesc, nullptr, &m_PointerStagingTexture);
+		if (FAILED(hr))
+		{
+			_com_error err(hr);
+			LOG_ERROR(L"Failed creating staging texture for pointer: %ls", err.ErrorMessage());
+			return hr;
+		}
 	}
 	D3D11_BOX Box{};
 	// Copy needed part of desktop image
@@ -670,13 +831,11 @@ HRESULT MouseManager::ProcessMonoMask(
 	Box.right = *ptrLeft + *ptrWidth;
 	Box.bottom = *ptrTop + *ptrHeight;
 	Box.back = 1;
-	m_DeviceContext->CopySubresourceRegion(CopyBuffer, 0, 0, 0, 0, pBgTexture, 0, &Box);
+	m_DeviceContext->CopySubresourceRegion(m_PointerStagingTexture, 0, 0, 0, 0, pBgTexture, 0, &Box);
 
 	// QI for IDXGISurface
-	IDXGISurface *CopySurface = nullptr;
-	hr = CopyBuffer->QueryInterface(__uuidof(IDXGISurface), (void **)&CopySurface);
-	CopyBuffer->Release();
-	CopyBuffer = nullptr;
+	CComPtr<IDXGISurface> CopySurface = nullptr;
+	hr = m_PointerStagingTexture->QueryInterface(__uuidof(IDXGISurface), (void **)&CopySurface);
 	if (FAILED(hr))
 	{
 		_com_error err(hr);
@@ -689,8 +848,6 @@ HRESULT MouseManager::ProcessMonoMask(
 	hr = CopySurface->Map(&MappedSurface, DXGI_MAP_READ);
 	if (FAILED(hr))
 	{
-		CopySurface->Release();
-		CopySurface = nullptr;
 		_com_error err(hr);
 		LOG_ERROR(L"Failed to map surface for pointer: %lls", err.ErrorMessage());
 		return hr;
@@ -749,82 +906,27 @@ HRESULT MouseManager::ProcessMonoMask(
 		DesktopBuffer32 = reinterpret_cast<UINT *>(MappedSurface.pBits);
 	}
 
+	CURSOR_RASTER_DESC rasterDesc{};
+	rasterDesc.pShape = pPtrInfo->PtrShapeBuffer;
+	rasterDesc.ShapePitch = pPtrInfo->ShapeInfo.Pitch;
+	rasterDesc.MaskHeight = pPtrInfo->ShapeInfo.Height / 2;
+	rasterDesc.SkipX = SkipX;
+	rasterDesc.SkipY = SkipY;
+	rasterDesc.pBackground = DesktopBuffer32;
+	rasterDesc.BackgroundPitchInPixels = DesktopPitchInPixels;
+	rasterDesc.Width = *ptrWidth;
+	rasterDesc.Height = *ptrHeight;
 	if (IsMono)
 	{
-		//https://docs.microsoft.com/en-us/windows-hardware/drivers/display/drawing-monochrome-pointers
-		for (INT Row = 0; Row < *ptrHeight; ++Row)
-		{
-			// Set mask
-			BYTE Mask = 0x80;
-			Mask = Mask >> (SkipX % 8);
-			for (INT Col = 0; Col < *ptrWidth; ++Col)
-			{
-				// Get masks using appropriate offsets
-				BYTE AndMask = pPtrInfo->PtrShapeBuffer[((Col + SkipX) / 8) + ((Row + SkipY) * (pPtrInfo->ShapeInfo.Pitch))] & Mask;
-				BYTE XorMask = pPtrInfo->PtrShapeBuffer[((Col + SkipX) / 8) + ((Row + SkipY + (pPtrInfo->ShapeInfo.Height / 2)) * (pPtrInfo->ShapeInfo.Pitch))] & Mask;
-				UINT AndMask32 = (AndMask) ? OPAQUE_WHITE : OPAQUE_BLACK;
-				UINT XorMask32 = (XorMask) ? TRANSPARENT_WHITE : TRANSPARENT_BLACK;
-
-				if (AndMask && !XorMask) {
-					// Instead of copying the desktop pixel for parts where the cursor is not visible, transparent white is used instead,
-					// to enable the pointer texture to be resized independently of the background and drawn on top of it.
-					InitBuffer32[(Row * *ptrWidth) + Col] = TRANSPARENT_WHITE;
-				}
-				else {
-					// Set new pixel with background from desktop
-					InitBuffer32[(Row * *ptrWidth) + Col] = (DesktopBuffer32[(Row * DesktopPitchInPixels) + Col] & AndMask32) ^ XorMask32;
-				}
-
-				// Adjust mask
-				if (Mask == 0x01)
-				{
-					Mask = 0x80;
-				}
-				else
-				{
-					Mask = Mask >> 1;
-				}
-			}
-		}
+		RasterizeMonochromeCursor(rasterDesc, InitBuffer32);
 	}
 	else
 	{
-		//https://docs.microsoft.com/en-us/windows-hardware/drivers/display/drawing-color-pointers
-		UINT *Buffer32 = reinterpret_cast<UINT *>(pPtrInfo->PtrShapeBuffer);
-
-		// Iterate through pixels
-		for (INT Row = 0; Row < *ptrHeight; ++Row)
-		{
-			for (INT Col = 0; Col < *ptrWidth; ++Col)
-			{
-				UINT RgbValue = Buffer32[(Col + SkipX) + ((Row + SkipY) * (pPtrInfo->ShapeInfo.Pitch / sizeof(UINT)))];
-				// Set up mask
-				UINT MaskVal = OPAQUE_BLACK & RgbValue;
-				if (MaskVal)
-				{
-					// Mask was 0xFF
-					if (RgbValue == MaskVal) {
-						// Instead of copying the desktop pixel for parts where the cursor is not visible, we use transparent white,
-						// to enable the pointer texture to be resized independently of the background and drawn on top of it.
-						InitBuffer32[(Row * *ptrWidth) + Col] = TRANSPARENT_WHITE;
-					}
-					else {
-						InitBuffer32[(Row * *ptrWidth) + Col] = (DesktopBuffer32[(Row * DesktopPitchInPixels) + Col] ^ RgbValue) | OPAQUE_BLACK;
-					}
-				}
-				else
-				{
-					// Mask was 0x00
-					InitBuffer32[(Row * *ptrWidth) + Col] = RgbValue | OPAQUE_BLACK;
-				}
-			}
-		}
+		RasterizeMaskedColorCursor(rasterDesc, InitBuffer32);
 	}
 
 	// Done with resource
 	hr = CopySurface->Unmap();
-	CopySurface->Release();
-	CopySurface = nullptr;
 	if (FAILED(hr))
 	{
 		_com_error err(hr);
@@ -920,6 +1022,7 @@ HRESULT MouseManager::GetMouse(_Inout_ PTR_INFO *pPtrInfo, _In_ bool getShapeBuf
 		return hr;
 	}
 	pPtrInfo->IsPointerShapeUpdated = true;
+	pPtrInfo->ShapeUpdateCount++;
 	return S_OK;
 }
 
@@ -1002,6 +1105,7 @@ HRESULT MouseManager::GetMouse(_Inout_ PTR_INFO *pPtrInfo, _In_ bool getShapeBuf
 				return E_FAIL;
 			}
 			pPtrInfo->IsPointerShapeUpdated = true;
+			pPtrInfo->ShapeUpdateCount++;
 		}
 	}
 	else {
@@ -1047,6 +1151,7 @@ HRESULT MouseManager::GetMouse(_Inout_ PTR_INFO *pPtrInfo, _In_ bool getShapeBuf
 				return E_FAIL;
 			}
 			pPtrInfo->IsPointerShapeUpdated = true;
+			pPtrInfo->ShapeUpdateCount++;
 		}
 	}
 
@@ -1072,6 +1177,14 @@ HRESULT MouseManager::GetMouse(_Inout_ PTR_INFO *pPtrInfo, _In_ bool getShapeBuf
 
 void MouseManager::CleanDX()
 {
+	if (m_PointerShapeCacheHits + m_PointerShapeCacheMisses > 0) {
+		LOG_DEBUG(L"Mouse pointer cache: %lld hits, %lld misses, %.1f%% hit rate", m_PointerShapeCacheHits, m_PointerShapeCacheMisses, GetPointerCacheHitRate() * 100);
+	}
+	m_PointerShapeCache.clear();
+	m_PointerStagingTexture.Release();
+	m_PointerUploadTexture.Release();
+	m_PointerShapeCacheHits = 0;
+	m_PointerShapeCacheMisses = 0;
 	if (m_SamplerLinear)
 		m_SamplerLinear.Release();
 	if (m_BlendState)
@@ -5,8 +5,12 @@
 #include <memory>
 #include "CommonTypes.h"
 #include "TextureManager.h"
-#include <thread>
-LRESULT CALLBACK MouseHookProc(int nCode, WPARAM wParam, LPARAM lParam);
+#include "MouseClickEvents.h"
+#include "MouseClickEventSource.h"
+#include <optional>
+#include <unordered_map>
+#include <vector>
+class CursorMetadataWriter;
 
 class MouseManager
 {
@@ -17,20 +21,49 @@ public:
 	HRESULT Initialize(_In_ ID3D11DeviceContext *pDeviceContext, _In_ ID3D11Device *pDevice, _In_ std::shared_ptr<MOUSE_OPTIONS> &pOptions);
 	void InitializeMouseClickDetection();
 	void StopMouseClickDetection();
-	HRESULT ProcessMousePointer(_In_ ID3D11Texture2D *pFrame, _In_ PTR_INFO *pPtrInfo);
+	/// <summary>
+	/// Draws the mouse pointer, and any mouse click that is active at the time of the frame.
+	/// </summary>
+	/// <param name="pFrame">The frame to draw on</param>
+	/// <param name="pPtrInfo">The mouse pointer info</param>
+	/// <param name="frameTimeStamp">QueryPerformanceCounter time the frame was captured, or 0 to use the current time.</param>
+	HRESULT ProcessMousePointer(_In_ ID3D11Texture2D *pFrame, _In_ PTR_INFO *pPtrInfo, _In_ INT64 frameTimeStamp);
 	HRESULT GetMouse(_Inout_ PTR_INFO *pPtrInfo, _In_ bool getShapeBuffer, _In_ DXGI_OUTDUPL_FRAME_INFO *pFrameInfo, _In_ RECT screenRect, _In_ IDXGIOutputDuplication *pDeskDupl, _In_ int offsetX, _In_ int offsetY);
 	HRESULT GetMouse(_Inout_ PTR_INFO *pPtrInfo, _In_ bool getShapeBuffer, _In_ int offsetX, _In_ int offsetY);
 	void CleanDX();
+	/// <summary>
+	/// Sets the writer detected mouse clicks are recorded to when the pointer is recorded as metadata instead of drawn on the frames, or nullptr to stop recording them.
+	/// </summary>
+	void SetCursorMetadataWriter(_In_opt_ std::shared_ptr<CursorMetadataWriter> pWriter);
+	/// <summary>
+	/// Number of pointer draws that used an already rendered pointer shape.
+	/// </summary>
+	inline INT64 GetPointerCacheHits() { return m_PointerShapeCacheHits; }
+	/// <summary>
+	/// Number of pointer draws that had to render a new pointer shape.
+	/// </summary>
+	inline INT64 GetPointerCacheMisses() { return m_PointerShapeCacheMisses; }
+	inline double GetPointerCacheHitRate() {
+		INT64 total = m_PointerShapeCacheHits + m_PointerShapeCacheMisses;
+		return total > 0 ? static_cast<double>(m_PointerShapeCacheHits) / total : 0;
+	}
 protected:
 	HRESULT DrawMousePointer(_In_ PTR_INFO *pPtrInfo, _Inout_ ID3D11Texture2D *pBbgTexture, DXGI_MODE_ROTATION rotation);
 	HRESULT DrawMouseClick(_In_ PTR_INFO *pPtrInfo, _In_ ID3D11Texture2D *pBgTexture, std::string colorStr, float radius, DXGI_MODE_ROTATION rotation);
 private:
-	static const UINT TRANSPARENT_WHITE = 0x00FFFFFF;
-	static const UINT TRANSPARENT_BLACK = 0x00000000;
-	static const UINT OPAQUE_WHITE = 0xFFFFFFFF;
-	static const UINT OPAQUE_BLACK = 0xFF000000;
 	static const int NUMVERTICES = 6;
 	static const int BPP = 4;
+	static const size_t MAX_CACHED_POINTER_SHAPES = 32;
+
+	struct CACHED_POINTER_SHAPE {
+		// Copy of the shape buffer, to rule out hash collisions
+		std::vector<BYTE> ShapeBuffer;
+		DXGI_OUTDUPL_POINTER_SHAPE_INFO ShapeInfo;
+		SIZE_F Scale;
+		ATL::CComPtr<ID3D11Texture2D> Texture;
+		ATL::CComPtr<ID3D11ShaderResourceView> ShaderResource;
+		UINT64 LastUsed;
+	};
 
 	ATL::CComPtr<ID3D11SamplerState> m_SamplerLinear;
 	ATL::CComPtr<ID3D11BlendState> m_BlendState;
@@ -46,17 +79,37 @@ private:
 
 	CRITICAL_SECTION m_CriticalSection;
 	bool m_IsCapturingMouseClicks;
-	std::chrono::steady_clock::time_point m_LastMouseDrawTimeStamp;
-	HANDLE m_MouseHookThread;
-	DWORD m_MouseHookThreadId;
 	std::vector<BYTE> _InitBuffer;
 	std::vector<BYTE> _DesktopBuffer;
-	HANDLE m_StopPollingTaskEvent;
-	std::thread m_MousePollingThread;
+	std::unique_ptr<MouseClickEventSource> m_MouseClickEventSource;
+	// Clicks detected by the event source, waiting to be drawn on the frame they happened in
+	MouseClickEventQueue m_MouseClickEvents;
+	MouseClickTracker m_MouseClickTracker;
+	LARGE_INTEGER m_QPCFrequency;
+	// Staging texture the background under masked and monochrome pointers is read back with
+	ATL::CComPtr<ID3D11Texture2D> m_PointerStagingTexture;
+	// Texture pointers rasterized against the background are uploaded to
+	ATL::CComPtr<ID3D11Texture2D> m_PointerUploadTexture;
+	// Rendered pointers that look the same on any background, keyed by a hash of the shape and scale
+	std::unordered_map<UINT64, CACHED_POINTER_SHAPE> m_PointerShapeCache;
+	UINT64 m_PointerShapeCacheClock;
+	// Cache key of the shape drawn last, and the shape update count and buffer it was drawn from. The shape buffer is only hashed again
+	// when the shape is updated, so drawing an unchanged pointer does not read the whole buffer.
+	std::optional<UINT64> m_CurrentPointerShapeKey;
+	UINT64 m_CurrentPointerShapeUpdateCount;
+	const BYTE *m_CurrentPointerShapeBuffer;
+	INT64 m_PointerShapeCacheHits;
+	INT64 m_PointerShapeCacheMisses;
+	std::shared_ptr<CursorMetadataWriter> m_CursorMetadataWriter;
+	void OnMouseClickEvent(_In_ const MOUSE_CLICK_EVENT &clickEvent);
 	long ParseColorString(std::string color);
 	void GetPointerPosition(_In_ PTR_INFO *pPtrInfo, DXGI_MODE_ROTATION rotation, int desktopWidth, int desktopHeight, _Out_ INT *PtrLeft, _Out_ INT *PtrTop);
 	HRESULT ProcessMonoMask(_In_ ID3D11Texture2D *pBgTexture, _In_ DXGI_MODE_ROTATION rotation, _In_ bool IsMono, _Inout_ PTR_INFO *PtrInfo, _Out_ INT *PtrWidth, _Out_ INT *PtrHeight, _Out_ INT *PtrLeft, _Out_ INT *PtrTop, _Outptr_result_bytebuffer_(*PtrHeight **PtrWidth *BPP) BYTE **pInitBuffer);
 
+	HRESULT GetCachedPointerTexture(_In_ PTR_INFO *pPtrInfo, _Outptr_ ID3D11Texture2D **ppTexture, _Outptr_ ID3D11ShaderResourceView **ppShaderResource);
+	HRESULT UploadPointerTexture(_In_ BYTE *pBuffer, _In_ INT width, _In_ INT height, _Outptr_ ID3D11Texture2D **ppTexture);
+	UINT64 GetPointerShapeHash(_In_ PTR_INFO *pPtrInfo, _In_ UINT shapeBufferSize);
+
 	HRESULT InitMouseClickTexture(_In_ ID3D11DeviceContext *pDeviceContext, _In_ ID3D11Device *pDevice);
 	HRESULT ResizeShapeBuffer(_Inout_ PTR_INFO *pPtrInfo, _In_ int bufferSize);
 };
@@ -1,5 +1,8 @@
 #include "OutputManager.h"
 #include "screengrab.h"
+#include "TraceRecorder.h"
+#include "FlightRecorder.h"
+#include "TexturePool.h"
 #include <ppltasks.h> 
 #include <concrt.h>
 #include <filesystem>
@@ -9,8 +12,16 @@ using namespace concurrency;
 OutputManager::OutputManager() :
 	m_Device(nullptr),
 	m_DeviceContext(nullptr),
-	m_PresentationClock(nullptr),
-	m_TimeSrc(nullptr),
+	m_MediaClock(std::make_shared<SystemMediaClock>()),
+	m_Metrics(nullptr),
+	m_RenderTime(nullptr),
+	m_VideoWriteTime(nullptr),
+	m_AudioWriteTime(nullptr),
+	m_VideoSampleCount(nullptr),
+	m_AudioSampleCount(nullptr),
+	m_PaddedAudioSampleCount(nullptr),
+	m_QueuedVideoSamples(nullptr),
+	m_QueuedAudioSamples(nullptr),
 	m_CallBack(nullptr),
 	m_FinalizeEvent(nullptr),
 	m_SinkWriter(nullptr),
@@ -32,6 +43,7 @@ OutputManager::OutputManager() :
 {
 	m_FinalizeEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
 	InitializeCriticalSection(&m_CriticalSection);
+	SetMetricsRegistry(std::make_shared<MetricsRegistry>());
 }
 
 OutputManager::~OutputManager()
@@ -41,6 +53,21 @@ OutputManager::~OutputManager()
 	DeleteCriticalSection(&m_CriticalSection);
 }
 
+void OutputManager::SetMetricsRegistry(_In_ std::shared_ptr<MetricsRegistry> pMetrics)
+{
+	EnterCriticalSection(&m_CriticalSection);
+	LeaveCriticalSectionOnExit leaveOnExit(&m_CriticalSection);
+	m_Metrics = pMetrics;
+	m_RenderTime = &pMetrics->GetHistogram(L"output.render_time");
+	m_VideoWriteTime = &pMetrics->GetHistogram(L"output.write_time", L"video");
+	m_AudioWriteTime = &pMetrics->GetHistogram(L"output.write_time", L"audio");
+	m_VideoSampleCount = &pMetrics->GetCounter(L"output.samples", L"video");
+	m_AudioSampleCount = &pMetrics->GetCounter(L"output.samples", L"audio");
+	m_PaddedAudioSampleCount = &pMetrics->GetCounter(L"output.padded_audio_samples");
+	m_QueuedVideoSamples = &pMetrics->GetGauge(L"output.queued_samples", L"video");
+	m_QueuedAudioSamples = &pMetrics->GetGauge(L"output.queued_samples", L"audio");
+}
+
 HRESULT OutputManager::Initialize(
 	_In_ ID3D11DeviceContext *pDeviceContext,
 	_In_ ID3D11Device *pDevice,
@@ -67,13 +94,6 @@ HRESULT OutputManager::Initialize(
 	if (m_MediaTransform) {
 		m_MediaTransform->ProcessMessage(MFT_MESSAGE_COMMAND_FLUSH, 0);
 	}
-	if (!m_TimeSrc) {
-		RETURN_ON_BAD_HR(MFCreateSystemTimeSource(&m_TimeSrc));
-	}
-	if (!m_PresentationClock) {
-		RETURN_ON_BAD_HR(MFCreatePresentationClock(&m_PresentationClock));
-		RETURN_ON_BAD_HR(m_PresentationClock->SetTimeSource(m_TimeSrc));
-	}
 	RETURN_ON_BAD_HR(m_DeviceManager->ResetDevice(pDevice, m_ResetToken));
 	return S_OK;
 }
@@ -193,15 +213,21 @@ HRESULT OutputManager::RenderFrame(_In_ FrameWriteModel &model) {
 	EnterCriticalSection(&m_CriticalSection);
 	LeaveCriticalSectionOnExit leaveOnExit(&m_CriticalSection);
 	MeasureExecutionTime measure(L"RenderFrame");
+	TRACE_SPAN("RenderFrame");
+	LatencyTimer renderTimer(*m_RenderTime);
 	auto recorderMode = GetOutputOptions()->GetRecorderMode();
 	if (recorderMode == RecorderModeInternal::Video) {
+		LatencyTimer videoWriteTimer(*m_VideoWriteTime);
 		hr = WriteFrameToVideo(model.StartPos, model.Duration, m_VideoStreamIndex, model.Frame);
+		videoWriteTimer.Stop();
 		bool wroteAudioSample = false;
 		if (FAILED(hr)) {
 			_com_error err(hr);
 			LOG_ERROR(L"Writing of video frame with start pos %lld ms failed: %s", (HundredNanosToMillis(model.StartPos)), err.ErrorMessage());
 			return hr;//Stop recording if we fail
 		}
+		m_VideoSampleCount->Add();
+		UpdateQueuedSamples(m_VideoStreamIndex, m_QueuedVideoSamples);
 		bool paddedAudio = false;
 
 		/* If the audio pCaptureInstance returns no data, i.e. the source is silent, we need to pad the PCM stream with zeros to give the media sink silence as input.
@@ -210,7 +236,7 @@ HRESULT OutputManager::RenderFrame(_In_ FrameWriteModel &model) {
 		 * and inserting silence between two frames that has audio leads to glitching. */
 		if (GetAudioOptions()->IsAudioEnabled() && model.Audio.size() == 0 && model.Duration > 0) {
 			if (!m_LastFrameHadAudio) {
-				int frameCount = int(ceil(GetAudioOptions()->GetAudioSamplesPerSecond() * HundredNanosToMillis(model.Duration) / 1000));
+				int frameCount = static_cast<int>(CountFromMediaTime(model.Duration, MEDIA_RATE{ GetAudioOptions()->GetAudioSamplesPerSecond(), 1 }));
 				int byteCount = frameCount * (GetAudioOptions()->GetAudioBitsPerSample() / 8) * GetAudioOptions()->GetAudioChannels();
 				model.Audio.insert(model.Audio.end(), byteCount, 0);
 				paddedAudio = true;
@@ -222,7 +248,9 @@ HRESULT OutputManager::RenderFrame(_In_ FrameWriteModel &model) {
 		}
 
 		if (model.Audio.size() > 0) {
+			LatencyTimer audioWriteTimer(*m_AudioWriteTime);
 			hr = WriteAudioSamplesToVideo(model.StartPos, model.Duration, m_AudioStreamIndex, &(model.Audio)[0], (DWORD)model.Audio.size());
+			audioWriteTimer.Stop();
 			if (FAILED(hr)) {
 				_com_error err(hr);
 				LOG_ERROR(L"Writing of audio sample with start pos %lld ms failed: %s", (HundredNanosToMillis(model.StartPos)), err.ErrorMessage());
@@ -230,6 +258,12 @@ HRESULT OutputManager::RenderFrame(_In_ FrameWriteModel &model) {
 			}
 			else {
 				wroteAudioSample = true;
+				m_AudioSampleCount->Add();
+				if (paddedAudio) {
+					m_PaddedAudioSampleCount->Add();
+					FlightRecorder::Instance().Record(FlightEventType::AudioPadded, S_OK, model.StartPos);
+				}
+				UpdateQueuedSamples(m_AudioStreamIndex, m_QueuedAudioSamples);
 			}
 		}
 		auto frameInfoStr = wroteAudioSample ? (paddedAudio ? L"video sample and audio padding" : L"video and audio sample") : L"video sample";
@@ -276,38 +310,39 @@ HRESULT OutputManager::WriteFrameToImage(_In_ ID3D11Texture2D *pAcquiredDesktopI
 }
 HRESULT OutputManager::StartMediaClock()
 {
-	return m_PresentationClock->Start(0);
+	m_MediaClock->Start();
+	return S_OK;
 }
 HRESULT OutputManager::ResumeMediaClock()
 {
-	return m_PresentationClock->Start(PRESENTATION_CURRENT_POSITION);
+	m_MediaClock->Resume();
+	return S_OK;
 }
 HRESULT OutputManager::PauseMediaClock()
 {
-	return m_PresentationClock->Pause();
+	m_MediaClock->Pause();
+	return S_OK;
 }
 HRESULT OutputManager::StopMediaClock()
 {
-	return m_PresentationClock->Stop();
+	m_MediaClock->Stop();
+	return S_OK;
 }
 
 bool OutputManager::isMediaClockRunning()
 {
-	MFCLOCK_STATE state;
-	m_PresentationClock->GetState(0, &state);
-	return state == MFCLOCK_STATE_RUNNING;
+	return m_MediaClock->GetState() == MediaClockState::Running;
 }
 
 bool OutputManager::isMediaClockPaused()
 {
-	MFCLOCK_STATE state;
-	m_PresentationClock->GetState(0, &state);
-	return state == MFCLOCK_STATE_PAUSED;
+	return m_MediaClock->GetState() == MediaClockState::Paused;
 }
 
 HRESULT OutputManager::GetMediaTimeStamp(_Out_ INT64 *pTime)
 {
-	return m_PresentationClock->GetTime(pTime);
+	*pTime = m_MediaClock->GetTime();
+	return S_OK;
 }
 
 HRESULT OutputManager::ConfigureOutputMediaTypes(
@@ -331,7 +366,7 @@ HRESULT OutputManager::ConfigureOutputMediaTypes(
 	RETURN_ON_BAD_HR(pVideoMediaType->SetUINT32(MF_MT_YUV_MATRIX, MFVideoTransferMatrix_BT709));
 	RETURN_ON_BAD_HR(pVideoMediaType->SetUINT32(MF_MT_TRANSFER_FUNCTION, MFVideoTransFunc_709));
 	RETURN_ON_BAD_HR(MFSetAttributeSize(pVideoMediaType, MF_MT_FRAME_SIZE, destWidth, destHeight));
-	RETURN_ON_BAD_HR(MFSetAttributeRatio(pVideoMediaType, MF_MT_FRAME_RATE, GetEncoderOptions()->GetVideoFps(), 1));
+	RETURN_ON_BAD_HR(MFSetAttributeRatio(pVideoMediaType, MF_MT_FRAME_RATE, GetEncoderOptions()->GetVideoFps(), GetEncoderOptions()->GetVideoFpsDenominator()));
 	RETURN_ON_BAD_HR(MFSetAttributeRatio(pVideoMediaType, MF_MT_PIXEL_ASPECT_RATIO, 1, 1));
 
 	if (GetAudioOptions()->IsAudioEnabled()) {
@@ -378,7 +413,7 @@ HRESULT OutputManager::ConfigureInputMediaTypes(
 	RETURN_ON_BAD_HR(pVideoMediaType->SetUINT32(MF_MT_TRANSFER_FUNCTION, MFVideoTransFunc_709));
 	RETURN_ON_BAD_HR(MFSetAttributeSize(pVideoMediaType, MF_MT_FRAME_SIZE, sourceWidth, sourceHeight));
 	if (!GetEncoderOptions()->GetIsFixedFramerate() && !GetEncoderOptions()->GetIsFragmentedMp4Enabled()) {
-		RETURN_ON_BAD_HR(MFSetAttributeRatio(pVideoMediaType, MF_MT_FRAME_RATE, GetEncoderOptions()->GetVideoFps(), 1));
+		RETURN_ON_BAD_HR(MFSetAttributeRatio(pVideoMediaType, MF_MT_FRAME_RATE, GetEncoderOptions()->GetVideoFps(), GetEncoderOptions()->GetVideoFpsDenominator()));
 	}
 	RETURN_ON_BAD_HR(MFSetAttributeRatio(pVideoMediaType, MF_MT_PIXEL_ASPECT_RATIO, 1, 1));
 
@@ -528,14 +563,16 @@ HRESULT OutputManager::InitializeVideoSinkWriter(
 HRESULT OutputManager::WriteFrameToVideo(_In_ INT64 frameStartPos, _In_ INT64 frameDuration, _In_ DWORD streamIndex, _In_ ID3D11Texture2D *pAcquiredDesktopImage)
 {
 	//The encoder works async, so the input frame has to be copied, else it can be overwritten before the encoder uses it. See issue #277.
+	//The copy is taken from the texture pool, which does not hand it out again until the encoder has released the sample holding it.
 	CComPtr<ID3D11Texture2D> pFrameCopy;
 	D3D11_TEXTURE2D_DESC desc;
 	pAcquiredDesktopImage->GetDesc(&desc);
-	m_Device->CreateTexture2D(&desc, nullptr, &pFrameCopy);
+	HRESULT hr;
+	RETURN_ON_BAD_HR(hr = TexturePool::Shared().Acquire(m_Device, desc, &pFrameCopy));
 	m_DeviceContext->CopyResource(pFrameCopy, pAcquiredDesktopImage);
 
 	IMFMediaBuffer *pMediaBuffer;
-	HRESULT hr = MFCreateDXGISurfaceBuffer(__uuidof(ID3D11Texture2D), pFrameCopy, 0, FALSE, &pMediaBuffer);
+	hr = MFCreateDXGISurfaceBuffer(__uuidof(ID3D11Texture2D), pFrameCopy, 0, FALSE, &pMediaBuffer);
 	IMF2DBuffer *p2DBuffer;
 	if (SUCCEEDED(hr))
 	{
@@ -598,6 +635,7 @@ HRESULT OutputManager::WriteFrameToVideo(_In_ INT64 frameStartPos, _In_ INT64 fr
 					outputDataBuffer.pSample = transformSample;
 					SafeRelease(&transformBuffer);
 				}
+				TRACE_SPAN("ConvertToNV12");
 				if (SUCCEEDED(hr))
 				{
 					hr = m_MediaTransform->ProcessInput(streamIndex, pSample, 0);
@@ -621,11 +659,13 @@ HRESULT OutputManager::WriteFrameToVideo(_In_ INT64 frameStartPos, _In_ INT64 fr
 			}
 			if (SUCCEEDED(hr))
 			{
+				TRACE_SPAN("WriteVideoSample");
 				hr = m_SinkWriter->WriteSample(streamIndex, transformSample);
 			}
 			SafeRelease(&transformSample);
 		}
 		else {
+			TRACE_SPAN("WriteVideoSample");
 			hr = m_SinkWriter->WriteSample(streamIndex, pSample);
 		}
 	}
@@ -635,6 +675,19 @@ HRESULT OutputManager::WriteFrameToVideo(_In_ INT64 frameStartPos, _In_ INT64 fr
 	return hr;
 }
 
+void OutputManager::UpdateQueuedSamples(_In_ DWORD streamIndex, _In_ MetricGauge *pQueuedSamples)
+{
+	MF_SINK_WRITER_STATISTICS statistics{};
+	statistics.cb = sizeof(MF_SINK_WRITER_STATISTICS);
+	if (SUCCEEDED(m_SinkWriter->GetStatistics(streamIndex, &statistics))) {
+		double queuedSamples = static_cast<double>(statistics.qwNumSamplesReceived - statistics.qwNumSamplesProcessed);
+		if (queuedSamples != pQueuedSamples->GetValue()) {
+			FlightRecorder::Instance().Record(FlightEventType::QueueDepth, S_OK, static_cast<INT64>(queuedSamples), pQueuedSamples == m_QueuedAudioSamples ? 1 : 0);
+		}
+		pQueuedSamples->Set(queuedSamples);
+	}
+}
+
 HRESULT OutputManager::WriteAudioSamplesToVideo(_In_ INT64 frameStartPos, _In_ INT64 frameDuration, _In_ DWORD streamIndex, _In_ BYTE *pSrc, _In_ DWORD cbData)
 {
 	IMFMediaBuffer *pBuffer = nullptr;
@@ -696,6 +749,7 @@ HRESULT OutputManager::WriteAudioSamplesToVideo(_In_ INT64 frameStartPos, _In_ I
 	if (SUCCEEDED(hr))
 	{
 		// Send the sample to the Sink Writer.
+		TRACE_SPAN("WriteAudioSample");
 		hr = m_SinkWriter->WriteSample(streamIndex, pSample);
 	}
 	SafeRelease(&pSample);
@@ -6,6 +6,8 @@
 #include "CMFSinkWriterCallback.h"
 #include "cleanup.h"
 #include "fifo_map.h"
+#include "MediaClock.h"
+#include "MetricsRegistry.h"
 #include <mfreadwrite.h>
 
 struct FrameWriteModel
@@ -48,12 +50,32 @@ public:
 	HRESULT GetMediaTimeStamp(_Out_ INT64 *pTime);
 	bool isMediaClockRunning();
 	bool isMediaClockPaused();
+	/// <summary>
+	/// Replaces the clock frames are time stamped with, like a virtual clock to record faster than real time.
+	/// </summary>
+	inline void SetMediaClock(_In_ std::shared_ptr<MediaClock> pMediaClock) { m_MediaClock = pMediaClock; }
+	inline std::shared_ptr<MediaClock> GetMediaClock() { return m_MediaClock; }
+	/// <summary>
+	/// Sets the registry the write latencies, sample counts and encoder queue depths are recorded to.
+	/// </summary>
+	void SetMetricsRegistry(_In_ std::shared_ptr<MetricsRegistry> pMetrics);
 private:
 	ID3D11DeviceContext *m_DeviceContext = nullptr;
 	ID3D11Device *m_Device = nullptr;
 
-	CComPtr<IMFPresentationTimeSource> m_TimeSrc;
-	CComPtr<IMFPresentationClock> m_PresentationClock;
+	std::shared_ptr<MediaClock> m_MediaClock;
+
+	std::shared_ptr<MetricsRegistry> m_Metrics;
+	LatencyHistogram *m_RenderTime;
+	LatencyHistogram *m_VideoWriteTime;
+	LatencyHistogram *m_AudioWriteTime;
+	MetricCounter *m_VideoSampleCount;
+	MetricCounter *m_AudioSampleCount;
+	//Silent audio samples written because no audio was captured for the frame
+	MetricCounter *m_PaddedAudioSampleCount;
+	//Samples given to the sink writer that it has not yet delivered to the media sink
+	MetricGauge *m_QueuedVideoSamples;
+	MetricGauge *m_QueuedAudioSamples;
 
 	std::shared_ptr<ENCODER_OPTIONS> m_EncoderOptions;
 	std::shared_ptr<AUDIO_OPTIONS> m_AudioOptions;
@@ -75,7 +97,6 @@ private:
 	std::wstring m_OutputFullPath;
 	bool m_LastFrameHadAudio;
 	UINT64 m_RenderedFrameCount;
-	std::chrono::steady_clock::time_point m_PreviousSnapshotTaken;
 	CRITICAL_SECTION m_CriticalSection;
 	bool m_UseManualNV12Converter;
 
@@ -90,5 +111,6 @@ private:
 	HRESULT WriteFrameToVideo(_In_ INT64 frameStartPos, _In_ INT64 frameDuration, _In_ DWORD streamIndex, _In_ ID3D11Texture2D *pAcquiredDesktopImage);
 
 	HRESULT WriteAudioSamplesToVideo(_In_ INT64 frameStartPos, _In_ INT64 frameDuration, _In_ DWORD streamIndex, _In_ BYTE *pSrc, _In_ DWORD cbData);
+	void UpdateQueuedSamples(_In_ DWORD streamIndex, _In_ MetricGauge *pQueuedSamples);
 };
 
@@ -14,6 +14,9 @@
 #include "Screengrab.h"
 #include "DynamicWait.h"
 #include "HighresTimer.h"
+#include "TraceRecorder.h"
+#include "FlightRecorder.h"
+#include "TexturePool.h"
 
 #pragma comment(lib, "dxguid.lib")
 #pragma comment(lib, "D3D11.lib")
@@ -41,8 +44,6 @@ bool isLoggingEnabled = false;
 int logSeverityLevel = LOG_LVL_INFO;
 #endif
 
-std::wstring logFilePath;
-
 // Driver types supported
 D3D_DRIVER_TYPE gDriverTypes[] =
 {
@@ -60,6 +61,13 @@ D3D_FEATURE_LEVEL m_FeatureLevels[] =
 	D3D_FEATURE_LEVEL_9_1
 };
 
+static bool IsAnySourceReplayedAtFullSpeed(_In_ const std::vector<RECORDING_SOURCE *> &sources)
+{
+	return std::any_of(sources.begin(), sources.end(), [](const RECORDING_SOURCE *source) {
+		return source->Type == RecordingSourceType::Replay && source->ReplaySpeed == TraceReplaySpeed::FullSpeed;
+		});
+}
+
 struct RecordingManager::TaskWrapper {
 	Concurrency::task<void> m_RecordTask = concurrency::task_from_result();
 	Concurrency::cancellation_token_source m_RecordTaskCts;
@@ -72,6 +80,7 @@ RecordingManager::RecordingManager() :
 	RecordingSnapshotCreatedCallback(nullptr),
 	RecordingStatusChangedCallback(nullptr),
 	RecordingFrameNumberChangedCallback(nullptr),
+	RecordingStatisticsCallback(nullptr),
 	m_TextureManager(nullptr),
 	m_OutputManager(nullptr),
 	m_CaptureManager(nullptr),
@@ -84,6 +93,8 @@ RecordingManager::RecordingManager() :
 	m_IsDestructing(false),
 	m_RecordingSources{},
 	m_DxResources{},
+	m_Metrics(make_shared<MetricsRegistry>()),
+	m_StatisticsInterval(1000),
 	m_FrameDataCallbackTexture(nullptr)
 {
 	_CrtSetDbgFlag(_CRTDBG_ALLOC_MEM_DF | _CRTDBG_LEAK_CHECK_DF);
@@ -117,17 +128,32 @@ RecordingManager::~RecordingManager()
 	CleanDx(&m_DxResources);
 	MFShutdown();
 	LOG_INFO(L"Media Foundation shut down");
+	FlushLog();
 }
 
 void RecordingManager::SetLogEnabled(bool value) {
 	isLoggingEnabled = value;
 }
 void RecordingManager::SetLogFilePath(std::wstring value) {
-	logFilePath = value;
+	::SetLogFilePath(value);
 }
 void RecordingManager::SetLogSeverityLevel(int value) {
 	logSeverityLevel = value;
 }
+void RecordingManager::SetTraceFilePath(std::wstring value) {
+	m_TraceFilePath = value;
+}
+void RecordingManager::SetCaptureTraceFilePath(std::wstring value) {
+	m_CaptureTraceFilePath = value;
+}
+
+METRICS_SNAPSHOT RecordingManager::GetStatistics() {
+	return std::atomic_load(&m_Metrics)->GetSnapshot();
+}
+
+HRESULT RecordingManager::WriteFlightRecord(_In_ std::wstring path) {
+	return FlightRecorder::Instance().WriteToFile(path);
+}
 
 
 HRESULT RecordingManager::ConfigureOutputDir(_In_ std::wstring path) {
@@ -208,7 +234,7 @@ HRESULT RecordingManager::TakeSnapshot(_In_opt_ std::wstring path, _In_opt_ IStr
 		}
 
 		RETURN_ON_BAD_HR(hr);
-		hr = ProcessTexture(capturedFrame.Frame, &processedTexture, capturedFrame.PtrInfo);
+		hr = ProcessTexture(capturedFrame.Frame, &processedTexture, capturedFrame.PtrInfo, capturedFrame.TimeStamp.QuadPart);
 		SafeRelease(&capturedFrame.Frame);
 	}
 	else {
@@ -291,10 +317,20 @@ HRESULT RecordingManager::BeginRecording(_In_opt_ std::wstring path, _In_opt_ IS
 		return S_FALSE;
 	}
 	m_IsRecording = true;
+	std::atomic_store(&m_Metrics, make_shared<MetricsRegistry>());
 	m_TaskWrapperImpl->m_RecordTaskCts = cancellation_token_source();
-	m_TaskWrapperImpl->m_RecordTask = concurrency::create_task([this, stream]() {
+	m_TaskWrapperImpl->m_RecordTask = concurrency::create_task([this, stream, traceFilePath = m_TraceFilePath]() {
 		LOG_INFO(L"Starting recording task");
 		REC_RESULT result{};
+		if (!traceFilePath.empty()) {
+			TraceRecorder::Instance().Start();
+		}
+		ExecuteFuncOnExit writeTraceOnExit([&]() {
+			if (!traceFilePath.empty()) {
+				TraceRecorder::Instance().Stop();
+				LOG_ON_BAD_HR(TraceRecorder::Instance().WriteToFile(traceFilePath));
+			}
+		});
 		HRESULT hr = CoInitializeEx(nullptr, COINITBASE_MULTITHREADED | COINIT_DISABLE_OLE1DDE);
 		RETURN_RESULT_ON_BAD_HR(hr, L"CoInitializeEx failed");
 		RETURN_RESULT_ON_BAD_HR(hr = InitializeDx(nullptr, &m_DxResources), L"Failed to initialize DirectX");
@@ -302,8 +338,17 @@ HRESULT RecordingManager::BeginRecording(_In_opt_ std::wstring path, _In_opt_ IS
 		m_TextureManager = make_unique<TextureManager>();
 		RETURN_RESULT_ON_BAD_HR(hr = m_TextureManager->Initialize(m_DxResources.Context, m_DxResources.Device), L"Failed to initialize TextureManager");
 		m_OutputManager = make_unique<OutputManager>();
+		m_OutputManager->SetMetricsRegistry(m_Metrics);
+		if (m_MediaClock) {
+			m_OutputManager->SetMediaClock(m_MediaClock);
+		}
+		else if (IsAnySourceReplayedAtFullSpeed(m_RecordingSources)) {
+			//Replays at full speed run on a virtual clock the recorder loop advances frame by frame
+			m_OutputManager->SetMediaClock(make_shared<VirtualMediaClock>());
+		}
 		RETURN_RESULT_ON_BAD_HR(hr = m_OutputManager->Initialize(m_DxResources.Context, m_DxResources.Device, GetEncoderOptions(), GetAudioOptions(), GetSnapshotOptions(), GetOutputOptions()), L"Failed to initialize OutputManager");
 		m_CaptureManager = make_unique<ScreenCaptureManager>();
+		m_CaptureManager->SetMetricsRegistry(m_Metrics);
 		RETURN_RESULT_ON_BAD_HR(m_CaptureManager->Initialize(m_DxResources.Context, m_DxResources.Device, GetOutputOptions(), GetEncoderOptions(), GetMouseOptions()), L"Failed to initialize ScreenCaptureManager");
 		m_MouseManager = make_unique<MouseManager>();
 		RETURN_RESULT_ON_BAD_HR(hr = m_MouseManager->Initialize(m_DxResources.Context, m_DxResources.Device, GetMouseOptions()), L"Failed to initialize mouse manager");
@@ -387,6 +432,9 @@ bool RecordingManager::SetExcludeFromCapture(HWND hwnd, bool isExcluded) {
 
 void RecordingManager::CleanupDxResources()
 {
+	if (m_DxResources.Device) {
+		TexturePool::Shared().Clear(m_DxResources.Device);
+	}
 	SafeRelease(&m_DxResources.Context);
 	SafeRelease(&m_DxResources.Device);
 #if _DEBUG
@@ -402,7 +450,19 @@ void RecordingManager::SetRecordingCompleteStatus(_In_ REC_RESULT result, nlohma
 {
 	std::wstring errMsg = L"";
 	bool isSuccess = SUCCEEDED(result.RecordingResult) && SUCCEEDED(result.FinalizeResult);
+	FlightRecorder::Instance().Record(FlightEventType::RecordingFinished, result.RecordingResult, result.FinalizeResult);
 	if (!isSuccess) {
+		std::wstring flightRecordPath = m_OutputFullPath;
+		if (flightRecordPath.empty()) {
+			wchar_t tempPath[MAX_PATH];
+			GetTempPathW(MAX_PATH, tempPath);
+			flightRecordPath = std::wstring(tempPath) + L"ScreenRecorderLib";
+		}
+		flightRecordPath += FLIGHT_RECORDER_FILE_EXTENSION;
+		if (SUCCEEDED(WriteFlightRecord(flightRecordPath))) {
+			LOG_INFO(L"Wrote flight record of the failed recording to %ls", flightRecordPath.c_str());
+		}
+
 		if (SUCCEEDED(result.RecordingResult) && FAILED(result.FinalizeResult)) {
 			_com_error err(result.FinalizeResult);
 			errMsg = err.ErrorMessage();
@@ -454,8 +514,12 @@ void RecordingManager::SetRecordingCompleteStatus(_In_ REC_RESULT result, nlohma
 REC_RESULT RecordingManager::StartRecorderLoop(_In_ const std::vector<RECORDING_SOURCE *> &sources, _In_ const std::vector<RECORDING_OVERLAY *> &overlays, _In_opt_ IStream *pStream)
 {
 	std::optional<PTR_INFO> pPtrInfo = std::nullopt;
+	//QueryPerformanceCounter time of the most recently captured frame
+	INT64 frameTimeStamp = 0;
 	HRESULT hr = S_OK;
 	auto recorderMode = GetOutputOptions()->GetRecorderMode();
+	TraceRecorder::Instance().SetThreadName("Recorder");
+	FlightRecorder::Instance().Record(FlightEventType::RecordingStarted, S_OK, static_cast<INT64>(recorderMode));
 
 	// Event for when a thread encounters an error
 	HANDLE ErrorEvent = CreateEvent(nullptr, TRUE, FALSE, nullptr);
@@ -465,6 +529,55 @@ REC_RESULT RecordingManager::StartRecorderLoop(_In_ const std::vector<RECORDING_
 	}
 	CloseHandleOnExit closeExpectedErrorEvent(ErrorEvent);
 
+	std::shared_ptr<CursorMetadataWriter> pCursorMetadata = nullptr;
+	if (recorderMode == RecorderModeInternal::Video && GetMouseOptions()->IsMousePointerMetadataEnabled()) {
+		if (pStream) {
+			LOG_WARN(L"Mouse pointer metadata is only supported when recording to a file, the mouse pointer will be drawn on the video frames");
+		}
+		else {
+			pCursorMetadata = make_shared<CursorMetadataWriter>([this](INT64 *pTime) { return m_OutputManager->GetMediaTimeStamp(pTime); });
+			RETURN_RESULT_ON_BAD_HR(hr = pCursorMetadata->Open(CursorMetadataWriter::GetMetadataPath(m_OutputFullPath)), L"Failed to create mouse pointer metadata file");
+			m_CaptureManager->SetCursorMetadataWriter(pCursorMetadata);
+			m_MouseManager->SetCursorMetadataWriter(pCursorMetadata);
+		}
+	}
+	ExecuteFuncOnExit closeCursorMetadataOnExit([&]() {
+		if (pCursorMetadata) {
+			m_MouseManager->SetCursorMetadataWriter(nullptr);
+			LOG_ON_BAD_HR(pCursorMetadata->Close());
+			LOG_DEBUG(L"Wrote %lld mouse pointer records and %zu pointer shapes, skipped %lld unchanged pointer records", pCursorMetadata->GetPointerRecordCount(), pCursorMetadata->GetShapeCount(), pCursorMetadata->GetSkippedPointerRecordCount());
+		}
+	});
+
+	//Replayed sources share the loaded trace with the audio and the pacing of the recorder loop
+	std::vector<std::shared_ptr<CaptureTraceReplay>> replays{};
+	ExecuteFuncOnExit releaseReplaysOnExit([&]() {
+		for each (RECORDING_SOURCE * source in sources)
+		{
+			source->Replay.reset();
+			source->Clock.reset();
+		}
+		for each (RECORDING_OVERLAY * overlay in overlays)
+		{
+			overlay->Clock.reset();
+		}
+	});
+	for each (RECORDING_SOURCE * source in sources)
+	{
+		source->Clock = m_OutputManager->GetMediaClock();
+		if (source->Type == RecordingSourceType::Replay) {
+			std::shared_ptr<CaptureTraceReplay> pReplay = make_shared<CaptureTraceReplay>();
+			RETURN_RESULT_ON_BAD_HR(hr = pReplay->Load(source->SourcePath), L"Failed to load capture trace");
+			pReplay->SetClock(m_OutputManager->GetMediaClock());
+			source->Replay = pReplay;
+			replays.push_back(pReplay);
+		}
+	}
+	for each (RECORDING_OVERLAY * overlay in overlays)
+	{
+		overlay->Clock = m_OutputManager->GetMediaClock();
+	}
+
 	RETURN_RESULT_ON_BAD_HR(hr = m_CaptureManager->StartCapture(sources, overlays, ErrorEvent), L"Failed to start capture");
 
 
@@ -478,10 +591,14 @@ REC_RESULT RecordingManager::StartRecorderLoop(_In_ const std::vector<RECORDING_
 	SetViewPort(m_DxResources.Context, static_cast<float>(videoOutputFrameSize.cx), static_cast<float>(videoOutputFrameSize.cy));
 
 	std::unique_ptr<AudioManager> pAudioManager = make_unique<AudioManager>();
+	pAudioManager->SetMetricsRegistry(m_Metrics);
 
 
 	if (recorderMode == RecorderModeInternal::Video) {
 		hr = pAudioManager->Initialize(GetAudioOptions());
+		if (SUCCEEDED(hr) && !replays.empty() && GetAudioOptions()->IsAudioEnabled()) {
+			LOG_ON_BAD_HR(pAudioManager->SetReplay(replays.front()));
+		}
 		if (SUCCEEDED(hr)) {
 			pAudioManager->StartCapture();
 		}
@@ -495,20 +612,76 @@ REC_RESULT RecordingManager::StartRecorderLoop(_In_ const std::vector<RECORDING_
 	else {
 		RETURN_RESULT_ON_BAD_HR(hr = m_OutputManager->BeginRecording(m_OutputFullPath, videoOutputFrameSize), L"Failed to initialize video sink writer");
 	}
+	if (pCursorMetadata) {
+		LOG_ON_BAD_HR(pCursorMetadata->WriteLayout(GetCursorMetadataLayout(videoInputFrameRect, videoOutputFrameSize)));
+	}
+
+	std::unique_ptr<CaptureTraceWriter> pCaptureTrace = nullptr;
+	if (!m_CaptureTraceFilePath.empty()) {
+		CAPTURE_TRACE_HEADER header{};
+		SIZE canvasSize = m_CaptureManager->GetOutputSize();
+		header.Width = canvasSize.cx;
+		header.Height = canvasSize.cy;
+		if (recorderMode == RecorderModeInternal::Video && GetAudioOptions()->IsAudioEnabled()) {
+			header.AudioSamplesPerSecond = GetAudioOptions()->GetAudioSamplesPerSecond();
+			header.AudioChannels = GetAudioOptions()->GetAudioChannels();
+			header.AudioBitsPerSample = GetAudioOptions()->GetAudioBitsPerSample();
+		}
+		pCaptureTrace = make_unique<CaptureTraceWriter>();
+		RETURN_RESULT_ON_BAD_HR(hr = pCaptureTrace->Open(m_CaptureTraceFilePath, header), L"Failed to create capture trace file");
+	}
+	ExecuteFuncOnExit closeCaptureTraceOnExit([&]() {
+		if (pCaptureTrace) {
+			LOG_ON_BAD_HR(pCaptureTrace->Close());
+			LOG_DEBUG(L"Wrote %lld frames, %lld mouse pointer records and %lld audio packets to the capture trace, %llu bytes in total", pCaptureTrace->GetFrameRecordCount(), pCaptureTrace->GetPointerRecordCount(), pCaptureTrace->GetAudioRecordCount(), pCaptureTrace->GetWrittenByteCount());
+		}
+	});
+	//Staging texture the frames of the capture trace are read back through
+	CComPtr<ID3D11Texture2D> pCaptureTraceTexture = nullptr;
 	pAudioManager->ClearRecordedBytes();
 
-	std::chrono::steady_clock::time_point previousSnapshotTaken = (std::chrono::steady_clock::time_point::min)();
-	double videoFrameDurationMillis = 0;
+	//All timing of the loop is taken from the media clock, in 100 nanosecond units
+	std::shared_ptr<MediaClock> pMediaClock = m_OutputManager->GetMediaClock();
+	//On a virtual clock, the loop advances the clock to the next frame instead of waiting for it, so the recording runs as fast as frames are processed
+	std::shared_ptr<VirtualMediaClock> pVirtualClock = std::dynamic_pointer_cast<VirtualMediaClock>(pMediaClock);
+	std::optional<INT64> previousSnapshotTime = std::nullopt;
+	INT64 snapshotInterval100Nanos = MillisToHundredNanos(static_cast<double>(GetSnapshotOptions()->GetSnapshotsInterval().count()));
+	MEDIA_RATE videoFrameRate{ GetEncoderOptions()->GetVideoFps(), GetEncoderOptions()->GetVideoFpsDenominator() };
+	//Frames of a fixed frame rate start at the times of their frame index, so they do not drift from the frame rate over long recordings
+	bool isFrameTimeFromIndex = recorderMode == RecorderModeInternal::Video && GetEncoderOptions()->GetIsFixedFramerate() && videoFrameRate.Numerator > 0;
+	INT64 videoFrameDuration100Nanos = 0;
 	if (recorderMode == RecorderModeInternal::Video) {
-		videoFrameDurationMillis = (double)1000 / GetEncoderOptions()->GetVideoFps();
+		videoFrameDuration100Nanos = MediaTimeFromCount(1, videoFrameRate);
 	}
 	else if (recorderMode == RecorderModeInternal::Slideshow) {
-		videoFrameDurationMillis = (double)GetSnapshotOptions()->GetSnapshotsInterval().count();
+		videoFrameDuration100Nanos = snapshotInterval100Nanos;
 	}
-	INT64 videoFrameDuration100Nanos = MillisToHundredNanos(videoFrameDurationMillis);
+	double videoFrameDurationMillis = HundredNanosToMillisDouble(videoFrameDuration100Nanos);
+
+	MetricCounter &renderedFrames = m_Metrics->GetCounter(L"recorder.frames");
+	//Frames rendered without any source having updated since the previous frame
+	MetricCounter &unchangedFrames = m_Metrics->GetCounter(L"recorder.unchanged_frames");
+	//Output frames at a fixed frame rate that were skipped because the previous frame took too long
+	MetricCounter &droppedFrames = m_Metrics->GetCounter(L"recorder.dropped_frames");
+	LatencyHistogram &frameInterval = m_Metrics->GetHistogram(L"recorder.frame_interval");
+	LatencyHistogram &frameTime = m_Metrics->GetHistogram(L"recorder.frame_time");
+	MetricGauge &achievedFps = m_Metrics->GetGauge(L"recorder.fps");
+	//Texture pool statistics are shared by all recordings in the process, so the counters hold the change since this recording started
+	MetricCounter &texturePoolHits = m_Metrics->GetCounter(L"texture_pool.hits");
+	MetricCounter &texturePoolMisses = m_Metrics->GetCounter(L"texture_pool.misses");
+	MetricCounter &texturePoolEvictions = m_Metrics->GetCounter(L"texture_pool.evictions");
+	MetricGauge &texturePoolTextures = m_Metrics->GetGauge(L"texture_pool.textures");
+	MetricGauge &texturePoolBytes = m_Metrics->GetGauge(L"texture_pool.bytes");
+	TEXTURE_POOL_STATISTICS previousTexturePoolStatistics = TexturePool::Shared().GetStatistics();
+	INT64 fpsWindowStartTime = 0;
+	int fpsWindowStartFrameNr = 0;
+	std::optional<INT64> previousStatisticsTime = std::nullopt;
+	INT64 statisticsInterval100Nanos = MillisToHundredNanos(static_cast<double>(m_StatisticsInterval.count()));
 
 	int frameNr = 0;
 	INT64 lastFrameStartPos100Nanos = 0;
+	//Frame index the last frame started at, when frame times are calculated from the frame index
+	INT64 lastFrameIndex = 0;
 	cancellation_token token = m_TaskWrapperImpl->m_RecordTaskCts.get_token();
 	DynamicWait retryWait{};
 	INT64 totalDiff = 0;
@@ -524,44 +697,86 @@ REC_RESULT RecordingManager::StartRecorderLoop(_In_ const std::vector<RECORDING_
 			return false;
 		});
 
+	auto GetNextFrameDuration100Nanos([&]() {
+		if (isFrameTimeFromIndex) {
+			return MediaTimeFromCount(lastFrameIndex + 1, videoFrameRate) - lastFrameStartPos100Nanos;
+		}
+		return videoFrameDuration100Nanos;
+		});
+
 	auto GetTimeUntilNextFrameMillis([&]() {
-		INT64 timestamp;
-		m_OutputManager->GetMediaTimeStamp(&timestamp);
-		INT64 durationSinceLastFrame100Nanos = timestamp - lastFrameStartPos100Nanos;
-		INT64 nanosRemaining = max(0, videoFrameDuration100Nanos - durationSinceLastFrame100Nanos);
-		return HundredNanosToMillisDouble(nanosRemaining);
+		return HundredNanosToMillisDouble(GetTimeUntilNextFrame(pMediaClock->GetTime(), lastFrameStartPos100Nanos, GetNextFrameDuration100Nanos()));
 		});
 
-	auto IsTimeToTakeSnapshot([&]()
-	{
-		// The first condition is needed since (now - min) yields negative value because of overflow...
-		return previousSnapshotTaken == (std::chrono::steady_clock::time_point::min)() ||
-			(std::chrono::steady_clock::now() - previousSnapshotTaken) > GetSnapshotOptions()->GetSnapshotsInterval();
-	});
+	auto WriteCaptureTraceRecords([&](const CAPTURED_FRAME &frame, INT64 timeStamp)->HRESULT {
+		TRACE_SPAN("WriteCaptureTrace");
+		HRESULT traceHr = S_FALSE;
+		//Unchanged frames are not read back, except for the first frame of the trace
+		if (frame.Frame && (frame.FrameUpdateCount > 0 || pCaptureTrace->GetFrameRecordCount() == 0)) {
+			D3D11_TEXTURE2D_DESC desc;
+			frame.Frame->GetDesc(&desc);
+			if (pCaptureTraceTexture) {
+				D3D11_TEXTURE2D_DESC stagingDesc;
+				pCaptureTraceTexture->GetDesc(&stagingDesc);
+				if (stagingDesc.Width != desc.Width || stagingDesc.Height != desc.Height) {
+					pCaptureTraceTexture.Release();
+				}
+			}
+			if (!pCaptureTraceTexture) {
+				desc.Usage = D3D11_USAGE_STAGING;
+				desc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+				desc.MiscFlags = 0;
+				desc.BindFlags = 0;
+				RETURN_ON_BAD_HR(traceHr = m_DxResources.Device->CreateTexture2D(&desc, nullptr, &pCaptureTraceTexture));
+			}
+			m_DxResources.Context->CopyResource(pCaptureTraceTexture, frame.Frame);
+			D3D11_MAPPED_SUBRESOURCE map;
+			RETURN_ON_BAD_HR(traceHr = m_DxResources.Context->Map(pCaptureTraceTexture, 0, D3D11_MAP_READ, 0, &map));
+			traceHr = pCaptureTrace->WriteFrame(timeStamp, static_cast<const UINT *>(map.pData), desc.Width, desc.Height, map.RowPitch / 4);
+			m_DxResources.Context->Unmap(pCaptureTraceTexture, 0);
+			RETURN_ON_BAD_HR(traceHr);
+		}
+		if (frame.PtrInfo) {
+			const PTR_INFO &ptrInfo = frame.PtrInfo.value();
+			UINT shapeSize = min(ptrInfo.BufferSize, ptrInfo.ShapeInfo.Pitch * ptrInfo.ShapeInfo.Height);
+			RETURN_ON_BAD_HR(traceHr = pCaptureTrace->WritePointer(timeStamp, ptrInfo.Position, ptrInfo.Visible, ptrInfo.ShapeInfo, ptrInfo.PtrShapeBuffer, shapeSize));
+		}
+		return traceHr;
+		});
 
-	auto PrepareAndRenderFrame([&](CComPtr<ID3D11Texture2D> pTextureToRender, INT64 duration100Nanos)->HRESULT {
+	auto PrepareAndRenderFrame([&](CComPtr<ID3D11Texture2D> pTextureToRender, INT64 frameEndPos100Nanos)->HRESULT {
+		TRACE_SPAN("PrepareAndRenderFrame");
+		INT64 duration100Nanos = frameEndPos100Nanos - lastFrameStartPos100Nanos;
+		LatencyTimer frameTimer(frameTime);
 		CComPtr<ID3D11Texture2D> processedTexture;
-		HRESULT renderHr = ProcessTexture(pTextureToRender, &processedTexture, pPtrInfo);
+		HRESULT renderHr = ProcessTexture(pTextureToRender, &processedTexture, pPtrInfo, frameTimeStamp);
 		if (renderHr == S_OK) {
 			pTextureToRender.Release();
 			pTextureToRender.Attach(processedTexture);
 			(*pTextureToRender).AddRef();
 		}
 		if (recorderMode == RecorderModeInternal::Video) {
-			if (GetSnapshotOptions()->IsSnapshotWithVideoEnabled() && IsTimeToTakeSnapshot()) {
+			if (GetSnapshotOptions()->IsSnapshotWithVideoEnabled() && IsSnapshotDue(pMediaClock->GetTime(), previousSnapshotTime, snapshotInterval100Nanos)) {
 				if (GetSnapshotOptions()->GetSnapshotsDirectory().empty())
 					return S_FALSE;
 				wstring snapshotPath = GetSnapshotOptions()->GetSnapshotsDirectory() + L"\\" + s2ws(CurrentTimeToFormattedString(true)) + GetSnapshotOptions()->GetImageExtension();
 				TakeSnapshot(snapshotPath, nullptr, pTextureToRender);
-				previousSnapshotTaken = steady_clock::now();
+				previousSnapshotTime = pMediaClock->GetTime();
 			}
 		}
 
 		INT64 diff = 0;
-		auto audioBytes = pAudioManager->GrabAudioFrame(duration100Nanos);
+		std::vector<BYTE> audioBytes;
+		{
+			TRACE_SPAN("GrabAudioFrame");
+			audioBytes = pAudioManager->GrabAudioFrame(duration100Nanos);
+		}
+		if (pCaptureTrace && audioBytes.size() > 0) {
+			LOG_ON_BAD_HR(pCaptureTrace->WriteAudio(lastFrameStartPos100Nanos + totalDiff, audioBytes));
+		}
 		if (audioBytes.size() > 0) {
 			INT64 frameCount = audioBytes.size() / (INT64)((GetAudioOptions()->GetAudioBitsPerSample() / 8) * GetAudioOptions()->GetAudioChannels());
-			INT64 newDuration = (frameCount * 10 * 1000 * 1000) / GetAudioOptions()->GetAudioSamplesPerSecond();
+			INT64 newDuration = MediaTimeFromCount(frameCount, MEDIA_RATE{ GetAudioOptions()->GetAudioSamplesPerSecond(), 1 });
 			diff = newDuration - duration100Nanos;
 		}
 
@@ -572,15 +787,18 @@ REC_RESULT RecordingManager::StartRecorderLoop(_In_ const std::vector<RECORDING_
 		model.Audio = audioBytes;
 		RETURN_ON_BAD_HR(renderHr = m_EncoderResult = m_OutputManager->RenderFrame(model));
 		frameNr++;
+		renderedFrames.Add();
 		totalDiff += diff;
 		if (RecordingFrameNumberChangedCallback != nullptr && !m_IsDestructing) {
+			TRACE_SPAN("FrameNumberChangedCallback");
 			SendNewFrameCallback(frameNr, pTextureToRender);
 		}
-		lastFrameStartPos100Nanos += duration100Nanos;
+		lastFrameStartPos100Nanos = frameEndPos100Nanos;
 		return renderHr;
 	});
 
 	auto RestartCapture([&](CAPTURE_RESULT result) {
+		FlightRecorder::Instance().Record(FlightEventType::CaptureRestarting, result.RecordingResult, m_RestartCaptureCount, result.IsDeviceError ? 1 : 0);
 		//Stop existing capture
 		hr = m_CaptureManager->StopCapture();
 
@@ -626,20 +844,28 @@ REC_RESULT RecordingManager::StartRecorderLoop(_In_ const std::vector<RECORDING_
 				m_RestartCaptureCount++;
 			}
 			ResetEvent(ErrorEvent);
+			m_CaptureManager->SetCursorMetadataWriter(pCursorMetadata);
+			m_CaptureManager->SetMetricsRegistry(m_Metrics);
 			hr = m_CaptureManager->StartCapture(sources, overlays, ErrorEvent);
 		}
 		if (SUCCEEDED(hr)) {
 			//The source dimensions may have changed
 			hr = InitializeRects(m_CaptureManager->GetOutputSize(), &videoInputFrameRect, nullptr);
 			LOG_TRACE(L"Reinitialized input frame rect: [%d,%d,%d,%d]", videoInputFrameRect.left, videoInputFrameRect.top, videoInputFrameRect.right, videoInputFrameRect.bottom);
+			if (pCursorMetadata) {
+				LOG_ON_BAD_HR(pCursorMetadata->WriteLayout(GetCursorMetadataLayout(videoInputFrameRect, videoOutputFrameSize)));
+			}
 		}
 		pPtrInfo.reset();
-
+		//The staging texture belongs to the device the capture ran on before the restart
+		pCaptureTraceTexture.Release();
+		FlightRecorder::Instance().Record(FlightEventType::CaptureRestarted, hr);
 		return hr;
 	});
 
 	while (true)
 	{
+		TraceRecorder::Instance().SetFrameNumber(frameNr);
 		if (token.is_canceled()) {
 			LOG_DEBUG("Recording task was cancelled");
 			hr = S_OK;
@@ -689,11 +915,11 @@ REC_RESULT RecordingManager::StartRecorderLoop(_In_ const std::vector<RECORDING_
 			}
 		}
 		if (m_IsPaused) {
-			if (m_OutputManager->isMediaClockRunning()) {
-				m_OutputManager->PauseMediaClock();
+			if (pMediaClock->GetState() == MediaClockState::Running) {
+				pMediaClock->Pause();
 			}
 			ExecuteFuncOnExit clearDataOnExit([&]() {
-				previousSnapshotTaken = steady_clock::now();
+				previousSnapshotTime = pMediaClock->GetTime();
 				if (pAudioManager)
 					pAudioManager->ClearRecordedBytes();
 			});
@@ -703,8 +929,19 @@ REC_RESULT RecordingManager::StartRecorderLoop(_In_ const std::vector<RECORDING_
 			}
 		}
 		CAPTURED_FRAME capturedFrame{};
+		if (pVirtualClock && !m_IsPaused) {
+			pVirtualClock->Advance(GetTimeUntilNextFrame(pMediaClock->GetTime(), lastFrameStartPos100Nanos, GetNextFrameDuration100Nanos()));
+		}
+		for each (std::shared_ptr<CaptureTraceReplay> pReplay in replays)
+		{
+			//On a virtual clock, wait for the replayed sources to present everything due, so every run renders the same frames
+			DWORD presentTimeoutMillis = pVirtualClock ? static_cast<DWORD>(m_MaxFrameLengthMillis) : 0;
+			if (pReplay->PresentUntil(pMediaClock->GetTime(), presentTimeoutMillis) != S_OK && pVirtualClock) {
+				LOG_WARN(L"Replayed source did not present the records due within %u ms", presentTimeoutMillis);
+			}
+		}
 		// Get new frame
-		hr = m_CaptureManager->AcquireNextFrame(GetTimeUntilNextFrameMillis(), m_MaxFrameLengthMillis, &capturedFrame);
+		hr = m_CaptureManager->AcquireNextFrame(GetTimeUntilNextFrameMillis(), pVirtualClock ? 0 : m_MaxFrameLengthMillis, &capturedFrame);
 
 		//If there are any source previews on paused status, the loop exits here. This allows the source previews to continu render.
 		if (m_IsPaused) {
@@ -715,16 +952,35 @@ REC_RESULT RecordingManager::StartRecorderLoop(_In_ const std::vector<RECORDING_
 			if (capturedFrame.FrameUpdateCount > 0) {
 				m_RestartCaptureCount = 0;
 			}
-			if (capturedFrame.PtrInfo) {
+			frameTimeStamp = capturedFrame.TimeStamp.QuadPart;
+			//When the pointer is recorded as metadata, it is not drawn on the frames.
+			if (capturedFrame.PtrInfo && !pCursorMetadata) {
 				pPtrInfo = capturedFrame.PtrInfo.value();
 			}
+			if (pCaptureTrace) {
+				LOG_ON_BAD_HR(WriteCaptureTraceRecords(capturedFrame, pMediaClock->GetTime()));
+			}
 		}
 		else if (hr != DXGI_ERROR_WAIT_TIMEOUT) {
 			RETURN_RESULT_ON_BAD_HR(hr, L"");
 		}
-		INT64 timestamp;
-		RETURN_ON_BAD_HR(m_OutputManager->GetMediaTimeStamp(&timestamp));
-		INT64 durationSinceLastFrame100Nanos = timestamp - lastFrameStartPos100Nanos;
+		INT64 frameEndPos100Nanos = pMediaClock->GetTime();
+		INT64 durationSinceLastFrame100Nanos = frameEndPos100Nanos - lastFrameStartPos100Nanos;
+		INT64 frameIndex = lastFrameIndex;
+		if (isFrameTimeFromIndex) {
+			frameIndex = FrameIndexFromMediaTime(frameEndPos100Nanos, lastFrameIndex, videoFrameRate);
+			frameEndPos100Nanos = MediaTimeFromCount(frameIndex, videoFrameRate);
+		}
+		if (capturedFrame.FrameUpdateCount == 0) {
+			unchangedFrames.Add();
+		}
+		if (frameNr > 0) {
+			frameInterval.Record(durationSinceLastFrame100Nanos);
+			if (isFrameTimeFromIndex) {
+				//A late frame takes the place of the frames that were due before it
+				droppedFrames.Add(frameIndex - lastFrameIndex - 1);
+			}
+		}
 
 
 
@@ -739,7 +995,32 @@ REC_RESULT RecordingManager::StartRecorderLoop(_In_ const std::vector<RECORDING_
 				LOG_DEBUG("Changed Recording Status to Recording");
 			}
 		}
-		RETURN_RESULT_ON_BAD_HR(hr = PrepareAndRenderFrame(capturedFrame.Frame, durationSinceLastFrame100Nanos), L"Failed to render frame");
+		INT64 frameStartPos100Nanos = lastFrameStartPos100Nanos;
+		hr = PrepareAndRenderFrame(capturedFrame.Frame, frameEndPos100Nanos);
+		lastFrameIndex = frameIndex;
+		FlightRecorder::Instance().Record(FlightEventType::FrameRendered, hr, frameStartPos100Nanos, static_cast<UINT16>(min(capturedFrame.FrameUpdateCount, MAXUINT16)));
+		RETURN_RESULT_ON_BAD_HR(hr, L"Failed to render frame");
+		INT64 now = pMediaClock->GetTime();
+		if (now - fpsWindowStartTime >= MEDIA_TIME_UNITS_PER_SECOND) {
+			achievedFps.Set((frameNr - fpsWindowStartFrameNr) * static_cast<double>(MEDIA_TIME_UNITS_PER_SECOND) / (now - fpsWindowStartTime));
+			fpsWindowStartTime = now;
+			fpsWindowStartFrameNr = frameNr;
+			TEXTURE_POOL_STATISTICS texturePoolStatistics = TexturePool::Shared().GetStatistics();
+			texturePoolHits.Add(texturePoolStatistics.Hits - previousTexturePoolStatistics.Hits);
+			texturePoolMisses.Add(texturePoolStatistics.Misses - previousTexturePoolStatistics.Misses);
+			texturePoolEvictions.Add(texturePoolStatistics.Evictions - previousTexturePoolStatistics.Evictions);
+			texturePoolTextures.Set(texturePoolStatistics.TextureCount);
+			texturePoolBytes.Set(static_cast<double>(texturePoolStatistics.SizeInBytes));
+			previousTexturePoolStatistics = texturePoolStatistics;
+		}
+		if (RecordingStatisticsCallback != nullptr && !m_IsDestructing && IsSnapshotDue(now, previousStatisticsTime, statisticsInterval100Nanos)) {
+			previousStatisticsTime = now;
+			RecordingStatisticsCallback(m_Metrics->GetSnapshot());
+		}
+		if (!replays.empty() && std::all_of(replays.begin(), replays.end(), [&](const std::shared_ptr<CaptureTraceReplay> &pReplay) { return now >= pReplay->GetDuration(); })) {
+			LOG_INFO(L"Reached the end of the replayed capture trace");
+			break;
+		}
 		if (recorderMode == RecorderModeInternal::Screenshot) {
 			break;
 		}
@@ -839,6 +1120,7 @@ HRESULT RecordingManager::InitializeRects(_In_ SIZE captureFrameSize, _Out_opt_
 
 HRESULT RecordingManager::ProcessTextureTransforms(_In_ ID3D11Texture2D *pTexture, _Out_ ID3D11Texture2D **ppProcessedTexture, RECT videoInputFrameRect, SIZE videoOutputFrameSize)
 {
+	TRACE_SPAN("ProcessTextureTransforms");
 	D3D11_TEXTURE2D_DESC desc;
 	pTexture->GetDesc(&desc);
 	HRESULT hr = S_FALSE;
@@ -860,7 +1142,11 @@ HRESULT RecordingManager::ProcessTextureTransforms(_In_ ID3D11Texture2D *pTextur
 		desc.Width = videoOutputFrameSize.cx;
 		desc.Height = videoOutputFrameSize.cy;
 		ID3D11Texture2D *pCanvas;
-		RETURN_ON_BAD_HR(hr = m_DxResources.Device->CreateTexture2D(&desc, nullptr, &pCanvas));
+		RETURN_ON_BAD_HR(hr = TexturePool::Shared().Acquire(m_DxResources.Device, desc, &pCanvas));
+		//Canvases from the pool hold the previous frame, so the margins around the content are blanked
+		if (RectWidth(contentRect) < videoOutputFrameSize.cx || RectHeight(contentRect) < videoOutputFrameSize.cy) {
+			m_TextureManager->BlankTexture(pCanvas, RECT{ 0, 0, videoOutputFrameSize.cx, videoOutputFrameSize.cy });
+		}
 		int leftMargin = (int)max(0, round(((double)videoOutputFrameSize.cx - (double)RectWidth(contentRect))) / 2);
 		int topMargin = (int)max(0, round(((double)videoOutputFrameSize.cy - (double)RectHeight(contentRect))) / 2);
 
@@ -883,6 +1169,59 @@ HRESULT RecordingManager::ProcessTextureTransforms(_In_ ID3D11Texture2D *pTextur
 	return hr;
 }
 
+CURSOR_METADATA_LAYOUT RecordingManager::GetCursorMetadataLayout(_In_ RECT videoInputFrameRect, _In_ SIZE videoOutputFrameSize)
+{
+	CURSOR_METADATA_LAYOUT layout{};
+	layout.OutputWidth = videoOutputFrameSize.cx;
+	layout.OutputHeight = videoOutputFrameSize.cy;
+	LONG inputWidth = RectWidth(videoInputFrameRect);
+	LONG inputHeight = RectHeight(videoInputFrameRect);
+	if (inputWidth <= 0 || inputHeight <= 0) {
+		return layout;
+	}
+	LONG contentWidth = inputWidth;
+	LONG contentHeight = inputHeight;
+	int leftMargin = 0;
+	int topMargin = 0;
+	//Same size calculations as in TextureManager::ResizeTexture and the margins in ProcessTextureTransforms
+	if (inputWidth != videoOutputFrameSize.cx || inputHeight != videoOutputFrameSize.cy) {
+		double widthRatio = static_cast<double>(videoOutputFrameSize.cx) / inputWidth;
+		double heightRatio = static_cast<double>(videoOutputFrameSize.cy) / inputHeight;
+		switch (GetOutputOptions()->GetStretch())
+		{
+			case TextureStretchMode::Fill: {
+				contentWidth = MakeEven(videoOutputFrameSize.cx);
+				contentHeight = MakeEven(videoOutputFrameSize.cy);
+				break;
+			}
+			case TextureStretchMode::UniformToFill: {
+				double resizeRatio = max(widthRatio, heightRatio);
+				contentWidth = MakeEven((LONG)round(inputWidth * resizeRatio));
+				contentHeight = MakeEven((LONG)round(inputHeight * resizeRatio));
+				break;
+			}
+			case TextureStretchMode::Uniform: {
+				double resizeRatio = min(widthRatio, heightRatio);
+				contentWidth = MakeEven((LONG)round(inputWidth * resizeRatio));
+				contentHeight = MakeEven((LONG)round(inputHeight * resizeRatio));
+				break;
+			}
+			case TextureStretchMode::None:
+			default:
+				contentWidth = MakeEven(inputWidth);
+				contentHeight = MakeEven(inputHeight);
+				break;
+		}
+		leftMargin = (int)max(0, round(((double)videoOutputFrameSize.cx - (double)contentWidth)) / 2);
+		topMargin = (int)max(0, round(((double)videoOutputFrameSize.cy - (double)contentHeight)) / 2);
+	}
+	layout.ScaleX = static_cast<double>(contentWidth) / inputWidth;
+	layout.ScaleY = static_cast<double>(contentHeight) / inputHeight;
+	layout.OffsetX = leftMargin - videoInputFrameRect.left * layout.ScaleX;
+	layout.OffsetY = topMargin - videoInputFrameRect.top * layout.ScaleY;
+	return layout;
+}
+
 bool RecordingManager::CheckDependencies(_Out_ std::wstring *error)
 {
 	wstring errorText;
@@ -980,14 +1319,18 @@ HRESULT RecordingManager::SaveTextureAsVideoSnapshot(_In_ ID3D11Texture2D *pText
 	return m_OutputManager->WriteFrameToImage(pProcessedTexture, pStream);
 }
 
-HRESULT RecordingManager::ProcessTexture(_In_ ID3D11Texture2D *pTexture, _Out_ ID3D11Texture2D **ppProcessedTexture, _In_opt_ std::optional<PTR_INFO> pPtrInfo = std::nullopt)
+HRESULT RecordingManager::ProcessTexture(_In_ ID3D11Texture2D *pTexture, _Out_ ID3D11Texture2D **ppProcessedTexture, _In_opt_ std::optional<PTR_INFO> pPtrInfo, _In_ INT64 frameTimeStamp)
 {
 	*ppProcessedTexture = nullptr;
 	HRESULT hr = E_FAIL;
 	int updatedOverlaysCount = 0;
-	m_CaptureManager->ProcessOverlays(pTexture, &updatedOverlaysCount);
+	{
+		TRACE_SPAN("ProcessOverlays");
+		m_CaptureManager->ProcessOverlays(pTexture, &updatedOverlaysCount);
+	}
 	if (pPtrInfo) {
-		hr = m_MouseManager->ProcessMousePointer(pTexture, &pPtrInfo.value());
+		TRACE_SPAN("ProcessMousePointer");
+		hr = m_MouseManager->ProcessMousePointer(pTexture, &pPtrInfo.value(), frameTimeStamp);
 		if (FAILED(hr)) {
 			_com_error err(hr);
 			LOG_ERROR(L"Error drawing mouse pointer: %s", err.ErrorMessage());
@@ -4,6 +4,9 @@
 #include "AudioManager.h"
 #include "OutputManager.h"
 #include "ScreenCaptureManager.h"
+#include "CursorMetadata.h"
+#include "CaptureTrace.h"
+#include "MetricsRegistry.h"
 #include "Log.h"
 #include "fifo_map.h"
 #include "CommonTypes.h"
@@ -12,6 +15,7 @@ typedef void(__stdcall *CallbackStatusChangedFunction)(int);
 typedef void(__stdcall *CallbackErrorFunction)(std::wstring, std::wstring);
 typedef void(__stdcall *CallbackSnapshotFunction)(std::wstring);
 typedef void(__stdcall *CallbackFrameNumberChangedFunction)(int, INT64, _In_opt_ FRAME_BITMAP_DATA *data);
+typedef void(__stdcall *CallbackStatisticsFunction)(const METRICS_SNAPSHOT &);
 
 #define STATUS_IDLE 0
 #define STATUS_RECORDING 1
@@ -31,6 +35,8 @@ public:
 	CallbackStatusChangedFunction RecordingStatusChangedCallback;
 	CallbackSnapshotFunction RecordingSnapshotCreatedCallback;
 	CallbackFrameNumberChangedFunction RecordingFrameNumberChangedCallback;
+	//Called from the recording thread with the statistics of the recording, once per statistics interval
+	CallbackStatisticsFunction RecordingStatisticsCallback;
 	HRESULT TakeSnapshot(_In_ std::wstring path);
 	HRESULT TakeSnapshot(_In_ IStream *stream);
 	HRESULT BeginRecording(_In_ std::wstring path);
@@ -112,6 +118,15 @@ public:
 	void SetLogEnabled(bool value);
 	void SetLogFilePath(std::wstring value);
 	void SetLogSeverityLevel(int value);
+	/// <summary>
+	/// Sets a path to write a Chrome trace event file of the recording pipeline to when a recording ends, or an empty path to not trace.
+	/// </summary>
+	void SetTraceFilePath(std::wstring value);
+	/// <summary>
+	/// Sets a path to record the frames, mouse pointer and audio the recording pipeline receives to, so they can be replayed with a replay recording source.
+	/// Changed frames are read back from the GPU while recording. An empty path does not record a capture trace.
+	/// </summary>
+	void SetCaptureTraceFilePath(std::wstring value);
 
 	void SetEncoderOptions(ENCODER_OPTIONS *options) { m_EncoderOptions.reset(options); }
 	std::shared_ptr<ENCODER_OPTIONS> GetEncoderOptions() { return m_EncoderOptions; }
@@ -123,6 +138,24 @@ public:
 	std::shared_ptr<SNAPSHOT_OPTIONS> GetSnapshotOptions() { return m_SnapshotOptions; }
 	void SetOutputOptions(OUTPUT_OPTIONS *options) { m_OutputOptions.reset(options); }
 	std::shared_ptr<OUTPUT_OPTIONS> GetOutputOptions() { return m_OutputOptions; }
+	/// <summary>
+	/// Sets the clock recordings are paced and time stamped by. The recorder advances a VirtualMediaClock itself, one frame at a time,
+	/// so a recording on it runs as fast as the frames are processed. Takes effect on the next recording.
+	/// </summary>
+	void SetMediaClock(_In_ std::shared_ptr<MediaClock> pMediaClock) { m_MediaClock = pMediaClock; }
+	/// <summary>
+	/// Gets the frame rate, frame counts, latency histograms and queue depths of the current recording, or of the last one if none is running.
+	/// Metrics of recording sources are broken down by the source ID. Can be called from any thread.
+	/// </summary>
+	METRICS_SNAPSHOT GetStatistics();
+	/// <summary>
+	/// Sets how often RecordingStatisticsCallback is called while recording, in media time.
+	/// </summary>
+	void SetStatisticsInterval(_In_ std::chrono::milliseconds value) { m_StatisticsInterval = value; }
+	/// <summary>
+	/// Writes the most recent pipeline events of the flight recorder to a file. This is done automatically when a recording fails.
+	/// </summary>
+	HRESULT WriteFlightRecord(_In_ std::wstring path);
 private:
 	bool m_IsDestructing;
 	UINT m_TimerResolution;
@@ -153,6 +186,13 @@ private:
 	std::shared_ptr<MOUSE_OPTIONS> m_MouseOptions;
 	std::shared_ptr<SNAPSHOT_OPTIONS> m_SnapshotOptions;
 	std::shared_ptr<OUTPUT_OPTIONS> m_OutputOptions;
+	// Clock set with SetMediaClock, or nullptr to record in real time
+	std::shared_ptr<MediaClock> m_MediaClock;
+	std::wstring m_TraceFilePath;
+	std::wstring m_CaptureTraceFilePath;
+	// Metrics of the current or last recording. Replaced when a recording begins, so it must be read with std::atomic_load.
+	std::shared_ptr<MetricsRegistry> m_Metrics;
+	std::chrono::milliseconds m_StatisticsInterval;
 
 	ID3D11Texture2D *m_FrameDataCallbackTexture;
 	D3D11_TEXTURE2D_DESC m_FrameDataCallbackTextureDesc;
@@ -203,9 +243,10 @@ private:
 	/// </summary>
 	/// <param name="pTexture">The texture to process</param>
 	/// <param name="pPtrInfo">Mouse pointer info (optional).</param>
+	/// <param name="frameTimeStamp">QueryPerformanceCounter time the texture was captured, used to draw the mouse clicks that happened before it.</param>
 	/// <param name="ppProcessedTexture">The output texture.</param>
 	/// <returns>S_OK if any processing has been done, S_FALSE if no changes, else an error code</returns>
-	HRESULT ProcessTexture(_In_ ID3D11Texture2D *pTexture, _Out_ ID3D11Texture2D **ppProcessedTexture, _In_opt_ std::optional<PTR_INFO> pPtrInfo);
+	HRESULT ProcessTexture(_In_ ID3D11Texture2D *pTexture, _Out_ ID3D11Texture2D **ppProcessedTexture, _In_opt_ std::optional<PTR_INFO> pPtrInfo, _In_ INT64 frameTimeStamp);
 
 	/// <summary>
 	/// Perform cropping and resizing on texture if needed.
@@ -217,6 +258,13 @@ private:
 	/// <returns>S_OK if any processing has been done, S_FALSE if no changes, else an error code</returns>
 	HRESULT ProcessTextureTransforms(_In_ ID3D11Texture2D *pTexture, _Out_ ID3D11Texture2D **ppProcessedTexture, RECT videoInputFrameRect, SIZE videoOutputFrameSize);
 
+	/// <summary>
+	/// Returns the mapping from canvas to video frame coordinates done by ProcessTextureTransforms, for the cursor metadata file.
+	/// </summary>
+	/// <param name="videoInputFrameRect">The source rectangle.</param>
+	/// <param name="videoOutputFrameSize">The output dimensions.</param>
+	CURSOR_METADATA_LAYOUT GetCursorMetadataLayout(_In_ RECT videoInputFrameRect, _In_ SIZE videoOutputFrameSize);
+
 	/// <summary>
 	/// Releases DirectX resources and reports any leaks
 	/// </summary>
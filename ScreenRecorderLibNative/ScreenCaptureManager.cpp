@@ -7,9 +7,21 @@
 #include "VideoReader.h"
 #include "ImageReader.h"
 #include "GifReader.h"
+#include "TestPatternCapture.h"
+#include "TraceReplayCapture.h"
 #include <typeinfo>
 #include "DynamicWait.h"
 #include "Exception.h"
+#include "TripleBufferedTexture.h"
+#include "CaptureScheduler.h"
+#include "CursorMetadata.h"
+#include "TraceRecorder.h"
+#include "FlightRecorder.h"
+
+//Overlays on a pinned thread block in the source for up to this long waiting for a new frame.
+#define PINNED_OVERLAY_ACQUIRE_TIMEOUT_MILLIS 10
+//Overlays on the worker pool never block, and instead poll their source at this interval.
+#define POOLED_OVERLAY_POLL_INTERVAL_MILLIS 10
 
 using namespace DirectX;
 using namespace std::chrono;
@@ -17,28 +29,94 @@ using namespace std;
 DWORD WINAPI CaptureThreadProc(_In_ void *Param);
 DWORD WINAPI OverlayCaptureThreadProc(_In_ void *Param);
 _Ret_maybenull_ CaptureBase *CreateCaptureInstance(_In_ RECORDING_SOURCE_BASE *pSource);
+bool IsPooledCaptureSource(_In_ RECORDING_SOURCE_BASE *pSource);
+HRESULT WriteCursorMetadata(_In_ CursorMetadataWriter *pWriter, _In_ PTR_INFO *pPtrInfo);
+
+//
+// Captures an overlay one frame at a time, so the same capture logic can run either in a loop on a pinned thread,
+// or as a recurring task on the capture scheduler.
+//
+class OverlayCaptureTask
+{
+public:
+	/// <param name="pData">The overlay to capture</param>
+	/// <param name="acquireTimeoutMillis">Time to block waiting for a new frame from the overlay source on each run</param>
+	/// <param name="frameIntervalMillis">Time until the next run after a frame has been published</param>
+	/// <param name="pDeviceCriticalSection">Held during each run, if the device of the overlay is shared with other tasks</param>
+	OverlayCaptureTask(_In_ OVERLAY_THREAD_DATA *pData, _In_ DWORD acquireTimeoutMillis, _In_ DWORD frameIntervalMillis, _In_opt_ CRITICAL_SECTION *pDeviceCriticalSection = nullptr);
+
+	/// <summary>
+	/// Runs one iteration of the overlay capture.
+	/// </summary>
+	/// <returns>The number of milliseconds until the task should run again, or INFINITE when the capture has finished</returns>
+	DWORD Run();
+private:
+	OVERLAY_THREAD_DATA *m_Data;
+	unique_ptr<CaptureBase> m_Capture;
+	//A capture that was stopped during the current run, and is destroyed at the end of it
+	unique_ptr<CaptureBase> m_ReleasedCapture;
+	std::shared_ptr<TripleBufferedTexture> m_FrameBuffer;
+	//The last frame that was published. Static sources return the same texture on every call, which then does not need to be published again.
+	CComPtr<ID3D11Texture2D> m_LastPublishedFrame;
+	DynamicWait m_RetryWait;
+	int m_RetryCount;
+	bool m_IsStarted;
+	bool m_IsCapturingVideo;
+	bool m_IsFrameBufferDirty;
+	DWORD m_AcquireTimeoutMillis;
+	DWORD m_FrameIntervalMillis;
+	CRITICAL_SECTION *m_DeviceCriticalSection;
+	const IStream *m_SourceStream;
+	std::wstring m_SourcePath;
+	HWND m_SourceWindowHandle;
+
+	DWORD RunOnce();
+	HRESULT StartCapture();
+	void ReleaseCapture();
+	HRESULT CaptureFrame(_Out_ DWORD *pNextRunMillis);
+	bool IsSourceChanged();
+	/// <summary>
+	/// Handles a failed capture. Returns the delay before the capture is retried, or INFINITE if the capture should end.
+	/// </summary>
+	DWORD ProcessCaptureError(_In_ HRESULT hr);
+	DWORD Complete();
+};
+
 ScreenCaptureManager::ScreenCaptureManager() :
 	m_Device(nullptr),
 	m_DeviceContext(nullptr),
 	m_TerminateThreadsEvent(nullptr),
 	m_LastAcquiredFrameTimeStamp{},
 	m_OutputRect{},
-	m_SharedSurf(nullptr),
-	m_KeyMutex(nullptr),
+	m_CanvasSurf(nullptr),
+	m_NewFrameEvent(nullptr),
 	m_CaptureThreads{},
 	m_OverlayThreads{},
+	m_OverlayLayers{},
 	m_TextureManager(nullptr),
+	m_Scheduler(nullptr),
+	m_PooledDxResources{},
 	m_IsCapturing(false),
 	m_OutputOptions(nullptr),
 	m_EncoderOptions(nullptr),
 	m_MouseOptions(nullptr),
 	m_FrameCopy(nullptr),
 	m_IsInitialFrameWriteComplete(false),
-	m_IsInitialOverlayWriteComplete(false)
+	m_IsInitialOverlayWriteComplete(false),
+	m_CursorMetadataWriter(nullptr),
+	m_Metrics(nullptr),
+	m_FrameWaitTime(nullptr),
+	m_ComposeTime(nullptr)
 {
+	SetMetricsRegistry(std::make_shared<MetricsRegistry>());
 	// Event to tell spawned threads to quit
 	m_TerminateThreadsEvent = CreateEvent(nullptr, TRUE, FALSE, nullptr);
+	// Event for capture threads to notify about new frames
+	m_NewFrameEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
 	InitializeCriticalSection(&m_CriticalSection);
+	InitializeCriticalSection(&m_PtrInfoCriticalSection);
+	InitializeCriticalSection(&m_OverlayCriticalSection);
+	InitializeCriticalSection(&m_PooledDeviceCriticalSection);
 }
 
 ScreenCaptureManager::~ScreenCaptureManager()
@@ -48,6 +126,16 @@ ScreenCaptureManager::~ScreenCaptureManager()
 	}
 	Clean();
 	DeleteCriticalSection(&m_CriticalSection);
+	DeleteCriticalSection(&m_PtrInfoCriticalSection);
+	DeleteCriticalSection(&m_OverlayCriticalSection);
+	DeleteCriticalSection(&m_PooledDeviceCriticalSection);
+}
+
+void ScreenCaptureManager::SetMetricsRegistry(_In_ std::shared_ptr<MetricsRegistry> pMetrics)
+{
+	m_Metrics = pMetrics;
+	m_FrameWaitTime = &pMetrics->GetHistogram(L"capture.frame_wait_time");
+	m_ComposeTime = &pMetrics->GetHistogram(L"capture.compose_time");
 }
 
 //
@@ -70,6 +158,8 @@ HRESULT ScreenCaptureManager::Initialize(
 
 	m_TextureManager = make_unique<TextureManager>();
 	RETURN_ON_BAD_HR(hr = m_TextureManager->Initialize(m_DeviceContext, m_Device));
+	m_Scheduler = make_unique<CaptureScheduler>();
+	RETURN_ON_BAD_HR(hr = m_Scheduler->Initialize());
 	return hr;
 }
 
@@ -85,7 +175,7 @@ HRESULT ScreenCaptureManager::StartCapture(_In_ const std::vector<RECORDING_SOUR
 
 	HRESULT hr = E_FAIL;
 	std::vector<RECORDING_SOURCE_DATA *> createdOutputs{};
-	RETURN_ON_BAD_HR(hr = CreateSharedSurf(sources, &createdOutputs, &m_OutputRect, &m_SharedSurf, &m_KeyMutex));
+	RETURN_ON_BAD_HR(hr = CreateCanvasSurf(sources, &createdOutputs, &m_OutputRect, &m_CanvasSurf));
 	RETURN_ON_BAD_HR(hr = InitializeRecordingSources(createdOutputs, hErrorEvent));
 	RETURN_ON_BAD_HR(hr = InitializeOverlays(overlays, hErrorEvent));
 	m_IsCapturing = true;
@@ -107,7 +197,6 @@ HRESULT ScreenCaptureManager::InitializeRecordingSources(_In_ const std::vector<
 		}
 		startedEventHandles.push_back(startedEvent);
 
-		HANDLE sharedHandle = GetSharedHandle(m_SharedSurf);
 		// Create appropriate # of threads for duplication
 
 		RECORDING_SOURCE_DATA *data = recordingSources.at(i);
@@ -117,8 +206,14 @@ HRESULT ScreenCaptureManager::InitializeRecordingSources(_In_ const std::vector<
 		threadData->ErrorEvent = hErrorEvent;
 		threadData->StartedEvent = startedEvent;
 		threadData->TerminateThreadsEvent = m_TerminateThreadsEvent;
-		threadData->CanvasTexSharedHandle = sharedHandle;
+		threadData->NewFrameEvent = m_NewFrameEvent;
 		threadData->PtrInfo = &m_PtrInfo;
+		threadData->PtrInfoCriticalSection = &m_PtrInfoCriticalSection;
+		threadData->CursorMetadata = m_CursorMetadataWriter;
+		threadData->Metrics.FrameWriteTime = &m_Metrics->GetHistogram(L"capture.frame_write_time", data->RecordingSource->ID);
+		threadData->Metrics.PublishedFrames = &m_Metrics->GetCounter(L"capture.published_frames", data->RecordingSource->ID);
+		threadData->Metrics.DroppedFrames = &m_Metrics->GetCounter(L"capture.dropped_frames", data->RecordingSource->ID);
+		threadData->Metrics.LateFrames = &m_Metrics->GetCounter(L"capture.late_frames", data->RecordingSource->ID);
 
 		threadData->RecordingSource = data;
 		RtlZeroMemory(&threadData->RecordingSource->DxRes, sizeof(DX_RESOURCES));
@@ -148,11 +243,10 @@ HRESULT ScreenCaptureManager::InitializeRecordingSources(_In_ const std::vector<
 HRESULT ScreenCaptureManager::InitializeOverlays(_In_ const std::vector<RECORDING_OVERLAY *> &overlays, _In_opt_  HANDLE hErrorEvent)
 {
 	HRESULT hr = S_FALSE;
-	if (!m_SharedSurf) {
-		LOG_ERROR(L"Shared surface is not initialized");
+	if (!m_CanvasSurf) {
+		LOG_ERROR(L"Canvas surface is not initialized");
 		return E_FAIL;
 	}
-	HANDLE sharedHandle = GetSharedHandle(m_SharedSurf);
 	UINT overlayCount = static_cast<UINT>(overlays.size());
 	std::vector<HANDLE> startedEventHandles{};
 	for (UINT i = 0; i < overlayCount; i++)
@@ -176,16 +270,37 @@ HRESULT ScreenCaptureManager::InitializeOverlays(_In_ const std::vector<RECORDIN
 			threadData->ErrorEvent = hErrorEvent;
 			threadData->StartedEvent = startedEvent;
 			threadData->TerminateThreadsEvent = m_TerminateThreadsEvent;
-			threadData->CanvasTexSharedHandle = sharedHandle;
-			threadData->TerminateThreadsEvent = m_TerminateThreadsEvent;
+			threadData->NewFrameEvent = m_NewFrameEvent;
 			threadData->RecordingOverlay = new RECORDING_OVERLAY_DATA(overlay);
 			RtlZeroMemory(&threadData->RecordingOverlay->DxRes, sizeof(DX_RESOURCES));
-			RETURN_ON_BAD_HR(hr = InitializeDx(nullptr, &threadData->RecordingOverlay->DxRes));
+			bool isPooled = IsPooledCaptureSource(overlay);
+			if (isPooled) {
+				//Pooled overlays share one device. Each overlay holds its own references, so it is cleaned up like a device of its own.
+				if (!m_PooledDxResources.Device) {
+					RETURN_ON_BAD_HR(hr = InitializeDx(nullptr, &m_PooledDxResources));
+				}
+				DX_RESOURCES &dxRes = threadData->RecordingOverlay->DxRes;
+				dxRes = m_PooledDxResources;
+				dxRes.Device->AddRef();
+				dxRes.Context->AddRef();
+				if (dxRes.Debug) {
+					dxRes.Debug->AddRef();
+				}
+			}
+			else {
+				RETURN_ON_BAD_HR(hr = InitializeDx(nullptr, &threadData->RecordingOverlay->DxRes));
+			}
 			OVERLAY_THREAD *thread = new OVERLAY_THREAD();
 			thread->ThreadData = threadData;
-			DWORD ThreadId;
-			thread->ThreadHandle = CreateThread(nullptr, 0, OverlayCaptureThreadProc, threadData, 0, &ThreadId);
 			m_OverlayThreads.push_back(thread);
+			if (isPooled) {
+				std::shared_ptr<OverlayCaptureTask> task = std::make_shared<OverlayCaptureTask>(threadData, 0, POOLED_OVERLAY_POLL_INTERVAL_MILLIS, &m_PooledDeviceCriticalSection);
+				RETURN_ON_BAD_HR(hr = m_Scheduler->ScheduleTask([task]() { return task->Run(); }));
+			}
+			else {
+				DWORD ThreadId;
+				thread->ThreadHandle = CreateThread(nullptr, 0, OverlayCaptureThreadProc, threadData, 0, &ThreadId);
+			}
 		}
 		else {
 			if (!hErrorEvent) {
@@ -220,6 +335,10 @@ HRESULT ScreenCaptureManager::StopCapture()
 	}
 	HRESULT hr = WaitForThreadTermination();
 	m_IsCapturing = false;
+	for each (SOURCE_FRAME_STATISTICS stats in GetFrameStatistics())
+	{
+		LOG_DEBUG(L"Frame statistics for source %ls: %lld published, %lld dropped, %lld late", stats.ID.c_str(), stats.PublishedFrameCount, stats.DroppedFrameCount, stats.LateFrameCount);
+	}
 	return hr;
 }
 
@@ -237,6 +356,7 @@ HRESULT ScreenCaptureManager::CopyCurrentFrame(_Out_ CAPTURED_FRAME *pFrame)
 	pFrame->Frame = pFrameCopy;
 	pFrame->PtrInfo = m_PtrInfo;
 	pFrame->FrameUpdateCount = 0;
+	QueryPerformanceCounter(&pFrame->TimeStamp);
 	return S_OK;
 }
 
@@ -270,7 +390,7 @@ HRESULT ScreenCaptureManager::AcquireNextFrame(_In_  double timeUntilNextFrame,
 			}
 			if (m_OutputOptions->GetRecorderMode() == RecorderModeInternal::Video) {
 				if (!m_EncoderOptions->GetIsFixedFramerate()
-					&& ((m_MouseOptions->IsMousePointerEnabled() && m_PtrInfo.IsPointerShapeUpdated)//and never delay when pointer changes if we draw pointer
+					&& ((m_MouseOptions->IsMousePointerEnabled() && !m_CursorMetadataWriter && m_PtrInfo.IsPointerShapeUpdated)//and never delay when pointer changes if we draw pointer
 						|| false)) // Or if we need to write a snapshot 
 				{
 					return false;
@@ -287,67 +407,155 @@ HRESULT ScreenCaptureManager::AcquireNextFrame(_In_  double timeUntilNextFrame,
 		});
 
 	DWORD syncTimeout = GetNextSyncTimeout();
-
+	TraceSpan waitSpan("WaitForNewFrame");
+	LatencyTimer waitTimer(*m_FrameWaitTime);
 	while (true)
 	{
-		// Try to acquire keyed mutex in order to access shared surface
-		hr = m_KeyMutex->AcquireSync(1, syncTimeout);
+		// Wait for any of the capture threads to publish a new frame
+		DWORD result = WaitForSingleObject(m_NewFrameEvent, syncTimeout);
 
-		if (hr == static_cast<HRESULT>(WAIT_TIMEOUT)) {
+		if (result == WAIT_TIMEOUT) {
 			if (!ShouldDelay()) {
-				hr = m_KeyMutex->AcquireSync(0, 0);
-				if (SUCCEEDED(hr)) {
-					hr = m_KeyMutex->ReleaseSync(1);
-					syncTimeout = 0;
-				}
-			}
-			else {
-				syncTimeout = GetNextSyncTimeout();
+				break;
 			}
+			syncTimeout = GetNextSyncTimeout();
 		}
-		else if (hr == static_cast<HRESULT>(WAIT_ABANDONED)) {
-			return E_FAIL;
-		}
-		else if (SUCCEEDED(hr)) {
+		else if (result == WAIT_OBJECT_0) {
 			haveNewFrame = true;
-			if (ShouldDelay()) {
-				m_KeyMutex->ReleaseSync(0);
-				syncTimeout = GetNextSyncTimeout();
-			}
-			else {
+			if (!ShouldDelay()) {
 				break;
 			}
+			syncTimeout = GetNextSyncTimeout();
 		}
-		else if (FAILED(hr)) {
-			return hr;
+		else {
+			DWORD dwErr = GetLastError();
+			LOG_ERROR(L"WaitForSingleObject failed: last error = %u", dwErr);
+			return HRESULT_FROM_WIN32(dwErr);
 		}
 	}
+	waitSpan.End();
+	waitTimer.Stop();
 	{
-		ReleaseKeyedMutexOnExit releaseMutex(m_KeyMutex, 0);
-		MeasureExecutionTime measure(L"AcquireNextFrame lock");
+		MeasureExecutionTime measure(L"AcquireNextFrame compose");
+		TRACE_SPAN("ComposeFrame");
+		LatencyTimer composeTimer(*m_ComposeTime);
 		int updatedFrameCount = GetUpdatedSourceCount();
 		int updatedOverlaysCount = GetUpdatedOverlayCount();
 
 		if (!m_FrameCopy) {
 			D3D11_TEXTURE2D_DESC desc;
-			m_SharedSurf->GetDesc(&desc);
+			m_CanvasSurf->GetDesc(&desc);
 			desc.MiscFlags = 0;
 			desc.BindFlags = D3D11_BIND_SHADER_RESOURCE | D3D11_BIND_RENDER_TARGET;
 			RETURN_ON_BAD_HR(hr = m_Device->CreateTexture2D(&desc, nullptr, &m_FrameCopy));
 		}
 		if (m_OutputOptions->IsVideoCaptureEnabled()) {
-			m_DeviceContext->CopyResource(m_FrameCopy, m_SharedSurf);
+			RETURN_ON_BAD_HR(hr = ComposeCanvas());
+			m_DeviceContext->CopyResource(m_FrameCopy, m_CanvasSurf);
 		}
 		if (updatedFrameCount > 0 || updatedOverlaysCount > 0) {
 			QueryPerformanceCounter(&m_LastAcquiredFrameTimeStamp);
 		}
-		m_PtrInfo.IsPointerShapeUpdated = false;
 		RtlZeroMemory(pFrame, sizeof(pFrame));
 		pFrame->Frame = m_FrameCopy;
-		pFrame->PtrInfo = m_PtrInfo;
 		pFrame->FrameUpdateCount = updatedFrameCount;
+		QueryPerformanceCounter(&pFrame->TimeStamp);
+		EnterCriticalSection(&m_PtrInfoCriticalSection);
+		LeaveCriticalSectionOnExit leavePtrInfoCriticalSection(&m_PtrInfoCriticalSection);
+		m_PtrInfo.IsPointerShapeUpdated = false;
+		pFrame->PtrInfo = m_PtrInfo;
 	}
-	return hr;
+	return S_OK;
+}
+
+HRESULT ScreenCaptureManager::ComposeCanvas()
+{
+	D3D11_TEXTURE2D_DESC canvasDesc;
+	m_CanvasSurf->GetDesc(&canvasDesc);
+	SIZE canvasSize = SIZE{ static_cast<LONG>(canvasDesc.Width),static_cast<LONG>(canvasDesc.Height) };
+	double lateThresholdMillis = GetLateFrameThresholdMillis();
+	for each (CAPTURE_THREAD * threadObject in m_CaptureThreads)
+	{
+		if (!threadObject->ThreadData) {
+			continue;
+		}
+		std::shared_ptr<TripleBufferedTexture> pFrameBuffer = std::atomic_load(&threadObject->ThreadData->FrameBuffer);
+		if (!pFrameBuffer) {
+			continue;
+		}
+		ID3D11Texture2D *pSourceFrame = nullptr;
+		HRESULT hr = pFrameBuffer->AcquireLatest(m_Device, lateThresholdMillis, &pSourceFrame);
+		if (FAILED(hr)) {
+			LOG_ERROR(L"Failed to acquire frame for source: hr = 0x%08x", hr);
+			continue;
+		}
+		SOURCE_METRICS &metrics = threadObject->ThreadData->Metrics;
+		if (metrics.CountedFrameBuffer != pFrameBuffer.get()) {
+			metrics.CountedFrameBuffer = pFrameBuffer.get();
+			metrics.CountedPublishedFrames = 0;
+			metrics.CountedDroppedFrames = 0;
+			metrics.CountedLateFrames = 0;
+		}
+		//The frame buffer keeps totals, so the counters are given the change since they were last updated
+		INT64 publishedFrames = pFrameBuffer->GetPublishedFrameCount();
+		INT64 droppedFrames = pFrameBuffer->GetDroppedFrameCount();
+		INT64 lateFrames = pFrameBuffer->GetLateFrameCount();
+		metrics.PublishedFrames->Add(publishedFrames - metrics.CountedPublishedFrames);
+		metrics.DroppedFrames->Add(droppedFrames - metrics.CountedDroppedFrames);
+		metrics.LateFrames->Add(lateFrames - metrics.CountedLateFrames);
+		metrics.CountedPublishedFrames = publishedFrames;
+		metrics.CountedDroppedFrames = droppedFrames;
+		metrics.CountedLateFrames = lateFrames;
+		if (hr == S_FALSE || !pSourceFrame) {
+			//No new frame, the canvas already holds the previous one.
+			continue;
+		}
+		RECT sourceRect = GetSourceRect(canvasSize, threadObject->ThreadData->RecordingSource);
+		D3D11_BOX box{};
+		box.back = 1;
+		box.right = static_cast<UINT>(max(0, min(pFrameBuffer->GetSize().cx, canvasSize.cx - sourceRect.left)));
+		box.bottom = static_cast<UINT>(max(0, min(pFrameBuffer->GetSize().cy, canvasSize.cy - sourceRect.top)));
+		if (sourceRect.left < 0 || sourceRect.top < 0 || box.right == 0 || box.bottom == 0) {
+			continue;
+		}
+		m_DeviceContext->CopySubresourceRegion(m_CanvasSurf, 0, sourceRect.left, sourceRect.top, 0, pSourceFrame, 0, &box);
+	}
+	return S_OK;
+}
+
+double ScreenCaptureManager::GetLateFrameThresholdMillis()
+{
+	//A frame that has waited for more than one output frame before being composed missed the frame it was captured for.
+	UINT32 fps = m_EncoderOptions->GetVideoFps();
+	return fps > 0 ? 1000.0 * m_EncoderOptions->GetVideoFpsDenominator() / fps : 0;
+}
+
+std::vector<SOURCE_FRAME_STATISTICS> ScreenCaptureManager::GetFrameStatistics()
+{
+	std::vector<SOURCE_FRAME_STATISTICS> statistics;
+	auto AddStatistics([&](std::wstring id, std::shared_ptr<TripleBufferedTexture> pFrameBuffer) {
+		SOURCE_FRAME_STATISTICS stats{};
+		stats.ID = id;
+		if (pFrameBuffer) {
+			stats.PublishedFrameCount = pFrameBuffer->GetPublishedFrameCount();
+			stats.DroppedFrameCount = pFrameBuffer->GetDroppedFrameCount();
+			stats.LateFrameCount = pFrameBuffer->GetLateFrameCount();
+		}
+		statistics.push_back(stats);
+	});
+	for each (CAPTURE_THREAD * threadObject in m_CaptureThreads)
+	{
+		if (threadObject->ThreadData && threadObject->ThreadData->RecordingSource) {
+			AddStatistics(threadObject->ThreadData->RecordingSource->RecordingSource->ID, std::atomic_load(&threadObject->ThreadData->FrameBuffer));
+		}
+	}
+	for each (OVERLAY_THREAD * threadObject in m_OverlayThreads)
+	{
+		if (threadObject->ThreadData && threadObject->ThreadData->RecordingOverlay) {
+			AddStatistics(threadObject->ThreadData->RecordingOverlay->RecordingOverlay->ID, std::atomic_load(&threadObject->ThreadData->FrameBuffer));
+		}
+	}
+	return statistics;
 }
 
 //
@@ -357,14 +565,13 @@ void ScreenCaptureManager::Clean()
 {
 	EnterCriticalSection(&m_CriticalSection);
 	LeaveCriticalSectionOnExit leaveOnExit(&m_CriticalSection);
-	if (m_SharedSurf) {
-		m_SharedSurf->Release();
-		m_SharedSurf = nullptr;
+	//Pooled overlay tasks reference the thread data, so they must be stopped before it is released.
+	if (m_Scheduler) {
+		m_Scheduler->Stop();
 	}
-	if (m_KeyMutex)
-	{
-		m_KeyMutex->Release();
-		m_KeyMutex = nullptr;
+	if (m_CanvasSurf) {
+		m_CanvasSurf->Release();
+		m_CanvasSurf = nullptr;
 	}
 	if (m_PtrInfo.PtrShapeBuffer)
 	{
@@ -409,8 +616,11 @@ void ScreenCaptureManager::Clean()
 		delete threadObject;
 	}
 	m_OverlayThreads.clear();
+	m_OverlayLayers.clear();
+	CleanDx(&m_PooledDxResources);
 
 	CloseHandle(m_TerminateThreadsEvent);
+	CloseHandle(m_NewFrameEvent);
 }
 
 //
@@ -419,13 +629,19 @@ void ScreenCaptureManager::Clean()
 HRESULT ScreenCaptureManager::WaitForThreadTermination()
 {
 	LOG_TRACE("Waiting for capture thread termination..");
-	UINT overlayCount = static_cast<UINT>(m_OverlayThreads.size());
-	if (overlayCount > 0) {
-		std::vector<HANDLE> threadHandles{};
-		for (OVERLAY_THREAD *obj : m_OverlayThreads) {
-			threadHandles.push_back(obj->ThreadHandle);
+	if (m_Scheduler) {
+		m_Scheduler->Stop();
+	}
+	std::vector<HANDLE> overlayThreadHandles{};
+	for (OVERLAY_THREAD *obj : m_OverlayThreads) {
+		//Overlays running on the worker pool have no thread of their own.
+		if (obj->ThreadHandle) {
+			overlayThreadHandles.push_back(obj->ThreadHandle);
 		}
-		if (WaitForMultipleObjects(overlayCount, threadHandles.data(), TRUE, 5000) == WAIT_TIMEOUT) {
+	}
+	UINT overlayCount = static_cast<UINT>(overlayThreadHandles.size());
+	if (overlayCount > 0) {
+		if (WaitForMultipleObjects(overlayCount, overlayThreadHandles.data(), TRUE, 5000) == WAIT_TIMEOUT) {
 			LOG_ERROR(L"Timeout in overlay capture thread termination");
 			return E_FAIL;
 		}
@@ -645,6 +861,8 @@ RECT ScreenCaptureManager::GetOverlayRect(_In_ SIZE canvasSize, _In_ SIZE overla
 
 HRESULT ScreenCaptureManager::ProcessOverlays(_Inout_ ID3D11Texture2D *pCanvasTexture, _Out_ int *updateCount)
 {
+	EnterCriticalSection(&m_OverlayCriticalSection);
+	LeaveCriticalSectionOnExit leaveOnExit(&m_OverlayCriticalSection);
 	HRESULT hr = S_FALSE;
 	int count = 0;
 
@@ -652,6 +870,23 @@ HRESULT ScreenCaptureManager::ProcessOverlays(_Inout_ ID3D11Texture2D *pCanvasTe
 	pCanvasTexture->GetDesc(&desc);
 	SIZE canvasSize = SIZE{ static_cast<LONG>(desc.Width),static_cast<LONG>(desc.Height) };
 
+	//Consecutive static overlays are drawn together from a cached layer, so the draw order of all overlays is preserved.
+	std::vector<OVERLAY_LAYER_ENTRY> staticOverlays{};
+	bool isStaticOverlayUpdated = false;
+	size_t layerCount = 0;
+	auto DrawStaticOverlays([&]() {
+		if (staticOverlays.size() == 1) {
+			//A single overlay is cheaper to draw directly than through a canvas sized layer.
+			LOG_ON_BAD_HR(hr = m_TextureManager->DrawTexture(pCanvasTexture, staticOverlays.front().Texture, staticOverlays.front().Rect));
+		}
+		else if (staticOverlays.size() > 1) {
+			LOG_ON_BAD_HR(hr = DrawOverlayLayer(pCanvasTexture, layerCount, staticOverlays, isStaticOverlayUpdated));
+			layerCount++;
+		}
+		staticOverlays.clear();
+		isStaticOverlayUpdated = false;
+	});
+
 	for each (OVERLAY_THREAD * threadObject in m_OverlayThreads)
 	{
 		if (threadObject->ThreadData) {
@@ -659,20 +894,35 @@ HRESULT ScreenCaptureManager::ProcessOverlays(_Inout_ ID3D11Texture2D *pCanvasTe
 				continue;
 			}
 			RECORDING_OVERLAY_DATA *pOverlayData = threadObject->ThreadData->RecordingOverlay;
-			HANDLE sharedHandle = threadObject->ThreadData->OverlayTexSharedHandle;
-			if (pOverlayData && sharedHandle) {
-				CComPtr<ID3D11Texture2D> pOverlayTexture;
-				CONTINUE_ON_BAD_HR(hr = m_Device->OpenSharedResource(sharedHandle, __uuidof(ID3D11Texture2D), reinterpret_cast<void **>(&pOverlayTexture)));
+			std::shared_ptr<TripleBufferedTexture> pFrameBuffer = std::atomic_load(&threadObject->ThreadData->FrameBuffer);
+			if (pOverlayData && pFrameBuffer) {
+				ID3D11Texture2D *pOverlayTexture = nullptr;
+				CONTINUE_ON_BAD_HR(hr = pFrameBuffer->AcquireLatest(m_Device, GetLateFrameThresholdMillis(), &pOverlayTexture));
+				if (!pOverlayTexture) {
+					continue;
+				}
 				D3D11_TEXTURE2D_DESC overlayDesc;
 				pOverlayTexture->GetDesc(&overlayDesc);
 				SIZE textureSize = SIZE{ static_cast<LONG>(overlayDesc.Width),static_cast<LONG>(overlayDesc.Height) };
-				CONTINUE_ON_BAD_HR(hr = m_TextureManager->DrawTexture(pCanvasTexture, pOverlayTexture, GetOverlayRect(canvasSize, textureSize, pOverlayData->RecordingOverlay)));
+				RECT overlayRect = GetOverlayRect(canvasSize, textureSize, pOverlayData->RecordingOverlay);
+				if (threadObject->ThreadData->IsStaticContent) {
+					staticOverlays.push_back(OVERLAY_LAYER_ENTRY{ pFrameBuffer, pOverlayTexture, overlayRect });
+					isStaticOverlayUpdated |= hr == S_OK;
+				}
+				else {
+					DrawStaticOverlays();
+					CONTINUE_ON_BAD_HR(hr = m_TextureManager->DrawTexture(pCanvasTexture, pOverlayTexture, overlayRect));
+				}
 				if (threadObject->ThreadData->LastUpdateTimeStamp.QuadPart > m_LastAcquiredFrameTimeStamp.QuadPart) {
 					count++;
 				}
 			}
 		}
 	}
+	DrawStaticOverlays();
+	//Release layers for runs of static overlays that no longer exist.
+	m_OverlayLayers.resize(layerCount);
+
 	if (count > 0) {
 		QueryPerformanceCounter(&m_LastAcquiredFrameTimeStamp);
 	}
@@ -680,7 +930,60 @@ HRESULT ScreenCaptureManager::ProcessOverlays(_Inout_ ID3D11Texture2D *pCanvasTe
 	return hr;
 }
 
-HRESULT ScreenCaptureManager::CreateSharedSurf(_In_ const std::vector<RECORDING_SOURCE *> &sources, _Out_ std::vector<RECORDING_SOURCE_DATA *> *pCreatedOutputs, _Out_ RECT *pDeskBounds, _Outptr_ ID3D11Texture2D **ppSharedTexture, _Outptr_ IDXGIKeyedMutex **ppKeyedMutex)
+HRESULT ScreenCaptureManager::DrawOverlayLayer(_Inout_ ID3D11Texture2D *pCanvasTexture, _In_ size_t layerIndex, _In_ const std::vector<OVERLAY_LAYER_ENTRY> &overlays, _In_ bool isContentUpdated)
+{
+	HRESULT hr = S_OK;
+	if (m_OverlayLayers.size() <= layerIndex) {
+		m_OverlayLayers.resize(layerIndex + 1);
+	}
+	OVERLAY_LAYER &layer = m_OverlayLayers.at(layerIndex);
+
+	D3D11_TEXTURE2D_DESC canvasDesc;
+	pCanvasTexture->GetDesc(&canvasDesc);
+	bool isLayerSizeValid = false;
+	if (layer.Texture) {
+		D3D11_TEXTURE2D_DESC layerDesc;
+		layer.Texture->GetDesc(&layerDesc);
+		isLayerSizeValid = layerDesc.Width == canvasDesc.Width && layerDesc.Height == canvasDesc.Height;
+	}
+	bool isLayerValid = isLayerSizeValid && !isContentUpdated && layer.Overlays.size() == overlays.size();
+	for (size_t i = 0; isLayerValid && i < overlays.size(); i++) {
+		isLayerValid = layer.Overlays.at(i).FrameBuffer == overlays.at(i).FrameBuffer
+			&& layer.Overlays.at(i).Texture == overlays.at(i).Texture
+			&& EqualRect(&layer.Overlays.at(i).Rect, &overlays.at(i).Rect);
+	}
+
+	if (!isLayerValid) {
+		if (!isLayerSizeValid) {
+			layer.Texture.Release();
+			D3D11_TEXTURE2D_DESC layerDesc;
+			RtlZeroMemory(&layerDesc, sizeof(D3D11_TEXTURE2D_DESC));
+			layerDesc.Width = canvasDesc.Width;
+			layerDesc.Height = canvasDesc.Height;
+			layerDesc.MipLevels = 1;
+			layerDesc.ArraySize = 1;
+			layerDesc.Format = DXGI_FORMAT_B8G8R8A8_UNORM;
+			layerDesc.SampleDesc.Count = 1;
+			layerDesc.Usage = D3D11_USAGE_DEFAULT;
+			layerDesc.BindFlags = D3D11_BIND_RENDER_TARGET | D3D11_BIND_SHADER_RESOURCE;
+			RETURN_ON_BAD_HR(hr = m_Device->CreateTexture2D(&layerDesc, nullptr, &layer.Texture));
+		}
+		CComPtr<ID3D11RenderTargetView> pLayerRTV;
+		RETURN_ON_BAD_HR(hr = m_Device->CreateRenderTargetView(layer.Texture, nullptr, &pLayerRTV));
+		FLOAT transparent[4] = { 0.f, 0.f, 0.f, 0.f };
+		m_DeviceContext->ClearRenderTargetView(pLayerRTV, transparent);
+		layer.Overlays.clear();
+		for each (OVERLAY_LAYER_ENTRY overlay in overlays)
+		{
+			RETURN_ON_BAD_HR(hr = m_TextureManager->DrawTexture(layer.Texture, overlay.Texture, overlay.Rect, TextureBlendMode::AccumulateLayer));
+		}
+		layer.Overlays = overlays;
+		LOG_TRACE(L"Rasterized %u static overlays into composition layer %u", static_cast<UINT>(overlays.size()), static_cast<UINT>(layerIndex));
+	}
+	return m_TextureManager->DrawTexture(pCanvasTexture, layer.Texture, RECT{ 0, 0, static_cast<LONG>(canvasDesc.Width), static_cast<LONG>(canvasDesc.Height) }, TextureBlendMode::PremultipliedAlphaBlend);
+}
+
+HRESULT ScreenCaptureManager::CreateCanvasSurf(_In_ const std::vector<RECORDING_SOURCE *> &sources, _Out_ std::vector<RECORDING_SOURCE_DATA *> *pCreatedOutputs, _Out_ RECT *pDeskBounds, _Outptr_ ID3D11Texture2D **ppCanvasTexture)
 {
 	*pCreatedOutputs = std::vector<RECORDING_SOURCE_DATA *>();
 	std::vector<std::pair<RECORDING_SOURCE *, RECT>> validOutputs;
@@ -718,15 +1021,14 @@ HRESULT ScreenCaptureManager::CreateSharedSurf(_In_ const std::vector<RECORDING_
 	}
 
 	// Set created outputs
-	hr = ScreenCaptureManager::CreateSharedSurf(*pDeskBounds, ppSharedTexture, ppKeyedMutex);
+	hr = ScreenCaptureManager::CreateCanvasSurf(*pDeskBounds, ppCanvasTexture);
 	return hr;
 }
 
-HRESULT ScreenCaptureManager::CreateSharedSurf(_In_ RECT desktopRect, _Outptr_ ID3D11Texture2D **ppSharedTexture, _Outptr_ IDXGIKeyedMutex **ppKeyedMutex)
+HRESULT ScreenCaptureManager::CreateCanvasSurf(_In_ RECT desktopRect, _Outptr_ ID3D11Texture2D **ppCanvasTexture)
 {
-	CComPtr<ID3D11Texture2D> pSharedTexture = nullptr;
-	CComPtr<IDXGIKeyedMutex> pKeyedMutex = nullptr;
-	// Create shared texture for all capture threads to draw into
+	CComPtr<ID3D11Texture2D> pCanvasTexture = nullptr;
+	// Create the texture the frames from all capture threads are composed onto. Each thread writes to its own buffers, so this is only accessed by the compositor.
 	D3D11_TEXTURE2D_DESC DeskTexD;
 	RtlZeroMemory(&DeskTexD, sizeof(D3D11_TEXTURE2D_DESC));
 	DeskTexD.Width = RectWidth(desktopRect);
@@ -736,30 +1038,19 @@ HRESULT ScreenCaptureManager::CreateSharedSurf(_In_ RECT desktopRect, _Outptr_ I
 	DeskTexD.Format = DXGI_FORMAT_B8G8R8A8_UNORM;
 	DeskTexD.SampleDesc.Count = 1;
 	DeskTexD.Usage = D3D11_USAGE_DEFAULT;
-	DeskTexD.BindFlags = D3D11_BIND_RENDER_TARGET;
+	DeskTexD.BindFlags = D3D11_BIND_RENDER_TARGET | D3D11_BIND_SHADER_RESOURCE;
 	DeskTexD.CPUAccessFlags = 0;
-	DeskTexD.MiscFlags = D3D11_RESOURCE_MISC_SHARED_KEYEDMUTEX;
+	DeskTexD.MiscFlags = 0;
 
-	HRESULT hr = m_Device->CreateTexture2D(&DeskTexD, nullptr, &pSharedTexture);
-	if (FAILED(hr))
-	{
-		LOG_ERROR(L"Failed to create shared texture");
-		return hr;
-	}
-	// Get keyed mutex
-	hr = pSharedTexture->QueryInterface(__uuidof(IDXGIKeyedMutex), reinterpret_cast<void **>(&pKeyedMutex));
+	HRESULT hr = m_Device->CreateTexture2D(&DeskTexD, nullptr, &pCanvasTexture);
 	if (FAILED(hr))
 	{
-		LOG_ERROR(L"Failed to query for keyed mutex in OUTPUTMANAGER");
+		LOG_ERROR(L"Failed to create canvas texture");
 		return hr;
 	}
-	if (ppSharedTexture) {
-		*ppSharedTexture = pSharedTexture;
-		(*ppSharedTexture)->AddRef();
-	}
-	if (ppKeyedMutex) {
-		*ppKeyedMutex = pKeyedMutex;
-		(*ppKeyedMutex)->AddRef();
+	if (ppCanvasTexture) {
+		*ppCanvasTexture = pCanvasTexture;
+		(*ppCanvasTexture)->AddRef();
 	}
 	return hr;
 }
@@ -773,6 +1064,7 @@ DWORD WINAPI CaptureThreadProc(_In_ void *Param)
 	CAPTURE_THREAD_DATA *pData = static_cast<CAPTURE_THREAD_DATA *>(Param);
 	RECORDING_SOURCE_DATA *pSourceData = pData->RecordingSource;
 	RECORDING_SOURCE *pSource = pSourceData->RecordingSource;
+	TraceRecorder::Instance().SetThreadName("Capture");
 
 	DynamicWait retryWait;
 	retryWait.SetWaitBands({
@@ -782,9 +1074,11 @@ DWORD WINAPI CaptureThreadProc(_In_ void *Param)
 					});
 	int retryCount = 0;
 	bool isCapturingVideo = true;
-	bool isSharedSurfaceDirty = false;
+	bool isCaptureSurfaceDirty = false;
 	bool isSourceDirty = false;
-	bool waitToProcessCurrentFrame = false;
+	// The surface this source writes its frames to, in source local coordinates. It is kept across restarts so incremental updates apply to the previous frame.
+	CComPtr<ID3D11Texture2D> pCaptureSurf = nullptr;
+	std::shared_ptr<TripleBufferedTexture> pFrameBuffer = nullptr;
 
 	hr = CoInitializeEx(nullptr, COINITBASE_MULTITHREADED | COINIT_DISABLE_OLE1DDE);
 	if (FAILED(hr)) {
@@ -797,9 +1091,6 @@ Start:
 		try
 		{
 			std::unique_ptr<CaptureBase> pRecordingSourceCapture = nullptr;
-			// D3D objects
-			CComPtr<ID3D11Texture2D> SharedSurf = nullptr;
-			CComPtr<IDXGIKeyedMutex> KeyMutex = nullptr;
 			SetEvent(pData->StartedEvent);
 
 			if (WaitForSingleObjectEx(pData->TerminateThreadsEvent, 0, FALSE) == WAIT_OBJECT_0) {
@@ -814,18 +1105,34 @@ Start:
 				goto Exit;
 			}
 
-			// Obtain handle to sync shared Surface
-			hr = pSourceData->DxRes.Device->OpenSharedResource(pData->CanvasTexSharedHandle, __uuidof(ID3D11Texture2D), reinterpret_cast<void **>(&SharedSurf));
-			if (FAILED(hr))
-			{
-				LOG_ERROR(L"Opening shared texture failed");
-				goto Exit;
+			SIZE frameSize = SIZE{ RectWidth(pSourceData->FrameCoordinates),RectHeight(pSourceData->FrameCoordinates) };
+			if (!pCaptureSurf) {
+				D3D11_TEXTURE2D_DESC desc;
+				RtlZeroMemory(&desc, sizeof(D3D11_TEXTURE2D_DESC));
+				desc.Width = frameSize.cx;
+				desc.Height = frameSize.cy;
+				desc.MipLevels = 1;
+				desc.ArraySize = 1;
+				desc.Format = DXGI_FORMAT_B8G8R8A8_UNORM;
+				desc.SampleDesc.Count = 1;
+				desc.Usage = D3D11_USAGE_DEFAULT;
+				desc.BindFlags = D3D11_BIND_RENDER_TARGET | D3D11_BIND_SHADER_RESOURCE;
+				hr = pSourceData->DxRes.Device->CreateTexture2D(&desc, nullptr, &pCaptureSurf);
+				if (FAILED(hr))
+				{
+					LOG_ERROR(L"Failed to create capture surface");
+					goto Exit;
+				}
 			}
-			hr = SharedSurf->QueryInterface(__uuidof(IDXGIKeyedMutex), reinterpret_cast<void **>(&KeyMutex));
-			if (FAILED(hr))
-			{
-				LOG_ERROR(L"Failed to get keyed mutex interface in spawned thread");
-				goto Exit;
+			if (!pFrameBuffer) {
+				pFrameBuffer = std::make_shared<TripleBufferedTexture>();
+				hr = pFrameBuffer->Initialize(pSourceData->DxRes.Device, frameSize.cx, frameSize.cy);
+				if (FAILED(hr))
+				{
+					LOG_ERROR(L"Failed to create frame buffers");
+					goto Exit;
+				}
+				std::atomic_store(&pData->FrameBuffer, pFrameBuffer);
 			}
 			// Make duplication
 			hr = pRecordingSourceCapture->Initialize(pSourceData->DxRes.Context, pSourceData->DxRes.Device);
@@ -834,6 +1141,8 @@ Start:
 				LOG_ERROR(L"Failed to initialize recording source %ls", pRecordingSourceCapture->Name().c_str());
 				goto Exit;
 			}
+			//The pointer is recorded separately when it is written as metadata, so pointer movement alone does not need a new frame.
+			pRecordingSourceCapture->SetPointerOnlyUpdatesPublished(!pData->CursorMetadata);
 			hr = pRecordingSourceCapture->StartCapture(*pSource);
 
 			if (FAILED(hr))
@@ -848,7 +1157,8 @@ Start:
 				LOG_ERROR(L"Failed to initialize TextureManager");
 				goto Exit;
 			}
-			SIZE frameSize = SIZE{ RectWidth(pSourceData->FrameCoordinates),RectHeight(pSourceData->FrameCoordinates) };
+			//The source writes to its own surface, so the frame is placed at the origin instead of at the source position on the canvas.
+			RECT localFrameCoordinates = RECT{ 0,0,frameSize.cx,frameSize.cy };
 			SIZE sourceOutputSize = pSource->OutputSize.value_or(frameSize);
 			const IStream *sourceStream = pSource->SourceStream;
 			const std::wstring sourcePath = pSource->SourcePath;
@@ -861,13 +1171,24 @@ Start:
 				return sourceOutputSize.cx != currentSize.cx
 					|| sourceOutputSize.cy != currentSize.cy;
 			});
+			auto PublishFrame([&]() {
+				ID3D11Texture2D *pBackBuffer = nullptr;
+				HRESULT publishHr = pFrameBuffer->GetBackBuffer(&pBackBuffer);
+				if (FAILED(publishHr)) {
+					LOG_ERROR(L"Failed to acquire frame buffer: hr = 0x%08x", publishHr);
+					return;
+				}
+				pSourceData->DxRes.Context->CopyResource(pBackBuffer, pCaptureSurf);
+				//Publishing releases the keyed mutex of the buffer, which submits the copy before the compositor device reads it.
+				pFrameBuffer->Publish();
+				SetEvent(pData->NewFrameEvent);
+			});
 
 			ExecuteFuncOnExit blankFrameOnExit([&]() {
 				if (!IsSourceChanged(pSource)
-					&& WaitForSingleObjectEx(pData->TerminateThreadsEvent, 0, FALSE) != WAIT_OBJECT_0
-					&& KeyMutex->AcquireSync(0, 500) == S_OK) {
-					textureManager.BlankTexture(SharedSurf, pSourceData->FrameCoordinates, pSourceData->OffsetX, pSourceData->OffsetY);
-					KeyMutex->ReleaseSync(1);
+					&& WaitForSingleObjectEx(pData->TerminateThreadsEvent, 0, FALSE) != WAIT_OBJECT_0) {
+					textureManager.BlankTexture(pCaptureSurf, localFrameCoordinates, 0, 0);
+					PublishFrame();
 				}
 			});
 
@@ -876,7 +1197,6 @@ Start:
 
 			bool isPreviewEnabled = pSource->IsVideoFramePreviewEnabled.value_or(false);
 			// Main duplication loop
-			std::chrono::steady_clock::time_point WaitForFrameBegin = (std::chrono::steady_clock::time_point::min)();
 			while (true)
 			{
 				if (WaitForSingleObjectEx(pData->TerminateThreadsEvent, 0, FALSE) == WAIT_OBJECT_0) {
@@ -889,120 +1209,96 @@ Start:
 					goto Start;
 				}
 				if (IsSourceOutputSizeChanged(pSource)) {
-					isSharedSurfaceDirty = true;
+					isCaptureSurfaceDirty = true;
 					sourceOutputSize = pSource->OutputSize.value_or(frameSize);
 				}
 				if (isPreviewEnabled != pSource->IsVideoFramePreviewEnabled.value_or(false)) {
 					isPreviewEnabled = pSource->IsVideoFramePreviewEnabled.value_or(false);
-					isSharedSurfaceDirty = true;
+					isCaptureSurfaceDirty = true;
 				}
 				if (!isCapturingVideo) {
 					Sleep(1);
 					if (pSource->IsVideoCaptureEnabled.value_or(true)) {
 						isCapturingVideo = true;
-						isSharedSurfaceDirty = true;
+						isCaptureSurfaceDirty = true;
 					}
 					continue;
 				}
 				CComPtr<ID3D11Texture2D> pFrame = nullptr;
-				if (!waitToProcessCurrentFrame)
-				{
-					if (isSharedSurfaceDirty) {
-						hr = pRecordingSourceCapture->AcquireNextFrame(10, &pFrame);
-					}
-					else {
-						hr = pRecordingSourceCapture->AcquireNextFrame(10, nullptr);
-					}
-					if (hr == DXGI_ERROR_WAIT_TIMEOUT) {
-						continue;
-					}
-					else if (hr == S_FALSE) {
-						Sleep(10);
-						continue;
-					}
-					else if (FAILED(hr)) {
-						break;
-					}
+				TraceSpan acquireSpan("AcquireSourceFrame");
+				if (isCaptureSurfaceDirty) {
+					hr = pRecordingSourceCapture->AcquireNextFrame(10, &pFrame);
 				}
-				{
-					MeasureExecutionTime measure(L"CaptureThreadProc wait for sync");
-					// We have a new frame so try and process it
-					// Try to acquire keyed mutex in order to access shared surface
-					hr = KeyMutex->AcquireSync(0, 1);
+				else {
+					hr = pRecordingSourceCapture->AcquireNextFrame(10, nullptr);
 				}
-				if (hr == static_cast<HRESULT>(WAIT_TIMEOUT))
-				{
-					// Can't use shared surface right now, try again later
-					if (!waitToProcessCurrentFrame) {
-						WaitForFrameBegin = chrono::steady_clock::now();
-					}
-					waitToProcessCurrentFrame = true;
+				acquireSpan.End();
+				if (hr == DXGI_ERROR_WAIT_TIMEOUT) {
 					continue;
 				}
-				else if (FAILED(hr))
-				{
-					// Generic unknown failure
-					LOG_ERROR(L"Unexpected error acquiring KeyMutex");
+				else if (hr == S_FALSE) {
+					Sleep(10);
+					continue;
+				}
+				else if (FAILED(hr)) {
 					break;
 				}
 #if MEASURE_EXECUTION_TIME
-				MeasureExecutionTime measureLock(string_format(L"CaptureThreadProc sync lock for %ls", pRecordingSourceCapture->Name().c_str()));
+				MeasureExecutionTime measureWrite(string_format(L"CaptureThreadProc write frame for %ls", pRecordingSourceCapture->Name().c_str()));
 #endif
-				ReleaseKeyedMutexOnExit releaseMutex(KeyMutex, 1);
-
-				// We can now process the current frame
-				if (waitToProcessCurrentFrame) {
-					waitToProcessCurrentFrame = false;
-					LONGLONG waitTimeMillis = duration_cast<milliseconds>(chrono::steady_clock::now() - WaitForFrameBegin).count();
-					//If the capture has been waiting for an excessive time to draw a frame, we assume the frame is stale, and drop it.
-					if (pData->TotalUpdatedFrameCount > 0 && waitTimeMillis > 1000) {
-						isSharedSurfaceDirty = true;
-						LOG_DEBUG("Dropped %ls frame because wait time exceeded limit", pRecordingSourceCapture->Name().c_str());
-						continue;
-					}
-					LOG_TRACE(L"CaptureThreadProc waited for busy shared surface for %lld ms", waitTimeMillis);
-				}
+				TRACE_SPAN("WriteSourceFrame");
+				LatencyTimer writeTimer(*pData->Metrics.FrameWriteTime);
 				if (pSource->IsCursorCaptureEnabled.value_or(true)) {
 					// Get mouse info
+					EnterCriticalSection(pData->PtrInfoCriticalSection);
 					hr = pRecordingSourceCapture->GetMouse(pData->PtrInfo, pSourceData->FrameCoordinates, pSourceData->OffsetX, pSourceData->OffsetY);
+					if (SUCCEEDED(hr) && pData->CursorMetadata) {
+						LOG_ON_BAD_HR(WriteCursorMetadata(pData->CursorMetadata.get(), pData->PtrInfo));
+					}
+					LeaveCriticalSection(pData->PtrInfoCriticalSection);
 					if (FAILED(hr)) {
 						LOG_ERROR("Failed to get mouse data");
 					}
 				}
 				else if (pData->PtrInfo) {
+					EnterCriticalSection(pData->PtrInfoCriticalSection);
 					pData->PtrInfo->Visible = false;
+					if (pData->CursorMetadata) {
+						LOG_ON_BAD_HR(WriteCursorMetadata(pData->CursorMetadata.get(), pData->PtrInfo));
+					}
+					LeaveCriticalSection(pData->PtrInfoCriticalSection);
 				}
 
 				if (pSource->IsVideoCaptureEnabled.value_or(true)) {
-					RECT offsetFrameCoordinates = pSourceData->FrameCoordinates;
+					RECT offsetFrameCoordinates = localFrameCoordinates;
 					if (pSourceData->RecordingSource->OutputSize.has_value()) {
 						offsetFrameCoordinates = MakeRectEven(RECT
 							{
-								pSourceData->FrameCoordinates.left,
-								pSourceData->FrameCoordinates.top,
-								pSourceData->FrameCoordinates.left + pSourceData->RecordingSource->OutputSize.value().cx,
-								pSourceData->FrameCoordinates.top + pSourceData->RecordingSource->OutputSize.value().cy
+								0,
+								0,
+								pSourceData->RecordingSource->OutputSize.value().cx,
+								pSourceData->RecordingSource->OutputSize.value().cy
 							});
 					}
 
-					SIZE contentOffset = pRecordingSourceCapture->GetContentOffset(pSource->Anchor, pSourceData->FrameCoordinates, offsetFrameCoordinates);
-					OffsetRect(&offsetFrameCoordinates, pSourceData->OffsetX + contentOffset.cx, pSourceData->OffsetY + contentOffset.cy);
+					SIZE contentOffset = pRecordingSourceCapture->GetContentOffset(pSource->Anchor, localFrameCoordinates, offsetFrameCoordinates);
+					OffsetRect(&offsetFrameCoordinates, contentOffset.cx, contentOffset.cy);
 					if (isSourceDirty) {
-						textureManager.BlankTexture(SharedSurf, pSourceData->FrameCoordinates, pSourceData->OffsetX, pSourceData->OffsetY);
+						textureManager.BlankTexture(pCaptureSurf, localFrameCoordinates, 0, 0);
 						isSourceDirty = false;
 					}
-					if (isSharedSurfaceDirty && pFrame) {
-						textureManager.BlankTexture(SharedSurf, pSourceData->FrameCoordinates, pSourceData->OffsetX, pSourceData->OffsetY);
-						//The screen has been blacked out, so we restore a full frame to the shared surface before starting to apply updates.
-						hr = pRecordingSourceCapture->WriteNextFrameToSharedSurface(0, SharedSurf, pSourceData->OffsetX, pSourceData->OffsetY, offsetFrameCoordinates, pFrame);
-						isSharedSurfaceDirty = false;
+					if (isCaptureSurfaceDirty && pFrame) {
+						textureManager.BlankTexture(pCaptureSurf, localFrameCoordinates, 0, 0);
+						//The surface has been blacked out, so we restore a full frame before starting to apply updates.
+						hr = pRecordingSourceCapture->WriteNextFrameToSharedSurface(0, pCaptureSurf, 0, 0, offsetFrameCoordinates, pFrame);
+						isCaptureSurfaceDirty = false;
 					}
 					else {
-						hr = pRecordingSourceCapture->WriteNextFrameToSharedSurface(0, SharedSurf, pSourceData->OffsetX, pSourceData->OffsetY, offsetFrameCoordinates);
+						hr = pRecordingSourceCapture->WriteNextFrameToSharedSurface(0, pCaptureSurf, 0, 0, offsetFrameCoordinates);
 					}
 				}
 				else {
-					hr = textureManager.BlankTexture(SharedSurf, pSourceData->FrameCoordinates, pSourceData->OffsetX, pSourceData->OffsetY);
+					hr = textureManager.BlankTexture(pCaptureSurf, localFrameCoordinates, 0, 0);
 					if (SUCCEEDED(hr)) {
 						isCapturingVideo = false;
 					}
@@ -1016,6 +1312,8 @@ Start:
 				else if (hr == S_FALSE) {
 					continue;
 				}
+				PublishFrame();
+				pRecordingSourceCapture->OnFramePublished();
 				pData->TotalUpdatedFrameCount++;
 				QueryPerformanceCounter(&pData->LastUpdateTimeStamp);
 			}
@@ -1037,6 +1335,7 @@ Exit:
 		if (FAILED(hr))
 		{
 			ProcessCaptureHRESULT(hr, pData->ThreadResult, pSourceData->DxRes.Device);
+			FlightRecorder::Instance().Record(FlightEventType::CaptureFailed, hr, 0, pData->ThreadResult->IsRecoverableError ? 1 : 0);
 			if (pData->ThreadResult->IsRecoverableError) {
 				if (pData->ThreadResult->IsDeviceError) {
 					LOG_INFO("Recoverable device error in screen capture, reinitializing devices and capture..");
@@ -1044,7 +1343,7 @@ Exit:
 				}
 				else {
 					LOG_INFO("Recoverable error in screen capture, reinitializing..");
-					isSharedSurfaceDirty = true;
+					isCaptureSurfaceDirty = true;
 					if (pData->ThreadResult->NumberOfRetries == INFINITE
 						|| retryCount <= pData->ThreadResult->NumberOfRetries) {
 						retryCount++;
@@ -1070,219 +1369,272 @@ Exit:
 }
 
 
-DWORD WINAPI OverlayCaptureThreadProc(_In_ void *Param) {
-	HRESULT hr = E_FAIL;
-	_set_se_translator(ExceptionTranslator);
-	// Data passed in from thread creation
-	OVERLAY_THREAD_DATA *pData = static_cast<OVERLAY_THREAD_DATA *>(Param);
-
-	RECORDING_OVERLAY_DATA *pOverlayData = pData->RecordingOverlay;
-	RECORDING_OVERLAY *pOverlay = pOverlayData->RecordingOverlay;
-
-	DynamicWait retryWait;
-	retryWait.SetWaitBands({
+OverlayCaptureTask::OverlayCaptureTask(_In_ OVERLAY_THREAD_DATA *pData, _In_ DWORD acquireTimeoutMillis, _In_ DWORD frameIntervalMillis, _In_opt_ CRITICAL_SECTION *pDeviceCriticalSection) :
+	m_Data(pData),
+	m_Capture(nullptr),
+	m_ReleasedCapture(nullptr),
+	m_FrameBuffer(nullptr),
+	m_LastPublishedFrame(nullptr),
+	m_RetryWait{},
+	m_RetryCount(0),
+	m_IsStarted(false),
+	m_IsCapturingVideo(true),
+	m_IsFrameBufferDirty(true),
+	m_AcquireTimeoutMillis(acquireTimeoutMillis),
+	m_FrameIntervalMillis(frameIntervalMillis),
+	m_DeviceCriticalSection(pDeviceCriticalSection),
+	m_SourceStream(nullptr),
+	m_SourcePath(L""),
+	m_SourceWindowHandle(nullptr)
+{
+	m_RetryWait.SetWaitBands({
 						  {25, 5},
 						  {250, 5},
 						  {500, WAIT_BAND_STOP}
-						});
-	int retryCount = 0;
-	bool IsCapturingVideo = true;
-	CComPtr<ID3D11Texture2D> pSharedTexture = nullptr;
-	hr = CoInitializeEx(nullptr, COINITBASE_MULTITHREADED | COINIT_DISABLE_OLE1DDE);
-	if (FAILED(hr)) {
-		goto Exit;
+		});
+}
+
+DWORD OverlayCaptureTask::Run()
+{
+	DWORD nextRunMillis;
+	if (m_DeviceCriticalSection) {
+		//Readers keep device context state across calls, so tasks that share a device run one at a time.
+		EnterCriticalSection(m_DeviceCriticalSection);
+		nextRunMillis = RunOnce();
+		LeaveCriticalSection(m_DeviceCriticalSection);
+	}
+	else {
+		nextRunMillis = RunOnce();
 	}
+	//Readers may wait for threads of their own that take the device lock when they are destroyed, so they are destroyed outside it.
+	m_ReleasedCapture.reset();
+	return nextRunMillis;
+}
 
-Start:
+DWORD OverlayCaptureTask::RunOnce()
+{
+	_se_translator_function previousTranslator = _set_se_translator(ExceptionTranslator);
+	ExecuteFuncOnExit restoreTranslator([&]() { _set_se_translator(previousTranslator); });
+	HRESULT hr = S_OK;
+	DWORD nextRunMillis = 0;
+	try
 	{
-		try
-		{
-			bool isSharedTextureDirty = true;
-			unique_ptr<CaptureBase> overlayCapture = nullptr;
-			// D3D objects
-			CComPtr<ID3D11Texture2D> pCurrentFrame = nullptr;
-			CComPtr<ID3D11Texture2D> SharedSurf = nullptr;
-			CComPtr<IDXGIKeyedMutex> KeyMutex = nullptr;
-
-			SetEvent(pData->StartedEvent);
-
-			if (WaitForSingleObjectEx(pData->TerminateThreadsEvent, 0, FALSE) == WAIT_OBJECT_0) {
-				hr = S_OK;
-				goto Exit;
-			}
+		if (!m_IsStarted) {
+			m_IsStarted = true;
+			SetEvent(m_Data->StartedEvent);
+		}
+		if (WaitForSingleObjectEx(m_Data->TerminateThreadsEvent, 0, FALSE) == WAIT_OBJECT_0) {
+			m_Data->ThreadResult->RecordingResult = S_OK;
+			return Complete();
+		}
+		if (!m_Capture) {
+			hr = StartCapture();
+		}
+		if (SUCCEEDED(hr)) {
+			hr = CaptureFrame(&nextRunMillis);
+		}
+	}
+	catch (const AccessViolationException &e) {
+		hr = EXCEPTION_ACCESS_VIOLATION;
+		LOG_ERROR(L"Exception in overlay capture: AccessViolationException");
+	}
+	catch (...) {
+		hr = E_UNEXPECTED;
+		LOG_ERROR(L"Exception in overlay capture");
+	}
+	if (FAILED(hr)) {
+		return ProcessCaptureError(hr);
+	}
+	return nextRunMillis;
+}
 
-			overlayCapture.reset(CreateCaptureInstance(pOverlay));
-			if (!overlayCapture) {
-				LOG_ERROR(L"Failed to create recording source");
-				goto Exit;
-			}
+HRESULT OverlayCaptureTask::StartCapture()
+{
+	RECORDING_OVERLAY_DATA *pOverlayData = m_Data->RecordingOverlay;
+	RECORDING_OVERLAY *pOverlay = pOverlayData->RecordingOverlay;
+	HRESULT hr;
+	m_Capture.reset(CreateCaptureInstance(pOverlay));
+	if (!m_Capture) {
+		LOG_ERROR(L"Failed to create recording source");
+		return E_FAIL;
+	}
+	m_Capture->SetDeviceCriticalSection(m_DeviceCriticalSection);
+	hr = m_Capture->Initialize(pOverlayData->DxRes.Context, pOverlayData->DxRes.Device);
+	hr = m_Capture->StartCapture(*pOverlay);
+	if (FAILED(hr)) {
+		ReleaseCapture();
+		return hr;
+	}
+	m_SourceStream = pOverlay->SourceStream;
+	m_SourcePath = pOverlay->SourcePath;
+	m_SourceWindowHandle = pOverlay->SourceWindow;
+	m_IsFrameBufferDirty = true;
+	m_LastPublishedFrame.Release();
+	m_Data->IsStaticContent = m_Capture->IsStaticContent();
+	*m_Data->ThreadResult = {};
+	m_Data->ThreadResult->RecordingResult = S_OK;
+	return hr;
+}
 
-			hr = overlayCapture->Initialize(pOverlayData->DxRes.Context, pOverlayData->DxRes.Device);
-			hr = overlayCapture->StartCapture(*pOverlay);
-			if (FAILED(hr))
-			{
-				goto Exit;
-			}
+void OverlayCaptureTask::ReleaseCapture()
+{
+	if (m_Capture) {
+		m_ReleasedCapture = std::move(m_Capture);
+	}
+}
 
-			// Obtain handle to sync shared Surface
-			hr = pOverlayData->DxRes.Device->OpenSharedResource(pData->CanvasTexSharedHandle, __uuidof(ID3D11Texture2D), reinterpret_cast<void **>(&SharedSurf));
-			if (FAILED(hr))
-			{
-				LOG_ERROR(L"Opening shared texture failed");
-				goto Exit;
-			}
-			hr = SharedSurf->QueryInterface(__uuidof(IDXGIKeyedMutex), reinterpret_cast<void **>(&KeyMutex));
-			if (FAILED(hr))
-			{
-				LOG_ERROR(L"Failed to get keyed mutex interface in spawned thread");
-				goto Exit;
-			}
+bool OverlayCaptureTask::IsSourceChanged()
+{
+	RECORDING_OVERLAY *pOverlay = m_Data->RecordingOverlay->RecordingOverlay;
+	return pOverlay->SourcePath != m_SourcePath || pOverlay->SourceStream != m_SourceStream || pOverlay->SourceWindow != m_SourceWindowHandle;
+}
 
-			const IStream *sourceStream = pOverlay->SourceStream;
-			const std::wstring sourcePath = pOverlay->SourcePath;
-			const HWND sourceWindowHandle = pOverlay->SourceWindow;
+HRESULT OverlayCaptureTask::CaptureFrame(_Out_ DWORD *pNextRunMillis)
+{
+	RECORDING_OVERLAY_DATA *pOverlayData = m_Data->RecordingOverlay;
+	RECORDING_OVERLAY *pOverlay = pOverlayData->RecordingOverlay;
+	*pNextRunMillis = 0;
 
-			auto IsSourceChanged([&sourceStream, &sourcePath, &sourceWindowHandle](RECORDING_OVERLAY *overlay) {
-				return overlay->SourcePath != sourcePath || overlay->SourceStream != sourceStream || overlay->SourceWindow != sourceWindowHandle;
-				});
+	if (IsSourceChanged()) {
+		//Restart the capture with the new source on the next run.
+		ReleaseCapture();
+		return S_OK;
+	}
 
-			*pData->ThreadResult = {};
-			pData->ThreadResult->RecordingResult = S_OK;
-			// Main capture loop
-			while (true)
-			{
-				if (WaitForSingleObjectEx(pData->TerminateThreadsEvent, 0, FALSE) == WAIT_OBJECT_0) {
-					hr = S_OK;
-					break;
-				}
+	if (!m_IsCapturingVideo) {
+		*pNextRunMillis = 1;
+		m_IsCapturingVideo = pOverlay->IsVideoCaptureEnabled.value_or(true);
+		return S_OK;
+	}
+	CComPtr<ID3D11Texture2D> pCurrentFrame = nullptr;
+	// Get new frame from video capture
+	HRESULT hr = m_Capture->AcquireNextFrame(m_AcquireTimeoutMillis, &pCurrentFrame);
+	if (hr == DXGI_ERROR_WAIT_TIMEOUT) {
+		*pNextRunMillis = m_FrameIntervalMillis;
+		return S_OK;
+	}
+	else if (hr == S_FALSE) {
+		*pNextRunMillis = 10;
+		return S_OK;
+	}
+	else if (FAILED(hr)) {
+		return hr;
+	}
+	//Readers of changing content may return the same texture updated in place, so only static content is skipped by texture identity.
+	if (m_Data->IsStaticContent && pCurrentFrame == m_LastPublishedFrame && !m_IsFrameBufferDirty) {
+		*pNextRunMillis = max(m_FrameIntervalMillis, 10ul);
+		return S_OK;
+	}
 
-				if (IsSourceChanged(pOverlay)) {
-					goto Start;
-				}
+	if (m_FrameBuffer == nullptr || m_IsFrameBufferDirty) {
+		D3D11_TEXTURE2D_DESC desc;
+		pCurrentFrame->GetDesc(&desc);
+		if (!m_FrameBuffer
+			|| m_FrameBuffer->GetSize().cx != static_cast<LONG>(desc.Width)
+			|| m_FrameBuffer->GetSize().cy != static_cast<LONG>(desc.Height)) {
+			//The compositor may still be reading from the current buffers, so a new set is created and swapped in.
+			std::shared_ptr<TripleBufferedTexture> pNewFrameBuffer = std::make_shared<TripleBufferedTexture>();
+			RETURN_ON_BAD_HR(hr = pNewFrameBuffer->Initialize(pOverlayData->DxRes.Device, desc.Width, desc.Height));
+			m_FrameBuffer = pNewFrameBuffer;
+			std::atomic_store(&m_Data->FrameBuffer, m_FrameBuffer);
+			LOG_INFO("Created new overlay frame buffers");
+		}
+		m_IsFrameBufferDirty = false;
+	}
 
-				if (!IsCapturingVideo) {
-					Sleep(1);
-					IsCapturingVideo = pOverlay->IsVideoCaptureEnabled.value_or(true);
-					continue;
-				}
-				pCurrentFrame.Release();
-				// Get new frame from video capture
-				hr = overlayCapture->AcquireNextFrame(10, &pCurrentFrame);
-				if (hr == DXGI_ERROR_WAIT_TIMEOUT) {
-					continue;
-				}
-				else if (hr == S_FALSE) {
-					Sleep(10);
-					continue;
-				}
-				else if (FAILED(hr)) {
-					break;
-				}
+	if (!pOverlay->IsVideoCaptureEnabled.value_or(true)) {
+		D3D11_TEXTURE2D_DESC desc;
+		pCurrentFrame->GetDesc(&desc);
+		pCurrentFrame.Release();
+		pOverlayData->DxRes.Device->CreateTexture2D(&desc, nullptr, &pCurrentFrame);
+		m_IsCapturingVideo = false;
+	}
 
-				if (pSharedTexture == nullptr || isSharedTextureDirty) {
-					D3D11_TEXTURE2D_DESC desc;
-					pCurrentFrame->GetDesc(&desc);
-					bool createSharedTexture = true;
-					if (pSharedTexture) {
-						D3D11_TEXTURE2D_DESC pSharedTextureDesc;
-						pSharedTexture->GetDesc(&pSharedTextureDesc);
-						if (pSharedTextureDesc.Width == desc.Width && pSharedTextureDesc.Height == desc.Height) {
-							createSharedTexture = false;
-						}
-						else {
-							pSharedTexture.Release();
-						}
-					}
-					if (createSharedTexture) {
-						desc.Format = DXGI_FORMAT_B8G8R8A8_UNORM;
-						desc.SampleDesc.Count = 1;
-						desc.Usage = D3D11_USAGE_DEFAULT;
-						desc.BindFlags = D3D11_BIND_RENDER_TARGET | D3D11_BIND_SHADER_RESOURCE;
-						desc.CPUAccessFlags = 0;
-						desc.MiscFlags = D3D11_RESOURCE_MISC_SHARED;
-						pOverlayData->DxRes.Device->CreateTexture2D(&desc, nullptr, &pSharedTexture);
-						HANDLE sharedHandle = GetSharedHandle(pSharedTexture);
-						pData->OverlayTexSharedHandle = sharedHandle;
-						LOG_INFO("Created new overlay shared texture");
-					}
-					isSharedTextureDirty = false;
-				}
+	ID3D11Texture2D *pBackBuffer = nullptr;
+	RETURN_ON_BAD_HR(hr = m_FrameBuffer->GetBackBuffer(&pBackBuffer));
+	pOverlayData->DxRes.Context->CopyResource(pBackBuffer, pCurrentFrame);
+	//Publishing releases the keyed mutex of the buffer, which submits the copy before the compositor device reads it.
+	m_FrameBuffer->Publish();
+	m_LastPublishedFrame = pCurrentFrame;
+	QueryPerformanceCounter(&m_Data->LastUpdateTimeStamp);
+	// Notify the rendering loop about the updated overlay.
+	SetEvent(m_Data->NewFrameEvent);
+	*pNextRunMillis = m_FrameIntervalMillis;
+	return S_OK;
+}
 
-				if (!pOverlay->IsVideoCaptureEnabled.value_or(true)) {
-					D3D11_TEXTURE2D_DESC desc;
-					pCurrentFrame->GetDesc(&desc);
-					pCurrentFrame.Release();
-					pOverlayData->DxRes.Device->CreateTexture2D(&desc, nullptr, &pCurrentFrame);
-					IsCapturingVideo = false;
+DWORD OverlayCaptureTask::ProcessCaptureError(_In_ HRESULT hr)
+{
+	ReleaseCapture();
+	//E_ABORT is returned when the capture loop should be stopped, but the recording continue. On other errors, we check how to handle them.
+	if (hr == E_ABORT) {
+		hr = S_OK;
+	}
+	m_Data->ThreadResult->RecordingResult = hr;
+	if (FAILED(hr))
+	{
+		ProcessCaptureHRESULT(hr, m_Data->ThreadResult, m_Data->RecordingOverlay->DxRes.Device);
+		if (m_Data->ThreadResult->IsRecoverableError) {
+			if (m_Data->ThreadResult->IsDeviceError) {
+				LOG_INFO("Recoverable device error in overlay capture, reinitializing devices and capture..");
+				SetEvent(m_Data->ErrorEvent);
+			}
+			else {
+				LOG_INFO("Recoverable error in overlay capture, reinitializing..");
+				if (m_Data->ThreadResult->NumberOfRetries == INFINITE
+					|| m_RetryCount <= m_Data->ThreadResult->NumberOfRetries) {
+					m_RetryCount++;
+					return m_RetryWait.GetNextWaitTime();
 				}
-
-				pOverlayData->DxRes.Context->CopyResource(pSharedTexture, pCurrentFrame);
-				//If a shared texture is updated on one device ID3D11DeviceContext::Flush must be called on that device. 
-				//https://docs.microsoft.com/en-us/windows/win32/api/d3d11/nf-d3d11-id3d11device-opensharedresource
-				pOverlayData->DxRes.Context->Flush();
-				QueryPerformanceCounter(&pData->LastUpdateTimeStamp);
-				// Try to acquire keyed mutex in order to access shared surface. The timeout value is 0, and we just continue if we don't get a lock.
-				// This is just used to notify the rendering loop about updated overlays, so no reason to wait around if it's already updating.
-				if (KeyMutex->AcquireSync(0, 0) == S_OK) {
-					KeyMutex->ReleaseSync(1);
+				else {
+					m_Data->ThreadResult->IsRecoverableError = false;
+					SetEvent(m_Data->ErrorEvent);
+					LOG_ERROR("Retry count of %d exceeded in overlay capture, exiting..", m_Data->ThreadResult->NumberOfRetries);
 				}
 			}
 		}
-		catch (const AccessViolationException &e) {
-			hr = EXCEPTION_ACCESS_VIOLATION;
-			LOG_ERROR(L"Exception in WASAPICapture: AccessViolationException");
-		}
-		catch (...) {
-			hr = E_UNEXPECTED;
-			LOG_ERROR(L"Exception in WASAPICapture");
+		else {
+			SetEvent(m_Data->ErrorEvent);
+			LOG_ERROR("Fatal error in overlay capture, exiting..");
 		}
 	}
-Exit:
-	if (pData->ThreadResult) {
-		//E_ABORT is returned when the capture loop should be stopped, but the recording continue. On other errors, we check how to handle them.
-		if (hr == E_ABORT) {
-			hr = S_OK;
-		}
+	return Complete();
+}
+
+DWORD OverlayCaptureTask::Complete()
+{
+	ReleaseCapture();
+	m_LastPublishedFrame.Release();
+	m_Data->IsStaticContent = false;
+	//Remove the overlay from the canvas before exiting.
+	m_FrameBuffer = nullptr;
+	std::atomic_store(&m_Data->FrameBuffer, std::shared_ptr<TripleBufferedTexture>(nullptr));
+	return INFINITE;
+}
+
+DWORD WINAPI OverlayCaptureThreadProc(_In_ void *Param) {
+	// Data passed in from thread creation
+	OVERLAY_THREAD_DATA *pData = static_cast<OVERLAY_THREAD_DATA *>(Param);
+	HRESULT hr = CoInitializeEx(nullptr, COINITBASE_MULTITHREADED | COINIT_DISABLE_OLE1DDE);
+	if (FAILED(hr)) {
+		SetEvent(pData->StartedEvent);
 		pData->ThreadResult->RecordingResult = hr;
-		if (FAILED(hr))
-		{
-			ProcessCaptureHRESULT(hr, pData->ThreadResult, pOverlayData->DxRes.Device);
-			if (pData->ThreadResult->IsRecoverableError) {
-				if (pData->ThreadResult->IsDeviceError) {
-					LOG_INFO("Recoverable device error in overlay capture, reinitializing devices and capture..");
-					SetEvent(pData->ErrorEvent);
-				}
-				else {
-					LOG_INFO("Recoverable error in overlay capture, reinitializing..");
-					if (pData->ThreadResult->NumberOfRetries == INFINITE
-						|| retryCount <= pData->ThreadResult->NumberOfRetries) {
-						retryCount++;
-						retryWait.Wait();
-						goto Start;
-					}
-					else {
-						pData->ThreadResult->IsRecoverableError = false;
-						SetEvent(pData->ErrorEvent);
-						LOG_ERROR("Retry count of %d exceeded in overlay capture, exiting..", pData->ThreadResult->NumberOfRetries);
-					}
-				}
+		LOG_ERROR(L"CoInitializeEx failed in overlay capture: hr = 0x%08x", hr);
+		return 0;
+	}
+	{
+		OverlayCaptureTask task(pData, PINNED_OVERLAY_ACQUIRE_TIMEOUT_MILLIS, 0);
+		while (true) {
+			DWORD nextRunMillis = task.Run();
+			if (nextRunMillis == INFINITE) {
+				break;
 			}
-			else {
-				SetEvent(pData->ErrorEvent);
-				LOG_ERROR("Fatal error in overlay capture, exiting..");
+			if (nextRunMillis > 0) {
+				//Wake up early on termination, the next run will then exit.
+				WaitForSingleObjectEx(pData->TerminateThreadsEvent, nextRunMillis, FALSE);
 			}
 		}
 	}
-
-	//Blank shared texture before exiting.
-	if (pSharedTexture) {
-		D3D11_TEXTURE2D_DESC desc;
-		pSharedTexture->GetDesc(&desc);
-		CComPtr<ID3D11Texture2D> pBlankTexture;
-		pOverlayData->DxRes.Device->CreateTexture2D(&desc, nullptr, &pBlankTexture);
-		pOverlayData->DxRes.Context->CopyResource(pSharedTexture, pBlankTexture);
-	}
-
 	CoUninitialize();
 	LOG_DEBUG("Exiting OverlayCaptureThreadProc");
 	return 0;
@@ -1335,11 +1687,51 @@ _Ret_maybenull_ CaptureBase *CreateCaptureInstance(_In_ RECORDING_SOURCE_BASE *p
 		case RecordingSourceType::Window: {
 			return new WindowsGraphicsCapture();
 		}
+		case RecordingSourceType::TestPattern: {
+			return new TestPatternCapture();
+		}
+		case RecordingSourceType::Replay: {
+			return new TraceReplayCapture();
+		}
 		default:
 			return nullptr;
 	}
 }
 
+//
+// Returns true if the overlay can be polled from the capture worker pool instead of a pinned thread.
+// Pictures are either static or animate at GIF frame rates. Videos are decoded by their source reader, and test patterns are generated,
+// so a non-blocking poll finds their next frame without waiting. Screen, window and camera overlays block on the capture API and keep their own thread.
+//
+bool IsPooledCaptureSource(_In_ RECORDING_SOURCE_BASE *pSource)
+{
+	switch (pSource->Type)
+	{
+		case RecordingSourceType::Picture:
+		case RecordingSourceType::Video:
+		case RecordingSourceType::TestPattern:
+			return true;
+		default:
+			return false;
+	}
+}
+
+//
+// Records the current pointer state, in the same canvas coordinates the pointer would have been drawn at.
+// Called with the pointer info lock held, right after the pointer info is updated, so IsPointerShapeUpdated tells whether the shape changed.
+// The writer only queues a small record, and hashes and copies the shape buffer when it changed.
+//
+HRESULT WriteCursorMetadata(_In_ CursorMetadataWriter *pWriter, _In_ PTR_INFO *pPtrInfo)
+{
+	CURSOR_METADATA_POINTER pointer{};
+	pointer.Left = static_cast<LONG>(round((pPtrInfo->Position.x + pPtrInfo->Offset.x) * pPtrInfo->Scale.cx));
+	pointer.Top = static_cast<LONG>(round((pPtrInfo->Position.y + pPtrInfo->Offset.y) * pPtrInfo->Scale.cy));
+	pointer.Visible = pPtrInfo->Visible && pPtrInfo->PtrShapeBuffer != nullptr;
+	pointer.ScaleX = pPtrInfo->Scale.cx;
+	pointer.ScaleY = pPtrInfo->Scale.cy;
+	return pWriter->WritePointer(pointer, pPtrInfo->ShapeInfo, pPtrInfo->PtrShapeBuffer, pPtrInfo->BufferSize, pPtrInfo->IsPointerShapeUpdated);
+}
+
 void ProcessCaptureHRESULT(_In_ HRESULT hr, _Inout_ CAPTURE_RESULT *pResult, _In_opt_ ID3D11Device *pDevice) {
 	*pResult = {};
 	pResult->RecordingResult = hr;
@@ -5,6 +5,8 @@
 #include "Screengrab.h"
 #include "TextureManager.h"
 #include "Util.h"
+#include "CaptureScheduler.h"
+#include "MetricsRegistry.h"
 #include <atlbase.h>
 
 void ProcessCaptureHRESULT(_In_ HRESULT hr, _Inout_ CAPTURE_RESULT *pResult, _In_opt_ ID3D11Device *pDevice);
@@ -39,35 +41,89 @@ public:
 	std::vector<CAPTURE_RESULT *> GetCaptureResults();
 	std::vector<CAPTURE_THREAD_DATA> GetCaptureThreadData();
 	std::vector<OVERLAY_THREAD_DATA> GetOverlayThreadData();
+	/// <summary>
+	/// Gets the number of published, dropped and late frames for each recording source and overlay.
+	/// </summary>
+	std::vector<SOURCE_FRAME_STATISTICS> GetFrameStatistics();
 	virtual HRESULT ProcessOverlays(_Inout_ ID3D11Texture2D *pBackgroundFrame, _Out_ int *updateCount);
 	HRESULT InitializeOverlays(_In_ const std::vector<RECORDING_OVERLAY *> &overlays, _In_opt_  HANDLE hErrorEvent);
+	/// <summary>
+	/// Sets the writer the capture threads record the pointer to, when it is not drawn on the frames. Must be set before capture is started.
+	/// </summary>
+	inline void SetCursorMetadataWriter(_In_opt_ std::shared_ptr<CursorMetadataWriter> pWriter) { m_CursorMetadataWriter = pWriter; }
+	/// <summary>
+	/// Sets the registry the compositor and capture threads record their metrics to. Must be set before capture is started.
+	/// </summary>
+	void SetMetricsRegistry(_In_ std::shared_ptr<MetricsRegistry> pMetrics);
 protected:
 	LARGE_INTEGER m_LastAcquiredFrameTimeStamp;
-	ID3D11Texture2D *m_SharedSurf;
-	IDXGIKeyedMutex *m_KeyMutex;
+	//The canvas all recording sources are composed onto.
+	ID3D11Texture2D *m_CanvasSurf;
 	ID3D11Device *m_Device;
 	ID3D11DeviceContext *m_DeviceContext;
 	RECT m_OutputRect;
 	PTR_INFO m_PtrInfo;
 
-	virtual HRESULT CreateSharedSurf(_In_ RECT desktopRect, _Outptr_ ID3D11Texture2D **ppSharedTexture, _Outptr_ IDXGIKeyedMutex **ppKeyedMutex);
-	virtual HRESULT CreateSharedSurf(_In_ const std::vector<RECORDING_SOURCE *> &sources, _Out_ std::vector<RECORDING_SOURCE_DATA *> *pCreatedOutputs, _Out_ RECT *pDeskBounds, _Outptr_ ID3D11Texture2D **ppSharedTexture, _Outptr_ IDXGIKeyedMutex **ppKeyedMutex);
+	virtual HRESULT CreateCanvasSurf(_In_ RECT desktopRect, _Outptr_ ID3D11Texture2D **ppCanvasTexture);
+	virtual HRESULT CreateCanvasSurf(_In_ const std::vector<RECORDING_SOURCE *> &sources, _Out_ std::vector<RECORDING_SOURCE_DATA *> *pCreatedOutputs, _Out_ RECT *pDeskBounds, _Outptr_ ID3D11Texture2D **ppCanvasTexture);
 private:
 	bool m_IsInitialFrameWriteComplete;
 	bool m_IsInitialOverlayWriteComplete;
 	bool m_IsCapturing;
 	HANDLE m_TerminateThreadsEvent;
+	HANDLE m_NewFrameEvent;
 	CRITICAL_SECTION m_CriticalSection;
+	CRITICAL_SECTION m_PtrInfoCriticalSection;
 	std::shared_ptr<ENCODER_OPTIONS> m_EncoderOptions;
 	std::shared_ptr<OUTPUT_OPTIONS> m_OutputOptions;
 	std::shared_ptr<MOUSE_OPTIONS> m_MouseOptions;
 	std::unique_ptr<TextureManager> m_TextureManager;
+	//Runs capture of overlays that do not need a dedicated thread.
+	std::unique_ptr<CaptureScheduler> m_Scheduler;
+	//The device shared by all overlays captured on the scheduler, and the lock that keeps them from using it at the same time.
+	DX_RESOURCES m_PooledDxResources;
+	CRITICAL_SECTION m_PooledDeviceCriticalSection;
 	CComPtr<ID3D11Texture2D> m_FrameCopy;
+	std::shared_ptr<CursorMetadataWriter> m_CursorMetadataWriter;
+	std::shared_ptr<MetricsRegistry> m_Metrics;
+	//Time spent waiting for a capture thread to publish a frame, and composing the published frames onto the canvas
+	LatencyHistogram *m_FrameWaitTime;
+	LatencyHistogram *m_ComposeTime;
 
 	std::vector<CAPTURE_THREAD *> m_CaptureThreads;
 	std::vector<OVERLAY_THREAD *> m_OverlayThreads;
 
+	struct OVERLAY_LAYER_ENTRY {
+		std::shared_ptr<TripleBufferedTexture> FrameBuffer;
+		CComPtr<ID3D11Texture2D> Texture;
+		RECT Rect;
+	};
+	//
+	// A run of consecutive static overlays, rasterized at their final size and position into a canvas sized layer.
+	//
+	struct OVERLAY_LAYER {
+		CComPtr<ID3D11Texture2D> Texture;
+		// The overlays the layer was rasterized from. The layer is rebuilt when any of them change.
+		std::vector<OVERLAY_LAYER_ENTRY> Overlays;
+	};
+	std::vector<OVERLAY_LAYER> m_OverlayLayers;
+	// Guards the overlay layer cache, as overlays may be drawn from both the recording loop and snapshot threads.
+	CRITICAL_SECTION m_OverlayCriticalSection;
+
 	void Clean();
+	/// <summary>
+	/// Copies the newest completed frame of each recording source onto the canvas. Sources without a new frame keep their previous content.
+	/// </summary>
+	HRESULT ComposeCanvas();
+	/// <summary>
+	/// Draws a run of static overlays onto the canvas from a cached layer. The layer is only rasterized again if the overlays, their frames or their positions changed.
+	/// </summary>
+	/// <param name="pCanvasTexture">The texture to draw the layer onto</param>
+	/// <param name="layerIndex">Index of the run of static overlays in draw order</param>
+	/// <param name="overlays">The overlays in the run</param>
+	/// <param name="isContentUpdated">True if any of the overlays has published a new frame</param>
+	HRESULT DrawOverlayLayer(_Inout_ ID3D11Texture2D *pCanvasTexture, _In_ size_t layerIndex, _In_ const std::vector<OVERLAY_LAYER_ENTRY> &overlays, _In_ bool isContentUpdated);
+	double GetLateFrameThresholdMillis();
 	HRESULT WaitForThreadTermination();
 	_Ret_maybenull_ CAPTURE_THREAD_DATA *GetCaptureDataForRect(RECT rect);
 	RECT GetSourceRect(_In_ SIZE canvasSize, _In_ RECORDING_SOURCE_DATA *pSource);
@@ -0,0 +1,39 @@
+#pragma once
+#include <Windows.h>
+
+//
+// Helpers for processing 32bpp pixels four at a time, shared by the CPU pixel kernels.
+// PIXELS_SIMD is defined when vector instructions are available on this build. Otherwise kernels must use their scalar code.
+//
+#if defined(_M_X64) || defined(_M_IX86)
+#include <emmintrin.h>
+#define PIXELS_SIMD
+//SSE2 is part of the x64 baseline, and the default instruction set for 32 bit builds.
+typedef __m128i PIXELS;
+static inline PIXELS LoadPixels(const UINT *p) { return _mm_loadu_si128(reinterpret_cast<const __m128i *>(p)); }
+static inline void StorePixels(UINT *p, PIXELS v) { _mm_storeu_si128(reinterpret_cast<__m128i *>(p), v); }
+static inline PIXELS SplatPixels(UINT v) { return _mm_set1_epi32(static_cast<int>(v)); }
+static inline PIXELS SetPixels(UINT p0, UINT p1, UINT p2, UINT p3) { return _mm_setr_epi32(p0, p1, p2, p3); }
+static inline PIXELS AndPixels(PIXELS a, PIXELS b) { return _mm_and_si128(a, b); }
+static inline PIXELS OrPixels(PIXELS a, PIXELS b) { return _mm_or_si128(a, b); }
+static inline PIXELS XorPixels(PIXELS a, PIXELS b) { return _mm_xor_si128(a, b); }
+// a & ~b
+static inline PIXELS AndNotPixels(PIXELS a, PIXELS b) { return _mm_andnot_si128(b, a); }
+static inline PIXELS EqualPixels(PIXELS a, PIXELS b) { return _mm_cmpeq_epi32(a, b); }
+// mask ? a : b, for masks that are all ones or all zeros in each pixel
+static inline PIXELS SelectPixels(PIXELS mask, PIXELS a, PIXELS b) { return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b)); }
+#elif defined(_M_ARM64)
+#include <arm_neon.h>
+#define PIXELS_SIMD
+typedef uint32x4_t PIXELS;
+static inline PIXELS LoadPixels(const UINT *p) { return vld1q_u32(reinterpret_cast<const uint32_t *>(p)); }
+static inline void StorePixels(UINT *p, PIXELS v) { vst1q_u32(reinterpret_cast<uint32_t *>(p), v); }
+static inline PIXELS SplatPixels(UINT v) { return vdupq_n_u32(v); }
+static inline PIXELS SetPixels(UINT p0, UINT p1, UINT p2, UINT p3) { const uint32_t lanes[4] = { p0, p1, p2, p3 }; return vld1q_u32(lanes); }
+static inline PIXELS AndPixels(PIXELS a, PIXELS b) { return vandq_u32(a, b); }
+static inline PIXELS OrPixels(PIXELS a, PIXELS b) { return vorrq_u32(a, b); }
+static inline PIXELS XorPixels(PIXELS a, PIXELS b) { return veorq_u32(a, b); }
+static inline PIXELS AndNotPixels(PIXELS a, PIXELS b) { return vbicq_u32(a, b); }
+static inline PIXELS EqualPixels(PIXELS a, PIXELS b) { return vceqq_u32(a, b); }
+static inline PIXELS SelectPixels(PIXELS mask, PIXELS a, PIXELS b) { return vbslq_u32(mask, a, b); }
+#endif
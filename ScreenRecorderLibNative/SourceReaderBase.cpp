@@ -3,8 +3,50 @@
 #include "Cleanup.h"
 using namespace std;
 
+static std::optional<YuvPixelFormat> GetYuvPixelFormat(_In_ const GUID &subtype)
+{
+	if (subtype == MFVideoFormat_NV12) {
+		return YuvPixelFormat::NV12;
+	}
+	else if (subtype == MFVideoFormat_YUY2) {
+		return YuvPixelFormat::YUY2;
+	}
+	return std::nullopt;
+}
+
+static YuvMatrix GetYuvMatrix(_In_ IMFMediaType *pMediaType, _In_ SIZE frameSize)
+{
+	UINT32 transferMatrix = MFGetAttributeUINT32(pMediaType, MF_MT_YUV_MATRIX, MFVideoTransferMatrix_Unknown);
+	if (transferMatrix == MFVideoTransferMatrix_BT709) {
+		return YuvMatrix::BT709;
+	}
+	else if (transferMatrix == MFVideoTransferMatrix_BT601) {
+		return YuvMatrix::BT601;
+	}
+	//Without a matrix in the media type, HD video is assumed to be BT.709 and SD video BT.601
+	return frameSize.cy >= 720 ? YuvMatrix::BT709 : YuvMatrix::BT601;
+}
+
 SourceReaderBase::SourceReaderBase() :
-	m_Sample{ nullptr },
+	m_OutputSamplePool{},
+	m_OutputSampleSize(0),
+	m_LatestBuffer(nullptr),
+	m_FrameQueue(nullptr),
+	m_IsReadPaused(false),
+	m_StreamIndex(0),
+	m_QPCFrequency{ 0 },
+	m_Clock(nullptr),
+	m_IsVirtualClock(false),
+	m_UploadingBuffer(nullptr),
+	m_UploadTexture(nullptr),
+	m_YuvFormat(std::nullopt),
+	m_YuvMatrix{},
+	m_IsYuvConvertedOnGpu(false),
+	m_LumaTexture(nullptr),
+	m_ChromaTexture(nullptr),
+	m_AllocatedSampleCount(0),
+	m_AllocatedTextureCount(0),
+	m_ReceivedFrameCount(0),
 	m_LastSampleReceivedTimeStamp{ 0 },
 	m_ReferenceCount(1),
 	m_Stride(0),
@@ -25,12 +67,23 @@ SourceReaderBase::SourceReaderBase() :
 	InitializeCriticalSection(&m_CriticalSection);
 	m_NewFrameEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
 	m_StopCaptureEvent = CreateEvent(nullptr, TRUE, FALSE, nullptr);
+	QueryPerformanceFrequency(&m_QPCFrequency);
 }
 SourceReaderBase::~SourceReaderBase()
 {
 	Close();
+	if (m_ReceivedFrameCount > 0) {
+		LOG_DEBUG(L"Source reader received %lld frames, and allocated %u output samples and %u upload textures", m_ReceivedFrameCount, m_AllocatedSampleCount, m_AllocatedTextureCount);
+	}
+	if (m_FrameQueue) {
+		DECODED_FRAME_QUEUE_STATISTICS statistics = m_FrameQueue->GetStatistics();
+		LOG_DEBUG(L"Source reader presented %lld queued frames, of which %lld were late, and dropped %lld frames", statistics.PresentedFrameCount, statistics.LateFrameCount, statistics.DroppedFrameCount);
+	}
 	EnterCriticalSection(&m_CriticalSection);
-
+	if (m_FramerateTimer && m_FramerateTimer->GetTickCount() > 0) {
+		TIMER_LATENESS_HISTOGRAM lateness = m_FramerateTimer->GetLatenessHistogram();
+		LOG_DEBUG(L"Source reader frame rate timer ticked %lld times, with an average lateness of %.3f ms and a maximum of %.3f ms, and missed %lld ticks", lateness.TickCount, lateness.TotalLateness / 10000.0 / max(1, lateness.TickCount), lateness.MaxLateness / 10000.0, lateness.MissedTickCount);
+	}
 	delete m_FramerateTimer;
 	CloseHandle(m_NewFrameEvent);
 	CloseHandle(m_StopCaptureEvent);
@@ -47,6 +100,8 @@ HRESULT SourceReaderBase::StartCapture(_In_ RECORDING_SOURCE_BASE &recordingSour
 	EnterCriticalSection(&m_CriticalSection);
 	LeaveCriticalSectionOnExit leaveCriticalSection(&m_CriticalSection, L"StartCapture");
 	m_RecordingSource = &recordingSource;
+	m_Clock = recordingSource.Clock;
+	m_IsVirtualClock = std::dynamic_pointer_cast<VirtualMediaClock>(m_Clock) != nullptr;
 	long streamIndex;
 
 	if (recordingSource.SourceStream) {
@@ -59,6 +114,20 @@ HRESULT SourceReaderBase::StartCapture(_In_ RECORDING_SOURCE_BASE &recordingSour
 	RETURN_ON_BAD_HR(GetDefaultStride(m_OutputMediaType, &m_Stride));
 	RETURN_ON_BAD_HR(GetFrameRate(m_InputMediaType, &m_FrameRate));
 	RETURN_ON_BAD_HR(GetFrameSize(m_InputMediaType, &m_FrameSize));
+	GUID outputSubtype;
+	RETURN_ON_BAD_HR(hr = m_OutputMediaType->GetGUID(MF_MT_SUBTYPE, &outputSubtype));
+	m_YuvFormat = GetYuvPixelFormat(outputSubtype);
+	if (m_YuvFormat.has_value()) {
+		bool isFullRange = MFGetAttributeUINT32(m_OutputMediaType, MF_MT_VIDEO_NOMINAL_RANGE, MFNominalRange_Unknown) == MFNominalRange_0_255;
+		m_YuvMatrix = GetYuvToRgbMatrix(GetYuvMatrix(m_OutputMediaType, m_FrameSize), isFullRange);
+		m_IsYuvConvertedOnGpu = m_TextureManager->IsYuvTextureSupported(m_YuvFormat.value());
+		LOG_INFO(L"Source reader frames are %ls, and are converted to RGB on the %ls", m_YuvFormat.value() == YuvPixelFormat::NV12 ? L"NV12" : L"YUY2", m_IsYuvConvertedOnGpu ? L"GPU" : L"CPU");
+	}
+	if (GetLookaheadFrameCount() > 0) {
+		m_FrameQueue = std::make_unique<DecodedFrameQueue<CComPtr<IMFMediaBuffer>>>(GetLookaheadFrameCount());
+	}
+	m_IsReadPaused = false;
+	m_StreamIndex = streamIndex;
 	if (SUCCEEDED(hr))
 	{
 		ResetEvent(m_StopCaptureEvent);
@@ -92,7 +161,11 @@ HRESULT SourceReaderBase::GetNativeSize(_In_ RECORDING_SOURCE_BASE &recordingSou
 void SourceReaderBase::Close()
 {
 	EnterCriticalSection(&m_CriticalSection);
-	SafeRelease(&m_Sample);
+	m_LatestBuffer.Release();
+	if (m_FrameQueue) {
+		m_FrameQueue->Clear();
+	}
+	m_OutputSamplePool.clear();
 	if (m_FramerateTimer) {
 		m_FramerateTimer->StopTimer(true);
 	}
@@ -105,6 +178,28 @@ void SourceReaderBase::Close()
 
 HRESULT SourceReaderBase::AcquireNextFrame(_In_ DWORD timeoutMillis, _Outptr_opt_ ID3D11Texture2D **ppFrame)
 {
+	HRESULT hr = UploadNextFrame(timeoutMillis, ppFrame != nullptr);
+	if (SUCCEEDED(hr) && ppFrame) {
+		if (m_YuvFormat.has_value() && m_IsYuvConvertedOnGpu) {
+			//Callers of AcquireNextFrame need an RGB texture, so the planes are converted at their native size.
+			if (!m_UploadTexture) {
+				RETURN_ON_BAD_HR(hr = m_TextureManager->CreateTexture(m_FrameSize.cx, m_FrameSize.cy, &m_UploadTexture, 0, D3D11_BIND_RENDER_TARGET | D3D11_BIND_SHADER_RESOURCE));
+				m_AllocatedTextureCount++;
+			}
+			RETURN_ON_BAD_HR(hr = m_TextureManager->DrawYuvTexture(m_UploadTexture, m_LumaTexture, m_ChromaTexture, m_YuvFormat.value(), m_YuvMatrix, RECT{ 0, 0, m_FrameSize.cx, m_FrameSize.cy }));
+		}
+		//The texture is updated in place on the next call, so callers must be done with it by then.
+		*ppFrame = m_UploadTexture;
+		(*ppFrame)->AddRef();
+	}
+	return hr;
+}
+
+HRESULT SourceReaderBase::UploadNextFrame(_In_ DWORD timeoutMillis, _In_ bool isUploadRequested)
+{
+	if (m_FrameQueue) {
+		return UploadNextQueuedFrame(timeoutMillis, isUploadRequested);
+	}
 	DWORD result = WAIT_OBJECT_0;
 
 	if (m_LastGrabTimeStamp.QuadPart >= m_LastSampleReceivedTimeStamp.QuadPart) {
@@ -112,44 +207,22 @@ HRESULT SourceReaderBase::AcquireNextFrame(_In_ DWORD timeoutMillis, _Outptr_opt
 	}
 	HRESULT hr = S_OK;
 	if (result == WAIT_OBJECT_0) {
-		//Only create frame if the caller accepts one.
-		if (ppFrame) {
+		//Only upload the frame if the caller accepts one.
+		if (isUploadRequested) {
 			EnterCriticalSection(&m_CriticalSection);
-			LeaveCriticalSectionOnExit leaveCriticalSection(&m_CriticalSection, L"GetFrameBuffer");
-
-
-			DWORD len;
-			BYTE *data;
-			hr = m_Sample->Lock(&data, NULL, &len);
-			ExecuteFuncOnExit releaseSampleLock([&]() {
-				m_Sample->Unlock();
-			});
-			if (FAILED(hr))
-			{
-				delete[] m_PtrFrameBuffer;
-				m_PtrFrameBuffer = nullptr;
-				return hr;
+			CComPtr<IMFMediaBuffer> pBuffer = m_LatestBuffer;
+			//Keep the source reader callback from converting the next frame into this buffer while it is uploaded
+			m_UploadingBuffer = pBuffer;
+			LeaveCriticalSection(&m_CriticalSection);
+			if (!pBuffer) {
+				return DXGI_ERROR_WAIT_TIMEOUT;
 			}
+			hr = UploadFrame(pBuffer);
+			EnterCriticalSection(&m_CriticalSection);
+			m_UploadingBuffer.Release();
+			LeaveCriticalSection(&m_CriticalSection);
 			if (SUCCEEDED(hr)) {
-				hr = ResizeFrameBuffer(len);
-				int bytesPerPixel = abs(m_Stride) / m_FrameSize.cx;
-				//Copy the bitmap buffer, with handling of negative stride. https://docs.microsoft.com/en-us/windows/win32/medfound/image-stride
-				hr = MFCopyImage(
-					m_PtrFrameBuffer,       // Destination buffer.
-					abs(m_Stride),                    // Destination stride. We use the absolute value to flip bitmaps with negative stride. 
-					m_Stride > 0 ? data : data + (m_FrameSize.cy - 1) * abs(m_Stride), // First row in source image with positive stride, or the last row with negative stride.
-					m_Stride,						  // Source stride.
-					bytesPerPixel * m_FrameSize.cx,	      // Image width in bytes.
-					m_FrameSize.cy						  // Image height in pixels.
-				);
-
-				CComPtr<ID3D11Texture2D> pTexture;
-				hr = m_TextureManager->CreateTextureFromBuffer(m_PtrFrameBuffer, m_Stride, m_FrameSize.cx, m_FrameSize.cy, &pTexture, 0, D3D11_BIND_SHADER_RESOURCE);
-				if (SUCCEEDED(hr)) {
-					*ppFrame = pTexture;
-					(*ppFrame)->AddRef();
-					QueryPerformanceCounter(&m_LastGrabTimeStamp);
-				}
+				QueryPerformanceCounter(&m_LastGrabTimeStamp);
 			}
 		}
 	}
@@ -164,6 +237,175 @@ HRESULT SourceReaderBase::AcquireNextFrame(_In_ DWORD timeoutMillis, _Outptr_opt
 	return hr;
 }
 
+HRESULT SourceReaderBase::UploadNextQueuedFrame(_In_ DWORD timeoutMillis, _In_ bool isUploadRequested)
+{
+	ULONGLONG waitEnd = GetTickCount64() + timeoutMillis;
+	CComPtr<IMFMediaBuffer> pBuffer;
+	bool isReadResumed = false;
+	while (true) {
+		EnterCriticalSection(&m_CriticalSection);
+		LONGLONG clockTime = GetPresentationClockTime();
+		LONGLONG timeUntilNextFrame = m_FrameQueue->GetTimeUntilNextFrame(clockTime);
+		if (timeUntilNextFrame == 0 && isUploadRequested) {
+			m_FrameQueue->TryAcquire(clockTime, &pBuffer);
+			//Keep the source reader callback from converting the next frame into this buffer while it is uploaded
+			m_UploadingBuffer = pBuffer;
+			isReadResumed = m_IsReadPaused;
+			m_IsReadPaused = false;
+		}
+		LeaveCriticalSection(&m_CriticalSection);
+		if (timeUntilNextFrame == 0) {
+			break;
+		}
+		ULONGLONG now = GetTickCount64();
+		if (now >= waitEnd) {
+			return DXGI_ERROR_WAIT_TIMEOUT;
+		}
+		DWORD waitMillis = static_cast<DWORD>(waitEnd - now);
+		if (timeUntilNextFrame > 0) {
+			waitMillis = min(waitMillis, static_cast<DWORD>((timeUntilNextFrame + 9999) / 10000));
+		}
+		if (m_IsVirtualClock) {
+			waitMillis = min(waitMillis, static_cast<DWORD>(SOURCE_READER_VIRTUAL_CLOCK_POLL_MILLIS));
+		}
+		//Wake up when the next frame is due, or when a frame is added to the queue
+		if (WaitForSingleObject(m_NewFrameEvent, waitMillis) == WAIT_FAILED) {
+			DWORD dwErr = GetLastError();
+			LOG_ERROR(L"WaitForSingleObject failed: last error = %u", dwErr);
+			return HRESULT_FROM_WIN32(dwErr);
+		}
+	}
+	if (isReadResumed && m_SourceReader) {
+		//A frame was taken from the full queue, so the reader can decode the next one
+		LOG_ON_BAD_HR(m_SourceReader->ReadSample(m_StreamIndex, 0, NULL, NULL, NULL, NULL));
+	}
+	if (!isUploadRequested) {
+		return S_OK;
+	}
+	HRESULT hr = UploadFrame(pBuffer);
+	EnterCriticalSection(&m_CriticalSection);
+	m_UploadingBuffer.Release();
+	LeaveCriticalSection(&m_CriticalSection);
+	if (SUCCEEDED(hr)) {
+		QueryPerformanceCounter(&m_LastGrabTimeStamp);
+	}
+	return hr;
+}
+
+LONGLONG SourceReaderBase::GetPresentationClockTime()
+{
+	if (m_Clock) {
+		return m_Clock->GetTime();
+	}
+	LARGE_INTEGER counter;
+	QueryPerformanceCounter(&counter);
+	//Split the conversion to 100 nanosecond units to avoid overflow
+	return (counter.QuadPart / m_QPCFrequency.QuadPart) * 10000000 + (counter.QuadPart % m_QPCFrequency.QuadPart) * 10000000 / m_QPCFrequency.QuadPart;
+}
+
+std::optional<DECODED_FRAME_QUEUE_STATISTICS> SourceReaderBase::GetFrameQueueStatistics()
+{
+	EnterCriticalSection(&m_CriticalSection);
+	LeaveCriticalSectionOnExit leaveCriticalSection(&m_CriticalSection, L"GetFrameQueueStatistics");
+	if (!m_FrameQueue) {
+		return std::nullopt;
+	}
+	return m_FrameQueue->GetStatistics();
+}
+
+HRESULT SourceReaderBase::UploadFrame(_In_ IMFMediaBuffer *pBuffer)
+{
+	HRESULT hr;
+	DWORD len;
+	BYTE *data;
+	RETURN_ON_BAD_HR(hr = pBuffer->Lock(&data, NULL, &len));
+	ExecuteFuncOnExit releaseBufferLock([&]() {
+		pBuffer->Unlock();
+	});
+	int bytesPerPixel = abs(m_Stride) / m_FrameSize.cx;
+	const BYTE *pFrameData = data;
+	LONG pitch = abs(m_Stride);
+	if (m_YuvFormat.has_value()) {
+		if (len < GetYuvFrameBufferSize(m_YuvFormat.value(), m_Stride, m_FrameSize.cy)) {
+			LOG_ERROR(L"Frame buffer of %u bytes is too small for a %ldx%ld frame", len, m_FrameSize.cx, m_FrameSize.cy);
+			return E_FAIL;
+		}
+		if (m_IsYuvConvertedOnGpu) {
+			return UploadYuvPlanes(data);
+		}
+		//The device cannot sample the planes, so the frame is converted with the CPU kernels
+		pitch = m_FrameSize.cx * 4;
+		RETURN_ON_BAD_HR(hr = ResizeFrameBuffer(pitch * m_FrameSize.cy));
+		ConvertYuvFrameToBGRA(m_YuvFormat.value(), data, abs(m_Stride), m_FrameSize.cx, m_FrameSize.cy, m_YuvMatrix, m_PtrFrameBuffer, pitch);
+		pFrameData = m_PtrFrameBuffer;
+	}
+	else if (len < static_cast<DWORD>(abs(m_Stride) * (m_FrameSize.cy - 1) + bytesPerPixel * m_FrameSize.cx)) {
+		LOG_ERROR(L"Frame buffer of %u bytes is too small for a %ldx%ld frame", len, m_FrameSize.cx, m_FrameSize.cy);
+		return E_FAIL;
+	}
+	else if (m_Stride < 0) {
+		RETURN_ON_BAD_HR(hr = ResizeFrameBuffer(len));
+		//Copy the bitmap buffer to flip bitmaps with negative stride. https://docs.microsoft.com/en-us/windows/win32/medfound/image-stride
+		RETURN_ON_BAD_HR(hr = MFCopyImage(
+			m_PtrFrameBuffer,       // Destination buffer.
+			abs(m_Stride),                    // Destination stride. We use the absolute value to flip bitmaps with negative stride. 
+			data + (m_FrameSize.cy - 1) * abs(m_Stride), // The last row in source image with negative stride.
+			m_Stride,						  // Source stride.
+			bytesPerPixel * m_FrameSize.cx,	      // Image width in bytes.
+			m_FrameSize.cy						  // Image height in pixels.
+		));
+		pFrameData = m_PtrFrameBuffer;
+	}
+
+	if (m_UploadTexture) {
+		D3D11_TEXTURE2D_DESC desc;
+		m_UploadTexture->GetDesc(&desc);
+		if (desc.Width != static_cast<UINT>(m_FrameSize.cx) || desc.Height != static_cast<UINT>(m_FrameSize.cy)) {
+			m_UploadTexture.Release();
+		}
+	}
+	if (!m_UploadTexture) {
+		RETURN_ON_BAD_HR(hr = m_TextureManager->CreateTextureFromBuffer(pFrameData, pitch, m_FrameSize.cx, m_FrameSize.cy, &m_UploadTexture, 0, D3D11_BIND_SHADER_RESOURCE));
+		m_AllocatedTextureCount++;
+	}
+	else {
+		m_DeviceContext->UpdateSubresource(m_UploadTexture, 0, nullptr, pFrameData, pitch, 0);
+	}
+	return hr;
+}
+
+HRESULT SourceReaderBase::UploadYuvPlanes(_In_ const BYTE *pFrameData)
+{
+	HRESULT hr = S_OK;
+	if (!m_LumaTexture) {
+		RETURN_ON_BAD_HR(hr = m_TextureManager->CreateYuvPlaneTextures(m_YuvFormat.value(), m_FrameSize.cx, m_FrameSize.cy, &m_LumaTexture, &m_ChromaTexture));
+		m_AllocatedTextureCount += 2;
+	}
+	UINT pitch = abs(m_Stride);
+	m_DeviceContext->UpdateSubresource(m_LumaTexture, 0, nullptr, pFrameData, pitch, 0);
+	if (m_YuvFormat.value() == YuvPixelFormat::NV12) {
+		//The UV plane follows the Y plane
+		m_DeviceContext->UpdateSubresource(m_ChromaTexture, 0, nullptr, pFrameData + static_cast<size_t>(pitch) * m_FrameSize.cy, pitch, 0);
+	}
+	else {
+		//The packed samples are read as Y from one texture, and as U and V from the other
+		m_DeviceContext->UpdateSubresource(m_ChromaTexture, 0, nullptr, pFrameData, pitch, 0);
+	}
+	return hr;
+}
+
+bool SourceReaderBase::IsYuvFrameDrawnDirectly()
+{
+	if (!m_YuvFormat.has_value() || !m_IsYuvConvertedOnGpu) {
+		return false;
+	}
+	RECORDING_SOURCE *recordingSource = dynamic_cast<RECORDING_SOURCE *>(m_RecordingSource);
+	if (recordingSource && recordingSource->SourceRect.has_value() && IsValidRect(recordingSource->SourceRect.value())) {
+		return false;
+	}
+	return !m_RecordingSource->IsVideoFramePreviewEnabled.value_or(false);
+}
+
 HRESULT SourceReaderBase::ResizeFrameBuffer(UINT bufferSize) {
 	// Old buffer too small
 	if (bufferSize > m_BufferSize)
@@ -211,6 +453,20 @@ HRESULT SourceReaderBase::WriteNextFrameToSharedSurface(_In_ DWORD timeoutMillis
 {
 	CComPtr<ID3D11Texture2D> pProcessedTexture;
 	HRESULT hr = E_FAIL;
+	if (!pTexture && IsYuvFrameDrawnDirectly()) {
+		//Convert, resize and draw the planes in one pass, without an intermediate RGB texture
+		RETURN_ON_BAD_HR(hr = UploadNextFrame(timeoutMillis, true));
+		SIZE contentSize = m_FrameSize;
+		if (RectWidth(destinationRect) != m_FrameSize.cx || RectHeight(destinationRect) != m_FrameSize.cy) {
+			contentSize = TextureManager::GetResizedSize(m_FrameSize, SIZE{ RectWidth(destinationRect),RectHeight(destinationRect) }, m_RecordingSource->Stretch);
+		}
+		SIZE contentOffset = GetContentOffset(m_RecordingSource->Anchor, destinationRect, RECT{ 0,0,contentSize.cx,contentSize.cy });
+		long left = destinationRect.left + offsetX + contentOffset.cx;
+		long top = destinationRect.top + offsetY + contentOffset.cy;
+		long right = left + MakeEven(contentSize.cx);
+		long bottom = top + MakeEven(contentSize.cy);
+		return m_TextureManager->DrawYuvTexture(pSharedSurf, m_LumaTexture, m_ChromaTexture, m_YuvFormat.value(), m_YuvMatrix, RECT{ left,top,right,bottom });
+	}
 	if (pTexture) {
 		pProcessedTexture = pTexture;
 		hr = S_OK;
@@ -308,6 +564,20 @@ HRESULT SourceReaderBase::CreateIMFTransform(_In_ DWORD streamIndex, _In_ IMFMed
 	CComPtr<IMFMediaType> pOutputMediaType = nullptr;
 	HRESULT hr;
 
+	GUID inputSubtype;
+	RETURN_ON_BAD_HR(hr = pInputMediaType->GetGUID(MF_MT_SUBTYPE, &inputSubtype));
+	if (GetYuvPixelFormat(inputSubtype).has_value()
+		&& MFGetAttributeUINT32(pInputMediaType, MF_MT_INTERLACE_MODE, MFVideoInterlace_Progressive) == MFVideoInterlace_Progressive) {
+		//Progressive NV12 and YUY2 frames are uploaded as they are and converted to RGB when drawn, so they need no media transform.
+		RETURN_ON_BAD_HR(hr = MFCreateMediaType(&pOutputMediaType));
+		RETURN_ON_BAD_HR(hr = pInputMediaType->CopyAllItems(pOutputMediaType));
+		if (ppOutputMediaType) {
+			*ppOutputMediaType = pOutputMediaType;
+			(*ppOutputMediaType)->AddRef();
+		}
+		return hr;
+	}
+
 	UINT32 width;
 	UINT32 height;
 	//Get width and height
@@ -352,6 +622,37 @@ HRESULT SourceReaderBase::CreateIMFTransform(_In_ DWORD streamIndex, _In_ IMFMed
 	return hr;
 }
 
+HRESULT SourceReaderBase::GetPooledOutputSample(_In_ DWORD size, _In_ DWORD alignment, _Outptr_ IMFSample **ppSample)
+{
+	*ppSample = nullptr;
+	HRESULT hr;
+	EnterCriticalSection(&m_CriticalSection);
+	LeaveCriticalSectionOnExit leaveCriticalSection(&m_CriticalSection, L"GetPooledOutputSample");
+	if (size != m_OutputSampleSize) {
+		//Samples still held as the newest or uploading frame stay valid until they are released.
+		m_OutputSamplePool.clear();
+		m_OutputSampleSize = size;
+	}
+	for each (const OUTPUT_SAMPLE & pooledSample in m_OutputSamplePool)
+	{
+		if (pooledSample.Buffer != m_LatestBuffer && pooledSample.Buffer != m_UploadingBuffer
+			&& !(m_FrameQueue && m_FrameQueue->Contains(pooledSample.Buffer))) {
+			*ppSample = pooledSample.Sample;
+			(*ppSample)->AddRef();
+			return S_OK;
+		}
+	}
+	OUTPUT_SAMPLE outputSample;
+	RETURN_ON_BAD_HR(hr = MFCreateAlignedMemoryBuffer(size, alignment > 0 ? alignment - 1 : 0, &outputSample.Buffer));
+	RETURN_ON_BAD_HR(hr = MFCreateSample(&outputSample.Sample));
+	RETURN_ON_BAD_HR(hr = outputSample.Sample->AddBuffer(outputSample.Buffer));
+	m_OutputSamplePool.push_back(outputSample);
+	m_AllocatedSampleCount++;
+	*ppSample = outputSample.Sample;
+	(*ppSample)->AddRef();
+	return hr;
+}
+
 //Method from IMFSourceReaderCallback
 HRESULT SourceReaderBase::OnReadSample(HRESULT status, DWORD streamIndex, DWORD streamFlags, LONGLONG timeStamp, IMFSample *sample)
 {
@@ -365,70 +666,91 @@ HRESULT SourceReaderBase::OnReadSample(HRESULT status, DWORD streamIndex, DWORD
 		}
 		if (sample)
 		{
-			EnterCriticalSection(&m_CriticalSection);
-			{
-				LeaveCriticalSectionOnExit leaveCriticalSection(&m_CriticalSection, L"OnReadSample");
-				if (m_MediaTransform) {
-					//Run media transform to convert sample to MFVideoFormat_ARGB32
-					MFT_OUTPUT_STREAM_INFO info{};
-					hr = m_MediaTransform->GetOutputStreamInfo(0, &info);
+			CComPtr<IMFMediaBuffer> pFrameBuffer;
+			if (m_MediaTransform) {
+				//Run media transform to convert sample to MFVideoFormat_ARGB32
+				MFT_OUTPUT_STREAM_INFO info{};
+				hr = m_MediaTransform->GetOutputStreamInfo(0, &info);
+				if (FAILED(hr)) {
+					LOG_ERROR(L"GetOutputStreamInfo failed: hr = 0x%08x", hr);
+				}
+				bool transformProvidesSamples = info.dwFlags & (MFT_OUTPUT_STREAM_PROVIDES_SAMPLES | MFT_OUTPUT_STREAM_CAN_PROVIDE_SAMPLES);
+				MFT_OUTPUT_DATA_BUFFER outputDataBuffer;
+				RtlZeroMemory(&outputDataBuffer, sizeof(outputDataBuffer));
+				outputDataBuffer.dwStreamID = 0;
+				CComPtr<IMFSample> pOutputSample;
+				if (!transformProvidesSamples) {
+					hr = GetPooledOutputSample(info.cbSize, info.cbAlignment, &pOutputSample);
 					if (FAILED(hr)) {
-						LOG_ERROR(L"GetOutputStreamInfo failed: hr = 0x%08x", hr);
+						LOG_ERROR(L"Failed to get output sample: hr = 0x%08x", hr);
 					}
-					bool transformProvidesSamples = info.dwFlags & (MFT_OUTPUT_STREAM_PROVIDES_SAMPLES | MFT_OUTPUT_STREAM_CAN_PROVIDE_SAMPLES);
-					MFT_OUTPUT_DATA_BUFFER outputDataBuffer;
-					RtlZeroMemory(&outputDataBuffer, sizeof(outputDataBuffer));
-					outputDataBuffer.dwStreamID = 0;
-					if (!transformProvidesSamples) {
-						IMFMediaBuffer *transformBuffer = nullptr;
-						//create a buffer for the output sample
-						hr = MFCreateMemoryBuffer(info.cbSize, &transformBuffer);
-						if (FAILED(hr))
-						{
-							LOG_ERROR(L"MFCreateMemoryBuffer failed: hr = 0x%08x", hr);
-						}
-						IMFSample *transformSample;
-						hr = MFCreateSample(&transformSample);
-						if (FAILED(hr)) {
-							LOG_ERROR(L"MFCreateSample failed: hr = 0x%08x", hr);
-						}
-						hr = transformSample->AddBuffer(transformBuffer);
-
-						outputDataBuffer.pSample = transformSample;
-						SafeRelease(&transformBuffer);
+					outputDataBuffer.pSample = pOutputSample;
+				}
+				hr = m_MediaTransform->ProcessInput(0, sample, 0);
+				if (FAILED(hr)) {
+					LOG_ERROR(L"ProcessInput failed: hr = 0x%08x", hr);
+				}
+				DWORD dwDSPStatus = 0;
+				hr = m_MediaTransform->ProcessOutput(0, 1, &outputDataBuffer, &dwDSPStatus);
+				if (FAILED(hr)) {
+					LOG_ERROR(L"ProcessOutput failed: hr = 0x%08x", hr);
+				}
+				if (outputDataBuffer.pSample) {
+					if (SUCCEEDED(hr)) {
+						outputDataBuffer.pSample->GetBufferByIndex(0, &pFrameBuffer);
 					}
-					hr = m_MediaTransform->ProcessInput(0, sample, 0);
-					if (FAILED(hr)) {
-						LOG_ERROR(L"ProcessInput failed: hr = 0x%08x", hr);
+					if (transformProvidesSamples) {
+						//Samples provided by the transform are released by the caller
+						outputDataBuffer.pSample->Release();
 					}
-					DWORD dwDSPStatus = 0;
-					hr = m_MediaTransform->ProcessOutput(0, 1, &outputDataBuffer, &dwDSPStatus);
-					if (FAILED(hr)) {
-						LOG_ERROR(L"ProcessOutput failed: hr = 0x%08x", hr);
+				}
+				SafeRelease(&outputDataBuffer.pEvents);
+			}
+			else {
+				//The buffers of the source reader can be decoder surfaces, so the frame is copied to a pooled sample instead of holding on to them
+				DWORD totalLength = 0;
+				CComPtr<IMFSample> pCopySample;
+				hr = sample->GetTotalLength(&totalLength);
+				if (SUCCEEDED(hr)) {
+					hr = GetPooledOutputSample(totalLength, SOURCE_READER_COPY_ALIGNMENT, &pCopySample);
+				}
+				if (SUCCEEDED(hr)) {
+					hr = pCopySample->GetBufferByIndex(0, &pFrameBuffer);
+				}
+				if (SUCCEEDED(hr)) {
+					hr = sample->CopyToBuffer(pFrameBuffer);
+				}
+				if (FAILED(hr)) {
+					LOG_ERROR(L"Failed to copy sample: hr = 0x%08x", hr);
+					pFrameBuffer.Release();
+				}
+			}
+			if (pFrameBuffer) {
+				//Only the newest buffer is swapped under the lock, so the callback never waits for a frame to be uploaded.
+				EnterCriticalSection(&m_CriticalSection);
+				if (m_FrameQueue) {
+					LONGLONG duration = 0;
+					if (FAILED(sample->GetSampleDuration(&duration)) || duration <= 0) {
+						duration = m_FrameRate > 0 ? static_cast<LONGLONG>(10000000 / m_FrameRate) : 0;
 					}
-					SafeRelease(&m_Sample);
-					//Store the converted media buffer
-					IMFMediaBuffer *mediaBuffer = NULL;
-					outputDataBuffer.pSample->GetBufferByIndex(0, &mediaBuffer);
-					outputDataBuffer.pSample->Release();
-					m_Sample = mediaBuffer;
+					m_FrameQueue->TryPush(pFrameBuffer, timeStamp, duration);
 				}
 				else {
-					IMFMediaBuffer *mediaBuffer = NULL;
-					sample->GetBufferByIndex(0, &mediaBuffer);
-					sample->Release();
-					m_Sample = mediaBuffer;
+					m_LatestBuffer = pFrameBuffer;
 				}
+				m_ReceivedFrameCount++;
 				//Update timestamp and notify that there is a new sample available
 				QueryPerformanceCounter(&m_LastSampleReceivedTimeStamp);
+				LeaveCriticalSection(&m_CriticalSection);
 				SetEvent(m_NewFrameEvent);
 			}
-			if (SUCCEEDED(hr)) {
-				if (!m_FramerateTimer) {
-					m_FramerateTimer = new HighresTimer();
-					m_FramerateTimer->StartRecurringTimer((INT64)floor(1000 / m_FrameRate));
-				}
+			//Queued frames are presented by their time stamps, so only sources without a queue are paced by the timer
+			if (SUCCEEDED(hr) && !m_FrameQueue) {
 				if (m_FrameRate > 0) {
+					if (!m_FramerateTimer) {
+						m_FramerateTimer = new HighresTimer();
+						m_FramerateTimer->StartPreciseTimer(static_cast<INT64>(10000000 / m_FrameRate));
+					}
 					auto t1 = std::chrono::high_resolution_clock::now();
 					auto sleepTime = m_FramerateTimer->GetMillisUntilNextTick();
 					MeasureExecutionTime measureNextTick(L"OnReadSample scheduled delay");
@@ -442,6 +764,16 @@ HRESULT SourceReaderBase::OnReadSample(HRESULT status, DWORD streamIndex, DWORD
 				}
 			}
 		}
+		if (m_FrameQueue) {
+			EnterCriticalSection(&m_CriticalSection);
+			//The next sample is requested when a frame is taken from the queue
+			m_IsReadPaused = m_FrameQueue->IsFull();
+			bool isReadPaused = m_IsReadPaused;
+			LeaveCriticalSection(&m_CriticalSection);
+			if (isReadPaused) {
+				return hr;
+			}
+		}
 		// Request the next frame.
 		if (m_SourceReader && (SUCCEEDED(hr))) {
 			hr = m_SourceReader->ReadSample(streamIndex, 0, NULL, NULL, NULL, NULL);
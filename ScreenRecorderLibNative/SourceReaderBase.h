@@ -12,7 +12,15 @@
 #include "LogMediaType.h"
 #include "CaptureBase.h"
 #include "TextureManager.h"
+#include "YuvConversion.h"
+#include "DecodedFrameQueue.h"
 #include "MF.util.h"
+#include "MediaClock.h"
+
+//Alignment in bytes of the pooled samples YUV frames are copied to, when they are not converted by a media transform.
+#define SOURCE_READER_COPY_ALIGNMENT 16
+//Longest wait in milliseconds for a queued frame to be due on a virtual clock, which can advance faster than real time.
+#define SOURCE_READER_VIRTUAL_CLOCK_POLL_MILLIS 1
 
 class SourceReaderBase abstract : public CaptureBase, public IMFSourceReaderCallback  //this class inherits from IMFSourceReaderCallback
 {
@@ -28,6 +36,10 @@ public:
 	inline virtual HRESULT GetMouse(_Inout_ PTR_INFO *pPtrInfo, _In_ RECT frameCoordinates, _In_ int offsetX, _In_ int offsetY) override {
 		return S_FALSE;
 	}
+	/// <summary>
+	/// Returns the depth and the late and dropped frame counts of the decoded frame queue, or nothing if frames are not queued.
+	/// </summary>
+	std::optional<DECODED_FRAME_QUEUE_STATISTICS> GetFrameQueueStatistics();
 
 	//  the class must implement the methods from IMFSourceReaderCallback 
 	STDMETHODIMP OnReadSample(HRESULT status, DWORD streamIndex, DWORD streamFlags, LONGLONG timeStamp, IMFSample *sample);
@@ -61,14 +73,82 @@ protected:
 	virtual HRESULT CreateOutputMediaType(_In_ SIZE frameSize, _Outptr_ IMFMediaType **pType, _Out_ LONG *stride);
 	virtual HRESULT CreateIMFTransform(_In_ DWORD streamIndex, _In_ IMFMediaType *pInputMediaType, _Outptr_ IMFTransform **pColorConverter, _Outptr_ IMFMediaType **ppOutputMediaType);
 	virtual HRESULT SourceReaderBase::ResizeFrameBuffer(UINT bufferSize);
+	/// <summary>
+	/// Number of decoded frames read ahead of playback and presented by their time stamps.
+	/// Sources that return 0, like cameras, always present the newest frame.
+	/// </summary>
+	virtual inline UINT GetLookaheadFrameCount() { return 0; }
 	CRITICAL_SECTION m_CriticalSection;
 	inline IMFDXGIDeviceManager *GetDeviceManager() { return m_DeviceManager; }
 private:
+	/// <summary>
+	/// Returns a sample in system memory from the pool for a frame to be written to, allocating one only if all pooled samples are in use.
+	/// </summary>
+	HRESULT GetPooledOutputSample(_In_ DWORD size, _In_ DWORD alignment, _Outptr_ IMFSample **ppSample);
+	/// <summary>
+	/// Waits for a new frame, and uploads it if requested.
+	/// </summary>
+	HRESULT UploadNextFrame(_In_ DWORD timeoutMillis, _In_ bool isUploadRequested);
+	/// <summary>
+	/// Waits for a queued frame to be due, and uploads it if requested. Reading is resumed if it was paused because the queue was full.
+	/// </summary>
+	HRESULT UploadNextQueuedFrame(_In_ DWORD timeoutMillis, _In_ bool isUploadRequested);
+	/// <summary>
+	/// Returns the time of the clock queued frames are presented by, in 100 nanosecond units. This is the clock of the recording,
+	/// so video sources stay in sync with the rest of the recording on a virtual clock, or the performance counter if the source has no clock.
+	/// </summary>
+	LONGLONG GetPresentationClockTime();
+	/// <summary>
+	/// Copies a frame to the upload texture, or to the YUV plane textures if YUV frames are converted on the GPU.
+	/// </summary>
+	HRESULT UploadFrame(_In_ IMFMediaBuffer *pBuffer);
+	HRESULT UploadYuvPlanes(_In_ const BYTE *pFrameData);
+	/// <summary>
+	/// Returns true if the YUV planes can be converted, resized and drawn to the destination in one pass.
+	/// Cropping and frame callbacks need the frame as an RGB texture first.
+	/// </summary>
+	bool IsYuvFrameDrawnDirectly();
+
+	struct OUTPUT_SAMPLE {
+		CComPtr<IMFSample> Sample;
+		CComPtr<IMFMediaBuffer> Buffer;
+	};
 	long m_ReferenceCount;
 	HANDLE m_NewFrameEvent;
 	HANDLE m_StopCaptureEvent;
 	LARGE_INTEGER m_LastSampleReceivedTimeStamp;
-	IMFMediaBuffer *m_Sample;
+	// Samples the media transform writes converted frames to, or YUV frames without a transform are copied to, so the buffers
+	// of the source reader are released right away. The pool holds the newest frame, the frame being uploaded
+	// and the frame being converted, and the queued frames of sources that read ahead.
+	std::vector<OUTPUT_SAMPLE> m_OutputSamplePool;
+	// Size of the pooled samples
+	DWORD m_OutputSampleSize;
+	// The newest frame, handed from the source reader callback to AcquireNextFrame
+	CComPtr<IMFMediaBuffer> m_LatestBuffer;
+	// Frames decoded ahead of playback, for sources with a lookahead frame count. Replaces m_LatestBuffer for those sources.
+	std::unique_ptr<DecodedFrameQueue<CComPtr<IMFMediaBuffer>>> m_FrameQueue;
+	// True when the queue was full after the last sample, so the next sample is requested once a frame is taken from the queue
+	bool m_IsReadPaused;
+	DWORD m_StreamIndex;
+	LARGE_INTEGER m_QPCFrequency;
+	// Clock of the recording queued frames are presented by, or null to present them by the performance counter
+	std::shared_ptr<MediaClock> m_Clock;
+	bool m_IsVirtualClock;
+	// The frame AcquireNextFrame is uploading, which must not be written to until the upload is done
+	CComPtr<IMFMediaBuffer> m_UploadingBuffer;
+	// Texture returned by AcquireNextFrame, updated in place with each new frame
+	CComPtr<ID3D11Texture2D> m_UploadTexture;
+	// Set if NV12 or YUY2 frames are delivered without a media transform, to be converted to RGB when they are drawn
+	std::optional<YuvPixelFormat> m_YuvFormat;
+	YUV_TO_RGB_MATRIX m_YuvMatrix;
+	// True if YUV frames are uploaded as planes and converted by the pixel shader, false if they are converted on the CPU
+	bool m_IsYuvConvertedOnGpu;
+	// Planes of the newest YUV frame, when YUV frames are converted on the GPU
+	CComPtr<ID3D11Texture2D> m_LumaTexture;
+	CComPtr<ID3D11Texture2D> m_ChromaTexture;
+	UINT m_AllocatedSampleCount;
+	UINT m_AllocatedTextureCount;
+	INT64 m_ReceivedFrameCount;
 	HighresTimer *m_FramerateTimer;
 	IMFMediaType *m_OutputMediaType;
 	IMFMediaType *m_InputMediaType;
@@ -0,0 +1,302 @@
+#include "TestPattern.h"
+#include <cmath>
+#include <cstdio>
+
+//Side of the squares that change in the DirtyRects mode
+#define TEST_PATTERN_CHANGED_RECT_SIZE 64
+//Pixels the bars move each frame
+#define TEST_PATTERN_BAR_SPEED 4
+//Size of the generated pointer
+#define TEST_PATTERN_POINTER_SIZE 32
+
+static const UINT BarColors[] = {
+	0xFFBFBFBF, //white
+	0xFFBFBF00, //yellow
+	0xFF00BFBF, //cyan
+	0xFF00BF00, //green
+	0xFFBF00BF, //magenta
+	0xFFBF0000, //red
+	0xFF0000BF, //blue
+	0xFF000000  //black
+};
+
+static const char *TextLines[] = {
+	"THE QUICK BROWN FOX JUMPS OVER THE LAZY DOG",
+	"PACK MY BOX WITH FIVE DOZEN LIQUOR JUGS",
+	"SPHINX OF BLACK QUARTZ JUDGE MY VOW",
+	"HOW VEXINGLY QUICK DAFT ZEBRAS JUMP"
+};
+
+//5x7 glyphs for the digits and capital letters, one row per byte with the leftmost pixel in bit 4.
+static const BYTE DigitGlyphs[10][7] = {
+	{ 0x0E,0x11,0x13,0x15,0x19,0x11,0x0E },
+	{ 0x04,0x0C,0x04,0x04,0x04,0x04,0x0E },
+	{ 0x0E,0x11,0x01,0x02,0x04,0x08,0x1F },
+	{ 0x1F,0x02,0x04,0x02,0x01,0x11,0x0E },
+	{ 0x02,0x06,0x0A,0x12,0x1F,0x02,0x02 },
+	{ 0x1F,0x10,0x1E,0x01,0x01,0x11,0x0E },
+	{ 0x06,0x08,0x10,0x1E,0x11,0x11,0x0E },
+	{ 0x1F,0x01,0x02,0x04,0x08,0x08,0x08 },
+	{ 0x0E,0x11,0x11,0x0E,0x11,0x11,0x0E },
+	{ 0x0E,0x11,0x11,0x0F,0x01,0x02,0x0C }
+};
+static const BYTE LetterGlyphs[26][7] = {
+	{ 0x0E,0x11,0x11,0x1F,0x11,0x11,0x11 },
+	{ 0x1E,0x11,0x11,0x1E,0x11,0x11,0x1E },
+	{ 0x0E,0x11,0x10,0x10,0x10,0x11,0x0E },
+	{ 0x1C,0x12,0x11,0x11,0x11,0x12,0x1C },
+	{ 0x1F,0x10,0x10,0x1E,0x10,0x10,0x1F },
+	{ 0x1F,0x10,0x10,0x1E,0x10,0x10,0x10 },
+	{ 0x0E,0x11,0x10,0x17,0x11,0x11,0x0F },
+	{ 0x11,0x11,0x11,0x1F,0x11,0x11,0x11 },
+	{ 0x0E,0x04,0x04,0x04,0x04,0x04,0x0E },
+	{ 0x07,0x02,0x02,0x02,0x02,0x12,0x0C },
+	{ 0x11,0x12,0x14,0x18,0x14,0x12,0x11 },
+	{ 0x10,0x10,0x10,0x10,0x10,0x10,0x1F },
+	{ 0x11,0x1B,0x15,0x15,0x11,0x11,0x11 },
+	{ 0x11,0x11,0x19,0x15,0x13,0x11,0x11 },
+	{ 0x0E,0x11,0x11,0x11,0x11,0x11,0x0E },
+	{ 0x1E,0x11,0x11,0x1E,0x10,0x10,0x10 },
+	{ 0x0E,0x11,0x11,0x11,0x15,0x12,0x0D },
+	{ 0x1E,0x11,0x11,0x1E,0x14,0x12,0x11 },
+	{ 0x0F,0x10,0x10,0x0E,0x01,0x01,0x1E },
+	{ 0x1F,0x04,0x04,0x04,0x04,0x04,0x04 },
+	{ 0x11,0x11,0x11,0x11,0x11,0x11,0x0E },
+	{ 0x11,0x11,0x11,0x11,0x11,0x0A,0x04 },
+	{ 0x11,0x11,0x11,0x15,0x15,0x15,0x0A },
+	{ 0x11,0x11,0x0A,0x04,0x0A,0x11,0x11 },
+	{ 0x11,0x11,0x11,0x0A,0x04,0x04,0x04 },
+	{ 0x1F,0x01,0x02,0x04,0x08,0x10,0x1F }
+};
+
+static const BYTE *GetGlyph(_In_ char c)
+{
+	if (c >= '0' && c <= '9') {
+		return DigitGlyphs[c - '0'];
+	}
+	if (c >= 'A' && c <= 'Z') {
+		return LetterGlyphs[c - 'A'];
+	}
+	return nullptr;
+}
+
+/// <summary>
+/// Scrambles the bits of the value, to derive independent random values from the seed and frame index.
+/// </summary>
+static UINT64 MixBits(_In_ UINT64 value)
+{
+	value += 0x9E3779B97F4A7C15ULL;
+	value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	value = (value ^ (value >> 27)) * 0x94D049BB133111EBULL;
+	return value ^ (value >> 31);
+}
+
+TestPatternGenerator::TestPatternGenerator(_In_ const TEST_PATTERN_OPTIONS &options) :
+	m_Options(options),
+	m_Size{ MakeEven(max(16L, options.Size.cx)), MakeEven(max(16L, options.Size.cy)) },
+	m_Pixels{},
+	m_HasFrame(false),
+	m_LastFrameIndex(0)
+{
+	m_Options.FrameRate = max(1u, m_Options.FrameRate);
+	m_Pixels.resize(static_cast<size_t>(m_Size.cx) * m_Size.cy);
+}
+
+void TestPatternGenerator::RenderFrame(_In_ UINT64 frameIndex, _Out_ std::vector<RECT> *pDirtyRects)
+{
+	pDirtyRects->clear();
+	if (m_HasFrame && frameIndex == m_LastFrameIndex) {
+		return;
+	}
+	switch (m_Options.Mode)
+	{
+		case TestPatternMode::ScrollingText:
+			RenderScrollingText(frameIndex);
+			break;
+		case TestPatternMode::Noise:
+			RenderNoise(frameIndex);
+			break;
+		case TestPatternMode::DirtyRects: {
+			if (!m_HasFrame) {
+				RenderBackground();
+			}
+			else {
+				//The rectangles of the previous frame are restored, so the frame stays the same for any order of indexes
+				for each (RECT rect in GetChangedRects(m_LastFrameIndex)) {
+					RestoreBackground(rect);
+					pDirtyRects->push_back(rect);
+				}
+			}
+			std::vector<RECT> changedRects = GetChangedRects(frameIndex);
+			for (UINT32 i = 0; i < changedRects.size(); i++) {
+				FillRect(changedRects[i], GetChangedRectColor(frameIndex, i));
+				pDirtyRects->push_back(changedRects[i]);
+			}
+			break;
+		}
+		case TestPatternMode::MovingBars:
+		default:
+			RenderMovingBars(frameIndex);
+			break;
+	}
+	if (!m_HasFrame || m_Options.Mode != TestPatternMode::DirtyRects) {
+		pDirtyRects->clear();
+		pDirtyRects->push_back(RECT{ 0, 0, m_Size.cx, m_Size.cy });
+	}
+	m_HasFrame = true;
+	m_LastFrameIndex = frameIndex;
+}
+
+POINT TestPatternGenerator::GetPointerPosition(_In_ UINT64 frameIndex) const
+{
+	//The pointer follows a Lissajous curve over the frame, which repeats every 15 seconds
+	const double pi = 3.14159265358979323846;
+	double seconds = static_cast<double>(frameIndex % (15ULL * m_Options.FrameRate)) / m_Options.FrameRate;
+	double halfWidth = max(0L, m_Size.cx / 2 - TEST_PATTERN_POINTER_SIZE);
+	double halfHeight = max(0L, m_Size.cy / 2 - TEST_PATTERN_POINTER_SIZE);
+	return POINT{
+		static_cast<LONG>(m_Size.cx / 2 + halfWidth * sin(2 * pi * seconds / 5)),
+		static_cast<LONG>(m_Size.cy / 2 + halfHeight * sin(2 * pi * seconds / 3)) };
+}
+
+std::vector<UINT> TestPatternGenerator::CreatePointerShape(_Out_ SIZE *pSize)
+{
+	const LONG size = TEST_PATTERN_POINTER_SIZE;
+	std::vector<UINT> shape(static_cast<size_t>(size) * size, 0x00000000);
+	const LONG arrowHeight = size * 3 / 4;
+	for (LONG y = 0; y < arrowHeight; y++) {
+		LONG arrowWidth = y * 2 / 3;
+		for (LONG x = 0; x <= arrowWidth; x++) {
+			bool isOutline = x == 0 || x == arrowWidth || y == arrowHeight - 1;
+			shape[static_cast<size_t>(y) * size + x] = isOutline ? 0xFF000000 : 0xFFFFFFFF;
+		}
+	}
+	*pSize = SIZE{ size, size };
+	return shape;
+}
+
+void TestPatternGenerator::RenderMovingBars(_In_ UINT64 frameIndex)
+{
+	//The bars are vertical, so one row is rendered and copied to the rest of the frame
+	const LONG width = m_Size.cx;
+	const LONG barWidth = max(1L, width / static_cast<LONG>(ARRAYSIZE(BarColors)));
+	const LONG shift = static_cast<LONG>((frameIndex * TEST_PATTERN_BAR_SPEED) % width);
+	UINT *pRow = m_Pixels.data();
+	for (LONG x = 0; x < width; x++) {
+		LONG bar = ((x + width - shift) % width) / barWidth;
+		pRow[x] = BarColors[min(bar, static_cast<LONG>(ARRAYSIZE(BarColors)) - 1)];
+	}
+	for (LONG y = 1; y < m_Size.cy; y++) {
+		memcpy(pRow + static_cast<size_t>(y) * width, pRow, width * sizeof(UINT));
+	}
+}
+
+void TestPatternGenerator::RenderScrollingText(_In_ UINT64 frameIndex)
+{
+	const UINT backgroundColor = 0xFF101820;
+	const UINT textColor = 0xFFE0E0E0;
+	//Glyphs are scaled up with the frame height, and each line scrolls by one glyph pixel per frame
+	const LONG scale = max(1L, m_Size.cy / 360);
+	const LONG cellWidth = 6 * scale;
+	const LONG cellHeight = 9 * scale;
+	const UINT64 scrollOffset = frameIndex * scale;
+	char text[128] = {};
+	UINT64 textLine = MAXUINT64;
+	size_t textLength = 0;
+	for (LONG y = 0; y < m_Size.cy; y++) {
+		UINT *pRow = m_Pixels.data() + static_cast<size_t>(y) * m_Size.cx;
+		UINT64 row = y + scrollOffset;
+		UINT64 line = row / cellHeight;
+		LONG glyphRow = static_cast<LONG>(row % cellHeight) / scale;
+		if (glyphRow >= 7) {
+			for (LONG x = 0; x < m_Size.cx; x++) {
+				pRow[x] = backgroundColor;
+			}
+			continue;
+		}
+		if (line != textLine) {
+			const char *pLineText = TextLines[(line + m_Options.Seed) % ARRAYSIZE(TextLines)];
+			int length = snprintf(text, sizeof(text), "%06llu %s", static_cast<unsigned long long>(line), pLineText);
+			textLength = length > 0 ? min(static_cast<size_t>(length), sizeof(text) - 1) : 0;
+			textLine = line;
+		}
+		for (LONG x = 0; x < m_Size.cx; x++) {
+			size_t column = static_cast<size_t>(x / cellWidth);
+			LONG glyphColumn = (x % cellWidth) / scale;
+			const BYTE *pGlyph = column < textLength && glyphColumn < 5 ? GetGlyph(text[column]) : nullptr;
+			bool isSet = pGlyph && (pGlyph[glyphRow] & (0x10 >> glyphColumn));
+			pRow[x] = isSet ? textColor : backgroundColor;
+		}
+	}
+}
+
+void TestPatternGenerator::RenderNoise(_In_ UINT64 frameIndex)
+{
+	UINT64 state = MixBits(MixBits(m_Options.Seed) ^ frameIndex) | 1;
+	size_t count = m_Pixels.size();
+	for (size_t i = 0; i + 1 < count; i += 2) {
+		//xorshift64, which gives two opaque pixels per step
+		state ^= state << 13;
+		state ^= state >> 7;
+		state ^= state << 17;
+		m_Pixels[i] = static_cast<UINT>(state) | 0xFF000000;
+		m_Pixels[i + 1] = static_cast<UINT>(state >> 32) | 0xFF000000;
+	}
+}
+
+void TestPatternGenerator::RenderBackground()
+{
+	for (LONG y = 0; y < m_Size.cy; y++) {
+		UINT *pRow = m_Pixels.data() + static_cast<size_t>(y) * m_Size.cx;
+		for (LONG x = 0; x < m_Size.cx; x++) {
+			pRow[x] = GetBackgroundColor(x, y);
+		}
+	}
+}
+
+void TestPatternGenerator::FillRect(_In_ RECT rect, _In_ UINT color)
+{
+	for (LONG y = rect.top; y < rect.bottom; y++) {
+		UINT *pRow = m_Pixels.data() + static_cast<size_t>(y) * m_Size.cx;
+		for (LONG x = rect.left; x < rect.right; x++) {
+			pRow[x] = color;
+		}
+	}
+}
+
+void TestPatternGenerator::RestoreBackground(_In_ RECT rect)
+{
+	for (LONG y = rect.top; y < rect.bottom; y++) {
+		UINT *pRow = m_Pixels.data() + static_cast<size_t>(y) * m_Size.cx;
+		for (LONG x = rect.left; x < rect.right; x++) {
+			pRow[x] = GetBackgroundColor(x, y);
+		}
+	}
+}
+
+std::vector<RECT> TestPatternGenerator::GetChangedRects(_In_ UINT64 frameIndex) const
+{
+	std::vector<RECT> rects;
+	const LONG width = min(static_cast<LONG>(TEST_PATTERN_CHANGED_RECT_SIZE), m_Size.cx);
+	const LONG height = min(static_cast<LONG>(TEST_PATTERN_CHANGED_RECT_SIZE), m_Size.cy);
+	UINT64 frameSeed = MixBits(MixBits(m_Options.Seed) ^ frameIndex);
+	for (UINT32 i = 0; i < m_Options.DirtyRectCount; i++) {
+		UINT64 random = MixBits(frameSeed + i);
+		LONG left = static_cast<LONG>((random & 0xFFFFFFFF) % (m_Size.cx - width + 1));
+		LONG top = static_cast<LONG>((random >> 32) % (m_Size.cy - height + 1));
+		rects.push_back(RECT{ left, top, left + width, top + height });
+	}
+	return rects;
+}
+
+UINT TestPatternGenerator::GetChangedRectColor(_In_ UINT64 frameIndex, _In_ UINT32 rectIndex) const
+{
+	return static_cast<UINT>(MixBits(MixBits(m_Options.Seed + rectIndex) ^ frameIndex)) | 0xFF000000;
+}
+
+UINT TestPatternGenerator::GetBackgroundColor(_In_ LONG x, _In_ LONG y) const
+{
+	//A checkerboard with the same cell size as the changed rectangles
+	bool isDark = ((x / TEST_PATTERN_CHANGED_RECT_SIZE) + (y / TEST_PATTERN_CHANGED_RECT_SIZE)) % 2 == 0;
+	return isDark ? 0xFF303030 : 0xFF404040;
+}
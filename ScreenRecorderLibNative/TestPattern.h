@@ -0,0 +1,48 @@
+#pragma once
+#include "CommonTypes.h"
+
+//
+// Renders the frames of test pattern recording sources into a 32bpp BGRA buffer on the CPU.
+// A frame only depends on the options and its index, so recordings with the same options get the same content,
+// which makes the load on the capture, composition and encoding stages repeatable without a desktop to record.
+//
+class TestPatternGenerator
+{
+public:
+	TestPatternGenerator(_In_ const TEST_PATTERN_OPTIONS &options);
+	/// <summary>
+	/// Renders the frame with the given index over the previously rendered frame.
+	/// </summary>
+	/// <param name="pDirtyRects">Receives the areas that differ from the previously rendered frame</param>
+	void RenderFrame(_In_ UINT64 frameIndex, _Out_ std::vector<RECT> *pDirtyRects);
+	inline const std::vector<UINT> &GetPixels() const { return m_Pixels; }
+	inline LONG GetStride() const { return m_Size.cx * 4; }
+	inline SIZE GetSize() const { return m_Size; }
+	/// <summary>
+	/// Returns the position of the generated pointer on the frame with the given index, relative to the frame.
+	/// </summary>
+	POINT GetPointerPosition(_In_ UINT64 frameIndex) const;
+	/// <summary>
+	/// Returns the BGRA pixels of the generated pointer, an opaque arrow on a transparent background.
+	/// </summary>
+	static std::vector<UINT> CreatePointerShape(_Out_ SIZE *pSize);
+private:
+	void RenderMovingBars(_In_ UINT64 frameIndex);
+	void RenderScrollingText(_In_ UINT64 frameIndex);
+	void RenderNoise(_In_ UINT64 frameIndex);
+	void RenderBackground();
+	void FillRect(_In_ RECT rect, _In_ UINT color);
+	void RestoreBackground(_In_ RECT rect);
+	/// <summary>
+	/// Returns the rectangles that change on the frame with the given index in the DirtyRects mode.
+	/// </summary>
+	std::vector<RECT> GetChangedRects(_In_ UINT64 frameIndex) const;
+	UINT GetChangedRectColor(_In_ UINT64 frameIndex, _In_ UINT32 rectIndex) const;
+	UINT GetBackgroundColor(_In_ LONG x, _In_ LONG y) const;
+
+	TEST_PATTERN_OPTIONS m_Options;
+	SIZE m_Size;
+	std::vector<UINT> m_Pixels;
+	bool m_HasFrame;
+	UINT64 m_LastFrameIndex;
+};
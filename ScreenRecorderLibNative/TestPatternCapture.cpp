@@ -0,0 +1,243 @@
+#include "TestPatternCapture.h"
+#include "util.h"
+#include "cleanup.h"
+
+using namespace std;
+
+//Real time between checks of a virtual clock for the next frame, in 100 nanosecond units
+#define VIRTUAL_CLOCK_POLL_INTERVAL 10000LL
+
+TestPatternCapture::TestPatternCapture() :
+	m_Generator(nullptr),
+	m_Timer(nullptr),
+	m_Texture(nullptr),
+	m_Clock(nullptr),
+	m_IsVirtualClock(false),
+	m_StartTime(0),
+	m_FrameRate(1),
+	m_HasFrame(false),
+	m_FrameIndex(0),
+	m_IsPointerShapeSent(false)
+{
+}
+
+TestPatternCapture::~TestPatternCapture()
+{
+	if (m_Timer) {
+		m_Timer->StopTimer(true);
+	}
+	SafeRelease(&m_Device);
+	SafeRelease(&m_DeviceContext);
+}
+
+HRESULT TestPatternCapture::Initialize(_In_ ID3D11DeviceContext *pDeviceContext, _In_ ID3D11Device *pDevice)
+{
+	m_Device = pDevice;
+	m_DeviceContext = pDeviceContext;
+
+	m_Device->AddRef();
+	m_DeviceContext->AddRef();
+
+	m_TextureManager = make_unique<TextureManager>();
+	return m_TextureManager->Initialize(pDeviceContext, pDevice);
+}
+
+HRESULT TestPatternCapture::StartCapture(_In_ RECORDING_SOURCE_BASE &source)
+{
+	m_RecordingSource = &source;
+	m_Generator = make_unique<TestPatternGenerator>(source.TestPattern);
+	m_Timer = make_unique<HighresTimer>();
+	m_FrameRate = max(1u, source.TestPattern.FrameRate);
+	m_HasFrame = false;
+	m_FrameIndex = 0;
+	m_IsPointerShapeSent = false;
+	m_Texture.Release();
+	SIZE size = m_Generator->GetSize();
+	HRESULT hr;
+	RETURN_ON_BAD_HR(hr = m_TextureManager->CreateTexture(size.cx, size.cy, &m_Texture, 0, D3D11_BIND_SHADER_RESOURCE));
+	m_Clock = source.Clock;
+	if (!m_Clock) {
+		m_Clock = make_shared<SystemMediaClock>();
+		m_Clock->Start();
+	}
+	m_IsVirtualClock = std::dynamic_pointer_cast<VirtualMediaClock>(m_Clock) != nullptr;
+	m_StartTime = m_Clock->GetTime();
+	LOG_INFO(L"Started test pattern capture of %dx%d at %u fps", size.cx, size.cy, m_FrameRate);
+	return hr;
+}
+
+HRESULT TestPatternCapture::GetNativeSize(_In_ RECORDING_SOURCE_BASE &recordingSource, _Out_ SIZE *nativeMediaSize)
+{
+	if (m_Generator) {
+		*nativeMediaSize = m_Generator->GetSize();
+	}
+	else {
+		//The generator rounds the configured size the same way
+		*nativeMediaSize = SIZE{ MakeEven(max(16L, recordingSource.TestPattern.Size.cx)), MakeEven(max(16L, recordingSource.TestPattern.Size.cy)) };
+	}
+	return S_OK;
+}
+
+HRESULT TestPatternCapture::AcquireNextFrame(_In_ DWORD timeoutMillis, _Outptr_opt_result_maybenull_ ID3D11Texture2D **ppFrame)
+{
+	if (ppFrame) {
+		*ppFrame = nullptr;
+	}
+	if (!m_Generator) {
+		LOG_ERROR("TestPatternCapture must be started before acquiring frames");
+		return E_FAIL;
+	}
+	UINT64 frameIndex = static_cast<UINT64>(GetElapsed100Nanos()) * m_FrameRate / 10000000;
+	if (m_HasFrame && frameIndex <= m_FrameIndex) {
+		//Wait for the next frame if it is due within the timeout
+		frameIndex = m_FrameIndex + 1;
+		INT64 waitTime = GetFrameTime100Nanos(frameIndex) - GetElapsed100Nanos();
+		if (m_IsVirtualClock) {
+			if (waitTime > 0) {
+				RETURN_ON_BAD_HR(m_Timer->WaitFor(min(waitTime, VIRTUAL_CLOCK_POLL_INTERVAL)));
+			}
+			if (GetFrameTime100Nanos(frameIndex) > GetElapsed100Nanos()) {
+				return DXGI_ERROR_WAIT_TIMEOUT;
+			}
+			frameIndex = max(frameIndex, static_cast<UINT64>(GetElapsed100Nanos()) * m_FrameRate / 10000000);
+		}
+		else {
+			if (waitTime > static_cast<INT64>(timeoutMillis) * 10000) {
+				return DXGI_ERROR_WAIT_TIMEOUT;
+			}
+			if (waitTime > 0) {
+				RETURN_ON_BAD_HR(m_Timer->WaitFor(waitTime));
+			}
+		}
+	}
+	HRESULT hr;
+	RETURN_ON_BAD_HR(hr = UploadFrame(frameIndex));
+	QueryPerformanceCounter(&m_LastGrabTimeStamp);
+	if (ppFrame) {
+		*ppFrame = m_Texture;
+		(*ppFrame)->AddRef();
+	}
+	return hr;
+}
+
+HRESULT TestPatternCapture::WriteNextFrameToSharedSurface(_In_ DWORD timeoutMillis, _Inout_ ID3D11Texture2D *pSharedSurf, INT offsetX, INT offsetY, _In_ RECT destinationRect, _In_opt_ ID3D11Texture2D *pTexture)
+{
+	if (!m_RecordingSource) {
+		LOG_ERROR("No recording source found in TestPatternCapture");
+		return E_FAIL;
+	}
+	CComPtr<ID3D11Texture2D> pProcessedTexture;
+	HRESULT hr = E_FAIL;
+	if (pTexture) {
+		pProcessedTexture = pTexture;
+		hr = S_OK;
+	}
+	else if (m_HasFrame) {
+		//The capture loop acquires the frame before writing it, so the last uploaded frame is the one to write.
+		pProcessedTexture = m_Texture;
+		hr = S_OK;
+	}
+	else {
+		hr = AcquireNextFrame(timeoutMillis, &pProcessedTexture);
+		RETURN_ON_BAD_HR(hr);
+	}
+	D3D11_TEXTURE2D_DESC frameDesc;
+	pProcessedTexture->GetDesc(&frameDesc);
+	RECORDING_SOURCE *recordingSource = dynamic_cast<RECORDING_SOURCE *>(m_RecordingSource);
+	if (recordingSource && recordingSource->SourceRect.has_value()
+		&& IsValidRect(recordingSource->SourceRect.value())
+		&& (RectWidth(recordingSource->SourceRect.value()) != frameDesc.Width || (RectHeight(recordingSource->SourceRect.value()) != frameDesc.Height))) {
+		ID3D11Texture2D *pCroppedTexture;
+		RETURN_ON_BAD_HR(hr = m_TextureManager->CropTexture(pProcessedTexture, recordingSource->SourceRect.value(), &pCroppedTexture));
+		if (hr == S_OK) {
+			pProcessedTexture.Release();
+			pProcessedTexture.Attach(pCroppedTexture);
+		}
+	}
+	pProcessedTexture->GetDesc(&frameDesc);
+
+	RECT contentRect = destinationRect;
+	if (RectWidth(destinationRect) != frameDesc.Width || RectHeight(destinationRect) != frameDesc.Height) {
+		ID3D11Texture2D *pResizedTexture;
+		RETURN_ON_BAD_HR(hr = m_TextureManager->ResizeTexture(pProcessedTexture, SIZE{ RectWidth(destinationRect),RectHeight(destinationRect) }, m_RecordingSource->Stretch, &pResizedTexture, &contentRect));
+		pProcessedTexture.Release();
+		pProcessedTexture.Attach(pResizedTexture);
+	}
+	pProcessedTexture->GetDesc(&frameDesc);
+
+	SIZE contentOffset = GetContentOffset(m_RecordingSource->Anchor, destinationRect, contentRect);
+	long left = destinationRect.left + offsetX + contentOffset.cx;
+	long top = destinationRect.top + offsetY + contentOffset.cy;
+	long right = left + MakeEven(frameDesc.Width);
+	long bottom = top + MakeEven(frameDesc.Height);
+	m_TextureManager->DrawTexture(pSharedSurf, pProcessedTexture, RECT{ left,top,right,bottom });
+	SendBitmapCallback(pProcessedTexture);
+	return hr;
+}
+
+HRESULT TestPatternCapture::GetMouse(_Inout_ PTR_INFO *pPtrInfo, _In_ RECT frameCoordinates, _In_ int offsetX, _In_ int offsetY)
+{
+	pPtrInfo->IsPointerShapeUpdated = false;
+	if (!m_Generator || !m_HasFrame || !m_RecordingSource->TestPattern.IsPointerEnabled) {
+		return S_FALSE;
+	}
+	POINT position = m_Generator->GetPointerPosition(m_FrameIndex);
+	pPtrInfo->Position.x = position.x + frameCoordinates.left + offsetX;
+	pPtrInfo->Position.y = position.y + frameCoordinates.top + offsetY;
+	pPtrInfo->WhoUpdatedPositionLast = frameCoordinates;
+	pPtrInfo->LastTimeStamp = m_LastGrabTimeStamp;
+	pPtrInfo->Visible = true;
+	if (m_IsPointerShapeSent && pPtrInfo->PtrShapeBuffer) {
+		return S_OK;
+	}
+	//The shape never changes, so it is only written once, as a color pointer in the same layout Desktop Duplication uses.
+	SIZE shapeSize;
+	std::vector<UINT> shape = TestPatternGenerator::CreatePointerShape(&shapeSize);
+	UINT bufferSize = static_cast<UINT>(shape.size() * sizeof(UINT));
+	if (bufferSize > pPtrInfo->BufferSize) {
+		delete[] pPtrInfo->PtrShapeBuffer;
+		pPtrInfo->PtrShapeBuffer = new (std::nothrow) BYTE[bufferSize];
+		if (!pPtrInfo->PtrShapeBuffer) {
+			pPtrInfo->BufferSize = 0;
+			LOG_ERROR(L"Failed to allocate memory for pointer shape in TestPatternCapture");
+			return E_OUTOFMEMORY;
+		}
+		pPtrInfo->BufferSize = bufferSize;
+	}
+	memcpy(pPtrInfo->PtrShapeBuffer, shape.data(), bufferSize);
+	pPtrInfo->ShapeInfo.Type = DXGI_OUTDUPL_POINTER_SHAPE_TYPE_COLOR;
+	pPtrInfo->ShapeInfo.Width = shapeSize.cx;
+	pPtrInfo->ShapeInfo.Height = shapeSize.cy;
+	pPtrInfo->ShapeInfo.Pitch = shapeSize.cx * 4;
+	pPtrInfo->ShapeInfo.HotSpot = POINT{ 0, 0 };
+	pPtrInfo->IsPointerShapeUpdated = true;
+	pPtrInfo->ShapeUpdateCount++;
+	m_IsPointerShapeSent = true;
+	return S_OK;
+}
+
+HRESULT TestPatternCapture::UploadFrame(_In_ UINT64 frameIndex)
+{
+	std::vector<RECT> dirtyRects;
+	m_Generator->RenderFrame(frameIndex, &dirtyRects);
+	const BYTE *pPixels = reinterpret_cast<const BYTE *>(m_Generator->GetPixels().data());
+	LONG stride = m_Generator->GetStride();
+	for each (RECT rect in dirtyRects) {
+		D3D11_BOX box{ static_cast<UINT>(rect.left), static_cast<UINT>(rect.top), 0, static_cast<UINT>(rect.right), static_cast<UINT>(rect.bottom), 1 };
+		const BYTE *pSource = pPixels + static_cast<size_t>(rect.top) * stride + static_cast<size_t>(rect.left) * 4;
+		m_DeviceContext->UpdateSubresource(m_Texture, 0, &box, pSource, stride, 0);
+	}
+	m_HasFrame = true;
+	m_FrameIndex = frameIndex;
+	return S_OK;
+}
+
+INT64 TestPatternCapture::GetElapsed100Nanos()
+{
+	return max(0, m_Clock->GetTime() - m_StartTime);
+}
+
+INT64 TestPatternCapture::GetFrameTime100Nanos(_In_ UINT64 frameIndex)
+{
+	return static_cast<INT64>(frameIndex / m_FrameRate * 10000000 + frameIndex % m_FrameRate * 10000000 / m_FrameRate);
+}
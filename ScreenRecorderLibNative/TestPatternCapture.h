@@ -0,0 +1,47 @@
+#pragma once
+#include "CaptureBase.h"
+#include "CommonTypes.h"
+#include "HighresTimer.h"
+#include "TestPattern.h"
+#include "MediaClock.h"
+#include <atlbase.h>
+
+//
+// Captures generated test pattern frames at the configured frame rate, for load and soak tests that do not depend on
+// the desktop, a camera or media files. The frame index follows the time since the capture started, so slow consumers skip frames
+// the same way they would with a live source. The time is taken from the clock of the recording, so a recording on a virtual clock
+// gets its frames in virtual time. Only the changed areas of the frame are uploaded to the texture.
+//
+class TestPatternCapture :public CaptureBase
+{
+public:
+	TestPatternCapture();
+	~TestPatternCapture();
+	virtual HRESULT Initialize(_In_ ID3D11DeviceContext *pDeviceContext, _In_ ID3D11Device *pDevice) override;
+	virtual HRESULT StartCapture(_In_ RECORDING_SOURCE_BASE &source) override;
+	virtual HRESULT GetNativeSize(_In_ RECORDING_SOURCE_BASE &recordingSource, _Out_ SIZE *nativeMediaSize) override;
+	virtual HRESULT AcquireNextFrame(_In_ DWORD timeoutMillis, _Outptr_opt_result_maybenull_ ID3D11Texture2D **ppFrame) override;
+	virtual HRESULT WriteNextFrameToSharedSurface(_In_ DWORD timeoutMillis, _Inout_ ID3D11Texture2D *pSharedSurf, INT offsetX, INT offsetY, _In_ RECT destinationRect, _In_opt_ ID3D11Texture2D *pTexture = nullptr) override;
+	virtual HRESULT GetMouse(_Inout_ PTR_INFO *pPtrInfo, _In_ RECT frameCoordinates, _In_ int offsetX, _In_ int offsetY) override;
+	virtual inline std::wstring Name() override { return L"TestPatternCapture"; };
+private:
+	/// <summary>
+	/// Renders the frame and uploads the areas that changed since the previous frame.
+	/// </summary>
+	HRESULT UploadFrame(_In_ UINT64 frameIndex);
+	INT64 GetElapsed100Nanos();
+	INT64 GetFrameTime100Nanos(_In_ UINT64 frameIndex);
+
+	std::unique_ptr<TestPatternGenerator> m_Generator;
+	std::unique_ptr<HighresTimer> m_Timer;
+	CComPtr<ID3D11Texture2D> m_Texture;
+	//The clock of the recording, or a clock started with the capture when the source is captured outside of a recording
+	std::shared_ptr<MediaClock> m_Clock;
+	//Virtual time only advances when the recorder renders a frame, so it is polled instead of waited for
+	bool m_IsVirtualClock;
+	INT64 m_StartTime;
+	UINT32 m_FrameRate;
+	bool m_HasFrame;
+	UINT64 m_FrameIndex;
+	bool m_IsPointerShapeSent;
+};
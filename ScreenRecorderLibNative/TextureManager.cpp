@@ -3,17 +3,33 @@
 #include "util.h"
 #include <atlbase.h>
 #include "cleanup.h"
+#include "YuvPixelShader.h"
+#include "TexturePool.h"
 
 using namespace DirectX;
 
+//
+// Constant buffer of the YUV pixel shader.
+//
+struct YUV_SHADER_CONSTANTS {
+	YUV_TO_RGB_MATRIX Matrix;
+	// The first value is 1 if U and V are in the green and alpha channels of the chroma texture, as for YUY2 frames.
+	float ChromaLayout[4];
+};
+
 TextureManager::TextureManager() :
 	m_Device(nullptr),
 	m_DeviceContext(nullptr),
 	m_SamplerLinear(nullptr),
 	m_BlendState(nullptr),
+	m_LayerBlendState(nullptr),
+	m_PremultipliedBlendState(nullptr),
 	m_VertexShader(nullptr),
 	m_PixelShader(nullptr),
-	m_InputLayout(nullptr)
+	m_YuvPixelShader(nullptr),
+	m_YuvConstantBuffer(nullptr),
+	m_InputLayout(nullptr),
+	m_BlankTexture(nullptr)
 {
 }
 
@@ -59,32 +75,43 @@ HRESULT TextureManager::Initialize(_In_ ID3D11DeviceContext *pDeviceContext, _In
 	hr = m_Device->CreateBlendState(&BlendStateDesc, &m_BlendState);
 	RETURN_ON_BAD_HR(hr);
 
+	// Layers keep premultiplied color and accumulate coverage, so they can be blended onto the canvas in a single pass later.
+	BlendStateDesc.RenderTarget[0].DestBlendAlpha = D3D11_BLEND_INV_SRC_ALPHA;
+	hr = m_Device->CreateBlendState(&BlendStateDesc, &m_LayerBlendState);
+	RETURN_ON_BAD_HR(hr);
+
+	BlendStateDesc.RenderTarget[0].SrcBlend = D3D11_BLEND_ONE;
+	hr = m_Device->CreateBlendState(&BlendStateDesc, &m_PremultipliedBlendState);
+	RETURN_ON_BAD_HR(hr);
+
 	// Initialize shaders
 	hr = InitShaders(pDevice, &m_PixelShader, &m_VertexShader, &m_InputLayout);
 	RETURN_ON_BAD_HR(hr);
 
+	// The YUV shader is optional. Without it, YUV frames are converted to RGB on the CPU before they are uploaded.
+	if (SUCCEEDED(m_Device->CreatePixelShader(g_YuvPS, ARRAYSIZE(g_YuvPS), nullptr, &m_YuvPixelShader))) {
+		D3D11_BUFFER_DESC constantBufferDesc;
+		RtlZeroMemory(&constantBufferDesc, sizeof(constantBufferDesc));
+		constantBufferDesc.Usage = D3D11_USAGE_DEFAULT;
+		constantBufferDesc.ByteWidth = sizeof(YUV_SHADER_CONSTANTS);
+		constantBufferDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+		LOG_ON_BAD_HR(m_Device->CreateBuffer(&constantBufferDesc, nullptr, &m_YuvConstantBuffer));
+	}
+	else {
+		LOG_WARN(L"Failed to create YUV pixel shader, YUV frames will be converted on the CPU");
+	}
 	return hr;
 }
 
-HRESULT TextureManager::ResizeTexture(_In_ ID3D11Texture2D *pOrgTexture, _In_  SIZE targetSize, _In_ TextureStretchMode stretch, _Outptr_ ID3D11Texture2D **ppResizedTexture, _Out_opt_ RECT *pContentRect)
+SIZE TextureManager::GetResizedSize(_In_ SIZE originalSize, _In_ SIZE targetSize, _In_ TextureStretchMode stretch)
 {
-	HRESULT hr;
-
-	// Create shader resource from texture of the original frame
-	D3D11_TEXTURE2D_DESC frameDesc = {};
-	pOrgTexture->GetDesc(&frameDesc);
 	UINT targetWidth = targetSize.cx;
 	UINT targetHeight = targetSize.cy;
-	UINT originalWidth = frameDesc.Width;
-	UINT originalHeight = frameDesc.Height;
-	// Calculate aspect ratios
-	double originalAspect = static_cast<double>(originalWidth) / originalHeight;
-	double targetAspect = static_cast<double>(targetWidth) / targetHeight;
+	UINT originalWidth = originalSize.cx;
+	UINT originalHeight = originalSize.cy;
 
 	double widthRatio = static_cast<double>(targetWidth) / originalWidth;
 	double heightRatio = static_cast<double>(targetHeight) / originalHeight;
-	UINT widthDiff = originalWidth - targetWidth;
-	UINT heightDiff = originalHeight - targetHeight;
 	LONG resizedWidth = 0;
 	LONG resizedHeight = 0;
 	switch (stretch)
@@ -112,6 +139,19 @@ HRESULT TextureManager::ResizeTexture(_In_ ID3D11Texture2D *pOrgTexture, _In_  S
 			resizedHeight = MakeEven((LONG)round(originalHeight));
 			break;
 	}
+	return SIZE{ resizedWidth, resizedHeight };
+}
+
+HRESULT TextureManager::ResizeTexture(_In_ ID3D11Texture2D *pOrgTexture, _In_  SIZE targetSize, _In_ TextureStretchMode stretch, _Outptr_ ID3D11Texture2D **ppResizedTexture, _Out_opt_ RECT *pContentRect)
+{
+	HRESULT hr;
+
+	// Create shader resource from texture of the original frame
+	D3D11_TEXTURE2D_DESC frameDesc = {};
+	pOrgTexture->GetDesc(&frameDesc);
+	SIZE resizedSize = GetResizedSize(SIZE{ static_cast<LONG>(frameDesc.Width), static_cast<LONG>(frameDesc.Height) }, targetSize, stretch);
+	LONG resizedWidth = resizedSize.cx;
+	LONG resizedHeight = resizedSize.cy;
 	if (pContentRect) {
 		*pContentRect = RECT{ 0,0,resizedWidth,resizedHeight };
 	}
@@ -132,9 +172,8 @@ HRESULT TextureManager::ResizeTexture(_In_ ID3D11Texture2D *pOrgTexture, _In_  S
 	D3D11_TEXTURE2D_DESC targetDesc;
 	InitializeDesc(resizedWidth, resizedHeight, &targetDesc);
 	ID3D11Texture2D *pResizedFrame = nullptr;
-	RETURN_ON_BAD_HR(GetOrCreateTexture(targetDesc, &pResizedFrame));
+	RETURN_ON_BAD_HR(TexturePool::Shared().Acquire(m_Device, targetDesc, &pResizedFrame));
 	*ppResizedTexture = pResizedFrame;
-	(*ppResizedTexture)->AddRef();
 	// Save current view port so we can restore later
 	D3D11_VIEWPORT VP;
 	UINT numViewports = 1;
@@ -250,9 +289,8 @@ HRESULT TextureManager::RotateTexture(_In_ ID3D11Texture2D *pOrgTexture, _In_ DX
 	ID3D11Texture2D *pRotatedFrame = nullptr;
 	D3D11_TEXTURE2D_DESC targetDesc;
 	InitializeDesc(rotatedWidth, rotatedHeight, &targetDesc);
-	RETURN_ON_BAD_HR(GetOrCreateTexture(targetDesc, &pRotatedFrame));
+	RETURN_ON_BAD_HR(TexturePool::Shared().Acquire(m_Device, targetDesc, &pRotatedFrame));
 	*ppRotatedTexture = pRotatedFrame;
-	(*ppRotatedTexture)->AddRef();
 
 	// Save current view port so we can restore later
 	D3D11_VIEWPORT VP;
@@ -337,7 +375,7 @@ HRESULT TextureManager::RotateTexture(_In_ ID3D11Texture2D *pOrgTexture, _In_ DX
 	return hr;
 }
 
-HRESULT TextureManager::DrawTexture(_Inout_ ID3D11Texture2D *pCanvasTexture, _In_ ID3D11Texture2D *pTexture, _In_ RECT rect)
+HRESULT TextureManager::DrawTexture(_Inout_ ID3D11Texture2D *pCanvasTexture, _In_ ID3D11Texture2D *pTexture, _In_ RECT rect, _In_ TextureBlendMode blendMode)
 {
 	HRESULT hr = S_FALSE;
 	D3D11_TEXTURE2D_DESC desktopDesc = {};
@@ -413,7 +451,14 @@ HRESULT TextureManager::DrawTexture(_Inout_ ID3D11Texture2D *pCanvasTexture, _In
 	UINT Stride = sizeof(VERTEX);
 	UINT Offset = 0;
 	m_DeviceContext->IASetVertexBuffers(0, 1, &VertexBuffer, &Stride, &Offset);
-	m_DeviceContext->OMSetBlendState(m_BlendState, BlendFactor, 0xFFFFFFFF);
+	ID3D11BlendState *pBlendState = m_BlendState;
+	if (blendMode == TextureBlendMode::AccumulateLayer) {
+		pBlendState = m_LayerBlendState;
+	}
+	else if (blendMode == TextureBlendMode::PremultipliedAlphaBlend) {
+		pBlendState = m_PremultipliedBlendState;
+	}
+	m_DeviceContext->OMSetBlendState(pBlendState, BlendFactor, 0xFFFFFFFF);
 	m_DeviceContext->OMSetRenderTargets(1, &RTV, nullptr);
 	m_DeviceContext->VSSetShader(m_VertexShader, nullptr, 0);
 	m_DeviceContext->PSSetShader(m_PixelShader, nullptr, 0);
@@ -441,6 +486,160 @@ HRESULT TextureManager::DrawTexture(_Inout_ ID3D11Texture2D *pCanvasTexture, _In
 	return hr;
 }
 
+HRESULT TextureManager::DrawYuvTexture(_Inout_ ID3D11Texture2D *pCanvasTexture, _In_ ID3D11Texture2D *pLumaTexture, _In_ ID3D11Texture2D *pChromaTexture, _In_ YuvPixelFormat format, _In_ const YUV_TO_RGB_MATRIX &matrix, _In_ RECT rect)
+{
+	if (!m_YuvPixelShader || !m_YuvConstantBuffer) {
+		return E_NOT_VALID_STATE;
+	}
+	HRESULT hr;
+	// Save current view port so we can restore later
+	D3D11_VIEWPORT VP;
+	UINT numViewports = 1;
+	m_DeviceContext->RSGetViewports(&numViewports, &VP);
+
+	// Set view port
+	SetViewPort(m_DeviceContext, static_cast<float>(RectWidth(rect)), static_cast<float>(RectHeight(rect)), static_cast<float>(rect.left), static_cast<float>(rect.top));
+
+	VERTEX Vertices[] =
+	{
+		{ XMFLOAT3(-1.0f, -1.0f, 0), XMFLOAT2(0.0f, 1.0f) },
+		{ XMFLOAT3(-1.0f, 1.0f, 0), XMFLOAT2(0.0f, 0.0f) },
+		{ XMFLOAT3(1.0f, -1.0f, 0), XMFLOAT2(1.0f, 1.0f) },
+		{ XMFLOAT3(1.0f, -1.0f, 0), XMFLOAT2(1.0f, 1.0f) },
+		{ XMFLOAT3(-1.0f, 1.0f, 0), XMFLOAT2(0.0f, 0.0f) },
+		{ XMFLOAT3(1.0f, 1.0f, 0), XMFLOAT2(1.0f, 0.0f) },
+	};
+
+	// Create shader resources from the planes, with the formats they were created with
+	CComPtr<ID3D11ShaderResourceView> pLumaSRV;
+	CComPtr<ID3D11ShaderResourceView> pChromaSRV;
+	hr = m_Device->CreateShaderResourceView(pLumaTexture, nullptr, &pLumaSRV);
+	if (SUCCEEDED(hr)) {
+		hr = m_Device->CreateShaderResourceView(pChromaTexture, nullptr, &pChromaSRV);
+	}
+	if (FAILED(hr))
+	{
+		_com_error err(hr);
+		LOG_ERROR(L"Failed to create shader resource from YUV planes: %ls", err.ErrorMessage());
+		return hr;
+	}
+	D3D11_BUFFER_DESC bufferDesc;
+	ZeroMemory(&bufferDesc, sizeof(D3D11_BUFFER_DESC));
+	bufferDesc.Usage = D3D11_USAGE_DEFAULT;
+	bufferDesc.ByteWidth = sizeof(VERTEX) * _countof(Vertices);
+	bufferDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+	bufferDesc.CPUAccessFlags = 0;
+
+	D3D11_SUBRESOURCE_DATA initData;
+	ZeroMemory(&initData, sizeof(D3D11_SUBRESOURCE_DATA));
+	initData.pSysMem = Vertices;
+
+	CComPtr<ID3D11Buffer> pVertexBuffer;
+	RETURN_ON_BAD_HR(hr = m_Device->CreateBuffer(&bufferDesc, &initData, &pVertexBuffer));
+	CComPtr<ID3D11RenderTargetView> pRTV;
+	RETURN_ON_BAD_HR(hr = m_Device->CreateRenderTargetView(pCanvasTexture, nullptr, &pRTV));
+
+	YUV_SHADER_CONSTANTS constants{};
+	constants.Matrix = matrix;
+	constants.ChromaLayout[0] = format == YuvPixelFormat::YUY2 ? 1.0f : 0.0f;
+	m_DeviceContext->UpdateSubresource(m_YuvConstantBuffer, 0, nullptr, &constants, 0, 0);
+
+	// Set resources. The converted frame is opaque, so it replaces the canvas without blending.
+	FLOAT BlendFactor[4] = { 0.f, 0.f, 0.f, 0.f };
+	UINT Stride = sizeof(VERTEX);
+	UINT Offset = 0;
+	ID3D11Buffer *pVertexBuffers[] = { pVertexBuffer };
+	ID3D11ShaderResourceView *shaderResources[] = { pLumaSRV, pChromaSRV };
+	m_DeviceContext->IASetVertexBuffers(0, 1, pVertexBuffers, &Stride, &Offset);
+	m_DeviceContext->OMSetBlendState(nullptr, BlendFactor, 0xFFFFFFFF);
+	ID3D11RenderTargetView *renderTargets[] = { pRTV };
+	m_DeviceContext->OMSetRenderTargets(1, renderTargets, nullptr);
+	m_DeviceContext->VSSetShader(m_VertexShader, nullptr, 0);
+	m_DeviceContext->PSSetShader(m_YuvPixelShader, nullptr, 0);
+	m_DeviceContext->PSSetConstantBuffers(0, 1, &m_YuvConstantBuffer);
+	m_DeviceContext->PSSetShaderResources(0, 2, shaderResources);
+	m_DeviceContext->PSSetSamplers(0, 1, &m_SamplerLinear);
+	m_DeviceContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+	// Draw
+	m_DeviceContext->Draw(_countof(Vertices), 0);
+
+	// Restore view port
+	m_DeviceContext->RSSetViewports(1, &VP);
+	// Clear shader resources
+	ID3D11ShaderResourceView *nullShader[] = { nullptr, nullptr };
+	m_DeviceContext->PSSetShaderResources(0, 2, nullShader);
+	return hr;
+}
+
+void TextureManager::GetYuvPlaneFormats(_In_ YuvPixelFormat format, _Out_ DXGI_FORMAT *pLumaFormat, _Out_ DXGI_FORMAT *pChromaFormat)
+{
+	switch (format)
+	{
+		case YuvPixelFormat::YUY2:
+			// Y in red, with U or V in green, and Y0 U Y1 V in one texel per pair of pixels
+			*pLumaFormat = DXGI_FORMAT_R8G8_UNORM;
+			*pChromaFormat = DXGI_FORMAT_R8G8B8A8_UNORM;
+			break;
+		case YuvPixelFormat::NV12:
+		default:
+			*pLumaFormat = DXGI_FORMAT_R8_UNORM;
+			*pChromaFormat = DXGI_FORMAT_R8G8_UNORM;
+			break;
+	}
+}
+
+bool TextureManager::IsYuvTextureSupported(_In_ YuvPixelFormat format)
+{
+	if (!m_YuvPixelShader || !m_YuvConstantBuffer) {
+		return false;
+	}
+	DXGI_FORMAT planeFormats[2];
+	GetYuvPlaneFormats(format, &planeFormats[0], &planeFormats[1]);
+	for each (DXGI_FORMAT planeFormat in planeFormats)
+	{
+		UINT support = 0;
+		if (FAILED(m_Device->CheckFormatSupport(planeFormat, &support))
+			|| !(support & D3D11_FORMAT_SUPPORT_TEXTURE2D)
+			|| !(support & D3D11_FORMAT_SUPPORT_SHADER_SAMPLE)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+HRESULT TextureManager::CreateYuvPlaneTextures(_In_ YuvPixelFormat format, _In_ UINT width, _In_ UINT height, _Outptr_ ID3D11Texture2D **ppLumaTexture, _Outptr_ ID3D11Texture2D **ppChromaTexture)
+{
+	*ppLumaTexture = nullptr;
+	*ppChromaTexture = nullptr;
+	HRESULT hr;
+	D3D11_TEXTURE2D_DESC desc = { 0 };
+	desc.MipLevels = 1;
+	desc.ArraySize = 1;
+	desc.SampleDesc.Count = 1;
+	desc.SampleDesc.Quality = 0;
+	desc.Usage = D3D11_USAGE_DEFAULT;
+	desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+	DXGI_FORMAT lumaFormat;
+	DXGI_FORMAT chromaFormat;
+	GetYuvPlaneFormats(format, &lumaFormat, &chromaFormat);
+
+	CComPtr<ID3D11Texture2D> pLumaTexture;
+	desc.Format = lumaFormat;
+	desc.Width = width;
+	desc.Height = height;
+	RETURN_ON_BAD_HR(hr = m_Device->CreateTexture2D(&desc, nullptr, &pLumaTexture));
+
+	CComPtr<ID3D11Texture2D> pChromaTexture;
+	desc.Format = chromaFormat;
+	desc.Width = (width + 1) / 2;
+	desc.Height = format == YuvPixelFormat::NV12 ? (height + 1) / 2 : height;
+	RETURN_ON_BAD_HR(hr = m_Device->CreateTexture2D(&desc, nullptr, &pChromaTexture));
+
+	*ppLumaTexture = pLumaTexture.Detach();
+	*ppChromaTexture = pChromaTexture.Detach();
+	return hr;
+}
+
 void TextureManager::ConfigureRotationVertices(_Inout_ VERTEX(&vertices)[6], _In_ RECT textureRect, _In_opt_ DXGI_MODE_ROTATION rotation)
 {
 	LONG textureLeft = textureRect.left;
@@ -560,21 +759,6 @@ HRESULT TextureManager::InitializeDesc(_In_ UINT width, _In_ UINT height, _Out_
 	return S_OK;
 }
 
-HRESULT TextureManager::GetOrCreateTexture(_In_ D3D11_TEXTURE2D_DESC desc, _Outptr_ ID3D11Texture2D **ppTexture)
-{
-	ID3D11Texture2D *tex = nullptr;
-	if (m_TextureCache.find(desc) != m_TextureCache.end()) {
-		tex = m_TextureCache.at(desc);
-	}
-	else {
-		RETURN_ON_BAD_HR(m_Device->CreateTexture2D(&desc, nullptr, &tex));
-		m_TextureCache[desc] = tex;
-	}
-	*ppTexture = tex;
-	return S_OK;
-}
-
-
 HRESULT TextureManager::CropTexture(_In_ ID3D11Texture2D *pTexture, _In_ RECT cropRect, _Outptr_ ID3D11Texture2D **ppCroppedFrame)
 {
 	*ppCroppedFrame = nullptr;
@@ -596,10 +780,8 @@ HRESULT TextureManager::CropTexture(_In_ ID3D11Texture2D *pTexture, _In_ RECT cr
 	CComPtr<ID3D11Device> pDevice;
 	pTexture->GetDevice(&pDevice);
 	ID3D11Texture2D *pCroppedFrame = nullptr;
-	RETURN_ON_BAD_HR(GetOrCreateTexture(frameDesc, &pCroppedFrame));
-	if (pCroppedFrame == pTexture) {
-		RETURN_ON_BAD_HR(pDevice->CreateTexture2D(&frameDesc, nullptr, &pCroppedFrame));
-	}
+	//The pool never hands out a texture that is in use, so the cropped frame is never the source texture
+	RETURN_ON_BAD_HR(TexturePool::Shared().Acquire(pDevice, frameDesc, &pCroppedFrame));
 	D3D11_BOX sourceRegion;
 	RtlZeroMemory(&sourceRegion, sizeof(sourceRegion));
 	sourceRegion.left = cropRect.left;
@@ -612,7 +794,6 @@ HRESULT TextureManager::CropTexture(_In_ ID3D11Texture2D *pTexture, _In_ RECT cr
 	pDevice->GetImmediateContext(&context);
 	context->CopySubresourceRegion(pCroppedFrame, 0, 0, 0, 0, pTexture, 0, &sourceRegion);
 	*ppCroppedFrame = pCroppedFrame;
-	(*ppCroppedFrame)->AddRef();
 	return S_OK;
 }
 
@@ -624,7 +805,7 @@ HRESULT TextureManager::CopyTextureWithCPU(_In_ ID3D11Device *pDevice, _In_ ID3D
 	CComPtr<ID3D11DeviceContext> pDuplicationDeviceContext = nullptr;
 	pSourceDevice->GetImmediateContext(&pDuplicationDeviceContext);
 
-	//Create a new staging texture on the source device that supports CPU access.
+	//Get a staging texture on the source device that supports CPU access.
 	CComPtr<ID3D11Texture2D> pStagingTexture;
 	D3D11_TEXTURE2D_DESC stagingDesc;
 	pSourceTexture->GetDesc(&stagingDesc);
@@ -632,28 +813,24 @@ HRESULT TextureManager::CopyTextureWithCPU(_In_ ID3D11Device *pDevice, _In_ ID3D
 	stagingDesc.Usage = D3D11_USAGE_STAGING;
 	stagingDesc.MiscFlags = 0;
 	stagingDesc.BindFlags = 0;
-	RETURN_ON_BAD_HR(hr = pSourceDevice->CreateTexture2D(&stagingDesc, nullptr, &pStagingTexture));
-	//Copy the source surface to the new staging texture.
+	RETURN_ON_BAD_HR(hr = TexturePool::Shared().Acquire(pSourceDevice, stagingDesc, &pStagingTexture));
+	//Copy the source surface to the staging texture.
 	pDuplicationDeviceContext->CopyResource(pStagingTexture, pSourceTexture);
-	D3D11_MAPPED_SUBRESOURCE mapped{};
-	//Map the staging texture to get access to the texture data.
-	RETURN_ON_BAD_HR(hr = pDuplicationDeviceContext->Map(pStagingTexture, 0, D3D11_MAP_READ, 0, &mapped));
-	BYTE *data = (BYTE *)mapped.pData;
-	LONG stride = mapped.RowPitch;
-	pDuplicationDeviceContext->Unmap(pStagingTexture, 0);
-	// Set up init data and create new texture from the mapped data.
-	D3D11_SUBRESOURCE_DATA initData = { 0 };
-	initData.pSysMem = data;
-	initData.SysMemPitch = abs(stride);
-	initData.SysMemSlicePitch = 0;
 	D3D11_TEXTURE2D_DESC mappedTextureDesc;
 	pSourceTexture->GetDesc(&mappedTextureDesc);
 	mappedTextureDesc.MiscFlags = 0;
 	mappedTextureDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
 	CComPtr<ID3D11Texture2D> pTextureCopy;
-	RETURN_ON_BAD_HR(hr = pDevice->CreateTexture2D(&mappedTextureDesc, &initData, &pTextureCopy));
-	*ppTextureCopy = pTextureCopy;
-	(*ppTextureCopy)->AddRef();
+	RETURN_ON_BAD_HR(hr = TexturePool::Shared().Acquire(pDevice, mappedTextureDesc, &pTextureCopy));
+	CComPtr<ID3D11DeviceContext> pDeviceContext = nullptr;
+	pDevice->GetImmediateContext(&pDeviceContext);
+	D3D11_MAPPED_SUBRESOURCE mapped{};
+	//Map the staging texture to get access to the texture data.
+	RETURN_ON_BAD_HR(hr = pDuplicationDeviceContext->Map(pStagingTexture, 0, D3D11_MAP_READ, 0, &mapped));
+	//Upload the data to the copy while the staging texture is mapped, as the mapped memory is not valid after it is unmapped.
+	pDeviceContext->UpdateSubresource(pTextureCopy, 0, nullptr, mapped.pData, mapped.RowPitch, 0);
+	pDuplicationDeviceContext->Unmap(pStagingTexture, 0);
+	*ppTextureCopy = pTextureCopy.Detach();
 	return hr;
 }
 
@@ -681,7 +858,7 @@ HRESULT TextureManager::CreateTexture(_In_ UINT width, _In_ UINT height, _Outptr
 	return hr;
 }
 
-HRESULT TextureManager::CreateTextureFromBuffer(_In_ BYTE *pFrameBuffer, _In_ LONG stride, _In_ UINT width, _In_ UINT height, _Outptr_ ID3D11Texture2D **ppTexture, UINT miscFlag, UINT bindFlag)
+HRESULT TextureManager::CreateTextureFromBuffer(_In_ const BYTE *pFrameBuffer, _In_ LONG stride, _In_ UINT width, _In_ UINT height, _Outptr_ ID3D11Texture2D **ppTexture, UINT miscFlag, UINT bindFlag)
 {
 	D3D11_TEXTURE2D_DESC desc = { 0 };
 	desc.MipLevels = 1;
@@ -720,16 +897,35 @@ HRESULT TextureManager::BlankTexture(_Inout_ ID3D11Texture2D *pTexture, _In_ REC
 	Box.bottom = height;
 	Box.back = 1;
 
-	CComPtr<ID3D11Texture2D> pBlankFrame;
 	D3D11_TEXTURE2D_DESC desc;
 	pTexture->GetDesc(&desc);
-	desc.MiscFlags = 0;
-	desc.Width = width;
-	desc.Height = height;
-	HRESULT hr = m_Device->CreateTexture2D(&desc, nullptr, &pBlankFrame);
-	if (SUCCEEDED(hr)) {
-		m_DeviceContext->CopySubresourceRegion(pTexture, 0, rect.left + offsetX, rect.top + offsetY, 0, pBlankFrame, 0, &Box);
+	D3D11_TEXTURE2D_DESC blankDesc{};
+	if (m_BlankTexture) {
+		m_BlankTexture->GetDesc(&blankDesc);
 	}
+	//The blank texture is only created again when a larger region or another format is blanked, so it is not allocated for every frame.
+	//It is never taken from the texture pool, as pooled textures are not blank when they are reused.
+	if (!m_BlankTexture || blankDesc.Format != desc.Format || blankDesc.SampleDesc.Count != desc.SampleDesc.Count
+		|| blankDesc.Width < static_cast<UINT>(width) || blankDesc.Height < static_cast<UINT>(height)) {
+		//Grow the blank texture to fit both the regions blanked before and this one
+		UINT blankWidth = blankDesc.Format == desc.Format ? max(blankDesc.Width, static_cast<UINT>(width)) : width;
+		UINT blankHeight = blankDesc.Format == desc.Format ? max(blankDesc.Height, static_cast<UINT>(height)) : height;
+		blankDesc = desc;
+		blankDesc.Width = blankWidth;
+		blankDesc.Height = blankHeight;
+		blankDesc.MipLevels = 1;
+		blankDesc.ArraySize = 1;
+		blankDesc.Usage = D3D11_USAGE_DEFAULT;
+		blankDesc.BindFlags = 0;
+		blankDesc.CPUAccessFlags = 0;
+		blankDesc.MiscFlags = 0;
+		SafeRelease(&m_BlankTexture);
+		HRESULT hr = m_Device->CreateTexture2D(&blankDesc, nullptr, &m_BlankTexture);
+		if (FAILED(hr)) {
+			return S_OK;
+		}
+	}
+	m_DeviceContext->CopySubresourceRegion(pTexture, 0, rect.left + offsetX, rect.top + offsetY, 0, m_BlankTexture, 0, &Box);
 	return S_OK;
 }
 
@@ -767,8 +963,9 @@ void TextureManager::CleanRefs()
 		m_BlendState->Release();
 		m_BlendState = nullptr;
 	}
-	for (auto &pair : m_TextureCache)
-	{
-		SafeRelease(&pair.second);
-	}
+	SafeRelease(&m_LayerBlendState);
+	SafeRelease(&m_PremultipliedBlendState);
+	SafeRelease(&m_YuvPixelShader);
+	SafeRelease(&m_YuvConstantBuffer);
+	SafeRelease(&m_BlankTexture);
 }
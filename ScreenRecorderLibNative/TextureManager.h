@@ -2,10 +2,19 @@
 #include <DirectXMath.h>
 #include "CommonTypes.h"
 #include "DX.util.h"
-#include <unordered_map>
+#include "YuvConversion.h"
 
 using namespace std;
 
+enum class TextureBlendMode {
+	///<summary>Blends a texture with straight alpha onto the canvas.</summary>
+	AlphaBlend,
+	///<summary>Blends a texture with straight alpha into a layer that starts out transparent. The layer ends up with premultiplied alpha.</summary>
+	AccumulateLayer,
+	///<summary>Blends a layer with premultiplied alpha onto the canvas, such as one built with AccumulateLayer.</summary>
+	PremultipliedAlphaBlend
+};
+
 class TextureManager
 {
 public:
@@ -14,7 +23,24 @@ public:
 	HRESULT Initialize(_In_ ID3D11DeviceContext *pDeviceContext, _In_ ID3D11Device *Device);
 	HRESULT ResizeTexture(_In_ ID3D11Texture2D *pOrgTexture, _In_  SIZE targetSize, _In_ TextureStretchMode stretch, _Outptr_ ID3D11Texture2D **ppResizedTexture, _Out_opt_ RECT *pContentRect = nullptr);
 	HRESULT RotateTexture(_In_ ID3D11Texture2D *pOrgTexture, _In_ DXGI_MODE_ROTATION rotation, _Outptr_ ID3D11Texture2D **ppRotatedTexture);
-	HRESULT DrawTexture(_Inout_ ID3D11Texture2D *pCanvasTexture, _In_ ID3D11Texture2D *pTexture, _In_ RECT rect);
+	HRESULT DrawTexture(_Inout_ ID3D11Texture2D *pCanvasTexture, _In_ ID3D11Texture2D *pTexture, _In_ RECT rect, _In_ TextureBlendMode blendMode = TextureBlendMode::AlphaBlend);
+	/// <summary>
+	/// Draws a YUV frame uploaded with CreateYuvPlaneTextures to the rectangle of the canvas, converting it to RGB in the pixel shader.
+	/// </summary>
+	HRESULT DrawYuvTexture(_Inout_ ID3D11Texture2D *pCanvasTexture, _In_ ID3D11Texture2D *pLumaTexture, _In_ ID3D11Texture2D *pChromaTexture, _In_ YuvPixelFormat format, _In_ const YUV_TO_RGB_MATRIX &matrix, _In_ RECT rect);
+	/// <summary>
+	/// Returns true if the device can sample the planes of frames of the format, so they can be drawn with DrawYuvTexture.
+	/// </summary>
+	bool IsYuvTextureSupported(_In_ YuvPixelFormat format);
+	/// <summary>
+	/// Creates the textures the planes of a YUV frame are uploaded to. NV12 frames are uploaded as a Y plane and a UV plane.
+	/// YUY2 frames are uploaded to both textures, which read the packed samples as Y and as U and V respectively.
+	/// </summary>
+	HRESULT CreateYuvPlaneTextures(_In_ YuvPixelFormat format, _In_ UINT width, _In_ UINT height, _Outptr_ ID3D11Texture2D **ppLumaTexture, _Outptr_ ID3D11Texture2D **ppChromaTexture);
+	/// <summary>
+	/// Returns the size ResizeTexture resizes a texture of the original size to.
+	/// </summary>
+	static SIZE GetResizedSize(_In_ SIZE originalSize, _In_ SIZE targetSize, _In_ TextureStretchMode stretch);
 	/// <summary>
 	/// Crops a texture to the given rectangle.
 	/// </summary>
@@ -31,11 +57,14 @@ public:
 	/// <param name="ppTextureCopy">The copied texture</param>
 	HRESULT CopyTextureWithCPU(_In_ ID3D11Device *pDevice, _In_ ID3D11Texture2D *pTexture, _Outptr_ ID3D11Texture2D **ppTextureCopy);
 	HRESULT CreateTexture(_In_ UINT width, _In_ UINT height, _Outptr_ ID3D11Texture2D **ppTexture, UINT miscFlag = 0, UINT bindFlag = 0);
-	HRESULT CreateTextureFromBuffer(_In_ BYTE *pFrameBuffer, _In_ LONG stride, _In_ UINT width, _In_ UINT height, _Outptr_ ID3D11Texture2D **ppTexture, UINT miscFlag = 0, UINT bindFlag = 0);
+	HRESULT CreateTextureFromBuffer(_In_ const BYTE *pFrameBuffer, _In_ LONG stride, _In_ UINT width, _In_ UINT height, _Outptr_ ID3D11Texture2D **ppTexture, UINT miscFlag = 0, UINT bindFlag = 0);
 	HRESULT BlankTexture(_Inout_ ID3D11Texture2D *pTexture, _In_ RECT rect, _In_ INT OffsetX = 0, _In_  INT OffsetY = 0);
 private:
 	HRESULT InitializeDesc(_In_ UINT width, _In_ UINT height, _Out_ D3D11_TEXTURE2D_DESC *pTargetDesc);
-	HRESULT GetOrCreateTexture(_In_ D3D11_TEXTURE2D_DESC desc, _Outptr_ ID3D11Texture2D **ppTexture);
+	/// <summary>
+	/// Returns the texture formats the luma and chroma planes of the format are uploaded as.
+	/// </summary>
+	void GetYuvPlaneFormats(_In_ YuvPixelFormat format, _Out_ DXGI_FORMAT *pLumaFormat, _Out_ DXGI_FORMAT *pChromaFormat);
 	void ConfigureRotationVertices(_Inout_ VERTEX(&vertices)[6], _In_ RECT textureRect, _In_opt_ DXGI_MODE_ROTATION rotation = DXGI_MODE_ROTATION_UNSPECIFIED);
 	void CleanRefs();
 
@@ -43,46 +72,14 @@ private:
 	ID3D11DeviceContext *m_DeviceContext;
 	ID3D11SamplerState *m_SamplerLinear;
 	ID3D11BlendState *m_BlendState;
+	ID3D11BlendState *m_LayerBlendState;
+	ID3D11BlendState *m_PremultipliedBlendState;
 	ID3D11VertexShader *m_VertexShader;
 	ID3D11PixelShader *m_PixelShader;
+	ID3D11PixelShader *m_YuvPixelShader;
+	ID3D11Buffer *m_YuvConstantBuffer;
 	ID3D11InputLayout *m_InputLayout;
 
-
-	struct TextureDescHasher {
-		std::size_t operator()(const D3D11_TEXTURE2D_DESC &desc) const noexcept {
-			std::string temp =
-				to_string(desc.Format)
-				.append(to_string(desc.ArraySize))
-				.append(to_string(desc.BindFlags))
-				.append(to_string(desc.CPUAccessFlags))
-				.append(to_string(desc.Format))
-				.append(to_string(desc.Height))
-				.append(to_string(desc.MipLevels))
-				.append(to_string(desc.MiscFlags))
-				.append(to_string(desc.SampleDesc.Count))
-				.append(to_string(desc.SampleDesc.Quality))
-				.append(to_string(desc.Width))
-				.append(to_string(desc.Usage));
-			return hash<string>{}(temp);
-		};
-	};
-
-	struct TextureDescComparator {
-		bool operator()(const D3D11_TEXTURE2D_DESC &A,
-						const D3D11_TEXTURE2D_DESC &B) const noexcept {
-			return A.Format == B.Format
-				&& A.ArraySize == B.ArraySize
-				&& A.BindFlags == B.BindFlags
-				&& A.CPUAccessFlags == B.CPUAccessFlags
-				&& A.Format == B.Format
-				&& A.Height == B.Height
-				&& A.MipLevels == B.MipLevels
-				&& A.MiscFlags == B.MiscFlags
-				&& A.SampleDesc.Count == B.SampleDesc.Count
-				&& A.SampleDesc.Quality == B.SampleDesc.Quality
-				&& A.Usage == B.Usage
-				&& A.Width == B.Width;
-		};
-	};
-	std::unordered_map<D3D11_TEXTURE2D_DESC, ID3D11Texture2D *, TextureDescHasher, TextureDescComparator> m_TextureCache;
+	// Texture that is never written to, which is copied from to blank regions of other textures
+	ID3D11Texture2D *m_BlankTexture;
 };
@@ -0,0 +1,209 @@
+#include "TexturePool.h"
+#include "Log.h"
+#include "Util.h"
+
+using namespace std;
+
+//Adds a value to an FNV-1a hash.
+static inline UINT64 HashCombine(_In_ UINT64 hash, _In_ UINT64 value)
+{
+	return (hash ^ value) * 0x100000001B3ull;
+}
+
+bool TEXTURE_POOL_KEY::operator==(const TEXTURE_POOL_KEY &other) const
+{
+	return Device == other.Device
+		&& Desc.Width == other.Desc.Width
+		&& Desc.Height == other.Desc.Height
+		&& Desc.MipLevels == other.Desc.MipLevels
+		&& Desc.ArraySize == other.Desc.ArraySize
+		&& Desc.Format == other.Desc.Format
+		&& Desc.SampleDesc.Count == other.Desc.SampleDesc.Count
+		&& Desc.SampleDesc.Quality == other.Desc.SampleDesc.Quality
+		&& Desc.Usage == other.Desc.Usage
+		&& Desc.BindFlags == other.Desc.BindFlags
+		&& Desc.CPUAccessFlags == other.Desc.CPUAccessFlags
+		&& Desc.MiscFlags == other.Desc.MiscFlags;
+}
+
+size_t TexturePoolKeyHasher::operator()(const TEXTURE_POOL_KEY &key) const
+{
+	UINT64 hash = 0xCBF29CE484222325ull;
+	hash = HashCombine(hash, reinterpret_cast<UINT_PTR>(key.Device));
+	hash = HashCombine(hash, key.Desc.Width);
+	hash = HashCombine(hash, key.Desc.Height);
+	hash = HashCombine(hash, key.Desc.MipLevels);
+	hash = HashCombine(hash, key.Desc.ArraySize);
+	hash = HashCombine(hash, key.Desc.Format);
+	hash = HashCombine(hash, key.Desc.SampleDesc.Count);
+	hash = HashCombine(hash, key.Desc.SampleDesc.Quality);
+	hash = HashCombine(hash, key.Desc.Usage);
+	hash = HashCombine(hash, key.Desc.BindFlags);
+	hash = HashCombine(hash, key.Desc.CPUAccessFlags);
+	hash = HashCombine(hash, key.Desc.MiscFlags);
+	return static_cast<size_t>(hash);
+}
+
+TexturePool::TexturePool(_In_ size_t budgetBytes, _In_opt_ TextureFactory factory) :
+	m_Mutex(),
+	m_Entries{},
+	m_EntriesByKey{},
+	m_Factory(factory),
+	m_BudgetBytes(budgetBytes),
+	m_SizeInBytes(0),
+	m_Hits(0),
+	m_Misses(0),
+	m_Evictions(0)
+{
+	if (!m_Factory) {
+		m_Factory = [](_In_ ID3D11Device *pDevice, _In_ const D3D11_TEXTURE2D_DESC &desc, _Outptr_ ID3D11Texture2D **ppTexture) {
+			return pDevice->CreateTexture2D(&desc, nullptr, ppTexture);
+		};
+	}
+}
+
+TexturePool &TexturePool::Shared()
+{
+	static TexturePool pool(TEXTURE_POOL_BUDGET_BYTES);
+	return pool;
+}
+
+size_t TexturePool::GetTextureSizeInBytes(_In_ const D3D11_TEXTURE2D_DESC &desc)
+{
+	//Bits per pixel of the formats used in the library. Other formats are counted as 32 bits per pixel.
+	UINT64 bitsPerPixel;
+	switch (desc.Format)
+	{
+	case DXGI_FORMAT_R8_UNORM:
+	case DXGI_FORMAT_R8_UINT:
+	case DXGI_FORMAT_A8_UNORM:
+		bitsPerPixel = 8;
+		break;
+	case DXGI_FORMAT_NV12:
+		bitsPerPixel = 12;
+		break;
+	case DXGI_FORMAT_R8G8_UNORM:
+	case DXGI_FORMAT_R16_UNORM:
+	case DXGI_FORMAT_R16_FLOAT:
+	case DXGI_FORMAT_YUY2:
+		bitsPerPixel = 16;
+		break;
+	case DXGI_FORMAT_R16G16B16A16_FLOAT:
+	case DXGI_FORMAT_R16G16B16A16_UNORM:
+		bitsPerPixel = 64;
+		break;
+	case DXGI_FORMAT_R32G32B32A32_FLOAT:
+		bitsPerPixel = 128;
+		break;
+	default:
+		bitsPerPixel = 32;
+		break;
+	}
+	UINT64 pixels = 0;
+	UINT width = max(desc.Width, 1u);
+	UINT height = max(desc.Height, 1u);
+	//A mip level count of 0 is the full chain
+	for (UINT level = 0; desc.MipLevels == 0 || level < desc.MipLevels; level++) {
+		pixels += static_cast<UINT64>(width) * height;
+		if (width == 1 && height == 1) {
+			break;
+		}
+		width = max(width / 2, 1u);
+		height = max(height / 2, 1u);
+	}
+	UINT64 samples = static_cast<UINT64>(max(desc.ArraySize, 1u)) * max(desc.SampleDesc.Count, 1u);
+	return static_cast<size_t>(pixels * samples * bitsPerPixel / 8);
+}
+
+HRESULT TexturePool::Acquire(_In_ ID3D11Device *pDevice, _In_ const D3D11_TEXTURE2D_DESC &desc, _Outptr_ ID3D11Texture2D **ppTexture)
+{
+	*ppTexture = nullptr;
+	TEXTURE_POOL_KEY key{ pDevice, desc };
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		auto range = m_EntriesByKey.equal_range(key);
+		for (auto iterator = range.first; iterator != range.second; iterator++) {
+			if (!IsInUse(iterator->second->Texture)) {
+				//Move the entry to the front, as the most recently used
+				m_Entries.splice(m_Entries.begin(), m_Entries, iterator->second);
+				m_Hits++;
+				return m_Entries.front().Texture.CopyTo(ppTexture);
+			}
+		}
+	}
+	m_Misses++;
+	//Textures are created outside the lock, so other threads are not held up by the allocation
+	CComPtr<ID3D11Texture2D> pTexture = nullptr;
+	HRESULT hr;
+	RETURN_ON_BAD_HR(hr = m_Factory(pDevice, desc, &pTexture));
+	size_t sizeInBytes = GetTextureSizeInBytes(desc);
+	if (sizeInBytes > m_BudgetBytes) {
+		LOG_DEBUG(L"Texture of %zu bytes is larger than the texture pool budget, and is not pooled", sizeInBytes);
+		*ppTexture = pTexture.Detach();
+		return S_OK;
+	}
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	while (!m_Entries.empty() && m_SizeInBytes + sizeInBytes > m_BudgetBytes) {
+		//Evict the least recently used texture. If it is still in use, it is freed when its users release it.
+		Remove(std::prev(m_Entries.end()));
+		m_Evictions++;
+	}
+	m_Entries.push_front(POOL_ENTRY{ key, pTexture, sizeInBytes });
+	m_EntriesByKey.emplace(key, m_Entries.begin());
+	m_SizeInBytes += sizeInBytes;
+	*ppTexture = pTexture.Detach();
+	return S_OK;
+}
+
+void TexturePool::Clear(_In_ ID3D11Device *pDevice)
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	auto entry = m_Entries.begin();
+	while (entry != m_Entries.end()) {
+		auto next = std::next(entry);
+		if (entry->Key.Device == pDevice) {
+			Remove(entry);
+		}
+		entry = next;
+	}
+}
+
+void TexturePool::Clear()
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	m_Entries.clear();
+	m_EntriesByKey.clear();
+	m_SizeInBytes = 0;
+}
+
+TEXTURE_POOL_STATISTICS TexturePool::GetStatistics()
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	TEXTURE_POOL_STATISTICS statistics{};
+	statistics.Hits = m_Hits;
+	statistics.Misses = m_Misses;
+	statistics.Evictions = m_Evictions;
+	statistics.TextureCount = static_cast<UINT>(m_Entries.size());
+	statistics.SizeInBytes = m_SizeInBytes;
+	return statistics;
+}
+
+bool TexturePool::IsInUse(_In_ ID3D11Texture2D *pTexture)
+{
+	//The pool holds one reference to every texture, so any other reference is a user
+	pTexture->AddRef();
+	return pTexture->Release() > 1;
+}
+
+void TexturePool::Remove(_In_ std::list<POOL_ENTRY>::iterator entry)
+{
+	auto range = m_EntriesByKey.equal_range(entry->Key);
+	for (auto iterator = range.first; iterator != range.second; iterator++) {
+		if (iterator->second == entry) {
+			m_EntriesByKey.erase(iterator);
+			break;
+		}
+	}
+	m_SizeInBytes -= entry->SizeInBytes;
+	m_Entries.erase(entry);
+}
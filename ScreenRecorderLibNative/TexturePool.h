@@ -0,0 +1,98 @@
+#pragma once
+#include <Windows.h>
+#include <d3d11.h>
+#include <atlbase.h>
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <list>
+#include <unordered_map>
+
+//Maximum video memory used by the textures kept in the texture pool shared by all devices in the process.
+#define TEXTURE_POOL_BUDGET_BYTES (256 * 1024 * 1024)
+
+//
+// Identifies the textures in the pool that can be handed out for a request. Textures are only reused on the device that created them.
+//
+struct TEXTURE_POOL_KEY {
+	ID3D11Device *Device;
+	D3D11_TEXTURE2D_DESC Desc;
+
+	bool operator==(const TEXTURE_POOL_KEY &other) const;
+};
+
+struct TexturePoolKeyHasher {
+	size_t operator()(const TEXTURE_POOL_KEY &key) const;
+};
+
+struct TEXTURE_POOL_STATISTICS {
+	// Number of requests that reused a texture in the pool
+	UINT64 Hits;
+	// Number of requests that created a new texture
+	UINT64 Misses;
+	// Number of textures dropped from the pool to stay within the budget
+	UINT64 Evictions;
+	// Number of textures in the pool, both in use and available
+	UINT TextureCount;
+	// Estimated video memory used by the textures in the pool
+	size_t SizeInBytes;
+};
+
+//
+// Pool of textures that are reused between frames, instead of allocating textures for every frame in the capture and encode paths.
+// A texture is acquired with Acquire, and released by releasing the returned reference. The pool holds one reference of its own
+// to every texture, so a texture is available for reuse once that is the only reference left, e.g. after the encoder is done with a sample.
+// Several textures are kept for each description, so textures that are still in use are never handed out twice.
+// The least recently used textures are dropped from the pool when it exceeds its budget. Textures that are in use when they are dropped
+// stay valid for their users, and are freed when released.
+//
+class TexturePool
+{
+public:
+	typedef std::function<HRESULT(_In_ ID3D11Device *pDevice, _In_ const D3D11_TEXTURE2D_DESC &desc, _Outptr_ ID3D11Texture2D **ppTexture)> TextureFactory;
+
+	/// <summary>
+	/// Creates a pool that creates textures with the given factory, or with ID3D11Device::CreateTexture2D if none is given.
+	/// </summary>
+	TexturePool(_In_ size_t budgetBytes, _In_opt_ TextureFactory factory = nullptr);
+	/// <summary>
+	/// Returns the pool shared by all texture users in the process.
+	/// </summary>
+	static TexturePool &Shared();
+	/// <summary>
+	/// Returns an estimate of the video memory used by a texture with the given description.
+	/// </summary>
+	static size_t GetTextureSizeInBytes(_In_ const D3D11_TEXTURE2D_DESC &desc);
+
+	/// <summary>
+	/// Returns a texture with the given description that is not in use, creating one if the pool has none.
+	/// The contents of a reused texture are undefined, so callers must overwrite the parts they read.
+	/// </summary>
+	HRESULT Acquire(_In_ ID3D11Device *pDevice, _In_ const D3D11_TEXTURE2D_DESC &desc, _Outptr_ ID3D11Texture2D **ppTexture);
+	/// <summary>
+	/// Drops all textures created on the device from the pool. Call this before the device is released, so the pool does not keep it alive.
+	/// </summary>
+	void Clear(_In_ ID3D11Device *pDevice);
+	void Clear();
+
+	TEXTURE_POOL_STATISTICS GetStatistics();
+private:
+	struct POOL_ENTRY {
+		TEXTURE_POOL_KEY Key;
+		CComPtr<ID3D11Texture2D> Texture;
+		size_t SizeInBytes;
+	};
+	bool IsInUse(_In_ ID3D11Texture2D *pTexture);
+	void Remove(_In_ std::list<POOL_ENTRY>::iterator entry);
+
+	std::mutex m_Mutex;
+	// Entries ordered from the most to the least recently acquired
+	std::list<POOL_ENTRY> m_Entries;
+	std::unordered_multimap<TEXTURE_POOL_KEY, std::list<POOL_ENTRY>::iterator, TexturePoolKeyHasher> m_EntriesByKey;
+	TextureFactory m_Factory;
+	size_t m_BudgetBytes;
+	size_t m_SizeInBytes;
+	std::atomic<UINT64> m_Hits;
+	std::atomic<UINT64> m_Misses;
+	std::atomic<UINT64> m_Evictions;
+};
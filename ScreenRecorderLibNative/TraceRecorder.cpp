@@ -0,0 +1,193 @@
+#include "TraceRecorder.h"
+#include "Log.h"
+#include <fstream>
+
+using namespace std;
+
+static void WriteJsonString(_Inout_ std::ostream &stream, _In_ const char *text)
+{
+	stream << '"';
+	for (const char *c = text; *c; c++) {
+		if (*c == '"' || *c == '\\') {
+			stream << '\\';
+		}
+		stream << *c;
+	}
+	stream << '"';
+}
+
+TraceThreadBuffer::TraceThreadBuffer(_In_ UINT64 session) :
+	m_Session(session),
+	m_ThreadId(GetCurrentThreadId()),
+	m_ThreadName(nullptr),
+	m_Blocks{},
+	m_EventCount(0),
+	m_DroppedEventCount(0)
+{
+}
+
+bool TraceThreadBuffer::TryAdd(_In_ const TRACE_EVENT &traceEvent)
+{
+	INT64 eventCount = m_EventCount.load(std::memory_order_relaxed);
+	INT64 blockIndex = eventCount / TRACE_BLOCK_EVENT_COUNT;
+	if (blockIndex >= TRACE_MAX_BLOCKS_PER_THREAD) {
+		m_DroppedEventCount.fetch_add(1, std::memory_order_relaxed);
+		return false;
+	}
+	if (!m_Blocks[blockIndex]) {
+		m_Blocks[blockIndex] = std::make_unique<TRACE_EVENT[]>(TRACE_BLOCK_EVENT_COUNT);
+	}
+	m_Blocks[blockIndex][eventCount % TRACE_BLOCK_EVENT_COUNT] = traceEvent;
+	m_EventCount.store(eventCount + 1, std::memory_order_release);
+	return true;
+}
+
+const TRACE_EVENT &TraceThreadBuffer::GetEvent(_In_ INT64 index) const
+{
+	return m_Blocks[index / TRACE_BLOCK_EVENT_COUNT][index % TRACE_BLOCK_EVENT_COUNT];
+}
+
+TraceRecorder &TraceRecorder::Instance()
+{
+	//Never destroyed, as spans may still end on other threads when the module is unloaded
+	static TraceRecorder *recorder = new TraceRecorder();
+	return *recorder;
+}
+
+TraceRecorder::TraceRecorder() :
+	m_IsEnabled(false),
+	m_Session(0),
+	m_FrameNumber(0),
+	m_StartTime(0),
+	m_QPCFrequency{ 0 },
+	m_BuffersMutex{},
+	m_Buffers{}
+{
+	QueryPerformanceFrequency(&m_QPCFrequency);
+}
+
+void TraceRecorder::Start()
+{
+	std::scoped_lock lock(m_BuffersMutex);
+	m_Buffers.clear();
+	m_Session++;
+	m_FrameNumber = 0;
+	LARGE_INTEGER startTime;
+	QueryPerformanceCounter(&startTime);
+	m_StartTime = startTime.QuadPart;
+	m_IsEnabled = true;
+}
+
+void TraceRecorder::Stop()
+{
+	m_IsEnabled = false;
+}
+
+static thread_local const char *t_ThreadName = nullptr;
+
+TraceThreadBuffer *TraceRecorder::GetThreadBuffer()
+{
+	thread_local std::shared_ptr<TraceThreadBuffer> t_Buffer = nullptr;
+	UINT64 session = m_Session.load(std::memory_order_acquire);
+	if (!t_Buffer || t_Buffer->GetSession() != session) {
+		t_Buffer = std::make_shared<TraceThreadBuffer>(session);
+		t_Buffer->SetThreadName(t_ThreadName);
+		std::scoped_lock lock(m_BuffersMutex);
+		m_Buffers.push_back(t_Buffer);
+	}
+	return t_Buffer.get();
+}
+
+void TraceRecorder::SetThreadName(_In_ const char *name)
+{
+	t_ThreadName = name;
+	//Only threads that record events get a buffer
+	if (IsEnabled()) {
+		GetThreadBuffer()->SetThreadName(name);
+	}
+}
+
+void TraceRecorder::RecordSpan(_In_ const char *name, _In_ INT64 startTime, _In_ INT64 endTime)
+{
+	if (!IsEnabled()) {
+		return;
+	}
+	GetThreadBuffer()->TryAdd(TRACE_EVENT{ name, startTime, endTime - startTime, m_FrameNumber.load(std::memory_order_relaxed) });
+}
+
+HRESULT TraceRecorder::Write(_Inout_ std::ostream &stream)
+{
+	std::vector<std::shared_ptr<TraceThreadBuffer>> buffers;
+	UINT64 session;
+	INT64 startTime;
+	{
+		std::scoped_lock lock(m_BuffersMutex);
+		buffers = m_Buffers;
+		session = m_Session;
+		startTime = m_StartTime;
+	}
+	const double microsPerTick = 1000000.0 / m_QPCFrequency.QuadPart;
+	const DWORD processId = GetCurrentProcessId();
+	char line[256];
+	bool isFirstEvent = true;
+	stream << "{\"traceEvents\":[";
+	for each (auto buffer in buffers)
+	{
+		if (buffer->GetSession() != session) {
+			continue;
+		}
+		if (buffer->GetThreadName()) {
+			stream << (isFirstEvent ? "\n" : ",\n");
+			snprintf(line, sizeof(line), "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%lu,\"tid\":%lu,\"args\":{\"name\":", processId, buffer->GetThreadId());
+			stream << line;
+			WriteJsonString(stream, buffer->GetThreadName());
+			stream << "}}";
+			isFirstEvent = false;
+		}
+		INT64 eventCount = buffer->GetEventCount();
+		for (INT64 i = 0; i < eventCount; i++) {
+			const TRACE_EVENT &traceEvent = buffer->GetEvent(i);
+			stream << (isFirstEvent ? "\n" : ",\n");
+			stream << "{\"name\":";
+			WriteJsonString(stream, traceEvent.Name);
+			snprintf(line, sizeof(line), ",\"cat\":\"pipeline\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%lu,\"tid\":%lu,\"args\":{\"frame\":%lld}}",
+				(traceEvent.StartTime - startTime) * microsPerTick,
+				traceEvent.Duration * microsPerTick,
+				processId,
+				buffer->GetThreadId(),
+				traceEvent.FrameNumber);
+			stream << line;
+			isFirstEvent = false;
+		}
+	}
+	stream << "\n],\"displayTimeUnit\":\"ms\"}\n";
+	return stream.good() ? S_OK : E_FAIL;
+}
+
+HRESULT TraceRecorder::WriteToFile(_In_ std::wstring path)
+{
+	std::ofstream stream(path, ios_base::out | ios_base::trunc | ios_base::binary);
+	if (!stream.is_open()) {
+		LOG_ERROR(L"Failed to open trace file %ls", path.c_str());
+		return E_FAIL;
+	}
+	HRESULT hr = Write(stream);
+	TRACE_STATISTICS statistics = GetStatistics();
+	LOG_DEBUG(L"Wrote %lld trace events from %lld threads to %ls, %lld events were dropped", statistics.EventCount, statistics.ThreadCount, path.c_str(), statistics.DroppedEventCount);
+	return hr;
+}
+
+TRACE_STATISTICS TraceRecorder::GetStatistics()
+{
+	std::scoped_lock lock(m_BuffersMutex);
+	TRACE_STATISTICS statistics{};
+	for each (auto buffer in m_Buffers)
+	{
+		if (buffer->GetSession() == m_Session) {
+			statistics.EventCount += buffer->GetEventCount();
+			statistics.DroppedEventCount += buffer->GetDroppedEventCount();
+			statistics.ThreadCount++;
+		}
+	}
+	return statistics;
+}
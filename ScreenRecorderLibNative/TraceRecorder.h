@@ -0,0 +1,149 @@
+#pragma once
+#include <Windows.h>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+//Number of events in each block of a thread's trace buffer. Blocks are allocated as the buffer fills.
+#define TRACE_BLOCK_EVENT_COUNT 4096
+//Maximum number of blocks per thread, enough for a 10 minute recording at 60 fps. Events recorded after that are dropped.
+#define TRACE_MAX_BLOCKS_PER_THREAD 256
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+//Records the time until the end of the enclosing scope as a span with the given name, if tracing is enabled. The name must be a string literal.
+#define TRACE_SPAN(name) TraceSpan TRACE_CONCAT(traceSpan, __LINE__)(name)
+
+struct TRACE_EVENT {
+	// Name of the span. Must be a string literal, as it is only read when the trace is written.
+	const char *Name;
+	// QueryPerformanceCounter time the span started
+	INT64 StartTime;
+	// Duration of the span, in QueryPerformanceCounter ticks
+	INT64 Duration;
+	// Number of the frame the recorder was working on when the span ended
+	INT64 FrameNumber;
+};
+
+struct TRACE_STATISTICS {
+	INT64 EventCount;
+	// Events not recorded because the buffer of their thread was full
+	INT64 DroppedEventCount;
+	INT64 ThreadCount;
+};
+
+//
+// Append-only buffer of the trace events of one thread. Only the owning thread records events, without locks.
+// The events already recorded can be read from another thread at the same time.
+//
+class TraceThreadBuffer
+{
+public:
+	TraceThreadBuffer(_In_ UINT64 session);
+	bool TryAdd(_In_ const TRACE_EVENT &traceEvent);
+	/// <summary>
+	/// Returns the event at the index, which must be less than the event count.
+	/// </summary>
+	const TRACE_EVENT &GetEvent(_In_ INT64 index) const;
+	inline INT64 GetEventCount() const { return m_EventCount.load(std::memory_order_acquire); }
+	inline INT64 GetDroppedEventCount() const { return m_DroppedEventCount.load(std::memory_order_relaxed); }
+	inline UINT64 GetSession() const { return m_Session; }
+	inline DWORD GetThreadId() const { return m_ThreadId; }
+	inline const char *GetThreadName() const { return m_ThreadName.load(std::memory_order_acquire); }
+	inline void SetThreadName(_In_ const char *name) { m_ThreadName.store(name, std::memory_order_release); }
+private:
+	UINT64 m_Session;
+	DWORD m_ThreadId;
+	std::atomic<const char *> m_ThreadName;
+	std::unique_ptr<TRACE_EVENT[]> m_Blocks[TRACE_MAX_BLOCKS_PER_THREAD];
+	//Number of events recorded. Only written by the owning thread.
+	std::atomic<INT64> m_EventCount;
+	std::atomic<INT64> m_DroppedEventCount;
+};
+
+//
+// Records spans of the stages of the recording pipeline on all threads, tagged with the frame number of the recorder,
+// and writes them as a Chrome trace event file that can be loaded in chrome://tracing or Perfetto.
+// Recording an event is a performance counter read and a write to a buffer of the calling thread.
+//
+class TraceRecorder
+{
+public:
+	static TraceRecorder &Instance();
+	/// <summary>
+	/// Discards the events of the previous trace, and starts recording events.
+	/// </summary>
+	void Start();
+	void Stop();
+	inline bool IsEnabled() { return m_IsEnabled.load(std::memory_order_relaxed); }
+	/// <summary>
+	/// Sets the frame number that spans ending after this are tagged with.
+	/// </summary>
+	inline void SetFrameNumber(_In_ INT64 frameNumber) { m_FrameNumber.store(frameNumber, std::memory_order_relaxed); }
+	/// <summary>
+	/// Names the calling thread in the trace. The name must be a string literal.
+	/// </summary>
+	void SetThreadName(_In_ const char *name);
+	/// <summary>
+	/// Records a span on the calling thread, if tracing is enabled.
+	/// </summary>
+	/// <param name="startTime">QueryPerformanceCounter time the span started</param>
+	/// <param name="endTime">QueryPerformanceCounter time the span ended</param>
+	void RecordSpan(_In_ const char *name, _In_ INT64 startTime, _In_ INT64 endTime);
+	/// <summary>
+	/// Writes the recorded events in the Chrome trace event JSON format. Can be called while events are recorded.
+	/// </summary>
+	HRESULT Write(_Inout_ std::ostream &stream);
+	HRESULT WriteToFile(_In_ std::wstring path);
+	TRACE_STATISTICS GetStatistics();
+private:
+	TraceRecorder();
+	TraceThreadBuffer *GetThreadBuffer();
+
+	std::atomic<bool> m_IsEnabled;
+	std::atomic<UINT64> m_Session;
+	std::atomic<INT64> m_FrameNumber;
+	//QueryPerformanceCounter time the trace was started. Event times are written relative to it.
+	INT64 m_StartTime;
+	LARGE_INTEGER m_QPCFrequency;
+	std::mutex m_BuffersMutex;
+	std::vector<std::shared_ptr<TraceThreadBuffer>> m_Buffers;
+};
+
+//
+// Records the time from construction until destruction as a span, if tracing was enabled when it was constructed.
+//
+class TraceSpan
+{
+public:
+	TraceSpan(_In_ const char *name) :
+		m_Name(name),
+		m_StartTime{ 0 }
+	{
+		if (TraceRecorder::Instance().IsEnabled()) {
+			QueryPerformanceCounter(&m_StartTime);
+		}
+	}
+	~TraceSpan()
+	{
+		End();
+	}
+	/// <summary>
+	/// Ends the span before the end of its scope.
+	/// </summary>
+	void End()
+	{
+		if (m_StartTime.QuadPart != 0) {
+			LARGE_INTEGER endTime;
+			QueryPerformanceCounter(&endTime);
+			TraceRecorder::Instance().RecordSpan(m_Name, m_StartTime.QuadPart, endTime.QuadPart);
+			m_StartTime.QuadPart = 0;
+		}
+	}
+private:
+	const char *m_Name;
+	LARGE_INTEGER m_StartTime;
+};
@@ -0,0 +1,269 @@
+#include "TraceReplayCapture.h"
+#include "util.h"
+#include "cleanup.h"
+
+using namespace std;
+
+//Above this number of changed areas, the whole canvas is uploaded at once
+#define MAX_REPLAY_UPLOAD_RECTS 64
+
+TraceReplayCapture::TraceReplayCapture() :
+	m_Replay(nullptr),
+	m_Clock(nullptr),
+	m_Timer(nullptr),
+	m_Texture(nullptr),
+	m_Canvas{},
+	m_Speed(TraceReplaySpeed::RealTime),
+	m_HasFrame(false),
+	m_FrameCount(0),
+	m_PointerCount(0),
+	m_PresentedTime(-1),
+	m_SentPointerShape(nullptr)
+{
+}
+
+TraceReplayCapture::~TraceReplayCapture()
+{
+	if (m_Timer) {
+		m_Timer->StopTimer(true);
+	}
+	SafeRelease(&m_Device);
+	SafeRelease(&m_DeviceContext);
+}
+
+HRESULT TraceReplayCapture::Initialize(_In_ ID3D11DeviceContext *pDeviceContext, _In_ ID3D11Device *pDevice)
+{
+	m_Device = pDevice;
+	m_DeviceContext = pDeviceContext;
+
+	m_Device->AddRef();
+	m_DeviceContext->AddRef();
+
+	m_TextureManager = make_unique<TextureManager>();
+	return m_TextureManager->Initialize(pDeviceContext, pDevice);
+}
+
+HRESULT TraceReplayCapture::StartCapture(_In_ RECORDING_SOURCE_BASE &source)
+{
+	HRESULT hr;
+	m_RecordingSource = &source;
+	m_Replay = source.Replay;
+	if (!m_Replay) {
+		//The recorder loads the trace when a recording starts. Sources started without it load their own copy.
+		m_Replay = make_shared<CaptureTraceReplay>();
+		RETURN_ON_BAD_HR(hr = m_Replay->Load(source.SourcePath));
+	}
+	m_Clock = m_Replay->GetClock();
+	if (!m_Clock) {
+		m_Clock = make_shared<SystemMediaClock>();
+		m_Clock->Start();
+	}
+	m_Speed = source.ReplaySpeed;
+	m_Timer = make_unique<HighresTimer>();
+	m_Canvas.clear();
+	m_HasFrame = false;
+	m_FrameCount = 0;
+	m_PointerCount = 0;
+	m_PresentedTime = -1;
+	m_SentPointerShape = nullptr;
+	m_Texture.Release();
+	const CAPTURE_TRACE_HEADER &header = m_Replay->GetHeader();
+	RETURN_ON_BAD_HR(hr = m_TextureManager->CreateTexture(header.Width, header.Height, &m_Texture, 0, D3D11_BIND_SHADER_RESOURCE));
+	LOG_INFO(L"Started replay of capture trace of %ux%u with %zu frames", header.Width, header.Height, m_Replay->GetFrames().size());
+	return hr;
+}
+
+HRESULT TraceReplayCapture::GetNativeSize(_In_ RECORDING_SOURCE_BASE &recordingSource, _Out_ SIZE *nativeMediaSize)
+{
+	CAPTURE_TRACE_HEADER header{};
+	HRESULT hr = S_OK;
+	if (m_Replay) {
+		header = m_Replay->GetHeader();
+	}
+	else if (recordingSource.Replay) {
+		header = recordingSource.Replay->GetHeader();
+	}
+	else {
+		hr = CaptureTraceReplay::ReadHeader(recordingSource.SourcePath, &header);
+	}
+	*nativeMediaSize = SIZE{ static_cast<LONG>(header.Width), static_cast<LONG>(header.Height) };
+	return hr;
+}
+
+HRESULT TraceReplayCapture::AcquireNextFrame(_In_ DWORD timeoutMillis, _Outptr_opt_result_maybenull_ ID3D11Texture2D **ppFrame)
+{
+	if (ppFrame) {
+		*ppFrame = nullptr;
+	}
+	if (!m_Replay) {
+		LOG_ERROR("TraceReplayCapture must be started before acquiring frames");
+		return E_FAIL;
+	}
+	INT64 presentTime = GetPresentTime();
+	if (m_HasFrame && m_Replay->GetLastRecordTimeUntil(presentTime) <= m_PresentedTime) {
+		RETURN_ON_BAD_HR(WaitForNextRecord(timeoutMillis));
+		presentTime = GetPresentTime();
+		if (m_Replay->GetLastRecordTimeUntil(presentTime) <= m_PresentedTime) {
+			return DXGI_ERROR_WAIT_TIMEOUT;
+		}
+	}
+	HRESULT hr;
+	RETURN_ON_BAD_HR(hr = PresentRecords(presentTime));
+	QueryPerformanceCounter(&m_LastGrabTimeStamp);
+	if (ppFrame) {
+		*ppFrame = m_Texture;
+		(*ppFrame)->AddRef();
+	}
+	return hr;
+}
+
+HRESULT TraceReplayCapture::WriteNextFrameToSharedSurface(_In_ DWORD timeoutMillis, _Inout_ ID3D11Texture2D *pSharedSurf, INT offsetX, INT offsetY, _In_ RECT destinationRect, _In_opt_ ID3D11Texture2D *pTexture)
+{
+	if (!m_RecordingSource) {
+		LOG_ERROR(L"No recording source found in TraceReplayCapture");
+		return E_FAIL;
+	}
+	CComPtr<ID3D11Texture2D> pProcessedTexture;
+	HRESULT hr = E_FAIL;
+	if (pTexture) {
+		pProcessedTexture = pTexture;
+		hr = S_OK;
+	}
+	else if (m_HasFrame) {
+		//The capture loop acquires the frame before writing it, so the last uploaded frame is the one to write.
+		pProcessedTexture = m_Texture;
+		hr = S_OK;
+	}
+	else {
+		hr = AcquireNextFrame(timeoutMillis, &pProcessedTexture);
+		RETURN_ON_BAD_HR(hr);
+	}
+	D3D11_TEXTURE2D_DESC frameDesc;
+	pProcessedTexture->GetDesc(&frameDesc);
+	RECORDING_SOURCE *recordingSource = dynamic_cast<RECORDING_SOURCE *>(m_RecordingSource);
+	if (recordingSource && recordingSource->SourceRect.has_value()
+		&& IsValidRect(recordingSource->SourceRect.value())
+		&& (RectWidth(recordingSource->SourceRect.value()) != frameDesc.Width || (RectHeight(recordingSource->SourceRect.value()) != frameDesc.Height))) {
+		ID3D11Texture2D *pCroppedTexture;
+		RETURN_ON_BAD_HR(hr = m_TextureManager->CropTexture(pProcessedTexture, recordingSource->SourceRect.value(), &pCroppedTexture));
+		if (hr == S_OK) {
+			pProcessedTexture.Release();
+			pProcessedTexture.Attach(pCroppedTexture);
+		}
+	}
+	pProcessedTexture->GetDesc(&frameDesc);
+
+	RECT contentRect = destinationRect;
+	if (RectWidth(destinationRect) != frameDesc.Width || RectHeight(destinationRect) != frameDesc.Height) {
+		ID3D11Texture2D *pResizedTexture;
+		RETURN_ON_BAD_HR(hr = m_TextureManager->ResizeTexture(pProcessedTexture, SIZE{ RectWidth(destinationRect),RectHeight(destinationRect) }, m_RecordingSource->Stretch, &pResizedTexture, &contentRect));
+		pProcessedTexture.Release();
+		pProcessedTexture.Attach(pResizedTexture);
+	}
+	pProcessedTexture->GetDesc(&frameDesc);
+
+	SIZE contentOffset = GetContentOffset(m_RecordingSource->Anchor, destinationRect, contentRect);
+	long left = destinationRect.left + offsetX + contentOffset.cx;
+	long top = destinationRect.top + offsetY + contentOffset.cy;
+	long right = left + MakeEven(frameDesc.Width);
+	long bottom = top + MakeEven(frameDesc.Height);
+	m_TextureManager->DrawTexture(pSharedSurf, pProcessedTexture, RECT{ left,top,right,bottom });
+	SendBitmapCallback(pProcessedTexture);
+	return hr;
+}
+
+HRESULT TraceReplayCapture::GetMouse(_Inout_ PTR_INFO *pPtrInfo, _In_ RECT frameCoordinates, _In_ int offsetX, _In_ int offsetY)
+{
+	pPtrInfo->IsPointerShapeUpdated = false;
+	if (!m_Replay || m_PointerCount == 0) {
+		return S_FALSE;
+	}
+	const CAPTURE_TRACE_POINTER &pointer = m_Replay->GetPointers()[m_PointerCount - 1];
+	pPtrInfo->Position.x = pointer.Position.x + frameCoordinates.left + offsetX;
+	pPtrInfo->Position.y = pointer.Position.y + frameCoordinates.top + offsetY;
+	pPtrInfo->WhoUpdatedPositionLast = frameCoordinates;
+	pPtrInfo->LastTimeStamp = m_LastGrabTimeStamp;
+	pPtrInfo->Visible = pointer.Visible;
+	const CAPTURE_TRACE_POINTER *pShape = m_Replay->GetPointerShape(m_PointerCount - 1);
+	if (!pShape || (pShape == m_SentPointerShape && pPtrInfo->PtrShapeBuffer)) {
+		return S_OK;
+	}
+	UINT bufferSize = static_cast<UINT>(pShape->ShapeBuffer.size());
+	if (bufferSize > pPtrInfo->BufferSize) {
+		delete[] pPtrInfo->PtrShapeBuffer;
+		pPtrInfo->PtrShapeBuffer = new (std::nothrow) BYTE[bufferSize];
+		if (!pPtrInfo->PtrShapeBuffer) {
+			pPtrInfo->BufferSize = 0;
+			LOG_ERROR(L"Failed to allocate memory for pointer shape in TraceReplayCapture");
+			return E_OUTOFMEMORY;
+		}
+		pPtrInfo->BufferSize = bufferSize;
+	}
+	memcpy(pPtrInfo->PtrShapeBuffer, pShape->ShapeBuffer.data(), bufferSize);
+	pPtrInfo->ShapeInfo = pShape->ShapeInfo;
+	pPtrInfo->IsPointerShapeUpdated = true;
+	pPtrInfo->ShapeUpdateCount++;
+	m_SentPointerShape = pShape;
+	return S_OK;
+}
+
+void TraceReplayCapture::OnFramePublished()
+{
+	if (m_Replay) {
+		m_Replay->SetPresented(m_PresentedTime);
+	}
+}
+
+HRESULT TraceReplayCapture::PresentRecords(_In_ INT64 timeStamp)
+{
+	HRESULT hr = S_OK;
+	size_t frameCount = m_Replay->GetFrameCountUntil(timeStamp);
+	std::vector<RECT> dirtyRects{};
+	for (; m_FrameCount < frameCount; m_FrameCount++) {
+		RETURN_ON_BAD_HR(hr = m_Replay->ApplyFrame(m_FrameCount, &m_Canvas));
+		const std::vector<RECT> &frameRects = m_Replay->GetFrames()[m_FrameCount].DirtyRects;
+		dirtyRects.insert(dirtyRects.end(), frameRects.begin(), frameRects.end());
+	}
+	const CAPTURE_TRACE_HEADER &header = m_Replay->GetHeader();
+	if (dirtyRects.size() > MAX_REPLAY_UPLOAD_RECTS) {
+		dirtyRects.clear();
+		dirtyRects.push_back(RECT{ 0,0,static_cast<LONG>(header.Width),static_cast<LONG>(header.Height) });
+	}
+	const BYTE *pPixels = reinterpret_cast<const BYTE *>(m_Canvas.data());
+	UINT stride = header.Width * 4;
+	for each (RECT rect in dirtyRects) {
+		D3D11_BOX box{ static_cast<UINT>(rect.left), static_cast<UINT>(rect.top), 0, static_cast<UINT>(rect.right), static_cast<UINT>(rect.bottom), 1 };
+		const BYTE *pSource = pPixels + static_cast<size_t>(rect.top) * stride + static_cast<size_t>(rect.left) * 4;
+		m_DeviceContext->UpdateSubresource(m_Texture, 0, &box, pSource, stride, 0);
+	}
+	m_PointerCount = m_Replay->GetPointerCountUntil(timeStamp);
+	m_PresentedTime = m_Replay->GetLastRecordTimeUntil(timeStamp);
+	m_HasFrame = true;
+	return hr;
+}
+
+HRESULT TraceReplayCapture::WaitForNextRecord(_In_ DWORD timeoutMillis)
+{
+	if (m_Speed == TraceReplaySpeed::FullSpeed) {
+		m_Replay->WaitForPresentRequest(m_Clock->GetTime(), timeoutMillis);
+		return S_OK;
+	}
+	INT64 waitTime = static_cast<INT64>(timeoutMillis) * 10000;
+	std::optional<INT64> nextRecordTime = m_Replay->GetNextRecordTimeAfter(m_PresentedTime);
+	if (nextRecordTime.has_value()) {
+		waitTime = min(waitTime, nextRecordTime.value() - m_Clock->GetTime());
+	}
+	if (waitTime > 0) {
+		RETURN_ON_BAD_HR(m_Timer->WaitFor(waitTime));
+	}
+	return S_OK;
+}
+
+INT64 TraceReplayCapture::GetPresentTime()
+{
+	INT64 time = m_Clock->GetTime();
+	if (!m_HasFrame && !m_Replay->GetFrames().empty()) {
+		time = max(time, m_Replay->GetFrames().front().TimeStamp);
+	}
+	return time;
+}
@@ -0,0 +1,54 @@
+#pragma once
+#include "CaptureBase.h"
+#include "CommonTypes.h"
+#include "HighresTimer.h"
+#include "CaptureTrace.h"
+#include <atlbase.h>
+
+//
+// Replays the frames and mouse pointer of a capture trace recorded with RecordingManager::SetCaptureTraceFilePath.
+// Records are presented when they are due on the media clock of the recording, and only the areas of the canvas
+// that changed are uploaded to the texture. At full speed the source waits for the recorder to ask for the next records
+// instead of waiting for time to pass.
+//
+class TraceReplayCapture :public CaptureBase
+{
+public:
+	TraceReplayCapture();
+	~TraceReplayCapture();
+	virtual HRESULT Initialize(_In_ ID3D11DeviceContext *pDeviceContext, _In_ ID3D11Device *pDevice) override;
+	virtual HRESULT StartCapture(_In_ RECORDING_SOURCE_BASE &source) override;
+	virtual HRESULT GetNativeSize(_In_ RECORDING_SOURCE_BASE &recordingSource, _Out_ SIZE *nativeMediaSize) override;
+	virtual HRESULT AcquireNextFrame(_In_ DWORD timeoutMillis, _Outptr_opt_result_maybenull_ ID3D11Texture2D **ppFrame) override;
+	virtual HRESULT WriteNextFrameToSharedSurface(_In_ DWORD timeoutMillis, _Inout_ ID3D11Texture2D *pSharedSurf, INT offsetX, INT offsetY, _In_ RECT destinationRect, _In_opt_ ID3D11Texture2D *pTexture = nullptr) override;
+	virtual HRESULT GetMouse(_Inout_ PTR_INFO *pPtrInfo, _In_ RECT frameCoordinates, _In_ int offsetX, _In_ int offsetY) override;
+	virtual void OnFramePublished() override;
+	virtual inline std::wstring Name() override { return L"TraceReplayCapture"; };
+private:
+	/// <summary>
+	/// Applies the frames and pointer records up to the time, and uploads the areas of the canvas that changed.
+	/// </summary>
+	HRESULT PresentRecords(_In_ INT64 timeStamp);
+	/// <summary>
+	/// Waits until the next record is due, or the timeout has passed.
+	/// </summary>
+	HRESULT WaitForNextRecord(_In_ DWORD timeoutMillis);
+	/// <summary>
+	/// Returns the media time records are due at. The first frame is presented right away, so the recording has a frame to start with.
+	/// </summary>
+	INT64 GetPresentTime();
+
+	std::shared_ptr<CaptureTraceReplay> m_Replay;
+	//The clock of the recording, or a clock started with the capture when the source is replayed outside of a recording
+	std::shared_ptr<MediaClock> m_Clock;
+	std::unique_ptr<HighresTimer> m_Timer;
+	CComPtr<ID3D11Texture2D> m_Texture;
+	std::vector<UINT> m_Canvas;
+	TraceReplaySpeed m_Speed;
+	bool m_HasFrame;
+	size_t m_FrameCount;
+	size_t m_PointerCount;
+	//Time of the most recent record presented
+	INT64 m_PresentedTime;
+	const CAPTURE_TRACE_POINTER *m_SentPointerShape;
+};
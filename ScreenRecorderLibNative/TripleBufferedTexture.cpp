@@ -0,0 +1,156 @@
+#include "TripleBufferedTexture.h"
+#include "DX.util.h"
+#include "Log.h"
+#include "Util.h"
+#include "Cleanup.h"
+
+TripleBufferedTexture::TripleBufferedTexture() :
+	m_Slots{},
+	m_PendingState(1),
+	m_BackIndex(0),
+	m_FrontIndex(2),
+	m_HasFrontBuffer(false),
+	m_IsBackBufferAcquired(false),
+	m_IsFrontBufferAcquired(false),
+	m_Size{},
+	m_QPCFrequency{},
+	m_PublishedFrameCount(0),
+	m_DroppedFrameCount(0),
+	m_LateFrameCount(0)
+{
+	QueryPerformanceFrequency(&m_QPCFrequency);
+	InitializeCriticalSection(&m_ConsumerCriticalSection);
+}
+
+TripleBufferedTexture::~TripleBufferedTexture()
+{
+	DeleteCriticalSection(&m_ConsumerCriticalSection);
+}
+
+HRESULT TripleBufferedTexture::Initialize(_In_ ID3D11Device *pProducerDevice, _In_ UINT width, _In_ UINT height)
+{
+	D3D11_TEXTURE2D_DESC desc;
+	RtlZeroMemory(&desc, sizeof(D3D11_TEXTURE2D_DESC));
+	desc.Width = width;
+	desc.Height = height;
+	desc.MipLevels = 1;
+	desc.ArraySize = 1;
+	desc.Format = DXGI_FORMAT_B8G8R8A8_UNORM;
+	desc.SampleDesc.Count = 1;
+	desc.Usage = D3D11_USAGE_DEFAULT;
+	desc.BindFlags = D3D11_BIND_RENDER_TARGET | D3D11_BIND_SHADER_RESOURCE;
+	desc.CPUAccessFlags = 0;
+	desc.MiscFlags = D3D11_RESOURCE_MISC_SHARED_KEYEDMUTEX;
+
+	for (UINT i = 0; i < BUFFER_COUNT; i++) {
+		BUFFER_SLOT &slot = m_Slots[i];
+		slot.ProducerTexture.Release();
+		slot.ProducerMutex.Release();
+		slot.ConsumerTexture.Release();
+		slot.ConsumerMutex.Release();
+		HRESULT hr = pProducerDevice->CreateTexture2D(&desc, nullptr, &slot.ProducerTexture);
+		if (FAILED(hr)) {
+			LOG_ERROR(L"Failed to create frame buffer texture: hr = 0x%08x", hr);
+			return hr;
+		}
+		RETURN_ON_BAD_HR(hr = slot.ProducerTexture->QueryInterface(__uuidof(IDXGIKeyedMutex), reinterpret_cast<void **>(&slot.ProducerMutex)));
+		slot.SharedHandle = GetSharedHandle(slot.ProducerTexture);
+		if (!slot.SharedHandle) {
+			LOG_ERROR(L"Failed to get shared handle for frame buffer texture");
+			return E_FAIL;
+		}
+		slot.PublishTimeStamp = {};
+	}
+	m_Size = SIZE{ static_cast<LONG>(width),static_cast<LONG>(height) };
+	m_BackIndex = 0;
+	m_PendingState = 1;
+	m_FrontIndex = 2;
+	m_HasFrontBuffer = false;
+	m_IsBackBufferAcquired = false;
+	m_IsFrontBufferAcquired = false;
+	return S_OK;
+}
+
+HRESULT TripleBufferedTexture::GetBackBuffer(_Outptr_ ID3D11Texture2D **ppBackBuffer)
+{
+	*ppBackBuffer = nullptr;
+	BUFFER_SLOT &slot = m_Slots[m_BackIndex];
+	if (!m_IsBackBufferAcquired) {
+		RETURN_ON_BAD_HR(AcquireSync(slot.ProducerMutex));
+		m_IsBackBufferAcquired = true;
+	}
+	*ppBackBuffer = slot.ProducerTexture;
+	return S_OK;
+}
+
+void TripleBufferedTexture::Publish()
+{
+	if (m_IsBackBufferAcquired) {
+		//Releasing the keyed mutex submits the queued writes, and makes the consumer device wait for them before it reads the buffer.
+		m_Slots[m_BackIndex].ProducerMutex->ReleaseSync(0);
+		m_IsBackBufferAcquired = false;
+	}
+	QueryPerformanceCounter(&m_Slots[m_BackIndex].PublishTimeStamp);
+	UINT8 previousState = m_PendingState.exchange(m_BackIndex | NEW_FRAME_FLAG, std::memory_order_acq_rel);
+	m_BackIndex = previousState & BUFFER_INDEX_MASK;
+	m_PublishedFrameCount++;
+	if (previousState & NEW_FRAME_FLAG) {
+		//The previous frame was never picked up by the compositor before it was replaced.
+		m_DroppedFrameCount++;
+	}
+}
+
+HRESULT TripleBufferedTexture::AcquireLatest(_In_ ID3D11Device *pConsumerDevice, _In_ double lateThresholdMillis, _Outptr_result_maybenull_ ID3D11Texture2D **ppFrame)
+{
+	*ppFrame = nullptr;
+	EnterCriticalSection(&m_ConsumerCriticalSection);
+	LeaveCriticalSectionOnExit leaveCriticalSection(&m_ConsumerCriticalSection);
+	HRESULT hr = S_FALSE;
+	if (m_PendingState.load(std::memory_order_acquire) & NEW_FRAME_FLAG) {
+		//The current front buffer is handed back to the producer, so the reads queued on it are released first.
+		if (m_IsFrontBufferAcquired) {
+			m_Slots[m_FrontIndex].ConsumerMutex->ReleaseSync(0);
+			m_IsFrontBufferAcquired = false;
+		}
+		UINT8 previousState = m_PendingState.exchange(m_FrontIndex, std::memory_order_acq_rel);
+		m_FrontIndex = previousState & BUFFER_INDEX_MASK;
+		m_HasFrontBuffer = true;
+		hr = S_OK;
+
+		LARGE_INTEGER now;
+		QueryPerformanceCounter(&now);
+		double waitedMillis = static_cast<double>(now.QuadPart - m_Slots[m_FrontIndex].PublishTimeStamp.QuadPart) * 1000 / m_QPCFrequency.QuadPart;
+		if (lateThresholdMillis > 0 && waitedMillis > lateThresholdMillis) {
+			m_LateFrameCount++;
+		}
+	}
+	if (!m_HasFrontBuffer) {
+		return S_FALSE;
+	}
+	BUFFER_SLOT &slot = m_Slots[m_FrontIndex];
+	if (!slot.ConsumerTexture) {
+		RETURN_ON_BAD_HR(pConsumerDevice->OpenSharedResource(slot.SharedHandle, __uuidof(ID3D11Texture2D), reinterpret_cast<void **>(&slot.ConsumerTexture)));
+		RETURN_ON_BAD_HR(slot.ConsumerTexture->QueryInterface(__uuidof(IDXGIKeyedMutex), reinterpret_cast<void **>(&slot.ConsumerMutex)));
+	}
+	if (!m_IsFrontBufferAcquired) {
+		RETURN_ON_BAD_HR(AcquireSync(slot.ConsumerMutex));
+		m_IsFrontBufferAcquired = true;
+	}
+	*ppFrame = slot.ConsumerTexture;
+	return hr;
+}
+
+HRESULT TripleBufferedTexture::AcquireSync(_In_ IDXGIKeyedMutex *pMutex)
+{
+	HRESULT hr = pMutex->AcquireSync(0, FRAME_BUFFER_SYNC_TIMEOUT_MILLIS);
+	if (hr == static_cast<HRESULT>(WAIT_TIMEOUT)) {
+		LOG_WARN(L"Timed out waiting for the keyed mutex of a frame buffer");
+		return DXGI_ERROR_WAIT_TIMEOUT;
+	}
+	else if (hr == static_cast<HRESULT>(WAIT_ABANDONED)) {
+		//The other device was lost while it held the buffer
+		LOG_ERROR(L"The keyed mutex of a frame buffer was abandoned");
+		return E_FAIL;
+	}
+	return hr;
+}
@@ -0,0 +1,93 @@
+#pragma once
+#include <d3d11.h>
+#include <atlbase.h>
+#include <atomic>
+
+//Longest time to wait for the GPU work of the other device on a buffer to finish, before giving up on the frame.
+#define FRAME_BUFFER_SYNC_TIMEOUT_MILLIS 500
+
+//
+// Three shared textures that let a capture source hand frames to the compositor without either side waiting on the other.
+// The producer always owns a back buffer to draw into, the consumer owns the front buffer it is reading from,
+// and the third buffer holds the newest completed frame. Publishing and acquiring are a single atomic exchange of buffer indices.
+// The buffers are created with a keyed mutex, which each device holds while it uses a buffer. This orders the GPU work of the two devices,
+// so a buffer is not written by the producer while a copy from it is still queued on the consumer device, or read before the write has finished.
+//
+class TripleBufferedTexture
+{
+public:
+	TripleBufferedTexture();
+	~TripleBufferedTexture();
+
+	/// <summary>
+	/// Creates the three shared textures on the producer device.
+	/// </summary>
+	/// <param name="pProducerDevice">The device the producer renders with</param>
+	/// <param name="width">Width of the buffers</param>
+	/// <param name="height">Height of the buffers</param>
+	HRESULT Initialize(_In_ ID3D11Device *pProducerDevice, _In_ UINT width, _In_ UINT height);
+
+	/// <summary>
+	/// Gets the buffer the producer should write the next frame into, and acquires its keyed mutex on the producer device.
+	/// Waits for queued reads of the buffer on the consumer device to finish.
+	/// </summary>
+	/// <param name="ppBackBuffer">The back buffer. The texture is owned by this instance.</param>
+	HRESULT GetBackBuffer(_Outptr_ ID3D11Texture2D **ppBackBuffer);
+
+	/// <summary>
+	/// Releases the keyed mutex of the back buffer, publishes it as the newest completed frame and hands the producer a new back buffer.
+	/// Does not wait for the consumer.
+	/// </summary>
+	void Publish();
+
+	/// <summary>
+	/// Gets the newest completed frame, opened on the consumer device. Never waits for the producer to publish, but calls from multiple consumer threads are serialized.
+	/// The consumer device holds the keyed mutex of the returned frame until a newer frame is acquired, so the frame can be read until then.
+	/// </summary>
+	/// <param name="pConsumerDevice">The device the compositor renders with</param>
+	/// <param name="lateThresholdMillis">A frame that waited longer than this before being acquired is counted as late</param>
+	/// <param name="ppFrame">The newest frame, or nullptr if nothing has been published yet. The texture is owned by this instance.</param>
+	/// <returns>S_OK if a new frame was acquired since the last call, S_FALSE if the previous frame is returned again, else an error code</returns>
+	HRESULT AcquireLatest(_In_ ID3D11Device *pConsumerDevice, _In_ double lateThresholdMillis, _Outptr_result_maybenull_ ID3D11Texture2D **ppFrame);
+
+	inline SIZE GetSize() { return m_Size; }
+	/// <summary>Total number of frames published by the producer.</summary>
+	inline INT64 GetPublishedFrameCount() { return m_PublishedFrameCount; }
+	/// <summary>Number of published frames that were replaced by a newer frame before the compositor read them.</summary>
+	inline INT64 GetDroppedFrameCount() { return m_DroppedFrameCount; }
+	/// <summary>Number of frames that waited longer than the late threshold before the compositor read them.</summary>
+	inline INT64 GetLateFrameCount() { return m_LateFrameCount; }
+private:
+	static const UINT BUFFER_COUNT = 3;
+	static const UINT8 BUFFER_INDEX_MASK = 0x3;
+	static const UINT8 NEW_FRAME_FLAG = 0x4;
+
+	struct BUFFER_SLOT {
+		CComPtr<ID3D11Texture2D> ProducerTexture;
+		CComPtr<IDXGIKeyedMutex> ProducerMutex;
+		CComPtr<ID3D11Texture2D> ConsumerTexture;
+		CComPtr<IDXGIKeyedMutex> ConsumerMutex;
+		HANDLE SharedHandle;
+		LARGE_INTEGER PublishTimeStamp;
+	};
+	/// <summary>
+	/// Acquires the keyed mutex, turning a timeout into an error.
+	/// </summary>
+	static HRESULT AcquireSync(_In_ IDXGIKeyedMutex *pMutex);
+	BUFFER_SLOT m_Slots[BUFFER_COUNT];
+	//Index of the newest completed buffer, combined with NEW_FRAME_FLAG if the consumer has not yet picked it up.
+	std::atomic<UINT8> m_PendingState;
+	UINT8 m_BackIndex;
+	UINT8 m_FrontIndex;
+	bool m_HasFrontBuffer;
+	// True while the producer device holds the keyed mutex of the back buffer
+	bool m_IsBackBufferAcquired;
+	// True while the consumer device holds the keyed mutex of the front buffer
+	bool m_IsFrontBufferAcquired;
+	CRITICAL_SECTION m_ConsumerCriticalSection;
+	SIZE m_Size;
+	LARGE_INTEGER m_QPCFrequency;
+	std::atomic<INT64> m_PublishedFrameCount;
+	std::atomic<INT64> m_DroppedFrameCount;
+	std::atomic<INT64> m_LateFrameCount;
+};
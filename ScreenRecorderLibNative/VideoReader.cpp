@@ -200,8 +200,11 @@ HRESULT VideoReader::InitializeSourceReader(
 								LOG_ON_BAD_HR(hr);
 							}
 						}
+						//There is no media transform for frames that are drawn in their native format
 						*ppMediaTransform = pMediaTransform;
-						(*ppMediaTransform)->AddRef();
+						if (*ppMediaTransform) {
+							(*ppMediaTransform)->AddRef();
+						}
 					}
 					*pStreamIndex = streamIndex;
 					foundValidTopology = true;
@@ -2,6 +2,9 @@
 #include "SourceReaderBase.h"
 #include "MF.util.h"
 
+//Number of decoded frames kept ahead of playback, which also covers the seek back to the start when the video loops.
+#define VIDEO_READER_LOOKAHEAD_FRAMES 4
+
 class VideoReader :public SourceReaderBase
 {
 public:
@@ -9,6 +12,7 @@ public:
 	virtual ~VideoReader();
 	virtual inline std::wstring Name() override { return L"VideoReader"; };
 protected:
+	virtual inline UINT GetLookaheadFrameCount() override { return VIDEO_READER_LOOKAHEAD_FRAMES; }
 	virtual HRESULT InitializeSourceReader(
 		_In_ std::wstring filePath,
 		_In_ std::optional<long> sourceFormatIndex,
@@ -7,6 +7,8 @@
 #include "DynamicWait.h"
 #include "WASAPINotify.h"
 #include "Exception.h"
+#include "TraceRecorder.h"
+#include "FlightRecorder.h"
 
 using namespace std;
 
@@ -273,6 +275,7 @@ HRESULT WASAPICapture::StartCaptureLoop(
 		_In_ HANDLE hRestartEvent
 ) {
 	HRESULT hr = S_OK;
+	TraceRecorder::Instance().SetThreadName("Audio capture");
 	WAVEFORMATEX *pwfx;
 	RETURN_ON_BAD_HR(hr = GetWaveFormat(pAudioClient, true, &pwfx));
 	CoTaskMemFreeOnExit freeMixFormat(pwfx);
@@ -353,6 +356,7 @@ HRESULT WASAPICapture::StartCaptureLoop(
 				SUCCEEDED(hr) && nNextPacketSize > 0;
 				hr = pAudioCaptureClient->GetNextPacketSize(&nNextPacketSize)
 				) {
+				TRACE_SPAN("CaptureAudioPacket");
 				// get the captured data
 				BYTE *pData;
 				UINT32 nNumFramesToRead;
@@ -379,6 +383,7 @@ HRESULT WASAPICapture::StartCaptureLoop(
 					else {
 						LOG_DEBUG(L"IAudioCaptureClient::GetBuffer set flags to 0x%08x on pass %u after %u frames on %ls", dwFlags, nPasses, nFrames, m_Tag.c_str());
 						isDiscontinuity = true;
+						FlightRecorder::Instance().Record(FlightEventType::AudioDiscontinuity, S_OK, static_cast<INT64>(nDevicePosition), m_Flow == eCapture ? 1 : 0);
 					}
 				}
 				else if ((dwFlags & AUDCLNT_BUFFERFLAGS_SILENT) != 0) {
@@ -409,14 +414,12 @@ HRESULT WASAPICapture::StartCaptureLoop(
 #pragma warning(disable: 26110)
 				const std::lock_guard<std::mutex> lock(m_TaskWrapperImpl->m_Mutex);
 #pragma prefast(suppress: __WARNING_INCORRECT_ANNOTATION, "IAudioCaptureClient::GetBuffer SAL annotation implies a 1-byte buffer")
-				if (m_RecordedBytes.size() == 0)
-					m_RecordedBytes.reserve(size);
-				m_RecordedBytes.insert(m_RecordedBytes.end(), &bufferData[0], &bufferData[size]);
+				m_RecordedBytes.Append(bufferData, size);
 				//This should reduce glitching if there is discontinuity in the audio stream.
 				if (isDiscontinuity) {
 					UINT64 frameDiff = nDevicePosition - nLastDevicePosition;
 					if (frameDiff != nNumFramesToRead) {
-						m_RecordedBytes.insert(m_RecordedBytes.begin(), (size_t)(frameDiff * nBlockAlign), 0);
+						m_RecordedBytes.PrependSilence((size_t)(frameDiff * nBlockAlign));
 						LOG_DEBUG(L"Discontinuity detected, padded audio bytes with %d bytes of silence on %ls", frameDiff, m_Tag.c_str());
 					}
 				}
@@ -458,7 +461,7 @@ HRESULT WASAPICapture::StartCaptureLoop(
 }
 std::vector<BYTE> WASAPICapture::PeakRecordedBytes()
 {
-	return m_RecordedBytes;
+	return m_RecordedBytes.Peek();
 }
 
 std::vector<BYTE> WASAPICapture::GetRecordedBytes(UINT64 duration100Nanos)
@@ -468,10 +471,9 @@ std::vector<BYTE> WASAPICapture::GetRecordedBytes(UINT64 duration100Nanos)
 	size_t byteCount;
 	{
 		const std::lock_guard<std::mutex> lock(m_TaskWrapperImpl->m_Mutex);
-		byteCount = min((frameCount * m_InputFormat.FrameBytes()), m_RecordedBytes.size());
-		newvector = std::vector<BYTE>(m_RecordedBytes.begin(), m_RecordedBytes.begin() + byteCount);
-		m_RecordedBytes.erase(m_RecordedBytes.begin(), m_RecordedBytes.begin() + byteCount);
-		LOG_TRACE(L"Got %d bytes from WASAPICapture %ls. %d bytes remaining", newvector.size(), m_Tag.c_str(), m_RecordedBytes.size());
+		newvector = m_RecordedBytes.Take(frameCount * m_InputFormat.FrameBytes());
+		byteCount = newvector.size();
+		LOG_TRACE(L"Got %d bytes from WASAPICapture %ls. %d bytes remaining", newvector.size(), m_Tag.c_str(), m_RecordedBytes.GetSize());
 
 		// convert audio
 		if (m_Resampler && byteCount > 0) {
@@ -514,7 +516,7 @@ HRESULT WASAPICapture::StartCapture()
 			}
 			return hr;
 		}
-		m_RecordedBytes.clear();
+		m_RecordedBytes.Clear();
 	}
 	if (m_TaskWrapperImpl->m_CaptureThread.joinable()) {
 		SetEvent(m_CaptureStopEvent);
@@ -648,6 +650,12 @@ bool WASAPICapture::StopListeners() {
 	return true;
 }
 
+size_t WASAPICapture::GetRecordedByteCount()
+{
+	const std::lock_guard<std::mutex> lock(m_TaskWrapperImpl->m_Mutex);
+	return m_RecordedBytes.GetSize() + m_OverflowBytes.size();
+}
+
 void WASAPICapture::ReturnAudioBytesToBuffer(std::vector<BYTE> bytes)
 {
 	m_OverflowBytes.swap(bytes);
@@ -690,7 +698,7 @@ bool WASAPICapture::IsCapturing() {
 void WASAPICapture::ClearRecordedBytes()
 {
 	const std::lock_guard<std::mutex> lock(m_TaskWrapperImpl->m_Mutex);
-	m_RecordedBytes.clear();
+	m_RecordedBytes.Clear();
 }
 
 HRESULT WASAPICapture::ReconnectThreadLoop() {
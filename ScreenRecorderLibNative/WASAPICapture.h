@@ -1,6 +1,7 @@
 //https://github.com/mvaneerde/blog/tree/master/loopback-capture
 #pragma once
 #include "WWMFResampler.h"
+#include "AudioSamples.h"
 #include "Log.h"
 #include "CommonTypes.h"
 #include "DynamicWait.h"
@@ -27,6 +28,10 @@ public:
 	bool IsCapturing();
 	std::vector<BYTE> PeakRecordedBytes();
 	std::vector<BYTE> GetRecordedBytes(UINT64 duration100Nanos);
+	/// <summary>
+	/// Returns the number of captured bytes waiting to be read with GetRecordedBytes.
+	/// </summary>
+	size_t GetRecordedByteCount();
 	HRESULT Initialize(_In_ std::wstring deviceId, _In_ EDataFlow flow);
 	HRESULT StartCapture();
 	HRESULT StopCapture();
@@ -82,7 +87,7 @@ private:
 	std::atomic<bool> m_IsCapturing = false;
 	std::atomic<bool> m_IsOffline = false;
 	std::vector<BYTE> m_OverflowBytes = {};
-	std::vector<BYTE> m_RecordedBytes = {};
+	AudioSampleQueue m_RecordedBytes;
 	HANDLE m_CaptureStartedEvent = nullptr;
 	HANDLE m_CaptureStopEvent = nullptr;
 	HANDLE m_CaptureRestartEvent = nullptr;
@@ -0,0 +1,137 @@
+#include "YuvConversion.h"
+#include <cmath>
+
+//Number of fractional bits of the fixed point coefficients used by the kernels.
+static const int FIXED_POINT_BITS = 16;
+
+//
+// The conversion matrix in fixed point, for 8 bit samples. The offsets include the rounding of the result.
+//
+struct FIXED_POINT_MATRIX {
+	INT32 R[4];
+	INT32 G[4];
+	INT32 B[4];
+};
+
+YUV_TO_RGB_MATRIX GetYuvToRgbMatrix(_In_ YuvMatrix matrix, _In_ bool isFullRange)
+{
+	//Weights of red and blue in the luma of each matrix
+	double kr = matrix == YuvMatrix::BT709 ? 0.2126 : 0.299;
+	double kb = matrix == YuvMatrix::BT709 ? 0.0722 : 0.114;
+	double kg = 1.0 - kr - kb;
+	//Video range samples are scaled up to the full range
+	double yOffset = isFullRange ? 0.0 : 16.0 / 255;
+	double yScale = isFullRange ? 1.0 : 255.0 / 219;
+	double chromaScale = isFullRange ? 1.0 : 255.0 / 224;
+	double chromaOffset = 128.0 / 255;
+
+	auto setRow = [&](float(&row)[4], double u, double v) {
+		row[0] = static_cast<float>(yScale);
+		row[1] = static_cast<float>(u * chromaScale);
+		row[2] = static_cast<float>(v * chromaScale);
+		row[3] = static_cast<float>(-yScale * yOffset - (u + v) * chromaScale * chromaOffset);
+	};
+	YUV_TO_RGB_MATRIX result;
+	setRow(result.R, 0, 2 * (1 - kr));
+	setRow(result.G, -2 * (1 - kb) * kb / kg, -2 * (1 - kr) * kr / kg);
+	setRow(result.B, 2 * (1 - kb), 0);
+	return result;
+}
+
+UINT GetYuvFrameBufferSize(_In_ YuvPixelFormat format, _In_ LONG stride, _In_ UINT height)
+{
+	UINT rowSize = static_cast<UINT>(abs(stride));
+	switch (format)
+	{
+		case YuvPixelFormat::NV12:
+			return rowSize * height + rowSize * ((height + 1) / 2);
+		case YuvPixelFormat::YUY2:
+		default:
+			return rowSize * height;
+	}
+}
+
+static FIXED_POINT_MATRIX ToFixedPoint(_In_ const YUV_TO_RGB_MATRIX &matrix)
+{
+	const double scale = 1 << FIXED_POINT_BITS;
+	auto convertRow = [&](INT32(&fixedRow)[4], const float(&row)[4]) {
+		for (int i = 0; i < 3; i++) {
+			fixedRow[i] = static_cast<INT32>(lround(row[i] * scale));
+		}
+		//The offset applies to results in the 0-255 range
+		fixedRow[3] = static_cast<INT32>(lround(row[3] * 255 * scale)) + (1 << (FIXED_POINT_BITS - 1));
+	};
+	FIXED_POINT_MATRIX result;
+	convertRow(result.R, matrix.R);
+	convertRow(result.G, matrix.G);
+	convertRow(result.B, matrix.B);
+	return result;
+}
+
+static inline UINT ToByte(_In_ INT32 value)
+{
+	if (value < 0) {
+		return 0;
+	}
+	value >>= FIXED_POINT_BITS;
+	return value > 255 ? 255 : static_cast<UINT>(value);
+}
+
+//
+// Converts one pair of pixels that share U and V samples. The chroma terms are calculated once for both pixels,
+// and Y has the same weight in R, G and B.
+//
+static inline void ConvertPixelPair(_In_ const FIXED_POINT_MATRIX &m, _In_ INT32 y0, _In_ INT32 y1, _In_ INT32 u, _In_ INT32 v, _Out_ UINT *pPixels, _In_ bool hasSecondPixel)
+{
+	INT32 r = m.R[1] * u + m.R[2] * v + m.R[3];
+	INT32 g = m.G[1] * u + m.G[2] * v + m.G[3];
+	INT32 b = m.B[1] * u + m.B[2] * v + m.B[3];
+	INT32 luma = m.R[0] * y0;
+	pPixels[0] = 0xFF000000 | (ToByte(luma + r) << 16) | (ToByte(luma + g) << 8) | ToByte(luma + b);
+	if (hasSecondPixel) {
+		luma = m.R[0] * y1;
+		pPixels[1] = 0xFF000000 | (ToByte(luma + r) << 16) | (ToByte(luma + g) << 8) | ToByte(luma + b);
+	}
+}
+
+void ConvertNV12ToBGRA(_In_ const BYTE *pLuma, _In_ LONG lumaStride, _In_ const BYTE *pChroma, _In_ LONG chromaStride, _In_ UINT width, _In_ UINT height, _In_ const YUV_TO_RGB_MATRIX &matrix, _Out_ BYTE *pDestination, _In_ LONG destinationStride)
+{
+	FIXED_POINT_MATRIX m = ToFixedPoint(matrix);
+	for (UINT row = 0; row < height; row++) {
+		const BYTE *pLumaRow = pLuma + static_cast<INT64>(row) * lumaStride;
+		const BYTE *pChromaRow = pChroma + static_cast<INT64>(row / 2) * chromaStride;
+		UINT *pOutput = reinterpret_cast<UINT *>(pDestination + static_cast<INT64>(row) * destinationStride);
+		for (UINT x = 0; x < width; x += 2) {
+			bool hasSecondPixel = x + 1 < width;
+			ConvertPixelPair(m, pLumaRow[x], hasSecondPixel ? pLumaRow[x + 1] : 0, pChromaRow[x], pChromaRow[x + 1], pOutput + x, hasSecondPixel);
+		}
+	}
+}
+
+void ConvertYUY2ToBGRA(_In_ const BYTE *pSource, _In_ LONG sourceStride, _In_ UINT width, _In_ UINT height, _In_ const YUV_TO_RGB_MATRIX &matrix, _Out_ BYTE *pDestination, _In_ LONG destinationStride)
+{
+	FIXED_POINT_MATRIX m = ToFixedPoint(matrix);
+	for (UINT row = 0; row < height; row++) {
+		const BYTE *pSourceRow = pSource + static_cast<INT64>(row) * sourceStride;
+		UINT *pOutput = reinterpret_cast<UINT *>(pDestination + static_cast<INT64>(row) * destinationStride);
+		for (UINT x = 0; x < width; x += 2) {
+			//Each group of 4 bytes holds Y0 U Y1 V
+			const BYTE *pGroup = pSourceRow + x * 2;
+			ConvertPixelPair(m, pGroup[0], pGroup[2], pGroup[1], pGroup[3], pOutput + x, x + 1 < width);
+		}
+	}
+}
+
+void ConvertYuvFrameToBGRA(_In_ YuvPixelFormat format, _In_ const BYTE *pSource, _In_ LONG sourceStride, _In_ UINT width, _In_ UINT height, _In_ const YUV_TO_RGB_MATRIX &matrix, _Out_ BYTE *pDestination, _In_ LONG destinationStride)
+{
+	switch (format)
+	{
+		case YuvPixelFormat::NV12:
+			//The chroma plane follows the luma plane, with the same stride
+			ConvertNV12ToBGRA(pSource, sourceStride, pSource + static_cast<INT64>(sourceStride) * height, sourceStride, width, height, matrix, pDestination, destinationStride);
+			break;
+		case YuvPixelFormat::YUY2:
+			ConvertYUY2ToBGRA(pSource, sourceStride, width, height, matrix, pDestination, destinationStride);
+			break;
+	}
+}
@@ -0,0 +1,55 @@
+#pragma once
+#include <Windows.h>
+
+//
+// Conversion of YUV frames from cameras and video decoders to BGRA.
+// Frames are normally uploaded as planes and converted by the YUV pixel shader while they are drawn.
+// The kernels here are the reference for that conversion, and are used when the device cannot sample the planes.
+//
+
+enum class YuvPixelFormat {
+	///<summary>A plane of 8 bit Y samples, followed by a plane of interleaved U and V samples at half the width and height.</summary>
+	NV12,
+	///<summary>Packed Y0 U Y1 V samples, with U and V shared by each pair of pixels in a row.</summary>
+	YUY2
+};
+
+enum class YuvMatrix {
+	BT601,
+	BT709
+};
+
+//
+// Converts normalized Y, U and V values to R, G and B. Each row holds the coefficients of Y, U and V, followed by an offset.
+// The layout matches the constant buffer of the YUV pixel shader.
+//
+struct YUV_TO_RGB_MATRIX {
+	float R[4];
+	float G[4];
+	float B[4];
+};
+
+/// <summary>
+/// Returns the conversion for the matrix, for samples in the full 0-255 range or the 16-235 (Y) and 16-240 (U,V) video range.
+/// </summary>
+YUV_TO_RGB_MATRIX GetYuvToRgbMatrix(_In_ YuvMatrix matrix, _In_ bool isFullRange);
+
+/// <summary>
+/// Returns the size in bytes of a frame of the format, with the given stride of the Y plane or packed samples.
+/// </summary>
+UINT GetYuvFrameBufferSize(_In_ YuvPixelFormat format, _In_ LONG stride, _In_ UINT height);
+
+/// <summary>
+/// Converts an NV12 frame to BGRA pixels. U and V samples are shared by each 2x2 block of pixels.
+/// </summary>
+void ConvertNV12ToBGRA(_In_ const BYTE *pLuma, _In_ LONG lumaStride, _In_ const BYTE *pChroma, _In_ LONG chromaStride, _In_ UINT width, _In_ UINT height, _In_ const YUV_TO_RGB_MATRIX &matrix, _Out_ BYTE *pDestination, _In_ LONG destinationStride);
+
+/// <summary>
+/// Converts a YUY2 frame to BGRA pixels.
+/// </summary>
+void ConvertYUY2ToBGRA(_In_ const BYTE *pSource, _In_ LONG sourceStride, _In_ UINT width, _In_ UINT height, _In_ const YUV_TO_RGB_MATRIX &matrix, _Out_ BYTE *pDestination, _In_ LONG destinationStride);
+
+/// <summary>
+/// Converts a contiguous frame of the format, as laid out in a Media Foundation buffer, to BGRA pixels.
+/// </summary>
+void ConvertYuvFrameToBGRA(_In_ YuvPixelFormat format, _In_ const BYTE *pSource, _In_ LONG sourceStride, _In_ UINT width, _In_ UINT height, _In_ const YUV_TO_RGB_MATRIX &matrix, _Out_ BYTE *pDestination, _In_ LONG destinationStride);
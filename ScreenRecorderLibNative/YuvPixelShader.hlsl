@@ -0,0 +1,37 @@
+//----------------------------------------------------------------------
+// Converts a YUV frame uploaded as planes to RGB while it is drawn.
+// NV12 frames are drawn from an R8 texture of Y samples and an R8G8 texture of U and V samples at half the width and height.
+// YUY2 frames are uploaded twice: as R8G8 texels of Y and U or V, and as R8G8B8A8 texels of Y0 U Y1 V at half the width.
+//----------------------------------------------------------------------
+
+Texture2D txLuma : register(t0);
+Texture2D txChroma : register(t1);
+SamplerState samLinear : register(s0);
+
+cbuffer YuvConstants : register(b0)
+{
+	// Coefficients of Y, U and V, followed by an offset, for each of R, G and B. See YUV_TO_RGB_MATRIX.
+	float4 RowR;
+	float4 RowG;
+	float4 RowB;
+	// x is 1 if U and V are in the green and alpha channels of the chroma texture, and 0 if they are in red and green.
+	float4 ChromaLayout;
+};
+
+struct PS_INPUT
+{
+	float4 Pos : SV_POSITION;
+	float2 Tex : TEXCOORD;
+};
+
+//--------------------------------------------------------------------------------------
+// Pixel Shader
+//--------------------------------------------------------------------------------------
+float4 PS(PS_INPUT input) : SV_Target
+{
+	float y = txLuma.Sample(samLinear, input.Tex).r;
+	float4 chroma = txChroma.Sample(samLinear, input.Tex);
+	float3 yuv = float3(y, lerp(chroma.rg, chroma.ga, ChromaLayout.x));
+	float3 rgb = float3(dot(RowR.xyz, yuv) + RowR.w, dot(RowG.xyz, yuv) + RowG.w, dot(RowB.xyz, yuv) + RowB.w);
+	return float4(saturate(rgb), 1.0f);
+}
\ No newline at end of file
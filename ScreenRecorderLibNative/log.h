@@ -20,16 +20,40 @@
 #define LOG_LVL_WARN 3
 #define LOG_LVL_ERR 4
 
-#define LOG_TRACE(format, ...) if(isLoggingEnabled && LOG_LVL_TRACE >= logSeverityLevel) {_log(L"%s [TRACE] [%-25.24hs|%20.19hs:%4d] >> " format L"\n", GetTimestamp().c_str(), file_name(__FILE__), __func__, __LINE__, __VA_ARGS__);}
-#define LOG_DEBUG(format, ...) if(isLoggingEnabled && LOG_LVL_DEBUG >= logSeverityLevel) {_log(L"%s [DEBUG] [%-25.24hs|%20.19hs:%4d] >> " format L"\n", GetTimestamp().c_str(), file_name(__FILE__), __func__, __LINE__, __VA_ARGS__);}
-#define LOG_INFO(format, ...) if(isLoggingEnabled && LOG_LVL_INFO >= logSeverityLevel) {_log(L"%s [INFO]  [%-25.24hs|%20.19hs:%4d] >> " format L"\n", GetTimestamp().c_str(), file_name(__FILE__), __func__, __LINE__, __VA_ARGS__);}
-#define LOG_WARN(format, ...) if(isLoggingEnabled && LOG_LVL_WARN >= logSeverityLevel) {_log(L"%s [WARN]  [%-25.24hs|%20.19hs:%4d] >> " format L"\n", GetTimestamp().c_str(), file_name(__FILE__), __func__, __LINE__, __VA_ARGS__);}
-#define LOG_ERROR(format, ...) if(isLoggingEnabled && LOG_LVL_ERR >= logSeverityLevel) {_log(L"%s [ERROR] [%-25.24hs|%20.19hs:%4d] >> " format L"\n", GetTimestamp().c_str(), file_name(__FILE__), __func__, __LINE__, __VA_ARGS__);}
+#define LOG_TRACE(format, ...) if(isLoggingEnabled && LOG_LVL_TRACE >= logSeverityLevel) {_log(LOG_LVL_TRACE, L"[TRACE] [%-25.24hs|%20.19hs:%4d] >> " format L"\n", file_name(__FILE__), __func__, __LINE__, __VA_ARGS__);}
+#define LOG_DEBUG(format, ...) if(isLoggingEnabled && LOG_LVL_DEBUG >= logSeverityLevel) {_log(LOG_LVL_DEBUG, L"[DEBUG] [%-25.24hs|%20.19hs:%4d] >> " format L"\n", file_name(__FILE__), __func__, __LINE__, __VA_ARGS__);}
+#define LOG_INFO(format, ...) if(isLoggingEnabled && LOG_LVL_INFO >= logSeverityLevel) {_log(LOG_LVL_INFO, L"[INFO]  [%-25.24hs|%20.19hs:%4d] >> " format L"\n", file_name(__FILE__), __func__, __LINE__, __VA_ARGS__);}
+#define LOG_WARN(format, ...) if(isLoggingEnabled && LOG_LVL_WARN >= logSeverityLevel) {_log(LOG_LVL_WARN, L"[WARN]  [%-25.24hs|%20.19hs:%4d] >> " format L"\n", file_name(__FILE__), __func__, __LINE__, __VA_ARGS__);}
+#define LOG_ERROR(format, ...) if(isLoggingEnabled && LOG_LVL_ERR >= logSeverityLevel) {_log(LOG_LVL_ERR, L"[ERROR] [%-25.24hs|%20.19hs:%4d] >> " format L"\n", file_name(__FILE__), __func__, __LINE__, __VA_ARGS__);}
+
+//Interval at which the log writer thread writes queued messages, in milliseconds.
+#define LOG_WRITER_INTERVAL_MILLIS 50
+//Number of intervals without messages after which the log writer thread closes the log file and exits.
+#define LOG_WRITER_IDLE_INTERVALS 20
+
+struct LOG_STATISTICS {
+	// Messages written to the log file or debug output
+	UINT64 WrittenCount;
+	// Messages dropped because the queue of the logging thread was full
+	UINT64 DroppedCount;
+};
 
 extern bool isLoggingEnabled;
 extern int logSeverityLevel;
-extern std::wstring logFilePath;
-void _log(PCWSTR format, ...);
+/// <summary>
+/// Queues a message for the log writer thread, which prefixes it with the time it was logged.
+/// </summary>
+void _log(int level, PCWSTR format, ...);
+/// <summary>
+/// Writes all queued messages before returning.
+/// </summary>
+void FlushLog();
+/// <summary>
+/// Writes the queued messages to the current log file, and writes later messages to the file at the path.
+/// Messages are written to the debug output if the path is empty.
+/// </summary>
+void SetLogFilePath(_In_ std::wstring path);
+LOG_STATISTICS GetLogStatistics();
 std::wstring GetTimestamp();
 
 constexpr const char *file_name(const char *path) {
@@ -736,6 +736,157 @@ namespace ScreenRecorderLib
             }
         }
 
+        [DataTestMethod]
+        [DataRow(TestPatternMode.MovingBars, AudioTestSignal.Tone)]
+        [DataRow(TestPatternMode.ScrollingText, AudioTestSignal.Beeps)]
+        [DataRow(TestPatternMode.Noise, AudioTestSignal.Noise)]
+        [DataRow(TestPatternMode.DirtyRects, AudioTestSignal.Silence)]
+        public void RecordingWithTestPatternAndTestSignal(TestPatternMode mode, AudioTestSignal signal)
+        {
+            string filePath = Path.Combine(GetTempPath(), Path.ChangeExtension(Path.GetRandomFileName(), ".mp4"));
+            try
+            {
+                using (var outStream = File.Open(filePath, FileMode.Create, FileAccess.ReadWrite, FileShare.Read))
+                {
+                    RecorderOptions options = new RecorderOptions();
+                    options.SourceOptions = new SourceOptions
+                    {
+                        RecordingSources = { new TestPatternRecordingSource(mode) { Size = new ScreenSize(640, 360), FrameRate = 30 } }
+                    };
+                    options.AudioOptions = new AudioOptions { IsAudioEnabled = true, TestSignal = signal };
+                    using (var rec = Recorder.CreateRecorder(options))
+                    {
+                        string error = "";
+                        bool isError = false;
+                        bool isComplete = false;
+                        ManualResetEvent finalizeResetEvent = new ManualResetEvent(false);
+                        ManualResetEvent recordingResetEvent = new ManualResetEvent(false);
+                        rec.OnRecordingComplete += (s, args) =>
+                        {
+                            isComplete = true;
+                            finalizeResetEvent.Set();
+                        };
+                        rec.OnRecordingFailed += (s, args) =>
+                        {
+                            isError = true;
+                            error = args.Error;
+                            finalizeResetEvent.Set();
+                            recordingResetEvent.Set();
+                        };
+                        rec.OnFrameRecorded += (s, args) =>
+                        {
+                            if (args.FrameNumber == 10)
+                            {
+                                recordingResetEvent.Set();
+                            }
+                        };
+                        rec.Record(outStream);
+                        recordingResetEvent.WaitOne(DefaultMaxRecordingLengthMillis);
+                        rec.Stop();
+                        finalizeResetEvent.WaitOne(5000);
+                        outStream.Flush();
+                        Assert.IsFalse(isError, error);
+                        Assert.IsTrue(isComplete);
+                        Assert.AreNotEqual(outStream.Length, 0);
+                        var mediaInfo = new MediaInfoWrapper(filePath);
+                        Assert.IsTrue(mediaInfo.VideoStreams.Count > 0);
+                        Assert.IsTrue(mediaInfo.AudioStreams.Count > 0);
+                        Assert.IsTrue(mediaInfo.Width == 640 && mediaInfo.Height == 360, "Expected and actual output dimensions differ");
+                    }
+                }
+            }
+            finally
+            {
+                File.Delete(filePath);
+            }
+        }
+
+        [TestMethod]
+        public void RecordingWithCaptureTraceReplayedAtFullSpeed()
+        {
+            string tracePath = Path.Combine(GetTempPath(), Path.ChangeExtension(Path.GetRandomFileName(), ".srtrace"));
+            string filePath = Path.Combine(GetTempPath(), Path.ChangeExtension(Path.GetRandomFileName(), ".mp4"));
+            string replayFilePath = Path.Combine(GetTempPath(), Path.ChangeExtension(Path.GetRandomFileName(), ".mp4"));
+            try
+            {
+                RecorderOptions options = new RecorderOptions();
+                options.SourceOptions = new SourceOptions
+                {
+                    RecordingSources = { new TestPatternRecordingSource(TestPatternMode.DirtyRects) { Size = new ScreenSize(640, 360), FrameRate = 30 } }
+                };
+                options.AudioOptions = new AudioOptions { IsAudioEnabled = true, TestSignal = AudioTestSignal.Beeps };
+                options.LogOptions = new LogOptions { CaptureTraceFilePath = tracePath };
+                using (var rec = Recorder.CreateRecorder(options))
+                {
+                    bool isError = false;
+                    string error = "";
+                    ManualResetEvent finalizeResetEvent = new ManualResetEvent(false);
+                    ManualResetEvent recordingResetEvent = new ManualResetEvent(false);
+                    rec.OnRecordingComplete += (s, args) => finalizeResetEvent.Set();
+                    rec.OnRecordingFailed += (s, args) =>
+                    {
+                        isError = true;
+                        error = args.Error;
+                        finalizeResetEvent.Set();
+                        recordingResetEvent.Set();
+                    };
+                    rec.OnFrameRecorded += (s, args) =>
+                    {
+                        if (args.FrameNumber == 30)
+                        {
+                            recordingResetEvent.Set();
+                        }
+                    };
+                    rec.Record(filePath);
+                    recordingResetEvent.WaitOne(DefaultMaxRecordingLengthMillis);
+                    rec.Stop();
+                    finalizeResetEvent.WaitOne(5000);
+                    Assert.IsFalse(isError, error);
+                }
+                Assert.IsTrue(new FileInfo(tracePath).Length > 0);
+
+                RecorderOptions replayOptions = new RecorderOptions();
+                replayOptions.SourceOptions = new SourceOptions
+                {
+                    RecordingSources = { new ReplayRecordingSource(tracePath, ReplaySpeed.FullSpeed) }
+                };
+                replayOptions.AudioOptions = new AudioOptions { IsAudioEnabled = true };
+                using (var rec = Recorder.CreateRecorder(replayOptions))
+                {
+                    bool isError = false;
+                    bool isComplete = false;
+                    string error = "";
+                    ManualResetEvent finalizeResetEvent = new ManualResetEvent(false);
+                    rec.OnRecordingComplete += (s, args) =>
+                    {
+                        isComplete = true;
+                        finalizeResetEvent.Set();
+                    };
+                    rec.OnRecordingFailed += (s, args) =>
+                    {
+                        isError = true;
+                        error = args.Error;
+                        finalizeResetEvent.Set();
+                    };
+                    rec.Record(replayFilePath);
+                    //The replay ends by itself when the end of the trace is reached
+                    finalizeResetEvent.WaitOne(DefaultMaxRecordingLengthMillis);
+                    Assert.IsFalse(isError, error);
+                    Assert.IsTrue(isComplete);
+                    var mediaInfo = new MediaInfoWrapper(replayFilePath);
+                    Assert.IsTrue(mediaInfo.VideoStreams.Count > 0);
+                    Assert.IsTrue(mediaInfo.AudioStreams.Count > 0);
+                    Assert.IsTrue(mediaInfo.Width == 640 && mediaInfo.Height == 360, "Expected and actual output dimensions differ");
+                }
+            }
+            finally
+            {
+                File.Delete(tracePath);
+                File.Delete(filePath);
+                File.Delete(replayFilePath);
+            }
+        }
+
         [TestMethod]
         public void RecordingWithOutputCropAndCustomFrameSize()
         {
@@ -0,0 +1,59 @@
+//
+// Prints a flight recorder dump written by ScreenRecorderLib, like the .flightrec file written next to a failed recording, as text or CSV.
+// Only uses the standard library, so it builds with any C++17 compiler:
+//
+//   cl /std:c++17 /EHsc FlightRecorderDecoder.cpp
+//   c++ -std=c++17 FlightRecorderDecoder.cpp -o FlightRecorderDecoder
+//
+// Usage: FlightRecorderDecoder <dump file> [--csv]
+//
+#include "../../ScreenRecorderLibNative/FlightRecorderFormat.h"
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+int main(int argc, char *argv[])
+{
+	if (argc < 2) {
+		fprintf(stderr, "Usage: %s <dump file> [--csv]\n", argv[0]);
+		return 2;
+	}
+	bool isCsv = argc > 2 && strcmp(argv[2], "--csv") == 0;
+	std::ifstream stream(argv[1], std::ios_base::in | std::ios_base::binary);
+	if (!stream.is_open()) {
+		fprintf(stderr, "Failed to open %s\n", argv[1]);
+		return 1;
+	}
+	FLIGHT_RECORDER_HEADER header{};
+	std::vector<FLIGHT_RECORD> records;
+	if (!FlightRecorderFile::Read(stream, &header, &records)) {
+		fprintf(stderr, "%s is not a flight recorder dump of version %d, or is truncated\n", argv[1], FLIGHT_RECORDER_VERSION);
+		return 1;
+	}
+	//Times are printed in milliseconds before the dump was written
+	auto GetMillisBeforeDump([&](const FLIGHT_RECORD &record) {
+		return header.Frequency > 0 ? (header.DumpTime - record.Time) * 1000.0 / header.Frequency : 0.0;
+	});
+	if (isCsv) {
+		printf("sequence,ms_before_dump,thread,event,hresult,value,detail\n");
+	}
+	else {
+		printf("%" PRIu32 " records, %" PRIu32 " dropped while dumping\n", header.RecordCount, header.DroppedRecordCount);
+		printf("%10s %14s %8s %-20s %10s %20s %6s\n", "sequence", "ms before dump", "thread", "event", "hresult", "value", "detail");
+	}
+	for (const FLIGHT_RECORD &record : records) {
+		const char *format = isCsv
+			? "%" PRIu32 ",%.3f,%" PRIu32 ",%s,0x%08" PRIX32 ",%" PRId64 ",%u\n"
+			: "%10" PRIu32 " %14.3f %8" PRIu32 " %-20s 0x%08" PRIX32 " %20" PRId64 " %6u\n";
+		printf(format,
+			record.Sequence,
+			GetMillisBeforeDump(record),
+			record.ThreadId,
+			GetFlightEventName(record.Type),
+			static_cast<uint32_t>(record.Result),
+			record.Value,
+			static_cast<unsigned int>(record.Detail));
+	}
+	return 0;
+}